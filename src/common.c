@@ -15,8 +15,15 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <math.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "common.h"
 
 void pl_rect2d_normalize(struct pl_rect2d *rc)
@@ -343,3 +350,57 @@ void pl_rect2df_offset(struct pl_rect2df *rc, float offset_x, float offset_y)
     rc->y0 += offset_y;
     rc->y1 += offset_y;
 }
+
+struct weight_idx {
+    float mag;
+    int idx;
+};
+
+static int cmp_weight_idx(const void *pa, const void *pb)
+{
+    const struct weight_idx *a = pa, *b = pb;
+    if (a->mag != b->mag)
+        return a->mag < b->mag ? 1 : -1; // descending magnitude
+    return a->idx - b->idx;
+}
+
+void pl_weights_round_half(float *weights, int num)
+{
+    struct weight_idx *order = malloc(num * sizeof(*order));
+    if (!order) {
+        // Fall back to plain rounding
+        for (int i = 0; i < num; i++)
+            weights[i] = pl_half_to_float(pl_float_to_half(weights[i]));
+        return;
+    }
+
+    for (int i = 0; i < num; i++)
+        order[i] = (struct weight_idx) { fabsf(weights[i]), i };
+    qsort(order, num, sizeof(*order), cmp_weight_idx);
+
+    // The smallest weights have the finest quantization, so the error that
+    // remains after the last weight is as small as possible
+    double err = 0.0;
+    for (int i = 0; i < num; i++) {
+        float *w = &weights[order[i].idx];
+        double target = *w + err;
+        *w = pl_half_to_float(pl_float_to_half(target));
+        err = target - *w;
+    }
+
+    free(order);
+}
+
+int pl_cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return PL_MAX(1, (int) info.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    return PL_MAX(1, (int) PL_MIN(num, INT_MAX));
+#else
+    return 1;
+#endif
+}
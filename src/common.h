@@ -49,6 +49,7 @@
 #include "include/libplacebo/shaders/colorspace.h"
 #include "include/libplacebo/shaders/sampling.h"
 #include "include/libplacebo/swapchain.h"
+#include "include/libplacebo/utils/render_pool.h"
 #include "include/libplacebo/utils/upload.h"
 
 #ifdef PL_HAVE_VULKAN
@@ -129,3 +130,81 @@ static inline size_t pl_lcm(size_t x, size_t y)
     assert(x && y);
     return x * (y / pl_gcd(x, y));
 }
+
+// Converts a float to an IEEE 754 half-precision float, rounding to nearest
+// (ties to even). Values too large for half precision become infinite.
+static inline uint16_t pl_float_to_half(float f)
+{
+    union { float f; uint32_t u; } x = { .f = f };
+    uint16_t sign = (x.u >> 16) & 0x8000;
+    uint32_t abs = x.u & 0x7FFFFFFF;
+    uint32_t h, rem, halfway;
+
+    if (abs > 0x7F800000)
+        return sign | 0x7E00; // NaN
+    if (abs >= 0x477FF000)
+        return sign | 0x7C00; // rounds to infinity
+    if (abs < 0x33000000)
+        return sign; // rounds to zero
+
+    if (abs < 0x38800000) {
+        // Subnormal half, shift out the mantissa including the implicit bit
+        int shift = 126 - (abs >> 23);
+        uint32_t mant = (abs & 0x7FFFFF) | 0x800000;
+        h = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        // Normal half, rebias the exponent (a mantissa overflow correctly
+        // carries over into the exponent when rounding up)
+        h = (abs - 0x38000000) >> 13;
+        rem = abs & 0x1FFF;
+        halfway = 0x1000;
+    }
+
+    if (rem > halfway || (rem == halfway && (h & 1)))
+        h++;
+    return sign | h;
+}
+
+static inline float pl_half_to_float(uint16_t h)
+{
+    union { float f; uint32_t u; } x;
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F, mant = h & 0x3FF;
+
+    if (exp == 0x1F) {
+        x.u = sign | 0x7F800000 | (mant << 13);
+    } else if (exp) {
+        x.u = sign | ((exp + 112) << 23) | (mant << 13);
+    } else {
+        x.f = mant * (1.0f / (1 << 24)); // subnormal, exact
+        x.u |= sign;
+    }
+
+    return x.f;
+}
+
+// Rounds `num` weights (e.g. one row of a separable filter) in-place to values
+// exactly representable as half floats. Rather than rounding each weight
+// independently, the rounding error is diffused from the largest to the
+// smallest weight, so that the sum of the weights is preserved.
+void pl_weights_round_half(float *weights, int num);
+
+// Hashes a filter config by value, consistent with `pl_filter_config_eq`.
+// Returns 0 for NULL configs.
+uint64_t pl_filter_config_hash(const struct pl_filter_config *c);
+
+// Helpers for hashing structs field by field, since hashing their raw memory
+// would also hash any padding bytes and pointer values
+static inline void pl_hash_merge(uint64_t *accum, uint64_t hash)
+{
+    *accum ^= hash + 0x9e3779b97f4a7c15LLU + (*accum << 6) + (*accum >> 2);
+}
+
+// Merges a single value (or padding-free array of values) into `accum`
+#define PL_HASH_VAL(accum, x) \
+    pl_hash_merge((accum), siphash64((const uint8_t *) &(x), sizeof(x)))
+
+// Returns the number of CPUs available to the process (at least 1)
+int pl_cpu_count(void);
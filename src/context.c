@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <locale.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "common.h"
 #include "context.h"
@@ -75,6 +76,7 @@ struct pl_context *pl_context_create(int api_ver,
 
     struct pl_context *ctx = talloc_zero(NULL, struct pl_context);
     ctx->params = *PL_DEF(params, &pl_context_default_params);
+    pthread_mutex_init(&ctx->lock, NULL);
     pl_info(ctx, "Initialized libplacebo %s (API v%d)", PL_VERSION, PL_API_VER);
     return ctx;
 }
@@ -83,6 +85,11 @@ const struct pl_context_params pl_context_default_params = {0};
 
 void pl_context_destroy(struct pl_context **ctx)
 {
+    if (*ctx) {
+        pthread_mutex_destroy(&(*ctx)->lock);
+        talloc_free((*ctx)->logbuffer.start);
+    }
+
     TA_FREEP(ctx);
 
     // Do global uninitialization only when refcount reaches 0
@@ -151,9 +158,13 @@ void pl_msg_va(struct pl_context *ctx, enum pl_log_level lev, const char *fmt,
     if (!pl_msg_test(ctx, lev))
         return;
 
+    // The log buffer is deliberately not parented to `ctx`, so that it can
+    // be grown without racing against other allocations on the context
+    pthread_mutex_lock(&ctx->lock);
     ctx->logbuffer.len = 0;
-    bstr_xappend_vasprintf(ctx, &ctx->logbuffer, fmt, va);
+    bstr_xappend_vasprintf(NULL, &ctx->logbuffer, fmt, va);
     ctx->params.log_cb(ctx->params.log_priv, lev, ctx->logbuffer.start);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 void pl_msg_source(struct pl_context *ctx, enum pl_log_level lev, const char *src)
@@ -174,3 +185,77 @@ void pl_msg_source(struct pl_context *ctx, enum pl_log_level lev, const char *sr
         line++;
     }
 }
+
+uint64_t pl_clock_ns(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Small per-thread IDs, for readability of the resulting trace
+static int trace_threads;
+static __thread int trace_thread;
+
+static void trace_event(struct pl_context *ctx, struct pl_trace_event ev)
+{
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->params.trace_cb)
+        ctx->params.trace_cb(ctx->params.trace_priv, &ev);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+uint64_t pl_trace_begin(struct pl_context *ctx)
+{
+    return pl_trace_test(ctx) ? pl_clock_ns() : 0;
+}
+
+void pl_trace_end(struct pl_context *ctx, const char *category,
+                  const char *name, uint64_t start)
+{
+    if (!start || !pl_trace_test(ctx))
+        return;
+
+    if (!trace_thread)
+        trace_thread = __atomic_add_fetch(&trace_threads, 1, __ATOMIC_RELAXED);
+
+    uint64_t now = pl_clock_ns();
+    trace_event(ctx, (struct pl_trace_event) {
+        .category = category,
+        .name = name,
+        .start_ns = start,
+        .duration_ns = now > start ? now - start : 0,
+        .thread = trace_thread,
+    });
+}
+
+void pl_trace_gpu(struct pl_context *ctx, const char *category,
+                  const char *name, uint64_t duration_ns)
+{
+    if (!pl_trace_test(ctx))
+        return;
+
+    uint64_t now = pl_clock_ns();
+    trace_event(ctx, (struct pl_trace_event) {
+        .category = category,
+        .name = name,
+        .start_ns = now > duration_ns ? now - duration_ns : 0,
+        .duration_ns = duration_ns,
+        .thread = 0,
+    });
+}
+
+void pl_trace_chrome(void *stream, const struct pl_trace_event *ev)
+{
+    // Timestamps are in microseconds. Printed as integers, to avoid depending
+    // on the locale's decimal separator
+    FILE *h = PL_DEF(stream, stdout);
+    fprintf(h, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"ts\":%"PRIu64".%03d,\"dur\":%"PRIu64".%03d,"
+            "\"pid\":0,\"tid\":%d},\n",
+            ev->name, ev->category,
+            ev->start_ns / 1000, (int) (ev->start_ns % 1000),
+            ev->duration_ns / 1000, (int) (ev->duration_ns % 1000),
+            ev->thread);
+}
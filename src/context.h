@@ -18,11 +18,13 @@
 #pragma once
 
 #include <stdarg.h>
+#include <pthread.h>
 #include "common.h"
 
 struct pl_context {
     struct pl_context_params params;
     struct bstr logbuffer;
+    pthread_mutex_t lock; // protects `logbuffer` and the call to `log_cb`
     // Provide a place for implementations to track suppression of errors
     uint64_t suppress_errors_for_object;
 };
@@ -57,3 +59,23 @@ void pl_msg_va(struct pl_context *ctx, enum pl_log_level lev, const char *fmt,
 
 // Log something with line numbers included
 void pl_msg_source(struct pl_context *ctx, enum pl_log_level lev, const char *src);
+
+// Returns the current value of a monotonic clock, in nanoseconds
+uint64_t pl_clock_ns(void);
+
+// Tracing-related functions. `category` and `name` must be static strings.
+static inline bool pl_trace_test(struct pl_context *ctx)
+{
+    return ctx->params.trace_cb;
+}
+
+// Returns the start time of a traced span, or 0 if tracing is disabled
+uint64_t pl_trace_begin(struct pl_context *ctx);
+
+// Reports a span started with `pl_trace_begin`. Does nothing if `start` is 0
+void pl_trace_end(struct pl_context *ctx, const char *category,
+                  const char *name, uint64_t start);
+
+// Reports a GPU execution time which was just retrieved from a `pl_timer`
+void pl_trace_gpu(struct pl_context *ctx, const char *category,
+                  const char *name, uint64_t duration_ns);
@@ -15,6 +15,8 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+
 #include "common.h"
 #include "context.h"
 #include "shaders.h"
@@ -39,24 +41,85 @@ struct pl_dispatch {
     struct pl_shader **shaders;
     int num_shaders;
 
-    // cache of compiled passes
+    // cache of compiled passes, plus a hash table (indexed by `pass->key`)
+    // for fast lookup. `buckets` is always a power of two in size.
     struct pass **passes;
     int num_passes;
+    struct pass **buckets;
+    int num_buckets;
+    uint64_t use_count; // monotonic counter for LRU tracking
+
+    // cached programs (loaded via pl_dispatch_load), indexed by signature
+    struct cached_pass *cached_passes;
+    int num_cached_passes;
 
     // temporary buffers to help avoid re_allocations during pass creation
     struct bstr tmp[TMP_COUNT];
+
+    // value of `pl_shader_params.reduced_precision` for new shaders
+    bool reduced_precision;
+
+    // value of `pl_shader_params.specialize_constants` for new shaders
+    bool specialize_constants;
+
+    // upgrade passes to compute shaders whenever the target allows it
+    bool prefer_compute;
+
+    // work group sizes of compute shaders, tuned or loaded so far, plus a
+    // hash table (indexed by `tuned_shader.key`) for fast lookup. `buckets`
+    // is always a power of two in size. (see `pl_dispatch_set_autotune`)
+    bool autotune;
+    struct tuned_shader **tuned;
+    int num_tuned;
+    struct tuned_shader **tuned_buckets;
+    int num_tuned_buckets;
+
+    // state for asynchronous compilation (see `compile_thread`). `done` is
+    // signalled whenever a compile thread finishes a queued pass
+    bool async;
+    int num_skipped;
+    pthread_t *threads;
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_cond_t done;
+    bool quit;
+    struct pass **queue; // protected by `lock`
+    int num_queue;
+
+    // state for warm-up sessions (see `pl_dispatch_warmup_begin`). While
+    // `warmup` is set, passes are only compiled, never executed
+    bool warmup;
+    bool warmup_failed;
+    int num_warmed;
+    uint8_t warmup_index; // `current_index` to restore once the session ends
+    struct pass **warmup_pending;
+    int num_warmup_pending;
+
+    // ring of host-mapped uniform buffers, which all passes sub-allocate
+    // their uniform data from (see `ubo_alloc`). `ubo_pos` is the current
+    // write position inside `ubo_ring[ubo_idx]`
+    const struct pl_buf **ubo_ring;
+    int num_ubo_ring;
+    int ubo_idx;
+    size_t ubo_pos;
+    bool ubo_ring_failed;
+
+    // cumulative statistics, see `pl_dispatch_stats`
+    struct pl_dispatch_stats stats;
 };
 
 enum pass_var_type {
     PASS_VAR_NONE = 0,
     PASS_VAR_GLOBAL, // regular/global uniforms (PL_GPU_CAP_INPUT_VARIABLES)
     PASS_VAR_UBO,    // uniform buffers
-    PASS_VAR_PUSHC   // push constants
+    PASS_VAR_PUSHC,  // push constants
+    PASS_VAR_CONST,  // specialization constants (`compile_time` vars)
 };
 
 // Cached metadata about a variable's effective placement / update method
 struct pass_var {
-    int index; // for pl_var_update
+    int index; // for pl_var_update, or the first `constant_id`
     enum pass_var_type type;
     struct pl_var_layout layout;
     void *cached_data;
@@ -64,15 +127,42 @@ struct pass_var {
 
 struct pass {
     uint64_t signature; // as returned by pl_shader_signature
+    uint64_t key;       // hash of the signature + raster target state
+    uint64_t constants; // hash of the specialization constant values
     const struct pl_pass *pass;
     bool failed;
 
+    // raster state this pass was created for (for cache lookups)
+    bool is_compute;
+    const struct pl_fmt *target_fmt;
+    struct pl_blend_params blend;
+    bool has_blend;
+    bool load;
+
+    // hash table chaining and LRU metadata
+    struct pass *next;
+    uint64_t last_use;
+
+    // for asynchronous compilation. `async_params` is owned by the pass and
+    // only accessed by the compile thread while queued; `async_res` and
+    // `async_done` are protected by `pl_dispatch.lock`
+    bool pending;
+    struct pl_pass_params *async_params;
+    const struct pl_pass *async_res;
+    bool async_done;
+
     // contains cached data and update metadata, same order as pl_shader
     struct pass_var *vars;
 
-    // for uniform buffer updates
+    // for uniform buffer updates. The contents are staged in `ubo_data` and
+    // copied to the GPU once per dispatch, either into a sub-allocation of
+    // the dispatch's UBO ring, or (as a fallback) into the dedicated `ubo`
     const struct pl_buf *ubo;
     struct pl_shader_desc ubo_desc; // temporary
+    int ubo_index;
+    size_t ubo_size;
+    uint8_t *ubo_data;
+    bool ubo_dirty;
 
     // Cached pl_pass_run_params. This will also contain mutable allocations
     // for the push constants, descriptor bindings (including the binding for
@@ -80,6 +170,48 @@ struct pass {
     struct pl_pass_run_params run_params;
 };
 
+struct cached_pass {
+    uint64_t signature;
+    const uint8_t *cached_program;
+    size_t cached_program_len;
+};
+
+// Candidate work group sizes tried by the autotuner for flexible compute
+// shaders, depending on whether their default work group is 2D or 1D
+static const int tune_sizes_2d[][2] = {
+    {8, 8}, {16, 8}, {16, 16}, {32, 8}, {32, 16}, {64, 4}, {32, 32},
+};
+
+static const int tune_sizes_1d[][2] = {
+    {64, 1}, {128, 1}, {256, 1}, {512, 1}, {1024, 1},
+};
+
+#define TUNE_MAX_CANDIDATES 8
+#define TUNE_RUNS 4         // timer results required per candidate
+#define TUNE_MAX_SUBMITS 16 // dispatches per candidate before giving up on it
+
+struct tuned_shader {
+    struct tuned_shader *next; // next entry in the same hash bucket
+    uint64_t key;       // shader signature, or the key of `sh_tune_group_size`
+    int size[2];        // fastest work group size, or {0} for the default
+    bool done;
+
+    // candidate sizes and tuning state, with one timer per candidate (since
+    // timer results can't be reliably paired with individual dispatches)
+    int sizes[TUNE_MAX_CANDIDATES][2];
+    int num_sizes;
+    struct pl_timer *timers[TUNE_MAX_CANDIDATES];
+    uint64_t best_ns[TUNE_MAX_CANDIDATES];
+    int results[TUNE_MAX_CANDIDATES];
+    int submits[TUNE_MAX_CANDIDATES];
+};
+
+static void tuned_shader_uninit(struct pl_dispatch *dp, struct tuned_shader *t)
+{
+    for (int i = 0; i < TUNE_MAX_CANDIDATES; i++)
+        pl_timer_destroy(dp->gpu, &t->timers[i]);
+}
+
 static void pass_destroy(struct pl_dispatch *dp, struct pass *pass)
 {
     if (!pass)
@@ -87,6 +219,7 @@ static void pass_destroy(struct pl_dispatch *dp, struct pass *pass)
 
     pl_buf_destroy(dp->gpu, &pass->ubo);
     pl_pass_destroy(dp->gpu, &pass->pass);
+    pl_pass_destroy(dp->gpu, &pass->async_res);
     talloc_free(pass);
 }
 
@@ -97,20 +230,106 @@ struct pl_dispatch *pl_dispatch_create(struct pl_context *ctx,
     struct pl_dispatch *dp = talloc_zero(ctx, struct pl_dispatch);
     dp->ctx = ctx;
     dp->gpu = gpu;
+    pthread_mutex_init(&dp->lock, NULL);
+    pthread_cond_init(&dp->wakeup, NULL);
+    pthread_cond_init(&dp->done, NULL);
 
     return dp;
 }
 
+// Upper bound on the number of cached passes. When exceeded, the least
+// recently used pass is evicted from the cache.
+#define MAX_PASSES 500
+
+static void unlink_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    struct pass **link = &dp->buckets[pass->key & (dp->num_buckets - 1)];
+    while (*link != pass) {
+        pl_assert(*link);
+        link = &(*link)->next;
+    }
+
+    *link = pass->next;
+    pass->next = NULL;
+}
+
+static void link_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    struct pass **head = &dp->buckets[pass->key & (dp->num_buckets - 1)];
+    pass->next = *head;
+    *head = pass;
+}
+
+static void evict_lru_pass(struct pl_dispatch *dp)
+{
+    // Never evict passes which are still being compiled
+    int idx = -1;
+    for (int i = 0; i < dp->num_passes; i++) {
+        if (dp->passes[i]->pending)
+            continue;
+        if (idx < 0 || dp->passes[i]->last_use < dp->passes[idx]->last_use)
+            idx = i;
+    }
+
+    if (idx < 0)
+        return;
+
+    struct pass *pass = dp->passes[idx];
+    PL_TRACE(dp, "Evicting least recently used pass 0x%llx from cache",
+             (unsigned long long) pass->signature);
+
+    unlink_pass(dp, pass);
+    TARRAY_REMOVE_AT(dp->passes, dp->num_passes, idx);
+    pass_destroy(dp, pass);
+}
+
+static void insert_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (dp->num_passes >= MAX_PASSES)
+        evict_lru_pass(dp);
+
+    TARRAY_APPEND(dp, dp->passes, dp->num_passes, pass);
+
+    // Keep the load factor at or below 1 by growing the table as needed
+    if (dp->num_passes > dp->num_buckets) {
+        int num_buckets = PL_MAX(dp->num_buckets * 2, 16);
+        TARRAY_RESIZE(dp, dp->buckets, num_buckets);
+        memset(dp->buckets, 0, num_buckets * sizeof(dp->buckets[0]));
+        dp->num_buckets = num_buckets;
+        for (int i = 0; i < dp->num_passes; i++)
+            link_pass(dp, dp->passes[i]);
+    } else {
+        link_pass(dp, pass);
+    }
+}
+
 void pl_dispatch_destroy(struct pl_dispatch **ptr)
 {
     struct pl_dispatch *dp = *ptr;
     if (!dp)
         return;
 
+    // Stop the compile threads, discarding any queued (but not yet started)
+    // compilation jobs
+    pthread_mutex_lock(&dp->lock);
+    dp->quit = true;
+    pthread_cond_broadcast(&dp->wakeup);
+    pthread_mutex_unlock(&dp->lock);
+    for (int i = 0; i < dp->num_threads; i++)
+        pthread_join(dp->threads[i], NULL);
+
+    pthread_cond_destroy(&dp->done);
+    pthread_cond_destroy(&dp->wakeup);
+    pthread_mutex_destroy(&dp->lock);
+
     for (int i = 0; i < dp->num_passes; i++)
         pass_destroy(dp, dp->passes[i]);
     for (int i = 0; i < dp->num_shaders; i++)
         pl_shader_free(&dp->shaders[i]);
+    for (int i = 0; i < dp->num_ubo_ring; i++)
+        pl_buf_destroy(dp->gpu, &dp->ubo_ring[i]);
+    for (int i = 0; i < dp->num_tuned; i++)
+        tuned_shader_uninit(dp, dp->tuned[i]);
 
     talloc_free(dp);
     *ptr = NULL;
@@ -122,15 +341,19 @@ struct pl_shader *pl_dispatch_begin_ex(struct pl_dispatch *dp, bool unique)
         .id = unique ? dp->current_ident++ : 0,
         .gpu = dp->gpu,
         .index = dp->current_index,
+        .reduced_precision = dp->reduced_precision,
+        .specialize_constants = dp->specialize_constants,
     };
 
     struct pl_shader *sh;
     if (TARRAY_POP(dp->shaders, dp->num_shaders, &sh)) {
         pl_shader_reset(sh, &params);
-        return sh;
+    } else {
+        sh = pl_shader_alloc(dp->ctx, &params);
     }
 
-    return pl_shader_alloc(dp->ctx, &params);
+    sh->dp = dp;
+    return sh;
 }
 
 void pl_dispatch_reset_frame(struct pl_dispatch *dp)
@@ -144,6 +367,76 @@ struct pl_shader *pl_dispatch_begin(struct pl_dispatch *dp)
     return pl_dispatch_begin_ex(dp, false);
 }
 
+// Size of each buffer in the UBO ring, and the maximum number of buffers
+#define UBO_CHUNK_SIZE (64 * 1024)
+#define MAX_UBO_CHUNKS 16
+
+static size_t ubo_chunk_size(const struct pl_gpu *gpu)
+{
+    return PL_MIN(UBO_CHUNK_SIZE, gpu->limits.max_ubo_size);
+}
+
+static bool ubo_ring_usable(struct pl_dispatch *dp, size_t size)
+{
+    const struct pl_gpu *gpu = dp->gpu;
+    return !dp->ubo_ring_failed && gpu->limits.align_ubo_offset &&
+           (gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS) &&
+           size <= ubo_chunk_size(gpu);
+}
+
+// Whether or not a variable gets implemented as a specialization constant.
+// Only scalars and vectors are supported, since matrices can't be constructed
+// out of specialization constants.
+static bool is_spec_const(const struct pl_dispatch *dp,
+                          const struct pl_shader_var *sv)
+{
+    const struct pl_gpu *gpu = dp->gpu;
+    return sv->compile_time && gpu->glsl.vulkan && gpu->limits.max_constants &&
+           sv->var.dim_m == 1 && sv->var.dim_a == 1;
+}
+
+// Hashes the values of all specialization constants. These are not part of
+// the shader text, so passes differing only in these values need to be told
+// apart separately
+static uint64_t constants_hash(const struct pl_dispatch *dp,
+                               const struct pl_shader *sh)
+{
+    uint64_t hash = 0;
+    for (int i = 0; i < sh->res.num_variables; i++) {
+        const struct pl_shader_var *sv = &sh->variables[i];
+        if (!is_spec_const(dp, sv))
+            continue;
+
+        size_t size = pl_var_host_layout(0, &sv->var).size;
+        uint64_t data[2] = { hash, siphash64(sv->data, size) };
+        hash = siphash64((const uint8_t *) data, sizeof(data));
+    }
+
+    return hash;
+}
+
+// Orders variables by how much they benefit from being placed in push
+// constants: Frequently updated variables come first, since every update of a
+// UBO variable costs a buffer write. After that, smaller variables come first,
+// so as many variables as possible fit into the push constant budget, and the
+// large (and mostly static) ones like matrices get pushed into the UBO
+// instead. Ordering by size also minimizes the std430 alignment padding.
+static int cmp_var_priority(const void *pa, const void *pb)
+{
+    const struct pl_shader_var *a = *(const struct pl_shader_var **) pa;
+    const struct pl_shader_var *b = *(const struct pl_shader_var **) pb;
+    if (a->dynamic != b->dynamic)
+        return a->dynamic ? -1 : 1;
+
+    size_t size_a = pl_var_host_layout(0, &a->var).size;
+    size_t size_b = pl_var_host_layout(0, &b->var).size;
+    if (size_a != size_b)
+        return PL_CMP(size_a, size_b);
+
+    // Preserve the declaration order otherwise, for determinism
+    return PL_CMP(a, b);
+}
+
 static bool add_pass_var(struct pl_dispatch *dp, void *tmp, struct pass *pass,
                          struct pl_pass_params *params,
                          const struct pl_shader_var *sv, struct pass_var *pv,
@@ -153,6 +446,34 @@ static bool add_pass_var(struct pl_dispatch *dp, void *tmp, struct pass *pass,
     if (pv->type)
         return true;
 
+    // Bake compile-time constants directly into the pass, if possible
+    int num_consts = params->num_constants + sv->var.dim_v;
+    if (is_spec_const(dp, sv) && num_consts <= gpu->limits.max_constants) {
+        size_t offset = 0;
+        int num = params->num_constants;
+        if (num) {
+            const struct pl_constant *last = &params->constants[num - 1];
+            offset = last->offset + pl_var_type_size(last->type);
+        }
+
+        size_t size = pl_var_host_layout(0, &sv->var).size;
+        params->constant_data = talloc_realloc_size(tmp, params->constant_data,
+                                                    offset + size);
+        memcpy((uint8_t *) params->constant_data + offset, sv->data, size);
+
+        pv->type = PASS_VAR_CONST;
+        pv->index = num;
+        for (int i = 0; i < sv->var.dim_v; i++) {
+            struct pl_constant con = {
+                .type = sv->var.type,
+                .offset = offset + i * pl_var_type_size(sv->var.type),
+                .id = params->num_constants,
+            };
+            TARRAY_APPEND(tmp, params->constants, params->num_constants, con);
+        }
+        return true;
+    }
+
     // Try not to use push constants for "large" values like matrices in the
     // first pass, since this is likely to exceed the VGPR/pushc size budgets
     bool try_pushc = greedy || (sv->var.dim_m == 1 && sv->var.dim_a == 1) || sv->dynamic;
@@ -172,13 +493,21 @@ static bool add_pass_var(struct pl_dispatch *dp, void *tmp, struct pass *pass,
         return true;
 
     // Attempt using uniform buffer next. The GLSL version 440 check is due
-    // to explicit offsets on UBO entries. In theory we could leave away
-    // the offsets and support UBOs for older GL as well, but this is a nice
-    // safety net for driver bugs (and also rules out potentially buggy drivers)
-    // Also avoid UBOs for highly dynamic stuff since that requires synchronizing
-    // the UBO writes every frame
-    bool try_ubo = !(gpu->caps & PL_GPU_CAP_INPUT_VARIABLES) || !sv->dynamic;
-    if (try_ubo && gpu->glsl.version >= 440 && gpu->limits.max_ubo_size) {
+    // to explicit offsets on UBO entries. Older GLSL versions can still use
+    // UBOs by relying on the implicit std140 layout (which matches the
+    // offsets we compute), but only do this if the UBO ring is usable, which
+    // serves as a nice safety net for driver bugs (since it also rules out
+    // drivers without persistently mapped buffers).
+    //
+    // Also avoid UBOs for highly dynamic stuff, since that requires
+    // synchronizing the UBO writes every frame - unless we can sub-allocate
+    // from the UBO ring, in which case packing everything into the UBO turns
+    // one update call per variable into a single buffer write per dispatch.
+    bool ubo_ring = ubo_ring_usable(dp, 0);
+    int ubo_ver = ubo_ring ? (gpu->glsl.gles ? 300 : 140) : 440;
+    bool try_ubo = !(gpu->caps & PL_GPU_CAP_INPUT_VARIABLES) || !sv->dynamic ||
+                   ubo_ring;
+    if (try_ubo && gpu->glsl.version >= ubo_ver && gpu->limits.max_ubo_size) {
         if (sh_buf_desc_append(tmp, gpu, &pass->ubo_desc, &pv->layout, sv->var)) {
             pv->type = PASS_VAR_UBO;
             return true;
@@ -217,6 +546,46 @@ static void add_var(struct pl_dispatch *dp, struct bstr *body,
     }
 }
 
+// Declares a variable as a (vector of) specialization constant(s), starting
+// at the given `constant_id`. The real values are always provided when
+// creating the pass, so the defaults are left as zero, which keeps the shader
+// text independent of them.
+static void add_spec_const(struct pl_dispatch *dp, struct bstr *body,
+                           const struct pl_var *var, int id)
+{
+    static const char *types[PL_VAR_TYPE_COUNT] = {
+        [PL_VAR_SINT]  = "int",
+        [PL_VAR_UINT]  = "uint",
+        [PL_VAR_FLOAT] = "float",
+    };
+
+    static const char *zero[PL_VAR_TYPE_COUNT] = {
+        [PL_VAR_SINT]  = "0",
+        [PL_VAR_UINT]  = "0u",
+        [PL_VAR_FLOAT] = "0.0",
+    };
+
+    const char *type = types[var->type];
+    pl_assert(type);
+
+    if (var->dim_v == 1) {
+        ADD(body, "layout(constant_id=%d) const %s %s = %s;\n",
+            id, type, var->name, zero[var->type]);
+        return;
+    }
+
+    for (int i = 0; i < var->dim_v; i++) {
+        ADD(body, "layout(constant_id=%d) const %s %s_%d = %s;\n",
+            id + i, type, var->name, i, zero[var->type]);
+    }
+
+    const char *vtype = pl_var_glsl_type_name(*var);
+    ADD(body, "const %s %s = %s(", vtype, var->name, vtype);
+    for (int i = 0; i < var->dim_v; i++)
+        ADD(body, "%s%s_%d", i > 0 ? ", " : "", var->name, i);
+    ADD(body, ");\n");
+}
+
 static int cmp_buffer_var(const void *pa, const void *pb)
 {
     const struct pl_buffer_var * const *a = pa, * const *b = pb;
@@ -265,8 +634,14 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
     struct bstr *pre = &dp->tmp[TMP_PRELUDE];
     ADD(pre, "#version %d%s\n", gpu->glsl.version,
         (gpu->glsl.gles && gpu->glsl.version > 100) ? " es" : "");
-    if (params->type == PL_PASS_COMPUTE)
-        ADD(pre, "#extension GL_ARB_compute_shader : enable\n");
+    if (params->type == PL_PASS_COMPUTE) {
+        if (!gpu->glsl.gles)
+            ADD(pre, "#extension GL_ARB_compute_shader : enable\n");
+        if (gpu->glsl.subgroup_size) {
+            ADD(pre, "#extension GL_KHR_shader_subgroup_basic : enable\n"
+                     "#extension GL_KHR_shader_subgroup_arithmetic : enable\n");
+        }
+    }
 
     // Enable all extensions needed for different types of input
     bool has_ssbo = false, has_ubo = false, has_img = false, has_texel = false,
@@ -291,11 +666,12 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
         }
     }
 
-    if (has_img)
+    // (These are all core in GLSL ES 3.10, which compute shaders require)
+    if (has_img && !gpu->glsl.gles)
         ADD(pre, "#extension GL_ARB_shader_image_load_store : enable\n");
     if (has_ubo)
         ADD(pre, "#extension GL_ARB_uniform_buffer_object : enable\n");
-    if (has_ssbo)
+    if (has_ssbo && !gpu->glsl.gles)
         ADD(pre, "#extension GL_ARB_shader_storage_buffer_object : enable\n");
     if (has_texel)
         ADD(pre, "#extension GL_ARB_texture_buffer_object : enable\n");
@@ -457,15 +833,17 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
             int dims = pl_tex_params_dimension(tex->params);
             pl_assert(format);
 
-            if (gpu->glsl.vulkan) {
+            // GLES can't change the binding of images (or storage buffers)
+            // after the fact, and also requires an explicit precision
+            if (gpu->glsl.vulkan || gpu->glsl.gles) {
                 ADD(glsl, "layout(binding=%d, %s) ", desc->binding, format);
             } else if (gpu->glsl.version >= 130) {
                 ADD(glsl, "layout(%s) ", format);
             }
-            ADD(glsl, "%s%s%s restrict uniform %s %s;\n", access,
+            ADD(glsl, "%s%s%s restrict uniform %s%s %s;\n", access,
                 (sd->memory & PL_MEMORY_COHERENT) ? " coherent" : "",
                 (sd->memory & PL_MEMORY_VOLATILE) ? " volatile" : "",
-                types[dims], desc->name);
+                gpu->glsl.gles ? "highp " : "", types[dims], desc->name);
             break;
         }
 
@@ -480,7 +858,7 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
             break;
 
         case PL_DESC_BUF_STORAGE:
-            if (gpu->glsl.vulkan) {
+            if (gpu->glsl.vulkan || gpu->glsl.gles) {
                 ADD(glsl, "layout(std430, binding=%d) ", desc->binding);
             } else if (gpu->glsl.version >= 140) {
                 ADD(glsl, "layout(std430) ");
@@ -522,10 +900,16 @@ static void generate_shaders(struct pl_dispatch *dp, struct pass *pass,
     for (int i = 0; i < res->num_variables; i++) {
         const struct pl_var *var = &res->variables[i].var;
         const struct pass_var *pv = &pass->vars[i];
-        if (pv->type != PASS_VAR_GLOBAL)
-            continue;
-        ADD(glsl, "uniform ");
-        add_var(dp, glsl, var);
+        switch (pv->type) {
+        case PASS_VAR_GLOBAL:
+            ADD(glsl, "uniform ");
+            add_var(dp, glsl, var);
+            break;
+        case PASS_VAR_CONST:
+            add_spec_const(dp, glsl, var, pv->index);
+            break;
+        default: break;
+        }
     }
 
     // Set up the main shader body
@@ -564,40 +948,291 @@ static bool blend_equal(const struct pl_blend_params *a,
            a->src_alpha == b->src_alpha && a->dst_alpha == b->dst_alpha;
 }
 
-static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
-                              const struct pl_tex *target, ident_t vert_pos,
-                              const struct pl_blend_params *blend, bool load)
+static void *compile_thread(void *arg)
 {
-    uint64_t sig = pl_shader_signature(sh);
+    struct pl_dispatch *dp = arg;
 
-    for (int i = 0; i < dp->num_passes; i++) {
-        struct pass *p = dp->passes[i];
-        if (p->signature != sig)
+    pthread_mutex_lock(&dp->lock);
+    while (!dp->quit) {
+        if (!dp->num_queue) {
+            pthread_cond_wait(&dp->wakeup, &dp->lock);
             continue;
+        }
 
-        // Failed shader, no additional checks needed
-        if (!p->pass)
-            return p;
+        struct pass *pass = dp->queue[0];
+        TARRAY_REMOVE_AT(dp->queue, dp->num_queue, 0);
+        pthread_mutex_unlock(&dp->lock);
 
-        if (pl_shader_is_compute(sh)) {
-            // no special requirements besides the signature
-            return p;
-        } else {
-            pl_assert(target);
-            const struct pl_fmt *tfmt;
-            tfmt = p->pass->params.target_dummy.params.format;
-            bool raster_ok = target->params.format == tfmt;
-            raster_ok &= blend_equal(p->pass->params.blend_params, blend);
-            raster_ok &= load == p->pass->params.load_target;
-            if (raster_ok)
+        uint64_t start = pl_trace_begin(dp->ctx);
+        const struct pl_pass *res = pl_pass_create(dp->gpu, pass->async_params);
+        pl_trace_end(dp->ctx, "dispatch", "compile", start);
+
+        pthread_mutex_lock(&dp->lock);
+        pass->async_res = res;
+        pass->async_done = true;
+        pthread_cond_broadcast(&dp->done);
+    }
+
+    pthread_mutex_unlock(&dp->lock);
+    return NULL;
+}
+
+// Makes sure at least `num` compile threads are running. Returns false if not
+// even a single compile thread could be started.
+static bool start_threads(struct pl_dispatch *dp, int num)
+{
+    while (dp->num_threads < num) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, compile_thread, dp) != 0) {
+            PL_WARN(dp, "Failed creating compile thread!");
+            break;
+        }
+
+        TARRAY_APPEND(dp, dp->threads, dp->num_threads, thread);
+    }
+
+    return dp->num_threads > 0;
+}
+
+// Queues up a pass for asynchronous compilation. Returns false if this is not
+// possible, in which case the caller should compile the pass synchronously.
+static bool queue_pass(struct pl_dispatch *dp, struct pass *pass,
+                       const struct pl_pass_params *params)
+{
+    if (!start_threads(dp, 1)) {
+        PL_WARN(dp, "Disabling asynchronous compilation!");
+        dp->async = false;
+        return false;
+    }
+
+    // The compile thread needs its own copy of the pass params, since the
+    // originals reference temporary state. Also make sure to avoid touching
+    // `dp` itself from the other thread.
+    struct pl_pass_params *async_params = talloc_ptrtype(pass, async_params);
+    *async_params = pl_pass_params_copy(async_params, params);
+    if (params->cached_program_len) {
+        async_params->cached_program = talloc_memdup(async_params,
+                params->cached_program, params->cached_program_len);
+        async_params->cached_program_len = params->cached_program_len;
+    }
+
+    pass->async_params = async_params;
+    pass->pending = true;
+
+    pthread_mutex_lock(&dp->lock);
+    TARRAY_APPEND(dp, dp->queue, dp->num_queue, pass);
+    pthread_cond_signal(&dp->wakeup);
+    pthread_mutex_unlock(&dp->lock);
+    return true;
+}
+
+// Checks whether a pending pass has finished compiling. Returns true if the
+// pass is ready (or failed), false if it's still pending.
+static bool poll_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (!pass->pending)
+        return true;
+
+    pthread_mutex_lock(&dp->lock);
+    bool done = pass->async_done;
+    pthread_mutex_unlock(&dp->lock);
+    if (!done)
+        return false;
+
+    pass->pass = pass->run_params.pass = pass->async_res;
+    pass->async_res = NULL;
+    pass->pending = false;
+    TA_FREEP(&pass->async_params);
+
+    if (!pass->pass) {
+        PL_ERR(dp, "Failed creating render pass for dispatch");
+        pass->failed = true;
+    } else {
+        PL_TRACE(dp, "Pass 0x%llx finished compiling",
+                 (unsigned long long) pass->signature);
+    }
+
+    return true;
+}
+
+// Like `poll_pass`, but unless asynchronous compilation is enabled, blocks
+// until the pass is done instead (e.g. for passes queued by a warm-up session)
+static bool ready_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (pass->pending && !dp->async) {
+        pthread_mutex_lock(&dp->lock);
+        while (!pass->async_done)
+            pthread_cond_wait(&dp->done, &dp->lock);
+        pthread_mutex_unlock(&dp->lock);
+    }
+
+    return poll_pass(dp, pass);
+}
+
+void pl_dispatch_set_async(struct pl_dispatch *dp, bool async)
+{
+    if (async && !(dp->gpu->caps & PL_GPU_CAP_THREAD_SAFE)) {
+        if (!dp->async) {
+            PL_DEBUG(dp, "GPU is not thread-safe, asynchronous compilation "
+                     "unavailable!");
+        }
+        async = false;
+    }
+
+    dp->async = async;
+}
+
+void pl_dispatch_set_reduced_precision(struct pl_dispatch *dp, bool enable)
+{
+    dp->reduced_precision = enable;
+}
+
+void pl_dispatch_set_specialize_constants(struct pl_dispatch *dp, bool enable)
+{
+    dp->specialize_constants = enable;
+}
+
+void pl_dispatch_set_prefer_compute(struct pl_dispatch *dp, bool enable)
+{
+    dp->prefer_compute = enable;
+}
+
+void pl_dispatch_set_autotune(struct pl_dispatch *dp, bool enable)
+{
+    dp->autotune = enable;
+}
+
+int pl_dispatch_skipped(struct pl_dispatch *dp)
+{
+    int num = dp->num_skipped;
+    dp->num_skipped = 0;
+    return num;
+}
+
+void pl_dispatch_stats(const struct pl_dispatch *dp, struct pl_dispatch_stats *out)
+{
+    *out = dp->stats;
+}
+
+static uint64_t pass_key(uint64_t sig, bool is_compute,
+                         const struct pl_tex *target,
+                         const struct pl_blend_params *blend, bool load)
+{
+    // Compute passes don't depend on any of the raster state
+    if (is_compute)
+        return sig;
+
+    struct {
+        uint64_t sig;
+        uintptr_t fmt;
+        int blend[4];
+        bool has_blend;
+        bool load;
+    } key;
+
+    memset(&key, 0, sizeof(key)); // make sure the padding is zero'd
+    key.sig = sig;
+    key.fmt = (uintptr_t) target->params.format;
+    key.has_blend = !!blend;
+    key.load = load;
+    if (blend) {
+        key.blend[0] = blend->src_rgb;
+        key.blend[1] = blend->dst_rgb;
+        key.blend[2] = blend->src_alpha;
+        key.blend[3] = blend->dst_alpha;
+    }
+
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
+static bool pass_matches(const struct pass *p, uint64_t sig, bool is_compute,
+                         const struct pl_tex *target,
+                         const struct pl_blend_params *blend, bool load)
+{
+    if (p->signature != sig || p->is_compute != is_compute)
+        return false;
+
+    // no special requirements besides the signature
+    if (is_compute)
+        return true;
+
+    pl_assert(target);
+    return target->params.format == p->target_fmt &&
+           blend_equal(p->has_blend ? &p->blend : NULL, blend) &&
+           load == p->load;
+}
+
+// Hashes the parts of a user-provided vertex layout which affect the pass
+static uint64_t vertex_layout_hash(const struct pl_dispatch_vertex_params *vp)
+{
+    uint64_t head[3] = {
+        vp->vertex_stride, vp->vertex_type, vp->vertex_position_idx,
+    };
+
+    uint64_t hash = siphash64((const uint8_t *) head, sizeof(head));
+
+    for (int i = 0; i < vp->num_vertex_attribs; i++) {
+        const struct pl_vertex_attrib *va = &vp->vertex_attribs[i];
+        uint64_t data[5] = {
+            hash, va->offset, va->fmt->type, va->fmt->num_components,
+            va->fmt->texel_size,
+        };
+        hash = siphash64((const uint8_t *) data, sizeof(data));
+    }
+
+    return hash;
+}
+
+// If `vparams` is set, the pass uses the given vertex layout instead of the
+// single quad generated by `pl_dispatch_finish`
+static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
+                              const struct pl_tex *target, ident_t vert_pos,
+                              const struct pl_blend_params *blend, bool load,
+                              const struct pl_dispatch_vertex_params *vparams)
+{
+    uint64_t sig = pl_shader_signature(sh);
+    if (vparams)
+        sig ^= vertex_layout_hash(vparams);
+    bool is_compute = pl_shader_is_compute(sh);
+    if (is_compute) {
+        // The work group size is not part of the signature, but may vary
+        // for the same shader (see `autotune_flexible`)
+        uint64_t data[3] = {
+            sig, sh->res.compute_group_size[0], sh->res.compute_group_size[1],
+        };
+        sig = siphash64((const uint8_t *) data, sizeof(data));
+    }
+    uint64_t consts = constants_hash(dp, sh);
+    uint64_t key = pass_key(sig, is_compute, target, blend, load) ^ consts;
+
+    if (dp->num_buckets) {
+        struct pass *p = dp->buckets[key & (dp->num_buckets - 1)];
+        for (; p; p = p->next) {
+            if (p->key == key && p->constants == consts &&
+                pass_matches(p, sig, is_compute, target, blend, load))
+            {
+                p->last_use = dp->use_count++;
+                dp->stats.cache_hits++;
                 return p;
+            }
         }
     }
 
+    dp->stats.cache_misses++;
     void *tmp = talloc_new(NULL); // for resources attached to `params`
 
     struct pass *pass = talloc_zero(dp, struct pass);
     pass->signature = sig;
+    pass->key = key;
+    pass->constants = consts;
+    pass->last_use = dp->use_count++;
+    pass->is_compute = is_compute;
+    pass->load = load;
+    pass->target_fmt = target ? target->params.format : NULL;
+    if (blend) {
+        pass->blend = *blend;
+        pass->has_blend = true;
+    }
     pass->ubo_desc = (struct pl_shader_desc) {
         .desc = {
             .name = "UBO",
@@ -609,7 +1244,7 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
 
     struct pl_pass_run_params *rparams = &pass->run_params;
     struct pl_pass_params params = {
-        .type = pl_shader_is_compute(sh) ? PL_PASS_COMPUTE : PL_PASS_RASTER,
+        .type = is_compute ? PL_PASS_COMPUTE : PL_PASS_RASTER,
         .num_descriptors = res->num_descriptors,
         .blend_params = blend, // set this for all pass types (for caching)
     };
@@ -634,9 +1269,11 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
             va->name = talloc_asprintf(tmp, "vert%s", va->name);
 
             // Place the vertex attribute
-            va->offset = params.vertex_stride;
             va->location = va_loc;
-            params.vertex_stride += va->fmt->texel_size;
+            if (!vparams) {
+                va->offset = params.vertex_stride;
+                params.vertex_stride += va->fmt->texel_size;
+            }
 
             // The number of vertex attribute locations consumed by a vertex
             // attribute is the number of vec4s it consumes, rounded up
@@ -644,11 +1281,17 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
             va_loc += (va->fmt->texel_size + va_loc_size - 1) / va_loc_size;
         }
 
-        // Generate the vertex array placeholder
-        params.vertex_type = PL_PRIM_TRIANGLE_STRIP;
-        rparams->vertex_count = 4; // single quad
-        size_t vert_size = rparams->vertex_count * params.vertex_stride;
-        rparams->vertex_data = talloc_zero_size(pass, vert_size);
+        if (vparams) {
+            // The vertex data itself is provided by every dispatch
+            params.vertex_type = vparams->vertex_type;
+            params.vertex_stride = vparams->vertex_stride;
+        } else {
+            // Generate the vertex array placeholder
+            params.vertex_type = PL_PRIM_TRIANGLE_STRIP;
+            rparams->vertex_count = 4; // single quad
+            size_t vert_size = rparams->vertex_count * params.vertex_stride;
+            rparams->vertex_data = talloc_zero_size(pass, vert_size);
+        }
     }
 
     // Place all the variables; these will dynamically end up in different
@@ -656,33 +1299,50 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
     //
     // We go through the list twice, once to place stuff that we definitely
     // want inside PCs, and then a second time to opportunistically place the rest.
+    // Both times, the variables are visited in order of placement priority
+    // (see `cmp_var_priority`) rather than declaration order.
+    const struct pl_shader_var **sorted_vars = NULL;
+    TARRAY_RESIZE(tmp, sorted_vars, res->num_variables);
+    for (int i = 0; i < res->num_variables; i++)
+        sorted_vars[i] = &sh->variables[i];
+    qsort(sorted_vars, res->num_variables, sizeof(sorted_vars[0]),
+          cmp_var_priority);
+
     pass->vars = talloc_zero_array(pass, struct pass_var, res->num_variables);
     for (int i = 0; i < res->num_variables; i++) {
-        if (!add_pass_var(dp, tmp, pass, &params, &sh->variables[i], &pass->vars[i], false))
+        const struct pl_shader_var *sv = sorted_vars[i];
+        struct pass_var *pv = &pass->vars[sv - sh->variables];
+        if (!add_pass_var(dp, tmp, pass, &params, sv, pv, false))
             goto error;
     }
 
     for (int i = 0; i < res->num_variables; i++) {
-        if (!add_pass_var(dp, tmp, pass, &params, &sh->variables[i], &pass->vars[i], true))
+        const struct pl_shader_var *sv = sorted_vars[i];
+        struct pass_var *pv = &pass->vars[sv - sh->variables];
+        if (!add_pass_var(dp, tmp, pass, &params, sv, pv, true))
             goto error;
     }
 
-    // Create and attach the UBO if necessary
-    int ubo_index = -1;
-    size_t ubo_size = sh_buf_desc_size(&pass->ubo_desc);
-    if (ubo_size) {
-        pass->ubo = pl_buf_create(dp->gpu, &(struct pl_buf_params) {
-            .type = PL_BUF_UNIFORM,
-            .size = ubo_size,
-            .host_writable = true,
-        });
+    // Create and attach the UBO if necessary. Prefer sub-allocating from the
+    // UBO ring, and only fall back to a dedicated buffer if that's impossible
+    pass->ubo_index = -1;
+    pass->ubo_size = sh_buf_desc_size(&pass->ubo_desc);
+    if (pass->ubo_size) {
+        if (!ubo_ring_usable(dp, pass->ubo_size)) {
+            pass->ubo = pl_buf_create(dp->gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_UNIFORM,
+                .size = pass->ubo_size,
+                .host_writable = true,
+            });
 
-        if (!pass->ubo) {
-            PL_ERR(dp, "Failed creating uniform buffer for dispatch");
-            goto error;
+            if (!pass->ubo) {
+                PL_ERR(dp, "Failed creating uniform buffer for dispatch");
+                goto error;
+            }
         }
 
-        ubo_index = res->num_descriptors;
+        pass->ubo_index = res->num_descriptors;
+        pass->ubo_data = talloc_zero_size(pass, pass->ubo_size);
         pass->ubo_desc.object = pass->ubo;
         sh_desc(sh, pass->ubo_desc);
     }
@@ -701,17 +1361,52 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
 
     // Pre-fill the desc_binding for the UBO
     if (pass->ubo) {
-        pl_assert(ubo_index >= 0);
-        rparams->desc_bindings[ubo_index].object = pass->ubo;
+        pl_assert(pass->ubo_index >= 0);
+        rparams->desc_bindings[pass->ubo_index].object = pass->ubo;
     }
 
     // Create the push constants region
     params.push_constants_size = PL_ALIGN2(params.push_constants_size, 4);
     rparams->push_constants = talloc_zero_size(pass, params.push_constants_size);
 
+    // Re-use a previously loaded program, if available
+    for (int i = 0; i < dp->num_cached_passes; i++) {
+        const struct cached_pass *c = &dp->cached_passes[i];
+        if (c->signature == sig) {
+            params.cached_program = c->cached_program;
+            params.cached_program_len = c->cached_program_len;
+            break;
+        }
+    }
+
+    // Passes which only differ in the values of their specialization
+    // constants share the same shader text, so the compiled program of any
+    // such pass can be re-used as well
+    for (int i = 0; params.num_constants && !params.cached_program_len &&
+                    i < dp->num_passes; i++)
+    {
+        const struct pass *p = dp->passes[i];
+        if (p->signature == sig && p->is_compute == is_compute && p->pass) {
+            params.cached_program = p->pass->params.cached_program;
+            params.cached_program_len = p->pass->params.cached_program_len;
+        }
+    }
+
+    if (params.cached_program_len)
+        dp->stats.programs_reused++;
+
     // Finally, finalize the shaders and create the pass itself
     generate_shaders(dp, pass, &params, sh, vert_pos, tmp);
+    bool async = dp->warmup ? dp->num_threads > 0 : dp->async;
+    if (async && queue_pass(dp, pass, &params)) {
+        PL_TRACE(dp, "Compiling pass 0x%llx asynchronously",
+                 (unsigned long long) sig);
+        goto error;
+    }
+
+    uint64_t start = pl_trace_begin(dp->ctx);
     pass->pass = rparams->pass = pl_pass_create(dp->gpu, &params);
+    pl_trace_end(dp->ctx, "dispatch", "compile", start);
     if (!pass->pass) {
         PL_ERR(dp, "Failed creating render pass for dispatch");
         goto error;
@@ -719,54 +1414,151 @@ static struct pass *find_pass(struct pl_dispatch *dp, struct pl_shader *sh,
 
     // fall through
 error:
+    pass->failed = !pass->pass && !pass->pending;
     pass->ubo_desc = (struct pl_shader_desc) {0}; // contains temporary pointers
     talloc_free(tmp);
-    TARRAY_APPEND(dp, dp->passes, dp->num_passes, pass);
+    insert_pass(dp, pass);
     return pass;
 }
 
-static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
-                            const struct pl_shader_var *sv, struct pass_var *pv)
+// Linearly sub-allocates `size` bytes from the UBO ring. When the current
+// buffer is exhausted, this moves on to the next one, provided the GPU is done
+// using it - otherwise, a new buffer is inserted into the ring in its place.
+static bool ubo_alloc(struct pl_dispatch *dp, size_t size,
+                      const struct pl_buf **out_buf, size_t *out_offset)
 {
-    struct pl_var_layout host_layout = pl_var_host_layout(0, &sv->var);
-    pl_assert(host_layout.size);
+    const struct pl_gpu *gpu = dp->gpu;
+    size_t chunk_size = ubo_chunk_size(gpu);
+    size_t pos = PL_ALIGN(dp->ubo_pos, gpu->limits.align_ubo_offset);
+    pl_assert(size <= chunk_size);
+
+    if (!dp->num_ubo_ring || pos + size > chunk_size) {
+        int next = dp->num_ubo_ring ? (dp->ubo_idx + 1) % dp->num_ubo_ring : 0;
+        bool busy = !dp->num_ubo_ring ||
+                    pl_buf_poll(gpu, dp->ubo_ring[next], 0);
+
+        if (busy && dp->num_ubo_ring < MAX_UBO_CHUNKS) {
+            const struct pl_buf *buf = pl_buf_create(gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_UNIFORM,
+                .size = chunk_size,
+                .host_mapped = true,
+            });
 
-    // Use the cache to skip updates if possible
-    if (pv->cached_data && !memcmp(sv->data, pv->cached_data, host_layout.size))
-        return;
-    if (!pv->cached_data)
-        pv->cached_data = talloc_size(pass, host_layout.size);
-    memcpy(pv->cached_data, sv->data, host_layout.size);
+            if (!buf) {
+                PL_WARN(dp, "Failed creating mapped uniform buffer, falling "
+                        "back to per-pass uniform buffers");
+                dp->ubo_ring_failed = true;
+                return false;
+            }
 
-    struct pl_pass_run_params *rparams = &pass->run_params;
-    switch (pv->type) {
-    case PASS_VAR_NONE:
-        abort();
-    case PASS_VAR_GLOBAL: {
-        struct pl_var_update vu = {
-            .index = pv->index,
-            .data  = sv->data,
-        };
-        TARRAY_APPEND(pass, rparams->var_updates, rparams->num_var_updates, vu);
-        break;
-    }
-    case PASS_VAR_UBO: {
-        pl_assert(pass->ubo);
-        uintptr_t src = (uintptr_t) sv->data;
-        uintptr_t end = src + (ptrdiff_t) host_layout.size;
-        size_t dst = pv->layout.offset;
-        while (src < end) {
-            pl_buf_write(dp->gpu, pass->ubo, dst, (void *) src, host_layout.stride);
-            src += host_layout.stride;
-            dst += pv->layout.stride;
+            PL_DEBUG(dp, "Growing UBO ring to %d buffers", dp->num_ubo_ring + 1);
+            TARRAY_INSERT_AT(dp, dp->ubo_ring, dp->num_ubo_ring, next, buf);
+        } else if (busy) {
+            // Ring is at its maximum size, so we have no choice but to block
+            while (pl_buf_poll(gpu, dp->ubo_ring[next], UINT64_MAX))
+                ; // do nothing
         }
-        break;
+
+        dp->ubo_idx = next;
+        pos = 0;
     }
-    case PASS_VAR_PUSHC:
-        pl_assert(rparams->push_constants);
-        memcpy_layout(rparams->push_constants, pv->layout, sv->data, host_layout);
-        break;
-    };
+
+    *out_buf = dp->ubo_ring[dp->ubo_idx];
+    *out_offset = pos;
+    dp->ubo_pos = pos + size;
+    return true;
+}
+
+// Uploads the staged uniform buffer contents for this dispatch
+static bool update_pass_ubo(struct pl_dispatch *dp, struct pass *pass)
+{
+    if (!pass->ubo_size)
+        return true;
+
+    if (!pass->ubo && !ubo_ring_usable(dp, pass->ubo_size)) {
+        // The UBO ring failed after this pass was created, so switch this
+        // pass over to a dedicated buffer
+        pass->ubo = pl_buf_create(dp->gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_UNIFORM,
+            .size = pass->ubo_size,
+            .host_writable = true,
+        });
+
+        if (!pass->ubo) {
+            PL_ERR(dp, "Failed creating uniform buffer for dispatch");
+            return false;
+        }
+
+        pass->ubo_dirty = true;
+    }
+
+    struct pl_desc_binding *db = &pass->run_params.desc_bindings[pass->ubo_index];
+    if (pass->ubo) {
+        if (pass->ubo_dirty) {
+            pl_buf_write(dp->gpu, pass->ubo, 0, pass->ubo_data, pass->ubo_size);
+            dp->stats.ubo_updates++;
+        }
+        *db = (struct pl_desc_binding) { .object = pass->ubo };
+        pass->ubo_dirty = false;
+        return true;
+    }
+
+    const struct pl_buf *buf;
+    size_t offset;
+    if (!ubo_alloc(dp, pass->ubo_size, &buf, &offset))
+        return update_pass_ubo(dp, pass); // retry with the fallback path
+
+    memcpy(buf->data + offset, pass->ubo_data, pass->ubo_size);
+    dp->stats.ubo_updates++;
+    *db = (struct pl_desc_binding) {
+        .object = buf,
+        .offset = offset,
+    };
+
+    return true;
+}
+
+static void update_pass_var(struct pl_dispatch *dp, struct pass *pass,
+                            const struct pl_shader_var *sv, struct pass_var *pv)
+{
+    // Specialization constants are part of the pass itself (see `find_pass`)
+    if (pv->type == PASS_VAR_CONST)
+        return;
+
+    struct pl_var_layout host_layout = pl_var_host_layout(0, &sv->var);
+    pl_assert(host_layout.size);
+
+    // Use the cache to skip updates if possible
+    if (pv->cached_data && !memcmp(sv->data, pv->cached_data, host_layout.size))
+        return;
+    if (!pv->cached_data)
+        pv->cached_data = talloc_size(pass, host_layout.size);
+    memcpy(pv->cached_data, sv->data, host_layout.size);
+
+    struct pl_pass_run_params *rparams = &pass->run_params;
+    switch (pv->type) {
+    case PASS_VAR_NONE:
+        abort();
+    case PASS_VAR_GLOBAL: {
+        struct pl_var_update vu = {
+            .index = pv->index,
+            .data  = sv->data,
+        };
+        TARRAY_APPEND(pass, rparams->var_updates, rparams->num_var_updates, vu);
+        break;
+    }
+    case PASS_VAR_UBO:
+        pl_assert(pass->ubo_data);
+        memcpy_layout(pass->ubo_data, pv->layout, sv->data, host_layout);
+        pass->ubo_dirty = true;
+        break;
+    case PASS_VAR_PUSHC:
+        pl_assert(rparams->push_constants);
+        memcpy_layout(rparams->push_constants, pv->layout, sv->data, host_layout);
+        break;
+    case PASS_VAR_CONST:
+        abort();
+    };
 }
 
 static void compute_vertex_attribs(struct pl_dispatch *dp, struct pl_shader *sh,
@@ -779,8 +1571,11 @@ static void compute_vertex_attribs(struct pl_dispatch *dp, struct pl_shader *sh,
         .dynamic = true,
     });
 
+    // `frag_valid` tells apart the excess invocations of work groups which
+    // extend past the edge of the rendering area
     GLSLP("#define frag_pos(id) (vec2(id) + vec2(0.5)) \n"
           "#define frag_map(id) (%s * frag_pos(id))    \n"
+          "#define frag_valid(id) (max(frag_map(id).x, frag_map(id).y) < 1.0) \n"
           "#define gl_FragCoord vec4(frag_pos(gl_GlobalInvocationID), 0.0, 1.0) \n",
           *out_scale);
 
@@ -866,7 +1661,271 @@ static void translate_compute_shader(struct pl_dispatch *dp,
     sh->res.output = PL_SHADER_SIG_NONE;
 }
 
-bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params *params)
+// Places the vertex attributes of `sh` sequentially, and describes the
+// resulting layout in `vp`, for drawing multiple sub-rects as a triangle list
+static void place_rect_attribs(struct pl_shader *sh, ident_t vert_pos,
+                               struct pl_dispatch_vertex_params *vp)
+{
+    const struct pl_shader_res *res = &sh->res;
+    struct pl_vertex_attrib *attribs;
+    attribs = talloc_array(sh, struct pl_vertex_attrib, res->num_vertex_attribs);
+
+    *vp = (struct pl_dispatch_vertex_params) {
+        .vertex_attribs = attribs,
+        .num_vertex_attribs = res->num_vertex_attribs,
+        .vertex_type = PL_PRIM_TRIANGLE_LIST,
+    };
+
+    for (int i = 0; i < res->num_vertex_attribs; i++) {
+        struct pl_vertex_attrib *va = &sh->vertex_attribs[i].attr;
+        va->offset = vp->vertex_stride;
+        vp->vertex_stride += va->fmt->texel_size;
+        if (va->name == vert_pos)
+            vp->vertex_position_idx = i;
+        attribs[i] = *va;
+    }
+}
+
+// Generates two triangles per sub-rect of `rc`, bilinearly interpolating the
+// corner values of every vertex attribute
+static void fill_rect_verts(const struct pl_shader *sh, const struct pl_rect2d *rc,
+                            const struct pl_rect2d *rects, int num_rects,
+                            size_t stride, uint8_t *out)
+{
+    static const int corners[6][2] = {
+        {0, 0}, {1, 0}, {0, 1},
+        {0, 1}, {1, 0}, {1, 1},
+    };
+
+    float w = pl_rect_w(*rc), h = pl_rect_h(*rc);
+    for (int r = 0; r < num_rects; r++) {
+        const struct pl_rect2d *sub = &rects[r];
+        float u[2] = { (sub->x0 - rc->x0) / w, (sub->x1 - rc->x0) / w };
+        float v[2] = { (sub->y0 - rc->y0) / h, (sub->y1 - rc->y0) / h };
+
+        for (int n = 0; n < PL_ARRAY_SIZE(corners); n++) {
+            float fu = u[corners[n][0]], fv = v[corners[n][1]];
+            for (int i = 0; i < sh->res.num_vertex_attribs; i++) {
+                const struct pl_shader_va *sva = &sh->vertex_attribs[i];
+                const float *p[4] = {
+                    sva->data[0], sva->data[1], sva->data[2], sva->data[3],
+                };
+
+                float val[4];
+                int comps = sva->attr.fmt->num_components;
+                for (int c = 0; c < comps; c++) {
+                    float top = p[0][c] + (p[1][c] - p[0][c]) * fu;
+                    float bot = p[2][c] + (p[3][c] - p[2][c]) * fu;
+                    val[c] = top + (bot - top) * fv;
+                }
+
+                memcpy(out + sva->attr.offset, val, comps * sizeof(float));
+            }
+            out += stride;
+        }
+    }
+}
+
+static bool tune_size_valid(const struct pl_gpu *gpu, const int size[2])
+{
+    return size[0] > 0 && size[1] > 0 &&
+           size[0] <= gpu->limits.max_group_size[0] &&
+           size[1] <= gpu->limits.max_group_size[1] &&
+           size[0] * size[1] <= gpu->limits.max_group_threads;
+}
+
+static void link_tuned(struct pl_dispatch *dp, struct tuned_shader *t)
+{
+    struct tuned_shader **head;
+    head = &dp->tuned_buckets[t->key & (dp->num_tuned_buckets - 1)];
+    t->next = *head;
+    *head = t;
+}
+
+static struct tuned_shader *find_tuned(struct pl_dispatch *dp, uint64_t key)
+{
+    if (!dp->num_tuned_buckets)
+        return NULL;
+
+    struct tuned_shader *t;
+    t = dp->tuned_buckets[key & (dp->num_tuned_buckets - 1)];
+    while (t && t->key != key)
+        t = t->next;
+    return t;
+}
+
+static struct tuned_shader *insert_tuned(struct pl_dispatch *dp, uint64_t key)
+{
+    struct tuned_shader *t = find_tuned(dp, key);
+    if (t)
+        return t;
+
+    t = talloc_zero(dp, struct tuned_shader);
+    t->key = key;
+    TARRAY_APPEND(dp, dp->tuned, dp->num_tuned, t);
+
+    // Keep the load factor at or below 1, same as for the pass cache
+    if (dp->num_tuned > dp->num_tuned_buckets) {
+        int num_buckets = PL_MAX(dp->num_tuned_buckets * 2, 16);
+        TARRAY_RESIZE(dp, dp->tuned_buckets, num_buckets);
+        memset(dp->tuned_buckets, 0, num_buckets * sizeof(*dp->tuned_buckets));
+        dp->num_tuned_buckets = num_buckets;
+        for (int i = 0; i < dp->num_tuned; i++)
+            link_tuned(dp, dp->tuned[i]);
+    } else {
+        link_tuned(dp, t);
+    }
+
+    return t;
+}
+
+// Sets the candidate sizes of a new entry, skipping invalid and duplicate ones
+static void tune_set_sizes(struct pl_dispatch *dp, struct tuned_shader *t,
+                           const int (*sizes)[2], int num_sizes)
+{
+    if (t->num_sizes)
+        return;
+
+    for (int i = 0; i < num_sizes && t->num_sizes < TUNE_MAX_CANDIDATES; i++) {
+        if (!tune_size_valid(dp->gpu, sizes[i]))
+            continue;
+
+        bool dupe = false;
+        for (int j = 0; j < t->num_sizes; j++) {
+            dupe |= t->sizes[j][0] == sizes[i][0] &&
+                    t->sizes[j][1] == sizes[i][1];
+        }
+
+        if (!dupe) {
+            t->sizes[t->num_sizes][0] = sizes[i][0];
+            t->sizes[t->num_sizes][1] = sizes[i][1];
+            t->num_sizes++;
+        }
+    }
+}
+
+static void tune_finish(struct pl_dispatch *dp, struct tuned_shader *t)
+{
+    int best = -1;
+    for (int i = 0; i < t->num_sizes; i++) {
+        if (t->results[i] && (best < 0 || t->best_ns[i] < t->best_ns[best]))
+            best = i;
+    }
+
+    tuned_shader_uninit(dp, t);
+    t->done = true;
+    if (best < 0) {
+        PL_DEBUG(dp, "Failed measuring any work group sizes for shader "
+                 "0x%"PRIx64", keeping the default", t->key);
+        return;
+    }
+
+    t->size[0] = t->sizes[best][0];
+    t->size[1] = t->sizes[best][1];
+    PL_DEBUG(dp, "Tuned work group size for shader 0x%"PRIx64": %dx%d "
+             "(%.3f us)", t->key, t->size[0], t->size[1],
+             t->best_ns[best] / 1e3);
+}
+
+// Collects the timer results measured so far, and returns the index of the
+// candidate size to try next, or -1 once tuning is done
+static int tune_next(struct pl_dispatch *dp, struct tuned_shader *t)
+{
+    if (t->done)
+        return -1;
+
+    int next = -1;
+    for (int i = 0; i < t->num_sizes; i++) {
+        uint64_t ns;
+        while ((ns = pl_timer_query(dp->gpu, t->timers[i]))) {
+            t->best_ns[i] = t->results[i] ? PL_MIN(t->best_ns[i], ns) : ns;
+            t->results[i]++;
+        }
+
+        if (t->results[i] >= TUNE_RUNS || t->submits[i] >= TUNE_MAX_SUBMITS)
+            continue;
+        if (next < 0 || t->submits[i] < t->submits[next])
+            next = i;
+    }
+
+    if (next >= 0 && !t->timers[next])
+        t->timers[next] = pl_timer_create(dp->gpu);
+
+    if (next < 0 || !t->timers[next]) {
+        // Either done, or no timer support, so there's nothing to tune
+        tune_finish(dp, t);
+        return -1;
+    }
+
+    return next;
+}
+
+// Picks the size for the shader `sh` out of the tuning entry `t`, and records
+// the choice in the shader. Leaves `size` untouched if there is no preference.
+static void tune_pick(struct pl_dispatch *dp, struct pl_shader *sh,
+                      struct tuned_shader *t, int size[2])
+{
+    int idx = tune_next(dp, t);
+    const int *pick = idx >= 0 ? t->sizes[idx] : t->size;
+    if (pick[0]) {
+        size[0] = pick[0];
+        size[1] = pick[1];
+    }
+
+    sh->tune = (struct sh_tune) { .key = t->key, .candidate = idx };
+}
+
+// Overrides the work group size of a flexible compute shader with the tuned
+// one, or with the candidate size to measure next while still tuning
+static void autotune_flexible(struct pl_dispatch *dp, struct pl_shader *sh)
+{
+    int *size = sh->res.compute_group_size;
+    struct tuned_shader *t = insert_tuned(dp, pl_shader_signature(sh));
+    if (size[1] == 1) {
+        tune_set_sizes(dp, t, tune_sizes_1d, PL_ARRAY_SIZE(tune_sizes_1d));
+    } else {
+        tune_set_sizes(dp, t, tune_sizes_2d, PL_ARRAY_SIZE(tune_sizes_2d));
+    }
+
+    tune_pick(dp, sh, t, size);
+}
+
+void pl_dispatch_tune_size(struct pl_dispatch *dp, struct pl_shader *sh,
+                           uint64_t key, const int (*sizes)[2], int num_sizes,
+                           int out[2])
+{
+    out[0] = sizes[0][0];
+    out[1] = sizes[0][1];
+    if (!dp->autotune)
+        return;
+
+    struct tuned_shader *t = insert_tuned(dp, key);
+    tune_set_sizes(dp, t, sizes, num_sizes);
+    tune_pick(dp, sh, t, out);
+}
+
+// Returns the timer to measure the dispatch of `sh` with, if its work group
+// size is one of the candidates currently being tuned
+static struct pl_timer *tune_timer(struct pl_dispatch *dp,
+                                   const struct pl_shader *sh)
+{
+    if (!dp->autotune || !sh->tune.key || sh->tune.candidate < 0)
+        return NULL;
+
+    struct tuned_shader *t = find_tuned(dp, sh->tune.key);
+    int idx = sh->tune.candidate;
+    if (!t || t->done || !t->timers[idx])
+        return NULL;
+
+    t->submits[idx]++;
+    return t->timers[idx];
+}
+
+// If `out_pass` is set, this only looks up (or starts compiling) the pass,
+// without actually dispatching anything. See `pl_dispatch_warmup`.
+static bool dispatch_finish(struct pl_dispatch *dp,
+                            const struct pl_dispatch_params *params,
+                            struct pass **out_pass)
 {
     struct pl_shader *sh = *params->shader;
     const struct pl_shader_res *res = &sh->res;
@@ -888,21 +1947,51 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params
     }
 
     const struct pl_tex_params *tpars = &params->target->params;
-    if (pl_tex_params_dimension(*tpars) != 2 || !tpars->renderable) {
+    if (pl_tex_params_dimension(*tpars) != 2 ||
+        !(tpars->renderable || tpars->storable))
+    {
         PL_ERR(dp, "Trying to dispatch a shader using an invalid target "
-               "texture. The target must be a renderable 2D texture.");
+               "texture. The target must be a renderable or storable 2D "
+               "texture.");
         goto error;
     }
 
-    if (pl_shader_is_compute(sh) && !tpars->storable) {
+    bool multi = params->num_rects > 0;
+    bool upgrade = !tpars->renderable || dp->prefer_compute ||
+                   (dp->gpu->caps & PL_GPU_CAP_PARALLEL_COMPUTE);
+
+    // Blending requires read-write access to the target image, which GLES
+    // only supports for single-channel 32-bit formats
+    if (params->blend_params && dp->gpu->glsl.gles && tpars->renderable)
+        upgrade = false;
+
+    if (pl_shader_is_compute(sh) && multi) {
+        PL_ERR(dp, "Trying to dispatch a compute shader using multiple "
+               "sub-rects. This requires a fragment shader.");
+        goto error;
+    } else if (pl_shader_is_compute(sh) && !tpars->storable) {
         PL_ERR(dp, "Trying to dispatch using a compute shader with a "
                "non-storable target texture.");
         goto error;
-    } else if (tpars->storable && (dp->gpu->caps & PL_GPU_CAP_PARALLEL_COMPUTE)) {
+    } else if (tpars->storable && upgrade && !multi) {
         if (sh_try_compute(sh, 16, 16, true, 0))
             PL_TRACE(dp, "Upgrading fragment shader to compute shader.");
     }
 
+    if (!pl_shader_is_compute(sh) && !tpars->renderable) {
+        PL_ERR(dp, "Trying to dispatch a fragment shader that can't be "
+               "turned into a compute shader to a non-renderable target.");
+        goto error;
+    }
+
+    struct pl_timer *timer = params->timer;
+    if (dp->autotune && pl_shader_is_compute(sh)) {
+        if (sh->flexible_work_groups)
+            autotune_flexible(dp, sh);
+        if (!timer && !out_pass)
+            timer = tune_timer(dp, sh);
+    }
+
     struct pl_rect2d rc = params->rect;
     if (!pl_rect_w(rc)) {
         rc.x0 = 0;
@@ -948,11 +2037,46 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params
     rc_norm.y1 = PL_MIN(rc_norm.y1, tpars->h);
     bool load = params->blend_params || !pl_rect2d_eq(rc_norm, full);
 
+    // Multiple sub-rects get drawn as a triangle list instead of the usual
+    // single quad, which never covers the entire target
+    struct pl_dispatch_vertex_params vparams;
+    if (multi) {
+        for (int i = 0; i < sh->res.num_vertex_attribs; i++) {
+            const struct pl_fmt *fmt = sh->vertex_attribs[i].attr.fmt;
+            if (fmt->type != PL_FMT_FLOAT ||
+                fmt->texel_size != fmt->num_components * sizeof(float))
+            {
+                PL_ERR(dp, "Trying to dispatch multiple sub-rects with "
+                       "non-float vertex attribute '%s'!",
+                       sh->vertex_attribs[i].attr.name);
+                goto error;
+            }
+        }
+
+        place_rect_attribs(sh, vert_pos, &vparams);
+        load = true;
+    }
+
     struct pass *pass = find_pass(dp, sh, params->target, vert_pos,
-                                  params->blend_params, load);
+                                  params->blend_params, load,
+                                  multi ? &vparams : NULL);
+
+    if (out_pass) {
+        *out_pass = pass;
+        ret = !pass->failed;
+        goto error;
+    }
+
+    // Skip passes which are still being compiled
+    if (!ready_pass(dp, pass)) {
+        dp->num_skipped++;
+        dp->stats.skipped++;
+        ret = true;
+        goto error;
+    }
 
     // Silently return on failed passes
-    if (!pass->pass)
+    if (pass->failed)
         goto error;
 
     struct pl_pass_run_params *rparams = &pass->run_params;
@@ -965,9 +2089,18 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params
     rparams->num_var_updates = 0;
     for (int i = 0; i < res->num_variables; i++)
         update_pass_var(dp, pass, &sh->variables[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
 
     // Update the vertex data
-    if (rparams->vertex_data) {
+    if (multi) {
+        rparams->vertex_count = 6 * params->num_rects;
+        size_t vert_size = rparams->vertex_count * vparams.vertex_stride;
+        rparams->vertex_data = talloc_realloc_size(pass, rparams->vertex_data,
+                                                   vert_size);
+        fill_rect_verts(sh, &rc, params->rects, params->num_rects,
+                        vparams.vertex_stride, rparams->vertex_data);
+    } else if (rparams->vertex_data) {
         uintptr_t vert_base = (uintptr_t) rparams->vertex_data;
         size_t stride = rparams->pass->params.vertex_stride;
         for (int i = 0; i < res->num_vertex_attribs; i++) {
@@ -999,10 +2132,18 @@ bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params
         rparams->scissors = rc_norm;
     }
 
+    // Compute shaders covering the entire target without blending overwrite
+    // all of its contents, so let the driver discard them. (Raster passes
+    // get this from `pl_pass_params.load_target` instead)
+    if (pl_shader_is_compute(sh) && !load)
+        pl_tex_invalidate(dp->gpu, params->target);
+
     // Dispatch the actual shader
     rparams->target = params->target;
-    rparams->timer = params->timer;
+    rparams->timer = timer;
+    rparams->async = params->async && pl_shader_is_compute(sh);
     pl_pass_run(dp->gpu, &pass->run_params);
+    dp->stats.dispatches++;
     ret = true;
 
 error:
@@ -1014,9 +2155,120 @@ error:
     return ret;
 }
 
+// Records a pass created during a warm-up session
+static void warmup_pass(struct pl_dispatch *dp, struct pass *pass)
+{
+    dp->num_warmed++;
+    if (pass->pending) {
+        TARRAY_APPEND(dp, dp->warmup_pending, dp->num_warmup_pending, pass);
+    } else if (pass->failed) {
+        dp->warmup_failed = true;
+    }
+}
+
+static bool dispatch_warmup(struct pl_dispatch *dp,
+                            const struct pl_dispatch_params *params)
+{
+    struct pass *pass = NULL;
+    bool ok = dispatch_finish(dp, params, &pass);
+    if (pass)
+        warmup_pass(dp, pass);
+    dp->warmup_failed |= !ok;
+    return ok;
+}
+
+bool pl_dispatch_finish(struct pl_dispatch *dp, const struct pl_dispatch_params *params)
+{
+    uint64_t start = pl_trace_begin(dp->ctx);
+    bool ret;
+    if (dp->warmup) {
+        ret = dispatch_warmup(dp, params);
+    } else {
+        ret = dispatch_finish(dp, params, NULL);
+    }
+    pl_trace_end(dp->ctx, "dispatch", "finish", start);
+    return ret;
+}
+
+void pl_dispatch_warmup_begin(struct pl_dispatch *dp, int num_threads)
+{
+    pl_assert(!dp->warmup);
+
+    // Queue up all passes on the compile threads (if possible), regardless
+    // of whether asynchronous compilation is otherwise enabled
+    if (dp->gpu->caps & PL_GPU_CAP_THREAD_SAFE)
+        start_threads(dp, PL_DEF(num_threads, 4));
+
+    dp->warmup = true;
+    dp->warmup_failed = false;
+    dp->num_warmed = 0;
+    dp->num_warmup_pending = 0;
+    dp->warmup_index = dp->current_index;
+}
+
+bool pl_dispatch_set_warmup(struct pl_dispatch *dp, bool enable)
+{
+    bool prev = dp->warmup;
+    dp->warmup = enable;
+    return prev;
+}
+
+int pl_dispatch_warmup_poll(struct pl_dispatch *dp)
+{
+    dp->warmup = false;
+    dp->current_index = dp->warmup_index;
+
+    int pending = 0;
+    for (int i = 0; i < dp->num_warmup_pending; i++)
+        pending += !poll_pass(dp, dp->warmup_pending[i]);
+
+    TA_FREEP(&dp->warmup_pending);
+    dp->num_warmup_pending = 0;
+    return pending;
+}
+
+bool pl_dispatch_warmup_end(struct pl_dispatch *dp)
+{
+    dp->warmup = false;
+    dp->current_index = dp->warmup_index;
+
+    // Pending passes are never evicted from the cache, so it's safe to hang
+    // on to them until they're done
+    pthread_mutex_lock(&dp->lock);
+    for (int i = 0; i < dp->num_warmup_pending; i++) {
+        while (!dp->warmup_pending[i]->async_done)
+            pthread_cond_wait(&dp->done, &dp->lock);
+    }
+    pthread_mutex_unlock(&dp->lock);
+
+    bool ret = !dp->warmup_failed;
+    for (int i = 0; i < dp->num_warmup_pending; i++) {
+        poll_pass(dp, dp->warmup_pending[i]);
+        ret &= !dp->warmup_pending[i]->failed;
+    }
+
+    PL_DEBUG(dp, "Warmed up %d passes, %d of which were compiled in parallel",
+             dp->num_warmed, dp->num_warmup_pending);
+
+    TA_FREEP(&dp->warmup_pending);
+    dp->num_warmup_pending = 0;
+    return ret;
+}
+
+bool pl_dispatch_warmup(struct pl_dispatch *dp,
+                        const struct pl_dispatch_params *params, int num_params,
+                        int num_threads)
+{
+    pl_dispatch_warmup_begin(dp, PL_MIN(PL_DEF(num_threads, 4), num_params));
+    for (int i = 0; i < num_params; i++)
+        dispatch_warmup(dp, &params[i]);
+    return pl_dispatch_warmup_end(dp);
+}
+
 bool pl_dispatch_compute(struct pl_dispatch *dp,
                          const struct pl_dispatch_compute_params *params)
 {
+    uint64_t start = pl_trace_begin(dp->ctx);
     struct pl_shader *sh = *params->shader;
     const struct pl_shader_res *res = &sh->res;
     bool ret = false;
@@ -1054,7 +2306,36 @@ bool pl_dispatch_compute(struct pl_dispatch *dp,
                                &(ident_t){0});
     }
 
-    struct pass *pass = find_pass(dp, sh, NULL, NULL, NULL, false);
+    // If the caller specified the effective size, flexible work groups can be
+    // tuned, with the dispatch size following the chosen work group size
+    int groups[3];
+    for (int i = 0; i < 3; i++) {
+        pl_assert(params->dispatch_size[i] > 0);
+        groups[i] = params->dispatch_size[i];
+    }
+
+    const int *gsize = sh->res.compute_group_size;
+    bool has_size = params->width && params->height;
+    if (dp->autotune && sh->flexible_work_groups && has_size) {
+        autotune_flexible(dp, sh);
+        groups[0] = (params->width + gsize[0] - 1) / gsize[0];
+        groups[1] = (params->height + gsize[1] - 1) / gsize[1];
+    }
+
+    struct pass *pass = find_pass(dp, sh, NULL, NULL, NULL, false, NULL);
+    if (dp->warmup) {
+        warmup_pass(dp, pass);
+        ret = !pass->failed;
+        goto error;
+    }
+
+    // Skip passes which are still being compiled
+    if (!ready_pass(dp, pass)) {
+        dp->num_skipped++;
+        dp->stats.skipped++;
+        ret = true;
+        goto error;
+    }
 
     // Silently return on failed passes
     if (pass->failed)
@@ -1070,16 +2351,182 @@ bool pl_dispatch_compute(struct pl_dispatch *dp,
     rparams->num_var_updates = 0;
     for (int i = 0; i < res->num_variables; i++)
         update_pass_var(dp, pass, &sh->variables[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
 
     // Update the dispatch size
-    for (int i = 0; i < 3; i++) {
-        pl_assert(params->dispatch_size[i] > 0);
-        rparams->compute_groups[i] = params->dispatch_size[i];
+    for (int i = 0; i < 3; i++)
+        rparams->compute_groups[i] = groups[i];
+
+    // Dispatch the actual shader
+    rparams->timer = PL_DEF(params->timer, tune_timer(dp, sh));
+    rparams->async = params->async;
+    pl_pass_run(dp->gpu, &pass->run_params);
+    dp->stats.dispatches++;
+    ret = true;
+
+error:
+    // Reset the temporary buffers which we use to build the shader
+    for (int i = 0; i < PL_ARRAY_SIZE(dp->tmp); i++)
+        dp->tmp[i].len = 0;
+
+    pl_dispatch_abort(dp, params->shader);
+    pl_trace_end(dp->ctx, "dispatch", "compute", start);
+    return ret;
+}
+
+bool pl_dispatch_vertex(struct pl_dispatch *dp,
+                        const struct pl_dispatch_vertex_params *params)
+{
+    uint64_t start = pl_trace_begin(dp->ctx);
+    struct pl_shader *sh = *params->shader;
+    const struct pl_shader_res *res = &sh->res;
+    bool ret = false;
+
+    if (sh->failed) {
+        PL_ERR(sh, "Trying to dispatch a failed shader.");
+        goto error;
+    }
+
+    if (!sh->mutable) {
+        PL_ERR(dp, "Trying to dispatch non-mutable shader?");
+        goto error;
+    }
+
+    if (res->input != PL_SHADER_SIG_NONE || res->output != PL_SHADER_SIG_COLOR) {
+        PL_ERR(dp, "Trying to dispatch shader with incompatible signature!");
+        goto error;
+    }
+
+    if (pl_shader_is_compute(sh)) {
+        PL_ERR(dp, "Trying to dispatch a compute shader using "
+               "`pl_dispatch_vertex`!");
+        goto error;
+    }
+
+    if (res->num_vertex_attribs) {
+        PL_ERR(dp, "Trying to dispatch a shader with its own vertex attributes "
+               "using `pl_dispatch_vertex`!");
+        goto error;
+    }
+
+    const struct pl_tex_params *tpars = &params->target->params;
+    if (pl_tex_params_dimension(*tpars) != 2 || !tpars->renderable) {
+        PL_ERR(dp, "Trying to dispatch a shader using an invalid target "
+               "texture. The target must be a renderable 2D texture.");
+        goto error;
+    }
+
+    int pos_idx = params->vertex_position_idx;
+    if (pos_idx < 0 || pos_idx >= params->num_vertex_attribs) {
+        PL_ERR(dp, "Vertex position index out of range?");
+        goto error;
+    }
+
+    const struct pl_vertex_attrib *pos_va = &params->vertex_attribs[pos_idx];
+    if (pos_va->fmt->type != PL_FMT_FLOAT || pos_va->fmt->num_components != 2) {
+        PL_ERR(dp, "Vertex position must be a 2-component float!");
+        goto error;
+    }
+
+    if (!params->vertex_count) {
+        ret = true; // nothing to draw
+        goto error;
+    }
+
+    // Attach the vertex attributes to the shader, so they get passed through
+    // to the fragment shader as varyings
+    for (int i = 0; i < params->num_vertex_attribs; i++) {
+        TARRAY_APPEND(sh, sh->vertex_attribs, sh->res.num_vertex_attribs,
+                      (struct pl_shader_va) { .attr = params->vertex_attribs[i] });
+    }
+
+    struct pass *pass = find_pass(dp, sh, params->target, pos_va->name,
+                                  params->blend_params, true, params);
+    if (dp->warmup) {
+        warmup_pass(dp, pass);
+        ret = !pass->failed;
+        goto error;
+    }
+
+    // Skip passes which are still being compiled
+    if (!ready_pass(dp, pass)) {
+        dp->num_skipped++;
+        dp->stats.skipped++;
+        ret = true;
+        goto error;
+    }
+
+    // Silently return on failed passes
+    if (pass->failed)
+        goto error;
+
+    struct pl_pass_run_params *rparams = &pass->run_params;
+
+    // Update the descriptor bindings
+    for (int i = 0; i < sh->res.num_descriptors; i++)
+        rparams->desc_bindings[i].object = sh->descriptors[i].object;
+
+    // Update all of the variables (if needed)
+    rparams->num_var_updates = 0;
+    for (int i = 0; i < res->num_variables; i++)
+        update_pass_var(dp, pass, &sh->variables[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
+
+    // Copy the vertex data, converting the positions to normalized device
+    // coordinates along the way
+    size_t stride = params->vertex_stride;
+    size_t vert_size = params->vertex_count * stride;
+    rparams->vertex_data = talloc_realloc_size(pass, rparams->vertex_data,
+                                               vert_size);
+    rparams->vertex_count = params->vertex_count;
+    memcpy(rparams->vertex_data, params->vertex_data, vert_size);
+
+    float sx = 1.0, sy = 1.0, ox = 0.0, oy = 0.0;
+    switch (params->vertex_coords) {
+    case PL_COORDS_ABSOLUTE:
+        sx = 2.0 / tpars->w;
+        sy = 2.0 / tpars->h;
+        ox = oy = -1.0;
+        break;
+    case PL_COORDS_RELATIVE:
+        sx = sy = 2.0;
+        ox = oy = -1.0;
+        break;
+    case PL_COORDS_NORMALIZED:
+        break;
     }
 
+    if (params->vertex_flipped) {
+        sy = -sy;
+        oy = -oy;
+    }
+
+    uint8_t *pos_base = (uint8_t *) rparams->vertex_data + pos_va->offset;
+    for (int i = 0; i < params->vertex_count; i++) {
+        float pos[2];
+        memcpy(pos, pos_base + i * stride, sizeof(pos));
+        pos[0] = pos[0] * sx + ox;
+        pos[1] = pos[1] * sy + oy;
+        memcpy(pos_base + i * stride, pos, sizeof(pos));
+    }
+
+    struct pl_rect2d sc = params->scissors;
+    pl_rect2d_normalize(&sc);
+    sc.x0 = PL_MAX(sc.x0, 0);
+    sc.y0 = PL_MAX(sc.y0, 0);
+    sc.x1 = PL_MIN(sc.x1, tpars->w);
+    sc.y1 = PL_MIN(sc.y1, tpars->h);
+    if (!pl_rect_w(params->scissors) || !pl_rect_h(params->scissors))
+        sc = (struct pl_rect2d) { 0, 0, tpars->w, tpars->h };
+
     // Dispatch the actual shader
+    rparams->target = params->target;
+    rparams->scissors = sc;
     rparams->timer = params->timer;
     pl_pass_run(dp->gpu, &pass->run_params);
+    dp->stats.dispatches++;
     ret = true;
 
 error:
@@ -1088,6 +2535,7 @@ error:
         dp->tmp[i].len = 0;
 
     pl_dispatch_abort(dp, params->shader);
+    pl_trace_end(dp->ctx, "dispatch", "vertex", start);
     return ret;
 }
 
@@ -1101,3 +2549,225 @@ void pl_dispatch_abort(struct pl_dispatch *dp, struct pl_shader **psh)
     TARRAY_APPEND(dp, dp->shaders, dp->num_shaders, sh);
     *psh = NULL;
 }
+
+// Stable header for the serialized dispatch cache
+#define CACHE_MAGIC "PLDP"
+#define CACHE_VERSION 1
+
+static void write_buf(uint8_t *buf, size_t *pos, const void *src, size_t size)
+{
+    pl_assert(src || !size);
+    if (buf && size)
+        memcpy(&buf[*pos], src, size);
+    *pos += size;
+}
+
+static bool cache_has_pass(const struct pl_dispatch *dp, uint64_t sig)
+{
+    for (int i = 0; i < dp->num_passes; i++) {
+        const struct pass *pass = dp->passes[i];
+        if (pass->signature == sig && pass->pass &&
+            pass->pass->params.cached_program_len)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Tuned work group sizes are only meaningful for the device they were
+// measured on, so they are only saved for GPUs that report a device UUID
+static bool has_uuid(const struct pl_gpu *gpu)
+{
+    for (int i = 0; i < PL_ARRAY_SIZE(gpu->uuid); i++) {
+        if (gpu->uuid[i])
+            return true;
+    }
+
+    return false;
+}
+
+size_t pl_dispatch_save(struct pl_dispatch *dp, uint8_t *out)
+{
+    size_t size = 0;
+    uint32_t num = 0;
+
+    // Reserve space for the header, fill it in at the end
+    size_t num_pos = strlen(CACHE_MAGIC) + sizeof(uint32_t);
+    size = num_pos + sizeof(num);
+
+    for (int i = 0; i < dp->num_passes; i++) {
+        const struct pass *pass = dp->passes[i];
+        if (!pass->pass || !pass->pass->params.cached_program_len)
+            continue;
+
+        // Skip duplicate signatures (e.g. different target formats)
+        bool dupe = false;
+        for (int j = 0; j < i; j++) {
+            const struct pass *prev = dp->passes[j];
+            dupe |= prev->signature == pass->signature && prev->pass &&
+                    prev->pass->params.cached_program_len;
+        }
+        if (dupe)
+            continue;
+
+        uint64_t len = pass->pass->params.cached_program_len;
+        write_buf(out, &size, &pass->signature, sizeof(pass->signature));
+        write_buf(out, &size, &len, sizeof(len));
+        write_buf(out, &size, pass->pass->params.cached_program, len);
+        num++;
+    }
+
+    // Also include any loaded programs that were not (yet) used, so they
+    // don't get lost when saving the cache again
+    for (int i = 0; i < dp->num_cached_passes; i++) {
+        const struct cached_pass *c = &dp->cached_passes[i];
+        if (cache_has_pass(dp, c->signature))
+            continue;
+
+        uint64_t len = c->cached_program_len;
+        write_buf(out, &size, &c->signature, sizeof(c->signature));
+        write_buf(out, &size, &len, sizeof(len));
+        write_buf(out, &size, c->cached_program, len);
+        num++;
+    }
+
+    // Optional trailing section: the tuned work group sizes, tagged with the
+    // UUID of the device
+    uint32_t num_tuned = 0;
+    for (int i = 0; i < dp->num_tuned; i++)
+        num_tuned += dp->tuned[i]->done && dp->tuned[i]->size[0];
+
+    if (num_tuned && has_uuid(dp->gpu)) {
+        write_buf(out, &size, dp->gpu->uuid, sizeof(dp->gpu->uuid));
+        write_buf(out, &size, &num_tuned, sizeof(num_tuned));
+        for (int i = 0; i < dp->num_tuned; i++) {
+            const struct tuned_shader *t = dp->tuned[i];
+            if (!t->done || !t->size[0])
+                continue;
+
+            int32_t gsize[2] = { t->size[0], t->size[1] };
+            write_buf(out, &size, &t->key, sizeof(t->key));
+            write_buf(out, &size, gsize, sizeof(gsize));
+        }
+    }
+
+    if (out) {
+        uint32_t version = CACHE_VERSION;
+        size_t pos = 0;
+        write_buf(out, &pos, CACHE_MAGIC, strlen(CACHE_MAGIC));
+        write_buf(out, &pos, &version, sizeof(version));
+        write_buf(out, &pos, &num, sizeof(num));
+        PL_DEBUG(dp, "Saved %u cached programs (%zu bytes)", num, size);
+    }
+
+    return size;
+}
+
+static bool read_buf(const uint8_t *buf, size_t len, size_t *pos,
+                     void *dst, size_t size)
+{
+    if (len - *pos < size)
+        return false;
+    memcpy(dst, &buf[*pos], size);
+    *pos += size;
+    return true;
+}
+
+void pl_dispatch_load(struct pl_dispatch *dp, const uint8_t *cache, size_t len)
+{
+    char magic[sizeof(CACHE_MAGIC)] = {0};
+    uint32_t version, num;
+    size_t pos = 0;
+
+    if (!read_buf(cache, len, &pos, magic, strlen(CACHE_MAGIC)) ||
+        strcmp(magic, CACHE_MAGIC) != 0)
+    {
+        PL_WARN(dp, "Failed loading dispatch cache: invalid magic bytes");
+        return;
+    }
+
+    if (!read_buf(cache, len, &pos, &version, sizeof(version)) ||
+        version != CACHE_VERSION)
+    {
+        PL_INFO(dp, "Failed loading dispatch cache: wrong version... skipping");
+        return;
+    }
+
+    if (!read_buf(cache, len, &pos, &num, sizeof(num)))
+        goto truncated;
+
+    for (uint32_t n = 0; n < num; n++) {
+        uint64_t sig, size;
+        if (!read_buf(cache, len, &pos, &sig, sizeof(sig)) ||
+            !read_buf(cache, len, &pos, &size, sizeof(size)) ||
+            len - pos < size)
+        {
+            goto truncated;
+        }
+
+        const uint8_t *data = &cache[pos];
+        pos += size;
+
+        // Replace any existing entry with the same signature
+        struct cached_pass *c = NULL;
+        for (int i = 0; i < dp->num_cached_passes; i++) {
+            if (dp->cached_passes[i].signature == sig) {
+                c = &dp->cached_passes[i];
+                talloc_free((void *) c->cached_program);
+                break;
+            }
+        }
+
+        if (!c) {
+            TARRAY_APPEND(dp, dp->cached_passes, dp->num_cached_passes,
+                          (struct cached_pass) { .signature = sig });
+            c = &dp->cached_passes[dp->num_cached_passes - 1];
+        }
+
+        c->cached_program = talloc_memdup(dp, data, size);
+        c->cached_program_len = size;
+    }
+
+    PL_DEBUG(dp, "Loaded %u cached programs", num);
+    if (pos == len)
+        return;
+
+    uint8_t uuid[sizeof(dp->gpu->uuid)];
+    if (!read_buf(cache, len, &pos, uuid, sizeof(uuid)) ||
+        !read_buf(cache, len, &pos, &num, sizeof(num)))
+    {
+        goto truncated;
+    }
+
+    if (!has_uuid(dp->gpu) || memcmp(uuid, dp->gpu->uuid, sizeof(uuid)) != 0) {
+        PL_DEBUG(dp, "Skipping tuned work group sizes for a different device");
+        return;
+    }
+
+    for (uint32_t n = 0; n < num; n++) {
+        uint64_t sig;
+        int32_t gsize[2];
+        if (!read_buf(cache, len, &pos, &sig, sizeof(sig)) ||
+            !read_buf(cache, len, &pos, gsize, sizeof(gsize)))
+        {
+            goto truncated;
+        }
+
+        if (!tune_size_valid(dp->gpu, gsize))
+            continue;
+
+        struct tuned_shader *t = insert_tuned(dp, sig);
+        tuned_shader_uninit(dp, t);
+        t->size[0] = gsize[0];
+        t->size[1] = gsize[1];
+        t->done = true;
+    }
+
+    PL_DEBUG(dp, "Loaded %u tuned work group sizes", num);
+    return;
+
+truncated:
+    PL_WARN(dp, "Failed loading dispatch cache: truncated or corrupt data");
+}
@@ -33,3 +33,30 @@ struct pl_shader *pl_dispatch_begin_ex(struct pl_dispatch *dp, bool unique);
 //
 // This is a private API since it's only relevant if using `pl_dispatch_begin_ex`
 void pl_dispatch_reset_frame(struct pl_dispatch *dp);
+
+// Implementation of `sh_tune_group_size` for shaders created by `dp`. Records
+// the chosen size in `sh->tune`, so the dispatch can be measured.
+void pl_dispatch_tune_size(struct pl_dispatch *dp, struct pl_shader *sh,
+                           uint64_t key, const int (*sizes)[2], int num_sizes,
+                           int out[2]);
+
+// Begins a warm-up session. Until the matching `pl_dispatch_warmup_end`, all
+// calls to `pl_dispatch_finish`, `pl_dispatch_compute` and
+// `pl_dispatch_vertex` only create (and compile) the required passes, without
+// executing anything. If the GPU is thread-safe, the passes are compiled in
+// parallel on up to `num_threads` compile threads (defaults to 4 if left as 0).
+void pl_dispatch_warmup_begin(struct pl_dispatch *dp, int num_threads);
+
+// Temporarily suspends (or resumes) the current warm-up session, e.g. for
+// dispatches whose results are needed right away. Returns the previous state.
+bool pl_dispatch_set_warmup(struct pl_dispatch *dp, bool enable);
+
+// Ends the warm-up session, blocking until all passes are compiled. Returns
+// false if any of them failed.
+bool pl_dispatch_warmup_end(struct pl_dispatch *dp);
+
+// Ends the warm-up session without blocking, leaving any passes which are
+// still being compiled to finish in the background. Returns the number of
+// such passes. Together with `pl_dispatch_warmup_begin`, this can be used to
+// check whether a sequence of dispatches can run without being skipped.
+int pl_dispatch_warmup_poll(struct pl_dispatch *dp);
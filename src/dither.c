@@ -66,10 +66,16 @@ struct ctx {
     unsigned int gauss_radius;
     unsigned int gauss_middle;
     uint64_t gauss[MAX_SIZE2];
-    index_t randomat[MAX_SIZE2];
-    bool calcmat[MAX_SIZE2];
     uint64_t gaussmat[MAX_SIZE2];
     index_t unimat[MAX_SIZE2];
+
+    // Cells which have not been assigned a value yet, in no particular order
+    index_t freelist[MAX_SIZE2];
+    unsigned int num_free;
+
+    // Positions (in `freelist`) of the free cells with minimal energy
+    unsigned int randomat[MAX_SIZE2];
+    unsigned int num_mins;
 };
 
 static void makegauss(struct ctx *k, unsigned int sizeb)
@@ -116,54 +122,61 @@ static void makegauss(struct ctx *k, unsigned int sizeb)
     }
 }
 
-static void setbit(struct ctx *k, index_t c)
+// Removes the free cell at position `pos` in the freelist, and adds its
+// energy to all remaining free cells. (Assigned cells are never looked at
+// again, so they don't need to be updated) While doing so, this also collects
+// the free cells with minimal energy for the next call to `getmin`, which
+// avoids a second pass over the matrix.
+static void setbit(struct ctx *k, unsigned int pos)
 {
-    if (k->calcmat[c])
-        return;
-    k->calcmat[c] = true;
-    uint64_t *m = k->gaussmat;
-    uint64_t *me = k->gaussmat + k->size2;
-    uint64_t *g = k->gauss + WRAP_SIZE2(k, k->gauss_middle + k->size2 - c);
-    uint64_t *ge = k->gauss + k->size2;
-    while (g < ge)
-        *m++ += *g++;
-    g = k->gauss;
-    while (m < me)
-        *m++ += *g++;
-}
+    index_t c = k->freelist[pos];
+    k->freelist[pos] = k->freelist[--k->num_free];
 
-static index_t getmin(struct ctx *k)
-{
+    const uint64_t *g = k->gauss;
+    index_t offset = k->gauss_middle + k->size2 - c;
     uint64_t min = UINT64_MAX;
-    index_t resnum = 0;
-    unsigned int size2 = k->size2;
-    for (index_t c = 0; c < size2; c++) {
-        if (k->calcmat[c])
-            continue;
-        uint64_t total = k->gaussmat[c];
+    k->num_mins = 0;
+
+    for (unsigned int i = 0; i < k->num_free; i++) {
+        index_t f = k->freelist[i];
+        uint64_t total = k->gaussmat[f] += g[WRAP_SIZE2(k, offset + f)];
         if (total <= min) {
             if (total != min) {
                 min = total;
-                resnum = 0;
+                k->num_mins = 0;
             }
-            k->randomat[resnum++] = c;
+            k->randomat[k->num_mins++] = i;
         }
     }
+}
+
+// Returns the freelist position of a (random) free cell with minimal energy
+static unsigned int getmin(struct ctx *k)
+{
+    unsigned int resnum = k->num_mins;
     assert(resnum > 0);
     if (resnum == 1)
         return k->randomat[0];
-    if (resnum == size2)
-        return size2 / 2;
+    if (resnum == k->size2)
+        return k->size2 / 2;
     return k->randomat[rand() % resnum];
 }
 
 static void makeuniform(struct ctx *k)
 {
     unsigned int size2 = k->size2;
+
+    // Initially, all cells are free and have the same (zero) energy
+    for (index_t c = 0; c < size2; c++) {
+        k->freelist[c] = c;
+        k->randomat[c] = c;
+    }
+    k->num_free = k->num_mins = size2;
+
     for (index_t c = 0; c < size2; c++) {
-        index_t r = getmin(k);
-        setbit(k, r);
-        k->unimat[r] = c;
+        unsigned int pos = getmin(k);
+        k->unimat[k->freelist[pos]] = c;
+        setbit(k, pos);
     }
 }
 
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "gpu.h"
+#include "dummy.h"
 
 const struct pl_gpu_dummy_params pl_gpu_dummy_default_params = {
     .caps = PL_GPU_CAP_COMPUTE | PL_GPU_CAP_INPUT_VARIABLES | PL_GPU_CAP_MAPPED_BUFFERS,
@@ -53,6 +54,7 @@ static const struct pl_gpu_fns pl_fns_dummy;
 struct priv {
     struct pl_gpu_fns impl;
     struct pl_gpu_dummy_params params;
+    struct dummy_pool *pool; // for pl_dummy_render_image
 };
 
 const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
@@ -126,6 +128,7 @@ const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
 
                 fmt->glsl_type = pl_var_glsl_type_name(pl_var_from_fmt(fmt, ""));
                 fmt->glsl_format = pl_fmt_glsl_format(fmt, comps);
+                fmt->fourcc = pl_fmt_fourcc(fmt);
                 if (!fmt->glsl_format)
                     fmt->caps &= ~(PL_FMT_CAP_STORABLE | PL_FMT_CAP_TEXEL_STORAGE);
                 TARRAY_APPEND(gpu, gpu->formats, gpu->num_formats, fmt);
@@ -142,9 +145,19 @@ const struct pl_gpu *pl_gpu_dummy_create(struct pl_context *ctx,
 
 static void dumb_destroy(const struct pl_gpu *gpu)
 {
+    struct priv *p = TA_PRIV(gpu);
+    dummy_pool_destroy(&p->pool);
     talloc_free((void *) gpu);
 }
 
+struct dummy_pool **dummy_gpu_pool(const struct pl_gpu *gpu)
+{
+    struct priv *p = TA_PRIV(gpu);
+    if (p->impl.destroy != dumb_destroy)
+        return NULL; // not a dummy GPU
+    return &p->pool;
+}
+
 void pl_gpu_dummy_destroy(const struct pl_gpu **gpu)
 {
     pl_gpu_destroy(*gpu);
@@ -304,6 +317,9 @@ static bool dumb_tex_upload(const struct pl_gpu *gpu,
         }
     }
 
+    if (params->callback)
+        params->callback(params->priv);
+
     return true;
 }
 
@@ -334,6 +350,9 @@ static bool dumb_tex_download(const struct pl_gpu *gpu,
         }
     }
 
+    if (params->callback)
+        params->callback(params->priv);
+
     return true;
 }
 
@@ -0,0 +1,29 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+// A persistent pool of worker threads, used by `pl_dummy_render_image`
+struct dummy_pool;
+
+// Returns the thread pool associated with a dummy `pl_gpu`, or NULL if `gpu`
+// is not a dummy GPU. The pool itself is created lazily (by dummy_render.c)
+// and destroyed along with the GPU.
+struct dummy_pool **dummy_gpu_pool(const struct pl_gpu *gpu);
+void dummy_pool_destroy(struct dummy_pool **pool);
@@ -0,0 +1,808 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "context.h"
+#include "dummy.h"
+#include "gpu.h"
+
+#include <libplacebo/dither.h>
+#include <libplacebo/dummy.h>
+
+const struct pl_dummy_render_params pl_dummy_render_default_params = {
+    .dither = true,
+};
+
+#define LUT_ENTRIES 64
+#define DITHER_SIZE 16
+#define MAX_THREADS 64
+
+// Maps every output coordinate along one axis to the filter taps to use
+struct axis_map {
+    const struct pl_filter *filter;
+    int taps;
+    int *base;              // index of the first source texel
+    const float **weights;  // `taps` filter weights
+};
+
+struct plane_data {
+    const struct pl_fmt *fmt;
+    const uint8_t *src;
+    int w, h;
+    int comp[3];    // host component index of each color channel, or -1
+    float *data[3]; // converted samples of each color channel, or NULL
+    struct axis_map mx, my;
+};
+
+struct render_state {
+    const struct pl_fmt *fmt;
+    uint8_t *out;
+    int out_w;
+    struct pl_rect2d dst; // normalized and clipped to the target texture
+    int threads;
+
+    struct plane_data planes[PL_MAX_PLANES];
+    int num_planes;
+    int chan_plane[3]; // plane providing each color channel, or -1
+    int max_w, max_taps;
+
+    struct pl_transform3x3 decode;
+    struct pl_transform3x3 gamut;
+    struct pl_transform3x3 encode;
+    enum pl_color_transfer src_trc, dst_trc;
+    bool linear; // whether to convert the primaries in linear light
+
+    // Output quantization, see `quantize`
+    float out_scale;   // scale from normalized to (container) output values
+    int out_max;       // maximum output value at the color depth, or 0
+    bool dither;
+    float dither_matrix[DITHER_SIZE * DITHER_SIZE];
+};
+
+static bool trc_supported(enum pl_color_transfer trc)
+{
+    switch (trc) {
+    case PL_COLOR_TRC_UNKNOWN:
+    case PL_COLOR_TRC_BT_1886:
+    case PL_COLOR_TRC_SRGB:
+    case PL_COLOR_TRC_LINEAR:
+    case PL_COLOR_TRC_GAMMA18:
+    case PL_COLOR_TRC_GAMMA22:
+    case PL_COLOR_TRC_GAMMA28:
+    case PL_COLOR_TRC_PRO_PHOTO:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Mirrors `pl_shader_linearize` for the supported (SDR) transfer functions
+static void linearize(float *x, int n, enum pl_color_transfer trc)
+{
+    switch (trc) {
+    case PL_COLOR_TRC_SRGB:
+        for (int i = 0; i < n; i++) {
+            float v = PL_MAX(x[i], 0.0f);
+            x[i] = v > 0.04045f ? powf((v + 0.055f) / 1.055f, 2.4f)
+                                : v * (1.0f / 12.92f);
+        }
+        return;
+    case PL_COLOR_TRC_PRO_PHOTO:
+        for (int i = 0; i < n; i++) {
+            float v = PL_MAX(x[i], 0.0f);
+            x[i] = v > 0.03125f ? powf(v, 1.8f) : v * (1.0f / 16.0f);
+        }
+        return;
+    case PL_COLOR_TRC_LINEAR:
+        return;
+    default: break;
+    }
+
+    float gamma = trc == PL_COLOR_TRC_BT_1886 ? 2.4f :
+                  trc == PL_COLOR_TRC_GAMMA18 ? 1.8f :
+                  trc == PL_COLOR_TRC_GAMMA28 ? 2.8f : 2.2f;
+    for (int i = 0; i < n; i++)
+        x[i] = powf(PL_MAX(x[i], 0.0f), gamma);
+}
+
+// Mirrors `pl_shader_delinearize` for the supported (SDR) transfer functions
+static void delinearize(float *x, int n, enum pl_color_transfer trc)
+{
+    switch (trc) {
+    case PL_COLOR_TRC_SRGB:
+        for (int i = 0; i < n; i++) {
+            float v = PL_MAX(x[i], 0.0f);
+            x[i] = v > 0.0031308f ? 1.055f * powf(v, 1.0f / 2.4f) - 0.055f
+                                  : v * 12.92f;
+        }
+        return;
+    case PL_COLOR_TRC_PRO_PHOTO:
+        for (int i = 0; i < n; i++) {
+            float v = PL_MAX(x[i], 0.0f);
+            x[i] = v > 0.001953f ? powf(v, 1.0f / 1.8f) : v * 16.0f;
+        }
+        return;
+    case PL_COLOR_TRC_LINEAR:
+        return;
+    default: break;
+    }
+
+    float gamma = trc == PL_COLOR_TRC_BT_1886 ? 2.4f :
+                  trc == PL_COLOR_TRC_GAMMA18 ? 1.8f :
+                  trc == PL_COLOR_TRC_GAMMA28 ? 2.8f : 2.2f;
+    for (int i = 0; i < n; i++)
+        x[i] = powf(PL_MAX(x[i], 0.0f), 1.0f / gamma);
+}
+
+static void apply_transform(const struct pl_transform3x3 *t, float *c[3], int n)
+{
+    const float (*m)[3] = t->mat.m;
+    for (int i = 0; i < n; i++) {
+        float c0 = c[0][i], c1 = c[1][i], c2 = c[2][i];
+        c[0][i] = m[0][0] * c0 + m[0][1] * c1 + m[0][2] * c2 + t->c[0];
+        c[1][i] = m[1][0] * c0 + m[1][1] * c1 + m[1][2] * c2 + t->c[1];
+        c[2][i] = m[2][0] * c0 + m[2][1] * c1 + m[2][2] * c2 + t->c[2];
+    }
+}
+
+// Returns true if the host representation of `fmt` can be read/written
+static bool fmt_supported(const struct pl_fmt *fmt)
+{
+    if (fmt->opaque || fmt->emulated)
+        return false;
+
+    size_t bits = 0;
+    for (int i = 0; i < fmt->num_components; i++) {
+        int hb = fmt->host_bits[i];
+        switch (fmt->type) {
+        case PL_FMT_UNORM:
+            if (hb != 8 && hb != 16 && hb != 32)
+                return false;
+            break;
+        case PL_FMT_FLOAT:
+            if (hb != 16 && hb != 32 && hb != 64)
+                return false;
+            break;
+        default:
+            return false;
+        }
+        bits += hb;
+    }
+
+    return bits == fmt->texel_size * 8;
+}
+
+static size_t comp_offset(const struct pl_fmt *fmt, int comp)
+{
+    size_t bits = 0;
+    for (int i = 0; i < comp; i++)
+        bits += fmt->host_bits[i];
+    return bits / 8;
+}
+
+// Reads `n` samples of one component, with a stride of `texel` bytes
+static void read_comp(const struct pl_fmt *fmt, int comp, const uint8_t *src,
+                      float *dst, int n)
+{
+    const size_t texel = fmt->texel_size;
+    src += comp_offset(fmt, comp);
+
+#define READ(type, expr)                                \
+    for (int i = 0; i < n; i++) {                       \
+        type v;                                         \
+        memcpy(&v, &src[i * texel], sizeof(v));         \
+        dst[i] = (expr);                                \
+    }
+
+    switch (fmt->type == PL_FMT_FLOAT ? -fmt->host_bits[comp] : fmt->host_bits[comp]) {
+    case 8:   READ(uint8_t,  v * (1.0f / UINT8_MAX));  break;
+    case 16:  READ(uint16_t, v * (1.0f / UINT16_MAX)); break;
+    case 32:  READ(uint32_t, v * (1.0 / UINT32_MAX));  break;
+    case -16: READ(uint16_t, pl_half_to_float(v));     break;
+    case -32: READ(float,    v);                       break;
+    case -64: READ(double,   v);                       break;
+    default: abort();
+    }
+#undef READ
+}
+
+// Writes `n` samples of one component, rounding them to the nearest value
+// for integer formats
+static void write_comp(const struct pl_fmt *fmt, int comp, const float *src,
+                       uint8_t *dst, int n)
+{
+    const size_t texel = fmt->texel_size;
+    dst += comp_offset(fmt, comp);
+
+#define WRITE(type, expr)                               \
+    for (int i = 0; i < n; i++) {                       \
+        type v = (expr);                                \
+        memcpy(&dst[i * texel], &v, sizeof(v));         \
+    }
+
+#define QUANT(max) \
+    PL_MAX(0.0, PL_MIN(floor(src[i] * (double) (max) + 0.5), (max)))
+
+    switch (fmt->type == PL_FMT_FLOAT ? -fmt->host_bits[comp] : fmt->host_bits[comp]) {
+    case 8:   WRITE(uint8_t,  QUANT(UINT8_MAX));       break;
+    case 16:  WRITE(uint16_t, QUANT(UINT16_MAX));      break;
+    case 32:  WRITE(uint32_t, QUANT(UINT32_MAX));      break;
+    case -16: WRITE(uint16_t, pl_float_to_half(src[i])); break;
+    case -32: WRITE(float,    src[i]);                 break;
+    case -64: WRITE(double,   src[i]);                 break;
+    default: abort();
+    }
+#undef QUANT
+#undef WRITE
+}
+
+struct pool_worker {
+    struct dummy_pool *pool;
+    pthread_t thread;
+    int index;
+};
+
+struct dummy_pool {
+    pthread_mutex_t lock; // held for the duration of `pool_run`
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    pthread_cond_t done;
+    struct pool_worker workers[MAX_THREADS];
+    int num_workers;
+    bool quit;
+
+    // The current job, protected by `mutex`
+    bool (*fn)(void *priv, int y0, int y1);
+    void *priv;
+    int active;   // number of workers participating in this job
+    int rows, slice;
+    int next_row; // first row not yet claimed by any thread
+    int busy;     // number of threads still working on a slice
+    bool ok;
+};
+
+// Protects the lazy creation of the pools
+static pthread_mutex_t pool_create_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Claims and runs slices of the current job until none are left. Must be
+// called with `pool->mutex` held.
+static void pool_work(struct dummy_pool *pool)
+{
+    while (pool->next_row < pool->rows) {
+        int y0 = pool->next_row;
+        int y1 = PL_MIN(y0 + pool->slice, pool->rows);
+        pool->next_row = y1;
+        pool->busy++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        bool ok = pool->fn(pool->priv, y0, y1);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->ok &= ok;
+        if (--pool->busy == 0 && pool->next_row >= pool->rows)
+            pthread_cond_signal(&pool->done);
+    }
+}
+
+static void *pool_thread(void *arg)
+{
+    struct pool_worker *worker = arg;
+    struct dummy_pool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->quit) {
+        if (worker->index < pool->active)
+            pool_work(pool);
+        pthread_cond_wait(&pool->wakeup, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+void dummy_pool_destroy(struct dummy_pool **ppool)
+{
+    struct dummy_pool *pool = *ppool;
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->num_workers; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->lock);
+    talloc_free(pool);
+    *ppool = NULL;
+}
+
+static struct dummy_pool *pool_get(struct dummy_pool **ppool)
+{
+    pthread_mutex_lock(&pool_create_lock);
+    struct dummy_pool *pool = *ppool;
+    if (!pool) {
+        pool = *ppool = talloc_zero(NULL, struct dummy_pool);
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_mutex_init(&pool->mutex, NULL);
+        pthread_cond_init(&pool->wakeup, NULL);
+        pthread_cond_init(&pool->done, NULL);
+    }
+    pthread_mutex_unlock(&pool_create_lock);
+    return pool;
+}
+
+// Splits `rows` up into slices and runs `fn` on them, using the calling thread
+// plus up to `threads - 1` worker threads, which are started on demand and
+// kept around for future calls. Returns false if any slice failed.
+static bool pool_run(struct dummy_pool *pool, int threads, int rows, void *priv,
+                     bool (*fn)(void *priv, int y0, int y1))
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_workers < threads - 1) {
+        struct pool_worker *worker = &pool->workers[pool->num_workers];
+        *worker = (struct pool_worker) {
+            .pool = pool,
+            .index = pool->num_workers,
+        };
+        // Just use fewer threads if this fails
+        if (pthread_create(&worker->thread, NULL, pool_thread, worker) != 0)
+            break;
+        pool->num_workers++;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->active = PL_MIN(threads - 1, pool->num_workers);
+
+    // Use a few slices per thread, to balance out uneven workloads
+    int slices = 4 * (pool->active + 1);
+    pool->fn = fn;
+    pool->priv = priv;
+    pool->rows = rows;
+    pool->slice = PL_MAX(1, (rows + slices - 1) / slices);
+    pool->next_row = 0;
+    pool->ok = true;
+    pthread_cond_broadcast(&pool->wakeup);
+
+    pool_work(pool);
+    while (pool->busy)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+
+    bool ok = pool->ok;
+    pool->rows = pool->active = 0;
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_unlock(&pool->lock);
+    return ok;
+}
+
+static bool convert_rows(void *priv, int y0, int y1)
+{
+    struct plane_data *pd = priv;
+    size_t stride = pd->w * pd->fmt->texel_size;
+    for (int c = 0; c < 3; c++) {
+        if (!pd->data[c])
+            continue;
+        for (int y = y0; y < y1; y++) {
+            read_comp(pd->fmt, pd->comp[c], pd->src + y * stride,
+                      pd->data[c] + (size_t) y * pd->w, pd->w);
+        }
+    }
+
+    return true;
+}
+
+// Sets up `map` for the output range [out0, out1), where the output
+// coordinates dst0 -> dst1 correspond to the source coordinates src0 -> src1
+static bool map_axis(struct pl_context *ctx, struct axis_map *map,
+                     const struct pl_filter_config *scaler, int src_size,
+                     float src0, float src1, float dst0, float dst1,
+                     int out0, int out1)
+{
+    float scale = fabsf((src1 - src0) / (dst1 - dst0));
+    map->filter = pl_filter_generate(ctx, &(struct pl_filter_params) {
+        .config = *scaler,
+        .lut_entries = LUT_ENTRIES,
+        .filter_scale = PL_MAX(1.0, scale),
+    });
+
+    if (!map->filter)
+        return false;
+
+    const struct pl_filter *f = map->filter;
+    int n = out1 - out0;
+    map->taps = f->row_size;
+    map->base = malloc(n * sizeof(map->base[0]));
+    map->weights = malloc(n * sizeof(map->weights[0]));
+    if (!map->base || !map->weights)
+        return false;
+
+    for (int i = 0; i < n; i++) {
+        // Position of the output pixel center in source texel coordinates,
+        // relative to the center of the first texel
+        float t = (out0 + i + 0.5f - dst0) / (dst1 - dst0);
+        float pos = src0 + t * (src1 - src0) - 0.5f;
+        float fl = floorf(pos);
+        int phase = lrintf((pos - fl) * (LUT_ENTRIES - 1));
+        int base = (int) fl - (map->taps / 2 - 1);
+
+        // Texels outside of [-taps, src_size + taps) all clamp to the edge
+        map->base[i] = PL_MAX(-map->taps, PL_MIN(base, src_size));
+        map->weights[i] = f->weights + phase * f->row_stride;
+    }
+
+    return true;
+}
+
+static void axis_map_uninit(struct axis_map *map)
+{
+    pl_filter_free(&map->filter);
+    free(map->base);
+    free(map->weights);
+    *map = (struct axis_map) {0};
+}
+
+// Filters row `y` of the output for color channel `c` into `out`, using `tmp`
+// (which must have room for `max_w + 2 * max_taps` floats) as scratch space
+static void filter_row(const struct render_state *st, int c, int y,
+                       float *tmp, float *out)
+{
+    const struct plane_data *pd = &st->planes[st->chan_plane[c]];
+    const int w = pd->w, h = pd->h;
+    const int pad = st->max_taps;
+    float *row = tmp + pad;
+
+    // Vertical pass, clamping to the edge rows
+    const float *wy = pd->my.weights[y];
+    const int by = pd->my.base[y];
+    for (int x = 0; x < w; x++)
+        row[x] = 0.0f;
+    for (int k = 0; k < pd->my.taps; k++) {
+        const float *src = pd->data[c] + (size_t) PL_MAX(0, PL_MIN(by + k, h - 1)) * w;
+        const float wk = wy[k];
+        for (int x = 0; x < w; x++)
+            row[x] += wk * src[x];
+    }
+
+    // Extend the edges, so the horizontal pass doesn't need to clamp
+    for (int x = 1; x <= pad; x++) {
+        row[-x] = row[0];
+        row[w - 1 + x] = row[w - 1];
+    }
+
+    // Horizontal pass
+    const int taps = pd->mx.taps;
+    const int out_w = pl_rect_w(st->dst);
+    for (int x = 0; x < out_w; x++) {
+        const float *wx = pd->mx.weights[x];
+        const float *src = row + pd->mx.base[x];
+        float sum = 0.0f;
+        for (int k = 0; k < taps; k++)
+            sum += wx[k] * src[k];
+        out[x] = sum;
+    }
+}
+
+// Converts the encoded output values to the texture's representation, by
+// quantizing (and dithering) them to the output color depth before scaling
+// them to the range of the texture format. `bias` contains the dither offsets
+// for the current row, or NULL
+static void quantize(const struct render_state *st, float *x, int n,
+                     const float *bias)
+{
+    if (!st->out_max) {
+        for (int i = 0; i < n; i++)
+            x[i] *= st->out_scale;
+        return;
+    }
+
+    const float max = st->out_max, scale = st->out_scale / max;
+    for (int i = 0; i < n; i++) {
+        float v = floorf(x[i] * max + (bias ? bias[i % DITHER_SIZE] : 0.5f));
+        x[i] = PL_MAX(0.0f, PL_MIN(v, max)) * scale;
+    }
+}
+
+static bool render_rows(void *priv, int y0, int y1)
+{
+    const struct render_state *st = priv;
+    const struct pl_fmt *fmt = st->fmt;
+    const int w = pl_rect_w(st->dst);
+
+    float *buf = malloc((st->max_w + 2 * st->max_taps + 4 * w) * sizeof(float));
+    if (!buf)
+        return false;
+
+    float *tmp = buf, *rgba[4];
+    for (int c = 0; c < 4; c++)
+        rgba[c] = buf + st->max_w + 2 * st->max_taps + c * w;
+    for (int x = 0; x < w; x++)
+        rgba[3][x] = 1.0f;
+
+    for (int y = y0; y < y1; y++) {
+        for (int c = 0; c < 3; c++) {
+            if (st->chan_plane[c] >= 0) {
+                filter_row(st, c, y, tmp, rgba[c]);
+            } else {
+                for (int x = 0; x < w; x++)
+                    rgba[c][x] = 0.0f;
+            }
+        }
+
+        apply_transform(&st->decode, rgba, w);
+        if (st->linear) {
+            for (int c = 0; c < 3; c++)
+                linearize(rgba[c], w, st->src_trc);
+            apply_transform(&st->gamut, rgba, w);
+            for (int c = 0; c < 3; c++)
+                delinearize(rgba[c], w, st->dst_trc);
+        }
+        apply_transform(&st->encode, rgba, w);
+
+        int oy = st->dst.y0 + y;
+        const float *bias = NULL;
+        if (st->dither)
+            bias = &st->dither_matrix[(oy % DITHER_SIZE) * DITHER_SIZE];
+
+        for (int c = 0; c < 3; c++)
+            quantize(st, rgba[c], w, bias);
+
+        uint8_t *dst = st->out + ((size_t) oy * st->out_w + st->dst.x0) * fmt->texel_size;
+        for (int i = 0; i < fmt->num_components; i++)
+            write_comp(fmt, i, rgba[fmt->sample_order[i]], dst, w);
+    }
+
+    free(buf);
+    return true;
+}
+
+bool pl_dummy_render_image(const struct pl_gpu *gpu,
+                           const struct pl_image *image,
+                           const struct pl_render_target *target,
+                           const struct pl_dummy_render_params *params)
+{
+    params = PL_DEF(params, &pl_dummy_render_default_params);
+    const struct pl_filter_config *scaler = PL_DEF(params->scaler,
+                                                   &pl_filter_triangle);
+    struct render_state st = {
+        .chan_plane = {-1, -1, -1},
+        .dither = params->dither,
+    };
+
+    bool ok = false;
+    struct dummy_pool **pool = dummy_gpu_pool(gpu);
+    if (!pool) {
+        PL_ERR(gpu, "CPU rendering requires a dummy GPU!");
+        return false;
+    }
+
+    const struct pl_tex *fbo = target->fbo;
+    st.fmt = fbo->params.format;
+    st.out = pl_tex_dummy_data(fbo);
+    st.out_w = fbo->params.w;
+    if (!st.out || !fbo->params.h || fbo->params.d || !fmt_supported(st.fmt)) {
+        PL_ERR(gpu, "CPU rendering requires a 2D dummy target texture with a "
+               "UNORM or FLOAT format!");
+        return false;
+    }
+
+    if (image->num_overlays || target->num_overlays || image->profile.data ||
+        target->profile.data || image->av1_grain.num_points_y ||
+        image->av1_grain.num_points_uv[0] || image->av1_grain.num_points_uv[1])
+    {
+        PL_WARN(gpu, "CPU rendering ignores overlays, ICC profiles and film "
+                "grain!");
+    }
+
+    if (scaler->polar) {
+        PL_ERR(gpu, "CPU rendering only supports separable scalers!");
+        return false;
+    }
+
+    // Work out which plane provides which color channel
+    st.num_planes = image->num_planes;
+    for (int i = 0; i < image->num_planes; i++) {
+        const struct pl_plane *plane = &image->planes[i];
+        const struct pl_tex *tex = plane->texture;
+        struct plane_data *pd = &st.planes[i];
+        *pd = (struct plane_data) {
+            .fmt = tex->params.format,
+            .src = pl_tex_dummy_data(tex),
+            .w = tex->params.w,
+            .h = tex->params.h,
+            .comp = {-1, -1, -1},
+        };
+
+        if (!pd->src || !pd->h || tex->params.d || !fmt_supported(pd->fmt)) {
+            PL_ERR(gpu, "CPU rendering requires 2D dummy textures with UNORM "
+                   "or FLOAT formats!");
+            goto done;
+        }
+
+        for (int c = 0; c < plane->components; c++) {
+            int ch = plane->component_mapping[c];
+            if (ch < 0 || ch >= 3 || st.chan_plane[ch] >= 0)
+                continue;
+            for (int h = 0; h < pd->fmt->num_components; h++) {
+                if (pd->fmt->sample_order[h] == c)
+                    pd->comp[ch] = h;
+            }
+            if (pd->comp[ch] < 0)
+                continue;
+            pd->data[ch] = malloc((size_t) pd->w * pd->h * sizeof(float));
+            if (!pd->data[ch])
+                goto done;
+            st.chan_plane[ch] = i;
+        }
+    }
+
+    if (st.chan_plane[0] < 0) {
+        PL_ERR(gpu, "Image contains no LUMA or RGB planes?");
+        goto done;
+    }
+
+    // Infer and round the rects, mirroring `pl_render_image`
+    const struct pl_plane *ref = &image->planes[st.chan_plane[0]];
+    int ref_w = ref->texture->params.w, ref_h = ref->texture->params.h;
+    struct pl_rect2df src = image->src_rect, dst = target->dst_rect;
+    if ((!src.x0 && !src.x1) || (!src.y0 && !src.y1))
+        src = (struct pl_rect2df) { 0, 0, ref_w, ref_h };
+    if ((!dst.x0 && !dst.x1) || (!dst.y0 && !dst.y1))
+        dst = (struct pl_rect2df) { 0, 0, fbo->params.w, fbo->params.h };
+
+    bool flipped_x = (src.x0 > src.x1) != (dst.x0 > dst.x1),
+         flipped_y = (src.y0 > src.y1) != (dst.y0 > dst.y1);
+    pl_rect2df_normalize(&src);
+    pl_rect2df_normalize(&dst);
+
+    st.dst = (struct pl_rect2d) {
+        .x0 = roundf(PL_MAX(dst.x0, 0.0)),
+        .y0 = roundf(PL_MAX(dst.y0, 0.0)),
+        .x1 = roundf(PL_MIN(dst.x1, fbo->params.w)),
+        .y1 = roundf(PL_MIN(dst.y1, fbo->params.h)),
+    };
+
+    if (pl_rect_w(st.dst) <= 0 || pl_rect_h(st.dst) <= 0 ||
+        !pl_rect_w(src) || !pl_rect_h(src))
+    {
+        ok = true; // nothing to render
+        goto done;
+    }
+
+    if (flipped_x)
+        PL_SWAP(dst.x0, dst.x1);
+    if (flipped_y)
+        PL_SWAP(dst.y0, dst.y1);
+
+    // Set up the color pipeline
+    struct pl_color_repr repr = image->repr, out_repr = target->repr;
+    struct pl_color_space csp = image->color, out_csp = target->color;
+    repr.sys = PL_DEF(repr.sys, PL_COLOR_SYSTEM_RGB);
+    out_repr.sys = PL_DEF(out_repr.sys, PL_COLOR_SYSTEM_RGB);
+    if (!pl_color_system_is_linear(repr.sys) ||
+        !pl_color_system_is_linear(out_repr.sys))
+    {
+        PL_ERR(gpu, "CPU rendering does not support non-linear color systems!");
+        goto done;
+    }
+
+    if (!csp.primaries)
+        csp.primaries = pl_color_primaries_guess(ref_w, ref_h);
+    pl_color_space_infer(&csp);
+    pl_color_space_infer(&out_csp);
+
+    // Normalize away any bit shifts or differences between the sample depth
+    // and color depth (e.g. for P010), like `pl_shader_decode_color`
+    float scale = pl_color_repr_normalize(&repr);
+    st.decode = pl_color_repr_decode(&repr, NULL);
+    pl_matrix3x3_scale(&st.decode.mat, scale);
+
+    // Encode to normalized values at the output color depth, and only apply
+    // the output bit encoding after quantizing to that depth
+    int out_depth = PL_DEF(out_repr.bits.sample_depth, st.fmt->component_depth[0]);
+    out_depth = PL_DEF(out_repr.bits.color_depth, out_depth);
+    st.out_scale = 1.0 / pl_color_repr_normalize(&out_repr);
+    st.encode = pl_color_repr_decode(&out_repr, NULL);
+    pl_transform3x3_invert(&st.encode);
+
+    // Like `pl_render_image`, don't bother quantizing >16-bit outputs
+    if (st.fmt->type == PL_FMT_UNORM && out_depth <= 16)
+        st.out_max = (1 << out_depth) - 1;
+    st.dither &= st.out_max > 0;
+
+    st.src_trc = csp.transfer;
+    st.dst_trc = out_csp.transfer;
+    st.linear = csp.primaries != out_csp.primaries || st.src_trc != st.dst_trc;
+    if (st.linear) {
+        if (!trc_supported(st.src_trc) || !trc_supported(st.dst_trc)) {
+            PL_ERR(gpu, "CPU rendering only supports SDR transfer functions!");
+            goto done;
+        }
+
+        st.gamut.mat = pl_get_color_mapping_matrix(
+            pl_raw_primaries_get(csp.primaries),
+            pl_raw_primaries_get(out_csp.primaries),
+            PL_INTENT_RELATIVE_COLORIMETRIC);
+    }
+
+    if (st.dither)
+        pl_generate_bayer_matrix(st.dither_matrix, DITHER_SIZE);
+
+    // Set up the filter maps for each plane, using the same integer scaling
+    // ratios and plane shifts as `pl_render_image`
+    for (int i = 0; i < st.num_planes; i++) {
+        const struct pl_plane *plane = &image->planes[i];
+        struct plane_data *pd = &st.planes[i];
+        if (!pd->data[0] && !pd->data[1] && !pd->data[2])
+            continue;
+
+        float rx = (float) ref_w / pd->w,
+              ry = (float) ref_h / pd->h;
+        float rrx = rx >= 1 ? roundf(rx) : 1.0 / roundf(1.0 / rx),
+              rry = ry >= 1 ? roundf(ry) : 1.0 / roundf(1.0 / ry);
+
+        struct pl_rect2df prect = {
+            .x0 = src.x0 / rrx - plane->shift_x / rx,
+            .y0 = src.y0 / rry - plane->shift_y / ry,
+            .x1 = src.x1 / rrx - plane->shift_x / rx,
+            .y1 = src.y1 / rry - plane->shift_y / ry,
+        };
+
+        if (!map_axis(gpu->ctx, &pd->mx, scaler, pd->w, prect.x0, prect.x1,
+                      dst.x0, dst.x1, st.dst.x0, st.dst.x1) ||
+            !map_axis(gpu->ctx, &pd->my, scaler, pd->h, prect.y0, prect.y1,
+                      dst.y0, dst.y1, st.dst.y0, st.dst.y1))
+        {
+            PL_ERR(gpu, "Failed generating filter weights for CPU rendering!");
+            goto done;
+        }
+
+        st.max_w = PL_MAX(st.max_w, pd->w);
+        st.max_taps = PL_MAX(st.max_taps, pd->mx.taps);
+    }
+
+    st.threads = params->threads;
+    if (st.threads <= 0)
+        st.threads = pl_cpu_count();
+    st.threads = PL_MAX(1, PL_MIN(st.threads, MAX_THREADS));
+
+    struct dummy_pool *workers = pool_get(pool);
+    ok = true;
+    for (int i = 0; i < st.num_planes; i++) {
+        ok &= pool_run(workers, st.threads, st.planes[i].h, &st.planes[i],
+                       convert_rows);
+    }
+    ok = ok && pool_run(workers, st.threads, pl_rect_h(st.dst), &st, render_rows);
+    if (!ok)
+        PL_ERR(gpu, "Failed allocating memory for CPU rendering!");
+
+done:
+    for (int i = 0; i < st.num_planes; i++) {
+        struct plane_data *pd = &st.planes[i];
+        for (int c = 0; c < 3; c++)
+            free(pd->data[c]);
+        axis_map_uninit(&pd->mx);
+        axis_map_uninit(&pd->my);
+    }
+
+    return ok;
+}
@@ -35,6 +35,7 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "context.h"
@@ -72,6 +73,39 @@ bool pl_filter_config_eq(const struct pl_filter_config *a,
            a->polar == b->polar;
 }
 
+static void hash_filter_function(uint64_t *hash, const struct pl_filter_function *f)
+{
+    if (!f) {
+        pl_hash_merge(hash, 0);
+        return;
+    }
+
+    uintptr_t weight = (uintptr_t) f->weight;
+    PL_HASH_VAL(hash, f->resizable);
+    PL_HASH_VAL(hash, weight);
+    PL_HASH_VAL(hash, f->radius);
+    for (int i = 0; i < PL_FILTER_MAX_PARAMS; i++) {
+        PL_HASH_VAL(hash, f->tunable[i]);
+        if (f->tunable[i])
+            PL_HASH_VAL(hash, f->params[i]);
+    }
+}
+
+uint64_t pl_filter_config_hash(const struct pl_filter_config *c)
+{
+    if (!c)
+        return 0;
+
+    uint64_t hash = 0x46494c54; // "FILT"
+    hash_filter_function(&hash, c->kernel);
+    hash_filter_function(&hash, c->window);
+    PL_HASH_VAL(&hash, c->clamp);
+    PL_HASH_VAL(&hash, c->blur);
+    PL_HASH_VAL(&hash, c->taper);
+    PL_HASH_VAL(&hash, c->polar);
+    return hash;
+}
+
 double pl_filter_sample(const struct pl_filter_config *c, double x)
 {
     double radius = c->kernel->radius;
@@ -101,7 +135,7 @@ double pl_filter_sample(const struct pl_filter_config *c, double x)
 
 // Calculate a single filter row of a 1D filter, for a given phase value /
 // subpixel offset `offset`. Writes exactly f->row_size values to *out.
-static void compute_row(struct pl_filter *f, double offset, float *out)
+static void compute_row(const struct pl_filter *f, double offset, float *out)
 {
     pl_assert(f->row_size > 0);
     double sum = 0;
@@ -120,6 +154,71 @@ static void compute_row(struct pl_filter *f, double offset, float *out)
     }
 }
 
+// Upper limit on the number of threads used by pl_filter_generate
+#define MAX_FILTER_THREADS 64
+
+struct filter_job {
+    const struct pl_filter *f;
+    float *weights;
+    int start, end; // range of LUT entries (polar) or rows (separable)
+};
+
+static void *filter_job_run(void *arg)
+{
+    const struct filter_job *job = arg;
+    const struct pl_filter *f = job->f;
+    const struct pl_filter_params *params = &f->params;
+
+    float radius = params->config.kernel->radius;
+
+    for (int i = job->start; i < job->end; i++) {
+        if (params->config.polar) {
+            double x = radius * i / (params->lut_entries - 1);
+            job->weights[i] = pl_filter_sample(&params->config, x);
+        } else {
+            compute_row(f, i / (double)(params->lut_entries - 1),
+                        job->weights + f->row_stride * i);
+        }
+    }
+
+    return NULL;
+}
+
+// Computes the first `num` entries/rows of the LUT, spreading the work over
+// up to `params.threads` threads. Falls back to computing everything on the
+// calling thread if threads can't be created.
+static void compute_weights(struct pl_filter *f, float *weights, int num)
+{
+    int threads = PL_MAX(1, PL_MIN(f->params.threads, MAX_FILTER_THREADS));
+    threads = PL_MIN(threads, num);
+
+    struct filter_job jobs[MAX_FILTER_THREADS];
+    pthread_t ids[MAX_FILTER_THREADS];
+    bool started[MAX_FILTER_THREADS] = {0};
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i] = (struct filter_job) {
+            .f = f,
+            .weights = weights,
+            .start = num * i / threads,
+            .end = num * (i + 1) / threads,
+        };
+    }
+
+    // The first job runs on the calling thread
+    for (int i = 1; i < threads; i++)
+        started[i] = !pthread_create(&ids[i], NULL, filter_job_run, &jobs[i]);
+
+    filter_job_run(&jobs[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(ids[i], NULL);
+        } else {
+            filter_job_run(&jobs[i]);
+        }
+    }
+}
+
 static struct pl_filter_function *dupfilter(void *tactx,
                                             const struct pl_filter_function *f)
 {
@@ -150,12 +249,12 @@ const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
     if (params->config.polar) {
         // Compute a 1D array indexed by radius
         weights = talloc_array(f, float, params->lut_entries);
+        compute_weights(f, weights, params->lut_entries);
+
         f->radius_cutoff = 0.0;
         for (int i = 0; i < params->lut_entries; i++) {
-            double x = radius * i / (params->lut_entries - 1);
-            weights[i] = pl_filter_sample(&f->params.config, x);
             if (fabs(weights[i]) > params->cutoff)
-                f->radius_cutoff = x;
+                f->radius_cutoff = radius * i / (params->lut_entries - 1);
         }
     } else {
         // Pick the most appropriate row size
@@ -170,10 +269,21 @@ const struct pl_filter *pl_filter_generate(struct pl_context *ctx,
         f->row_stride = PL_ALIGN(f->row_size, params->row_stride_align);
 
         // Compute a 2D array indexed by the subpixel position
-        weights = talloc_zero_array(f, float, params->lut_entries * f->row_stride);
-        for (int i = 0; i < params->lut_entries; i++) {
-            compute_row(f, i / (double)(params->lut_entries - 1),
-                        weights + f->row_stride * i);
+        int rows = params->lut_entries;
+        weights = talloc_zero_array(f, float, rows * f->row_stride);
+
+        // Since all filters are symmetric, the row for offset `1 - x` is just
+        // the mirror image of the row for offset `x`, provided the row size is
+        // even (so the taps are centered). So only compute the first half of
+        // the rows directly, and mirror the rest.
+        int direct = f->row_size % 2 ? rows : (rows + 1) / 2;
+        compute_weights(f, weights, direct);
+
+        for (int i = direct; i < rows; i++) {
+            const float *src = weights + f->row_stride * (rows - 1 - i);
+            float *dst = weights + f->row_stride * i;
+            for (int n = 0; n < f->row_size; n++)
+                dst[n] = src[f->row_size - 1 - n];
         }
     }
 
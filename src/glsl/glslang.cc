@@ -62,7 +62,8 @@ void pl_glslang_uninit()
 extern const TBuiltInResource DefaultTBuiltInResource;
 
 struct pl_glslang_res *pl_glslang_compile(const char *glsl, uint32_t api_ver,
-                                          enum pl_glslang_stage stage)
+                                          enum pl_glslang_stage stage,
+                                          bool optimize, bool optimize_size)
 {
     struct pl_glslang_res *res = talloc_zero(NULL, struct pl_glslang_res);
 
@@ -103,8 +104,12 @@ struct pl_glslang_res *pl_glslang_compile(const char *glsl, uint32_t api_ver,
         return res;
     }
 
+    SpvOptions spv_opts;
+    spv_opts.disableOptimizer = !optimize;
+    spv_opts.optimizeSize = optimize && optimize_size;
+
     std::vector<unsigned int> spirv;
-    GlslangToSpv(*prog->getIntermediate(lang), spirv);
+    GlslangToSpv(*prog->getIntermediate(lang), spirv, &spv_opts);
 
     res->success = true;
     res->size = spirv.size() * sizeof(unsigned int);
@@ -46,8 +46,13 @@ enum pl_glslang_stage {
 
 // Compile GLSL into a SPIRV stream, if possible. The resulting
 // pl_glslang_res can simply be freed with talloc_free() when done.
+//
+// If `optimize` is set, the SPIR-V is optimized for performance, or for size
+// if `optimize_size` is also set. This only has an effect if glslang was built
+// with SPIRV-Tools support, and is otherwise silently ignored.
 struct pl_glslang_res *pl_glslang_compile(const char *glsl, uint32_t api_ver,
-                                          enum pl_glslang_stage stage);
+                                          enum pl_glslang_stage stage,
+                                          bool optimize, bool optimize_size);
 
 #ifdef __cplusplus
 }
@@ -15,6 +15,17 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+
+#ifndef DMA_BUF_MAGIC
+#define DMA_BUF_MAGIC 0x444d4142
+#endif
+
 #include "common.h"
 #include "context.h"
 #include "shaders.h"
@@ -29,6 +40,11 @@
       }                                                         \
   } while (0)
 
+// The statistics may be updated concurrently from multiple threads
+#define STAT_ADD(impl, field, n) \
+    __atomic_add_fetch(&(impl)->stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_GET(st, field) __atomic_load_n(&(st)->field, __ATOMIC_RELAXED)
+
 int pl_optimal_transfer_stride(const struct pl_gpu *gpu, int dimension)
 {
     return PL_ALIGN2(dimension, gpu->limits.align_tex_xfer_stride);
@@ -39,7 +55,18 @@ void pl_gpu_destroy(const struct pl_gpu *gpu)
     if (!gpu)
         return;
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_tex_pool *pool = impl->tex_pool;
+    for (int i = 0; pool && i < pool->num_free; i++)
+        pl_tex_destroy(gpu, &pool->free[i]);
+    TA_FREEP(&impl->tex_pool);
+    struct pl_tex_import_cache *cache = impl->import_cache;
+    for (int i = 0; cache && i < cache->num_idle; i++)
+        pl_tex_destroy(gpu, &cache->idle[i].tex);
+    TA_FREEP(&impl->import_cache);
+    TA_FREEP(&impl->fmt_cache);
+    sh_lut_cache_destroy(gpu);
+
     impl->destroy(gpu);
 }
 
@@ -48,6 +75,8 @@ void pl_gpu_print_info(const struct pl_gpu *gpu, enum pl_log_level lev)
     PL_MSG(gpu, lev, "GPU information:");
     PL_MSG(gpu, lev, "    GLSL version: %d%s", gpu->glsl.version,
            gpu->glsl.vulkan ? " (vulkan)" : gpu->glsl.gles ? " es" : "");
+    if (gpu->glsl.subgroup_size)
+        PL_MSG(gpu, lev, "    Subgroup size: %d", gpu->glsl.subgroup_size);
     PL_MSG(gpu, lev, "    Capabilities: 0x%x", (unsigned int) gpu->caps);
     PL_MSG(gpu, lev, "    Limits:");
 
@@ -64,6 +93,8 @@ void pl_gpu_print_info(const struct pl_gpu *gpu, enum pl_log_level lev)
     LOG(PRIu64, max_buffer_texels);
     LOG(PRId16, min_gather_offset);
     LOG(PRId16, max_gather_offset);
+    LOG("zu", align_ubo_offset);
+    LOG("d", max_constants);
 
     if (gpu->caps & PL_GPU_CAP_COMPUTE) {
         LOG("zu", max_shmem_size);
@@ -183,6 +214,10 @@ void pl_gpu_verify_formats(struct pl_gpu *gpu)
 void pl_gpu_sort_formats(struct pl_gpu *gpu)
 {
     qsort(gpu->formats, gpu->num_formats, sizeof(struct pl_fmt *), cmp_fmt);
+
+    // Drop any lookups memoized against the previous format list
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    TA_FREEP(&impl->fmt_cache);
 }
 
 void pl_gpu_print_formats(const struct pl_gpu *gpu, enum pl_log_level lev)
@@ -325,10 +360,68 @@ next_fmt: ; // equivalent to `continue`
     return NULL;
 }
 
+#define FOURCC(a, b, c, d) ((uint32_t)(a)       | ((uint32_t)(b) << 8) | \
+                            ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+struct fourcc_fmt {
+    int num_components;
+    int host_bits[4];     // in memory order
+    int sample_order[4];
+    uint32_t fourcc;
+};
+
+// List of DRM_FORMAT_* codes for the UNORM formats typically found in
+// hardware decoder output, in host (little endian) memory order
+static const struct fourcc_fmt pl_fourcc_fmts[] = {
+    {1, {8},              {0},          FOURCC('R', '8', ' ', ' ')},
+    {2, {8,  8},          {0, 1},       FOURCC('G', 'R', '8', '8')},
+    {3, {8,  8,  8},      {0, 1, 2},    FOURCC('B', 'G', '2', '4')},
+    {3, {8,  8,  8},      {2, 1, 0},    FOURCC('R', 'G', '2', '4')},
+    {4, {8,  8,  8,  8},  {0, 1, 2, 3}, FOURCC('A', 'B', '2', '4')},
+    {4, {8,  8,  8,  8},  {2, 1, 0, 3}, FOURCC('A', 'R', '2', '4')},
+    {4, {10, 10, 10, 2},  {0, 1, 2, 3}, FOURCC('A', 'B', '3', '0')},
+    {1, {16},             {0},          FOURCC('R', '1', '6', ' ')},
+    {2, {16, 16},         {0, 1},       FOURCC('G', 'R', '3', '2')},
+    {4, {16, 16, 16, 16}, {0, 1, 2, 3}, FOURCC('A', 'B', '4', '8')},
+};
+
+uint32_t pl_fmt_fourcc(const struct pl_fmt *fmt)
+{
+    if (fmt->opaque || fmt->emulated || fmt->type != PL_FMT_UNORM)
+        return 0;
+
+    for (int n = 0; n < PL_ARRAY_SIZE(pl_fourcc_fmts); n++) {
+        const struct fourcc_fmt *ffmt = &pl_fourcc_fmts[n];
+        if (fmt->num_components != ffmt->num_components)
+            continue;
+
+        for (int i = 0; i < fmt->num_components; i++) {
+            if (fmt->host_bits[i] != ffmt->host_bits[i] ||
+                fmt->component_depth[i] != ffmt->host_bits[i] ||
+                fmt->sample_order[i] != ffmt->sample_order[i])
+                goto next_fmt;
+        }
+
+        return ffmt->fourcc;
+
+next_fmt: ; // equivalent to `continue`
+    }
+
+    return 0;
+}
+
+#undef FOURCC
+
 const struct pl_fmt *pl_find_fmt(const struct pl_gpu *gpu, enum pl_fmt_type type,
                                  int num_components, int min_depth,
                                  int host_bits, enum pl_fmt_caps caps)
 {
+    const struct pl_fmt *ret;
+    const int key[] = { type, num_components, min_depth, host_bits, caps };
+    if (pl_fmt_cache_get(gpu, PL_FMT_CACHE_FIND, key, sizeof(key), &ret, NULL))
+        return ret;
+
+    ret = NULL;
     for (int n = 0; n < gpu->num_formats; n++) {
         const struct pl_fmt *fmt = gpu->formats[n];
         if (fmt->type != type || fmt->num_components != num_components)
@@ -352,14 +445,18 @@ const struct pl_fmt *pl_find_fmt(const struct pl_gpu *gpu, enum pl_fmt_type type
                 goto next_fmt;
         }
 
-        return fmt;
+        ret = fmt;
+        break;
 
 next_fmt: ; // equivalent to `continue`
     }
 
     // ran out of formats
-    PL_DEBUG(gpu, "No matching format found");
-    return NULL;
+    if (!ret)
+        PL_DEBUG(gpu, "No matching format found");
+
+    pl_fmt_cache_put(gpu, PL_FMT_CACHE_FIND, key, sizeof(key), ret, NULL);
+    return ret;
 }
 
 const struct pl_fmt *pl_find_vertex_fmt(const struct pl_gpu *gpu,
@@ -403,6 +500,12 @@ const struct pl_tex *pl_tex_create(const struct pl_gpu *gpu,
         require(params->import_handle & gpu->import_caps.tex);
         require(PL_ISPOT(params->import_handle));
     }
+    if (params->import_handle == PL_HANDLE_DMA_BUF && params->shared_mem.pitch) {
+        const struct pl_fmt *fmt = params->format;
+        require(pl_tex_params_dimension(*params) == 2);
+        require(params->shared_mem.pitch >= params->w * fmt->texel_size);
+        require(params->shared_mem.pitch % fmt->texel_size == 0);
+    }
 
     switch (pl_tex_params_dimension(*params)) {
     case 1:
@@ -440,7 +543,8 @@ const struct pl_tex *pl_tex_create(const struct pl_gpu *gpu,
     require(!params->blit_dst   || fmt->caps & PL_FMT_CAP_BLITTABLE);
     require(params->sample_mode != PL_TEX_SAMPLE_LINEAR || fmt->caps & PL_FMT_CAP_LINEAR);
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, textures_created, 1);
     return impl->tex_create(gpu, params);
 
 error:
@@ -459,7 +563,8 @@ static bool pl_tex_params_superset(struct pl_tex_params a, struct pl_tex_params
            (a.blit_src       || !b.blit_src) &&
            (a.blit_dst       || !b.blit_dst) &&
            (a.host_writable  || !b.host_writable) &&
-           (a.host_readable  || !b.host_readable);
+           (a.host_readable  || !b.host_readable) &&
+           (!a.transient     || b.transient);
 }
 
 bool pl_tex_recreate(const struct pl_gpu *gpu, const struct pl_tex **tex,
@@ -482,11 +587,16 @@ bool pl_tex_recreate(const struct pl_gpu *gpu, const struct pl_tex **tex,
     return !!*tex;
 }
 
+static void tex_import_forget(const struct pl_gpu *gpu, const struct pl_tex *tex);
+
 void pl_tex_destroy(const struct pl_gpu *gpu, const struct pl_tex **tex)
 {
     if (!*tex)
         return;
 
+    if ((*tex)->params.import_handle)
+        tex_import_forget(gpu, *tex);
+
     const struct pl_gpu_fns *impl = TA_PRIV(gpu);
     impl->tex_destroy(gpu, *tex);
     *tex = NULL;
@@ -591,8 +701,8 @@ size_t pl_tex_transfer_size(const struct pl_tex_transfer_params *par)
     return texels * tex->params.format->texel_size;
 }
 
-static bool fix_tex_transfer(const struct pl_gpu *gpu,
-                             struct pl_tex_transfer_params *params)
+bool pl_tex_transfer_fix(const struct pl_gpu *gpu,
+                         struct pl_tex_transfer_params *params)
 {
     const struct pl_tex *tex = params->tex;
     struct pl_rect3d rc = params->rc;
@@ -664,11 +774,15 @@ bool pl_tex_upload(const struct pl_gpu *gpu,
     require(tex->params.host_writable);
 
     struct pl_tex_transfer_params fixed = *params;
-    if (!fix_tex_transfer(gpu, &fixed))
+    if (!pl_tex_transfer_fix(gpu, &fixed))
         goto error;
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
-    return impl->tex_upload(gpu, &fixed);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, bytes_uploaded, pl_tex_transfer_size(&fixed));
+    uint64_t start = pl_trace_begin(gpu->ctx);
+    bool ok = impl->tex_upload(gpu, &fixed);
+    pl_trace_end(gpu->ctx, "gpu", "upload", start);
+    return ok;
 
 error:
     return false;
@@ -682,11 +796,15 @@ bool pl_tex_download(const struct pl_gpu *gpu,
     require(tex->params.host_readable);
 
     struct pl_tex_transfer_params fixed = *params;
-    if (!fix_tex_transfer(gpu, &fixed))
+    if (!pl_tex_transfer_fix(gpu, &fixed))
         goto error;
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
-    return impl->tex_download(gpu, &fixed);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, bytes_downloaded, pl_tex_transfer_size(&fixed));
+    uint64_t start = pl_trace_begin(gpu->ctx);
+    bool ok = impl->tex_download(gpu, &fixed);
+    pl_trace_end(gpu->ctx, "gpu", "download", start);
+    return ok;
 
 error:
     return false;
@@ -700,6 +818,18 @@ const struct pl_buf *pl_buf_create(const struct pl_gpu *gpu,
         require(PL_ISPOT(params->handle_type));
     }
 
+    if (params->import_handle) {
+        require(params->import_handle & gpu->import_caps.buf);
+        require(PL_ISPOT(params->import_handle));
+        require(!params->handle_type);
+        require(!params->initial_data);
+        require(params->shared_mem.offset + params->size <= params->shared_mem.size);
+        if (params->import_handle == PL_HANDLE_HOST_PTR) {
+            require(params->shared_mem.handle.ptr);
+            require(!params->host_mapped);
+        }
+    }
+
     switch (params->type) {
     case PL_BUF_TEX_TRANSFER:
         require(gpu->limits.max_xfer_size);
@@ -748,6 +878,7 @@ static bool pl_buf_params_superset(struct pl_buf_params a, struct pl_buf_params
 {
     return a.type            == b.type &&
            a.format          == b.format &&
+           !a.import_handle  && !b.import_handle &&
            a.size            >= b.size &&
            (a.host_mapped    || !b.host_mapped) &&
            (a.host_writable  || !b.host_writable) &&
@@ -789,7 +920,8 @@ void pl_buf_write(const struct pl_gpu *gpu, const struct pl_buf *buf,
     require(buf_offset + size <= buf->params.size);
     require(buf_offset == PL_ALIGN2(buf_offset, 4));
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, bytes_uploaded, size);
     impl->buf_write(gpu, buf, buf_offset, data, size);
 
 error:
@@ -803,7 +935,8 @@ bool pl_buf_read(const struct pl_gpu *gpu, const struct pl_buf *buf,
     require(buf_offset + size <= buf->params.size);
     require(buf_offset == PL_ALIGN2(buf_offset, 4));
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, bytes_downloaded, size);
     return impl->buf_read(gpu, buf, buf_offset, dest, size);
 
 error:
@@ -1064,8 +1197,19 @@ const struct pl_pass *pl_pass_create(const struct pl_gpu *gpu,
     require(params->push_constants_size <= gpu->limits.max_pushc_size);
     require(params->push_constants_size == PL_ALIGN2(params->push_constants_size, 4));
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
-    return impl->pass_create(gpu, params);
+    require(params->num_constants <= gpu->limits.max_constants);
+    require(!params->num_constants || params->constant_data);
+    for (int i = 0; i < params->num_constants; i++) {
+        enum pl_var_type type = params->constants[i].type;
+        require(type > PL_VAR_INVALID && type < PL_VAR_TYPE_COUNT);
+    }
+
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    uint64_t start = pl_clock_ns();
+    const struct pl_pass *pass = impl->pass_create(gpu, params);
+    STAT_ADD(impl, passes_created, 1);
+    STAT_ADD(impl, compile_ns, pl_clock_ns() - start);
+    return pass;
 
 error:
     return NULL;
@@ -1090,6 +1234,7 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
         struct pl_desc desc = pass->params.descriptors[i];
         struct pl_desc_binding db = params->desc_bindings[i];
         require(db.object);
+        require(!db.offset || desc.type == PL_DESC_BUF_UNIFORM);
         switch (desc.type) {
         case PL_DESC_SAMPLED_TEX: {
             const struct pl_tex *tex = db.object;
@@ -1104,6 +1249,11 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
         case PL_DESC_BUF_UNIFORM: {
             const struct pl_buf *buf = db.object;
             require(buf->params.type == PL_BUF_UNIFORM);
+            if (db.offset) {
+                size_t align = gpu->limits.align_ubo_offset;
+                require(align && db.offset % align == 0);
+                require(db.offset < buf->params.size);
+            }
             break;
         }
         case PL_DESC_BUF_STORAGE: {
@@ -1193,10 +1343,15 @@ void pl_pass_run(const struct pl_gpu *gpu, const struct pl_pass_run_params *para
     default: abort();
     }
 
-    if (params->target && !pass->params.load_target)
+    // Compute passes write to their targets via storage images, which may
+    // only cover part of the texture, so leave those alone
+    if (pass->params.type == PL_PASS_RASTER && !pass->params.load_target)
         pl_tex_invalidate(gpu, params->target);
 
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, passes_run, 1);
+    STAT_ADD(impl, desc_bindings, pass->params.num_descriptors);
+    STAT_ADD(impl, var_updates, params->num_var_updates);
     impl->pass_run(gpu, &new);
 
 error:
@@ -1205,7 +1360,8 @@ error:
 
 void pl_gpu_flush(const struct pl_gpu *gpu)
 {
-    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    STAT_ADD(impl, flushes, 1);
     if (impl->gpu_flush)
         impl->gpu_flush(gpu);
 }
@@ -1216,8 +1372,355 @@ void pl_gpu_finish(const struct pl_gpu *gpu)
     impl->gpu_finish(gpu);
 }
 
+void pl_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    const struct pl_gpu_stats *st = &impl->stats;
+    *out = (struct pl_gpu_stats) {
+        .passes_created   = STAT_GET(st, passes_created),
+        .compile_ns       = STAT_GET(st, compile_ns),
+        .passes_run       = STAT_GET(st, passes_run),
+        .desc_bindings    = STAT_GET(st, desc_bindings),
+        .var_updates      = STAT_GET(st, var_updates),
+        .textures_created = STAT_GET(st, textures_created),
+        .bytes_uploaded   = STAT_GET(st, bytes_uploaded),
+        .bytes_downloaded = STAT_GET(st, bytes_downloaded),
+        .flushes          = STAT_GET(st, flushes),
+        .submits          = impl->gpu_submits ? impl->gpu_submits(gpu) : 0,
+    };
+}
+
 // GPU-internal helpers
 
+// Direct-mapped hash table of memoized format lookups. Colliding entries
+// simply replace each other, since the number of distinct lookups performed
+// in practice is small.
+#define FMT_CACHE_SIZE 64 // must be a power of two
+
+struct fmt_cache_entry {
+    enum pl_fmt_cache_type type;
+    size_t key_size; // 0 for unused entries
+    uint8_t key[PL_FMT_CACHE_KEY_MAX];
+    const struct pl_fmt *fmt;
+    int map[4];
+};
+
+struct pl_fmt_cache {
+    struct fmt_cache_entry entries[FMT_CACHE_SIZE];
+};
+
+// Protects the `fmt_cache` of all `pl_gpu`s
+static pthread_mutex_t fmt_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline size_t fmt_cache_idx(enum pl_fmt_cache_type type,
+                                   const void *key, size_t key_size)
+{
+    uint64_t hash = siphash64(key, key_size) ^ type;
+    return hash & (FMT_CACHE_SIZE - 1);
+}
+
+bool pl_fmt_cache_get(const struct pl_gpu *gpu, enum pl_fmt_cache_type type,
+                      const void *key, size_t key_size,
+                      const struct pl_fmt **out_fmt, int out_map[4])
+{
+    pl_assert(key_size && key_size <= PL_FMT_CACHE_KEY_MAX);
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    size_t idx = fmt_cache_idx(type, key, key_size);
+    bool found = false;
+
+    pthread_mutex_lock(&fmt_cache_lock);
+    const struct pl_fmt_cache *cache = impl->fmt_cache;
+    const struct fmt_cache_entry *e = cache ? &cache->entries[idx] : NULL;
+    if (e && e->type == type && e->key_size == key_size &&
+        memcmp(e->key, key, key_size) == 0)
+    {
+        *out_fmt = e->fmt;
+        if (out_map)
+            memcpy(out_map, e->map, sizeof(e->map));
+        found = true;
+    }
+    pthread_mutex_unlock(&fmt_cache_lock);
+
+    return found;
+}
+
+void pl_fmt_cache_put(const struct pl_gpu *gpu, enum pl_fmt_cache_type type,
+                      const void *key, size_t key_size,
+                      const struct pl_fmt *fmt, const int map[4])
+{
+    pl_assert(key_size && key_size <= PL_FMT_CACHE_KEY_MAX);
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    size_t idx = fmt_cache_idx(type, key, key_size);
+
+    pthread_mutex_lock(&fmt_cache_lock);
+    if (!impl->fmt_cache)
+        impl->fmt_cache = talloc_zero(NULL, struct pl_fmt_cache);
+
+    struct fmt_cache_entry *e = &impl->fmt_cache->entries[idx];
+    *e = (struct fmt_cache_entry) {
+        .type = type,
+        .key_size = key_size,
+        .fmt = fmt,
+    };
+    memcpy(e->key, key, key_size);
+    if (map)
+        memcpy(e->map, map, sizeof(e->map));
+    pthread_mutex_unlock(&fmt_cache_lock);
+}
+
+// Protects the `tex_pool` and `import_cache` of all `pl_gpu`s, since they may
+// be accessed by any number of users (renderers etc.) at the same time
+static pthread_mutex_t tex_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const struct pl_tex *pl_tex_pool_get(const struct pl_gpu *gpu,
+                                     const struct pl_tex_params *params)
+{
+    require(!params->initial_data);
+    require(!params->import_handle && !params->export_handle);
+
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    const struct pl_tex *tex = NULL;
+
+    pthread_mutex_lock(&tex_pool_lock);
+    struct pl_tex_pool *pool = impl->tex_pool;
+    for (int i = pool ? pool->num_free - 1 : -1; i >= 0; i--) {
+        if (pl_tex_params_superset(pool->free[i]->params, *params)) {
+            tex = pool->free[i];
+            TARRAY_REMOVE_AT(pool->free, pool->num_free, i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+
+    if (tex) {
+        PL_TRACE(gpu, "Reusing pooled %dx%dx%d texture",
+                 params->w, params->h, params->d);
+        pl_tex_invalidate(gpu, tex);
+        return tex;
+    }
+
+    PL_INFO(gpu, "Creating pooled %dx%dx%d texture",
+            params->w, params->h, params->d);
+    return pl_tex_create(gpu, params);
+
+error:
+    return NULL;
+}
+
+void pl_tex_pool_put(const struct pl_gpu *gpu, const struct pl_tex **tex)
+{
+    if (!*tex)
+        return;
+
+    const struct pl_tex_params *params = &(*tex)->params;
+    pl_assert(!params->import_handle && !params->export_handle);
+
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    const struct pl_tex *evict = NULL;
+
+    pthread_mutex_lock(&tex_pool_lock);
+    if (!impl->tex_pool)
+        impl->tex_pool = talloc_zero(NULL, struct pl_tex_pool);
+
+    struct pl_tex_pool *pool = impl->tex_pool;
+    TARRAY_APPEND(pool, pool->free, pool->num_free, *tex);
+    if (pool->num_free > PL_TEX_POOL_MAX_FREE) {
+        evict = pool->free[0];
+        TARRAY_REMOVE_AT(pool->free, pool->num_free, 0);
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+
+    pl_tex_destroy(gpu, &evict);
+    *tex = NULL;
+}
+
+bool pl_tex_pool_recreate(const struct pl_gpu *gpu, const struct pl_tex **tex,
+                          const struct pl_tex_params *params)
+{
+    if (*tex && pl_tex_params_superset((*tex)->params, *params)) {
+        pl_tex_invalidate(gpu, *tex);
+        return true;
+    }
+
+    pl_tex_pool_put(gpu, tex);
+    *tex = pl_tex_pool_get(gpu, params);
+    return !!*tex;
+}
+
+static bool tex_import_identity(const struct pl_tex_params *params,
+                                struct tex_import_entry *entry)
+{
+    // Hardware decoders re-export the same surfaces as fresh file
+    // descriptors, so the fd number itself is meaningless. The inode of a
+    // DMA-BUF is stable for the lifetime of the buffer, and since imported
+    // textures hold a reference to it, it can't be recycled while cached.
+    if (params->import_handle != PL_HANDLE_DMA_BUF)
+        return false;
+
+#ifdef __linux__
+    // Before Linux 5.3, all DMA-BUFs shared the same anonymous inode, so
+    // only trust inodes from the dedicated dmabuf pseudo-filesystem
+    int fd = params->shared_mem.handle.fd;
+    struct statfs sfs;
+    if (fstatfs(fd, &sfs) != 0 || sfs.f_type != DMA_BUF_MAGIC)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return false;
+
+    *entry = (struct tex_import_entry) {
+        .dev = st.st_dev,
+        .ino = st.st_ino,
+        .size = params->shared_mem.size,
+        .offset = params->shared_mem.offset,
+        .format = params->format,
+    };
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool tex_import_same_mem(const struct tex_import_entry *a,
+                                const struct tex_import_entry *b)
+{
+    return a->dev == b->dev && a->ino == b->ino &&
+           a->size == b->size && a->offset == b->offset &&
+           a->format == b->format;
+}
+
+static bool tex_import_compatible(const struct pl_tex *tex,
+                                  const struct pl_tex_params *params)
+{
+    const struct pl_shared_mem *a = &tex->params.shared_mem,
+                               *b = &params->shared_mem;
+
+    return tex->params.import_handle == params->import_handle &&
+           a->size == b->size && a->offset == b->offset &&
+           a->pitch == b->pitch &&
+           a->has_drm_format_mod == b->has_drm_format_mod &&
+           a->drm_format_mod == b->drm_format_mod &&
+           a->dedicated == b->dedicated &&
+           pl_tex_params_superset(tex->params, *params);
+}
+
+const struct pl_tex *pl_tex_import_get(const struct pl_gpu *gpu,
+                                       const struct pl_tex_params *params)
+{
+    require(params->import_handle);
+    require(!params->initial_data);
+
+    struct tex_import_entry entry;
+    if (!tex_import_identity(params, &entry))
+        return pl_tex_create(gpu, params);
+
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+
+    pthread_mutex_lock(&tex_pool_lock);
+    struct pl_tex_import_cache *cache = impl->import_cache;
+    for (int i = cache ? cache->num_idle - 1 : -1; i >= 0; i--) {
+        const struct tex_import_entry *e = &cache->idle[i];
+        if (tex_import_same_mem(e, &entry) &&
+            tex_import_compatible(e->tex, params))
+        {
+            entry.tex = e->tex;
+            TARRAY_REMOVE_AT(cache->idle, cache->num_idle, i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+
+    if (entry.tex) {
+        PL_TRACE(gpu, "Reusing imported %dx%d texture", params->w, params->h);
+    } else {
+        PL_DEBUG(gpu, "Importing %dx%d texture", params->w, params->h);
+        entry.tex = pl_tex_create(gpu, params);
+        if (!entry.tex)
+            return NULL;
+    }
+
+    // Remember the identity for `pl_tex_import_put`, since the handle
+    // itself is only guaranteed to be valid for the duration of this call
+    pthread_mutex_lock(&tex_pool_lock);
+    if (!impl->import_cache)
+        impl->import_cache = talloc_zero(NULL, struct pl_tex_import_cache);
+    cache = impl->import_cache;
+    TARRAY_APPEND(cache, cache->active, cache->num_active, entry);
+    pthread_mutex_unlock(&tex_pool_lock);
+    return entry.tex;
+
+error:
+    return NULL;
+}
+
+// Drops a texture that was destroyed directly from the list of active
+// imports, to prevent a future texture at the same address from inheriting
+// its identity
+static void tex_import_forget(const struct pl_gpu *gpu, const struct pl_tex *tex)
+{
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+
+    pthread_mutex_lock(&tex_pool_lock);
+    struct pl_tex_import_cache *cache = impl->import_cache;
+    for (int i = 0; cache && i < cache->num_active; i++) {
+        if (cache->active[i].tex == tex) {
+            TARRAY_REMOVE_AT(cache->active, cache->num_active, i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+}
+
+void pl_tex_import_put(const struct pl_gpu *gpu, const struct pl_tex **tex)
+{
+    if (!*tex)
+        return;
+
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    const struct pl_tex *evict = *tex;
+
+    pthread_mutex_lock(&tex_pool_lock);
+    struct pl_tex_import_cache *cache = impl->import_cache;
+    for (int i = 0; cache && i < cache->num_active; i++) {
+        struct tex_import_entry e = cache->active[i];
+        if (e.tex != *tex)
+            continue;
+
+        TARRAY_REMOVE_AT(cache->active, cache->num_active, i);
+        TARRAY_APPEND(cache, cache->idle, cache->num_idle, e);
+        evict = NULL;
+        if (cache->num_idle > PL_TEX_IMPORT_CACHE_SIZE) {
+            evict = cache->idle[0].tex;
+            TARRAY_REMOVE_AT(cache->idle, cache->num_idle, 0);
+        }
+        break;
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+
+    pl_tex_destroy(gpu, &evict);
+    *tex = NULL;
+}
+
+void pl_tex_import_cache_flush(const struct pl_gpu *gpu)
+{
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+
+    pthread_mutex_lock(&tex_pool_lock);
+    struct pl_tex_import_cache *cache = impl->import_cache;
+    struct tex_import_entry *idle = cache ? cache->idle : NULL;
+    int num_idle = cache ? cache->num_idle : 0;
+    if (cache) {
+        cache->idle = NULL;
+        cache->num_idle = 0;
+    }
+    pthread_mutex_unlock(&tex_pool_lock);
+
+    for (int i = 0; i < num_idle; i++)
+        pl_tex_destroy(gpu, &idle[i].tex);
+    talloc_free(idle);
+}
+
 void pl_buf_pool_uninit(const struct pl_gpu *gpu, struct pl_buf_pool *pool)
 {
     for (int i = 0; i < pool->num_buffers; i++)
@@ -1280,7 +1783,100 @@ error:
     return NULL;
 }
 
-bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
+void pl_buf_ring_uninit(const struct pl_gpu *gpu, struct pl_buf_ring *ring)
+{
+    for (int i = 0; i < ring->num_buffers; i++)
+        pl_buf_destroy(gpu, &ring->buffers[i]);
+
+    talloc_free(ring->buffers);
+    *ring = (struct pl_buf_ring) {0};
+}
+
+static bool pl_buf_ring_grow(const struct pl_gpu *gpu, struct pl_buf_ring *ring)
+{
+    const struct pl_buf *buf = pl_buf_create(gpu, &ring->current_params);
+    if (!buf)
+        return false;
+
+    TARRAY_INSERT_AT(NULL, ring->buffers, ring->num_buffers, ring->index, buf);
+    ring->offset = 0;
+    PL_DEBUG(gpu, "Resized buffer ring of type %u to %d x %zu bytes",
+             ring->current_params.type, ring->num_buffers,
+             ring->current_params.size);
+    return true;
+}
+
+const struct pl_buf *pl_buf_ring_alloc(const struct pl_gpu *gpu,
+                                       struct pl_buf_ring *ring,
+                                       const struct pl_buf_params *params,
+                                       size_t align, size_t *out_offset)
+{
+    require(!params->initial_data);
+    require(gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS);
+
+    struct pl_buf_params bufparams = *params;
+    bufparams.host_mapped = true;
+    if (!pl_buf_params_superset(ring->current_params, bufparams)) {
+        // Wait for all previous allocations to retire first, since pending
+        // transfer callbacks may still refer to the contents of the buffers
+        for (int i = 0; i < ring->num_buffers; i++)
+            while (pl_buf_poll(gpu, ring->buffers[i], UINT64_MAX)) ;
+        pl_buf_ring_uninit(gpu, ring);
+        bufparams.size = PL_MAX(bufparams.size, PL_BUF_RING_MIN_SIZE);
+        ring->current_params = bufparams;
+    }
+
+    // Make sure we have at least one buffer available
+    if (!ring->buffers) {
+        if (!pl_buf_ring_grow(gpu, ring))
+            return NULL;
+        goto done;
+    }
+
+    size_t offset = PL_ALIGN(ring->offset, align);
+    if (offset + params->size <= ring->current_params.size) {
+        ring->offset = offset;
+        goto done;
+    }
+
+    // The current buffer is exhausted, so move on to the next one. This is
+    // only safe to reuse once all previous allocations from it have retired
+    ring->index = (ring->index + 1) % ring->num_buffers;
+    ring->offset = 0;
+    if (!pl_buf_poll(gpu, ring->buffers[ring->index], 0))
+        goto done;
+
+    if (ring->num_buffers < PL_BUF_RING_MAX_BUFFERS) {
+        if (pl_buf_ring_grow(gpu, ring))
+            goto done;
+
+        // Failed growing the buffer ring, so just error out early
+        return NULL;
+    }
+
+    // Can't resize any further, so just loop until the buffer is usable
+    while (pl_buf_poll(gpu, ring->buffers[ring->index], 1000000000)) // 1s
+        PL_TRACE(gpu, "Blocked on buffer ring availability! (slow path)");
+
+done:
+    *out_offset = ring->offset;
+    ring->offset += params->size;
+    return ring->buffers[ring->index];
+
+error:
+    return NULL;
+}
+
+static size_t pbo_align(const struct pl_gpu *gpu,
+                        const struct pl_tex_transfer_params *params)
+{
+    size_t align = params->tex->params.format->texel_size;
+    if (gpu->limits.align_tex_xfer_offset)
+        align = pl_lcm(align, gpu->limits.align_tex_xfer_offset);
+    return align;
+}
+
+bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_ring *pbo,
                        const struct pl_tex_transfer_params *params)
 {
     if (params->buf)
@@ -1292,20 +1888,40 @@ bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
         .host_writable = true,
     };
 
-    const struct pl_buf *buf = pl_buf_pool_get(gpu, pbo, &bufparams);
+    size_t offset;
+    const struct pl_buf *buf;
+    buf = pl_buf_ring_alloc(gpu, pbo, &bufparams, pbo_align(gpu, params), &offset);
     if (!buf)
         return false;
 
-    pl_buf_write(gpu, buf, 0, params->ptr, bufparams.size);
+    memcpy(buf->data + offset, params->ptr, bufparams.size);
 
     struct pl_tex_transfer_params newparams = *params;
     newparams.buf = buf;
+    newparams.buf_offset = offset;
     newparams.ptr = NULL;
 
     return pl_tex_upload(gpu, &newparams);
 }
 
-bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
+struct pbo_download {
+    const struct pl_buf *buf;
+    size_t offset;
+    size_t size;
+    void *ptr;
+    void (*callback)(void *priv);
+    void *priv;
+};
+
+static void pbo_download_cb(void *priv)
+{
+    struct pbo_download *dl = priv;
+    memcpy(dl->ptr, dl->buf->data + dl->offset, dl->size);
+    dl->callback(dl->priv);
+    talloc_free(dl);
+}
+
+bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_ring *pbo,
                          const struct pl_tex_transfer_params *params)
 {
     if (params->buf)
@@ -1317,14 +1933,40 @@ bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
         .host_readable = true,
     };
 
-    const struct pl_buf *buf = pl_buf_pool_get(gpu, pbo, &bufparams);
+    size_t offset;
+    const struct pl_buf *buf;
+    buf = pl_buf_ring_alloc(gpu, pbo, &bufparams, pbo_align(gpu, params), &offset);
     if (!buf)
         return false;
 
     struct pl_tex_transfer_params newparams = *params;
     newparams.buf = buf;
+    newparams.buf_offset = offset;
     newparams.ptr = NULL;
 
+    if (params->callback) {
+        // Asynchronous readback: copy the data out of the buffer from within
+        // the transfer callback, once the download has actually completed
+        struct pbo_download *dl = talloc_ptrtype(NULL, dl);
+        *dl = (struct pbo_download) {
+            .buf = buf,
+            .offset = offset,
+            .size = bufparams.size,
+            .ptr = params->ptr,
+            .callback = params->callback,
+            .priv = params->priv,
+        };
+
+        newparams.callback = pbo_download_cb;
+        newparams.priv = dl;
+        if (!pl_tex_download(gpu, &newparams)) {
+            talloc_free(dl);
+            return false;
+        }
+
+        return true;
+    }
+
     if (!pl_tex_download(gpu, &newparams))
         return false;
 
@@ -1333,7 +1975,8 @@ bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
         while (pl_buf_poll(gpu, buf, UINT64_MAX)) ;
     }
 
-    return pl_buf_read(gpu, buf, 0, params->ptr, bufparams.size);
+    memcpy(params->ptr, buf->data + offset, bufparams.size);
+    return true;
 }
 
 bool pl_tex_upload_texel(const struct pl_gpu *gpu, struct pl_dispatch *dp,
@@ -1378,12 +2021,12 @@ bool pl_tex_upload_texel(const struct pl_gpu *gpu, struct pl_dispatch *dp,
     for (int i = 0; i < fmt->num_components; i++)
         GLSL("color[%d] = texelFetch(%s, base + %d).r; \n", i, buf, i);
 
-    // If the transfer width is a natural multiple of the thread size, we
-    // can skip the bounds check. Otherwise, make sure we aren't blitting out
-    // of the range since this would violate semantics
+    // Stores past the edge of the texture are discarded anyway, but make sure
+    // we aren't blitting out of the range since this would violate semantics.
+    // (The thread count may be tuned by the dispatch, so always check this)
     int groups_x = (pl_rect_w(params->rc) + threads - 1) / threads;
     bool is_crop = params->rc.x1 != params->tex->params.w;
-    if (is_crop && groups_x * threads != pl_rect_w(params->rc))
+    if (is_crop)
         GLSL("if (gl_GlobalInvocationID.x < %d)\n", pl_rect_w(params->rc));
 
     int dims = pl_tex_params_dimension(tex->params);
@@ -1401,6 +2044,8 @@ bool pl_tex_upload_texel(const struct pl_gpu *gpu, struct pl_dispatch *dp,
             pl_rect_h(params->rc),
             pl_rect_d(params->rc),
         },
+        .width  = pl_rect_w(params->rc),
+        .height = pl_rect_h(params->rc),
     });
 
 error:
@@ -1454,9 +2099,9 @@ bool pl_tex_download_texel(const struct pl_gpu *gpu, struct pl_dispatch *dp,
          params->stride_h, params->stride_w, fmt->num_components,
          img, coord_types[dims]);
 
+    // The thread count may be tuned by the dispatch, so always bounds check
     int groups_x = (pl_rect_w(params->rc) + threads - 1) / threads;
-    if (groups_x * threads != pl_rect_w(params->rc))
-        GLSL("if (gl_GlobalInvocationID.x < %d)\n", pl_rect_w(params->rc));
+    GLSL("if (gl_GlobalInvocationID.x < %d)\n", pl_rect_w(params->rc));
 
     GLSL("{\n");
     for (int i = 0; i < fmt->num_components; i++)
@@ -1470,6 +2115,8 @@ bool pl_tex_download_texel(const struct pl_gpu *gpu, struct pl_dispatch *dp,
             pl_rect_h(params->rc),
             pl_rect_d(params->rc),
         },
+        .width  = pl_rect_w(params->rc),
+        .height = pl_rect_h(params->rc),
     });
 
 error:
@@ -1501,6 +2148,16 @@ struct pl_pass_params pl_pass_params_copy(void *tactx,
 
 #undef DUPNAMES
 
+    size_t const_size = 0;
+    for (int i = 0; i < new.num_constants; i++) {
+        const struct pl_constant *c = &new.constants[i];
+        const_size = PL_MAX(const_size, c->offset + pl_var_type_size(c->type));
+    }
+
+    new.constants = TARRAY_DUP(tactx, new.constants, new.num_constants);
+    if (const_size)
+        new.constant_data = talloc_memdup(tactx, new.constant_data, const_size);
+
     return new;
 }
 
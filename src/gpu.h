@@ -55,6 +55,15 @@ struct pl_gpu_fns {
     GPU_PFN(timer_query); // optional
     GPU_PFN(gpu_flush); // optional
     GPU_PFN(gpu_finish);
+    uint64_t (*gpu_submits)(const struct pl_gpu *); // optional
+
+    // Generic state shared between all users of this `pl_gpu`. This is
+    // managed by the common code and must be left zero by the backends.
+    struct pl_tex_pool *tex_pool;
+    struct pl_tex_import_cache *import_cache; // see `pl_tex_import_get`
+    struct pl_lut_cache *lut_cache; // see `sh_lut`
+    struct pl_fmt_cache *fmt_cache; // see `pl_fmt_cache_get`
+    struct pl_gpu_stats stats; // updated atomically, see `pl_gpu_stats`
 };
 #undef GPU_PFN
 
@@ -90,6 +99,10 @@ void pl_gpu_verify_formats(struct pl_gpu *gpu);
 // Pretty-print the format list
 void pl_gpu_print_formats(const struct pl_gpu *gpu, enum pl_log_level lev);
 
+// Look up the DRM fourcc code matching a partially filled-in pl_fmt, or 0 if
+// the format has no equivalent DRM_FORMAT_* representation.
+uint32_t pl_fmt_fourcc(const struct pl_fmt *fmt);
+
 // Look up the right GLSL image format qualifier from a partially filled-in
 // pl_fmt, or NULL if the format does not have a legal matching GLSL name.
 //
@@ -99,6 +112,34 @@ const char *pl_fmt_glsl_format(const struct pl_fmt *fmt, int components);
 // Compute the total size (in bytes) of a texture transfer operation
 size_t pl_tex_transfer_size(const struct pl_tex_transfer_params *par);
 
+// Infer the default values of a texture transfer operation (rect, strides),
+// and validate the result. Returns false if the parameters are invalid.
+bool pl_tex_transfer_fix(const struct pl_gpu *gpu,
+                         struct pl_tex_transfer_params *params);
+
+// Memoization of format lookups (e.g. `pl_find_fmt`), since these involve
+// linear scans over the format list and are performed very frequently. The
+// cache is keyed on the kind of lookup and the raw bytes of `key`, which must
+// not contain any uninitialized padding. Both the resulting format (which may
+// be NULL, for failed lookups) and an optional component mapping are stored.
+enum pl_fmt_cache_type {
+    PL_FMT_CACHE_FIND,  // pl_find_fmt
+    PL_FMT_CACHE_PLANE, // pl_plane_find_fmt
+};
+
+#define PL_FMT_CACHE_KEY_MAX 64
+
+// Returns true if a cached result was found, which is written to
+// `out_fmt` and (if non-NULL) `out_map`.
+bool pl_fmt_cache_get(const struct pl_gpu *gpu, enum pl_fmt_cache_type type,
+                      const void *key, size_t key_size,
+                      const struct pl_fmt **out_fmt, int out_map[4]);
+
+// `map` may be NULL if the lookup has no component mapping
+void pl_fmt_cache_put(const struct pl_gpu *gpu, enum pl_fmt_cache_type type,
+                      const void *key, size_t key_size,
+                      const struct pl_fmt *fmt, const int map[4]);
+
 // A hard-coded upper limit on a pl_buf_pool's size, to prevent OOM loops
 #define PL_BUF_POOL_MAX_BUFFERS 8
 
@@ -117,11 +158,104 @@ const struct pl_buf *pl_buf_pool_get(const struct pl_gpu *gpu,
                                      struct pl_buf_pool *pool,
                                      const struct pl_buf_params *params);
 
-// Helper that wraps pl_tex_upload/download using texture upload buffers to
-// ensure that params->buf is always set.
-bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
+// Minimum size of each buffer in a `pl_buf_ring`, and hard-coded upper limit on
+// the number of buffers, to prevent OOM loops
+#define PL_BUF_RING_MIN_SIZE (16 << 20) // 16 MiB
+#define PL_BUF_RING_MAX_BUFFERS 4
+
+// A ring of large, persistently mapped buffers, which variable-sized transfers
+// are linearly sub-allocated from. A buffer is only reused once the GPU has
+// retired all previous allocations from it (as tracked by `pl_buf_poll`), so
+// allocating from the ring rarely blocks and never needs to reallocate unless
+// a single transfer exceeds the current buffer size.
+struct pl_buf_ring {
+    struct pl_buf_params current_params; // `size` is the size of each buffer
+    const struct pl_buf **buffers;
+    int num_buffers;
+    int index;      // buffer currently being allocated from
+    size_t offset;  // current offset into `buffers[index]`
+};
+
+void pl_buf_ring_uninit(const struct pl_gpu *gpu, struct pl_buf_ring *ring);
+
+// Allocates `params->size` bytes from the ring, with the offset aligned to a
+// multiple of `align`. The returned buffer is always `host_mapped`, and the
+// allocation remains valid until it is used by the GPU. Requires
+// PL_GPU_CAP_MAPPED_BUFFERS. Note: params->initial_data is *not* supported
+const struct pl_buf *pl_buf_ring_alloc(const struct pl_gpu *gpu,
+                                       struct pl_buf_ring *ring,
+                                       const struct pl_buf_params *params,
+                                       size_t align, size_t *out_offset);
+
+// A hard-coded upper limit on the number of free textures kept around by a
+// `pl_gpu`'s shared texture pool
+#define PL_TEX_POOL_MAX_FREE 16
+
+struct pl_tex_pool {
+    const struct pl_tex **free; // sorted from least to most recently released
+    int num_free;
+};
+
+// Acquire a texture from the `pl_gpu`'s texture pool, which is shared between
+// all users of the `pl_gpu` (e.g. several renderers). If no compatible free
+// texture is available, a new one is created. The contents of the returned
+// texture are undefined. Note: params->initial_data, import_handle and
+// export_handle are *not* supported
+const struct pl_tex *pl_tex_pool_get(const struct pl_gpu *gpu,
+                                     const struct pl_tex_params *params);
+
+// Hand a texture back to the texture pool, for use by future calls to
+// `pl_tex_pool_get`. Only the `PL_TEX_POOL_MAX_FREE` most recently released
+// textures are kept around, older textures get destroyed. Sets *tex to NULL.
+void pl_tex_pool_put(const struct pl_gpu *gpu, const struct pl_tex **tex);
+
+// Equivalent to `pl_tex_recreate`, except that incompatible textures are
+// exchanged with the texture pool instead of being destroyed and recreated.
+bool pl_tex_pool_recreate(const struct pl_gpu *gpu, const struct pl_tex **tex,
+                          const struct pl_tex_params *params);
+
+// A hard-coded upper limit on the number of idle imported textures kept
+// around by a `pl_gpu`'s import cache
+#define PL_TEX_IMPORT_CACHE_SIZE 32
+
+struct pl_tex_import_cache {
+    struct tex_import_entry {
+        const struct pl_tex *tex;
+        // Identity of the imported memory
+        uint64_t dev, ino;
+        size_t size, offset;
+        const struct pl_fmt *format;
+    } *idle, *active; // `idle` is sorted from least to most recently released
+    int num_idle, num_active;
+};
+
+// Import a texture from external memory, re-using a previously imported
+// texture if it was created from the same underlying memory object with
+// compatible parameters. This avoids re-importing the same memory over and
+// over again for e.g. the recycled surface pools of hardware decoders.
+// Memory objects are identified by their device and inode numbers (as
+// reported by fstat), together with the imported size, offset and format.
+// Only PL_HANDLE_DMA_BUF imports are cached, and only if the kernel gives
+// each DMA-BUF a unique inode (Linux 5.3+). Otherwise, this is equivalent to
+// `pl_tex_create`.
+const struct pl_tex *pl_tex_import_get(const struct pl_gpu *gpu,
+                                       const struct pl_tex_params *params);
+
+// Hand a texture obtained from `pl_tex_import_get` back to the import cache.
+// Only the `PL_TEX_IMPORT_CACHE_SIZE` most recently released textures are
+// kept around, older textures get destroyed. Note that cached textures keep
+// their underlying memory alive, until released by
+// `pl_tex_import_cache_flush`. Other textures are simply destroyed. Sets *tex
+// to NULL.
+void pl_tex_import_put(const struct pl_gpu *gpu, const struct pl_tex **tex);
+
+// Helper that wraps pl_tex_upload/download using a streaming buffer ring to
+// ensure that params->buf is always set. Requires PL_GPU_CAP_MAPPED_BUFFERS.
+// If params->callback is set, downloads are performed asynchronously, with
+// the data being copied to params->ptr right before the callback fires.
+bool pl_tex_upload_pbo(const struct pl_gpu *gpu, struct pl_buf_ring *pbo,
                        const struct pl_tex_transfer_params *params);
-bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_pool *pbo,
+bool pl_tex_download_pbo(const struct pl_gpu *gpu, struct pl_buf_ring *pbo,
                          const struct pl_tex_transfer_params *params);
 
 // This requires that params.buf has been set and is of type PL_BUF_TEXEL_*
@@ -18,6 +18,7 @@
 #ifndef LIBPLACEBO_CONTEXT_H_
 #define LIBPLACEBO_CONTEXT_H_
 
+#include <stdint.h>
 #include <libplacebo/config.h>
 
 // Meta-object to serve as a global entrypoint for the purposes of resource
@@ -40,6 +41,24 @@ enum pl_log_level {
     PL_LOG_ALL = PL_LOG_TRACE,
 };
 
+// A single timed event, as reported to `pl_context_params.trace_cb`. Events
+// are reported once they have ended, and are not necessarily reported in
+// chronological order.
+struct pl_trace_event {
+    const char *category;   // the subsystem, e.g. "dispatch" or "renderer"
+    const char *name;       // the operation, e.g. "compile" or "upload"
+    uint64_t start_ns;      // CLOCK_MONOTONIC timestamp (where available)
+    uint64_t duration_ns;
+
+    // A small number identifying the CPU thread the event occurred on,
+    // starting at 1. Events measured on the GPU (by `pl_timer` objects) use
+    // thread 0 instead. Since GPU timer results become available only
+    // asynchronously, these events are placed on the timeline such that they
+    // end at the time their result was retrieved, which may be a few frames
+    // after the GPU actually executed them.
+    int thread;
+};
+
 // Global options for a pl_context.
 struct pl_context_params {
     // Logging callback. All messages, informational or otherwise, will get
@@ -54,6 +73,15 @@ struct pl_context_params {
     // in increased CPU usage as it may enable extra debug paths based on the
     // configured log level.
     enum pl_log_level log_level;
+
+    // Tracing callback. If set, timed events for various internal operations
+    // (e.g. renderer stages, shader dispatches and compilation, texture
+    // transfers, command submission, swapchain operations) are reported to
+    // this callback, which may be called from any thread but never
+    // concurrently. Optional. `pl_trace_chrome` can be used to write these
+    // events out for viewing in chrome://tracing or the Perfetto UI.
+    void (*trace_cb)(void *trace_priv, const struct pl_trace_event *ev);
+    void *trace_priv;
 };
 
 // Creates a new, blank pl_context. The argument `api_ver` must be given as
@@ -94,4 +122,10 @@ void pl_context_update(struct pl_context *ctx,
 void pl_log_simple(void *stream, enum pl_log_level level, const char *msg);
 void pl_log_color(void *stream, enum pl_log_level level, const char *msg);
 
+// A simple tracing callback, writing each event as a JSON object in the Chrome
+// trace event format to the FILE* given as `trace_priv` (or stdout). The
+// output must be preceded by a single `[` to form a valid trace file; the
+// closing bracket may be omitted.
+void pl_trace_chrome(void *stream, const struct pl_trace_event *ev);
+
 #endif // LIBPLACEBO_CONTEXT_H_
@@ -45,7 +45,9 @@ struct pl_dispatch_params {
 
     // The texture to render to. This must have params compatible with the
     // shader, i.e. `target->params.renderable` for fragment shaders and
-    // `target->params.storable` for compute shaders.
+    // `target->params.storable` for compute shaders. Fragment shaders may
+    // also target storable textures that are not renderable, as long as they
+    // can be transparently converted into compute shaders.
     //
     // Note: Even when not using compute shaders, users are advised to always
     // set `target->params.storable` if permitted by the `pl_fmt`, since this
@@ -57,6 +59,20 @@ struct pl_dispatch_params {
     // entire texture will be rendered to.
     struct pl_rect2d rect;
 
+    // If set, only draws the given sub-rectangles of `rect`, all as part of a
+    // single draw call. This is useful for e.g. drawing multiple overlays or
+    // tiles that share the same shader, without having to dispatch the shader
+    // once per rect. The vertex attributes of the shader (including the
+    // position) are interpolated across `rect` as usual, so every sub-rect
+    // sees the same values as it would if the entire `rect` was drawn.
+    // Optional, if left as NULL, the entire `rect` is drawn.
+    //
+    // Note: This forces the use of a fragment shader, so the target must be
+    // renderable. Sub-rects may overlap, in which case the order in which
+    // they are drawn is unspecified.
+    const struct pl_rect2d *rects;
+    int num_rects;
+
     // If set, enables and controls the blending for this pass. Optional. When
     // using this with fragment shaders, `target->params.fmt->caps` must
     // include `PL_FMT_CAP_BLENDABLE`.
@@ -65,6 +81,12 @@ struct pl_dispatch_params {
     // If set, records the execution time of this dispatch into the given
     // timer object. Optional.
     struct pl_timer *timer;
+
+    // Marks this pass as independent of the surrounding rendering, allowing
+    // it to be executed on an asynchronous compute queue. Only has an effect
+    // if the shader is dispatched as a compute shader. See
+    // `pl_pass_run_params.async`.
+    bool async;
 };
 
 // Dispatch a generated shader (via the pl_shader mechanism). Returns whether
@@ -88,12 +110,22 @@ struct pl_dispatch_compute_params {
     // according to the given dimensions. The first two components of the
     // thread's global ID will be interpreted as the X and Y locations.
     //
+    // This also allows the work group size to be tuned (see
+    // `pl_dispatch_set_autotune`), in which case the first two components of
+    // `dispatch_size` are recomputed to cover these dimensions. The shader
+    // must then tolerate invocations outside of them.
+    //
     // Optional, ignored if either component is left as 0.
     int width, height;
 
     // If set, records the execution time of this dispatch into the given
     // timer object. Optional.
     struct pl_timer *timer;
+
+    // Marks this pass as independent of the surrounding rendering, allowing
+    // it to be executed on an asynchronous compute queue. See
+    // `pl_pass_run_params.async`.
+    bool async;
 };
 
 // A variant of `pl_dispatch_finish`, this one only dispatches a compute shader
@@ -101,8 +133,170 @@ struct pl_dispatch_compute_params {
 bool pl_dispatch_compute(struct pl_dispatch *dp,
                          const struct pl_dispatch_compute_params *params);
 
+enum pl_vertex_coords {
+    PL_COORDS_ABSOLUTE,     // Absolute/integer pixel coordinates of the target
+    PL_COORDS_RELATIVE,     // Relative coordinates in the range [0, 1]
+    PL_COORDS_NORMALIZED,   // GL-normalized coordinates in the range [-1, 1]
+};
+
+struct pl_dispatch_vertex_params {
+    // The shader to execute. This must be a fragment shader with the input
+    // signature set to PL_SHADER_SIG_NONE and the output signature set to
+    // PL_SHADER_SIG_COLOR, and must not have any vertex attributes of its own.
+    // The vertex attributes described below are available to the shader (as
+    // varyings) under their respective names.
+    struct pl_shader **shader;
+
+    // The texture to render to. Must have `target->params.renderable` set.
+    // Unlike `pl_dispatch_finish`, this always loads the existing contents of
+    // the target, since the geometry need not cover it.
+    const struct pl_tex *target;
+
+    // The target rect to clip rendering to. Optional, if left as {0}, the
+    // entire texture is used.
+    struct pl_rect2d scissors;
+
+    // If set, enables and controls the blending for this pass. Optional.
+    // `target->params.fmt->caps` must include `PL_FMT_CAP_BLENDABLE`.
+    const struct pl_blend_params *blend_params;
+
+    // The description of the vertex format, including offsets. The `location`
+    // fields are ignored, and assigned internally.
+    const struct pl_vertex_attrib *vertex_attribs;
+    int num_vertex_attribs;
+    size_t vertex_stride;
+
+    // The index of the vertex attribute corresponding to the vertex position.
+    // This attribute must be a 2-component PL_FMT_FLOAT, whose values are
+    // interpreted according to `vertex_coords`.
+    int vertex_position_idx;
+    enum pl_vertex_coords vertex_coords;
+    bool vertex_flipped; // flip the Y axis of `vertex_coords`
+
+    // Type and number of vertices to render. `vertex_data` is copied, and
+    // need not remain valid past the call to `pl_dispatch_vertex`.
+    enum pl_prim_type vertex_type;
+    int vertex_count;
+    const void *vertex_data;
+
+    // If set, records the execution time of this dispatch into the given
+    // timer object. Optional.
+    struct pl_timer *timer;
+};
+
+// A variant of `pl_dispatch_finish` which renders arbitrary user-provided
+// geometry instead of a single quad. This allows drawing many small,
+// disjoint primitives (e.g. the glyphs of a subtitle texture atlas) with a
+// single pass. Returns whether or not the dispatch was successful.
+bool pl_dispatch_vertex(struct pl_dispatch *dp,
+                        const struct pl_dispatch_vertex_params *params);
+
 // Cancel an active shader without submitting anything. Useful, for example,
 // if the shader was instead merged into a different shader.
 void pl_dispatch_abort(struct pl_dispatch *dp, struct pl_shader **sh);
 
+// Enables or disables asynchronous pass compilation. (Disabled by default)
+//
+// When enabled, passes that are not yet cached get compiled on a background
+// thread instead of blocking the calling thread. Until compilation finishes,
+// `pl_dispatch_finish` and `pl_dispatch_compute` will skip executing the
+// shader - leaving the target contents untouched - but still return true. Use
+// `pl_dispatch_skipped` to detect this, e.g. in order to fall back to a
+// cheaper, already compiled shader in the meantime.
+//
+// Requires `PL_GPU_CAP_THREAD_SAFE`, and is ignored otherwise.
+void pl_dispatch_set_async(struct pl_dispatch *dp, bool async);
+
+// Returns the number of dispatches that were skipped due to pending
+// asynchronous compilation since the last call to this function.
+int pl_dispatch_skipped(struct pl_dispatch *dp);
+
+// Cumulative counters of the work performed by a `pl_dispatch`. These are
+// always maintained, and only ever increase.
+struct pl_dispatch_stats {
+    uint64_t dispatches;      // shaders submitted for execution
+    uint64_t cache_hits;      // dispatches which re-used a cached pass
+    uint64_t cache_misses;    // dispatches which required creating a new pass
+    uint64_t programs_reused; // new passes created from an already compiled
+                              // program (e.g. from `pl_dispatch_load`)
+    uint64_t ubo_updates;     // uniform buffer contents uploaded
+    uint64_t skipped;         // dispatches skipped due to pending async
+                              // compilation (see `pl_dispatch_skipped`)
+};
+
+void pl_dispatch_stats(const struct pl_dispatch *dp, struct pl_dispatch_stats *out);
+
+// Compiles the passes for a list of dispatches ahead of time, without
+// actually executing anything, so that subsequent calls to
+// `pl_dispatch_finish` with the same shaders (and compatible targets) can
+// re-use the cached passes. This is intended for avoiding stutter on startup,
+// when the required shaders are known in advance. Like `pl_dispatch_finish`,
+// this takes over ownership of all of the shaders. Blocks until all passes
+// are compiled, and returns false if any of them failed.
+//
+// If the GPU has `PL_GPU_CAP_THREAD_SAFE`, the passes are compiled in parallel
+// on up to `num_threads` compile threads (defaults to 4 if left as 0). These
+// threads are kept around for use by asynchronous compilation (see
+// `pl_dispatch_set_async`). Otherwise, the passes are compiled one by one on
+// the calling thread.
+//
+// Note: Which pass gets used depends on the target's format and capabilities,
+// the blend mode, and whether or not the entire target is drawn to. So the
+// targets and rects used here should match those of the real dispatches.
+bool pl_dispatch_warmup(struct pl_dispatch *dp,
+                        const struct pl_dispatch_params *params, int num_params,
+                        int num_threads);
+
+// Sets `pl_shader_params.reduced_precision` for all shaders subsequently
+// returned by `pl_dispatch_begin`. (Disabled by default)
+void pl_dispatch_set_reduced_precision(struct pl_dispatch *dp, bool enable);
+
+// Sets `pl_shader_params.specialize_constants` for all shaders subsequently
+// returned by `pl_dispatch_begin`. (Disabled by default)
+void pl_dispatch_set_specialize_constants(struct pl_dispatch *dp, bool enable);
+
+// Dispatch all shaders targeting storable textures as compute shaders where
+// possible, even on GPUs without `PL_GPU_CAP_PARALLEL_COMPUTE`. This skips
+// render pass setup and vertex processing entirely. (Disabled by default)
+//
+// Note: Shaders targeting textures which are storable but not renderable
+// are always dispatched as compute shaders, regardless of this setting.
+void pl_dispatch_set_prefer_compute(struct pl_dispatch *dp, bool enable);
+
+// Automatically tune the work group size of compute shaders whose group size
+// is not fixed by the shader itself (e.g. fragment shaders upgraded to compute
+// shaders, or HDR peak detection), as well as of built-in compute shaders
+// that support a choice of sizes (e.g. polar sampling). The first few
+// dispatches of every such shader cycle through a set of candidate sizes,
+// timing each with a GPU timer, after which the fastest size is used for all
+// subsequent dispatches of that shader. (Disabled by default)
+//
+// Tuning requires GPU timer support, and only measures dispatches without a
+// user-provided timer. Shaders dispatched via `pl_dispatch_compute` are only
+// tuned if `pl_dispatch_compute_params.width/height` are set. Note that every
+// candidate size requires compiling a separate pass. The results are included
+// in `pl_dispatch_save`, so they can be re-used on subsequent runs instead of
+// tuning again.
+void pl_dispatch_set_autotune(struct pl_dispatch *dp, bool enable);
+
+// Serialize the internal state of a `pl_dispatch` into an abstract cache
+// object that can be e.g. saved to disk and loaded again later. This contains
+// the compiled programs (`pl_pass_params.cached_program`) of all passes
+// currently held in the cache, indexed by their shader signature, as well as
+// any tuned work group sizes (see `pl_dispatch_set_autotune`), tagged with the
+// device UUID. Returns the number of bytes written to `out`. If `out` is NULL,
+// writes nothing and returns the number of bytes required to store the data.
+size_t pl_dispatch_save(struct pl_dispatch *dp, uint8_t *out);
+
+// Load the result of a previous `pl_dispatch_save` call. Subsequently created
+// passes will use the loaded programs where possible, which avoids expensive
+// shader compilation on startup. This does not affect any passes that are
+// already cached. Invalid, truncated or out-of-date data is ignored, so this
+// function never fails.
+//
+// Note: The cached data is GPU and driver specific. Loading a cache created
+// by a different GPU or driver is safe, but provides no benefit. Tuned work
+// group sizes are only loaded if the device UUID matches.
+void pl_dispatch_load(struct pl_dispatch *dp, const uint8_t *cache, size_t size);
+
 #endif // LIBPLACEBO_DISPATCH_H
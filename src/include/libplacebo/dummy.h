@@ -19,6 +19,7 @@
 #define LIBPLACEBO_DUMMY_H_
 
 #include <libplacebo/gpu.h>
+#include <libplacebo/renderer.h>
 
 // The functions in this file allow creating and manipulating "dummy" contexts.
 // A dummy context isn't actually mapped by the GPU, all data exists purely on
@@ -89,4 +90,50 @@ struct pl_tex_dummy_params {
 const struct pl_tex *pl_tex_dummy_create(const struct pl_gpu *gpu,
                                          const struct pl_tex_dummy_params *params);
 
+// CPU rendering fallback. Since a dummy GPU can't execute any shaders, the
+// regular `pl_renderer` can't produce any output with it. As an alternative,
+// `pl_dummy_render_image` performs a restricted subset of what
+// `pl_render_image` does directly on the host data of dummy textures, using
+// multi-threaded, vectorization-friendly kernels. This covers:
+//
+// - sampling and merging of (subsampled) planes, including chroma location
+// - scaling with any separable (non-polar) filter
+// - color decoding/encoding for RGB and matrix-based YCbCr color systems
+// - conversion between color primaries, for SDR transfer functions (the
+//   output is simply clipped, there is no tone or gamut mapping)
+// - bit encodings (e.g. P010-style shifted samples) of the image and target
+// - ordered dithering to the target's color depth
+//
+// Other features of the source image (overlays, ICC profiles, film grain and
+// alpha) are ignored, and the alpha channel of the output is set to 1.0.
+
+struct pl_dummy_render_params {
+    // The filter to use for scaling. Must be separable (not polar). If left
+    // as NULL, defaults to `pl_filter_triangle` (bilinear).
+    const struct pl_filter_config *scaler;
+
+    // Dither the output to the color depth of the target (as given by
+    // `target->repr.bits`, defaulting to the texture format's depth), using an
+    // ordered dither matrix. Only affects integer output formats.
+    bool dither;
+
+    // The number of threads to spread the work over. If left as 0, defaults
+    // to the number of online CPUs. Worker threads are kept around by the
+    // `pl_gpu` for re-use, until it is destroyed.
+    int threads;
+};
+
+// Bilinear scaling with dithering, using all CPUs
+extern const struct pl_dummy_render_params pl_dummy_render_default_params;
+
+// Renders `image` to `target`, analogous to `pl_render_image`. All textures
+// must be (non-placeholder) dummy textures with UNORM or FLOAT formats.
+// Returns false, leaving the target untouched, if the image uses any color
+// system or transfer function unsupported by this fallback. If `params` is
+// NULL, it defaults to `&pl_dummy_render_default_params`.
+bool pl_dummy_render_image(const struct pl_gpu *gpu,
+                           const struct pl_image *image,
+                           const struct pl_render_target *target,
+                           const struct pl_dummy_render_params *params);
+
 #endif // LIBPLACEBO_DUMMY_H_
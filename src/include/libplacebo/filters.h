@@ -238,6 +238,12 @@ struct pl_filter_params {
     // inverse of the scaling ratio, i.e. src_size / dst_size.
     float filter_scale;
 
+    // If set to a value above 1, the LUT computation is split up and spread
+    // over (up to) this many threads. This is mostly useful for very large
+    // LUTs, whose generation would otherwise take a noticeable amount of time.
+    // Setting this to 0 or 1 computes the LUT on the calling thread.
+    int threads;
+
     // --- polar filers only (config.polar)
 
     // As a micro-optimization, all samples below this cutoff value will be
@@ -39,6 +39,25 @@ struct pl_glsl_desc {
     int version;        // GLSL version (e.g. 450), for #version
     bool gles;          // GLSL ES semantics (ESSL)
     bool vulkan;        // GL_KHR_vulkan_glsl semantics
+
+    // If non-zero, compute shaders support the GL_KHR_shader_subgroup_basic
+    // and GL_KHR_shader_subgroup_arithmetic extensions, with the given
+    // (fixed) number of invocations per subgroup.
+    int subgroup_size;
+
+    // If true, the GPU supports native half-precision (16-bit) floating point
+    // arithmetic in shaders, so reduced precision (i.e. `mediump`) math is
+    // actually expected to be faster.
+    bool float16;
+};
+
+// Controls the optimization of the SPIR-V generated for shaders, for GPU
+// backends which compile GLSL to SPIR-V (i.e. Vulkan).
+enum pl_spirv_opt {
+    PL_SPIRV_OPT_PERFORMANCE = 0, // optimize for runtime performance
+    PL_SPIRV_OPT_SIZE,            // optimize for the size of the SPIR-V module
+    PL_SPIRV_OPT_NONE,            // don't optimize (faster shader compilation)
+    PL_SPIRV_OPT_COUNT,
 };
 
 typedef uint64_t pl_gpu_caps;
@@ -48,8 +67,17 @@ enum {
     PL_GPU_CAP_INPUT_VARIABLES  = 1 << 2, // supports shader input variables
     PL_GPU_CAP_MAPPED_BUFFERS   = 1 << 3, // supports host-mapped buffers
     PL_GPU_CAP_BLITTABLE_1D_3D  = 1 << 4, // supports blittable 1D/3D textures
+    PL_GPU_CAP_THREAD_SAFE      = 1 << 5, // may be used from multiple threads
 };
 
+// Note on PL_GPU_CAP_THREAD_SAFE: If set, all `pl_gpu` functions may be called
+// concurrently from different threads. The only exception is that individual
+// objects (e.g. a `pl_tex`) must not be operated on by more than one thread at
+// the same time. Also note that operations may be recorded into internal
+// (per-thread) command buffers, so when handing an object over to a thread
+// that is using a separate synchronization mechanism (e.g. an external API),
+// call `pl_gpu_flush` first. This submits the commands of all threads.
+
 // Some `pl_gpu` operations allow sharing GPU resources with external APIs -
 // examples include interop with other graphics APIs such as CUDA, and also
 // various hardware decoding APIs. This defines the mechanism underpinning the
@@ -60,6 +88,7 @@ enum pl_handle_type {
     PL_HANDLE_WIN32     = (1 << 1), // `HANDLE` for win32 API
     PL_HANDLE_WIN32_KMT = (1 << 2), // `HANDLE` for pre-Windows-8 win32 API
     PL_HANDLE_DMA_BUF   = (1 << 3), // 'int fd' for a dma_buf fd
+    PL_HANDLE_HOST_PTR  = (1 << 4), // `void *` for a host-allocated pointer
 };
 
 struct pl_gpu_handle_caps {
@@ -78,6 +107,7 @@ struct pl_gpu_handle_caps {
 union pl_handle {
     int fd;         // PL_HANDLE_FD / PL_HANDLE_DMA_BUF
     void *handle;   // PL_HANDLE_WIN32 / PL_HANDLE_WIN32_KMT
+    void *ptr;      // PL_HANDLE_HOST_PTR
 };
 
 // Structure encapsulating memory that is shared between libplacebo and the
@@ -90,8 +120,28 @@ struct pl_shared_mem {
     union pl_handle handle;
     size_t size;   // the total size of the memory referenced by this handle
     size_t offset; // the offset of the object within the referenced memory
+
+    // For importing PL_HANDLE_DMA_BUF textures only: The row pitch of the
+    // texture data in bytes (defaults to the tightly packed size if 0) and,
+    // if `has_drm_format_mod` is set, the DRM format modifier describing the
+    // tiling layout of the memory. Without a modifier, the implementation
+    // infers the layout, which only works for memory allocated by the same
+    // driver. Exported memory never has a modifier set.
+    bool has_drm_format_mod;
+    uint64_t drm_format_mod;
+    size_t pitch;
+
+    // If true, the memory was allocated specifically for the single texture
+    // it backs (e.g. VK_KHR_dedicated_allocation), and must be imported as
+    // such. This is set by the implementation for exported textures where
+    // applicable, and should be passed through unmodified when importing.
+    bool dedicated;
 };
 
+// Mirrors of the corresponding DRM_FORMAT_MOD_* values from <drm_fourcc.h>
+#define PL_DRM_FORMAT_MOD_LINEAR  0ULL
+#define PL_DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
+
 // Structure defining the physical limits of this GPU instance. If a limit is
 // given as 0, that means that feature is unsupported.
 struct pl_gpu_limits {
@@ -105,6 +155,9 @@ struct pl_gpu_limits {
     uint64_t max_buffer_texels; // maximum texels in a PL_BUF_TEXEL_*
     int16_t min_gather_offset;  // minimum `textureGatherOffset` offset
     int16_t max_gather_offset;  // maximum `textureGatherOffset` offset
+    size_t align_ubo_offset;    // required alignment of `pl_desc_binding.offset`
+                                // for PL_DESC_BUF_UNIFORM (0 = unsupported)
+    int max_constants;          // maximum `pl_pass_params.num_constants`
 
     // Compute shader limits. Always available (non-zero) if PL_GPU_CAP_COMPUTE set
     size_t max_shmem_size;      // maximum compute shader shared memory size
@@ -224,6 +277,18 @@ struct pl_fmt {
     // (PL_FMT_CAP_STORABLE / PL_FMT_CAP_TEXEL_STORAGE), this gives the GLSL
     // texel format corresponding to the format. (e.g. rgba16ui)
     const char *glsl_format;
+
+    // If this format has an equivalent DRM_FORMAT_* representation (as used
+    // by e.g. hardware decoders exporting PL_HANDLE_DMA_BUF memory), this
+    // gives the corresponding DRM fourcc code. Otherwise, this is 0.
+    uint32_t fourcc;
+
+    // The list of DRM format modifiers supported for importing
+    // PL_HANDLE_DMA_BUF textures of this format, if known. (Currently only
+    // reported by the Vulkan backend, if VK_EXT_image_drm_format_modifier is
+    // enabled)
+    const uint64_t *modifiers;
+    int num_modifiers;
 };
 
 // Returns whether or not a pl_fmt's components are ordered sequentially
@@ -279,6 +344,14 @@ struct pl_tex_params {
     // Note: For `blit_src`, `blit_dst`, the texture must either be
     // 2-dimensional or `PL_GPU_CAP_BLITTABLE_1D_3D` must set.
 
+    // If true, this texture is only used as a short-lived intermediate, e.g.
+    // an FBO whose contents are produced and consumed within the same frame.
+    // This is purely a hint, which backends may use to back the texture by
+    // lazily allocated or otherwise transient memory when the rest of the
+    // texture parameters permit it. (For Vulkan, this is only possible for
+    // textures which are `renderable` and nothing else)
+    bool transient;
+
     // The following capabilities are only relevant for textures which have
     // either sampleable or blit_src enabled.
     enum pl_tex_sample_mode sample_mode;
@@ -449,6 +522,28 @@ struct pl_tex_transfer_params {
     // When performing a texture transfer using a buffer, the buffer may be
     // marked as "in use" and should not used for a different type of operation
     // until pl_buf_poll returns false.
+
+    // An optional callback to fire once the transfer has completed, i.e. once
+    // the data has been fully written to the texture (uploads) or to the
+    // buffer / host memory (downloads). This is mainly useful for asynchronous
+    // transfers to/from buffers, since it avoids having to poll the buffer
+    // with `pl_buf_poll` to find out when it becomes available.
+    //
+    // The callback may be invoked from within any libplacebo call on the same
+    // `pl_gpu` (e.g. `pl_buf_poll` or `pl_gpu_flush`), or even from within the
+    // transfer call itself if the transfer completed synchronously. It must
+    // not call back into the `pl_gpu`. It's guaranteed to be invoked exactly
+    // once if the transfer call succeeds, at the latest when calling
+    // `pl_gpu_finish` or destroying the `pl_gpu`.
+    //
+    // Setting this also allows downloads to host memory (`ptr`) to be
+    // performed asynchronously, i.e. without blocking the calling thread. In
+    // this case, the contents of `ptr` are undefined until the callback fires,
+    // and the memory must remain valid until then. (Currently, this is done
+    // by the OpenGL and Vulkan backends, which copy the data out of an
+    // internal staging buffer once the download completes)
+    void (*callback)(void *priv);
+    void *priv; // arbitrary user data passed to `callback`
 };
 
 // Upload data to a texture. Returns whether successful.
@@ -503,6 +598,26 @@ struct pl_buf_params {
     // `pl_gpu.export_caps.buf`.
     enum pl_handle_type handle_type;
 
+    // Setting this indicates that the memory backing this buffer will be
+    // imported from an external API, rather than allocated. If so, this must
+    // be exactly *one* of `pl_gpu.import_caps.buf`, and `shared_mem` must
+    // reference the memory to import. At most one of `handle_type` and
+    // `import_handle` can be set.
+    //
+    // For PL_HANDLE_HOST_PTR, `shared_mem.handle.ptr` points to the start of a
+    // host allocation of `shared_mem.size` bytes, and the buffer contents
+    // begin at `shared_mem.offset` bytes into it. This allows e.g. uploading
+    // software-decoded frames to textures directly from their original memory,
+    // without any intermediate copy. The memory pages spanned by the
+    // allocation must remain valid and must not be modified by the user for
+    // as long as the buffer is in use by the GPU (see `pl_buf_poll`), and
+    // until after the buffer has been destroyed. The start of the buffer
+    // contents should be aligned to at least the texel size of any formats
+    // it will be used to transfer (and 4 bytes). Imported host pointer
+    // buffers can't be `host_mapped`.
+    enum pl_handle_type import_handle;
+    struct pl_shared_mem shared_mem;
+
     // If non-NULL, the buffer will be created with these contents. Otherwise,
     // the initial data is undefined. Using this does *not* require setting
     // host_writable.
@@ -855,6 +970,16 @@ enum pl_prim_type {
     PL_PRIM_TRIANGLE_FAN,
 };
 
+// Represents a specialization constant. These are scalar values which are
+// baked into a pass at creation time, so the driver can optimize the shader
+// around them (e.g. by unrolling loops). In the GLSL, they must be declared as
+// `layout(constant_id = id) const T name = default;`.
+struct pl_constant {
+    enum pl_var_type type; // scalar type of the constant
+    size_t offset;         // byte offset into `pl_pass_params.constant_data`
+    int id;                // `constant_id` as used in the shader
+};
+
 enum pl_pass_type {
     PL_PASS_INVALID = 0,
     PL_PASS_RASTER,  // vertex+fragment shader
@@ -880,6 +1005,13 @@ struct pl_pass_params {
     // Push constant region. Must be be a multiple of 4 <= limits.max_pushc_size
     size_t push_constants_size;
 
+    // Specialization constants, with their values taken from `constant_data`.
+    // Only supported if `limits.max_constants` is nonzero, in which case
+    // `num_constants` must not exceed it. Otherwise, this must be empty.
+    struct pl_constant *constants;
+    int num_constants;
+    void *constant_data;
+
     // The shader text in GLSL. For PL_PASS_RASTER, this is interpreted
     // as a fragment shader. For PL_PASS_COMPUTE, this is interpreted as
     // a compute shader.
@@ -950,6 +1082,13 @@ void pl_pass_destroy(const struct pl_gpu *gpu, const struct pl_pass **pass);
 
 struct pl_desc_binding {
     const void *object; // pl_* object with type corresponding to pl_desc_type
+
+    // For PL_DESC_BUF_UNIFORM only: the byte offset into the buffer at which
+    // the bound range starts. The range extends to the end of the buffer.
+    // This must be a multiple of `limits.align_ubo_offset`, and can only be
+    // non-zero if that limit is supported. Must be 0 for all other types.
+    // This allows sub-allocating uniform data from one larger buffer.
+    size_t offset;
 };
 
 struct pl_var_update {
@@ -1002,6 +1141,15 @@ struct pl_pass_run_params {
     // Number of work groups to dispatch per dimension (X/Y/Z). Must be <= the
     // corresponding index of limits.max_dispatch
     int compute_groups[3];
+
+    // Hint that this pass is independent of the work immediately surrounding
+    // it, i.e. its results are not consumed (or only consumed much later),
+    // so it may be executed on a separate, asynchronous compute queue where
+    // available. Dependent passes are instead kept on the same queue as the
+    // surrounding rendering where possible, to avoid needless cross-queue
+    // synchronization. Correctness does not depend on this flag, since all
+    // resource dependencies are still tracked (and synchronized) internally.
+    bool async;
 };
 
 // Execute a render pass.
@@ -1128,4 +1276,26 @@ void pl_gpu_flush(const struct pl_gpu *gpu);
 // to a `pl_swapchain`.
 void pl_gpu_finish(const struct pl_gpu *gpu);
 
+// Cumulative counters of the work submitted to a `pl_gpu`, by all of its
+// users combined. These are maintained unconditionally and are cheap enough
+// to leave enabled in production. They only ever increase, so to get the
+// amount of work performed per frame, subtract the values of two successive
+// calls to `pl_gpu_stats`.
+struct pl_gpu_stats {
+    uint64_t passes_created;    // calls to `pl_pass_create` (shader compiles)
+    uint64_t compile_ns;        // host time spent inside `pl_pass_create`
+    uint64_t passes_run;        // calls to `pl_pass_run`
+    uint64_t desc_bindings;     // descriptors bound by `pl_pass_run`
+    uint64_t var_updates;       // `pl_var_update`s performed by `pl_pass_run`
+    uint64_t textures_created;  // calls to `pl_tex_create`
+    uint64_t bytes_uploaded;    // via `pl_tex_upload` and `pl_buf_write`
+    uint64_t bytes_downloaded;  // via `pl_tex_download` and `pl_buf_read`
+    uint64_t flushes;           // calls to `pl_gpu_flush`
+    uint64_t submits;           // command submissions to the GPU, e.g. calls
+                                // to vkQueueSubmit. Only supported by vulkan,
+                                // 0 for other APIs.
+};
+
+void pl_gpu_stats(const struct pl_gpu *gpu, struct pl_gpu_stats *out);
+
 #endif // LIBPLACEBO_GPU_H_
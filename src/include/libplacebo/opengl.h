@@ -34,6 +34,21 @@ struct pl_opengl_params {
     // for testing purposes
     pl_gpu_caps blacklist_caps; // capabilities to be excluded
     int max_glsl_version;       // limit the maximum GLSL version
+
+    // By default, libplacebo resets all GL state it modifies (bound program,
+    // textures, framebuffer, blending etc.) back to the defaults after every
+    // shader pass. Setting this allows libplacebo to leave this state bound
+    // in between passes instead, avoiding redundant GL calls for consecutive
+    // passes. The state is still reset by every other `pl_gpu` operation, as
+    // well as by `pl_gpu_flush` and `pl_gpu_finish`. Users sharing the
+    // context with their own GL code must call `pl_opengl_reset_state` before
+    // issuing their own GL commands, and restore the default state after.
+    bool lazy_state;
+
+    // The `EGLDisplay` the GL context belongs to, if any. Setting this allows
+    // importing PL_HANDLE_DMA_BUF textures (e.g. frames exported by hardware
+    // decoders) via EGLImage, if supported by the EGL implementation.
+    void *egl_display;
 };
 
 // Default/recommended parameters
@@ -56,6 +71,10 @@ const struct pl_opengl *pl_opengl_create(struct pl_context *ctx,
 // be explicitly destroyed by the user before calling `pl_opengl_destroy`.
 void pl_opengl_destroy(const struct pl_opengl **gl);
 
+// Resets any GL state left bound by libplacebo back to the defaults. Only
+// needed when using `pl_opengl_params.lazy_state`.
+void pl_opengl_reset_state(const struct pl_gpu *gpu);
+
 struct pl_opengl_framebuffer {
     // ID of the framebuffer, or 0 to use the context's default framebuffer.
     int id;
@@ -157,4 +176,67 @@ unsigned int pl_opengl_unwrap(const struct pl_gpu *gpu, const struct pl_tex *tex
                               unsigned int *out_target, int *out_iformat,
                               unsigned int *out_fbo);
 
+// Asynchronous texture uploads on a background thread. Normally, all GL
+// commands are issued from the thread owning the GL context, so uploading
+// large textures (e.g. decoded video frames) competes with rendering. A
+// `pl_opengl_uploader` instead performs the uploads on a worker thread, using
+// a second GL context that shares its objects with the main context. This is
+// similar to the dedicated transfer queue used by the vulkan backend.
+//
+// Since libplacebo does not create GL contexts on its own, the shared context
+// must be provided by the user, in the form of callbacks to bind it.
+struct pl_opengl_uploader_params {
+    // Bind the shared GL context to the calling thread, or unbind it again.
+    // These are only ever called from the worker thread, once on startup and
+    // once on shutdown, respectively. If `make_current` returns false, the
+    // creation of the uploader fails. Both required.
+    bool (*make_current)(void *priv);
+    void (*release_current)(void *priv);
+
+    // Arbitrary user pointer that gets passed to the callbacks.
+    void *priv;
+
+    // The maximum number of uploads queued on the worker thread at any time.
+    // `pl_opengl_upload` blocks while the queue is full. Defaults to 4.
+    int queue_depth;
+};
+
+struct pl_opengl_uploader;
+
+// Creates an uploader for textures of the given `pl_opengl`. This must be
+// called from the thread owning the main GL context. Requires support for
+// sync objects (GL 3.2 / GLES 3.0, or GL_ARB_sync). Returns NULL on failure.
+struct pl_opengl_uploader *pl_opengl_uploader_create(const struct pl_opengl *gl,
+                            const struct pl_opengl_uploader_params *params);
+
+// Finishes all pending uploads and stops the worker thread. This must be
+// called from the thread owning the main GL context.
+void pl_opengl_uploader_destroy(struct pl_opengl_uploader **up);
+
+// Queues a texture upload from host memory on the worker thread. Semantically
+// equivalent to `pl_tex_upload`, except that only uploads from `params->ptr`
+// are supported, and `params->timer` is ignored. Returns false if the
+// parameters are invalid or the uploader has failed. This must be called from
+// the thread owning the main GL context, since it inserts a fence
+// (`glFenceSync`) into the main context's command stream for the worker to
+// wait on.
+//
+// If `params->callback` is set, it is called from the worker thread once
+// `params->ptr` may be reused. Otherwise, the memory must remain valid until
+// `pl_opengl_uploader_sync` has been called for the texture.
+//
+// Note: The texture must not be used in any way by the main context until
+// after calling `pl_opengl_uploader_sync` for it. Destroying the texture
+// instead waits for its queued uploads and discards their fences.
+bool pl_opengl_upload(struct pl_opengl_uploader *up,
+                      const struct pl_tex_transfer_params *params);
+
+// Makes all subsequent GL commands of the main context wait for the uploads
+// previously queued for `tex`. This must be called from the thread owning the
+// main GL context before using `tex` again. It only blocks the calling thread
+// until the worker has issued the uploads - the wait for their completion
+// happens on the GPU, via `GLsync` fences.
+void pl_opengl_uploader_sync(struct pl_opengl_uploader *up,
+                             const struct pl_tex *tex);
+
 #endif // LIBPLACEBO_OPENGL_H_
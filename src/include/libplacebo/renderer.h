@@ -19,6 +19,7 @@
 #define LIBPLACEBO_RENDERER_H_
 
 #include <libplacebo/colorspace.h>
+#include <libplacebo/dispatch.h>
 #include <libplacebo/filters.h>
 #include <libplacebo/gpu.h>
 #include <libplacebo/shaders/av1.h>
@@ -45,6 +46,64 @@ void pl_renderer_destroy(struct pl_renderer **rr);
 // `pl_image.signature`.
 void pl_renderer_flush_cache(struct pl_renderer *rr);
 
+// Save/load the renderer's internal shader cache, i.e. the compiled programs
+// of all passes used so far. These are thin wrappers around
+// `pl_dispatch_save` and `pl_dispatch_load`, and follow the same semantics.
+// In particular, this can be used to share compiled programs between multiple
+// renderers on identical GPUs (see <libplacebo/utils/render_pool.h>).
+size_t pl_renderer_save(struct pl_renderer *rr, uint8_t *out);
+void pl_renderer_load(struct pl_renderer *rr, const uint8_t *cache, size_t size);
+
+// The individual stages of the rendering pipeline, for the purposes of
+// performance measurement. Note that some operations (e.g. peak detection,
+// or debanding when combined with scaling) are merged into the shader of
+// whatever pass follows them, and get attributed to that stage instead.
+enum pl_render_stage {
+    PL_RENDER_STAGE_READ_IMAGE,    // plane reading/merging, grain, plane hooks
+    PL_RENDER_STAGE_DEBAND,        // standalone debanding passes
+    PL_RENDER_STAGE_SCALE_MAIN,    // main scaler, linearization, sigmoidization
+    PL_RENDER_STAGE_OUTPUT_TARGET, // color management, encoding, dithering
+    PL_RENDER_STAGE_OVERLAYS,      // image and target overlays
+    PL_RENDER_STAGE_FRAME_MIX,     // frame blending (`pl_render_image_mix`)
+    PL_RENDER_STAGE_COUNT,
+};
+
+// GPU timing statistics for a single rendering stage. All times are in
+// nanoseconds, and refer to individual passes. The average and peak are
+// computed over (roughly) the last 32 passes of this stage.
+struct pl_render_stage_stats {
+    const char *name;  // human-readable name of this stage
+    uint64_t count;    // total number of passes measured so far
+    uint64_t last;     // time taken by the most recently measured pass
+    uint64_t average;  // rolling average
+    uint64_t peak;     // rolling peak
+};
+
+struct pl_render_stats {
+    struct pl_render_stage_stats stages[PL_RENDER_STAGE_COUNT];
+
+    // Work counters, accumulated since the renderer was created or the stats
+    // were last reset. Unlike the timing statistics, these are always
+    // gathered, regardless of `pl_render_params.measure_timing`.
+    uint64_t frames;                    // frames rendered
+    uint64_t fbos_allocated;            // intermediate textures (re)allocated
+    struct pl_dispatch_stats dispatch;  // work done by the internal dispatch
+    struct pl_gpu_stats gpu;            // work done by the `pl_gpu`. Note that
+                                        // this includes all other users of
+                                        // the same `pl_gpu`, too.
+
+    // Work done by the internal dispatch for the most recently rendered frame
+    struct pl_dispatch_stats last_frame;
+};
+
+// Retrieves the statistics gathered so far. Since GPU timer results are only
+// available asynchronously, the timing statistics (as enabled by
+// `pl_render_params.measure_timing`) may lag behind by a few frames.
+void pl_renderer_get_stats(struct pl_renderer *rr, struct pl_render_stats *out);
+
+// Resets all statistics.
+void pl_renderer_reset_stats(struct pl_renderer *rr);
+
 // Represents the options used for rendering. These affect the quality of
 // the result.
 struct pl_render_params {
@@ -62,6 +121,20 @@ struct pl_render_params {
     const struct pl_filter_config *upscaler;
     const struct pl_filter_config *downscaler;
 
+    // Configures the algorithms used for scaling the individual planes of an
+    // image to the size of its reference plane (e.g. for chroma upsampling of
+    // subsampled YCbCr content). If left as NULL, these default to `upscaler`
+    // and `downscaler`, respectively.
+    //
+    // Note: When using the built-in `pl_filter_bicubic`, `pl_filter_triangle`
+    // or `pl_filter_box` here (see above), the planes can be sampled directly
+    // in the same shader that merges them and decodes the color, avoiding the
+    // intermediate FBOs otherwise required by separable (orthogonal) filters.
+    // This is usually a good tradeoff, since the chroma planes contain far
+    // less detail than the luma plane.
+    const struct pl_filter_config *plane_upscaler;
+    const struct pl_filter_config *plane_downscaler;
+
     // The number of entries for the scaler LUTs. Defaults to 64 if left unset.
     int lut_entries;
 
@@ -138,6 +211,15 @@ struct pl_render_params {
     // Significantly speeds up downscaling with high downscaling ratios.
     bool skip_anti_aliasing;
 
+    // Pre-reduces the image before downscaling it, by repeatedly halving it
+    // with a 2x2 box filter (similar to sampling from a mipmap chain) until
+    // it is less than twice the size of the target. The configured
+    // `downscaler` is then only applied at this remaining small ratio,
+    // instead of having to evaluate very large kernels. Slightly blurrier,
+    // but drastically faster for thumbnails, mosaics etc. Requires a linearly
+    // sampleable FBO format, and is otherwise ignored.
+    bool mipmap_downscaling;
+
     // Cutoff value for polar sampling. See the equivalent option in
     // `pl_sample_filter_params` for more information.
     float polar_cutoff;
@@ -151,8 +233,72 @@ struct pl_render_params {
     // which can sometimes (not always) allow skipping some otherwise redundant
     // sampling work. Only relevant when peak detection is active (i.e.
     // params->peak_detect_params is set and the source is HDR).
+    //
+    // When this is false, the detection runs on an intermediate texture in the
+    // same frame. Without FBOs, this is only possible if the source image can
+    // be sampled directly, in which case the detection runs as a separate
+    // compute prepass. Otherwise, peak detection is disabled.
     bool allow_delayed_peak_detect;
 
+    // Compile shaders asynchronously in the background, instead of stalling
+    // whenever a new shader is needed (e.g. after changing the scaler). Frames
+    // rendered while compilation is still in progress will temporarily fall
+    // back to a simplified rendering pipeline (built-in GPU sampling, no
+    // debanding, sigmoidization or custom shaders), until the proper shaders
+    // become available. Requires `PL_GPU_CAP_THREAD_SAFE`, ignored otherwise.
+    // Also ignored when using `hooks`, since these can't be run speculatively.
+    bool async_compile;
+
+    // Compute intermediate values which don't need full precision (such as
+    // scaler weights, debanding and dithering) using half-precision math, on
+    // GPUs with native support for it. This can almost double ALU throughput
+    // on mobile and integrated GPUs, at the cost of a minor loss of accuracy.
+    // See `pl_shader_params.reduced_precision`.
+    bool reduced_precision;
+
+    // Bake rarely-changing shader variables (e.g. color matrices) directly
+    // into the generated GLSL as constants, so the driver can fold them. Any
+    // change to these values (e.g. switching the color representation)
+    // requires recompiling the affected shaders, so this is best suited to
+    // sessions where the image and render parameters stay the same for long
+    // stretches. See `pl_shader_params.specialize_constants`.
+    bool specialize_constants;
+
+    // Run every pass writing to a storable texture as a compute shader, even
+    // on GPUs that don't advertise `PL_GPU_CAP_PARALLEL_COMPUTE`. This avoids
+    // the overhead of render pass setup and vertex processing, which can be a
+    // net win for simple pipelines on some drivers. Passes which can't be
+    // expressed as compute shaders (e.g. blending onto non-storable textures)
+    // transparently fall back to the fragment shader path.
+    //
+    // Note: Independently of this option, the renderer also accepts targets
+    // which are storable but not renderable, in which case all passes writing
+    // directly to the target are dispatched as compute shaders.
+    bool prefer_compute;
+
+    // Tune the work group sizes of compute shaders (e.g. peak detection and
+    // polar sampling) for the current GPU. See `pl_dispatch_set_autotune`.
+    // The results are included in `pl_renderer_save`.
+    bool autotune_compute;
+
+    // If nonzero, the entire color conversion from the image's color space to
+    // the target's (linearization, color and tone mapping, delinearization) is
+    // baked into a 3D LUT with this many entries per dimension, which is then
+    // applied using tetrahedral interpolation. The LUT is rendered on the GPU,
+    // and only regenerated when the color spaces or `color_map_params` change.
+    // This can greatly reduce the per-pixel cost of expensive conversions,
+    // such as HDR to SDR tone mapping, at a minor loss of accuracy. A size of
+    // 33 is generally sufficient.
+    //
+    // Note: This is ignored while peak detection is active (since the
+    // conversion then depends on the detected values), when using a 3DLUT for
+    // ICC profiles (or `force_3dlut`), and on GPUs without GLSL 130 or
+    // renderable and host-readable 32-bit float textures. Input values outside
+    // the range [0, 1] get clipped. In particular, since peak detection is
+    // enabled by `pl_render_default_params`, HDR sources additionally require
+    // `peak_detect_params` to be set to NULL for this to take effect.
+    int color_lut_size;
+
     // --- Performance tuning / debugging options
     // These may affect performance or may make debugging problems easier,
     // but shouldn't have any effect on the quality.
@@ -175,6 +321,14 @@ struct pl_render_params {
     // (typically the presence of blittable texture formats).
     bool skip_redraw_caching;
 
+    // When redrawing a static frame whose target overlays changed (see the
+    // note on caching of `pl_render_image`), only restore and redraw the
+    // areas covered by the previous and current target overlays, instead of
+    // the entire target. This requires that the contents of `fbo` were not
+    // modified by anything else since the previous call to `pl_render_image`
+    // with the same `fbo`. Ignored otherwise.
+    bool partial_redraw;
+
     // Disables linearization / sigmoidization before scaling. This might be
     // useful when tracking down unexpected image artifacts or excessing
     // ringing, but it shouldn't normally be necessary.
@@ -186,6 +340,12 @@ struct pl_render_params {
     // general-purpose ones.
     bool disable_builtin_scalers;
 
+    // Disables merging adjacent filter taps into single bilinear texture
+    // fetches (see `pl_sample_filter_params.no_merging`). Since the merged
+    // taps are only as precise as the GPU's texture filtering, this may be
+    // useful when tracking down unexpected image artifacts.
+    bool disable_tap_merging;
+
     // Forces the use of a 3DLUT, even in cases where the use of one is
     // unnecessary. This is slower, but may improve the quality of the gamut
     // reduction step, if one is performed.
@@ -200,12 +360,19 @@ struct pl_render_params {
     // Completely overrides the use of FBOs, as if there were no renderable
     // texture format available. This disables most features.
     bool disable_fbos;
+
+    // Enables measuring the GPU execution time of every pass dispatched by
+    // the renderer, broken down by rendering stage. The results can be
+    // retrieved with `pl_renderer_get_stats`. Requires GPU timer support,
+    // silently ignored otherwise.
+    bool measure_timing;
 };
 
 // This contains the default/recommended options for reasonable image quality,
 // while also not being too terribly slow. All of the *_params structs are
 // defaulted to the corresponding *_default_params, except for deband_params,
-// which is disabled by default.
+// which is disabled by default. The planes are upscaled with the fast,
+// single-pass `pl_filter_bicubic`.
 //
 // This should be fine on most integrated GPUs, but if it's too slow, consider
 // setting the params to {0} instead, or alternatively setting
@@ -214,9 +381,10 @@ extern const struct pl_render_params pl_render_default_params;
 
 // This contains a higher quality preset for better image quality at the cost
 // of quite a bit of performance. In addition to the settings implied by
-// `pl_render_default_params`, it sets the upscaler to `pl_filter_ewa_lanczos`,
-// and enables debanding. This should only really be used with a discrete GPU
-// and where maximum image quality is desired.
+// `pl_render_default_params`, it sets the upscaler (for both the image and its
+// planes) to `pl_filter_ewa_lanczos`, and enables debanding. This should only
+// really be used with a discrete GPU and where maximum image quality is
+// desired.
 extern const struct pl_render_params pl_render_high_quality_params;
 
 #define PL_MAX_PLANES 4
@@ -279,6 +447,18 @@ enum pl_overlay_mode {
     PL_OVERLAY_MONOCHROME, // treat the texture as a single-component alpha map
 };
 
+// A single sub-region of an overlay texture, e.g. one glyph or bitmap of a
+// texture atlas. See `pl_overlay.parts`.
+struct pl_overlay_part {
+    struct pl_rect2df src; // source rect, in texels of the overlay texture
+    struct pl_rect2df dst; // target rect, same coordinate space as `rect`
+
+    // If the overlay's mode is PL_OVERLAY_MONOCHROME, then this part is
+    // drawn with this color (RGB) and opacity (A), replacing the overlay's
+    // `base_color`. Ignored for the other modes.
+    float color[4];
+};
+
 // A struct representing an image overlay (e.g. for subtitles or on-screen
 // status messages, controls, ...)
 struct pl_overlay {
@@ -303,6 +483,18 @@ struct pl_overlay {
     // of the texture / the value of `color` are interpreted according to this.
     struct pl_color_repr repr;
     struct pl_color_space color;
+
+    // If set, the overlay texture is treated as an atlas containing many
+    // independent parts (e.g. the bitmaps making up a line of subtitles),
+    // which are all drawn using a single pass, instead of a single pass per
+    // overlay. `rect` (and `base_color`) are ignored in this case.
+    //
+    // Note: Parts are always sampled directly (i.e. with bilinear or nearest
+    // neighbour filtering, depending on the texture), so they should ideally
+    // be drawn at their native size. See `pl_upload_overlay_atlas` for a
+    // helper to generate such atlases.
+    const struct pl_overlay_part *parts;
+    int num_parts;
 };
 
 // High-level description of a source image to render
@@ -385,8 +577,9 @@ void pl_image_set_chroma_location(struct pl_image *image,
 // Represents the target of a rendering operation
 struct pl_render_target {
     // The framebuffer (or texture) we want to render to. Must have `renderable`
-    // set. The other capabilities are optional, but in particular `storable`
-    // and `blittable` can help boost performance if available.
+    // or `storable` set. The other capabilities are optional, but in
+    // particular `storable` and `blittable` can help boost performance if
+    // available. (See also `pl_render_params.prefer_compute`)
     const struct pl_tex *fbo;
 
     // The destination rectangle which we want to render into. If this is
@@ -415,6 +608,16 @@ struct pl_render_target {
     // `pl_image.overlays`
     const struct pl_overlay *overlays;
     int num_overlays;
+
+    // If set, the `fbo` is exported using this sync object once the frame has
+    // been rendered (as if by `pl_tex_export`), so that the result can be
+    // handed off to an external API such as a hardware encoder. The consumer
+    // should wait on `export_sync->wait_handle` on the GPU, rather than having
+    // the CPU block on the rendering (e.g. via `pl_gpu_finish`). Requires the
+    // `fbo` to have been created with `export_handle` or `import_handle`. As
+    // with `pl_tex_export`, the user *must* signal `export_sync->signal_handle`
+    // before the `fbo` is used by libplacebo again. (Optional)
+    const struct pl_sync *export_sync;
 };
 
 // Fills in a pl_render_target based on a swapchain frame's FBO and metadata.
@@ -434,11 +637,85 @@ bool pl_render_target_partial(const struct pl_render_target *target);
 // Note on lifetime: Once this call returns, the passed structures may be
 // freely overwritten or discarded by the caller, even the referenced
 // `pl_tex` objects may be freely reused.
+//
+// Note on caching: When the same image (as determined by `pl_image.signature`)
+// is rendered with otherwise identical parameters several times in a row, and
+// only the target overlays change between calls (e.g. an animated OSD on top
+// of paused playback), the renderer keeps a copy of the target prior to
+// drawing the target overlays, and merely redraws the overlays on top of it.
+// This requires `fbo->params.blit_src` and `blit_dst`, and is bypassed if
+// `pl_render_params.skip_redraw_caching` is set or `pl_image.signature` is 0.
+// Note that the cached copy covers the entire `fbo`, including the area
+// outside of `dst_rect`.
+//
+// Similarly, when the same image is rendered several times in a row with
+// parameters that only differ in the final output stage (`color_map_params`,
+// `dither_params`, `cone_params`, `lut3d_params`, `color_lut_size`, and the
+// target's `repr`, `color` and `profile`), the scaled image is kept in an
+// intermediate texture, so that only the output stage needs to be redone.
+// This is bypassed under the same conditions, as well as when using any
+// `hooks` or with `disable_fbos`.
 bool pl_render_image(struct pl_renderer *rr, const struct pl_image *image,
                      const struct pl_render_target *target,
                      const struct pl_render_params *params);
 
-/* TODO
+// Compiles all of the shaders that `pl_render_image` would need for the given
+// image, target and params, without rendering anything. This is intended for
+// avoiding stutter on the first frame of a new stream (or after changing the
+// render params), when the configuration is known in advance. Blocks until
+// all passes are compiled, which happens in parallel if the GPU supports
+// `PL_GPU_CAP_THREAD_SAFE`. Returns false if any of them failed.
+//
+// Only the parameters of the image planes and the target `fbo` are relevant
+// (size, format and capabilities), their contents are never read from or
+// written to, so placeholder textures of the expected formats suffice. The
+// color spaces, representations, rects and overlays should otherwise match
+// those of the real frames, since they all influence the generated shaders.
+// This does not count as a rendered frame, and does not affect any of the
+// caches described in `pl_render_image`.
+bool pl_renderer_warmup(struct pl_renderer *rr, const struct pl_image *image,
+                        const struct pl_render_target *target,
+                        const struct pl_render_params *params);
+
+// Render a single image to several targets at once, e.g. the different
+// resolutions of an adaptive bitrate ladder. This is equivalent to calling
+// `pl_render_image` once per target, except that the source-side processing
+// (plane merging, debanding, film grain, `PL_HOOK_NATIVE`/`PL_HOOK_RGB` hooks,
+// peak detection etc.) only happens once, after which the result is kept in
+// an intermediate texture that every target is scaled and output from.
+//
+// All targets must crop the image to the same source region, which is
+// trivially the case when they all show the entire `image.src_rect`. The
+// redraw caching of `pl_render_image` is not used. If the image has overlays
+// or intermediate textures are unavailable, this falls back to rendering
+// each target individually.
+bool pl_render_image_multi(struct pl_renderer *rr, const struct pl_image *image,
+                           const struct pl_render_target *targets,
+                           int num_targets,
+                           const struct pl_render_params *params);
+
+// A single tile of a mosaic, see `pl_render_tiles`.
+struct pl_render_tile {
+    const struct pl_image *image;
+
+    // The area of the target to render this image to. Unlike
+    // `pl_render_target.dst_rect`, this must always be set explicitly.
+    struct pl_rect2df dst_rect;
+};
+
+// Render many images onto a single target, e.g. for a multiview mosaic or
+// monitoring wall. This is equivalent to calling `pl_render_image` for each
+// tile in order (with `target->dst_rect` replaced by the tile's `dst_rect`),
+// except that the target is only validated once, and the target overlays are
+// only drawn once, on top of all tiles. Tiles sharing the same configuration
+// (size, format, colorspace etc.) also share all of their shaders. The redraw
+// caching of `pl_render_image` is not used.
+//
+// Note: The area of the target not covered by any tile is left untouched, so
+// users will generally want to clear the target beforehand.
+bool pl_render_tiles(struct pl_renderer *rr, const struct pl_render_tile *tiles,
+                     int num_tiles, const struct pl_render_target *target,
+                     const struct pl_render_params *params);
 
 // Represents a mixture of input images, distributed temporally.
 //
@@ -487,14 +764,14 @@ struct pl_image_mix {
     float vsync_duration;
 
     // Explanation of the frame mixing radius: The algorithm chosen in
-    // `pl_render_params.frame_mixing` has a canonical radius equal to
+    // `pl_render_params.frame_mixer` has a canonical radius equal to
     // `pl_filter_config.kernel->radius`. This means that the frame mixing
     // algorithm will (only) need to consult all of the frames that have a
     // distance within the interval [-radius, radius]. As such, the user should
     // include all such frames in `images`, but may prune or omit frames that
     // lie outside it.
     //
-    // The built-in frame mixing (`pl_render_params.frame_mixing == NULL`) has
+    // The built-in frame mixing (`pl_render_params.frame_mixer == NULL`) has
     // a canonical radius equal to `vsync_duration/2`.
 };
 
@@ -509,9 +786,16 @@ struct pl_image_mix {
 // of pl_render_image_mix, where num_images = 1, that frame's distance is 0.0,
 // and the vsync_duration is 0.0. (But using `pl_render_image` instead of
 // `pl_render_image_mix` in such an example can still be more efficient)
+//
+// Note on caching: Each image in the mixture is rendered (once) into an
+// internal intermediate texture, keyed on `pl_image.signature`. Subsequent
+// calls involving the same images only need to re-run the (cheap) blending
+// step. This cache is invalidated automatically when the target size,
+// colorspace or rendering parameters change, and is bypassed entirely if
+// `pl_render_params.skip_redraw_caching` is set. Images no longer present in
+// the mixture are evicted from the cache.
 bool pl_render_image_mix(struct pl_renderer *rr, const struct pl_image_mix *mix,
                          const struct pl_render_target *target,
                          const struct pl_render_params *params);
-*/
 
 #endif // LIBPLACEBO_RENDERER_H_
@@ -55,6 +55,20 @@ struct pl_shader_params {
     // determine the effective GLSL mode and capabilities. If `gpu` is also
     // set, then this overrides `gpu->glsl`.
     struct pl_glsl_desc glsl;
+
+    // If true, intermediate values which don't need full precision (such as
+    // filter weights, debanding averages and dither offsets) are computed at
+    // reduced (half) precision. This can significantly improve throughput on
+    // mobile and integrated GPUs. Ignored unless `glsl.float16` is set.
+    bool reduced_precision;
+
+    // If true, variables which are not marked as `dynamic` (such as color
+    // conversion matrices) are emitted as GLSL `const` literals instead of
+    // being bound as shader variables, allowing the GLSL compiler to fold them
+    // into the surrounding arithmetic. Since this makes the shader signature
+    // depend on the values, every change to them requires recompiling the
+    // shader. Only recommended for sessions with mostly static parameters.
+    bool specialize_constants;
 };
 
 // Creates a new, blank, mutable pl_shader object.
@@ -175,6 +189,15 @@ struct pl_shader_var {
     struct pl_var var;  // the underlying variable description
     const void *data;   // the raw data (interpretation as with pl_var_update)
     bool dynamic;       // if true, the value is expected to change frequently
+
+    // If true, the value is expected to stay the same for as long as the
+    // shader is in use, e.g. parameters derived from static configuration.
+    // Such variables may be implemented as specialization constants (see
+    // `pl_constant`), so that the driver can optimize around their values.
+    // Changing the value is still allowed, but requires re-creating the pass,
+    // so this should not be used for values that vary per frame or with the
+    // image size. Mutually exclusive with `dynamic`.
+    bool compile_time;
 };
 
 struct pl_buffer_var {
@@ -111,6 +111,21 @@ struct pl_peak_detect_params {
     // by this amount, as a percentage of the actual measured peak. If left
     // as 0.0, this logic is disabled. The default value is 0.05.
     float overshoot_margin;
+
+    // If set to a value above 1, peak detection is performed on a copy of the
+    // image that has been downscaled by this factor in each dimension (e.g.
+    // 4 for 1/4 resolution), using bilinear sampling. This greatly reduces
+    // the cost of peak detection for high resolution sources, at the cost of
+    // slightly underestimating small isolated highlights. The smoothing and
+    // scene change logic are unaffected.
+    //
+    // Note: This is only implemented by `pl_renderer`, which runs the
+    // detection as a separate compute prepass on the downscaled image in this
+    // case, with the result being used by the same frame.
+    // `pl_shader_detect_peak` itself always measures every pixel it's invoked
+    // on, so direct users should feed it a downscaled image instead. The
+    // default value is 0, which disables downscaling.
+    int downsample;
 };
 
 extern const struct pl_peak_detect_params pl_peak_detect_default_params;
@@ -246,6 +261,17 @@ struct pl_color_map_params {
     // If left unset, defaults to 1.0, which corresponds to no boost.
     float max_boost;
 
+    // If nonzero, the tone mapping curve is evaluated ahead of time (on the
+    // CPU) into a 1D LUT with this many entries, which the shader then samples
+    // instead of evaluating the curve per pixel. The LUT is only regenerated
+    // when the curve or its parameters (e.g. the signal peak) change. A size
+    // of 256 is generally sufficient. Defaults to 0, i.e. disabled.
+    //
+    // Note: This requires a `peak_detect_state` object (which the LUT is
+    // stored in), and is ignored while peak detection is active, since the
+    // curve then depends on the detected values.
+    int tone_mapping_lut_size;
+
     // If true, enables the gamut warning feature. This will visibly highlight
     // all out-of-gamut colors (by inverting them), if they would have been
     // clipped as a result of gamut or tone mapping.
@@ -262,7 +288,9 @@ extern const struct pl_color_map_params pl_color_map_default_params;
 //
 // If `peak_detect_state` is set to a valid peak detection state object (as
 // created by `pl_shader_detect_peak`), the detected values will be used in
-// place of `src.sig_peak` / `src.sig_avg`.
+// place of `src.sig_peak` / `src.sig_avg`. This object is also used to
+// store the tone mapping LUT (see `tone_mapping_lut_size`), in which case it
+// need not have been used for peak detection.
 //
 // Note: The peak detection state object is only updated after the shader is
 // dispatched, so if `pl_shader_detect_peak` is called as part of the same
@@ -355,8 +383,40 @@ struct pl_3dlut_params {
     enum pl_rendering_intent intent;
 
     // The size of the 3DLUT to generate. If left as NULL, these individually
-    // default to 64, which is the recommended default for all three.
+    // default to 64, which is the recommended default for all three. (Or 33,
+    // when using `tetrahedral`)
     size_t size_r, size_g, size_b;
+
+    // If true, the 3DLUT is sampled using tetrahedral interpolation in the
+    // shader, instead of relying on the GPU's trilinear texture filtering.
+    // This costs a few more instructions per pixel, but is significantly more
+    // accurate, so much smaller LUTs (e.g. 17x17x17 or 33x33x33) suffice to
+    // match or exceed the quality of a trilinearly filtered 64x64x64 LUT.
+    // This in turn reduces the time needed to compute and upload the LUT, as
+    // well as the memory bandwidth needed to sample it. Requires GLSL 130+,
+    // ignored otherwise.
+    bool tetrahedral;
+
+    // If set to a value above 1, the 3DLUT computation is split up and spread
+    // over (up to) this many threads. Setting this to 0 or 1 computes the
+    // 3DLUT on the calling thread.
+    int threads;
+
+    // Optional callbacks for caching computed 3DLUTs, for example on disk, so
+    // that repeated use of the same profiles (e.g. across restarts) can skip
+    // the computation entirely. The `signature` uniquely identifies the
+    // source and destination profiles (including the contents of any ICC
+    // profiles), the rendering intent and the LUT size. The data consists of
+    // `size` bytes of RGBA float values, and is only valid for use on the
+    // same machine.
+    //
+    // `cache_load` should copy the cached data into `data` and return true,
+    // or return false if no matching entry exists. `cache_save` is called
+    // after computing a new 3DLUT, with the data to store. Either may be NULL.
+    void *cache_priv;
+    bool (*cache_load)(void *priv, uint64_t signature, void *data, size_t size);
+    void (*cache_save)(void *priv, uint64_t signature, const void *data,
+                       size_t size);
 };
 
 extern const struct pl_3dlut_params pl_3dlut_default_params;
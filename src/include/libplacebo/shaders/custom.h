@@ -88,6 +88,14 @@ struct pl_hook_params {
     const struct pl_tex *(*get_tex)(void *priv, int width, int height);
     void *priv;
 
+    // Optional helper function to return a texture obtained from `get_tex`
+    // (during the current frame) to the renderer, once the user no longer
+    // needs it. This allows the renderer to reuse it for subsequent passes,
+    // reducing the number of textures needed per frame. The user must not
+    // access the texture in any way after releasing it. Textures that were
+    // returned as part of a `pl_hook_res` must not be released. May be NULL.
+    void (*release_tex)(void *priv, const struct pl_tex *tex);
+
     // Which stage triggered the hook to run.
     enum pl_hook_stage stage;
 
@@ -78,6 +78,13 @@ struct pl_deband_params {
     //
     // Defaults to 6.0, which is very mild.
     float grain;
+
+    // Disable the use of compute shaders (e.g. if rendering to non-storable
+    // tex). When enabled, and the number of iterations is high relative to
+    // the radius, the texture is loaded into shared memory once per work group
+    // and all taps are interpolated from there, which saves a lot of texture
+    // bandwidth. Only used when not scaling.
+    bool no_compute;
 };
 
 extern const struct pl_deband_params pl_deband_default_params;
@@ -124,6 +131,13 @@ struct pl_sample_filter_params {
     bool no_compute;
     // Disable the use of filter widening / anti-aliasing (for downscaling)
     bool no_widening;
+    // Disable the use of texture gathering for polar filters. Only relevant
+    // for fragment shaders. (Mainly useful for testing/benchmarking)
+    bool no_gather;
+    // Disable merging pairs of adjacent taps into single bilinear samples for
+    // separated/orthogonal filters. This is exact up to the precision of the
+    // GPU's texture filtering. (Mainly useful for testing/benchmarking)
+    bool no_merging;
 
     // This shader object is used to store the LUT, and will be recreated
     // if necessary. To avoid thrashing the resource, users should avoid trying
@@ -164,4 +178,23 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
                             const struct pl_sample_src *src,
                             const struct pl_sample_filter_params *params);
 
+// Performs both passes of orthogonal sampling at once, using a compute shader
+// which keeps the intermediate (vertically scaled) results in shared memory.
+// This avoids having to write the intermediate result to a texture and read
+// it back again. The results are otherwise equivalent to using
+// `pl_shader_sample_ortho` for PL_SEP_VERT followed by PL_SEP_HORIZ.
+//
+// Returns false if this is not possible, in which case the shader is left
+// unmodified and the user should fall back to two separate passes of
+// `pl_shader_sample_ortho`. This happens e.g. if compute shaders are not
+// supported or disabled (`params->no_compute`), if `src->tex` is not set, if
+// `src->rect` is flipped, or if the filter footprint would exceed the
+// available shared memory (e.g. large kernels or strong downscaling).
+//
+// Note: The same `params->lut` may be used interchangeably with this function
+// and `pl_shader_sample_ortho`.
+bool pl_shader_sample_ortho_fused(struct pl_shader *sh,
+                                  const struct pl_sample_src *src,
+                                  const struct pl_sample_filter_params *params);
+
 #endif // LIBPLACEBO_SHADERS_SAMPLING_H_
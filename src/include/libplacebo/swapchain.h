@@ -43,7 +43,8 @@ void pl_swapchain_destroy(const struct pl_swapchain **sw);
 // will block until the just-submitted frame has finished rendering. Typical
 // values are 2 or 3, which enable better pipelining by allowing the GPU to be
 // processing one or two frames at the same time as the user is preparing the
-// next for submission.
+// next for submission. Note that this may change over time, e.g. with
+// `pl_vulkan_swapchain_params.adaptive_depth`.
 int pl_swapchain_latency(const struct pl_swapchain *sw);
 
 // Update/query the swapchain size. This function performs both roles: it tries
@@ -164,4 +165,125 @@ bool pl_swapchain_submit_frame(const struct pl_swapchain *sw);
 // `start_frame` blocked for should also be included).
 void pl_swapchain_swap_buffers(const struct pl_swapchain *sw);
 
+// Presentation timing feedback, as reported by the underlying graphics API.
+// All timestamps are in nanoseconds, and refer to the same time domain as
+// CLOCK_MONOTONIC (on platforms where that exists). Fields which are unknown
+// are left as 0.
+struct pl_swapchain_timing {
+    // Sequential index of the most recent frame for which timing information
+    // is available, counting from 1 for the first frame submitted to this
+    // swapchain.
+    uint64_t frame_id;
+
+    // The time at which this frame actually became visible on the display.
+    uint64_t actual_present;
+
+    // The earliest time at which this frame could have been presented, if
+    // the host had not been constrained by the desired present time. May be
+    // earlier than `actual_present` if the frame was submitted too late to
+    // make it into the vblank it was intended for.
+    uint64_t earliest_present;
+
+    // How long before the latest possible deadline this frame's presentation
+    // request was processed by the compositor / display engine. Small values
+    // indicate that rendering is cutting it close; users trying to minimize
+    // latency can use this to decide how late to start rendering.
+    uint64_t present_margin;
+
+    // The duration of a single refresh cycle of the display.
+    uint64_t refresh_duration;
+
+    // Extrapolated time of the next vblank following the time at which
+    // `pl_swapchain_timing` was called. Only available if both
+    // `actual_present` and `refresh_duration` are known.
+    uint64_t next_vblank;
+};
+
+// Queries the most recent presentation timing feedback for this swapchain.
+// Returns false if the swapchain does not support timing feedback, or if no
+// frame has been presented so far. (Leaving the contents of `out`
+// unmodified.)
+//
+// In combination with low-latency presentation modes (see the
+// platform-specific APIs), this allows users to delay `start_frame` until
+// shortly before `next_vblank`, minimizing input-to-photon latency.
+bool pl_swapchain_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out);
+
+// Headless ("offscreen") swapchains
+//
+// This is a virtual swapchain with no display attached, backed by a ring of
+// textures owned by libplacebo. It's intended for e.g. transcoding pipelines,
+// where frames are rendered, downloaded back to the host and consumed (e.g.
+// encoded) on the CPU. Each submitted frame is asynchronously downloaded into
+// a host-visible buffer, and `pl_swapchain_swap_buffers` meters the rendering
+// loop exactly like a real swapchain would, blocking until the Nth previously
+// submitted frame has finished rendering and downloading.
+
+struct pl_offscreen_swapchain_params {
+    // Template for the framebuffer textures. The `w`, `h` and `format` fields
+    // are required, and the format must be renderable and host readable.
+    // `renderable` and `host_readable` are forced on, `blit_dst` is forced on
+    // if the format supports it. The FBO size can be changed at runtime using
+    // `pl_swapchain_resize`.
+    struct pl_tex_params fbo_params;
+
+    // Maximum number of frames in flight, i.e. the number of frames that may
+    // be rendering/downloading at the same time. One additional image is
+    // allocated, so that a completed frame can be held by the user while the
+    // next one is being rendered. Optional, defaults to 3.
+    int swapchain_depth;
+
+    // If true, skip downloading the frame contents. The frames are still
+    // paced as normal, and `pl_offscreen_frame.fbo` can be used to access the
+    // rendered contents on the GPU.
+    bool no_download;
+
+    // The color representation and color space to report for the
+    // framebuffers. Optional, default to RGB and `pl_color_space_monitor`.
+    struct pl_color_repr color_repr;
+    struct pl_color_space color_space;
+};
+
+// Creates a new headless swapchain. Returns NULL on failure.
+const struct pl_swapchain *pl_offscreen_swapchain_create(const struct pl_gpu *gpu,
+                        const struct pl_offscreen_swapchain_params *params);
+
+// A completed frame, as retrieved from an offscreen swapchain.
+struct pl_offscreen_frame {
+    uint64_t frame_id;       // sequential index, counting from 0
+    const struct pl_tex *fbo; // the texture this frame was rendered to
+
+    // The buffer holding the downloaded frame contents, or NULL if
+    // `no_download` was set. If the GPU supports mapped buffers, `data`
+    // points directly at the contents. Otherwise, `data` is NULL and the
+    // contents must be read using `pl_buf_read`. Rows are `stride` bytes
+    // apart, and the data is otherwise tightly packed.
+    const struct pl_buf *buf;
+    const uint8_t *data;
+    size_t stride;
+};
+
+// Retrieves the oldest submitted frame that has not yet been retrieved,
+// waiting up to `timeout` nanoseconds for it to complete. Returns false if
+// no frame is available (yet). Frames are always returned in the order they
+// were submitted.
+//
+// The frame's resources remain valid, and its image slot stays reserved,
+// until the frame is released using `pl_offscreen_swapchain_release`. While
+// all image slots are reserved, `pl_swapchain_start_frame` will fail.
+//
+// Note: Submitted frames which were never retrieved by the time their image
+// slot gets reused by `pl_swapchain_start_frame` are silently dropped. Users
+// who want to consume every frame should drain this function after each
+// `pl_swapchain_swap_buffers`.
+bool pl_offscreen_swapchain_get(const struct pl_swapchain *sw,
+                                struct pl_offscreen_frame *out_frame,
+                                uint64_t timeout);
+
+// Releases a frame previously retrieved by `pl_offscreen_swapchain_get`,
+// allowing its image slot to be reused.
+void pl_offscreen_swapchain_release(const struct pl_swapchain *sw,
+                                    const struct pl_offscreen_frame *frame);
+
 #endif // LIBPLACEBO_SWAPCHAIN_H_
@@ -0,0 +1,71 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libplacebo/dispatch.h>
+#include <libplacebo/shaders/sampling.h>
+
+#ifndef LIBPLACEBO_BLIT_H_
+#define LIBPLACEBO_BLIT_H_
+
+// This file contains a utility for scaling one texture into another using a
+// proper filter kernel, without having to set up a full `pl_renderer`. This
+// is intended for e.g. thumbnail or preview generation. Unlike `pl_tex_blit`,
+// which is limited to nearest/bilinear sampling and requires both formats to
+// be `PL_FMT_CAP_BLITTABLE`, this only requires the source to be sampleable
+// and the destination to be renderable or storable.
+//
+// Where possible, separable filters are applied in a single compute shader
+// (see `pl_shader_sample_ortho_fused`). Otherwise, this falls back to two
+// separate passes via an intermediate texture from the `pl_gpu`'s internal
+// texture pool. No color management or format conversion is performed, the
+// texture contents are scaled as-is.
+
+struct pl_blit_filtered_params {
+    // The source texture. Must be a 2D texture with `params.sampleable`.
+    const struct pl_tex *src;
+
+    // The destination texture. Must be a 2D texture with `params.renderable`
+    // or `params.storable`.
+    const struct pl_tex *dst;
+
+    // The source and destination rects. Optional, if left as {0}, then the
+    // entire texture is used. The destination rect must be fully contained
+    // within the destination texture. The source rect may be flipped.
+    struct pl_rect2df src_rc;
+    struct pl_rect2d dst_rc;
+
+    // The filter to scale with, e.g. `&pl_filter_box` for (area-averaged)
+    // downscaling or `&pl_filter_mitchell`. Optional, if left as NULL, the
+    // source texture is sampled directly according to its `sample_mode`.
+    const struct pl_filter_config *filter;
+
+    // Antiringing strength, see `pl_sample_filter_params.antiring`.
+    float antiring;
+
+    // Optional shader object to store the filter LUT in. Should be left NULL
+    // (the default) for one-off blits, in which case a temporary object is
+    // used. Callers which repeatedly blit with the same filter and scaling
+    // ratio should set this to a NULL-initialized object of their own, and
+    // destroy it with `pl_shader_obj_destroy` when done.
+    struct pl_shader_obj **lut;
+};
+
+// Scales `params->src` into `params->dst`. Returns whether successful.
+bool pl_tex_blit_filtered(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                          const struct pl_blit_filtered_params *params);
+
+#endif // LIBPLACEBO_BLIT_H_
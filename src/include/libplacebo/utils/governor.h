@@ -0,0 +1,113 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libplacebo/renderer.h>
+
+#ifndef LIBPLACEBO_GOVERNOR_H_
+#define LIBPLACEBO_GOVERNOR_H_
+
+// This file contains a utility for adapting the rendering quality to the
+// available GPU time. The governor derives a fixed number of progressively
+// cheaper quality tiers from a set of user-provided `pl_render_params`, and
+// picks the tier to render each frame with based on the GPU time measured by
+// the renderer (see `pl_render_params.measure_timing`). It steps down when
+// the measured frame time exceeds the target, and back up again once there
+// has been enough headroom for a while.
+//
+// A typical render loop might look like this:
+//
+//     gov = pl_render_governor_create(ctx, &(struct pl_render_governor_params) {
+//         .params = &pl_render_high_quality_params,
+//         .target_ns = 1000000000 / 60,
+//     });
+//
+//     while (have_frames) {
+//         const struct pl_render_params *params;
+//         params = pl_render_governor_update(gov, rr);
+//         pl_render_image(rr, &image, &target, params);
+//         ...
+//     }
+//
+// Note that GPU timer results are only available asynchronously, so the
+// governor reacts to changes in load with a delay of a few frames. If the GPU
+// does not support timers, the governor never leaves the top tier.
+
+// Quality tiers, from the highest to the lowest quality:
+//
+// 0. The `pl_render_governor_params.params` as provided.
+// 1. Polar (EWA) scalers are replaced by `pl_filter_spline36`, and the
+//    number of debanding iterations is halved.
+// 2. All scalers are replaced by the built-in `pl_filter_bicubic`, debanding
+//    is limited to a single iteration, and peak detection is disabled.
+// 3. Only bilinear sampling is used, and debanding and sigmoidization are
+//    disabled.
+#define PL_RENDER_GOVERNOR_TIERS 4
+
+struct pl_render_governor_params {
+    // The rendering parameters to use for the highest quality tier. Required.
+    // The parameters are copied, but the structs they point to (e.g.
+    // `deband_params`) must outlive the governor. `measure_timing` is always
+    // enabled in the resulting parameters.
+    const struct pl_render_params *params;
+
+    // The target GPU time per frame, in nanoseconds, e.g. the vsync interval
+    // minus some safety margin. Required.
+    uint64_t target_ns;
+
+    // The governor steps back up once the frame time has remained below
+    // `headroom * target_ns` for `hold_frames` consecutive frames. Defaults to
+    // 0.7 and 120, respectively.
+    float headroom;
+    int hold_frames;
+
+    // The number of frames to wait after a change in tier, before the new
+    // frame time measurements are trusted. Defaults to 8.
+    int settle_frames;
+
+    // Optional callback, invoked whenever the current tier changes.
+    void (*tier_cb)(void *priv, int tier);
+    void *priv;
+};
+
+struct pl_render_governor;
+
+struct pl_render_governor *pl_render_governor_create(struct pl_context *ctx,
+                                const struct pl_render_governor_params *params);
+void pl_render_governor_destroy(struct pl_render_governor **gov);
+
+// Updates the governor with the latest timing statistics of `rr`, and returns
+// the rendering parameters to use for the next frame. This must be called
+// exactly once per frame, and always with the same renderer. Note that this
+// resets the renderer's statistics (see `pl_renderer_reset_stats`) whenever
+// the tier changes. The returned pointer remains valid for the lifetime of
+// the governor.
+const struct pl_render_params *pl_render_governor_update(
+        struct pl_render_governor *gov, struct pl_renderer *rr);
+
+// Returns the current tier, from 0 (highest quality) up to
+// `PL_RENDER_GOVERNOR_TIERS - 1`.
+int pl_render_governor_tier(const struct pl_render_governor *gov);
+
+// Returns the rendering parameters used for a given tier.
+const struct pl_render_params *pl_render_governor_params(
+        const struct pl_render_governor *gov, int tier);
+
+// Forces the governor into a given tier, e.g. after a change in resolution or
+// refresh rate. The governor continues adapting from this tier on.
+void pl_render_governor_set_tier(struct pl_render_governor *gov, int tier);
+
+#endif // LIBPLACEBO_GOVERNOR_H_
@@ -0,0 +1,114 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libplacebo/gpu.h>
+#include <libplacebo/renderer.h>
+
+#ifndef LIBPLACEBO_RENDER_POOL_H_
+#define LIBPLACEBO_RENDER_POOL_H_
+
+// This file contains a utility for distributing independent rendering jobs
+// (e.g. the frames of a transcode) across multiple GPUs. The pool creates one
+// `pl_renderer` per GPU, and picks which GPU each new job should run on. The
+// user is responsible for uploading the job's source data to, and rendering
+// it on, the GPU that was picked.
+//
+// A typical setup with vulkan might look like this:
+//
+//     VkPhysicalDevice devs[4];
+//     int num = pl_vulkan_choose_devices(ctx, &dparams, devs, 4);
+//     for (int i = 0; i < num; i++) {
+//         vk[i] = pl_vulkan_create(ctx, &(struct pl_vulkan_params) {
+//             .instance = inst->instance,
+//             .device = devs[i],
+//         });
+//         gpus[i] = vk[i]->gpu;
+//     }
+//
+//     pool = pl_render_pool_create(ctx, &(struct pl_render_pool_params) {
+//         .gpus = gpus,
+//         .num_gpus = num,
+//         .mode = PL_RENDER_POOL_LEAST_LOADED,
+//     });
+//
+//     while (have_frames) {
+//         struct pl_render_job job;
+//         pl_render_pool_begin(pool, &job);
+//         /* upload to job.gpu, pl_render_image(job.renderer, ...),
+//          * start downloading the result */
+//         ...
+//         /* at some point later, once the result has been consumed: */
+//         pl_render_pool_done(pool, &job);
+//     }
+
+enum pl_render_pool_mode {
+    // Distribute jobs evenly across all GPUs, in order.
+    PL_RENDER_POOL_ROUND_ROBIN = 0,
+
+    // Pick the GPU with the fewest outstanding jobs, i.e. jobs that were
+    // started with `pl_render_pool_begin` but not yet finished with
+    // `pl_render_pool_done`. Ties are broken in round-robin order.
+    PL_RENDER_POOL_LEAST_LOADED,
+};
+
+struct pl_render_pool_params {
+    // The GPUs to distribute jobs across. Required. The GPUs must outlive
+    // the pool.
+    const struct pl_gpu * const *gpus;
+    int num_gpus;
+
+    enum pl_render_pool_mode mode;
+
+    // By default, compiled programs are shared between the renderers of
+    // identical GPUs (as determined by comparing their capabilities, limits
+    // and formats), so that each shader only needs to be compiled once per
+    // type of device. Setting this disables the sharing.
+    bool no_cache_sharing;
+};
+
+struct pl_render_pool;
+
+// Creates a new render pool. Note that the pool is not thread-safe: calls to
+// `pl_render_pool_*` must be externally synchronized, both with each other and
+// with any use of the renderers they hand out (since sharing compiled programs
+// modifies the renderers' internal state). Returns NULL on failure.
+struct pl_render_pool *pl_render_pool_create(struct pl_context *ctx,
+                                    const struct pl_render_pool_params *params);
+void pl_render_pool_destroy(struct pl_render_pool **pool);
+
+// Represents a single job assigned to one of the pool's GPUs.
+struct pl_render_job {
+    int index;                   // index into `pl_render_pool_params.gpus`
+    const struct pl_gpu *gpu;    // the GPU this job should run on
+    struct pl_renderer *renderer; // the renderer belonging to `gpu`
+};
+
+// Picks the GPU for the next job, according to the pool's mode.
+void pl_render_pool_begin(struct pl_render_pool *pool, struct pl_render_job *job);
+
+// Marks a job as finished. This must be called exactly once for every job
+// returned by `pl_render_pool_begin`, ideally as soon as the job's results
+// are no longer needed on the GPU (e.g. once its download has completed).
+// This is also where newly compiled programs get shared with the pool's other
+// renderers.
+void pl_render_pool_done(struct pl_render_pool *pool,
+                         const struct pl_render_job *job);
+
+// Returns the number of outstanding jobs on the GPU with the given index.
+int pl_render_pool_load(const struct pl_render_pool *pool, int index);
+
+#endif // LIBPLACEBO_RENDER_POOL_H_
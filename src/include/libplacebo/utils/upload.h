@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 
+#include <libplacebo/dispatch.h>
 #include <libplacebo/gpu.h>
 #include <libplacebo/renderer.h>
 
@@ -107,7 +108,128 @@ const struct pl_fmt *pl_plane_find_fmt(const struct pl_gpu *gpu, int out_map[4],
 // The resulting texture is guaranteed to be `sampleable`, and it will also try
 // and maximize compatibility with the other `pl_renderer` requirements
 // (blittable, linear filterable, etc.).
+//
+// If no texture format matches the plane data directly, host memory data in
+// PL_FMT_UNORM format is repacked on the CPU first, by expanding each
+// component to 8 or 16 bits (preserving its normalized value) and dropping
+// any padding bits. This covers e.g. 24-bit RGB on GPUs without 3-component
+// formats, or P010-style data described with `component_pad`. The result is
+// written directly into the (mapped, if possible) staging buffer. Data
+// provided via `buf` is never repacked.
 bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
                      const struct pl_tex **tex, const struct pl_plane_data *data);
 
+// Import an image plane directly from external memory (e.g. a DMA-BUF frame
+// exported by a hardware decoder via VAAPI or V4L2), without any copies, and
+// output the resulting `pl_plane` struct to `out_plane` (optional). `data`
+// describes the plane's format and dimensions, but must have neither `pixels`
+// nor `buf` set. For PL_HANDLE_DMA_BUF, `data->row_stride` is used as the
+// pitch unless `shared_mem->pitch` is set. Multi-plane frames are imported
+// by calling this once per plane, with the respective `shared_mem.offset`.
+//
+// Since imported textures are bound to their memory, the previous contents
+// of `tex` are released to an internal cache of imported textures rather than
+// being reused directly. Importing memory that was already imported before
+// (e.g. a recycled hardware decoder surface) then re-uses the existing
+// texture from this cache, avoiding the cost of a fresh import. Cached
+// textures keep their memory alive until evicted, flushed (see
+// `pl_tex_import_cache_flush`) or until the `pl_gpu` is destroyed.
+// `handle_type` must be one of `gpu->import_caps.tex`.
+bool pl_import_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                     const struct pl_tex **tex, const struct pl_plane_data *data,
+                     enum pl_handle_type handle_type,
+                     const struct pl_shared_mem *shared_mem);
+
+// Destroy all idle textures held by the import cache of `pl_import_plane`,
+// releasing their underlying memory. Textures that are still in use are not
+// affected. Users should call this whenever the external memory is no longer
+// going to be re-used, e.g. after tearing down a hardware decoder.
+void pl_tex_import_cache_flush(const struct pl_gpu *gpu);
+
+// Upload multiple planes (e.g. all planes of a frame) at once. This behaves
+// like calling `pl_upload_plane` for each plane, except that all planes
+// provided as host pointers are first copied into a single shared staging
+// buffer, from which the transfers are then issued back-to-back. This avoids
+// the overhead of separate staging allocations, writes and synchronization
+// for every plane. Planes provided via `pl_plane_data.buf` are uploaded
+// directly.
+//
+// `staging` may point to a buffer (or NULL) which will be re-used across
+// calls and recreated as needed; the user must destroy it with
+// `pl_buf_destroy` when done. If `staging` itself is NULL, a temporary buffer
+// is used instead. `out_planes` is optional.
+bool pl_upload_planes(const struct pl_gpu *gpu, struct pl_plane out_planes[],
+                      const struct pl_tex *tex[], const struct pl_plane_data data[],
+                      int num_planes, const struct pl_buf **staging);
+
+// Packed pixel layouts which can't be described by `pl_plane_data`, either
+// because the components aren't aligned to texels, or because no GPU format
+// matches the host layout. The 10-bit layouts are unpacked to textures that
+// are normalized to their 10-bit range, so users should set
+// `pl_color_repr.bits.sample_depth` and `color_depth` to 10 for these.
+enum pl_packed_layout {
+    PL_PACKED_RGB24 = 1,    // 8-bit R, G, B (3 bytes per pixel)
+    PL_PACKED_BGR24,        // 8-bit B, G, R (3 bytes per pixel)
+    PL_PACKED_XRGB2101010,  // 10-bit B, G, R from the LSB of a 32-bit LE word
+    PL_PACKED_Y210,         // 10-bit 4:2:2 Y0 Cb Y1 Cr, MSB-aligned 16-bit LE
+    PL_PACKED_V210,         // 10-bit 4:2:2, 6 pixels per 16 bytes
+};
+
+struct pl_packed_data {
+    enum pl_packed_layout layout;
+    int width, height;
+
+    // Offset in bytes between rows. Optional, if left as 0, this is inferred
+    // from the `width` assuming no padding (or 128 byte aligned rows for
+    // PL_PACKED_V210). Must be a multiple of 4 for the word-based layouts.
+    size_t row_stride;
+
+    // The raw data, either from host memory or from a buffer (mutually
+    // exclusive). The buffer must be of type PL_BUF_STORAGE, and the offset a
+    // multiple of 4.
+    const void *pixels;
+    const struct pl_buf *buf;
+    size_t buf_offset;
+};
+
+// Upload an image in a packed layout, and unpack it on the GPU using a
+// compute shader. The result is output to up to two planes: one for packed
+// RGB layouts, or separate luma and (half-width) chroma planes for the 4:2:2
+// YCbCr layouts. `tex` must have room for two textures, which are
+// (re)created as needed. Returns the number of planes, or 0 on failure.
+// `out_planes` is optional.
+//
+// This requires compute shaders and storable texture formats. Host memory is
+// first copied into `*staging`, which is re-used and recreated as needed (as
+// with `pl_upload_planes`). If `staging` itself is NULL, a temporary buffer
+// is used instead.
+int pl_upload_packed(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                     struct pl_plane out_planes[2], const struct pl_tex *tex[2],
+                     const struct pl_packed_data *data,
+                     const struct pl_buf **staging);
+
+// Describes a single-component, 8-bit bitmap (e.g. an `ASS_Image`), to be
+// packed into an overlay texture atlas.
+struct pl_overlay_bitmap {
+    const uint8_t *data;   // the actual bitmap data
+    int w, h;              // dimensions of the bitmap, in pixels
+    size_t stride;         // offset in bytes between rows
+    struct pl_rect2df dst; // target rect (see `pl_overlay_part.dst`)
+    float color[4];        // color and opacity (see `pl_overlay_part.color`)
+};
+
+// Packs a list of bitmaps into a single texture atlas, and uploads it to `tex`
+// (as with `pl_upload_plane`). The resulting plane is written to `out_plane`,
+// and the corresponding part for each bitmap to `out_parts`, which must have
+// room for `num` entries. Together, these can be used directly as the `plane`
+// and `parts` of a PL_OVERLAY_MONOCHROME `pl_overlay`, which allows drawing
+// all of the bitmaps using a single pass. Returns whether successful.
+//
+// Note: The atlas dimensions are rounded up to powers of two, so `tex` can
+// generally be re-used from frame to frame without being reallocated.
+bool pl_upload_overlay_atlas(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                             const struct pl_tex **tex,
+                             struct pl_overlay_part out_parts[],
+                             const struct pl_overlay_bitmap bitmaps[], int num);
+
 #endif // LIBPLACEBO_UPLOAD_H_
@@ -209,6 +209,10 @@ struct pl_vulkan_params {
     // compute queue families, if supported by the device. On some devices,
     // these can allow the GPU to schedule compute shaders in parallel with
     // fragment shaders. Enabled by default.
+    //
+    // Note: Only compute passes marked as independent (`pl_pass_run_params.
+    // async`) are sent to the dedicated queue, unless the graphics queue
+    // family lacks compute support altogether.
     bool async_compute;
 
     // Limits the number of queues to request. If left as 0, this will enable
@@ -218,6 +222,13 @@ struct pl_vulkan_params {
     // can actually decrease performance.
     int queue_count;
 
+    // Reserves this many additional queues of the graphics queue family for
+    // use by independent streams (see `pl_vulkan_stream_create`). These queues
+    // are never used by this `pl_vulkan` itself. Limited by the number of
+    // queues the device provides, with at least one queue always being kept
+    // for the `pl_vulkan` itself. Defaults to 0.
+    int num_streams;
+
     // Enables extra device extensions. Device creation will fail if these
     // extensions are not all supported. The user may use this to enable e.g.
     // interop extensions.
@@ -237,6 +248,28 @@ struct pl_vulkan_params {
     // VkPhysicalDeviceVulkan11Features is not allowed.
     const VkPhysicalDeviceFeatures2KHR *features;
 
+    // Controls how the SPIR-V generated for shaders gets optimized, before
+    // being handed to the driver. Optimized modules can be much smaller,
+    // which speeds up pipeline creation, and can also run faster on drivers
+    // with weak shader compilers. The optimized result is what ends up in
+    // `pl_pass.params.cached_program`, so when re-using cached programs, the
+    // cost of the optimization is only ever paid once. Defaults to
+    // PL_SPIRV_OPT_PERFORMANCE.
+    //
+    // Note: With glslang, this only has an effect if glslang was built with
+    // support for SPIRV-Tools.
+    enum pl_spirv_opt spirv_opt;
+
+    // Optional format cache, as previously saved by
+    // `pl_vulkan_save_format_cache`. If this matches the device (as
+    // identified by its UUID, vendor/device ID and driver version), the
+    // format capabilities are taken from the cache instead of being probed
+    // from the driver one by one, which reduces startup time. Invalid or
+    // mismatching caches are silently ignored. Only needs to remain valid
+    // for the duration of this call.
+    const uint8_t *format_cache;
+    size_t format_cache_len;
+
     // --- Misc/debugging options
 
     // Restrict specific features to e.g. work around driver bugs, or simply
@@ -290,6 +323,16 @@ struct pl_vulkan_device_params {
 VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
                                          const struct pl_vulkan_device_params *params);
 
+// Like `pl_vulkan_choose_device`, but returns all matching devices instead of
+// just the best one, in order of preference. Devices of the same type retain
+// their enumeration order. Writes up to `max_devices` devices to
+// `out_devices`, and returns the number of devices written. This can be used
+// to create one `pl_vulkan` per device (via `pl_vulkan_params.device`), e.g.
+// for use with <libplacebo/utils/render_pool.h>.
+int pl_vulkan_choose_devices(struct pl_context *ctx,
+                             const struct pl_vulkan_device_params *params,
+                             VkPhysicalDevice *out_devices, int max_devices);
+
 struct pl_vulkan_swapchain_params {
     // The surface to use for rendering. Required, the user is in charge of
     // creating this. Must belong to the same VkInstance as `vk->instance`.
@@ -314,10 +357,32 @@ struct pl_vulkan_swapchain_params {
     // documentation for `pl_swapchain_get_latency` for more information. For
     // vulkan specifically, we are only able to wait until the GPU has finished
     // rendering a frame - we are unable to wait until the display has actually
-    // finished displaying it. So this only provides a rough guideline.
-    // Optional, defaults to 3.
+    // finished displaying it (unless `low_latency` is enabled). So this only
+    // provides a rough guideline. Optional, defaults to 3.
     int swapchain_depth;
 
+    // If true, `swapchain_depth` only serves as the upper limit, and the
+    // actual depth is adjusted at runtime based on the measured frame times:
+    // it is lowered (down to 1) while frames consistently render well within
+    // the refresh interval, to reduce latency, and raised again when the
+    // frame time approaches the refresh interval, to avoid dropped frames.
+    // The current depth is reported by `pl_swapchain_latency`. Frame times
+    // are measured on the GPU, which requires timestamp query support on the
+    // graphics queue; this is ignored (with a warning) if unavailable.
+    bool adaptive_depth;
+
+    // If true, `pl_swapchain_swap_buffers` additionally blocks until the Nth
+    // previously submitted frame has actually been presented on the display,
+    // rather than only until the GPU has finished rendering it. This requires
+    // the VK_KHR_present_wait extension, and is ignored (with a warning) if
+    // unavailable. Combined with a `swapchain_depth` of 1 and the timing
+    // feedback from `pl_swapchain_timing`, this allows users to start
+    // rendering as late as possible before the next vblank.
+    //
+    // Presentation timing feedback is provided by VK_GOOGLE_display_timing
+    // where available, independently of this option.
+    bool low_latency;
+
     // This suppresses automatic recreation of the swapchain when any call
     // returns VK_SUBOPTIMAL_KHR. Normally, libplacebo will recreate the
     // swapchain internally on the next `pl_swapchain_start_frame`. If enabled,
@@ -386,6 +451,11 @@ struct pl_vulkan_import_params {
     // libplacebo will assume no extra device features were enabled.
     const VkPhysicalDeviceFeatures2KHR *features;
 
+    // Mirrored from `pl_vulkan_params`.
+    enum pl_spirv_opt spirv_opt;
+    const uint8_t *format_cache;
+    size_t format_cache_len;
+
     // --- Misc/debugging options
 
     // Restrict specific features to e.g. work around driver bugs, or simply
@@ -403,6 +473,20 @@ struct pl_vulkan_import_params {
 const struct pl_vulkan *pl_vulkan_import(struct pl_context *ctx,
                                          const struct pl_vulkan_import_params *params);
 
+// Creates an independent stream on a `pl_vulkan` created with `num_streams`
+// greater than 0. The stream is a separate `pl_vulkan` (with its own `pl_gpu`)
+// sharing the VkDevice of `parent`, but bound exclusively to one of its
+// reserved graphics queues, with its own command pool and its own lock. This
+// allows e.g. several renderers, each using their own stream, to record and
+// submit commands from different threads without contending with each other.
+//
+// Objects created on one stream's `pl_gpu` can't be used on any other
+// `pl_gpu`, including that of `parent`. Returns NULL if all reserved queues
+// are already in use. Streams must be destroyed with `pl_vulkan_destroy`
+// before destroying `parent`.
+const struct pl_vulkan *pl_vulkan_stream_create(struct pl_context *ctx,
+                                                const struct pl_vulkan *parent);
+
 struct pl_vulkan_wrap_params {
     // The image itself. It *must* be usable concurrently by all of the queue
     // family indices listed in `pl_vulkan->queues`. Note that this requires
@@ -505,4 +589,74 @@ void pl_vulkan_release(const struct pl_gpu *gpu, const struct pl_tex *tex,
                        VkImageLayout layout, VkAccessFlags access,
                        VkSemaphore sem_in);
 
+// Memory usage statistics for a single Vulkan memory heap (VkMemoryHeap).
+// `budget` and `usage` are only available if the device supports
+// VK_EXT_memory_budget, and are 0 otherwise.
+struct pl_vulkan_mem_heap {
+    VkMemoryHeapFlags flags;    // as reported by the device
+    VkDeviceSize size;          // total size of the heap
+    VkDeviceSize allocated;     // device memory allocated by this `pl_gpu`
+    VkDeviceSize used;          // subset of `allocated` in use by live objects
+    VkDeviceSize budget;        // estimated budget available to this process
+    VkDeviceSize usage;         // estimated usage of this process (all APIs)
+};
+
+struct pl_vulkan_mem_stats {
+    int num_heaps;
+    struct pl_vulkan_mem_heap heaps[VK_MAX_MEMORY_HEAPS];
+};
+
+// Query the current memory usage of a vulkan `pl_gpu`, per memory heap. The
+// difference between `allocated` and `used` is memory held in reserve by
+// the internal allocator, which can be released with `pl_vulkan_trim`.
+void pl_vulkan_mem_stats(const struct pl_gpu *gpu,
+                         struct pl_vulkan_mem_stats *out);
+
+// Immediately release all device memory allocations which are not currently
+// in use by any objects, rather than keeping them around for future re-use.
+// Returns the number of bytes released. This is useful for reducing the
+// memory footprint of idle or low-priority instances when memory is scarce.
+//
+// Note: If VK_EXT_memory_budget is available, libplacebo also does this
+// automatically whenever allocating new memory would exceed the budget.
+size_t pl_vulkan_trim(const struct pl_gpu *gpu);
+
+// Serialize the pipeline cache shared by all passes of a vulkan `pl_gpu`,
+// which contains the driver's compiled code for all pipelines created so far.
+// This complements `pl_pass_params.cached_program` (which only stores the
+// SPIR-V of each pass), and can be restored with
+// `pl_vulkan_load_pipeline_cache` to speed up pass creation in future
+// processes. If `out` is NULL, returns the required size. Otherwise writes at
+// most `size` bytes to `out` and returns the number of bytes written. (The
+// required size may grow as new passes get created)
+size_t pl_vulkan_save_pipeline_cache(const struct pl_gpu *gpu, uint8_t *out,
+                                     size_t size);
+
+// Merge previously saved pipeline cache data into the pipeline cache of a
+// vulkan `pl_gpu`. Data belonging to a different device or driver version is
+// silently ignored.
+void pl_vulkan_load_pipeline_cache(const struct pl_gpu *gpu,
+                                   const uint8_t *cache, size_t size);
+
+// Command submission statistics. For the purposes of this struct, a "frame"
+// ends with every `pl_swapchain_submit_frame` or `pl_gpu_flush`.
+struct pl_vulkan_submit_stats {
+    int submits;            // vkQueueSubmit calls made during the last frame
+    int cmds;               // command buffers submitted during the last frame
+    uint64_t total_submits; // vkQueueSubmit calls made in total
+    uint64_t total_cmds;    // command buffers submitted in total
+};
+
+// Query the command submission statistics of a vulkan `pl_gpu`. libplacebo
+// batches up all consecutive commands targeting the same queue into a single
+// vkQueueSubmit, so `cmds` may be higher than `submits`.
+void pl_vulkan_submit_stats(const struct pl_gpu *gpu,
+                            struct pl_vulkan_submit_stats *out);
+
+// Serialize the format capabilities of a vulkan `pl_gpu` into the given
+// buffer, for use with `pl_vulkan_params.format_cache` in future processes
+// using the same device. Returns the number of bytes written. If `out` is
+// NULL, this only returns the size of the required buffer.
+size_t pl_vulkan_save_format_cache(const struct pl_gpu *gpu, uint8_t *out);
+
 #endif // LIBPLACEBO_VULKAN_H_
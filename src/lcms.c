@@ -17,6 +17,7 @@
 
 #include <lcms2.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "context.h"
 #include "lcms.h"
@@ -160,7 +161,81 @@ static void error_callback(cmsContext cms, cmsUInt32Number code,
     pl_err(ctx, "lcms2: [%d] %s", (int) code, msg);
 }
 
-bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent,
+// Bump this whenever the way the 3DLUT is computed changes, to invalidate
+// entries stored in user-provided caches
+#define LUT_CACHE_VERSION 1
+
+static uint64_t lut_signature(const struct pl_3dlut_params *params,
+                              const struct pl_3dlut_profile *src,
+                              const struct pl_3dlut_profile *dst,
+                              int s_r, int s_g, int s_b)
+{
+    struct {
+        uint32_t version;
+        int32_t intent;
+        int32_t size[3];
+        struct pl_color_space color[2];
+        uint64_t icc[2];
+    } key;
+
+    memset(&key, 0, sizeof(key)); // ensure padding is zeroed
+    key.version = LUT_CACHE_VERSION;
+    key.intent = params->intent;
+    key.size[0] = s_r;
+    key.size[1] = s_g;
+    key.size[2] = s_b;
+    key.color[0] = src->color;
+    key.color[1] = dst->color;
+
+    // Hash the profile contents rather than relying on the user-provided
+    // signature, since the cache may outlive the process
+    const struct pl_3dlut_profile *profs[2] = { src, dst };
+    for (int i = 0; i < 2; i++) {
+        const struct pl_icc_profile *icc = &profs[i]->profile;
+        if (icc->data)
+            key.icc[i] = siphash64(icc->data, icc->len) ^ icc->len;
+    }
+
+    return siphash64((const uint8_t *) &key, sizeof(key));
+}
+
+// Upper limit on the number of threads used by pl_lcms_compute_lut
+#define MAX_LUT_THREADS 64
+
+struct lut_job {
+    cmsHTRANSFORM trafo;
+    float *out_data;
+    uint16_t *tmp; // room for a single line of `s_r` input pixels
+    int s_r, s_g, s_b;
+    int start, end; // range of blue slices
+};
+
+static void *lut_job_run(void *arg)
+{
+    const struct lut_job *job = arg;
+    const int s_r = job->s_r, s_g = job->s_g, s_b = job->s_b;
+    uint16_t *tmp = job->tmp;
+
+    for (int b = job->start; b < job->end; b++) {
+        for (int g = 0; g < s_g; g++) {
+            // Fill in a single line of the temporary buffer
+            for (int r = 0; r < s_r; r++) {
+                tmp[r * 3 + 0] = r * 65535 / (s_r - 1);
+                tmp[r * 3 + 1] = g * 65535 / (s_g - 1);
+                tmp[r * 3 + 2] = b * 65535 / (s_b - 1);
+            }
+
+            // Transform this line into the right output position
+            size_t offset = (b * s_g + g) * s_r * 4;
+            cmsDoTransform(job->trafo, tmp, job->out_data + offset, s_r);
+        }
+    }
+
+    return NULL;
+}
+
+bool pl_lcms_compute_lut(struct pl_context *ctx,
+                         const struct pl_3dlut_params *params,
                          struct pl_3dlut_profile src, struct pl_3dlut_profile dst,
                          float *out_data, int s_r, int s_g, int s_b,
                          struct pl_3dlut_result *out)
@@ -180,31 +255,68 @@ bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent
     if (!srcp || !dstp)
         goto error;
 
+    pl_assert(s_r > 1 && s_g > 1 && s_b > 1);
+    size_t lut_size = (size_t) s_r * s_g * s_b * 4 * sizeof(float);
+    uint64_t signature = 0;
+    if (params->cache_load || params->cache_save)
+        signature = lut_signature(params, &src, &dst, s_r, s_g, s_b);
+
+    if (params->cache_load &&
+        params->cache_load(params->cache_priv, signature, out_data, lut_size))
+    {
+        pl_debug(ctx, "Loaded 3DLUT from cache (signature 0x%"PRIx64")",
+                 signature);
+        ret = true;
+        goto error;
+    }
 
-    uint32_t flags = cmsFLAGS_HIGHRESPRECALC | cmsFLAGS_BLACKPOINTCOMPENSATION;
+    // Disable the transform's internal cache, since that makes it safe to
+    // share the transform (and its expensive precalculated tables) between
+    // threads. The input pixels are all distinct anyway.
+    uint32_t flags = cmsFLAGS_HIGHRESPRECALC | cmsFLAGS_BLACKPOINTCOMPENSATION |
+                     cmsFLAGS_NOCACHE;
     trafo = cmsCreateTransformTHR(cms, srcp, TYPE_RGB_16, dstp, TYPE_RGBA_FLT,
-                                  intent, flags);
+                                  params->intent, flags);
     if (!trafo)
         goto error;
 
-    pl_assert(s_r > 1 && s_g > 1 && s_b > 1);
-    tmp = talloc_array(NULL, uint16_t, s_r * 3);
+    int threads = PL_MAX(1, PL_MIN(params->threads, MAX_LUT_THREADS));
+    threads = PL_MIN(threads, s_b);
+    tmp = talloc_array(NULL, uint16_t, threads * s_r * 3);
+
+    struct lut_job jobs[MAX_LUT_THREADS];
+    pthread_t ids[MAX_LUT_THREADS];
+    bool started[MAX_LUT_THREADS] = {0};
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i] = (struct lut_job) {
+            .trafo = trafo,
+            .out_data = out_data,
+            .tmp = tmp + i * s_r * 3,
+            .s_r = s_r,
+            .s_g = s_g,
+            .s_b = s_b,
+            .start = s_b * i / threads,
+            .end = s_b * (i + 1) / threads,
+        };
+    }
 
-    for (int b = 0; b < s_b; b++) {
-        for (int g = 0; g < s_g; g++) {
-            // Fill in a single line of the temporary buffer
-            for (int r = 0; r < s_r; r++) {
-                tmp[r * 3 + 0] = r * 65535 / (s_r - 1);
-                tmp[r * 3 + 1] = g * 65535 / (s_g - 1);
-                tmp[r * 3 + 2] = b * 65535 / (s_b - 1);
-            }
+    // The first job runs on the calling thread
+    for (int i = 1; i < threads; i++)
+        started[i] = !pthread_create(&ids[i], NULL, lut_job_run, &jobs[i]);
 
-            // Transform this line into the right output position
-            size_t offset = (b * s_g + g) * s_r * 4;
-            cmsDoTransform(trafo, tmp, out_data + offset, s_r);
+    lut_job_run(&jobs[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(ids[i], NULL);
+        } else {
+            lut_job_run(&jobs[i]);
         }
     }
 
+    if (params->cache_save)
+        params->cache_save(params->cache_priv, signature, out_data, lut_size);
+
     ret = true;
     // fall through
 
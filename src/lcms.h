@@ -21,8 +21,10 @@
 
 // Compute a transformation from one color profile to another, and fill the
 // provided array by the resulting 3DLUT. The array must have room for four
-// components per sample.
-bool pl_lcms_compute_lut(struct pl_context *ctx, enum pl_rendering_intent intent,
+// components per sample. Only `params->intent`, `threads` and the cache
+// callbacks are used, the LUT size is given by `s_r`, `s_g` and `s_b`.
+bool pl_lcms_compute_lut(struct pl_context *ctx,
+                         const struct pl_3dlut_params *params,
                          struct pl_3dlut_profile src, struct pl_3dlut_profile dst,
                          float *out_data, int s_r, int s_g, int s_b,
                          struct pl_3dlut_result *out);
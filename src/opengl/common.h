@@ -21,3 +21,7 @@
 #include "../context.h"
 
 #include <epoxy/gl.h>
+
+#ifdef EPOXY_HAS_EGL
+#include <epoxy/egl.h>
+#endif
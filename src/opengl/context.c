@@ -86,7 +86,7 @@ const struct pl_opengl *pl_opengl_create(struct pl_context *ctx,
         }
     }
 
-    pl_gl->gpu = pl_gpu_create_gl(ctx);
+    pl_gl->gpu = pl_gpu_create_gl(ctx, params);
     if (!pl_gl->gpu)
         goto error;
 
@@ -21,9 +21,45 @@
 
 static const struct pl_gpu_fns pl_fns_gl;
 
+// Completion callback for an asynchronous texture transfer
+struct gl_cb {
+    void (*callback)(void *priv);
+    void *priv;
+    GLsync sync;
+
+    // For pipelined downloads: data to copy out of the (mapped) `buf` into
+    // `dst` before firing the callback
+    const struct pl_tex *tex;
+    const struct pl_buf *buf;
+    void *dst;
+    size_t size;
+};
+
+// Cached GL state, used to elide redundant state changes between passes. Only
+// tracks state which `gl_pass_run` would otherwise set up and tear down for
+// every single pass. All-zero corresponds to the default GL state.
+#define GL_STATE_TEX_UNITS 32
+
+struct gl_state {
+    GLuint program;
+    GLuint fbo;
+    bool scissor;
+    bool blend;
+    GLenum blend_func[4];
+    struct {
+        GLenum target;
+        GLuint texture;
+    } textures[GL_STATE_TEX_UNITS];
+    bool active_unit_dirty; // GL_TEXTURE0 is not the active texture unit
+};
+
 // For gpu.priv
 struct pl_gl {
     struct pl_gpu_fns impl;
+    struct gl_cb *callbacks;
+    int num_callbacks;
+    struct pl_opengl_uploader **uploaders;
+    int num_uploaders;
 
     // Cached capabilities
     int gl_ver;
@@ -32,8 +68,87 @@ struct pl_gl {
     bool has_invalidate;
     bool has_vao;
     bool has_queries;
+    bool has_fences;
+
+    // If enabled, `state` may be left bound in between passes
+    bool lazy_state;
+    struct gl_state state;
+
+#ifdef EPOXY_HAS_EGL
+    // For importing DMA-BUFs via EGLImage
+    EGLDisplay egl_dpy;
+    bool has_egl_modifiers;
+#endif
 };
 
+// Restores all cached state to the GL defaults
+static void gl_state_reset(const struct pl_gpu *gpu)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    struct gl_state *s = &p->state;
+
+    for (int i = 0; i < GL_STATE_TEX_UNITS; i++) {
+        if (!s->textures[i].texture)
+            continue;
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(s->textures[i].target, 0);
+        s->active_unit_dirty = true;
+    }
+
+    if (s->active_unit_dirty)
+        glActiveTexture(GL_TEXTURE0);
+    if (s->program)
+        glUseProgram(0);
+    if (s->fbo)
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (s->scissor)
+        glDisable(GL_SCISSOR_TEST);
+    if (s->blend)
+        glDisable(GL_BLEND);
+
+    *s = (struct gl_state) {0};
+}
+
+static void gl_use_program(struct pl_gl *p, GLuint program)
+{
+    if (p->state.program != program) {
+        glUseProgram(program);
+        p->state.program = program;
+    }
+}
+
+static void gl_bind_fbo(struct pl_gl *p, GLuint fbo)
+{
+    if (p->state.fbo != fbo) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        p->state.fbo = fbo;
+    }
+}
+
+static void gl_bind_tex(struct pl_gl *p, int unit, GLenum target, GLuint texture)
+{
+    struct gl_state *s = &p->state;
+    if (unit < GL_STATE_TEX_UNITS && s->textures[unit].texture == texture &&
+        s->textures[unit].target == target)
+    {
+        return;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    s->active_unit_dirty = true;
+
+    if (unit < GL_STATE_TEX_UNITS) {
+        s->textures[unit].target = target;
+        s->textures[unit].texture = texture;
+    }
+}
+
+void pl_opengl_reset_state(const struct pl_gpu *gpu)
+{
+    gl_state_reset(gpu);
+}
+
 static bool test_ext(const struct pl_gpu *gpu, const char *ext,
                      int gl_ver, int gles_ver)
 {
@@ -46,8 +161,89 @@ static bool test_ext(const struct pl_gpu *gpu, const char *ext,
     return ext ? epoxy_has_gl_extension(ext) : false;
 }
 
+// Fires the callbacks of all completed transfers. If `wait` is true, this
+// blocks until all pending transfers have completed.
+static void gl_poll_callbacks(const struct pl_gpu *gpu, bool wait)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    while (p->num_callbacks) {
+        struct gl_cb cb = p->callbacks[0];
+        GLenum res = glClientWaitSync(cb.sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                      wait ? UINT64_MAX : 0);
+        if (res == GL_TIMEOUT_EXPIRED)
+            return;
+
+        // Also fire the callback if waiting failed, since there's nothing
+        // better we can do about it (and the callback must fire eventually)
+        glDeleteSync(cb.sync);
+        TARRAY_REMOVE_AT(p->callbacks, p->num_callbacks, 0);
+        if (cb.dst)
+            memcpy(cb.dst, cb.buf->data, cb.size);
+        cb.callback(cb.priv);
+    }
+}
+
+// Returns the most recent pending callback referencing `tex` or `buf`
+static struct gl_cb *gl_find_callback(const struct pl_gpu *gpu,
+                                      const struct pl_tex *tex,
+                                      const struct pl_buf *buf)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    for (int i = p->num_callbacks - 1; i >= 0; i--) {
+        struct gl_cb *cb = &p->callbacks[i];
+        if ((tex && cb->tex == tex) || (buf && cb->buf == buf))
+            return cb;
+    }
+
+    return NULL;
+}
+
+// Blocks until all pending callbacks referencing `tex` or `buf` have fired,
+// or until `timeout` expires. Returns whether any are still pending.
+static bool gl_wait_callbacks(const struct pl_gpu *gpu, const struct pl_tex *tex,
+                              const struct pl_buf *buf, uint64_t timeout)
+{
+    gl_poll_callbacks(gpu, false);
+    struct gl_cb *cb = gl_find_callback(gpu, tex, buf);
+    if (!cb || !timeout)
+        return !!cb;
+
+    // Fences signal in order, so waiting for the newest one suffices
+    glClientWaitSync(cb->sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    gl_poll_callbacks(gpu, false);
+    return !!gl_find_callback(gpu, tex, buf);
+}
+
+// Schedules the completion callback of a transfer that was just issued
+static void gl_transfer_callback(const struct pl_gpu *gpu,
+                                 const struct pl_tex_transfer_params *params)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    if (!params->callback)
+        return;
+
+    // Transfers to/from host memory are synchronous, and without fences we
+    // have no way of knowing when the GPU is done with a buffer - but this
+    // also means buffer access is implicitly synchronized by the driver
+    GLsync sync = NULL;
+    if (params->buf && p->has_fences)
+        sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    if (!sync) {
+        params->callback(params->priv);
+        return;
+    }
+
+    TARRAY_APPEND((void *) gpu, p->callbacks, p->num_callbacks, (struct gl_cb) {
+        .callback = params->callback,
+        .priv = params->priv,
+        .sync = sync,
+    });
+}
+
 static void gl_destroy_gpu(const struct pl_gpu *gpu)
 {
+    gl_poll_callbacks(gpu, true);
     talloc_free((void *) gpu);
 }
 
@@ -66,12 +262,35 @@ static void gl_destroy_gpu(const struct pl_gpu *gpu)
     } while (0)
 
 
+// GLES 3.1 only supports image load/store for a small, fixed set of formats
+static bool gles_storable(GLint ifmt)
+{
+    switch (ifmt) {
+    case GL_RGBA32F:
+    case GL_RGBA16F:
+    case GL_R32F:
+    case GL_RGBA8:
+    case GL_RGBA8_SNORM:
+    case GL_RGBA32I:
+    case GL_RGBA16I:
+    case GL_RGBA8I:
+    case GL_R32I:
+    case GL_RGBA32UI:
+    case GL_RGBA16UI:
+    case GL_RGBA8UI:
+    case GL_R32UI:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static bool gl_setup_formats(struct pl_gpu *gpu)
 {
     struct pl_gl *p = TA_PRIV(gpu);
     int features = gl_format_feature_flags(gpu);
     bool has_fbos = test_ext(gpu, "GL_ARB_framebuffer_object", 30, 20);
-    bool has_storage = test_ext(gpu, "GL_ARB_shader_image_load_store", 42, 0);
+    bool has_storage = test_ext(gpu, "GL_ARB_shader_image_load_store", 42, 31);
 
     for (const struct gl_format *gl_fmt = gl_formats; gl_fmt->ifmt; gl_fmt++) {
         if (gl_fmt->ver && !(gl_fmt->ver & features))
@@ -154,6 +373,7 @@ static bool gl_setup_formats(struct pl_gpu *gpu)
 
         fmt->glsl_type = pl_var_glsl_type_name(pl_var_from_fmt(fmt, ""));
         fmt->glsl_format = pl_fmt_glsl_format(fmt, fmt->num_components);
+        fmt->fourcc = pl_fmt_fourcc(fmt);
         pl_assert(fmt->glsl_type);
 
         // Add format capabilities based on the flags
@@ -167,8 +387,10 @@ static bool gl_setup_formats(struct pl_gpu *gpu)
         if (p->gl_ver || (fmt->caps & PL_FMT_CAP_RENDERABLE))
             fmt->caps |= PL_FMT_CAP_HOST_READABLE;
 
-        if ((gpu->caps & PL_GPU_CAP_COMPUTE) && fmt->glsl_format && has_storage)
-            fmt->caps |= PL_FMT_CAP_STORABLE;
+        if ((gpu->caps & PL_GPU_CAP_COMPUTE) && fmt->glsl_format && has_storage) {
+            if (!gpu->glsl.gles || gles_storable(gl_fmt->ifmt))
+                fmt->caps |= PL_FMT_CAP_STORABLE;
+        }
 
         // Only float-type formats are considered blendable in OpenGL
         switch (fmt->type) {
@@ -192,7 +414,8 @@ next_gl_fmt: ;
     return gl_check_err(gpu, "gl_setup_formats");
 }
 
-const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx)
+const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx,
+                                      const struct pl_opengl_params *params)
 {
     struct pl_gpu *gpu = talloc_zero_priv(NULL, struct pl_gpu, struct pl_gl);
     gpu->ctx = ctx;
@@ -200,13 +423,14 @@ const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx)
 
     struct pl_gl *p = TA_PRIV(gpu);
     p->impl = pl_fns_gl;
+    p->lazy_state = params->lazy_state;
     int ver = epoxy_gl_version();
     p->gl_ver = gpu->glsl.gles ? 0 : ver;
     p->gles_ver = gpu->glsl.gles ? ver : 0;
 
     // Query support for the capabilities
     gpu->caps |= PL_GPU_CAP_INPUT_VARIABLES;
-    if (test_ext(gpu, "GL_ARB_compute_shader", 43, 0))
+    if (test_ext(gpu, "GL_ARB_compute_shader", 43, 31))
         gpu->caps |= PL_GPU_CAP_COMPUTE;
     if (test_ext(gpu, "GL_ARB_buffer_storage", 44, 0))
         gpu->caps |= PL_GPU_CAP_MAPPED_BUFFERS;
@@ -245,9 +469,11 @@ const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx)
 
     if (test_ext(gpu, "GL_ARB_pixel_buffer_object", 31, 0))
         l->max_xfer_size = SIZE_MAX; // no limit imposed by GL
-    if (test_ext(gpu, "GL_ARB_uniform_buffer_object", 31, 0))
+    if (test_ext(gpu, "GL_ARB_uniform_buffer_object", 31, 0)) {
         get(GL_MAX_UNIFORM_BLOCK_SIZE, &l->max_ubo_size);
-    if (test_ext(gpu, "GL_ARB_shader_storage_buffer_object", 43, 0))
+        get(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &l->align_ubo_offset);
+    }
+    if (test_ext(gpu, "GL_ARB_shader_storage_buffer_object", 43, 31))
         get(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &l->max_ssbo_size);
 
     if (test_ext(gpu, "GL_ARB_texture_gather", 40, 0)) {
@@ -269,6 +495,21 @@ const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx)
     p->has_vao = test_ext(gpu, "GL_ARB_vertex_array_object", 30, 0);
     p->has_invalidate = test_ext(gpu, "GL_ARB_invalidate_subdata", 43, 30);
     p->has_queries = test_ext(gpu, "GL_ARB_timer_query", 33, 0);
+    p->has_fences = test_ext(gpu, "GL_ARB_sync", 32, 30);
+
+#ifdef EPOXY_HAS_EGL
+    if (params->egl_display) {
+        EGLDisplay dpy = params->egl_display;
+        if (epoxy_has_egl_extension(dpy, "EGL_EXT_image_dma_buf_import") &&
+            epoxy_has_gl_extension("GL_OES_EGL_image"))
+        {
+            p->egl_dpy = dpy;
+            p->has_egl_modifiers = epoxy_has_egl_extension(dpy,
+                    "EGL_EXT_image_dma_buf_import_modifiers");
+            gpu->import_caps.tex |= PL_HANDLE_DMA_BUF;
+        }
+    }
+#endif
 
     // We simply don't know, so make up some values
     gpu->limits.align_tex_xfer_offset = 32;
@@ -305,16 +546,55 @@ struct pl_tex_gl {
     GLenum format;
     GLint iformat;
     GLenum type;
+
+    // For pipelined uploads/downloads to/from host memory
+    struct pl_buf_pool pbo_write;
+    struct pl_buf_pool pbo_read;
+
+#ifdef EPOXY_HAS_EGL
+    EGLImageKHR image; // for imported DMA-BUFs
+#endif
 };
 
+void gl_add_uploader(const struct pl_gpu *gpu, struct pl_opengl_uploader *up)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    TARRAY_APPEND((void *) gpu, p->uploaders, p->num_uploaders, up);
+}
+
+void gl_remove_uploader(const struct pl_gpu *gpu, struct pl_opengl_uploader *up)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    for (int i = 0; i < p->num_uploaders; i++) {
+        if (p->uploaders[i] == up) {
+            TARRAY_REMOVE_AT(p->uploaders, p->num_uploaders, i);
+            return;
+        }
+    }
+}
+
 static void gl_tex_destroy(const struct pl_gpu *gpu, const struct pl_tex *tex)
 {
+    struct pl_gl *p = TA_PRIV(gpu);
     struct pl_tex_gl *tex_gl = TA_PRIV(tex);
+    gl_state_reset(gpu);
+    gl_wait_callbacks(gpu, tex, NULL, UINT64_MAX);
+    for (int i = 0; i < p->num_uploaders; i++)
+        gl_uploader_forget(p->uploaders[i], tex);
+    pl_buf_pool_uninit(gpu, &tex_gl->pbo_write);
+    pl_buf_pool_uninit(gpu, &tex_gl->pbo_read);
+
     if (tex_gl->fbo && !tex_gl->wrapped_fb)
         glDeleteFramebuffers(1, &tex_gl->fbo);
     if (!tex_gl->wrapped)
         glDeleteTextures(1, &tex_gl->texture);
 
+#ifdef EPOXY_HAS_EGL
+    if (tex_gl->image) {
+        eglDestroyImageKHR(p->egl_dpy, tex_gl->image);
+    }
+#endif
+
     talloc_free((void *) tex);
     gl_check_err(gpu, "gl_tex_destroy");
 }
@@ -336,10 +616,80 @@ static GLbitfield tex_barrier(const struct pl_tex *tex)
     return barrier;
 }
 
+// Binds the memory of an imported DMA-BUF to the currently bound texture
+static bool gl_tex_import_dmabuf(const struct pl_gpu *gpu,
+                                 const struct pl_tex *tex)
+{
+#ifdef EPOXY_HAS_EGL
+    struct pl_gl *p = TA_PRIV(gpu);
+    struct pl_tex_gl *tex_gl = TA_PRIV(tex);
+    const struct pl_tex_params *params = &tex->params;
+    const struct pl_shared_mem *shmem = &params->shared_mem;
+    const struct pl_fmt *fmt = params->format;
+
+    if (tex_gl->target != GL_TEXTURE_2D) {
+        PL_ERR(gpu, "DMA-BUF imports are only supported for 2D textures!");
+        return false;
+    }
+
+    if (!fmt->fourcc) {
+        PL_ERR(gpu, "Texture format '%s' has no DRM fourcc equivalent, cannot "
+               "import as DMA-BUF!", fmt->name);
+        return false;
+    }
+
+    bool explicit_mod = shmem->has_drm_format_mod &&
+                        shmem->drm_format_mod != PL_DRM_FORMAT_MOD_INVALID;
+    if (explicit_mod && shmem->drm_format_mod != PL_DRM_FORMAT_MOD_LINEAR &&
+        !p->has_egl_modifiers)
+    {
+        PL_ERR(gpu, "Importing DMA-BUFs with non-linear DRM format modifiers "
+               "requires EGL_EXT_image_dma_buf_import_modifiers!");
+        return false;
+    }
+
+    EGLint attribs[] = {
+        EGL_WIDTH,                      params->w,
+        EGL_HEIGHT,                     params->h,
+        EGL_LINUX_DRM_FOURCC_EXT,       fmt->fourcc,
+        EGL_DMA_BUF_PLANE0_FD_EXT,      shmem->handle.fd,
+        EGL_DMA_BUF_PLANE0_OFFSET_EXT,  shmem->offset,
+        EGL_DMA_BUF_PLANE0_PITCH_EXT,   PL_DEF(shmem->pitch, params->w * fmt->texel_size),
+        // Filled in below, if needed
+        EGL_NONE, 0,
+        EGL_NONE, 0,
+        EGL_NONE,
+    };
+
+    if (explicit_mod && p->has_egl_modifiers) {
+        EGLint *mod = &attribs[12];
+        mod[0] = EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT;
+        mod[1] = shmem->drm_format_mod & 0xFFFFFFFF;
+        mod[2] = EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT;
+        mod[3] = shmem->drm_format_mod >> 32;
+    }
+
+    tex_gl->image = eglCreateImageKHR(p->egl_dpy, EGL_NO_CONTEXT,
+                                      EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+    if (!tex_gl->image) {
+        PL_ERR(gpu, "Failed importing DMA-BUF: eglCreateImageKHR: 0x%x",
+               (unsigned) eglGetError());
+        return false;
+    }
+
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, tex_gl->image);
+    return gl_check_err(gpu, "gl_tex_import_dmabuf");
+#else
+    PL_ERR(gpu, "Importing DMA-BUFs requires libepoxy with EGL support!");
+    return false;
+#endif
+}
+
 static const struct pl_tex *gl_tex_create(const struct pl_gpu *gpu,
                                           const struct pl_tex_params *params)
 {
     struct pl_gl *p = TA_PRIV(gpu);
+    gl_state_reset(gpu);
 
     struct pl_tex *tex = talloc_zero_priv(NULL, struct pl_tex, struct pl_tex_gl);
     tex->params = *params;
@@ -394,23 +744,31 @@ static const struct pl_tex *gl_tex_create(const struct pl_gpu *gpu,
         break;
     }
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    switch (dims) {
-    case 1:
-        glTexImage1D(tex_gl->target, 0, tex_gl->iformat, params->w, 0,
-                     tex_gl->format, tex_gl->type, params->initial_data);
-        break;
-    case 2:
-        glTexImage2D(tex_gl->target, 0, tex_gl->iformat, params->w, params->h,
-                     0, tex_gl->format, tex_gl->type, params->initial_data);
-        break;
-    case 3:
-        glTexImage3D(tex_gl->target, 0, tex_gl->iformat, params->w, params->h,
-                     params->d, 0, tex_gl->format, tex_gl->type,
-                     params->initial_data);
-        break;
+    if (params->import_handle == PL_HANDLE_DMA_BUF) {
+        if (!gl_tex_import_dmabuf(gpu, tex)) {
+            glBindTexture(tex_gl->target, 0);
+            goto error;
+        }
+    } else {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        switch (dims) {
+        case 1:
+            glTexImage1D(tex_gl->target, 0, tex_gl->iformat, params->w, 0,
+                         tex_gl->format, tex_gl->type, params->initial_data);
+            break;
+        case 2:
+            glTexImage2D(tex_gl->target, 0, tex_gl->iformat, params->w,
+                         params->h, 0, tex_gl->format, tex_gl->type,
+                         params->initial_data);
+            break;
+        case 3:
+            glTexImage3D(tex_gl->target, 0, tex_gl->iformat, params->w,
+                         params->h, params->d, 0, tex_gl->format, tex_gl->type,
+                         params->initial_data);
+            break;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     }
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glBindTexture(tex_gl->target, 0);
 
     if (!gl_check_err(gpu, "gl_tex_create: texture"))
@@ -605,6 +963,7 @@ const struct pl_tex *pl_opengl_wrap(const struct pl_gpu *gpu,
                                     const struct pl_opengl_wrap_params *params)
 {
     struct pl_gl *p = TA_PRIV(gpu);
+    gl_state_reset(gpu);
 
     const struct pl_fmt *fmt = NULL;
     const struct gl_format *glfmt = NULL;
@@ -793,6 +1152,7 @@ static void gl_tex_invalidate(const struct pl_gpu *gpu, const struct pl_tex *tex
 {
     struct pl_gl *p = TA_PRIV(gpu);
     struct pl_tex_gl *tex_gl = TA_PRIV(tex);
+    gl_state_reset(gpu);
 
     if (!p->has_invalidate)
         return;
@@ -813,6 +1173,7 @@ static void gl_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
 {
     struct pl_tex_gl *tex_gl = TA_PRIV(tex);
     pl_assert(tex_gl->fbo || tex_gl->wrapped_fb);
+    gl_state_reset(gpu);
 
     glBindFramebuffer(GL_FRAMEBUFFER, tex_gl->fbo);
     glClearColor(color[0], color[1], color[2], color[3]);
@@ -830,6 +1191,7 @@ static void gl_tex_blit(const struct pl_gpu *gpu,
 
     pl_assert(src_gl->fbo || src_gl->wrapped_fb);
     pl_assert(dst_gl->fbo || dst_gl->wrapped_fb);
+    gl_state_reset(gpu);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, src_gl->fbo);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst_gl->fbo);
 
@@ -984,6 +1346,10 @@ static bool gl_buf_read(const struct pl_gpu *gpu, const struct pl_buf *buf,
 static bool gl_buf_poll(const struct pl_gpu *gpu, const struct pl_buf *buf,
                         uint64_t timeout)
 {
+    // Buffers with pending copies to host memory are still in use
+    if (gl_wait_callbacks(gpu, NULL, buf, timeout))
+        return true;
+
     // Non-persistently mapped buffers are always implicitly reusable in OpenGL,
     // the implementation will create more buffers under the hood if needed.
     if (!buf->data)
@@ -1017,6 +1383,39 @@ static int get_alignment(int stride)
 static void gl_timer_begin(struct pl_timer *timer);
 static void gl_timer_end(struct pl_timer *timer);
 
+static bool gl_tex_upload(const struct pl_gpu *gpu,
+                          const struct pl_tex_transfer_params *params);
+
+// Pipelined upload from host memory: copies the data into one of a ring of
+// persistently mapped PBOs and uploads from there. This avoids both the
+// driver-side copy and the implicit synchronization of uploading directly
+// from client memory, since the PBO is only reused once its fence signals.
+static bool gl_tex_upload_async(const struct pl_gpu *gpu,
+                                const struct pl_tex_transfer_params *params)
+{
+    const struct pl_tex *tex = params->tex;
+    struct pl_tex_gl *tex_gl = TA_PRIV(tex);
+    size_t size = pl_tex_transfer_size(params);
+
+    const struct pl_buf *buf;
+    buf = pl_buf_pool_get(gpu, &tex_gl->pbo_write, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = size,
+        .host_mapped = true,
+    });
+
+    if (!buf)
+        return false;
+
+    memcpy(buf->data, params->ptr, size);
+
+    struct pl_tex_transfer_params fixed = *params;
+    fixed.buf = buf;
+    fixed.buf_offset = 0;
+    fixed.ptr = NULL;
+    return gl_tex_upload(gpu, &fixed);
+}
+
 static bool gl_tex_upload(const struct pl_gpu *gpu,
                           const struct pl_tex_transfer_params *params)
 {
@@ -1026,6 +1425,14 @@ static bool gl_tex_upload(const struct pl_gpu *gpu,
     struct pl_tex_gl *tex_gl = TA_PRIV(tex);
     struct pl_buf_gl *buf_gl = buf ? TA_PRIV(buf) : NULL;
 
+    gl_state_reset(gpu);
+    gl_poll_callbacks(gpu, false);
+
+    // Uploading directly from host memory forces the driver to copy the data
+    // (or stall), so stream it through a mapped PBO instead if we can
+    if (!buf && p->has_fences && (gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS))
+        return gl_tex_upload_async(gpu, params);
+
     const void *src = params->ptr;
     if (buf) {
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf_gl->buffer);
@@ -1099,7 +1506,66 @@ static bool gl_tex_upload(const struct pl_gpu *gpu,
         }
     }
 
-    return gl_check_err(gpu, "gl_tex_upload");
+    if (!gl_check_err(gpu, "gl_tex_upload"))
+        return false;
+
+    gl_transfer_callback(gpu, params);
+    return true;
+}
+
+static bool gl_tex_download(const struct pl_gpu *gpu,
+                            const struct pl_tex_transfer_params *params);
+
+// Pipelined download to host memory: reads the texture into one of a ring of
+// mapped PBOs, and copies the result to `params->ptr` once its fence signals,
+// right before firing the callback. This avoids stalling on the readback.
+static bool gl_tex_download_async(const struct pl_gpu *gpu,
+                                  const struct pl_tex_transfer_params *params)
+{
+    struct pl_gl *p = TA_PRIV(gpu);
+    const struct pl_tex *tex = params->tex;
+    struct pl_tex_gl *tex_gl = TA_PRIV(tex);
+    size_t size = pl_tex_transfer_size(params);
+
+    // Growing the buffers re-creates the pool, so make sure none of the
+    // buffers being freed still have pending copies
+    if (size > tex_gl->pbo_read.current_params.size)
+        gl_wait_callbacks(gpu, tex, NULL, UINT64_MAX);
+
+    const struct pl_buf *buf;
+    buf = pl_buf_pool_get(gpu, &tex_gl->pbo_read, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = size,
+        .host_mapped = true,
+    });
+
+    if (!buf)
+        return false;
+
+    struct pl_tex_transfer_params fixed = *params;
+    fixed.buf = buf;
+    fixed.ptr = NULL;
+    fixed.callback = NULL;
+    if (!gl_tex_download(gpu, &fixed))
+        return false;
+
+    GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!sync) {
+        gl_check_err(gpu, "gl_tex_download_async");
+        return false;
+    }
+
+    TARRAY_APPEND((void *) gpu, p->callbacks, p->num_callbacks, (struct gl_cb) {
+        .callback = params->callback,
+        .priv = params->priv,
+        .sync = sync,
+        .tex = tex,
+        .buf = buf,
+        .dst = params->ptr,
+        .size = size,
+    });
+
+    return true;
 }
 
 static bool gl_tex_download(const struct pl_gpu *gpu,
@@ -1112,6 +1578,17 @@ static bool gl_tex_download(const struct pl_gpu *gpu,
     struct pl_buf_gl *buf_gl = buf ? TA_PRIV(buf) : NULL;
     bool ok = true;
 
+    gl_state_reset(gpu);
+    gl_poll_callbacks(gpu, false);
+
+    // Reading back directly to host memory stalls the pipeline, so avoid
+    // it if the user is prepared to be notified of completion asynchronously
+    if (!buf && params->callback && p->has_fences &&
+        (gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS))
+    {
+        return gl_tex_download_async(gpu, params);
+    }
+
     void *dst = params->ptr;
     if (buf) {
         glBindBuffer(GL_PIXEL_PACK_BUFFER, buf_gl->buffer);
@@ -1180,7 +1657,10 @@ static bool gl_tex_download(const struct pl_gpu *gpu,
         }
     }
 
-    return gl_check_err(gpu, "gl_tex_download") && ok;
+    ok &= gl_check_err(gpu, "gl_tex_download");
+    if (ok)
+        gl_transfer_callback(gpu, params);
+    return ok;
 }
 
 static int gl_desc_namespace(const struct pl_gpu *gpu, enum pl_desc_type type)
@@ -1349,6 +1829,7 @@ struct pl_pass_gl {
 static void gl_pass_destroy(const struct pl_gpu *gpu, const struct pl_pass *pass)
 {
     struct pl_pass_gl *pass_gl = TA_PRIV(pass);
+    gl_state_reset(gpu);
 
     if (pass_gl->vao)
         glDeleteVertexArrays(1, &pass_gl->vao);
@@ -1386,6 +1867,7 @@ static const struct pl_pass *gl_pass_create(const struct pl_gpu *gpu,
     struct pl_pass *pass = talloc_zero_priv(NULL, struct pl_pass, struct pl_pass_gl);
     struct pl_pass_gl *pass_gl = TA_PRIV(pass);
     pass->params = pl_pass_params_copy(pass, params);
+    gl_state_reset(gpu);
 
     // Load/Compile program
     if ((pass_gl->program = load_cached_program(gpu, params))) {
@@ -1448,8 +1930,43 @@ static const struct pl_pass *gl_pass_create(const struct pl_gpu *gpu,
         // For compatibility with older OpenGL, we need to explicitly update
         // the texture/image unit bindings after creating the shader program,
         // since specifying it directly requires GLSL 4.20+
-        GLint loc = glGetUniformLocation(pass_gl->program, params->descriptors[i].name);
-        glUniform1i(loc, params->descriptors[i].binding);
+        const struct pl_desc *desc = &params->descriptors[i];
+        switch (desc->type) {
+        case PL_DESC_BUF_UNIFORM: {
+            GLuint idx = glGetUniformBlockIndex(pass_gl->program, desc->name);
+            if (idx == GL_INVALID_INDEX) {
+                PL_WARN(gpu, "Uniform block '%s' not found in program, "
+                        "skipping binding!", desc->name);
+                continue;
+            }
+            glUniformBlockBinding(pass_gl->program, idx, desc->binding);
+            continue;
+        }
+        case PL_DESC_BUF_STORAGE: {
+            // GLES only supports (and `generate_shaders` always emits)
+            // explicit bindings in the shader itself
+            if (gpu->glsl.gles)
+                continue;
+            GLuint idx = glGetProgramResourceIndex(pass_gl->program,
+                                                   GL_SHADER_STORAGE_BLOCK,
+                                                   desc->name);
+            if (idx == GL_INVALID_INDEX) {
+                PL_WARN(gpu, "Storage block '%s' not found in program, "
+                        "skipping binding!", desc->name);
+                continue;
+            }
+            glShaderStorageBlockBinding(pass_gl->program, idx, desc->binding);
+            continue;
+        }
+        case PL_DESC_STORAGE_IMG:
+            if (gpu->glsl.gles)
+                continue; // same as above
+            break;
+        default: break;
+        }
+
+        GLint loc = glGetUniformLocation(pass_gl->program, desc->name);
+        glUniform1i(loc, desc->binding);
     }
 
     glUseProgram(0);
@@ -1542,8 +2059,8 @@ static void update_var(const struct pl_pass *pass,
     }
 }
 
-static void update_desc(const struct pl_pass *pass, int index,
-                        const struct pl_desc_binding *db)
+static void update_desc(const struct pl_gpu *gpu, const struct pl_pass *pass,
+                        int index, const struct pl_desc_binding *db)
 {
     const struct pl_desc *desc = &pass->params.descriptors[index];
 
@@ -1557,8 +2074,7 @@ static void update_desc(const struct pl_pass *pass, int index,
     case PL_DESC_SAMPLED_TEX: {
         const struct pl_tex *tex = db->object;
         struct pl_tex_gl *tex_gl = TA_PRIV(tex);
-        glActiveTexture(GL_TEXTURE0 + desc->binding);
-        glBindTexture(tex_gl->target, tex_gl->texture);
+        gl_bind_tex(TA_PRIV(gpu), desc->binding, tex_gl->target, tex_gl->texture);
         break;
     }
     case PL_DESC_STORAGE_IMG: {
@@ -1571,7 +2087,12 @@ static void update_desc(const struct pl_pass *pass, int index,
     case PL_DESC_BUF_UNIFORM: {
         const struct pl_buf *buf = db->object;
         struct pl_buf_gl *buf_gl = TA_PRIV(buf);
-        glBindBufferBase(buf_gl->target, desc->binding, buf_gl->buffer);
+        if (db->offset) {
+            glBindBufferRange(buf_gl->target, desc->binding, buf_gl->buffer,
+                              db->offset, buf->params.size - db->offset);
+        } else {
+            glBindBufferBase(buf_gl->target, desc->binding, buf_gl->buffer);
+        }
         break;
     }
     case PL_DESC_BUF_STORAGE: {
@@ -1587,17 +2108,23 @@ static void update_desc(const struct pl_pass *pass, int index,
     }
 }
 
-static void unbind_desc(const struct pl_pass *pass, int index,
-                        const struct pl_desc_binding *db)
+// Returns the memory barriers required for any writes through this descriptor
+static GLbitfield unbind_desc(const struct pl_gpu *gpu, const struct pl_pass *pass,
+                              int index, const struct pl_desc_binding *db)
 {
     const struct pl_desc *desc = &pass->params.descriptors[index];
+    GLbitfield barrier = 0;
 
     switch (desc->type) {
     case PL_DESC_SAMPLED_TEX: {
+        // Tracked texture units are unbound by `gl_state_reset`
+        if (desc->binding < GL_STATE_TEX_UNITS)
+            break;
         const struct pl_tex *tex = db->object;
         struct pl_tex_gl *tex_gl = TA_PRIV(tex);
         glActiveTexture(GL_TEXTURE0 + desc->binding);
         glBindTexture(tex_gl->target, 0);
+        glActiveTexture(GL_TEXTURE0);
         break;
     }
     case PL_DESC_STORAGE_IMG: {
@@ -1606,7 +2133,7 @@ static void unbind_desc(const struct pl_pass *pass, int index,
         glBindImageTexture(desc->binding, 0, 0, GL_FALSE, 0,
                            GL_WRITE_ONLY, GL_R32F);
         if (desc->access != PL_DESC_ACCESS_READONLY)
-            glMemoryBarrier(tex_gl->barrier);
+            barrier |= tex_gl->barrier;
         break;
     }
     case PL_DESC_BUF_UNIFORM:
@@ -1615,7 +2142,7 @@ static void unbind_desc(const struct pl_pass *pass, int index,
         struct pl_buf_gl *buf_gl = TA_PRIV(buf);
         glBindBufferBase(buf_gl->target, desc->binding, 0);
         if (desc->type == PL_DESC_BUF_STORAGE && desc->access != PL_DESC_ACCESS_READONLY)
-            glMemoryBarrier(buf_gl->barrier);
+            barrier |= buf_gl->barrier;
         break;
     }
     case PL_DESC_BUF_TEXEL_UNIFORM:
@@ -1623,6 +2150,8 @@ static void unbind_desc(const struct pl_pass *pass, int index,
         abort(); // TODO
     default: abort();
     }
+
+    return barrier;
 }
 
 static void gl_pass_run(const struct pl_gpu *gpu,
@@ -1632,13 +2161,16 @@ static void gl_pass_run(const struct pl_gpu *gpu,
     struct pl_pass_gl *pass_gl = TA_PRIV(pass);
     struct pl_gl *p = TA_PRIV(gpu);
 
-    glUseProgram(pass_gl->program);
+    gl_use_program(p, pass_gl->program);
 
     for (int i = 0; i < params->num_var_updates; i++)
         update_var(pass, &params->var_updates[i]);
     for (int i = 0; i < pass->params.num_descriptors; i++)
-        update_desc(pass, i, &params->desc_bindings[i]);
-    glActiveTexture(GL_TEXTURE0);
+        update_desc(gpu, pass, i, &params->desc_bindings[i]);
+    if (p->state.active_unit_dirty) {
+        glActiveTexture(GL_TEXTURE0);
+        p->state.active_unit_dirty = false;
+    }
 
     if (!gl_check_err(gpu, "gl_pass_run: updating uniforms"))
         return;
@@ -1646,7 +2178,7 @@ static void gl_pass_run(const struct pl_gpu *gpu,
     switch (pass->params.type) {
     case PL_PASS_RASTER: {
         struct pl_tex_gl *target_gl = TA_PRIV(params->target);
-        glBindFramebuffer(GL_FRAMEBUFFER, target_gl->fbo);
+        gl_bind_fbo(p, target_gl->fbo);
         if (!pass->params.load_target && p->has_invalidate) {
             GLenum fb = target_gl->fbo ? GL_COLOR_ATTACHMENT0 : GL_COLOR;
             glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &fb);
@@ -1656,7 +2188,10 @@ static void gl_pass_run(const struct pl_gpu *gpu,
                    pl_rect_w(params->viewport), pl_rect_h(params->viewport));
         glScissor(params->scissors.x0, params->scissors.y0,
                   pl_rect_w(params->scissors), pl_rect_h(params->scissors));
-        glEnable(GL_SCISSOR_TEST);
+        if (!p->state.scissor) {
+            glEnable(GL_SCISSOR_TEST);
+            p->state.scissor = true;
+        }
         gl_check_err(gpu, "gl_pass_run: enabling viewport/scissor");
 
         const struct pl_blend_params *blend = pass->params.blend_params;
@@ -1668,11 +2203,25 @@ static void gl_pass_run(const struct pl_gpu *gpu,
                 [PL_BLEND_ONE_MINUS_SRC_ALPHA]  = GL_ONE_MINUS_SRC_ALPHA,
             };
 
-            glBlendFuncSeparate(map_blend[blend->src_rgb],
-                                map_blend[blend->dst_rgb],
-                                map_blend[blend->src_alpha],
-                                map_blend[blend->dst_alpha]);
-            glEnable(GL_BLEND);
+            GLenum func[4] = {
+                map_blend[blend->src_rgb],
+                map_blend[blend->dst_rgb],
+                map_blend[blend->src_alpha],
+                map_blend[blend->dst_alpha],
+            };
+
+            if (memcmp(func, p->state.blend_func, sizeof(func)) != 0) {
+                glBlendFuncSeparate(func[0], func[1], func[2], func[3]);
+                memcpy(p->state.blend_func, func, sizeof(func));
+            }
+
+            if (!p->state.blend) {
+                glEnable(GL_BLEND);
+                p->state.blend = true;
+            }
+        } else if (p->state.blend) {
+            glDisable(GL_BLEND);
+            p->state.blend = false;
         }
         gl_check_err(gpu, "gl_pass_run: enabling blend");
 
@@ -1708,9 +2257,6 @@ static void gl_pass_run(const struct pl_gpu *gpu,
         }
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDisable(GL_SCISSOR_TEST);
-        glDisable(GL_BLEND);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
         break;
     }
 
@@ -1725,11 +2271,33 @@ static void gl_pass_run(const struct pl_gpu *gpu,
     default: abort();
     }
 
+    // Make all incoherent writes (image stores, storage buffers) visible to
+    // their subsequent uses, using a single barrier for the whole pass
+    GLbitfield barrier = 0;
     for (int i = 0; i < pass->params.num_descriptors; i++)
-        unbind_desc(pass, i, &params->desc_bindings[i]);
-    glActiveTexture(GL_TEXTURE0);
+        barrier |= unbind_desc(gpu, pass, i, &params->desc_bindings[i]);
+    if (barrier)
+        glMemoryBarrier(barrier);
+
+    // Persistently mapped buffers may be overwritten by the host at any time,
+    // so make pl_buf_poll track the GPU's use of them. (This must come after
+    // the barrier, for host reads to see the results)
+    for (int i = 0; i < pass->params.num_descriptors; i++) {
+        enum pl_desc_type type = pass->params.descriptors[i].type;
+        if (type != PL_DESC_BUF_UNIFORM && type != PL_DESC_BUF_STORAGE)
+            continue;
 
-    glUseProgram(0);
+        const struct pl_buf *buf = params->desc_bindings[i].object;
+        struct pl_buf_gl *buf_gl = TA_PRIV(buf);
+        if (buf->data) {
+            glDeleteSync(buf_gl->fence);
+            buf_gl->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    // Leave the state bound for the next pass if possible
+    if (!p->lazy_state)
+        gl_state_reset(gpu);
     gl_check_err(gpu, "gl_pass_run");
 }
 
@@ -1800,13 +2368,17 @@ static void gl_timer_end(struct pl_timer *timer)
 
 static void gl_gpu_flush(const struct pl_gpu *gpu)
 {
+    gl_state_reset(gpu);
     glFlush();
+    gl_poll_callbacks(gpu, false);
     gl_check_err(gpu, "gl_gpu_flush");
 }
 
 static void gl_gpu_finish(const struct pl_gpu *gpu)
 {
+    gl_state_reset(gpu);
     glFinish();
+    gl_poll_callbacks(gpu, true);
     gl_check_err(gpu, "gl_gpu_finish");
 }
 
@@ -20,7 +20,16 @@
 #include "../gpu.h"
 #include "common.h"
 
-const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx);
+const struct pl_gpu *pl_gpu_create_gl(struct pl_context *ctx,
+                                      const struct pl_opengl_params *params);
 
 const struct pl_tex *pl_opengl_wrap_fb(const struct pl_gpu *gpu, GLuint fbo,
                                        int w, int h);
+
+// Background uploaders register themselves with their `pl_gpu`, so that the
+// fences they hold for a texture can be released when it gets destroyed
+void gl_add_uploader(const struct pl_gpu *gpu, struct pl_opengl_uploader *up);
+void gl_remove_uploader(const struct pl_gpu *gpu, struct pl_opengl_uploader *up);
+
+// Waits for all queued uploads to `tex` and discards their fences (upload.c)
+void gl_uploader_forget(struct pl_opengl_uploader *up, const struct pl_tex *tex);
@@ -0,0 +1,366 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+
+#include "common.h"
+#include "formats.h"
+#include "gpu.h"
+#include "utils.h"
+
+struct upload_job {
+    uint64_t id;
+    struct pl_tex_transfer_params params;
+    GLuint texture;
+    GLenum target;
+    GLenum format;
+    GLenum type;
+    GLsync ready; // signalled once the main context is done with the texture
+};
+
+struct upload_fence {
+    const struct pl_tex *tex;
+    GLsync sync; // or NULL if the upload failed
+};
+
+struct pl_opengl_uploader {
+    struct pl_context *ctx;
+    const struct pl_gpu *gpu;
+    struct pl_opengl_uploader_params params;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup; // signalled when new jobs are queued
+    pthread_cond_t done;   // signalled whenever the worker finishes a job
+    bool started;
+    bool failed;
+    bool quit;
+
+    // Jobs stay in the queue until the worker has finished them, after which
+    // their fence is moved to `fences`, until consumed by
+    // `pl_opengl_uploader_sync`. Only the most recent fence of each texture is
+    // kept, since it also covers all prior uploads. Both protected by `lock`
+    struct upload_job *queue;
+    int num_queue;
+    struct upload_fence *fences;
+    int num_fences;
+    uint64_t num_submitted;
+
+    // only accessed by the worker thread
+    GLuint pbo;
+};
+
+static int get_alignment(size_t stride)
+{
+    if (stride % 8 == 0)
+        return 8;
+    if (stride % 4 == 0)
+        return 4;
+    if (stride % 2 == 0)
+        return 2;
+    return 1;
+}
+
+// Runs on the worker thread. Returns the fence signalling the completion of
+// the upload, or NULL on failure
+static GLsync run_job(struct pl_opengl_uploader *up, const struct upload_job *job)
+{
+    const struct pl_tex_transfer_params *params = &job->params;
+    const struct pl_tex *tex = params->tex;
+    size_t size = pl_tex_transfer_size(params);
+    GLsync sync = NULL;
+
+    // Wait for the main context to be done with the texture, to avoid
+    // overwriting it while it's still being sampled from
+    glWaitSync(job->ready, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync(job->ready);
+
+    // Orphan the previous contents of the PBO, so we don't have to wait for
+    // the previous upload to finish before reusing it
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, up->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (data) {
+        memcpy(data, params->ptr, size);
+        data = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) ? data : NULL;
+    }
+
+    if (params->callback)
+        params->callback(params->priv);
+
+    if (!data) {
+        PL_ERR(up, "Failed mapping PBO for background upload!");
+        goto done;
+    }
+
+    size_t texel = tex->params.format->texel_size;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, get_alignment(params->stride_w * texel));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, params->stride_w);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, params->stride_h);
+    glBindTexture(job->target, job->texture);
+
+    const struct pl_rect3d *rc = &params->rc;
+    switch (pl_tex_params_dimension(tex->params)) {
+    case 1:
+        glTexSubImage1D(job->target, 0, rc->x0, pl_rect_w(*rc),
+                        job->format, job->type, NULL);
+        break;
+    case 2:
+        glTexSubImage2D(job->target, 0, rc->x0, rc->y0, pl_rect_w(*rc),
+                        pl_rect_h(*rc), job->format, job->type, NULL);
+        break;
+    case 3:
+        glTexSubImage3D(job->target, 0, rc->x0, rc->y0, rc->z0, pl_rect_w(*rc),
+                        pl_rect_h(*rc), pl_rect_d(*rc), job->format, job->type,
+                        NULL);
+        break;
+    }
+
+    glBindTexture(job->target, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+
+    // The fence must be flushed for the main context to be able to wait on it
+    sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+done:
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!gl_check_err(up->gpu, "pl_opengl_upload")) {
+        glDeleteSync(sync);
+        sync = NULL;
+    }
+
+    return sync;
+}
+
+static void *upload_thread(void *arg)
+{
+    struct pl_opengl_uploader *up = arg;
+    bool ok = up->params.make_current(up->params.priv);
+    if (ok)
+        glGenBuffers(1, &up->pbo);
+
+    pthread_mutex_lock(&up->lock);
+    up->started = true;
+    up->failed = !ok;
+    pthread_cond_broadcast(&up->done);
+
+    while (ok) {
+        while (!up->num_queue && !up->quit)
+            pthread_cond_wait(&up->wakeup, &up->lock);
+        if (!up->num_queue)
+            break; // quit requested and all jobs finished
+
+        struct upload_job job = up->queue[0];
+        pthread_mutex_unlock(&up->lock);
+        GLsync sync = run_job(up, &job);
+        pthread_mutex_lock(&up->lock);
+
+        TARRAY_REMOVE_AT(up->queue, up->num_queue, 0);
+
+        // Replace the stale fence of a previous upload to the same texture
+        struct upload_fence *f = NULL;
+        for (int i = 0; i < up->num_fences; i++) {
+            if (up->fences[i].tex == job.params.tex)
+                f = &up->fences[i];
+        }
+
+        if (f && sync) {
+            glDeleteSync(f->sync);
+            f->sync = sync;
+        } else {
+            TARRAY_APPEND(up, up->fences, up->num_fences, (struct upload_fence) {
+                .tex = job.params.tex,
+                .sync = sync,
+            });
+        }
+        pthread_cond_broadcast(&up->done);
+    }
+
+    pthread_mutex_unlock(&up->lock);
+
+    if (ok) {
+        glDeleteBuffers(1, &up->pbo);
+        up->params.release_current(up->params.priv);
+    }
+
+    return NULL;
+}
+
+struct pl_opengl_uploader *pl_opengl_uploader_create(const struct pl_opengl *gl,
+                            const struct pl_opengl_uploader_params *params)
+{
+    pl_assert(params->make_current && params->release_current);
+    const struct pl_gpu *gpu = gl->gpu;
+
+    int ver = epoxy_gl_version();
+    if (ver < (epoxy_is_desktop_gl() ? 32 : 30)) {
+        PL_ERR(gpu, "Background uploads require GL 3.2 or GLES 3.0!");
+        return NULL;
+    }
+
+    struct pl_opengl_uploader *up = talloc_zero(NULL, struct pl_opengl_uploader);
+    up->ctx = gpu->ctx;
+    up->gpu = gpu;
+    up->params = *params;
+    up->params.queue_depth = PL_DEF(params->queue_depth, 4);
+
+    pthread_mutex_init(&up->lock, NULL);
+    pthread_cond_init(&up->wakeup, NULL);
+    pthread_cond_init(&up->done, NULL);
+
+    if (pthread_create(&up->thread, NULL, upload_thread, up) != 0) {
+        PL_ERR(up, "Failed creating background upload thread!");
+        goto error;
+    }
+
+    pthread_mutex_lock(&up->lock);
+    while (!up->started)
+        pthread_cond_wait(&up->done, &up->lock);
+    bool failed = up->failed;
+    pthread_mutex_unlock(&up->lock);
+
+    if (failed) {
+        PL_ERR(up, "Failed binding the shared GL context for background "
+               "uploads!");
+        pthread_join(up->thread, NULL);
+        goto error;
+    }
+
+    gl_add_uploader(gpu, up);
+    return up;
+
+error:
+    pthread_cond_destroy(&up->done);
+    pthread_cond_destroy(&up->wakeup);
+    pthread_mutex_destroy(&up->lock);
+    talloc_free(up);
+    return NULL;
+}
+
+void pl_opengl_uploader_destroy(struct pl_opengl_uploader **ptr)
+{
+    struct pl_opengl_uploader *up = *ptr;
+    if (!up)
+        return;
+
+    gl_remove_uploader(up->gpu, up);
+    pthread_mutex_lock(&up->lock);
+    up->quit = true;
+    pthread_cond_broadcast(&up->wakeup);
+    pthread_mutex_unlock(&up->lock);
+    pthread_join(up->thread, NULL);
+
+    for (int i = 0; i < up->num_fences; i++)
+        glDeleteSync(up->fences[i].sync);
+
+    pthread_cond_destroy(&up->done);
+    pthread_cond_destroy(&up->wakeup);
+    pthread_mutex_destroy(&up->lock);
+    talloc_free(up);
+    *ptr = NULL;
+}
+
+bool pl_opengl_upload(struct pl_opengl_uploader *up,
+                      const struct pl_tex_transfer_params *params)
+{
+    const struct pl_tex *tex = params->tex;
+    struct upload_job job = { .params = *params };
+    job.params.timer = NULL;
+
+    if (!tex || !tex->params.host_writable || !params->ptr ||
+        !pl_tex_transfer_fix(up->gpu, &job.params))
+    {
+        PL_ERR(up, "Invalid parameters for `pl_opengl_upload`!");
+        return false;
+    }
+
+    job.texture = pl_opengl_unwrap(up->gpu, tex, &job.target, NULL, NULL);
+    if (!job.texture)
+        return false;
+
+    const struct gl_format **fmtp = TA_PRIV(tex->params.format);
+    job.format = (*fmtp)->fmt;
+    job.type = (*fmtp)->type;
+
+    // Make the worker wait for all prior commands of the main context, since
+    // these may still be using the texture
+    job.ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    if (!gl_check_err(up->gpu, "pl_opengl_upload")) {
+        glDeleteSync(job.ready);
+        return false;
+    }
+
+    pthread_mutex_lock(&up->lock);
+    while (up->num_queue >= up->params.queue_depth)
+        pthread_cond_wait(&up->done, &up->lock);
+    job.id = ++up->num_submitted;
+    TARRAY_APPEND(up, up->queue, up->num_queue, job);
+    pthread_cond_signal(&up->wakeup);
+    pthread_mutex_unlock(&up->lock);
+    return true;
+}
+
+// Waits for the worker to finish all jobs for `tex`, and then releases their
+// fences, after making the main context wait on them if `wait` is set. Must be
+// called with `lock` held
+static void consume_fences(struct pl_opengl_uploader *up,
+                           const struct pl_tex *tex, bool wait)
+{
+    // Since jobs are processed in order, it's enough to wait for the most
+    // recent one
+    uint64_t last = 0;
+    for (int i = 0; i < up->num_queue; i++) {
+        if (up->queue[i].params.tex == tex)
+            last = up->queue[i].id;
+    }
+
+    while (up->num_queue && up->queue[0].id <= last)
+        pthread_cond_wait(&up->done, &up->lock);
+
+    for (int i = 0; i < up->num_fences; i++) {
+        struct upload_fence *f = &up->fences[i];
+        if (f->tex != tex)
+            continue;
+
+        if (f->sync && wait)
+            glWaitSync(f->sync, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(f->sync);
+
+        TARRAY_REMOVE_AT(up->fences, up->num_fences, i);
+        i--;
+    }
+}
+
+void pl_opengl_uploader_sync(struct pl_opengl_uploader *up,
+                             const struct pl_tex *tex)
+{
+    pthread_mutex_lock(&up->lock);
+    consume_fences(up, tex, true);
+    pthread_mutex_unlock(&up->lock);
+}
+
+void gl_uploader_forget(struct pl_opengl_uploader *up, const struct pl_tex *tex)
+{
+    pthread_mutex_lock(&up->lock);
+    consume_fences(up, tex, false);
+    pthread_mutex_unlock(&up->lock);
+}
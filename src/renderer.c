@@ -39,6 +39,52 @@ struct sampler {
     const struct pl_tex *sep_fbo_down;
 };
 
+// Intermediate image rendered as part of a frame mixing operation
+struct cached_frame {
+    uint64_t signature;
+    uint64_t params_hash; // for detecting when the cached result is stale
+    const struct pl_tex *tex;
+    bool evict; // for garbage collection
+};
+
+// Output of `pass_scale_main` for a recently rendered image, kept around so
+// that changes which only affect `pass_output_target` (e.g. dithering or the
+// target colorspace) don't need to redo the upstream processing
+struct cached_scaled {
+    uint64_t hash;      // upstream state of `tex`, or 0 if invalid
+    uint64_t last_hash; // upstream state of the previous frame
+    uint64_t key;       // upstream state of the current frame, or 0 to bypass
+    const struct pl_tex *tex;
+
+    // Metadata of the `struct img` stored in `tex`
+    struct pl_rect2df rect;
+    struct pl_color_repr repr;
+    struct pl_color_space color;
+    int comps;
+
+    // The rects and image colorspace as inferred by `pass_read_image`
+    struct pl_rect2df src_rect;
+    struct pl_rect2df dst_rect;
+    struct pl_rect2d dst_irect;
+    struct pl_color_space image_color;
+};
+
+// Number of passes considered for the rolling timing statistics
+#define STATS_WINDOW 32
+
+// Upper bound on the number of passes of a single stage timed per frame
+#define MAX_STAGE_TIMERS 64
+
+struct stage_stats {
+    // One timer per pass of this stage within a frame, since a timer's
+    // results would otherwise get interleaved (or dropped) between passes
+    struct pl_timer **timers;
+    int num_timers;
+    int timers_used; // for the current frame
+    uint64_t samples[STATS_WINDOW];
+    uint64_t count;
+};
+
 struct pl_renderer {
     const struct pl_gpu *gpu;
     struct pl_context *ctx;
@@ -56,6 +102,7 @@ struct pl_renderer {
     bool disable_blending;      // disable blending for the target/fbofmt
     bool disable_overlay;       // disable rendering overlays
     bool disable_3dlut;         // disable usage of a 3DLUT
+    bool disable_color_lut;     // disable baking the color conversion
     bool disable_peak_detect;   // disable peak detection shader
     bool disable_grain;         // disable AV1 grain code
     bool disable_hooks;         // disable user hooks / custom shaders
@@ -64,12 +111,49 @@ struct pl_renderer {
     struct pl_shader_obj *peak_detect_state;
     struct pl_shader_obj *dither_state;
     struct pl_shader_obj *lut3d_state;
+    struct pl_shader_obj *color_lut_state;
+    uint64_t color_lut_sig;     // conversion baked into `color_lut_state`
     struct pl_shader_obj *grain_state[4];
     const struct pl_tex **fbos;
     int num_fbos;
     struct sampler samplers[SCALER_COUNT];
     struct sampler *osd_samplers;
     int num_osd_samplers;
+
+    // Frame cache (for frame mixing)
+    struct cached_frame *frames;
+    int num_frames;
+
+    // Output cache (for redrawing target overlays on top of static frames).
+    // `output_tex` holds a copy of the target contents prior to drawing the
+    // target overlays, rendered with the state hashed as `output_hash`
+    const struct pl_tex *output_tex;
+    uint64_t output_hash;
+    uint64_t last_hash;                 // state of the previous frame
+    const struct pl_tex *output_fbo;    // target of the previous frame
+    struct pl_rect2d *osd_rects;        // target overlay areas of the same
+    int num_osd_rects;
+
+    // Scaled image cache (for re-outputting static frames)
+    struct cached_scaled scaled;
+
+    // Per-stage timing statistics
+    struct stage_stats stages[PL_RENDER_STAGE_COUNT];
+    bool probing; // between `probe_begin` and `probe_end`, nothing is timed
+    uint64_t async_ready; // `probe_key` of the last fully compiled frame
+
+    // Start of the current `begin_render` / `end_render` span, for tracing
+    uint64_t trace_start;
+
+    // Work counters (see `pl_render_stats`). The dispatch and GPU counters
+    // are cumulative, so these store their values at the time of the last
+    // reset, and at the start of the current frame, respectively.
+    uint64_t frames_rendered;
+    uint64_t fbos_allocated;
+    struct pl_dispatch_stats dp_base;
+    struct pl_gpu_stats gpu_base;
+    struct pl_dispatch_stats frame_base;
+    struct pl_dispatch_stats last_frame;
 };
 
 static void find_fbo_format(struct pl_renderer *rr)
@@ -138,6 +222,7 @@ struct pl_renderer *pl_renderer_create(struct pl_context *ctx,
     };
 
     assert(rr->dp);
+    pl_gpu_stats(gpu, &rr->gpu_base);
     find_fbo_format(rr);
     return rr;
 }
@@ -156,14 +241,15 @@ void pl_renderer_destroy(struct pl_renderer **p_rr)
     if (!rr)
         return;
 
-    // Free all intermediate FBOs
+    // Hand all intermediate FBOs back to the GPU's texture pool
     for (int i = 0; i < rr->num_fbos; i++)
-        pl_tex_destroy(rr->gpu, &rr->fbos[i]);
+        pl_tex_pool_put(rr->gpu, &rr->fbos[i]);
 
     // Free all shader resource objects
     pl_shader_obj_destroy(&rr->peak_detect_state);
     pl_shader_obj_destroy(&rr->dither_state);
     pl_shader_obj_destroy(&rr->lut3d_state);
+    pl_shader_obj_destroy(&rr->color_lut_state);
     for (int i = 0; i < PL_ARRAY_SIZE(rr->grain_state); i++)
         pl_shader_obj_destroy(&rr->grain_state[i]);
 
@@ -173,18 +259,373 @@ void pl_renderer_destroy(struct pl_renderer **p_rr)
     for (int i = 0; i < rr->num_osd_samplers; i++)
         sampler_destroy(rr, &rr->osd_samplers[i]);
 
+    // Free all cached frames
+    for (int i = 0; i < rr->num_frames; i++)
+        pl_tex_pool_put(rr->gpu, &rr->frames[i].tex);
+    pl_tex_pool_put(rr->gpu, &rr->output_tex);
+    pl_tex_pool_put(rr->gpu, &rr->scaled.tex);
+
+    // Free all timers
+    for (int i = 0; i < PL_ARRAY_SIZE(rr->stages); i++) {
+        struct stage_stats *st = &rr->stages[i];
+        for (int n = 0; n < st->num_timers; n++)
+            pl_timer_destroy(rr->gpu, &st->timers[n]);
+    }
+
     pl_dispatch_destroy(&rr->dp);
     TA_FREEP(p_rr);
 }
 
 void pl_renderer_flush_cache(struct pl_renderer *rr)
 {
+    for (int i = 0; i < rr->num_frames; i++)
+        pl_tex_pool_put(rr->gpu, &rr->frames[i].tex);
+    rr->num_frames = 0;
+
+    pl_tex_pool_put(rr->gpu, &rr->output_tex);
+    rr->output_hash = rr->last_hash = 0;
+    rr->output_fbo = NULL;
+
+    pl_tex_pool_put(rr->gpu, &rr->scaled.tex);
+    rr->scaled.hash = rr->scaled.last_hash = 0;
+    rr->async_ready = 0;
+
     pl_shader_obj_destroy(&rr->peak_detect_state);
 }
 
+size_t pl_renderer_save(struct pl_renderer *rr, uint8_t *out)
+{
+    return pl_dispatch_save(rr->dp, out);
+}
+
+void pl_renderer_load(struct pl_renderer *rr, const uint8_t *cache, size_t size)
+{
+    pl_dispatch_load(rr->dp, cache, size);
+}
+
+// Helpers for hashing the parameters that affect the rendered result. These
+// hash every field explicitly, rather than the raw structs.
+static void hash_color_space(uint64_t *hash, const struct pl_color_space *csp)
+{
+    PL_HASH_VAL(hash, csp->primaries);
+    PL_HASH_VAL(hash, csp->transfer);
+    PL_HASH_VAL(hash, csp->light);
+    PL_HASH_VAL(hash, csp->sig_peak);
+    PL_HASH_VAL(hash, csp->sig_avg);
+    PL_HASH_VAL(hash, csp->sig_scale);
+}
+
+static void hash_color_repr(uint64_t *hash, const struct pl_color_repr *repr)
+{
+    PL_HASH_VAL(hash, repr->sys);
+    PL_HASH_VAL(hash, repr->levels);
+    PL_HASH_VAL(hash, repr->alpha);
+    PL_HASH_VAL(hash, repr->bits.sample_depth);
+    PL_HASH_VAL(hash, repr->bits.color_depth);
+    PL_HASH_VAL(hash, repr->bits.bit_shift);
+}
+
+static void hash_color_map_params(uint64_t *hash,
+                                  const struct pl_color_map_params *p)
+{
+    PL_HASH_VAL(hash, p->intent);
+    PL_HASH_VAL(hash, p->tone_mapping_algo);
+    PL_HASH_VAL(hash, p->tone_mapping_param);
+    PL_HASH_VAL(hash, p->desaturation_strength);
+    PL_HASH_VAL(hash, p->desaturation_exponent);
+    PL_HASH_VAL(hash, p->desaturation_base);
+    PL_HASH_VAL(hash, p->max_boost);
+    PL_HASH_VAL(hash, p->tone_mapping_lut_size);
+    PL_HASH_VAL(hash, p->gamut_warning);
+}
+
+static void hash_overlays(uint64_t *hash, const struct pl_overlay *ols, int num)
+{
+    PL_HASH_VAL(hash, num);
+    for (int i = 0; i < num; i++) {
+        const struct pl_overlay *ol = &ols[i];
+        // The texture contents can't be hashed, only its identity
+        uintptr_t tex = (uintptr_t) ol->plane.texture;
+        PL_HASH_VAL(hash, tex);
+        PL_HASH_VAL(hash, ol->plane.components);
+        PL_HASH_VAL(hash, ol->plane.component_mapping);
+        PL_HASH_VAL(hash, ol->plane.shift_x);
+        PL_HASH_VAL(hash, ol->plane.shift_y);
+        PL_HASH_VAL(hash, ol->rect);
+        PL_HASH_VAL(hash, ol->mode);
+        PL_HASH_VAL(hash, ol->base_color);
+        hash_color_repr(hash, &ol->repr);
+        hash_color_space(hash, &ol->color);
+        PL_HASH_VAL(hash, ol->num_parts);
+        for (int n = 0; n < ol->num_parts; n++)
+            PL_HASH_VAL(hash, ol->parts[n]); // plain floats, no padding
+    }
+}
+
+// Hashes the render params. If `scaled_only` is set, only the options that
+// can affect the output of `pass_scale_main` are included. Options not
+// affecting the result at all (e.g. `measure_timing`) are always skipped.
+static uint64_t render_params_hash(const struct pl_render_params *params,
+                                   bool scaled_only)
+{
+    uint64_t hash = 0x52454e44; // "REND"
+    pl_hash_merge(&hash, pl_filter_config_hash(params->upscaler));
+    pl_hash_merge(&hash, pl_filter_config_hash(params->downscaler));
+    pl_hash_merge(&hash, pl_filter_config_hash(params->plane_upscaler));
+    pl_hash_merge(&hash, pl_filter_config_hash(params->plane_downscaler));
+    pl_hash_merge(&hash, pl_filter_config_hash(params->frame_mixer));
+    PL_HASH_VAL(&hash, params->lut_entries);
+    PL_HASH_VAL(&hash, params->antiringing_strength);
+
+    const struct pl_deband_params *deband = params->deband_params;
+    PL_HASH_VAL(&hash, (bool) {!!deband});
+    if (deband) {
+        PL_HASH_VAL(&hash, deband->iterations);
+        PL_HASH_VAL(&hash, deband->threshold);
+        PL_HASH_VAL(&hash, deband->radius);
+        PL_HASH_VAL(&hash, deband->grain);
+        PL_HASH_VAL(&hash, deband->no_compute);
+    }
+
+    const struct pl_sigmoid_params *sigmoid = params->sigmoid_params;
+    PL_HASH_VAL(&hash, (bool) {!!sigmoid});
+    if (sigmoid) {
+        PL_HASH_VAL(&hash, sigmoid->center);
+        PL_HASH_VAL(&hash, sigmoid->slope);
+    }
+
+    const struct pl_color_adjustment *adj = params->color_adjustment;
+    PL_HASH_VAL(&hash, (bool) {!!adj});
+    if (adj) {
+        PL_HASH_VAL(&hash, adj->brightness);
+        PL_HASH_VAL(&hash, adj->contrast);
+        PL_HASH_VAL(&hash, adj->saturation);
+        PL_HASH_VAL(&hash, adj->hue);
+        PL_HASH_VAL(&hash, adj->gamma);
+    }
+
+    const struct pl_peak_detect_params *peak = params->peak_detect_params;
+    PL_HASH_VAL(&hash, (bool) {!!peak});
+    if (peak) {
+        PL_HASH_VAL(&hash, peak->smoothing_period);
+        PL_HASH_VAL(&hash, peak->scene_threshold_low);
+        PL_HASH_VAL(&hash, peak->scene_threshold_high);
+        PL_HASH_VAL(&hash, peak->overshoot_margin);
+        PL_HASH_VAL(&hash, peak->downsample);
+    }
+
+    PL_HASH_VAL(&hash, params->num_hooks);
+    for (int i = 0; i < params->num_hooks; i++) {
+        uintptr_t hook = (uintptr_t) params->hooks[i]; // opaque, by identity
+        PL_HASH_VAL(&hash, hook);
+    }
+
+    PL_HASH_VAL(&hash, params->skip_anti_aliasing);
+    PL_HASH_VAL(&hash, params->mipmap_downscaling);
+    PL_HASH_VAL(&hash, params->polar_cutoff);
+    PL_HASH_VAL(&hash, params->disable_overlay_sampling);
+    PL_HASH_VAL(&hash, params->allow_delayed_peak_detect);
+    PL_HASH_VAL(&hash, params->async_compile);
+    PL_HASH_VAL(&hash, params->reduced_precision);
+    PL_HASH_VAL(&hash, params->specialize_constants);
+    PL_HASH_VAL(&hash, params->prefer_compute);
+    PL_HASH_VAL(&hash, params->autotune_compute);
+    PL_HASH_VAL(&hash, params->disable_linear_scaling);
+    PL_HASH_VAL(&hash, params->disable_builtin_scalers);
+    PL_HASH_VAL(&hash, params->disable_tap_merging);
+    PL_HASH_VAL(&hash, params->disable_fbos);
+    if (scaled_only)
+        return hash;
+
+    // Everything below is only used by `pass_output_target`
+    const struct pl_color_map_params *cmap = params->color_map_params;
+    PL_HASH_VAL(&hash, (bool) {!!cmap});
+    if (cmap)
+        hash_color_map_params(&hash, cmap);
+
+    const struct pl_dither_params *dither = params->dither_params;
+    PL_HASH_VAL(&hash, (bool) {!!dither});
+    if (dither) {
+        PL_HASH_VAL(&hash, dither->method);
+        PL_HASH_VAL(&hash, dither->lut_size);
+        PL_HASH_VAL(&hash, dither->temporal);
+    }
+
+    const struct pl_3dlut_params *lut3d = params->lut3d_params;
+    PL_HASH_VAL(&hash, (bool) {!!lut3d});
+    if (lut3d) {
+        PL_HASH_VAL(&hash, lut3d->intent);
+        PL_HASH_VAL(&hash, lut3d->size_r);
+        PL_HASH_VAL(&hash, lut3d->size_g);
+        PL_HASH_VAL(&hash, lut3d->size_b);
+        PL_HASH_VAL(&hash, lut3d->tetrahedral);
+    }
+
+    const struct pl_cone_params *cone = params->cone_params;
+    PL_HASH_VAL(&hash, (bool) {!!cone});
+    if (cone) {
+        PL_HASH_VAL(&hash, cone->cones);
+        PL_HASH_VAL(&hash, cone->strength);
+    }
+
+    PL_HASH_VAL(&hash, params->color_lut_size);
+    PL_HASH_VAL(&hash, params->force_3dlut);
+    PL_HASH_VAL(&hash, params->force_dither);
+    return hash;
+}
+
+static const char *stage_names[PL_RENDER_STAGE_COUNT] = {
+    [PL_RENDER_STAGE_READ_IMAGE]    = "read image",
+    [PL_RENDER_STAGE_DEBAND]        = "deband",
+    [PL_RENDER_STAGE_SCALE_MAIN]    = "scale main",
+    [PL_RENDER_STAGE_OUTPUT_TARGET] = "output target",
+    [PL_RENDER_STAGE_OVERLAYS]      = "overlays",
+    [PL_RENDER_STAGE_FRAME_MIX]     = "frame mix",
+};
+
+// Collects all timer results which have become available since the last call
+static void update_stats(struct pl_renderer *rr)
+{
+    for (int i = 0; i < PL_ARRAY_SIZE(rr->stages); i++) {
+        struct stage_stats *st = &rr->stages[i];
+        for (int n = 0; n < st->num_timers; n++) {
+            uint64_t ns;
+            while ((ns = pl_timer_query(rr->gpu, st->timers[n]))) {
+                st->samples[st->count++ % STATS_WINDOW] = ns;
+                pl_trace_gpu(rr->ctx, "renderer", stage_names[i], ns);
+            }
+        }
+    }
+}
+
+// Starts handing out the per-stage timers from the beginning again. Called
+// once per frame, i.e. by the public rendering entry points
+static void reset_timers(struct pl_renderer *rr)
+{
+    for (int i = 0; i < PL_ARRAY_SIZE(rr->stages); i++)
+        rr->stages[i].timers_used = 0;
+}
+
+// Returns the timer to use for a pass belonging to a given stage, or NULL
+static struct pl_timer *stage_timer(struct pl_renderer *rr,
+                                    enum pl_render_stage stage,
+                                    const struct pl_render_params *params)
+{
+    if (!params->measure_timing || rr->probing)
+        return NULL;
+
+    struct stage_stats *st = &rr->stages[stage];
+    if (st->timers_used == st->num_timers) {
+        if (st->num_timers == MAX_STAGE_TIMERS)
+            return NULL;
+        struct pl_timer *timer = pl_timer_create(rr->gpu);
+        if (!timer)
+            return NULL;
+        TARRAY_APPEND(rr, st->timers, st->num_timers, timer);
+    }
+
+    return st->timers[st->timers_used++];
+}
+
+static struct pl_dispatch_stats dispatch_stats_diff(struct pl_dispatch_stats a,
+                                                    struct pl_dispatch_stats b)
+{
+    return (struct pl_dispatch_stats) {
+        .dispatches      = a.dispatches - b.dispatches,
+        .cache_hits      = a.cache_hits - b.cache_hits,
+        .cache_misses    = a.cache_misses - b.cache_misses,
+        .programs_reused = a.programs_reused - b.programs_reused,
+        .ubo_updates     = a.ubo_updates - b.ubo_updates,
+        .skipped         = a.skipped - b.skipped,
+    };
+}
+
+static struct pl_gpu_stats gpu_stats_diff(struct pl_gpu_stats a,
+                                          struct pl_gpu_stats b)
+{
+    return (struct pl_gpu_stats) {
+        .passes_created   = a.passes_created - b.passes_created,
+        .compile_ns       = a.compile_ns - b.compile_ns,
+        .passes_run       = a.passes_run - b.passes_run,
+        .desc_bindings    = a.desc_bindings - b.desc_bindings,
+        .var_updates      = a.var_updates - b.var_updates,
+        .textures_created = a.textures_created - b.textures_created,
+        .bytes_uploaded   = a.bytes_uploaded - b.bytes_uploaded,
+        .bytes_downloaded = a.bytes_downloaded - b.bytes_downloaded,
+        .flushes          = a.flushes - b.flushes,
+        .submits          = a.submits - b.submits,
+    };
+}
+
+void pl_renderer_get_stats(struct pl_renderer *rr, struct pl_render_stats *out)
+{
+    update_stats(rr);
+
+    struct pl_dispatch_stats dp_stats;
+    struct pl_gpu_stats gpu_stats;
+    pl_dispatch_stats(rr->dp, &dp_stats);
+    pl_gpu_stats(rr->gpu, &gpu_stats);
+    out->frames = rr->frames_rendered;
+    out->fbos_allocated = rr->fbos_allocated;
+    out->dispatch = dispatch_stats_diff(dp_stats, rr->dp_base);
+    out->gpu = gpu_stats_diff(gpu_stats, rr->gpu_base);
+    out->last_frame = rr->last_frame;
+
+    for (int i = 0; i < PL_ARRAY_SIZE(rr->stages); i++) {
+        const struct stage_stats *st = &rr->stages[i];
+        struct pl_render_stage_stats *res = &out->stages[i];
+        *res = (struct pl_render_stage_stats) {
+            .name = stage_names[i],
+            .count = st->count,
+        };
+
+        if (!st->count)
+            continue;
+
+        int num = PL_MIN(st->count, STATS_WINDOW);
+        uint64_t sum = 0;
+        for (int n = 0; n < num; n++) {
+            sum += st->samples[n];
+            res->peak = PL_MAX(res->peak, st->samples[n]);
+        }
+
+        res->average = sum / num;
+        res->last = st->samples[(st->count - 1) % STATS_WINDOW];
+    }
+}
+
+void pl_renderer_reset_stats(struct pl_renderer *rr)
+{
+    // Drain any results still in flight, so they don't end up being counted
+    update_stats(rr);
+
+    for (int i = 0; i < PL_ARRAY_SIZE(rr->stages); i++) {
+        struct stage_stats *st = &rr->stages[i];
+        memset(st->samples, 0, sizeof(st->samples));
+        st->count = 0;
+    }
+
+    rr->frames_rendered = rr->fbos_allocated = 0;
+    rr->last_frame = (struct pl_dispatch_stats) {0};
+    pl_dispatch_stats(rr->dp, &rr->dp_base);
+    pl_gpu_stats(rr->gpu, &rr->gpu_base);
+}
+
+// Wrapper around `pl_tex_pool_recreate` which counts (re)allocations
+static bool recreate_fbo(struct pl_renderer *rr, const struct pl_tex **tex,
+                         const struct pl_tex_params *params)
+{
+    const struct pl_tex *old = *tex;
+    bool ok = pl_tex_pool_recreate(rr->gpu, tex, params);
+    if (ok && *tex != old)
+        rr->fbos_allocated++;
+    return ok;
+}
+
 const struct pl_render_params pl_render_default_params = {
     .upscaler           = &pl_filter_spline36,
     .downscaler         = &pl_filter_mitchell,
+    .plane_upscaler     = &pl_filter_bicubic,
     .frame_mixer        = NULL,
 
     .sigmoid_params     = &pl_sigmoid_default_params,
@@ -246,15 +687,42 @@ struct pass_state {
     // Integer version of `target.dst_rect`. Semantically identical.
     struct pl_rect2d dst_rect;
 
+    // The `image.src_rect` as inferred by `fix_rects`, but before being
+    // cropped to the target. Used to re-derive the rects for further targets.
+    struct pl_rect2df src_rect;
+
     // Cached copies of the `image` / `target` for this rendering pass,
     // corrected to make sure all rects etc. are properly defaulted/inferred.
     struct pl_image image;
     struct pl_render_target target;
 
     // Metadata for `rr->fbos`
-    bool *fbos_used;
+    enum fbo_state {
+        FBO_FREE = 0,   // not (yet) used during this pass
+        FBO_USED,       // currently holding an intermediate image
+        FBO_RELEASED,   // used earlier during this pass, but no longer needed
+    } *fbos_used;
+
+    // Whether FBOs may be released (and reused) once their contents have been
+    // consumed. This is disabled when hooks are active, since those are free
+    // to hold on to any intermediate texture they're given.
+    bool alias_fbos;
+
+    // Whether peak detection ran as a separate prepass, so its result is
+    // already available to the rest of this pass
+    bool peak_prepass;
+
+    // The stage currently being rendered, and the corresponding parameters
+    // (for timing purposes)
+    enum pl_render_stage stage;
+    const struct pl_render_params *params;
 };
 
+static inline struct pl_timer *pass_timer(struct pass_state *pass)
+{
+    return stage_timer(pass->rr, pass->stage, pass->params);
+}
+
 static const struct pl_tex *get_fbo(struct pass_state *pass, int w, int h)
 {
     struct pl_renderer *rr = pass->rr;
@@ -272,6 +740,7 @@ static const struct pl_tex *get_fbo(struct pass_state *pass, int w, int h)
         .sample_mode = (rr->fbofmt->caps & PL_FMT_CAP_LINEAR)
                             ? PL_TEX_SAMPLE_LINEAR
                             : PL_TEX_SAMPLE_NEAREST,
+        .transient  = true,
     };
 
     int best_idx = -1;
@@ -279,8 +748,16 @@ static const struct pl_tex *get_fbo(struct pass_state *pass, int w, int h)
 
     // Find the best-fitting texture out of rr->fbos
     for (int i = 0; i < rr->num_fbos; i++) {
-        if (pass->fbos_used[i])
+        if (pass->fbos_used[i] == FBO_USED)
+            continue;
+
+        // Only alias previously released FBOs of exactly the right size, to
+        // avoid recreating the same texture several times per frame
+        if (pass->fbos_used[i] == FBO_RELEASED &&
+            (rr->fbos[i]->params.w != w || rr->fbos[i]->params.h != h))
+        {
             continue;
+        }
 
         // Orthogonal distance
         int diff = abs(rr->fbos[i]->params.w - w) +
@@ -297,16 +774,45 @@ static const struct pl_tex *get_fbo(struct pass_state *pass, int w, int h)
         best_idx = rr->num_fbos;
         TARRAY_APPEND(rr, rr->fbos, rr->num_fbos, NULL);
         TARRAY_GROW(pass->tmp, pass->fbos_used, best_idx);
-        pass->fbos_used[best_idx] = false;
+        pass->fbos_used[best_idx] = FBO_FREE;
     }
 
-    if (!pl_tex_recreate(rr->gpu, &rr->fbos[best_idx], &params))
+    // Exchange mismatched FBOs with the GPU's texture pool, so that changes in
+    // resolution don't constantly destroy and recreate textures
+    if (!recreate_fbo(rr, &rr->fbos[best_idx], &params))
         return NULL;
 
-    pass->fbos_used[best_idx] = true;
+    pass->fbos_used[best_idx] = FBO_USED;
     return rr->fbos[best_idx];
 }
 
+// Collects the indices of all FBOs sampled by `sh`. Since these FBOs can only
+// ever be consumed by a single shader, they may be released for reuse once
+// `sh` has been dispatched.
+static int consumed_fbos(struct pass_state *pass, const struct pl_shader *sh,
+                         int **out)
+{
+    struct pl_renderer *rr = pass->rr;
+    if (!pass->alias_fbos)
+        return 0;
+
+    int num = 0;
+    for (int i = 0; i < sh->res.num_descriptors; i++) {
+        const struct pl_shader_desc *sd = &sh->descriptors[i];
+        if (sd->desc.type != PL_DESC_SAMPLED_TEX)
+            continue;
+
+        for (int n = 0; n < rr->num_fbos; n++) {
+            if (sd->object == rr->fbos[n] && pass->fbos_used[n] == FBO_USED) {
+                TARRAY_APPEND(pass->tmp, *out, num, n);
+                break;
+            }
+        }
+    }
+
+    return num;
+}
+
 // Forcibly convert an img to `tex`, dispatching where necessary
 static const struct pl_tex *img_tex(struct pass_state *pass, struct img *img)
 {
@@ -325,9 +831,13 @@ static const struct pl_tex *img_tex(struct pass_state *pass, struct img *img)
     }
 
     pl_assert(img->sh);
+    int *consumed = NULL;
+    int num_consumed = consumed_fbos(pass, img->sh, &consumed);
+
     bool ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
         .shader = &img->sh,
         .target = tex,
+        .timer  = pass_timer(pass),
     });
 
     if (!ok) {
@@ -336,6 +846,9 @@ static const struct pl_tex *img_tex(struct pass_state *pass, struct img *img)
         return NULL;
     }
 
+    for (int i = 0; i < num_consumed; i++)
+        pass->fbos_used[consumed[i]] = FBO_RELEASED;
+
     img->tex = tex;
     return img->tex;
 }
@@ -370,6 +883,11 @@ enum sampler_dir {
     SAMPLER_DOWN, // downscaling
 };
 
+enum sampler_usage {
+    SAMPLER_MAIN,  // scaling the image (or overlays) to the target
+    SAMPLER_PLANE, // scaling the planes to the reference plane
+};
+
 struct sampler_info {
     const struct pl_filter_config *config; // if applicable
     enum sampler_type type;
@@ -378,18 +896,25 @@ struct sampler_info {
 
 static struct sampler_info sample_src_info(struct pl_renderer *rr,
                                            const struct pl_sample_src *src,
+                                           enum sampler_usage usage,
                                            const struct pl_render_params *params)
 {
     struct sampler_info info;
+    const struct pl_filter_config *upscaler = params->upscaler;
+    const struct pl_filter_config *downscaler = params->downscaler;
+    if (usage == SAMPLER_PLANE) {
+        upscaler = PL_DEF(params->plane_upscaler, upscaler);
+        downscaler = PL_DEF(params->plane_downscaler, downscaler);
+    }
 
     float rx = src->new_w / fabs(pl_rect_w(src->rect));
     float ry = src->new_h / fabs(pl_rect_h(src->rect));
     if (rx < 1.0 - 1e-6 || ry < 1.0 - 1e-6) {
         info.dir = SAMPLER_DOWN;
-        info.config = params->downscaler;
+        info.config = downscaler;
     } else if (rx > 1.0 + 1e-6 || ry > 1.0 + 1e-6) {
         info.dir = SAMPLER_UP;
-        info.config = params->upscaler;
+        info.config = upscaler;
     } else {
         info.dir = SAMPLER_NOOP;
         info.type = SAMPLER_DIRECT;
@@ -411,7 +936,7 @@ static struct sampler_info sample_src_info(struct pl_renderer *rr,
         }
 
         bool is_linear = sample_mode == PL_TEX_SAMPLE_LINEAR;
-        bool can_fast = info.config == params->upscaler ||
+        bool can_fast = info.config == upscaler ||
                         params->skip_anti_aliasing;
 
         if (can_fast && !params->disable_builtin_scalers) {
@@ -427,8 +952,32 @@ static struct sampler_info sample_src_info(struct pl_renderer *rr,
     return info;
 }
 
+// Returns the number of pixels beyond the edges of `src->rect` that the
+// sampler described by `info` reads from, rounded up
+static int sampler_apron(const struct sampler_info *info,
+                         const struct pl_sample_src *src,
+                         const struct pl_render_params *params)
+{
+    switch (info->type) {
+    case SAMPLER_DIRECT: return 1;
+    case SAMPLER_BICUBIC: return 2;
+    case SAMPLER_COMPLEX: break;
+    }
+
+    const struct pl_filter_config *cfg = info->config;
+    float radius = cfg->kernel->radius * PL_DEF(cfg->blur, 1.0);
+    if (info->dir == SAMPLER_DOWN && !params->skip_anti_aliasing) {
+        // The filter gets widened to cover the source pixels instead
+        float rx = fabs(pl_rect_w(src->rect)) / src->new_w,
+              ry = fabs(pl_rect_h(src->rect)) / src->new_h;
+        radius *= PL_MAX(rx, ry);
+    }
+
+    return ceilf(radius) + 1;
+}
+
 static void dispatch_sampler(struct pass_state *pass, struct pl_shader *sh,
-                             struct sampler *sampler,
+                             struct sampler *sampler, enum sampler_usage usage,
                              const struct pl_render_params *params,
                              const struct pl_sample_src *src)
 {
@@ -436,7 +985,7 @@ static void dispatch_sampler(struct pass_state *pass, struct pl_shader *sh,
         goto fallback;
 
     struct pl_renderer *rr = pass->rr;
-    struct sampler_info info = sample_src_info(rr, src, params);
+    struct sampler_info info = sample_src_info(rr, src, usage, params);
     struct pl_shader_obj **lut = NULL;
     const struct pl_tex **sep_fbo = NULL;
     switch (info.dir) {
@@ -470,12 +1019,15 @@ static void dispatch_sampler(struct pass_state *pass, struct pl_shader *sh,
         .antiring    = params->antiringing_strength,
         .no_compute  = rr->disable_compute,
         .no_widening = params->skip_anti_aliasing,
+        .no_merging  = params->disable_tap_merging,
         .lut         = lut,
     };
 
     bool ok;
     if (info.config->polar) {
         ok = pl_shader_sample_polar(sh, src, &fparams);
+    } else if (pl_shader_sample_ortho_fused(sh, src, &fparams)) {
+        ok = true;
     } else {
         struct pl_shader *tsh = pl_dispatch_begin_ex(rr->dp, true);
         ok = pl_shader_sample_ortho(tsh, PL_SEP_VERT, src, &fparams);
@@ -510,6 +1062,229 @@ fallback:
     pl_shader_sample_direct(sh, src);
 }
 
+static const struct pl_blend_params overlay_blend = {
+    .src_rgb = PL_BLEND_SRC_ALPHA,
+    .dst_rgb = PL_BLEND_ONE_MINUS_SRC_ALPHA,
+    .src_alpha = PL_BLEND_ONE,
+    .dst_alpha = PL_BLEND_ONE_MINUS_SRC_ALPHA,
+};
+
+// Converts the sampled overlay texture (in `color`) to the target colorspace
+static void overlay_color(struct pl_shader *sh, const struct pl_overlay *ol,
+                          int components, ident_t part_color,
+                          struct pl_color_space color, bool use_sigmoid,
+                          const struct pl_render_params *params)
+{
+    const struct pl_plane *plane = &ol->plane;
+    const struct pl_tex *tex = plane->texture;
+
+    GLSL("vec4 osd_color;\n");
+    for (int c = 0; c < components; c++) {
+        if (plane->component_mapping[c] < 0)
+            continue;
+        GLSL("osd_color[%d] = color[%d];\n", plane->component_mapping[c],
+             tex->params.format->sample_order[c]);
+    }
+
+    switch (ol->mode) {
+    case PL_OVERLAY_NORMAL:
+        GLSL("color = osd_color;\n");
+        break;
+    case PL_OVERLAY_MONOCHROME:
+        if (part_color) {
+            GLSL("color = vec4(%s.rgb, %s.a * osd_color[0]);\n",
+                 part_color, part_color);
+        } else {
+            GLSL("color.a = osd_color[0];\n");
+            GLSL("color.rgb = %s;\n", sh_var(sh, (struct pl_shader_var) {
+                .var  = pl_var_vec3("base_color"),
+                .data = &ol->base_color,
+                .dynamic = true,
+            }));
+        }
+        break;
+    default: abort();
+    }
+
+    struct pl_color_repr repr = ol->repr;
+    pl_shader_decode_color(sh, &repr, NULL);
+    pl_shader_color_map(sh, params->color_map_params, ol->color, color,
+                        NULL, false);
+
+    if (use_sigmoid)
+        pl_shader_sigmoidize(sh, params->sigmoid_params);
+}
+
+// Draws a single overlay (or overlay part) as its own pass. `src_rc` is in
+// texel coordinates of the overlay texture, and `color` (if set) overrides
+// the monochrome base color and opacity
+static bool draw_overlay_rect(struct pass_state *pass, const struct pl_tex *fbo,
+                              const struct pl_overlay *ol,
+                              struct pl_rect2df src_rc, struct pl_rect2d rect,
+                              const float *part_color, struct sampler *sampler,
+                              struct pl_color_space color, bool use_sigmoid,
+                              const struct pl_render_params *params)
+{
+    struct pl_renderer *rr = pass->rr;
+    const struct pl_plane *plane = &ol->plane;
+
+    struct pl_sample_src src = {
+        .tex        = plane->texture,
+        .components = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components,
+        .new_w      = abs(pl_rect_w(rect)),
+        .new_h      = abs(pl_rect_h(rect)),
+        .rect       = src_rc,
+    };
+
+    if (params->disable_overlay_sampling)
+        sampler = NULL;
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    dispatch_sampler(pass, sh, sampler, SAMPLER_MAIN, params, &src);
+
+    ident_t part = NULL;
+    if (part_color && ol->mode == PL_OVERLAY_MONOCHROME) {
+        part = sh_var(sh, (struct pl_shader_var) {
+            .var  = pl_var_vec4("part_color"),
+            .data = part_color,
+            .dynamic = true,
+        });
+    }
+
+    overlay_color(sh, ol, src.components, part, color, use_sigmoid, params);
+    return pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+        .rect   = rect,
+        .blend_params = rr->disable_blending ? NULL : &overlay_blend,
+        .timer  = stage_timer(rr, PL_RENDER_STAGE_OVERLAYS, params),
+    });
+}
+
+static struct pl_rect2df transform_rect(const struct pl_transform2x2 *scale,
+                                        struct pl_rect2df rc)
+{
+    if (scale) {
+        float v0[2] = { rc.x0, rc.y0 };
+        float v1[2] = { rc.x1, rc.y1 };
+        pl_transform2x2_apply(scale, v0);
+        pl_transform2x2_apply(scale, v1);
+        rc = (struct pl_rect2df) { v0[0], v0[1], v1[0], v1[1] };
+    }
+
+    return rc;
+}
+
+struct osd_vertex {
+    float pos[2];
+    float coord[2];
+    float color[4];
+};
+
+// Draws all parts of an overlay atlas using a single pass. Returns false if
+// this is not possible, in which case the caller should fall back to drawing
+// each part individually
+static bool draw_overlay_parts(struct pass_state *pass, const struct pl_tex *fbo,
+                               const struct pl_overlay *ol,
+                               struct pl_color_space color, bool use_sigmoid,
+                               const struct pl_transform2x2 *scale,
+                               const struct pl_render_params *params)
+{
+    struct pl_renderer *rr = pass->rr;
+    const struct pl_gpu *gpu = rr->gpu;
+    const struct pl_plane *plane = &ol->plane;
+    const struct pl_tex *tex = plane->texture;
+
+    const struct pl_fmt *vec2 = pl_find_vertex_fmt(gpu, PL_FMT_FLOAT, 2);
+    const struct pl_fmt *vec4 = pl_find_vertex_fmt(gpu, PL_FMT_FLOAT, 4);
+    if (!fbo->params.renderable || !vec2 || !vec4)
+        return false;
+
+    float sx = 1.0, sy = 1.0;
+    if (tex->sampler_type != PL_SAMPLER_RECT) {
+        sx = 1.0 / tex->params.w;
+        sy = 1.0 / tex->params.h;
+    }
+
+    // Generate two triangles per part
+    struct osd_vertex *verts = talloc_array(pass->tmp, struct osd_vertex,
+                                            6 * ol->num_parts);
+    for (int n = 0; n < ol->num_parts; n++) {
+        const struct pl_overlay_part *part = &ol->parts[n];
+        struct pl_rect2df dst = transform_rect(scale, part->dst);
+        struct pl_rect2df src = {
+            .x0 = sx * (part->src.x0 - plane->shift_x),
+            .y0 = sy * (part->src.y0 - plane->shift_y),
+            .x1 = sx * (part->src.x1 - plane->shift_x),
+            .y1 = sy * (part->src.y1 - plane->shift_y),
+        };
+
+        struct osd_vertex corners[4] = {
+            { .pos = { dst.x0, dst.y0 }, .coord = { src.x0, src.y0 } },
+            { .pos = { dst.x1, dst.y0 }, .coord = { src.x1, src.y0 } },
+            { .pos = { dst.x0, dst.y1 }, .coord = { src.x0, src.y1 } },
+            { .pos = { dst.x1, dst.y1 }, .coord = { src.x1, src.y1 } },
+        };
+
+        for (int i = 0; i < 4; i++)
+            memcpy(corners[i].color, part->color, sizeof(corners[i].color));
+
+        static const int idx[6] = { 0, 1, 2, 2, 1, 3 };
+        for (int i = 0; i < 6; i++)
+            verts[6 * n + i] = corners[idx[i]];
+    }
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    if (!sh_require(sh, PL_SHADER_SIG_NONE, 0, 0)) {
+        pl_dispatch_abort(rr->dp, &sh);
+        return false;
+    }
+
+    ident_t id = sh_desc(sh, (struct pl_shader_desc) {
+        .desc = {
+            .name = "osd_tex",
+            .type = PL_DESC_SAMPLED_TEX,
+        },
+        .object = tex,
+    });
+
+    GLSL("// draw_overlay_parts                            \n"
+         "vec4 color = %s(%s, osd_coord);                  \n",
+         sh_tex_fn(sh, tex->params), id);
+
+    int comps = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components;
+    overlay_color(sh, ol, comps, "osd_part_color", color, use_sigmoid, params);
+
+    return pl_dispatch_vertex(rr->dp, &(struct pl_dispatch_vertex_params) {
+        .shader = &sh,
+        .target = fbo,
+        .blend_params = rr->disable_blending ? NULL : &overlay_blend,
+        .vertex_attribs = (struct pl_vertex_attrib[]) {
+            {
+                .name = "osd_pos",
+                .fmt = vec2,
+                .offset = offsetof(struct osd_vertex, pos),
+            }, {
+                .name = "osd_coord",
+                .fmt = vec2,
+                .offset = offsetof(struct osd_vertex, coord),
+            }, {
+                .name = "osd_part_color",
+                .fmt = vec4,
+                .offset = offsetof(struct osd_vertex, color),
+            },
+        },
+        .num_vertex_attribs = 3,
+        .vertex_stride = sizeof(struct osd_vertex),
+        .vertex_position_idx = 0,
+        .vertex_coords = PL_COORDS_ABSOLUTE,
+        .vertex_type = PL_PRIM_TRIANGLE_LIST,
+        .vertex_count = 6 * ol->num_parts,
+        .vertex_data = verts,
+        .timer = stage_timer(rr, PL_RENDER_STAGE_OVERLAYS, params),
+    });
+}
+
 static void draw_overlays(struct pass_state *pass, const struct pl_tex *fbo,
                           const struct pl_overlay *overlays, int num,
                           struct pl_color_space color, bool use_sigmoid,
@@ -536,85 +1311,54 @@ static void draw_overlays(struct pass_state *pass, const struct pl_tex *fbo,
         const struct pl_overlay *ol = &overlays[n];
         const struct pl_plane *plane = &ol->plane;
         const struct pl_tex *tex = plane->texture;
+        bool ok = true;
+
+        if (ol->num_parts) {
+            if (!draw_overlay_parts(pass, fbo, ol, color, use_sigmoid, scale,
+                                    params))
+            {
+                // Fall back to drawing every part with a separate pass
+                for (int i = 0; ok && i < ol->num_parts; i++) {
+                    const struct pl_overlay_part *part = &ol->parts[i];
+                    struct pl_rect2df dst = transform_rect(scale, part->dst);
+                    struct pl_rect2df src = {
+                        part->src.x0 - plane->shift_x,
+                        part->src.y0 - plane->shift_y,
+                        part->src.x1 - plane->shift_x,
+                        part->src.y1 - plane->shift_y,
+                    };
+
+                    struct pl_rect2d rect = {
+                        roundf(dst.x0), roundf(dst.y0),
+                        roundf(dst.x1), roundf(dst.y1),
+                    };
+
+                    if (!pl_rect_w(rect) || !pl_rect_h(rect))
+                        continue;
+
+                    ok = draw_overlay_rect(pass, fbo, ol, src, rect,
+                                           part->color, NULL, color,
+                                           use_sigmoid, params);
+                }
+            }
+        } else {
+            struct pl_rect2df dst = transform_rect(scale, (struct pl_rect2df) {
+                ol->rect.x0, ol->rect.y0, ol->rect.x1, ol->rect.y1,
+            });
 
-        struct pl_rect2d rect = ol->rect;
-        if (scale) {
-            float v0[2] = { rect.x0, rect.y0 };
-            float v1[2] = { rect.x1, rect.y1 };
-            pl_transform2x2_apply(scale, v0);
-            pl_transform2x2_apply(scale, v1);
-            rect = (struct pl_rect2d) { v0[0], v0[1], v1[0], v1[1] };
-        }
-
-        struct pl_sample_src src = {
-            .tex        = tex,
-            .components = ol->mode == PL_OVERLAY_MONOCHROME ? 1 : plane->components,
-            .new_w      = abs(pl_rect_w(rect)),
-            .new_h      = abs(pl_rect_h(rect)),
-            .rect = {
+            struct pl_rect2d rect = { dst.x0, dst.y0, dst.x1, dst.y1 };
+            struct pl_rect2df src = {
                 -plane->shift_x,
                 -plane->shift_y,
                 tex->params.w - plane->shift_x,
                 tex->params.h - plane->shift_y,
-            },
-        };
-
-        struct sampler *sampler = &rr->osd_samplers[n];
-        if (params->disable_overlay_sampling)
-            sampler = NULL;
-
-        struct pl_shader *sh = pl_dispatch_begin(rr->dp);
-        dispatch_sampler(pass, sh, sampler, params, &src);
-
-        GLSL("vec4 osd_color;\n");
-        for (int c = 0; c < src.components; c++) {
-            if (plane->component_mapping[c] < 0)
-                continue;
-            GLSL("osd_color[%d] = color[%d];\n", plane->component_mapping[c],
-                 tex->params.format->sample_order[c]);
-        }
+            };
 
-        switch (ol->mode) {
-        case PL_OVERLAY_NORMAL:
-            GLSL("color = osd_color;\n");
-            break;
-        case PL_OVERLAY_MONOCHROME:
-            GLSL("color.a = osd_color[0];\n");
-            GLSL("color.rgb = %s;\n", sh_var(sh, (struct pl_shader_var) {
-                .var  = pl_var_vec3("base_color"),
-                .data = &ol->base_color,
-                .dynamic = true,
-            }));
-            break;
-        default: abort();
+            ok = draw_overlay_rect(pass, fbo, ol, src, rect, NULL,
+                                   &rr->osd_samplers[n], color, use_sigmoid,
+                                   params);
         }
 
-        struct pl_color_repr repr = ol->repr;
-        pl_shader_decode_color(sh, &repr, NULL);
-        pl_shader_color_map(sh, params->color_map_params, ol->color, color,
-                            NULL, false);
-
-        if (use_sigmoid)
-            pl_shader_sigmoidize(sh, params->sigmoid_params);
-
-        static const struct pl_blend_params blend_params = {
-            .src_rgb = PL_BLEND_SRC_ALPHA,
-            .dst_rgb = PL_BLEND_ONE_MINUS_SRC_ALPHA,
-            .src_alpha = PL_BLEND_ONE,
-            .dst_alpha = PL_BLEND_ONE_MINUS_SRC_ALPHA,
-        };
-
-        const struct pl_blend_params *blend = &blend_params;
-        if (rr->disable_blending)
-            blend = NULL;
-
-        bool ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
-            .shader = &sh,
-            .target = fbo,
-            .rect   = rect,
-            .blend_params = blend,
-        });
-
         if (!ok) {
             PL_ERR(rr, "Failed rendering overlay texture!");
             rr->disable_overlay = true;
@@ -630,15 +1374,29 @@ static const struct pl_tex *get_hook_tex(void *priv, int width, int height)
     return get_fbo(pass, width, height);
 }
 
-// Returns if any hook was applied (even if there were errors)
-static bool pass_hook(struct pass_state *pass, struct img *img,
-                      enum pl_hook_stage stage,
-                      const struct pl_render_params *params)
+static void release_hook_tex(void *priv, const struct pl_tex *tex)
+{
+    struct pass_state *pass = priv;
+    struct pl_renderer *rr = pass->rr;
+
+    for (int i = 0; i < rr->num_fbos; i++) {
+        if (rr->fbos[i] == tex && pass->fbos_used[i] == FBO_USED) {
+            pass->fbos_used[i] = FBO_RELEASED;
+            return;
+        }
+    }
+}
+
+// Returns if any hook was applied (even if there were errors)
+static bool pass_hook(struct pass_state *pass, struct img *img,
+                      enum pl_hook_stage stage,
+                      const struct pl_render_params *params)
 {
     struct pl_renderer *rr = pass->rr;
     if (!rr->fbofmt || rr->disable_hooks)
         return false;
 
+    pl_assert(!rr->probing || !params->num_hooks); // see `use_async`
     bool ret = false;
 
     for (int n = 0; n < params->num_hooks; n++) {
@@ -651,6 +1409,7 @@ static bool pass_hook(struct pass_state *pass, struct img *img,
             .gpu = rr->gpu,
             .dispatch = rr->dp,
             .get_tex = get_hook_tex,
+            .release_tex = release_hook_tex,
             .priv = pass,
             .stage = stage,
             .rect = img->rect,
@@ -783,19 +1542,22 @@ static int deband_src(struct pass_state *pass, struct pl_shader *psh,
     }
 
     // The debanding shader can replace direct GPU sampling
-    bool deband_scales = sample_src_info(rr, psrc, params).type == SAMPLER_DIRECT;
+    struct sampler_info info = sample_src_info(rr, psrc, SAMPLER_PLANE, params);
+    bool deband_scales = info.type == SAMPLER_DIRECT;
 
     struct pl_shader *sh = psh;
     struct pl_sample_src *src = psrc;
     struct pl_sample_src fixed;
     if (!deband_scales) {
-        // Only sample/deband the relevant cut-out, but round it to the nearest
-        // integer to avoid doing fractional scaling
+        // Only sample/deband the relevant cut-out (plus whatever the scaler
+        // reads beyond its edges), but round it to the nearest integer to
+        // avoid doing fractional scaling
+        int apron = sampler_apron(&info, src, params);
         fixed = *src;
-        fixed.rect.x0 = floorf(fixed.rect.x0);
-        fixed.rect.y0 = floorf(fixed.rect.y0);
-        fixed.rect.x1 = ceilf(fixed.rect.x1);
-        fixed.rect.y1 = ceilf(fixed.rect.y1);
+        fixed.rect.x0 = PL_MAX(floorf(fixed.rect.x0) - apron, 0);
+        fixed.rect.y0 = PL_MAX(floorf(fixed.rect.y0) - apron, 0);
+        fixed.rect.x1 = PL_MIN(ceilf(fixed.rect.x1) + apron, src->tex->params.w);
+        fixed.rect.y1 = PL_MIN(ceilf(fixed.rect.y1) + apron, src->tex->params.h);
         fixed.new_w = pl_rect_w(fixed.rect);
         fixed.new_h = pl_rect_h(fixed.rect);
         src = &fixed;
@@ -820,6 +1582,7 @@ static int deband_src(struct pass_state *pass, struct pl_shader *psh,
     float scale = pl_color_transfer_nominal_peak(image->color.transfer)
                 * image->color.sig_scale;
     dparams.grain /= scale;
+    dparams.no_compute = rr->disable_compute;
 
     pl_shader_deband(sh, src, &dparams);
 
@@ -832,7 +1595,10 @@ static int deband_src(struct pass_state *pass, struct pl_shader *psh,
         .h  = src->new_h,
     };
 
+    enum pl_render_stage prev_stage = pass->stage;
+    pass->stage = PL_RENDER_STAGE_DEBAND;
     const struct pl_tex *new = img_tex(pass, &img);
+    pass->stage = prev_stage;
     if (!new) {
         PL_ERR(rr, "Failed dispatching debanding shader.. disabling debanding!");
         rr->disable_debanding = true;
@@ -849,6 +1615,58 @@ static int deband_src(struct pass_state *pass, struct pl_shader *psh,
     return DEBAND_NORMAL;
 }
 
+// Run peak detection as a separate compute prepass, optionally on a
+// downscaled copy of the image. The prepass only writes to the peak detection
+// buffer, so it needs no output texture, and the result is available to the
+// color mapping pass of the same frame.
+static bool hdr_detect_prepass(struct pass_state *pass,
+                               const struct pl_peak_detect_params *params,
+                               int downsample)
+{
+    struct pl_renderer *rr = pass->rr;
+    const struct pl_tex *tex = img_tex(pass, &pass->img);
+    if (!tex)
+        return false;
+
+    // Only consider the sampled region, not the apron around it
+    const struct pl_rect2df *rc = &pass->img.rect;
+    int w = PL_MAX(1, roundf(fabs(pl_rect_w(*rc))) / downsample),
+        h = PL_MAX(1, roundf(fabs(pl_rect_h(*rc))) / downsample);
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    bool ok = pl_shader_sample_direct(sh, &(struct pl_sample_src) {
+        .tex    = tex,
+        .rect   = *rc,
+        .new_w  = w,
+        .new_h  = h,
+    });
+
+    ok = ok && pl_shader_detect_peak(sh, pass->img.color,
+                                     &rr->peak_detect_state, params);
+    if (!ok) {
+        pl_dispatch_abort(rr->dp, &sh);
+        return false;
+    }
+
+    // Discard the sampled color, the only output is the detection buffer.
+    // Invocations outside the image are excluded by the shader itself, based
+    // on the size passed along below.
+    sh->res.output = PL_SHADER_SIG_NONE;
+    const int bw = sh->res.compute_group_size[0],
+              bh = sh->res.compute_group_size[1];
+
+    // Only the color mapping pass consumes the result (via the peak detection
+    // buffer), so let this run concurrently with the intermediate passes
+    return pl_dispatch_compute(rr->dp, &(struct pl_dispatch_compute_params) {
+        .shader = &sh,
+        .dispatch_size = { (w + bw - 1) / bw, (h + bh - 1) / bh, 1 },
+        .width  = w,
+        .height = h,
+        .timer  = pass_timer(pass),
+        .async  = true,
+    });
+}
+
 static void hdr_update_peak(struct pass_state *pass,
                             const struct pl_render_params *params)
 {
@@ -859,7 +1677,11 @@ static void hdr_update_peak(struct pass_state *pass,
     if (rr->disable_compute || rr->disable_peak_detect)
         goto cleanup;
 
-    if (!FBOFMT && !params->allow_delayed_peak_detect) {
+    // Without FBOs, the detection can only run as a prepass if the image is
+    // already available as a texture. Otherwise, it has to be merged into
+    // the main shader, which delays the result by a frame.
+    bool have_tex = FBOFMT || pass->img.tex;
+    if (!have_tex && !params->allow_delayed_peak_detect) {
         PL_WARN(rr, "Disabling peak detection because "
                 "`allow_delayed_peak_detect` is false, but lack of FBOs "
                 "forces the result to be delayed.");
@@ -867,9 +1689,18 @@ static void hdr_update_peak(struct pass_state *pass,
         goto cleanup;
     }
 
-    bool ok = pl_shader_detect_peak(img_sh(pass, &pass->img), pass->img.color,
-                                    &rr->peak_detect_state,
-                                    params->peak_detect_params);
+    const struct pl_peak_detect_params *dparams = params->peak_detect_params;
+    bool ok;
+    if (have_tex && dparams->downsample > 1) {
+        ok = pass->peak_prepass = hdr_detect_prepass(pass, dparams,
+                                                     dparams->downsample);
+    } else if (!FBOFMT && !params->allow_delayed_peak_detect) {
+        ok = pass->peak_prepass = hdr_detect_prepass(pass, dparams, 1);
+    } else {
+        ok = pl_shader_detect_peak(img_sh(pass, &pass->img), pass->img.color,
+                                   &rr->peak_detect_state, dparams);
+    }
+
     if (!ok) {
         PL_WARN(rr, "Failed creating HDR peak detection shader.. disabling");
         rr->disable_peak_detect = true;
@@ -1030,19 +1861,45 @@ static bool plane_av1_grain(struct pass_state *pass, int plane_idx,
         return false;
     }
 
+    // Leave the grain shader pending, so it can be fused into the plane
+    // merging pass if possible (see `plane_grain_fusable`)
     img->tex = NULL;
-    if (!img_tex(pass, img)) {
-        PL_ERR(rr, "Failed applying AV1 grain.. disabling!");
-        pl_dispatch_abort(rr->dp, &img->sh);
-        img->tex = grain_params.tex;
-        rr->disable_grain = true;
-        return false;
-    }
-
     img->repr = repr;
     return true;
 }
 
+// Returns whether a plane's pending AV1 grain shader can be fused directly
+// into the plane merging pass, which requires the plane to be sampled 1:1
+// (and in its entirety) without debanding
+static bool plane_grain_fusable(struct pass_state *pass, const struct img *img,
+                                const struct pl_rect2df *rect, int w, int h,
+                                const struct pl_render_params *params)
+{
+    struct pl_renderer *rr = pass->rr;
+    if (!img->sh)
+        return false;
+    if (!rr->disable_debanding && params->deband_params)
+        return false;
+
+    return w == img->w && h == img->h &&
+           rect->x0 == 0 && rect->y0 == 0 && rect->x1 == w && rect->y1 == h;
+}
+
+// Dispatches a plane's pending AV1 grain shader into an intermediate texture
+static void plane_grain_finish(struct pass_state *pass, struct plane_state *st,
+                               const struct pl_image *image)
+{
+    struct pl_renderer *rr = pass->rr;
+    if (!st->img.sh || img_tex(pass, &st->img))
+        return;
+
+    PL_ERR(rr, "Failed applying AV1 grain.. disabling!");
+    pl_dispatch_abort(rr->dp, &st->img.sh);
+    st->img.tex = st->plane.texture;
+    st->img.repr = image->repr;
+    rr->disable_grain = true;
+}
+
 // Returns true if any user hooks were executed
 static bool plane_user_hooks(struct pass_state *pass, struct plane_state *st,
                              const struct pl_render_params *params)
@@ -1120,6 +1977,7 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
     pass->ref_rect = image->src_rect;
 
     // Do a second pass to compute the rc of each plane
+    int ref_w = 0, ref_h = 0;
     for (int i = 0; i < image->num_planes; i++) {
         struct plane_state *st = &planes[i];
         float rx = ref_tex->params.w / st->plane.texture->params.w,
@@ -1164,6 +2022,18 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
             log_plane_info(rr, st);
         }
 
+        // Only keep the grain shader pending if it could be fused later on
+        if (!plane_grain_fusable(pass, &st->img, &st->img.rect, st->img.w,
+                                 st->img.h, params))
+        {
+            plane_grain_finish(pass, st, image);
+        }
+
+        if (st == ref) {
+            ref_w = st->img.w;
+            ref_h = st->img.h;
+        }
+
         // Update the conceptual width/height after applying plane shaders
         st->img.w = roundf(pl_rect_w(st->img.rect));
         st->img.h = roundf(pl_rect_h(st->img.rect));
@@ -1188,6 +2058,36 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
     float off_x = ref->img.rect.x0 - truncf(ref->img.rect.x0),
           off_y = ref->img.rect.y0 - truncf(ref->img.rect.y0);
 
+    // Only the cropped region of the image gets merged, so that rendering a
+    // small crop of a large image doesn't process the entire image. However,
+    // the main scaler also reads some pixels beyond the edges of the crop, so
+    // include these as well (where available), rather than having the scaler
+    // clamp to the edges of the crop.
+    int pad_x0 = 0, pad_y0 = 0, pad_x1 = 0, pad_y1 = 0;
+    if (FBOFMT) {
+        struct pl_sample_src msrc = {
+            .new_w = abs(pl_rect_w(pass->dst_rect)),
+            .new_h = abs(pl_rect_h(pass->dst_rect)),
+            .rect  = ref->img.rect,
+        };
+
+        struct sampler_info info = sample_src_info(rr, &msrc, SAMPLER_MAIN, params);
+        if (info.type != SAMPLER_DIRECT) {
+            int apron = sampler_apron(&info, &msrc, params);
+            int x0 = truncf(ref->img.rect.x0),
+                y0 = truncf(ref->img.rect.y0);
+            pad_x0 = PL_MAX(PL_MIN(apron, x0), 0);
+            pad_y0 = PL_MAX(PL_MIN(apron, y0), 0);
+            pad_x1 = PL_MAX(PL_MIN(apron, ref_w - x0 - ref->img.w), 0);
+            pad_y1 = PL_MAX(PL_MIN(apron, ref_h - y0 - ref->img.h), 0);
+            PL_TRACE(rr, "Padding merged planes by {%d %d %d %d}",
+                     pad_x0, pad_y0, pad_x1, pad_y1);
+        }
+    }
+
+    int merged_w = ref->img.w + pad_x0 + pad_x1,
+        merged_h = ref->img.h + pad_y0 + pad_y1;
+
     bool has_alpha = false;
     for (int i = 0; i < image->num_planes; i++) {
         struct plane_state *st = &planes[i];
@@ -1197,39 +2097,56 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
               scale_y = pl_rect_h(st->img.rect) / pl_rect_h(ref->img.rect);
 
         struct pl_sample_src src = {
-            .tex        = img_tex(pass, &st->img),
             .components = plane->components,
             .scale      = pl_color_repr_normalize(&st->img.repr),
-            .new_w      = ref->img.w,
-            .new_h      = ref->img.h,
+            .new_w      = merged_w,
+            .new_h      = merged_h,
             .rect = {
-                st->img.rect.x0 - scale_x * off_x,
-                st->img.rect.y0 - scale_y * off_y,
-                st->img.rect.x1 - scale_x * off_x,
-                st->img.rect.y1 - scale_y * off_y,
+                st->img.rect.x0 - scale_x * (off_x + pad_x0),
+                st->img.rect.y0 - scale_y * (off_y + pad_y0),
+                st->img.rect.x1 - scale_x * (off_x - pad_x1),
+                st->img.rect.y1 - scale_y * (off_y - pad_y1),
             },
         };
 
-        if (!src.tex)
-            src.tex = plane->texture; // Sanity fallback
-
         PL_TRACE(rr, "Aligning plane %d: {%f %f %f %f} -> {%f %f %f %f}",
                 i, st->img.rect.x0, st->img.rect.y0,
                 st->img.rect.x1, st->img.rect.y1,
                 src.rect.x0, src.rect.y0,
                 src.rect.x1, src.rect.y1);
 
-        struct pl_shader *psh = pl_dispatch_begin_ex(rr->dp, true);
-        if (deband_src(pass, psh, &src, image, params) != DEBAND_SCALED)
-            dispatch_sampler(pass, psh, &rr->samplers[i], params, &src);
+        struct pl_shader *psh = NULL;
+        if (plane_grain_fusable(pass, &st->img, &src.rect, merged_w, merged_h,
+                                params))
+        {
+            // The grain shader already outputs the plane at the right size,
+            // so it can take the place of sampling it
+            PL_TRACE(rr, "Fusing AV1 grain into plane merging pass");
+            psh = st->img.sh;
+            st->img.sh = NULL;
+            if (src.scale != 1.0) {
+                pl_shader_append(psh, SH_BUF_BODY, "color *= vec4(%f);\n",
+                                 src.scale);
+            }
+        } else {
+            plane_grain_finish(pass, st, image);
+            src.tex = img_tex(pass, &st->img);
+            if (!src.tex)
+                src.tex = plane->texture; // Sanity fallback
+
+            psh = pl_dispatch_begin_ex(rr->dp, true);
+            if (deband_src(pass, psh, &src, image, params) != DEBAND_SCALED)
+                dispatch_sampler(pass, psh, &rr->samplers[i], SAMPLER_PLANE,
+                                 params, &src);
+        }
 
         ident_t sub = sh_subpass(sh, psh);
         if (!sub) {
             // Can't merge shaders, so instead force FBO indirection here
             struct img inter_img = {
                 .sh = psh,
-                .w = ref->img.w,
-                .h = ref->img.h,
+                .w = merged_w,
+                .h = merged_h,
             };
 
             const struct pl_tex *inter_tex = img_tex(pass, &inter_img);
@@ -1252,12 +2169,14 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
             pl_assert(sub);
         }
 
+        // Fused grain shaders output the components in order, just like the
+        // intermediate textures they would otherwise be rendered to
         GLSL("tmp = %s();\n", sub);
         for (int c = 0; c < src.components; c++) {
             if (plane->component_mapping[c] < 0)
                 continue;
             GLSL("color[%d] = tmp[%d];\n", plane->component_mapping[c],
-                 src.tex->params.format->sample_order[c]);
+                 src.tex ? src.tex->params.format->sample_order[c] : c);
 
             has_alpha |= plane->component_mapping[c] == PL_CHANNEL_A;
         }
@@ -1270,16 +2189,16 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
 
     pass->img = (struct img) {
         .sh     = sh,
-        .w      = ref->img.w,
-        .h      = ref->img.h,
+        .w      = merged_w,
+        .h      = merged_h,
         .repr   = ref->img.repr,
         .color  = image->color,
         .comps  = has_alpha ? 4 : 3,
         .rect   = {
-            off_x,
-            off_y,
-            off_x + pl_rect_w(ref->img.rect),
-            off_y + pl_rect_h(ref->img.rect),
+            pad_x0 + off_x,
+            pad_y0 + off_y,
+            pad_x0 + off_x + pl_rect_w(ref->img.rect),
+            pad_y0 + off_y + pl_rect_h(ref->img.rect),
         },
     };
 
@@ -1299,6 +2218,111 @@ static bool pass_read_image(struct pl_renderer *rr, struct pass_state *pass,
     return true;
 }
 
+// Crops `img` back to `img->rect`, if it contains more than just that (e.g.
+// the apron added by `pass_read_image`). Only the scalers respect
+// `img->rect`, so this must be done before handing the image to anything
+// else. The result is a resizable shader, so it can still be scaled for free.
+static bool crop_img(struct pass_state *pass, struct img *img)
+{
+    int w = roundf(fabs(pl_rect_w(img->rect))),
+        h = roundf(fabs(pl_rect_h(img->rect)));
+    if (img->w == w && img->h == h)
+        return true;
+
+    const struct pl_tex *tex = img_tex(pass, img);
+    if (!tex)
+        return false;
+
+    struct pl_renderer *rr = pass->rr;
+    struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
+    bool ok = pl_shader_sample_direct(sh, &(struct pl_sample_src) {
+        .tex        = tex,
+        .rect       = img->rect,
+        .new_w      = w,
+        .new_h      = h,
+        .components = img->comps,
+    });
+
+    if (!ok) {
+        PL_ERR(rr, "Failed cropping image to the sampled region!");
+        pl_dispatch_abort(rr->dp, &sh);
+        return false;
+    }
+
+    *img = (struct img) {
+        .sh     = sh,
+        .w      = w,
+        .h      = h,
+        .repr   = img->repr,
+        .rect   = { 0, 0, w, h },
+        .color  = img->color,
+        .comps  = img->comps,
+    };
+    return true;
+}
+
+// Pre-reduces `img` towards a target size of `new_w`x`new_h` by repeatedly
+// halving it, akin to walking down a mipmap chain. Each level is a single
+// bilinear tap in between four texels, i.e. an exact 2x2 box filter. Stops
+// once the image is no longer twice as large as the target in both
+// dimensions, leaving only a small ratio for the actual downscaler, or as
+// soon as the current level can't be sampled bilinearly.
+static bool pass_mip_reduce(struct pass_state *pass, struct img *img,
+                            int new_w, int new_h)
+{
+    struct pl_renderer *rr = pass->rr;
+    if (!(rr->fbofmt->caps & PL_FMT_CAP_LINEAR))
+        return true;
+
+    int levels = 0;
+    for (;;) {
+        float w = fabs(pl_rect_w(img->rect)), h = fabs(pl_rect_h(img->rect));
+        if (w < 2 * new_w || h < 2 * new_h)
+            break;
+
+        const struct pl_tex *tex = img_tex(pass, img);
+        if (!tex)
+            return false;
+
+        // Nearest sampling would just drop three out of four texels, so
+        // leave this level to the actual downscaler instead
+        if (tex->params.sample_mode != PL_TEX_SAMPLE_LINEAR)
+            break;
+
+        int mip_w = roundf(w / 2), mip_h = roundf(h / 2);
+        struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
+        bool ok = pl_shader_sample_direct(sh, &(struct pl_sample_src) {
+            .tex        = tex,
+            .rect       = img->rect,
+            .new_w      = mip_w,
+            .new_h      = mip_h,
+            .components = img->comps,
+        });
+
+        if (!ok) {
+            PL_WARN(rr, "Failed pre-reducing main image, falling back to "
+                    "the plain downscaler");
+            pl_dispatch_abort(rr->dp, &sh);
+            break;
+        }
+
+        *img = (struct img) {
+            .sh     = sh,
+            .w      = mip_w,
+            .h      = mip_h,
+            .repr   = img->repr,
+            .rect   = { 0, 0, mip_w, mip_h },
+            .color  = img->color,
+            .comps  = img->comps,
+        };
+        levels++;
+    }
+
+    if (levels)
+        PL_TRACE(rr, "Pre-reduced main image by %d mip level(s)", levels);
+    return true;
+}
+
 static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
                             const struct pl_render_params *params)
 {
@@ -1317,14 +2341,15 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
 
     const struct pl_image *image = &pass->image;
     bool need_fbo = image->num_overlays > 0;
-    need_fbo |= rr->peak_detect_state && !params->allow_delayed_peak_detect;
+    need_fbo |= rr->peak_detect_state && !params->allow_delayed_peak_detect &&
+                !pass->peak_prepass;
 
     // Force FBO indirection if this shader is non-resizable
     int out_w, out_h;
     if (img->sh && pl_shader_output_size(img->sh, &out_w, &out_h))
         need_fbo |= out_w != src.new_w || out_h != src.new_h;
 
-    struct sampler_info info = sample_src_info(rr, &src, params);
+    struct sampler_info info = sample_src_info(rr, &src, SAMPLER_MAIN, params);
     bool use_sigmoid = info.dir == SAMPLER_UP && params->sigmoid_params;
     bool use_linear  = use_sigmoid || info.dir == SAMPLER_DOWN;
 
@@ -1345,14 +2370,16 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
     }
 
     if (info.dir == SAMPLER_NOOP && !need_fbo) {
-        pl_assert(src.new_w == img->w && src.new_h == img->h);
         PL_TRACE(rr, "Skipping main scaler (would be no-op)");
+        if (!crop_img(pass, img))
+            return false;
+        pl_assert(src.new_w == img->w && src.new_h == img->h);
         return true;
     }
 
     if (info.type == SAMPLER_DIRECT && !need_fbo) {
         PL_TRACE(rr, "Skipping main scaler (free sampling)");
-        return true;
+        return crop_img(pass, img);
     }
 
     // Hard-disable both sigmoidization and linearization when required
@@ -1405,18 +2432,36 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
 
     pass_hook(pass, img, PL_HOOK_PRE_KERNEL, params);
 
-    src.tex = img_tex(pass, img);
-    struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
-    dispatch_sampler(pass, sh, &rr->samplers[SCALER_MAIN], params, &src);
-    *img = (struct img) {
-        .sh     = sh,
-        .w      = src.new_w,
-        .h      = src.new_h,
-        .repr   = img->repr,
-        .rect   = { 0, 0, src.new_w, src.new_h },
-        .color  = img->color,
-        .comps  = img->comps,
-    };
+    // The mip chain may already end at exactly the target size, in which
+    // case there's nothing left for the actual downscaler to do
+    bool done = false;
+    if (params->mipmap_downscaling && info.dir == SAMPLER_DOWN) {
+        if (!pass_mip_reduce(pass, img, src.new_w, src.new_h))
+            return false;
+        src.rect = img->rect;
+        // The source is larger than the target, so this can only match if
+        // some levels were produced, which always cover the full image
+        done = pl_rect_w(img->rect) == src.new_w &&
+               pl_rect_h(img->rect) == src.new_h;
+    }
+
+    if (done) {
+        PL_TRACE(rr, "Skipping main scaler (mip chain matches target size)");
+    } else {
+        src.tex = img_tex(pass, img);
+        struct pl_shader *sh = pl_dispatch_begin_ex(rr->dp, true);
+        dispatch_sampler(pass, sh, &rr->samplers[SCALER_MAIN], SAMPLER_MAIN,
+                         params, &src);
+        *img = (struct img) {
+            .sh     = sh,
+            .w      = src.new_w,
+            .h      = src.new_h,
+            .repr   = img->repr,
+            .rect   = { 0, 0, src.new_w, src.new_h },
+            .color  = img->color,
+            .comps  = img->comps,
+        };
+    }
 
     pass_hook(pass, img, PL_HOOK_POST_KERNEL, params);
 
@@ -1427,6 +2472,144 @@ static bool pass_scale_main(struct pl_renderer *rr, struct pass_state *pass,
     return true;
 }
 
+// Renders the color conversion from `src` to `dst` for a regular grid of
+// input colors, and downloads the result. Returns NULL on failure.
+static float *render_color_lut(struct pl_renderer *rr, int size,
+                               struct pl_color_space src,
+                               struct pl_color_space dst,
+                               const struct pl_render_params *params)
+{
+    const struct pl_gpu *gpu = rr->gpu;
+    float *data = NULL;
+    const struct pl_fmt *fmt;
+    fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 32, 32, PL_FMT_CAP_RENDERABLE |
+                                                    PL_FMT_CAP_HOST_READABLE);
+    if (!fmt) {
+        PL_WARN(rr, "No renderable, host-readable 32-bit float format found, "
+                "disabling color LUT!");
+        return NULL;
+    }
+
+    // The `b` slices are stacked vertically, which matches the memory layout
+    // of a 3D texture
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = size,
+        .h              = size * size,
+        .format         = fmt,
+        .renderable     = true,
+        .host_readable  = true,
+    });
+    if (!tex)
+        return NULL;
+
+    struct pl_shader *sh = pl_dispatch_begin(rr->dp);
+    sh_require(sh, PL_SHADER_SIG_NONE, size, size * size);
+    GLSL("vec4 color = vec4(0.0, 0.0, 0.0, 1.0);                      \n"
+         "{                                                            \n"
+         "ivec2 lut_pos = ivec2(gl_FragCoord.xy);                      \n"
+         "color.rgb = vec3(lut_pos.x, lut_pos.y %% %d, lut_pos.y / %d) \n"
+         "          * vec3(1.0 / %d.0);                                \n"
+         "}                                                            \n",
+         size, size, size - 1);
+    pl_shader_color_map(sh, params->color_map_params, src, dst, NULL, false);
+
+    // Don't let asynchronous compilation (or warm-up) skip this pass, since
+    // the result is needed right away
+    pl_dispatch_set_async(rr->dp, false);
+    bool warmup = pl_dispatch_set_warmup(rr->dp, false);
+    bool ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = tex,
+    });
+    pl_dispatch_set_warmup(rr->dp, warmup);
+    pl_dispatch_set_async(rr->dp, params->async_compile);
+
+    if (ok) {
+        data = talloc_array(NULL, float, 4 * size * size * size);
+        ok = pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = tex,
+            .ptr = data,
+        });
+    }
+
+    pl_tex_destroy(gpu, &tex);
+    if (!ok)
+        TA_FREEP(&data);
+    return data;
+}
+
+static void fill_color_lut(void *priv, float *data, int w, int h, int d)
+{
+    memcpy(data, priv, w * h * d * sizeof(float[4]));
+}
+
+// Applies the color conversion from `src` to `dst` using a (cached) 3D LUT.
+// Returns false if this is not possible, leaving `sh` unmodified.
+static bool pass_color_lut(struct pass_state *pass, struct pl_shader *sh,
+                           struct pl_color_space src, struct pl_color_space dst,
+                           bool prelinearized,
+                           const struct pl_render_params *params)
+{
+    struct pl_renderer *rr = pass->rr;
+    const struct pl_gpu *gpu = rr->gpu;
+    int size = params->color_lut_size;
+    if (rr->disable_color_lut)
+        return false;
+
+    if (gpu->glsl.version < 130 || size < 2 || size > gpu->limits.max_tex_3d_dim) {
+        PL_WARN(rr, "Color LUT of size %d not supported, disabling!", size);
+        rr->disable_color_lut = true;
+        return false;
+    }
+
+    const struct pl_color_map_params *cparams;
+    cparams = PL_DEF(params->color_map_params, &pl_color_map_default_params);
+    uint64_t sig = 0;
+    hash_color_space(&sig, &src);
+    hash_color_space(&sig, &dst);
+    hash_color_map_params(&sig, cparams);
+    PL_HASH_VAL(&sig, size);
+
+    float *data = NULL;
+    if (sig != rr->color_lut_sig || !rr->color_lut_state) {
+        PL_DEBUG(rr, "Baking color conversion into %dx%dx%d LUT",
+                 size, size, size);
+        data = render_color_lut(rr, size, src, dst, params);
+        if (!data) {
+            PL_ERR(rr, "Failed rendering color LUT.. disabling");
+            rr->disable_color_lut = true;
+            return false;
+        }
+    }
+
+    ident_t lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &rr->color_lut_state,
+        .method = SH_LUT_TEXTURE,
+        .width = size,
+        .height = size,
+        .depth = size,
+        .comps = 4,
+        .update = data != NULL,
+        .priv = data,
+        .fill = fill_color_lut,
+    });
+    talloc_free(data);
+    if (!lut) {
+        rr->disable_color_lut = true;
+        return false;
+    }
+
+    rr->color_lut_sig = sig;
+    if (prelinearized)
+        pl_shader_delinearize(sh, src.transfer);
+
+    ident_t tetra = sh_lut_tetrahedral(sh, lut, (int[3]) { size, size, size });
+    GLSL("// pass_color_lut                \n"
+         "color.rgb = %s(color.rgb).rgb;   \n",
+         tetra);
+    return true;
+}
+
 static bool pass_output_target(struct pl_renderer *rr, struct pass_state *pass,
                                const struct pl_render_params *params)
 {
@@ -1494,7 +2677,18 @@ fallback:
 
 #endif
 
-    if (!use_3dlut) {
+    // The color conversion can't be baked while peak detection is active
+    bool use_color_lut = !use_3dlut && params->color_lut_size;
+    if (use_color_lut && rr->peak_detect_state) {
+        PL_TRACE(rr, "Skipping color LUT (peak detection is active)");
+        use_color_lut = false;
+    }
+    if (use_color_lut) {
+        use_color_lut = pass_color_lut(pass, sh, ref, target->color,
+                                       prelinearized, params);
+    }
+
+    if (!use_3dlut && !use_color_lut) {
         // current -> target
         pl_shader_color_map(sh, params->color_map_params, ref, target->color,
                             &rr->peak_detect_state, prelinearized);
@@ -1538,11 +2732,12 @@ fallback:
     }
 
     sh = img_sh(pass, img);
-    pl_assert(fbo->params.renderable);
+    pl_assert(fbo->params.renderable || fbo->params.storable);
     bool ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
         .shader = &sh,
         .target = fbo,
         .rect   = pass->dst_rect,
+        .timer  = pass_timer(pass),
     });
 
     *img = (struct img) {0};
@@ -1559,6 +2754,8 @@ static void fix_rects(struct pass_state *pass, const struct pl_tex *ref_tex)
         src->y1 = ref_tex->params.h;
     };
 
+    pass->src_rect = *src;
+
     if ((!dst->x0 && !dst->x1) || (!dst->y0 && !dst->y1)) {
         dst->x1 = pass->target.fbo->params.w;
         dst->y1 = pass->target.fbo->params.h;
@@ -1629,9 +2826,7 @@ static void fix_rects(struct pass_state *pass, const struct pl_tex *ref_tex)
 // bounds checked. This is because most functions accepting enums already
 // abort() in the default case, and because it's not the intent of this check
 // to catch all instances of memory corruption - just common logic bugs.
-static bool validate_structs(struct pl_renderer *rr,
-                             const struct pl_image *image,
-                             const struct pl_render_target *target)
+static bool validate_image(struct pl_renderer *rr, const struct pl_image *image)
 {
     // Rendering an image with no planes technically works, but is pointless
     require(image->num_planes > 0 && image->num_planes < PL_MAX_PLANES);
@@ -1649,8 +2844,14 @@ static bool validate_structs(struct pl_renderer *rr,
         require(pl_rect_w(overlay->rect) && pl_rect_h(overlay->rect));
     }
 
+    return true;
+}
+
+static bool validate_target(struct pl_renderer *rr,
+                            const struct pl_render_target *target)
+{
     require(target->fbo);
-    require(target->fbo->params.renderable);
+    require(target->fbo->params.renderable || target->fbo->params.storable);
 
     float dst_w = pl_rect_w(target->dst_rect),
           dst_h = pl_rect_h(target->dst_rect);
@@ -1662,25 +2863,181 @@ static bool validate_structs(struct pl_renderer *rr,
         require(pl_rect_w(overlay->rect) && pl_rect_h(overlay->rect));
     }
 
+    if (target->export_sync) {
+        const struct pl_tex_params *tpars = &target->fbo->params;
+        require(tpars->export_handle || tpars->import_handle);
+    }
+
     return true;
 }
 
-bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
-                     const struct pl_render_target *ptarget,
-                     const struct pl_render_params *params)
+static bool validate_structs(struct pl_renderer *rr,
+                             const struct pl_image *image,
+                             const struct pl_render_target *target)
 {
-    params = PL_DEF(params, &pl_render_default_params);
-    if (!validate_structs(rr, pimage, ptarget))
+    return validate_image(rr, image) && validate_target(rr, target);
+}
+
+// Re-targets `pass` at `ptarget`, sharing the source image `src` read by
+// `pass_read_image` for a previous target (covering `src_rect`)
+static bool pass_next_target(struct pass_state *pass,
+                             const struct pl_render_target *ptarget,
+                             const struct img *src, struct pl_rect2df src_rect)
+{
+    struct pl_renderer *rr = pass->rr;
+    pass->target = *ptarget;
+    pl_color_space_infer(&pass->target.color);
+
+    // `pass->src_rect` is already inferred, so `fix_rects` won't need the ref
+    pass->image.src_rect = pass->src_rect;
+    fix_rects(pass, NULL);
+
+    // Map the (cropped) source region of this target into `src`
+    const struct pl_rect2df *rc = &pass->image.src_rect;
+    float sx = pl_rect_w(src->rect) / pl_rect_w(src_rect),
+          sy = pl_rect_h(src->rect) / pl_rect_h(src_rect);
+
+    pass->img = *src;
+    pass->img.rect = (struct pl_rect2df) {
+        .x0 = src->rect.x0 + (rc->x0 - src_rect.x0) * sx,
+        .y0 = src->rect.y0 + (rc->y0 - src_rect.y0) * sy,
+        .x1 = src->rect.x0 + (rc->x1 - src_rect.x0) * sx,
+        .y1 = src->rect.y0 + (rc->y1 - src_rect.y0) * sy,
+    };
+
+    const float eps = 1e-3;
+    if (pass->img.rect.x0 < -eps || pass->img.rect.y0 < -eps ||
+        pass->img.rect.x1 > src->w + eps || pass->img.rect.y1 > src->h + eps)
+    {
+        PL_ERR(rr, "Target crops the image to a region not covered by the "
+               "first target, all targets must share the same source region!");
+        return false;
+    }
+
+    pass->ref_rect = pass->img.rect;
+    return true;
+}
+
+// Hashes everything that may affect the output of `pass_scale_main`, or
+// returns 0 if the scaled image can't be cached
+static uint64_t scaled_params_hash(const struct pl_renderer *rr,
+                                   const struct pl_image *image,
+                                   const struct pl_render_target *target,
+                                   const struct pl_render_params *params)
+{
+    if (!image->signature || params->skip_redraw_caching || params->num_hooks ||
+        !FBOFMT)
+    {
+        return 0;
+    }
+
+    uint64_t hash = render_params_hash(params, true);
+    uintptr_t fbofmt = (uintptr_t) rr->fbofmt;
+    PL_HASH_VAL(&hash, image->src_rect);
+    hash_color_repr(&hash, &image->repr);
+    hash_color_space(&hash, &image->color);
+    hash_overlays(&hash, image->overlays, image->num_overlays);
+    PL_HASH_VAL(&hash, target->dst_rect);
+    PL_HASH_VAL(&hash, target->fbo->params.w);
+    PL_HASH_VAL(&hash, target->fbo->params.h);
+    PL_HASH_VAL(&hash, fbofmt);
+    PL_HASH_VAL(&hash, image->signature);
+    return hash;
+}
+
+// Renders the output of `pass_scale_main` into `rr->scaled.tex`, so it can be
+// re-used by future passes with the same upstream state (`hash`)
+static bool pass_cache_scaled(struct pass_state *pass, uint64_t hash)
+{
+    struct pl_renderer *rr = pass->rr;
+    struct img *img = &pass->img;
+    rr->scaled.hash = 0;
+
+    bool ok = recreate_fbo(rr, &rr->scaled.tex, &(struct pl_tex_params) {
+        .w = img->w,
+        .h = img->h,
+        .format = rr->fbofmt,
+        .sampleable = true,
+        .renderable = true,
+        .storable = !!(rr->fbofmt->caps & PL_FMT_CAP_STORABLE),
+        .sample_mode = (rr->fbofmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
+    });
+
+    if (!ok) {
+        PL_WARN(rr, "Failed creating texture for the scaled image cache!");
+        return true; // not fatal, just skip caching
+    }
+
+    int *consumed = NULL;
+    struct pl_shader *sh = img_sh(pass, img);
+    int num_consumed = consumed_fbos(pass, sh, &consumed);
+    ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
+        .shader = &img->sh,
+        .target = rr->scaled.tex,
+        .timer  = pass_timer(pass),
+    });
+
+    if (!ok) {
+        PL_ERR(rr, "Failed dispatching scaled image to cache!");
         return false;
+    }
+
+    for (int i = 0; i < num_consumed; i++)
+        pass->fbos_used[consumed[i]] = FBO_RELEASED;
+
+    img->tex = rr->scaled.tex;
+    rr->scaled.hash = hash;
+    rr->scaled.rect = img->rect;
+    rr->scaled.repr = img->repr;
+    rr->scaled.color = img->color;
+    rr->scaled.comps = img->comps;
+    rr->scaled.src_rect = pass->image.src_rect;
+    rr->scaled.dst_rect = pass->target.dst_rect;
+    rr->scaled.dst_irect = pass->dst_rect;
+    rr->scaled.image_color = pass->image.color;
+    return true;
+}
+
+// Restores the state left behind by `pass_read_image` and `pass_scale_main`
+// from `rr->scaled`
+static void pass_restore_scaled(struct pass_state *pass)
+{
+    struct pl_renderer *rr = pass->rr;
+    const struct pl_tex *tex = rr->scaled.tex;
+    PL_TRACE(rr, "Using cached scaled image 0x%llx",
+             (unsigned long long) pass->image.signature);
+
+    pass->image.src_rect = pass->src_rect = pass->ref_rect = rr->scaled.src_rect;
+    pass->image.color = rr->scaled.image_color;
+    pass->target.dst_rect = rr->scaled.dst_rect;
+    pass->dst_rect = rr->scaled.dst_irect;
+    pass->img = (struct img) {
+        .tex    = tex,
+        .w      = tex->params.w,
+        .h      = tex->params.h,
+        .rect   = rr->scaled.rect,
+        .repr   = rr->scaled.repr,
+        .color  = rr->scaled.color,
+        .comps  = rr->scaled.comps,
+    };
+}
 
+static bool render_image(struct pl_renderer *rr, const struct pl_image *pimage,
+                         const struct pl_render_target *ptargets,
+                         int num_targets, const struct pl_render_params *params)
+{
     struct pass_state pass = {
         .tmp = talloc_new(NULL),
         .rr = rr,
         .image = *pimage,
-        .target = *ptarget,
+        .target = ptargets[0],
+        .params = params,
     };
 
-    pass.fbos_used = talloc_zero_array(pass.tmp, bool, rr->num_fbos);
+    pass.fbos_used = talloc_zero_array(pass.tmp, enum fbo_state, rr->num_fbos);
+    pass.alias_fbos = !params->num_hooks;
 
     struct pl_image *image = &pass.image;
     struct pl_render_target *target = &pass.target;
@@ -1703,37 +3060,87 @@ bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
             params->hooks[i]->reset(params->hooks[i]->priv);
     }
 
-    if (!pass_read_image(rr, &pass, params))
-        goto error;
+    update_stats(rr);
 
-    if (!pass_scale_main(rr, &pass, params))
-        goto error;
+    // The scaled image cache only applies to single targets
+    uint64_t scaled_key = num_targets == 1 ? rr->scaled.key : 0;
+    bool scaled_cached = scaled_key && rr->scaled.tex &&
+                         rr->scaled.hash == scaled_key;
 
-    if (!pass_output_target(rr, &pass, params))
-        goto error;
+    if (scaled_cached) {
+        pass_restore_scaled(&pass);
+    } else {
+        pass.stage = PL_RENDER_STAGE_READ_IMAGE;
+        if (!pass_read_image(rr, &pass, params))
+            goto error;
+    }
 
-    // If we don't have FBOs available, simulate the on-image overlays at
-    // this stage
-    if (image->num_overlays > 0 && !FBOFMT) {
-        float rx = pl_rect_w(target->dst_rect) / pl_rect_w(image->src_rect),
-              ry = pl_rect_h(target->dst_rect) / pl_rect_h(image->src_rect);
+    // When rendering to multiple targets, the source image is only read once
+    // and kept around in an FBO, which all of the targets sample from
+    struct img src = pass.img;
+    struct pl_rect2df src_rect = image->src_rect;
+    if (num_targets > 1) {
+        if (!img_tex(&pass, &pass.img))
+            goto error;
+        src = pass.img;
+    }
 
-        struct pl_transform2x2 scale = {
-            .mat = {{{ rx, 0.0 }, { 0.0, ry }}},
-            .c = {
-                target->dst_rect.x0 - image->src_rect.x0 * rx,
-                target->dst_rect.y0 - image->src_rect.y0 * ry
-            },
-        };
+    for (int i = 0; i < num_targets; i++) {
+        if (i > 0) {
+            // Everything except for the source image was consumed by the
+            // previous target, so those FBOs may be reused
+            for (int n = 0; pass.alias_fbos && n < rr->num_fbos; n++) {
+                if (pass.fbos_used[n] == FBO_USED && rr->fbos[n] != src.tex)
+                    pass.fbos_used[n] = FBO_RELEASED;
+            }
 
-        draw_overlays(&pass, target->fbo, image->overlays, image->num_overlays,
-                      target->color, false, &scale, params);
-    }
+            if (!pass_next_target(&pass, &ptargets[i], &src, src_rect))
+                goto error;
+        }
 
-    // Draw the final output overlays
-    draw_overlays(&pass, target->fbo, target->overlays, target->num_overlays,
-                  target->color, false, NULL, params);
+        if (!scaled_cached) {
+            pass.stage = PL_RENDER_STAGE_SCALE_MAIN;
+            if (!pass_scale_main(rr, &pass, params))
+                goto error;
+
+            // Start caching the scaled image once the same image was
+            // rendered twice in a row with the same upstream state
+            if (scaled_key && scaled_key == rr->scaled.last_hash) {
+                if (!pass_cache_scaled(&pass, scaled_key))
+                    goto error;
+            }
+        }
+
+        pass.stage = PL_RENDER_STAGE_OUTPUT_TARGET;
+        if (!pass_output_target(rr, &pass, params))
+            goto error;
+
+        // If we don't have FBOs available, simulate the on-image overlays at
+        // this stage
+        if (image->num_overlays > 0 && !FBOFMT) {
+            float rx = pl_rect_w(target->dst_rect) / pl_rect_w(image->src_rect),
+                  ry = pl_rect_h(target->dst_rect) / pl_rect_h(image->src_rect);
+
+            struct pl_transform2x2 scale = {
+                .mat = {{{ rx, 0.0 }, { 0.0, ry }}},
+                .c = {
+                    target->dst_rect.x0 - image->src_rect.x0 * rx,
+                    target->dst_rect.y0 - image->src_rect.y0 * ry
+                },
+            };
+
+            draw_overlays(&pass, target->fbo, image->overlays,
+                          image->num_overlays, target->color, false, &scale,
+                          params);
+        }
+
+        // Draw the final output overlays
+        draw_overlays(&pass, target->fbo, target->overlays, target->num_overlays,
+                      target->color, false, NULL, params);
+    }
 
+    if (num_targets == 1)
+        rr->scaled.last_hash = scaled_key;
     talloc_free(pass.tmp);
     return true;
 
@@ -1744,6 +3151,810 @@ error:
     return false;
 }
 
+// Returns a simplified version of `params` which only needs cheap (and
+// usually already compiled) shaders
+static struct pl_render_params fallback_params(const struct pl_render_params *params)
+{
+    struct pl_render_params fallback = *params;
+    fallback.upscaler = NULL;
+    fallback.downscaler = NULL;
+    fallback.plane_upscaler = NULL;
+    fallback.plane_downscaler = NULL;
+    fallback.deband_params = NULL;
+    fallback.sigmoid_params = NULL;
+    fallback.hooks = NULL;
+    fallback.num_hooks = 0;
+    fallback.async_compile = false;
+    return fallback;
+}
+
+// Applies the dispatch-level options in `params` for a batch of calls to
+// `render_image`. Must be paired with `end_render`.
+static void begin_render(struct pl_renderer *rr,
+                         const struct pl_render_params *params)
+{
+    pl_dispatch_set_reduced_precision(rr->dp, params->reduced_precision);
+    pl_dispatch_set_specialize_constants(rr->dp, params->specialize_constants);
+    pl_dispatch_set_prefer_compute(rr->dp, params->prefer_compute);
+    pl_dispatch_set_autotune(rr->dp, params->autotune_compute);
+    pl_dispatch_set_async(rr->dp, params->async_compile);
+    pl_dispatch_skipped(rr->dp); // reset the counter
+    pl_dispatch_stats(rr->dp, &rr->frame_base);
+    rr->trace_start = pl_trace_begin(rr->ctx);
+}
+
+// Whether `params->async_compile` is in effect, in which case the rendering
+// should be preceded by a check whether the required passes are ready. This
+// check can't run user hooks, since these may have side effects (e.g. frame
+// counters), so it's not possible with hooks.
+static bool use_async(const struct pl_renderer *rr,
+                      const struct pl_render_params *params)
+{
+    return params->async_compile && !params->num_hooks &&
+           (rr->gpu->caps & PL_GPU_CAP_THREAD_SAFE);
+}
+
+// Hashes the structure of an image and its target (formats, sizes, color
+// spaces), which together with the params determines the passes required to
+// render it. Frames with the same key as the last fully compiled one skip the
+// readiness check. If a change slips through, the missing passes are simply
+// compiled synchronously.
+static void hash_probe_key(uint64_t *hash, const struct pl_image *image,
+                           const struct pl_render_target *target)
+{
+    PL_HASH_VAL(hash, image->num_planes);
+    for (int i = 0; i < image->num_planes; i++) {
+        const struct pl_plane *plane = &image->planes[i];
+        uintptr_t fmt = (uintptr_t) plane->texture->params.format;
+        PL_HASH_VAL(hash, fmt);
+        PL_HASH_VAL(hash, plane->texture->params.w);
+        PL_HASH_VAL(hash, plane->texture->params.h);
+        PL_HASH_VAL(hash, plane->components);
+        PL_HASH_VAL(hash, plane->component_mapping);
+    }
+
+    hash_color_repr(hash, &image->repr);
+    hash_color_space(hash, &image->color);
+    PL_HASH_VAL(hash, image->src_rect);
+    PL_HASH_VAL(hash, image->num_overlays);
+    PL_HASH_VAL(hash, image->profile.signature);
+
+    const struct pl_av1_grain_data *grain = &image->av1_grain;
+    PL_HASH_VAL(hash, grain->num_points_y);
+    PL_HASH_VAL(hash, grain->chroma_scaling_from_luma);
+    PL_HASH_VAL(hash, grain->num_points_uv);
+    PL_HASH_VAL(hash, grain->ar_coeff_lag);
+    PL_HASH_VAL(hash, grain->overlap);
+
+    uintptr_t fbofmt = (uintptr_t) target->fbo->params.format;
+    PL_HASH_VAL(hash, fbofmt);
+    PL_HASH_VAL(hash, target->fbo->params.w);
+    PL_HASH_VAL(hash, target->fbo->params.h);
+    hash_color_repr(hash, &target->repr);
+    hash_color_space(hash, &target->color);
+    PL_HASH_VAL(hash, target->dst_rect);
+    PL_HASH_VAL(hash, target->num_overlays);
+    PL_HASH_VAL(hash, target->profile.signature);
+}
+
+// Begins checking whether all passes required for the next calls to
+// `render_image` are ready, without blocking. These go through the rendering
+// pipeline in warm-up mode, which queues any missing passes for asynchronous
+// compilation, but doesn't render anything (or touch the caches, same as
+// `pl_renderer_warmup`). Must be paired with `probe_end`.
+static void probe_begin(struct pl_renderer *rr, uint64_t saved[2])
+{
+    saved[0] = rr->scaled.key;
+    saved[1] = rr->scaled.last_hash;
+    rr->scaled.key = 0;
+    rr->probing = true;
+    pl_dispatch_warmup_begin(rr->dp, 0);
+}
+
+// Returns true if all of the passes are ready, in which case the same calls
+// can be repeated for real. `ok` is the result of the calls.
+static bool probe_end(struct pl_renderer *rr, const uint64_t saved[2], bool ok)
+{
+    int pending = pl_dispatch_warmup_poll(rr->dp);
+    rr->scaled.key = saved[0];
+    rr->scaled.last_hash = saved[1];
+    rr->probing = false;
+
+    if (pending) {
+        PL_TRACE(rr, "%d passes pending compilation, rendering using "
+                 "fallback pipeline", pending);
+    }
+
+    // On failure, let the actual rendering report the error
+    return !ok || !pending;
+}
+
+static void end_render(struct pl_renderer *rr)
+{
+    pl_dispatch_set_async(rr->dp, false);
+    pl_dispatch_set_reduced_precision(rr->dp, false);
+    pl_dispatch_set_specialize_constants(rr->dp, false);
+    pl_dispatch_set_prefer_compute(rr->dp, false);
+    pl_dispatch_set_autotune(rr->dp, false);
+    pl_trace_end(rr->ctx, "renderer", "render", rr->trace_start);
+
+    struct pl_dispatch_stats dp_stats;
+    pl_dispatch_stats(rr->dp, &dp_stats);
+    rr->last_frame = dispatch_stats_diff(dp_stats, rr->frame_base);
+    rr->frames_rendered++;
+
+    // Forward any GPU timings that have become available in the meantime
+    if (pl_trace_test(rr->ctx))
+        update_stats(rr);
+}
+
+// Like `render_image`, but also takes care of `params->async_compile`. If the
+// fallback pipeline ended up being used, `*complete` is set to false.
+static bool render_image_async(struct pl_renderer *rr,
+                               const struct pl_image *pimage,
+                               const struct pl_render_target *ptargets,
+                               int num_targets,
+                               const struct pl_render_params *params,
+                               bool *complete)
+{
+    *complete = true;
+    begin_render(rr, params);
+
+    struct pl_render_params fallback;
+    uint64_t key = 0;
+    if (use_async(rr, params)) {
+        key = render_params_hash(params, false);
+        for (int i = 0; i < num_targets; i++)
+            hash_probe_key(&key, pimage, &ptargets[i]);
+    }
+
+    if (key && key != rr->async_ready) {
+        uint64_t saved[2];
+        probe_begin(rr, saved);
+        bool ok = render_image(rr, pimage, ptargets, num_targets, params);
+        if (!probe_end(rr, saved, ok)) {
+            // Don't keep (or cache) incomplete scaled images
+            rr->scaled.hash = rr->scaled.key = 0;
+            fallback = fallback_params(params);
+            params = &fallback;
+            *complete = false;
+            rr->async_ready = 0;
+        } else if (ok) {
+            rr->async_ready = key;
+        }
+    }
+
+    // Whatever is still missing at this point (e.g. the fallback pipeline's
+    // own passes) is compiled synchronously, so nothing gets skipped
+    pl_dispatch_set_async(rr->dp, false);
+    bool ok = render_image(rr, pimage, ptargets, num_targets, params);
+    end_render(rr);
+    rr->scaled.key = 0;
+    return ok;
+}
+
+// Maximum number of frames that can be blended together in a single pass
+#define MAX_MIX_FRAMES 16
+
+// Computes the (normalized) weight of each image in the mix. Returns the
+// number of images with a nonzero weight.
+static int mix_weights(const struct pl_image_mix *mix,
+                       const struct pl_render_params *params, float *weights)
+{
+    const struct pl_filter_config *mixer = params->frame_mixer;
+    float vsync = fmaxf(mix->vsync_duration, 0.0);
+    double total = 0.0;
+
+    for (int i = 0; i < mix->num_images; i++) {
+        float dist = mix->distances[i];
+        if (mixer) {
+            weights[i] = pl_filter_sample(mixer, dist);
+        } else {
+            // Built-in frame mixing: each frame is considered to be
+            // visible in the interval [dist - 0.5, dist + 0.5], and
+            // contributes in proportion to its overlap with the vsync
+            float start = fmaxf(dist - 0.5, -vsync / 2),
+                  end   = fminf(dist + 0.5,  vsync / 2);
+            weights[i] = fmaxf(end - start, 0.0);
+        }
+
+        weights[i] = fmaxf(weights[i], 0.0);
+        total += weights[i];
+    }
+
+    if (total <= 0.0) {
+        // Degenerate case (e.g. vsync_duration = 0.0), just pick the frame
+        // closest to the current instant
+        int best = 0;
+        for (int i = 1; i < mix->num_images; i++) {
+            if (fabsf(mix->distances[i]) < fabsf(mix->distances[best]))
+                best = i;
+        }
+
+        for (int i = 0; i < mix->num_images; i++)
+            weights[i] = i == best;
+        return 1;
+    }
+
+    // Drop the least significant frames if there are too many to blend
+    int num = 0;
+    for (int i = 0; i < mix->num_images; i++)
+        num += weights[i] > 0.0;
+
+    while (num > MAX_MIX_FRAMES) {
+        int worst = -1;
+        for (int i = 0; i < mix->num_images; i++) {
+            if (weights[i] > 0.0 && (worst < 0 || weights[i] < weights[worst]))
+                worst = i;
+        }
+
+        total -= weights[worst];
+        weights[worst] = 0.0;
+        num--;
+    }
+
+    for (int i = 0; i < mix->num_images; i++)
+        weights[i] /= total;
+
+    return num;
+}
+
+static uint64_t frame_params_hash(const struct pl_image *image,
+                                  const struct pl_render_target *target,
+                                  int w, int h,
+                                  const struct pl_render_params *params)
+{
+    uint64_t hash = render_params_hash(params, false);
+    PL_HASH_VAL(&hash, image->src_rect);
+    hash_overlays(&hash, image->overlays, image->num_overlays);
+    PL_HASH_VAL(&hash, target->dst_rect);
+    hash_color_space(&hash, &target->color);
+    PL_HASH_VAL(&hash, w);
+    PL_HASH_VAL(&hash, h);
+    PL_HASH_VAL(&hash, image->profile.signature);
+    PL_HASH_VAL(&hash, target->profile.signature);
+    return hash;
+}
+
+// Returns the cached frame for a given image, (re-)rendering it if necessary
+static struct cached_frame *get_cached_frame(struct pl_renderer *rr,
+                                             const struct pl_image *image,
+                                             struct pl_render_target *inter,
+                                             int w, int h,
+                                             const struct pl_render_params *params)
+{
+    struct cached_frame *frame = NULL;
+    for (int i = 0; i < rr->num_frames; i++) {
+        if (rr->frames[i].signature == image->signature) {
+            frame = &rr->frames[i];
+            break;
+        }
+    }
+
+    if (!frame) {
+        TARRAY_APPEND(rr, rr->frames, rr->num_frames, (struct cached_frame) {
+            .signature = image->signature,
+        });
+        frame = &rr->frames[rr->num_frames - 1];
+    }
+
+    frame->evict = false;
+
+    uint64_t hash = frame_params_hash(image, inter, w, h, params);
+    if (frame->tex && frame->params_hash == hash && !params->skip_redraw_caching) {
+        PL_TRACE(rr, "Using cached frame 0x%llx",
+                 (unsigned long long) image->signature);
+        return frame;
+    }
+
+    bool ok = recreate_fbo(rr, &frame->tex, &(struct pl_tex_params) {
+        .w = w,
+        .h = h,
+        .format = rr->fbofmt,
+        .sampleable = true,
+        .renderable = true,
+        .storable = !!(rr->fbofmt->caps & PL_FMT_CAP_STORABLE),
+    });
+
+    if (!ok) {
+        PL_ERR(rr, "Failed creating intermediate texture for frame mixing!");
+        frame->params_hash = 0;
+        return NULL;
+    }
+
+    bool complete;
+    inter->fbo = frame->tex;
+    if (!render_image_async(rr, image, inter, 1, params, &complete)) {
+        frame->params_hash = 0;
+        return NULL;
+    }
+
+    // Don't cache incomplete frames, so they get redrawn once the proper
+    // shaders are available
+    frame->params_hash = complete ? hash : 0;
+    return frame;
+}
+
+static uint64_t output_params_hash(const struct pl_image *image,
+                                   const struct pl_render_target *target,
+                                   const struct pl_render_params *params)
+{
+    const struct pl_tex *fbo = target->fbo;
+    uintptr_t fmt = (uintptr_t) fbo->params.format;
+    uint64_t hash = frame_params_hash(image, target, fbo->params.w,
+                                      fbo->params.h, params);
+    hash_color_repr(&hash, &image->repr);
+    hash_color_space(&hash, &image->color);
+    hash_color_repr(&hash, &target->repr);
+    PL_HASH_VAL(&hash, fmt);
+    PL_HASH_VAL(&hash, image->signature);
+    return hash;
+}
+
+// Bounding box of the area affected by an overlay, clipped to the target
+static struct pl_rect2d overlay_bounds(const struct pl_overlay *ol,
+                                       const struct pl_tex *fbo)
+{
+    struct pl_rect2df rc = {
+        ol->rect.x0, ol->rect.y0, ol->rect.x1, ol->rect.y1,
+    };
+
+    for (int i = 0; i < ol->num_parts; i++) {
+        struct pl_rect2df dst = ol->parts[i].dst;
+        pl_rect2df_normalize(&dst);
+        if (i == 0) {
+            rc = dst;
+            continue;
+        }
+
+        rc.x0 = PL_MIN(rc.x0, dst.x0);
+        rc.y0 = PL_MIN(rc.y0, dst.y0);
+        rc.x1 = PL_MAX(rc.x1, dst.x1);
+        rc.y1 = PL_MAX(rc.y1, dst.y1);
+    }
+
+    pl_rect2df_normalize(&rc);
+    return (struct pl_rect2d) {
+        .x0 = PL_MAX(floorf(rc.x0), 0),
+        .y0 = PL_MAX(floorf(rc.y0), 0),
+        .x1 = PL_MIN(ceilf(rc.x1), fbo->params.w),
+        .y1 = PL_MIN(ceilf(rc.y1), fbo->params.h),
+    };
+}
+
+static void restore_output(struct pl_renderer *rr, const struct pl_tex *fbo,
+                           struct pl_rect2d rc)
+{
+    if (rc.x1 <= rc.x0 || rc.y1 <= rc.y0)
+        return;
+
+    struct pl_rect3d rc3 = { rc.x0, rc.y0, 0, rc.x1, rc.y1, 1 };
+    pl_tex_blit(rr->gpu, fbo, rr->output_tex, rc3, rc3);
+}
+
+// Draws the target overlays on top of the (pre-overlay) target contents
+static bool redraw_overlays(struct pl_renderer *rr,
+                            const struct pl_render_target *target,
+                            const struct pl_render_params *params)
+{
+    struct pass_state pass = {
+        .tmp = talloc_new(NULL),
+        .rr = rr,
+        .target = *target,
+        .params = params,
+    };
+
+    pass.fbos_used = talloc_zero_array(pass.tmp, enum fbo_state, rr->num_fbos);
+    pl_dispatch_reset_frame(rr->dp);
+    draw_overlays(&pass, target->fbo, target->overlays, target->num_overlays,
+                  target->color, false, NULL, params);
+
+    talloc_free(pass.tmp);
+    return !rr->disable_overlay;
+}
+
+// Hands off the rendered target to `target->export_sync`, if requested
+static bool export_target(struct pl_renderer *rr,
+                          const struct pl_render_target *target)
+{
+    if (!target->export_sync)
+        return true;
+
+    return pl_tex_export(rr->gpu, target->fbo, target->export_sync);
+}
+
+bool pl_render_image(struct pl_renderer *rr, const struct pl_image *pimage,
+                     const struct pl_render_target *ptarget,
+                     const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    if (!validate_structs(rr, pimage, ptarget))
+        return false;
+
+    reset_timers(rr);
+    const struct pl_tex *fbo = ptarget->fbo;
+    bool cacheable = !params->skip_redraw_caching && pimage->signature &&
+                     ptarget->num_overlays && !rr->disable_overlay &&
+                     fbo->params.blit_src && fbo->params.blit_dst;
+
+    // Consumed by the next call to `render_image_async`
+    uint64_t scaled_key = scaled_params_hash(rr, pimage, ptarget, params);
+
+    bool complete, ok;
+    if (!cacheable) {
+        rr->output_hash = rr->last_hash = 0;
+        rr->scaled.key = scaled_key;
+        ok = render_image_async(rr, pimage, ptarget, 1, params, &complete);
+        return ok && export_target(rr, ptarget);
+    }
+
+    uint64_t hash = output_params_hash(pimage, ptarget, params);
+    if (rr->output_tex && rr->output_hash == hash) {
+        // Only the target overlays can have changed
+        PL_TRACE(rr, "Redrawing overlays on top of cached frame 0x%llx",
+                 (unsigned long long) pimage->signature);
+        if (params->partial_redraw && fbo == rr->output_fbo) {
+            // Only restore the areas covered by the previous and current
+            // overlays, everything else is still intact
+            for (int i = 0; i < rr->num_osd_rects; i++)
+                restore_output(rr, fbo, rr->osd_rects[i]);
+            for (int i = 0; i < ptarget->num_overlays; i++) {
+                const struct pl_overlay *ol = &ptarget->overlays[i];
+                restore_output(rr, fbo, overlay_bounds(ol, fbo));
+            }
+        } else {
+            restore_output(rr, fbo, (struct pl_rect2d) {
+                0, 0, fbo->params.w, fbo->params.h,
+            });
+        }
+
+        ok = redraw_overlays(rr, ptarget, params);
+    } else if (rr->last_hash == hash) {
+        // The same frame was rendered twice in a row (e.g. paused playback),
+        // so start caching the output prior to drawing the target overlays
+        struct pl_render_target inter = *ptarget;
+        inter.overlays = NULL;
+        inter.num_overlays = 0;
+        rr->scaled.key = scaled_key;
+        ok = render_image_async(rr, pimage, &inter, 1, params, &complete);
+
+        ok = ok && recreate_fbo(rr, &rr->output_tex,
+            &(struct pl_tex_params) {
+                .w = fbo->params.w,
+                .h = fbo->params.h,
+                .format = fbo->params.format,
+                .blit_src = true,
+                .blit_dst = true,
+            });
+
+        if (ok) {
+            struct pl_rect3d rc = { 0, 0, 0, fbo->params.w, fbo->params.h, 1 };
+            pl_tex_blit(rr->gpu, rr->output_tex, fbo, rc, rc);
+            rr->output_hash = complete ? hash : 0;
+            ok = redraw_overlays(rr, ptarget, params);
+        }
+    } else {
+        rr->output_hash = 0;
+        rr->scaled.key = scaled_key;
+        ok = render_image_async(rr, pimage, ptarget, 1, params, &complete);
+    }
+
+    // Remember the areas touched by this frame's overlays
+    rr->last_hash = hash;
+    rr->output_fbo = fbo;
+    rr->num_osd_rects = 0;
+    for (int i = 0; i < ptarget->num_overlays; i++) {
+        TARRAY_APPEND(rr, rr->osd_rects, rr->num_osd_rects,
+                      overlay_bounds(&ptarget->overlays[i], fbo));
+    }
+
+    return ok && export_target(rr, ptarget);
+}
+
+bool pl_renderer_warmup(struct pl_renderer *rr, const struct pl_image *pimage,
+                        const struct pl_render_target *ptarget,
+                        const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    if (!validate_structs(rr, pimage, ptarget))
+        return false;
+
+    // Go through the regular rendering pipeline, except that the dispatch
+    // only compiles the passes. The caches are left untouched, since nothing
+    // actually gets rendered
+    uint64_t last_hash = rr->scaled.last_hash;
+    rr->scaled.key = 0;
+
+    uint64_t start = pl_trace_begin(rr->ctx);
+    pl_dispatch_set_reduced_precision(rr->dp, params->reduced_precision);
+    pl_dispatch_set_specialize_constants(rr->dp, params->specialize_constants);
+    pl_dispatch_set_prefer_compute(rr->dp, params->prefer_compute);
+    pl_dispatch_set_autotune(rr->dp, params->autotune_compute);
+    pl_dispatch_warmup_begin(rr->dp, 0);
+    bool ok = render_image(rr, pimage, ptarget, 1, params);
+    ok &= pl_dispatch_warmup_end(rr->dp);
+    pl_dispatch_set_reduced_precision(rr->dp, false);
+    pl_dispatch_set_specialize_constants(rr->dp, false);
+    pl_dispatch_set_prefer_compute(rr->dp, false);
+    pl_dispatch_set_autotune(rr->dp, false);
+    pl_trace_end(rr->ctx, "renderer", "warmup", start);
+
+    rr->scaled.last_hash = last_hash;
+    return ok;
+}
+
+bool pl_render_image_multi(struct pl_renderer *rr, const struct pl_image *pimage,
+                           const struct pl_render_target *ptargets,
+                           int num_targets,
+                           const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    require(num_targets > 0);
+    for (int i = 0; i < num_targets; i++) {
+        if (!validate_structs(rr, pimage, &ptargets[i]))
+            return false;
+    }
+
+    // Sharing the source image requires FBOs. Also, on-image overlays get
+    // drawn directly onto the source image, which must not happen twice.
+    if (num_targets == 1 || !FBOFMT || pimage->num_overlays) {
+        bool ok = true;
+        for (int i = 0; i < num_targets; i++)
+            ok &= pl_render_image(rr, pimage, &ptargets[i], params);
+        return ok;
+    }
+
+    bool complete;
+    rr->output_hash = rr->last_hash = 0;
+    reset_timers(rr);
+    bool ok = render_image_async(rr, pimage, ptargets, num_targets, params,
+                                 &complete);
+    for (int i = 0; ok && i < num_targets; i++)
+        ok = export_target(rr, &ptargets[i]);
+    return ok;
+}
+
+// Renders all tiles, drawing the target overlays on top of the last one
+static bool render_tiles(struct pl_renderer *rr,
+                         const struct pl_render_tile *tiles, int num_tiles,
+                         const struct pl_render_target *ptarget,
+                         const struct pl_render_params *params)
+{
+    struct pl_render_target target = *ptarget;
+    target.overlays = NULL;
+    target.num_overlays = 0;
+
+    bool ok = true;
+    for (int i = 0; i < num_tiles; i++) {
+        if (i == num_tiles - 1) {
+            target.overlays = ptarget->overlays;
+            target.num_overlays = ptarget->num_overlays;
+        }
+
+        target.dst_rect = tiles[i].dst_rect;
+        ok &= render_image(rr, tiles[i].image, &target, 1, params);
+    }
+
+    return ok;
+}
+
+bool pl_render_tiles(struct pl_renderer *rr, const struct pl_render_tile *tiles,
+                     int num_tiles, const struct pl_render_target *ptarget,
+                     const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    require(num_tiles > 0);
+    if (!validate_target(rr, ptarget))
+        return false;
+
+    for (int i = 0; i < num_tiles; i++) {
+        require(tiles[i].image);
+        require(pl_rect_w(tiles[i].dst_rect) && pl_rect_h(tiles[i].dst_rect));
+        if (!validate_image(rr, tiles[i].image))
+            return false;
+    }
+
+    rr->output_hash = rr->last_hash = 0;
+    reset_timers(rr);
+    begin_render(rr, params);
+
+    struct pl_render_params fallback;
+    uint64_t key = 0;
+    if (use_async(rr, params)) {
+        key = render_params_hash(params, false);
+        for (int i = 0; i < num_tiles; i++) {
+            hash_probe_key(&key, tiles[i].image, ptarget);
+            PL_HASH_VAL(&key, tiles[i].dst_rect);
+        }
+    }
+
+    if (key && key != rr->async_ready) {
+        uint64_t saved[2];
+        probe_begin(rr, saved);
+        bool ok = render_tiles(rr, tiles, num_tiles, ptarget, params);
+        if (!probe_end(rr, saved, ok)) {
+            fallback = fallback_params(params);
+            params = &fallback;
+            rr->async_ready = 0;
+        } else if (ok) {
+            rr->async_ready = key;
+        }
+    }
+
+    // Any passes still missing are compiled synchronously, see
+    // `render_image_async`
+    pl_dispatch_set_async(rr->dp, false);
+    bool ok = render_tiles(rr, tiles, num_tiles, ptarget, params);
+    end_render(rr);
+    return ok && export_target(rr, ptarget);
+}
+
+bool pl_render_image_mix(struct pl_renderer *rr, const struct pl_image_mix *mix,
+                         const struct pl_render_target *ptarget,
+                         const struct pl_render_params *params)
+{
+    params = PL_DEF(params, &pl_render_default_params);
+    require(mix->num_images > 0);
+    require(!params->frame_mixer || !params->frame_mixer->polar);
+    for (int i = 0; i < mix->num_images; i++) {
+        if (!validate_structs(rr, &mix->images[i], ptarget))
+            return false;
+    }
+
+    void *tmp = talloc_new(NULL);
+    float *weights = talloc_array(tmp, float, mix->num_images);
+    int num = mix_weights(mix, params, weights);
+
+    // Fast path: if only a single frame contributes to the output, or we
+    // don't have the ability to use intermediate textures, just render the
+    // most significant frame directly
+    if (num == 1 || !FBOFMT) {
+        int best = 0;
+        for (int i = 1; i < mix->num_images; i++) {
+            if (weights[i] > weights[best])
+                best = i;
+        }
+
+        talloc_free(tmp);
+        return pl_render_image(rr, &mix->images[best], ptarget, params);
+    }
+
+    reset_timers(rr);
+
+    // Figure out the (rounded, clipped) output area of the target
+    const struct pl_tex *fbo = ptarget->fbo;
+    struct pl_rect2df dst = ptarget->dst_rect;
+    if (!pl_rect_w(dst) || !pl_rect_h(dst))
+        dst = (struct pl_rect2df) { 0, 0, fbo->params.w, fbo->params.h };
+
+    struct pl_rect2df ndst = dst;
+    pl_rect2df_normalize(&ndst);
+    struct pl_rect2d out = {
+        .x0 = roundf(PL_MAX(ndst.x0, 0.0)),
+        .y0 = roundf(PL_MAX(ndst.y0, 0.0)),
+        .x1 = roundf(PL_MIN(ndst.x1, fbo->params.w)),
+        .y1 = roundf(PL_MIN(ndst.y1, fbo->params.h)),
+    };
+
+    if (pl_rect_w(out) <= 0 || pl_rect_h(out) <= 0) {
+        talloc_free(tmp);
+        return export_target(rr, ptarget); // nothing to render
+    }
+
+    // Each frame is rendered into an intermediate texture covering exactly
+    // the output area, in the target's colorspace (but RGB encoded)
+    struct pl_render_target inter = {
+        .dst_rect = {
+            dst.x0 - out.x0, dst.y0 - out.y0,
+            dst.x1 - out.x0, dst.y1 - out.y0,
+        },
+        .repr = pl_color_repr_rgb,
+        .color = ptarget->color,
+        .profile = ptarget->profile,
+    };
+
+    struct pl_render_params inter_params = *params;
+    inter_params.dither_params = NULL;
+
+    for (int i = 0; i < rr->num_frames; i++)
+        rr->frames[i].evict = true;
+
+    const struct pl_tex **texs = talloc_array(tmp, const struct pl_tex *, num);
+    float *tex_weights = talloc_array(tmp, float, num);
+    int num_texs = 0;
+    struct pl_shader *sh = NULL;
+
+    for (int i = 0; i < mix->num_images; i++) {
+        if (!weights[i])
+            continue;
+
+        struct cached_frame *frame;
+        frame = get_cached_frame(rr, &mix->images[i], &inter, pl_rect_w(out),
+                                 pl_rect_h(out), &inter_params);
+        if (!frame)
+            goto error;
+
+        texs[num_texs] = frame->tex;
+        tex_weights[num_texs] = weights[i];
+        num_texs++;
+    }
+
+    // Garbage collect frames which are no longer part of the mixture
+    for (int i = rr->num_frames - 1; i >= 0; i--) {
+        if (rr->frames[i].evict) {
+            pl_tex_pool_put(rr->gpu, &rr->frames[i].tex);
+            TARRAY_REMOVE_AT(rr->frames, rr->num_frames, i);
+        }
+    }
+
+    // Blend the frames together and output them to the target
+    sh = pl_dispatch_begin(rr->dp);
+    if (!sh_require(sh, PL_SHADER_SIG_NONE, pl_rect_w(out), pl_rect_h(out)))
+        goto error;
+
+    ident_t pos = NULL;
+    GLSL("// pl_render_image_mix      \n"
+         "vec4 color = vec4(0.0);     \n");
+
+    for (int i = 0; i < num_texs; i++) {
+        ident_t tex = sh_bind(sh, texs[i], "frame", NULL, i ? NULL : &pos,
+                              NULL, NULL);
+        ident_t weight = sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_float("weight"),
+            .data = &tex_weights[i],
+            .dynamic = true,
+        });
+
+        GLSL("color += %s * %s(%s, %s); \n",
+             weight, sh_tex_fn(sh, texs[i]->params), tex, pos);
+    }
+
+    pl_shader_encode_color(sh, &ptarget->repr);
+    if (params->dither_params) {
+        int fmt_depth = fbo->params.format->component_depth[0];
+        int depth = PL_DEF(ptarget->repr.bits.sample_depth, fmt_depth);
+        if (depth <= 16 || params->force_dither)
+            pl_shader_dither(sh, depth, &rr->dither_state, params->dither_params);
+    }
+
+    pl_dispatch_set_prefer_compute(rr->dp, params->prefer_compute);
+    pl_dispatch_set_autotune(rr->dp, params->autotune_compute);
+    bool ok = pl_dispatch_finish(rr->dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+        .rect   = out,
+        .timer  = stage_timer(rr, PL_RENDER_STAGE_FRAME_MIX, params),
+    });
+
+    if (!ok)
+        goto error;
+
+    // Draw the final output overlays on top of the blended result
+    struct pass_state pass = {
+        .tmp = tmp,
+        .rr = rr,
+        .target = *ptarget,
+        .params = params,
+    };
+
+    pass.fbos_used = talloc_zero_array(tmp, enum fbo_state, rr->num_fbos);
+    draw_overlays(&pass, fbo, ptarget->overlays, ptarget->num_overlays,
+                  ptarget->color, false, NULL, params);
+
+    pl_dispatch_set_prefer_compute(rr->dp, false);
+    pl_dispatch_set_autotune(rr->dp, false);
+    talloc_free(tmp);
+    return export_target(rr, ptarget);
+
+error:
+    pl_dispatch_abort(rr->dp, &sh);
+    pl_dispatch_set_prefer_compute(rr->dp, false);
+    pl_dispatch_set_autotune(rr->dp, false);
+    talloc_free(tmp);
+    PL_ERR(rr, "Failed rendering image mix!");
+    return false;
+}
+
 void pl_image_set_chroma_location(struct pl_image *image,
                                   enum pl_chroma_location chroma_loc)
 {
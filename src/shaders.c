@@ -17,10 +17,43 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "context.h"
 #include "shaders.h"
+#include "dispatch.h"
+
+#define SH_HASH_MUL 0x100000001b3LLU
+
+static void sh_hash_init(struct pl_shader *sh)
+{
+    for (int i = 0; i < SH_BUF_COUNT; i++)
+        sh->hashes[i] = (struct sh_buf_hash) { .mul = 1 };
+}
+
+static void sh_hash_concat(struct sh_buf_hash *hash, struct sh_buf_hash other)
+{
+    hash->hash = hash->hash * other.mul + other.hash;
+    hash->mul *= other.mul;
+}
+
+// Appends an entire buffer (with its corresponding hash) to `buf`
+static void sh_buf_concat(struct pl_shader *sh, enum pl_shader_buf buf,
+                          struct bstr str, struct sh_buf_hash hash)
+{
+    bstr_xappend(sh, &sh->buffers[buf], str);
+    sh_hash_concat(&sh->hashes[buf], hash);
+}
+
+static void sh_buf_clear(struct pl_shader *sh, enum pl_shader_buf buf)
+{
+    if (sh->buffers[buf].len) {
+        sh->buffers[buf].len = 0;
+        sh->buffers[buf].start[0] = '\0'; // for sanity / efficiency
+    }
+    sh->hashes[buf] = (struct sh_buf_hash) { .mul = 1 };
+}
 
 struct pl_shader *pl_shader_alloc(struct pl_context *ctx,
                                   const struct pl_shader_params *params)
@@ -36,6 +69,7 @@ struct pl_shader *pl_shader_alloc(struct pl_context *ctx,
     if (params)
         sh->res.params = *params;
 
+    sh_hash_init(sh);
     return sh;
 }
 
@@ -49,11 +83,38 @@ void pl_shader_free(struct pl_shader **psh)
     TA_FREEP(psh);
 }
 
+#define SH_ARENA_MIN_SIZE 4096
+
+static void *sh_tmp_alloc(struct pl_shader *sh, size_t size)
+{
+    struct sh_arena *arena = &sh->arena;
+    size = talloc_align(size);
+    if (arena->size - arena->used < size) {
+        // Abandon the current block, it stays allocated until `tmp` is freed
+        size_t new_size = PL_MAX(SH_ARENA_MIN_SIZE, 2 * arena->size);
+        new_size = PL_MAX(new_size, size);
+        *arena = (struct sh_arena) {
+            .block = talloc_size(sh->tmp, new_size),
+            .size = new_size,
+        };
+    }
+
+    void *ptr = arena->block + arena->used;
+    arena->used += size;
+    return ptr;
+}
+
+static void *sh_tmp_memdup(struct pl_shader *sh, const void *data, size_t size)
+{
+    void *ptr = sh_tmp_alloc(sh, size);
+    memcpy(ptr, data, size);
+    return ptr;
+}
+
 void pl_shader_reset(struct pl_shader *sh, const struct pl_shader_params *params)
 {
     struct pl_shader new = {
         .ctx = sh->ctx,
-        .tmp = talloc_ref_new(sh->ctx),
         .mutable = true,
 
         // Preserve array allocations
@@ -69,8 +130,23 @@ void pl_shader_reset(struct pl_shader *sh, const struct pl_shader_params *params
     for (int i = 0; i < PL_ARRAY_SIZE(new.buffers); i++)
         new.buffers[i] = (struct bstr) { .start = sh->buffers[i].start };
 
-    talloc_ref_deref(&sh->tmp);
+    if (talloc_ref_is_unique(sh->tmp)) {
+        // Nobody else is using the temporary allocations, so we can recycle
+        // them. Keep only the most recent (and largest) block of the arena.
+        new.tmp = sh->tmp;
+        char *block = talloc_steal(NULL, sh->arena.block);
+        talloc_free_children(new.tmp);
+        new.arena = (struct sh_arena) {
+            .block = talloc_steal(new.tmp, block),
+            .size = sh->arena.size,
+        };
+    } else {
+        talloc_ref_deref(&sh->tmp);
+        new.tmp = talloc_ref_new(sh->ctx);
+    }
+
     *sh = new;
+    sh_hash_init(sh);
 }
 
 bool pl_shader_is_failed(const struct pl_shader *sh)
@@ -129,6 +205,7 @@ bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem)
         *sh_bw = bw;
         *sh_bh = bh;
         sh->is_compute = true;
+        sh->flexible_work_groups = flex;
         return true;
     }
 
@@ -156,6 +233,17 @@ bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem)
     return true;
 }
 
+void sh_tune_group_size(struct pl_shader *sh, uint64_t key,
+                        const int (*sizes)[2], int num_sizes, int out[2])
+{
+    if (sh->dp) {
+        pl_dispatch_tune_size(sh->dp, sh, key, sizes, num_sizes, out);
+    } else {
+        out[0] = sizes[0][0];
+        out[1] = sizes[0][1];
+    }
+}
+
 bool pl_shader_is_compute(const struct pl_shader *sh)
 {
     return sh->is_compute;
@@ -174,8 +262,8 @@ bool pl_shader_output_size(const struct pl_shader *sh, int *w, int *h)
 uint64_t pl_shader_signature(const struct pl_shader *sh)
 {
     uint64_t res = 0;
-    for (int i = 0; i < PL_ARRAY_SIZE(sh->buffers); i++)
-        res ^= bstr_hash64(sh->buffers[i]);
+    for (int i = 0; i < PL_ARRAY_SIZE(sh->hashes); i++)
+        res = res * SH_HASH_MUL + sh->hashes[i].hash;
 
     // FIXME: also hash in the configuration of the descriptors/variables
 
@@ -184,35 +272,95 @@ uint64_t pl_shader_signature(const struct pl_shader *sh)
 
 ident_t sh_fresh(struct pl_shader *sh, const char *name)
 {
-    return talloc_asprintf(sh->tmp, "_%s_%d_%u", PL_DEF(name, "var"),
-                           sh->fresh++, SH_PARAMS(sh).id);
+    name = PL_DEF(name, "var");
+    int id = sh->fresh++;
+    unsigned int sh_id = SH_PARAMS(sh).id;
+
+    int len = snprintf(NULL, 0, "_%s_%d_%u", name, id, sh_id);
+    pl_assert(len >= 0);
+    char *ret = sh_tmp_alloc(sh, len + 1);
+    snprintf(ret, len + 1, "_%s_%d_%u", name, id, sh_id);
+    return ret;
+}
+
+// Emits `sv` as a GLSL constant instead of a variable, if possible
+static bool sh_var_const(struct pl_shader *sh, const struct pl_shader_var *sv)
+{
+    const struct pl_var *var = &sv->var;
+    const char *type = pl_var_glsl_type_name(*var);
+    if (sv->dynamic || var->dim_a != 1 || !type)
+        return false;
+
+    int num = var->dim_v * var->dim_m;
+    if (var->type == PL_VAR_FLOAT) {
+        const float *f = sv->data;
+        for (int i = 0; i < num; i++) {
+            if (!isfinite(f[i]))
+                return false;
+        }
+    } else if (var->type == PL_VAR_UINT && sh_glsl(sh).version < 130) {
+        return false;
+    }
+
+    // Host layout is tightly packed and column-major, which matches the
+    // argument order of the GLSL matrix constructors
+    GLSLH("const %s %s = %s(", type, var->name, type);
+    for (int i = 0; i < num; i++) {
+        const char *sep = i > 0 ? ", " : "";
+        switch (var->type) {
+        case PL_VAR_FLOAT: GLSLH("%s%.9g", sep, ((const float *) sv->data)[i]); break;
+        case PL_VAR_SINT:  GLSLH("%s%d", sep, ((const int *) sv->data)[i]); break;
+        case PL_VAR_UINT:  GLSLH("%s%uu", sep, ((const unsigned *) sv->data)[i]); break;
+        default: abort();
+        }
+    }
+    GLSLH(");\n");
+    return true;
 }
 
 ident_t sh_var(struct pl_shader *sh, struct pl_shader_var sv)
 {
     sv.var.name = sh_fresh(sh, sv.var.name);
-    sv.data = talloc_memdup(sh->tmp, sv.data, pl_var_host_layout(0, &sv.var).size);
+    if (SH_PARAMS(sh).specialize_constants && sh_var_const(sh, &sv))
+        return (ident_t) sv.var.name;
+
+    sv.data = sh_tmp_memdup(sh, sv.data, pl_var_host_layout(0, &sv.var).size);
     TARRAY_APPEND(sh, sh->variables, sh->res.num_variables, sv);
     return (ident_t) sv.var.name;
 }
 
-ident_t sh_desc(struct pl_shader *sh, struct pl_shader_desc sd)
+// Returns the existing descriptor binding the same object in the same way as
+// `sd`, if any. Storage images are never shared, since their access modes
+// and memory qualifiers may differ.
+static const struct pl_shader_desc *sh_find_desc(const struct pl_shader *sh,
+                                                 const struct pl_shader_desc *sd)
 {
-    // Skip re-attaching the same buffer desc twice
-    // FIXME: define aliases if the variable names differ
-    switch (sd.desc.type) {
+    switch (sd->desc.type) {
+    case PL_DESC_SAMPLED_TEX:
     case PL_DESC_BUF_UNIFORM:
     case PL_DESC_BUF_STORAGE:
     case PL_DESC_BUF_TEXEL_UNIFORM:
     case PL_DESC_BUF_TEXEL_STORAGE:
         for (int i = 0; i < sh->res.num_descriptors; i++) {
-            if (sh->descriptors[i].object == sd.object)
-                return (ident_t) sh->descriptors[i].desc.name;
+            const struct pl_shader_desc *other = &sh->descriptors[i];
+            if (other->object == sd->object && other->desc.type == sd->desc.type)
+                return other;
         }
 
     default: break;
     }
 
+    return NULL;
+}
+
+ident_t sh_desc(struct pl_shader *sh, struct pl_shader_desc sd)
+{
+    // Skip re-attaching the same desc twice. Since the sampler state is part
+    // of the `pl_tex`, this also covers re-binding the same texture
+    const struct pl_shader_desc *other = sh_find_desc(sh, &sd);
+    if (other)
+        return (ident_t) other->desc.name;
+
     sd.desc.name = sh_fresh(sh, sd.desc.name);
     TARRAY_APPEND(sh, sh->descriptors, sh->res.num_descriptors, sd);
     return (ident_t) sd.desc.name;
@@ -240,7 +388,7 @@ ident_t sh_attr_vec2(struct pl_shader *sh, const char *name,
         { rc->x1, rc->y1 },
     };
 
-    float *data = talloc_memdup(sh->tmp, &vals[0][0], sizeof(vals));
+    float *data = sh_tmp_memdup(sh, &vals[0][0], sizeof(vals));
     struct pl_shader_va va = {
         .attr = {
             .name     = sh_fresh(sh, name),
@@ -357,17 +505,29 @@ void pl_shader_append(struct pl_shader *sh, enum pl_shader_buf buf,
 {
     pl_assert(buf >= 0 && buf < SH_BUF_COUNT);
 
+    struct bstr *str = &sh->buffers[buf];
+    size_t start = str->len;
+
     va_list ap;
     va_start(ap, fmt);
-    bstr_xappend_vasprintf_c(sh, &sh->buffers[buf], fmt, ap);
+    bstr_xappend_vasprintf_c(sh, str, fmt, ap);
     va_end(ap);
+
+    struct bstr frag = { str->start + start, str->len - start };
+    sh_hash_concat(&sh->hashes[buf], (struct sh_buf_hash) {
+        .hash = bstr_hash64(frag),
+        .mul = SH_HASH_MUL,
+    });
 }
 
 void pl_shader_append_bstr(struct pl_shader *sh, enum pl_shader_buf buf,
                            struct bstr str)
 {
     pl_assert(buf >= 0 && buf < SH_BUF_COUNT);
-    bstr_xappend(sh, &sh->buffers[buf], str);
+    sh_buf_concat(sh, buf, str, (struct sh_buf_hash) {
+        .hash = bstr_hash64(str),
+        .mul = SH_HASH_MUL,
+    });
 }
 
 static const char *insigs[] = {
@@ -423,14 +583,31 @@ ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub)
                      "exceeded shared memory resource capabilities");
             return NULL;
         }
+
+        if (!sh->tune.key)
+            sh->tune = sub->tune;
     }
 
     sh->output_w = res_w;
     sh->output_h = res_h;
 
+    // Merge the descriptors, aliasing the ones which are already bound (e.g.
+    // when multiple subpasses sample from the same plane)
+    for (int i = 0; i < sub->res.num_descriptors; i++) {
+        const struct pl_shader_desc *sd = &sub->descriptors[i];
+        const struct pl_shader_desc *other = sh_find_desc(sh, sd);
+        if (other) {
+            GLSLH("#define %s %s\n", sd->desc.name, other->desc.name);
+        } else {
+            TARRAY_APPEND(sh, sh->descriptors, sh->res.num_descriptors, *sd);
+        }
+    }
+
     // Append the prelude and header
-    bstr_xappend(sh, &sh->buffers[SH_BUF_PRELUDE], sub->buffers[SH_BUF_PRELUDE]);
-    bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER],  sub->buffers[SH_BUF_HEADER]);
+    sh_buf_concat(sh, SH_BUF_PRELUDE, sub->buffers[SH_BUF_PRELUDE],
+                  sub->hashes[SH_BUF_PRELUDE]);
+    sh_buf_concat(sh, SH_BUF_HEADER, sub->buffers[SH_BUF_HEADER],
+                  sub->hashes[SH_BUF_HEADER]);
 
     // Append the body as a new header function
     ident_t name = sh_fresh(sh, "sub");
@@ -442,14 +619,14 @@ ident_t sh_subpass(struct pl_shader *sh, const struct pl_shader *sub)
     } else {
         GLSLH("%s %s(%s) {\n", outsigs[sub->res.output], name, insigs[sub->res.input]);
     }
-    bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], sub->buffers[SH_BUF_BODY]);
+    sh_buf_concat(sh, SH_BUF_HEADER, sub->buffers[SH_BUF_BODY],
+                  sub->hashes[SH_BUF_BODY]);
     GLSLH("%s\n}\n\n", retvals[sub->res.output]);
 
-    // Copy over all of the descriptors etc.
+    // Copy over all of the variables etc.
     talloc_ref_attach(sh->tmp, sub->tmp);
 #define COPY(f) TARRAY_CONCAT(sh, sh->f, sh->res.num_##f, sub->f, sub->res.num_##f)
     COPY(variables);
-    COPY(descriptors);
     COPY(vertex_attribs);
 #undef COPY
 
@@ -472,17 +649,12 @@ static ident_t sh_split(struct pl_shader *sh)
         GLSLH("%s %s(%s) {\n", outsigs[sh->res.output], name, insigs[sh->res.input]);
     }
 
-    if (sh->buffers[SH_BUF_BODY].len) {
-        bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], sh->buffers[SH_BUF_BODY]);
-        sh->buffers[SH_BUF_BODY].len = 0;
-        sh->buffers[SH_BUF_BODY].start[0] = '\0'; // for sanity / efficiency
-    }
-
-    if (sh->buffers[SH_BUF_FOOTER].len) {
-        bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], sh->buffers[SH_BUF_FOOTER]);
-        sh->buffers[SH_BUF_FOOTER].len = 0;
-        sh->buffers[SH_BUF_FOOTER].start[0] = '\0';
-    }
+    sh_buf_concat(sh, SH_BUF_HEADER, sh->buffers[SH_BUF_BODY],
+                  sh->hashes[SH_BUF_BODY]);
+    sh_buf_concat(sh, SH_BUF_HEADER, sh->buffers[SH_BUF_FOOTER],
+                  sh->hashes[SH_BUF_FOOTER]);
+    sh_buf_clear(sh, SH_BUF_BODY);
+    sh_buf_clear(sh, SH_BUF_FOOTER);
 
     GLSLH("%s\n}\n\n", retvals[sh->res.output]);
     return name;
@@ -506,7 +678,8 @@ const struct pl_shader_res *pl_shader_finalize(struct pl_shader *sh)
 
     // Concatenate the header onto the prelude to form the final output
     struct bstr *glsl = &sh->buffers[SH_BUF_PRELUDE];
-    bstr_xappend(sh, glsl, sh->buffers[SH_BUF_HEADER]);
+    sh_buf_concat(sh, SH_BUF_PRELUDE, sh->buffers[SH_BUF_HEADER],
+                  sh->hashes[SH_BUF_HEADER]);
 
     // Set the vas/vars/descs
     sh->res.vertex_attribs = sh->vertex_attribs;
@@ -666,23 +839,158 @@ static ident_t sh_lut_pos(struct pl_shader *sh, int lut_size)
     return name;
 }
 
+// A texture LUT shared between all shader objects on a `pl_gpu`
+struct sh_lut_cache_entry {
+    void (*fill)(void *priv, float *data, int w, int h, int d);
+    uint64_t signature;
+    enum sh_lut_method method;
+    int width, height, depth, comps;
+    bool fp16;
+    const struct pl_tex *tex;
+    int refcount;
+};
+
+struct pl_lut_cache {
+    struct sh_lut_cache_entry **entries;
+    int num_entries;
+};
+
+// Protects the `lut_cache` of all `pl_gpu`s
+static pthread_mutex_t lut_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns a new reference to a matching cache entry, or NULL if none exists
+static struct sh_lut_cache_entry *lut_cache_get(const struct pl_gpu *gpu,
+                                                const struct sh_lut_params *params,
+                                                enum sh_lut_method method)
+{
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct sh_lut_cache_entry *ret = NULL;
+
+    pthread_mutex_lock(&lut_cache_lock);
+    struct pl_lut_cache *cache = impl->lut_cache;
+    for (int i = 0; cache && i < cache->num_entries; i++) {
+        struct sh_lut_cache_entry *e = cache->entries[i];
+        if (e->fill == params->fill && e->signature == params->signature &&
+            e->method == method && e->width == params->width &&
+            e->height == params->height && e->depth == params->depth &&
+            e->comps == params->comps && e->fp16 == params->fp16)
+        {
+            e->refcount++;
+            ret = e;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lut_cache_lock);
+
+    return ret;
+}
+
+// Adds a newly created LUT texture to the cache, taking over ownership of it
+static struct sh_lut_cache_entry *lut_cache_add(const struct pl_gpu *gpu,
+                                                const struct sh_lut_params *params,
+                                                enum sh_lut_method method,
+                                                const struct pl_tex *tex)
+{
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    pthread_mutex_lock(&lut_cache_lock);
+    if (!impl->lut_cache)
+        impl->lut_cache = talloc_zero(NULL, struct pl_lut_cache);
+
+    struct pl_lut_cache *cache = impl->lut_cache;
+    struct sh_lut_cache_entry *e = talloc_ptrtype(cache, e);
+    *e = (struct sh_lut_cache_entry) {
+        .fill = params->fill,
+        .signature = params->signature,
+        .method = method,
+        .width = params->width,
+        .height = params->height,
+        .depth = params->depth,
+        .comps = params->comps,
+        .fp16 = params->fp16,
+        .tex = tex,
+        .refcount = 1,
+    };
+
+    TARRAY_APPEND(cache, cache->entries, cache->num_entries, e);
+    pthread_mutex_unlock(&lut_cache_lock);
+    return e;
+}
+
+static void lut_cache_unref(const struct pl_gpu *gpu,
+                            struct sh_lut_cache_entry **entry)
+{
+    struct sh_lut_cache_entry *e = *entry;
+    if (!e)
+        return;
+
+    const struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    const struct pl_tex *tex = NULL;
+
+    pthread_mutex_lock(&lut_cache_lock);
+    if (--e->refcount == 0) {
+        struct pl_lut_cache *cache = impl->lut_cache;
+        for (int i = 0; i < cache->num_entries; i++) {
+            if (cache->entries[i] == e) {
+                TARRAY_REMOVE_AT(cache->entries, cache->num_entries, i);
+                break;
+            }
+        }
+        tex = e->tex;
+        talloc_free(e);
+    }
+    pthread_mutex_unlock(&lut_cache_lock);
+
+    pl_tex_destroy(gpu, &tex);
+    *entry = NULL;
+}
+
+void sh_lut_cache_destroy(const struct pl_gpu *gpu)
+{
+    struct pl_gpu_fns *impl = TA_PRIV(gpu);
+    struct pl_lut_cache *cache = impl->lut_cache;
+    for (int i = 0; cache && i < cache->num_entries; i++) {
+        PL_WARN(gpu, "Shared LUT 0x%llx still referenced on pl_gpu "
+                "destruction, leaked shader object?",
+                (unsigned long long) cache->entries[i]->signature);
+        pl_tex_destroy(gpu, &cache->entries[i]->tex);
+    }
+
+    TA_FREEP(&impl->lut_cache);
+}
+
 struct sh_lut_obj {
     enum sh_lut_method method;
     int width, height, depth, comps;
+    bool fp16;
+    uint64_t signature;
     union {
         const struct pl_tex *tex;
         struct bstr str;
         float *data;
     } weights;
+
+    // If set, `weights.tex` is borrowed from this shared cache entry
+    struct sh_lut_cache_entry *cached;
 };
 
+// Releases the LUT texture, whether owned or shared
+static void sh_lut_release_tex(const struct pl_gpu *gpu, struct sh_lut_obj *lut)
+{
+    if (lut->cached) {
+        lut_cache_unref(gpu, &lut->cached);
+        lut->weights.tex = NULL;
+    } else {
+        pl_tex_destroy(gpu, &lut->weights.tex);
+    }
+}
+
 static void sh_lut_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_lut_obj *lut = ptr;
     switch (lut->method) {
     case SH_LUT_TEXTURE:
     case SH_LUT_LINEAR:
-        pl_tex_destroy(gpu, &lut->weights.tex);
+        sh_lut_release_tex(gpu, lut);
         break;
     case SH_LUT_UNIFORM:
         talloc_free(lut->weights.data);
@@ -699,15 +1007,18 @@ static void sh_lut_uninit(const struct pl_gpu *gpu, void *ptr)
 // Maximum number of floats to embed as a literal array (when using SH_LUT_AUTO)
 #define SH_LUT_MAX_LITERAL 256
 
-ident_t sh_lut(struct pl_shader *sh, struct pl_shader_obj **obj,
-               enum sh_lut_method method, int width, int height, int depth,
-               int comps, bool update, bool dynamic, void *priv,
-               void (*fill)(void *priv, float *data, int w, int h, int d))
+ident_t sh_lut(struct pl_shader *sh, const struct sh_lut_params *params)
 {
     const struct pl_gpu *gpu = SH_GPU(sh);
     float *tmp = NULL;
     ident_t ret = NULL;
 
+    enum sh_lut_method method = params->method;
+    int width = params->width, height = params->height, depth = params->depth;
+    int comps = params->comps;
+    bool update = params->update;
+    bool dynamic = params->dynamic;
+
     pl_assert(width > 0 && height >= 0 && depth >= 0);
     int sizes[] = { width, height, depth };
     int size = width * PL_DEF(height, 1) * PL_DEF(depth, 1);
@@ -737,7 +1048,7 @@ ident_t sh_lut(struct pl_shader *sh, struct pl_shader_obj **obj,
 next_dim: ; // `continue` out of the inner loop
     }
 
-    struct sh_lut_obj *lut = SH_OBJ(sh, obj, PL_SHADER_OBJ_LUT,
+    struct sh_lut_obj *lut = SH_OBJ(sh, params->object, PL_SHADER_OBJ_LUT,
                                     struct sh_lut_obj, sh_lut_uninit);
 
     if (!lut) {
@@ -778,15 +1089,32 @@ next_dim: ; // `continue` out of the inner loop
 
     // Forcibly reinitialize the existing LUT if needed
     if (method != lut->method || width != lut->width || height != lut->height
-        || depth != lut->depth || comps != lut->comps)
+        || depth != lut->depth || comps != lut->comps || params->fp16 != lut->fp16)
     {
         PL_DEBUG(sh, "LUT method or size changed, reinitializing..");
         update = true;
     }
 
-    if (update) {
+    if (params->signature != lut->signature)
+        update = true;
+
+    // Try re-using an identical texture LUT from the shared cache
+    bool shared = params->signature && !dynamic &&
+                  (method == SH_LUT_TEXTURE || method == SH_LUT_LINEAR);
+
+    struct sh_lut_cache_entry *cached = NULL;
+    if (update && shared)
+        cached = lut_cache_get(gpu, params, method);
+
+    if (cached) {
+        PL_TRACE(sh, "Re-using shared LUT 0x%llx",
+                 (unsigned long long) params->signature);
+        sh_lut_release_tex(gpu, lut);
+        lut->cached = cached;
+        lut->weights.tex = cached->tex;
+    } else if (update) {
         tmp = talloc_zero_size(NULL, size * comps * sizeof(float));
-        fill(priv, tmp, width, height, depth);
+        params->fill(params->priv, tmp, width, height, depth);
 
         switch (method) {
         case SH_LUT_TEXTURE:
@@ -804,14 +1132,25 @@ next_dim: ; // `continue` out of the inner loop
                 mode = PL_TEX_SAMPLE_LINEAR;
             }
 
-            const struct pl_fmt *fmt;
-            fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 32, caps);
+            const struct pl_fmt *fmt = NULL;
+            if (params->fp16)
+                fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 16, caps);
+
+            if (fmt) {
+                // Convert the data in-place, since halves are smaller
+                uint16_t *half = (uint16_t *) tmp;
+                for (int i = 0; i < size * comps; i++)
+                    half[i] = pl_float_to_half(tmp[i]);
+            } else {
+                fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, comps, 16, 32, caps);
+            }
+
             if (!fmt) {
                 SH_FAIL(sh, "Found no compatible texture format for LUT!");
                 goto error;
             }
 
-            struct pl_tex_params params = {
+            struct pl_tex_params tparams = {
                 .w              = width,
                 .h              = PL_DEF(height, texdim >= 2 ? 1 : 0),
                 .d              = PL_DEF(depth,  texdim >= 3 ? 1 : 0),
@@ -825,7 +1164,7 @@ next_dim: ; // `continue` out of the inner loop
 
             bool ok;
             if (dynamic) {
-                ok = pl_tex_recreate(gpu, &lut->weights.tex, &params);
+                ok = pl_tex_recreate(gpu, &lut->weights.tex, &tparams);
                 if (ok) {
                     ok = pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
                         .tex = lut->weights.tex,
@@ -833,8 +1172,8 @@ next_dim: ; // `continue` out of the inner loop
                     });
                 }
             } else {
-                pl_tex_destroy(gpu, &lut->weights.tex);
-                lut->weights.tex = pl_tex_create(gpu, &params);
+                sh_lut_release_tex(gpu, lut);
+                lut->weights.tex = pl_tex_create(gpu, &tparams);
                 ok = lut->weights.tex;
             }
 
@@ -842,6 +1181,9 @@ next_dim: ; // `continue` out of the inner loop
                 SH_FAIL(sh, "Failed creating LUT texture!");
                 goto error;
             }
+
+            if (shared)
+                lut->cached = lut_cache_add(gpu, params, method, lut->weights.tex);
             break;
         }
 
@@ -855,28 +1197,32 @@ next_dim: ; // `continue` out of the inner loop
             lut->weights.str.len = 0;
             for (int i = 0; i < size * comps; i += comps) {
                 if (i > 0)
-                    bstr_xappend_asprintf_c(lut, &lut->weights.str, ",");
+                    bstr_xappend(lut, &lut->weights.str, bstr0(","));
                 if (comps > 1)
                     bstr_xappend_asprintf_c(lut, &lut->weights.str, "vec%d(", comps);
                 for (int c = 0; c < comps; c++) {
-                    bstr_xappend_asprintf_c(lut, &lut->weights.str, "%s%f",
-                                            c > 0 ? "," : "",
-                                            tmp[i+c]);
+                    if (c > 0)
+                        bstr_xappend(lut, &lut->weights.str, bstr0(","));
+                    bstr_xappend_float_c(lut, &lut->weights.str, tmp[i+c]);
                 }
                 if (comps > 1)
-                    bstr_xappend_asprintf_c(lut, &lut->weights.str, ")");
+                    bstr_xappend(lut, &lut->weights.str, bstr0(")"));
             }
             break;
         }
 
         case SH_LUT_AUTO: abort();
         }
+    }
 
+    if (update) {
         lut->method = method;
         lut->width = width;
         lut->height = height;
         lut->depth = depth;
         lut->comps = comps;
+        lut->fp16 = params->fp16;
+        lut->signature = params->signature;
     }
 
     // Done updating, generate the GLSL
@@ -962,7 +1308,7 @@ next_dim: ; // `continue` out of the inner loop
     case SH_LUT_LITERAL:
         arr_name = sh_fresh(sh, "weights");
         GLSLH("const %s %s[%d] = float[](\n  ", types[comps - 1], arr_name, size);
-        bstr_xappend(sh, &sh->buffers[SH_BUF_HEADER], lut->weights.str);
+        pl_shader_append_bstr(sh, SH_BUF_HEADER, lut->weights.str);
         GLSLH(");\n");
         break;
 
@@ -986,6 +1332,52 @@ error:
     return ret;
 }
 
+ident_t sh_lut_tetrahedral(struct pl_shader *sh, ident_t lut, const int size[3])
+{
+    pl_assert(size[0] > 1 && size[1] > 1 && size[2] > 1);
+    ident_t name = sh_fresh(sh, "lut_tetra");
+
+    // Split the enclosing cube into six tetrahedra, each sharing the diagonal
+    // from `base` to `base + 1`, and pick the one containing `pos` based on
+    // the ordering of its fractional coordinates
+    GLSLH("vec4 %s(vec3 pos) {                                              \n"
+          "    const vec3 size = vec3(%d.0, %d.0, %d.0);                    \n"
+          "    pos = clamp(pos, 0.0, 1.0) * (size - vec3(1.0));             \n"
+          "    vec3 base = min(floor(pos), size - vec3(2.0));               \n"
+          "    vec3 f = pos - base;                                         \n"
+          "    ivec3 i = ivec3(base), d1, d2;                               \n"
+          "    vec4 w;                                                      \n"
+          "    if (f.r >= f.g) {                                            \n"
+          "        if (f.g >= f.b) {                                        \n"
+          "            d1 = ivec3(1, 0, 0); d2 = ivec3(1, 1, 0);            \n"
+          "            w = vec4(1.0 - f.r, f.r - f.g, f.g - f.b, f.b);      \n"
+          "        } else if (f.r >= f.b) {                                 \n"
+          "            d1 = ivec3(1, 0, 0); d2 = ivec3(1, 0, 1);            \n"
+          "            w = vec4(1.0 - f.r, f.r - f.b, f.b - f.g, f.g);      \n"
+          "        } else {                                                 \n"
+          "            d1 = ivec3(0, 0, 1); d2 = ivec3(1, 0, 1);            \n"
+          "            w = vec4(1.0 - f.b, f.b - f.r, f.r - f.g, f.g);      \n"
+          "        }                                                        \n"
+          "    } else {                                                     \n"
+          "        if (f.b >= f.g) {                                        \n"
+          "            d1 = ivec3(0, 0, 1); d2 = ivec3(0, 1, 1);            \n"
+          "            w = vec4(1.0 - f.b, f.b - f.g, f.g - f.r, f.r);      \n"
+          "        } else if (f.b >= f.r) {                                 \n"
+          "            d1 = ivec3(0, 1, 0); d2 = ivec3(0, 1, 1);            \n"
+          "            w = vec4(1.0 - f.g, f.g - f.b, f.b - f.r, f.r);      \n"
+          "        } else {                                                 \n"
+          "            d1 = ivec3(0, 1, 0); d2 = ivec3(1, 1, 0);            \n"
+          "            w = vec4(1.0 - f.g, f.g - f.r, f.r - f.b, f.b);      \n"
+          "        }                                                        \n"
+          "    }                                                            \n"
+          "    return w.x * %s(i) + w.y * %s(i + d1) + w.z * %s(i + d2)     \n"
+          "         + w.w * %s(i + ivec3(1));                               \n"
+          "}                                                                \n",
+          name, size[0], size[1], size[2], lut, lut, lut, lut);
+
+    return name;
+}
+
 const char *sh_bvec(const struct pl_shader *sh, int dims)
 {
     static const char *bvecs[] = {
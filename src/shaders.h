@@ -36,17 +36,45 @@ enum pl_shader_buf {
     SH_BUF_COUNT,
 };
 
+// Running hash of the fragments appended to a shader buffer. This is built up
+// incrementally as the buffer is written to, so that `pl_shader_signature`
+// does not need to re-hash the entire shader text. The hash of two
+// concatenated buffers can be derived from their individual hashes.
+struct sh_buf_hash {
+    uint64_t hash;
+    uint64_t mul; // SH_HASH_MUL raised to the number of fragments
+};
+
+// Simple bump allocator for the many small, short-lived allocations made
+// while building a shader. The current block is a child of `pl_shader.tmp`,
+// and is reused across `pl_shader_reset` if nothing else references `tmp`.
+struct sh_arena {
+    char *block;
+    size_t used;
+    size_t size;
+};
+
+// Work group size picked for a shader by the dispatch's autotuner
+struct sh_tune {
+    uint64_t key;  // identifies the tuned shader, or 0 if none
+    int candidate; // index of the candidate size being measured, or -1
+};
+
 struct pl_shader {
     struct pl_context *ctx;
+    struct pl_dispatch *dp; // dispatch which created this shader, or NULL
     struct pl_shader_res res; // for accumulating some of the fields
     struct xta_ref *tmp; // only used for var/va/desc names and var/va data
+    struct sh_arena arena; // bump allocator for the contents of `tmp`
     bool failed;
     bool mutable;
     int output_w;
     int output_h;
     struct bstr buffers[SH_BUF_COUNT];
+    struct sh_buf_hash hashes[SH_BUF_COUNT];
     bool is_compute;
     bool flexible_work_groups;
+    struct sh_tune tune;
     enum pl_sampler_type sampler_type;
     char sampler_prefix;
     int fresh;
@@ -72,6 +100,15 @@ struct pl_glsl_desc sh_glsl(const struct pl_shader *sh);
 // Attempt enabling compute shaders for this pass, if possible
 bool sh_try_compute(struct pl_shader *sh, int bw, int bh, bool flex, size_t mem);
 
+// Picks the work group size for a compute shader whose code depends on it, so
+// it can't be changed after the fact like flexible work group sizes can.
+// `sizes` lists the candidate sizes, starting with the default, and `key`
+// identifies the kind of shader (i.e. everything the best size may depend on).
+// If the shader's dispatch has autotuning enabled, this cycles through the
+// candidates until the fastest is known. Otherwise, returns the default.
+void sh_tune_group_size(struct pl_shader *sh, uint64_t key,
+                        const int (*sizes)[2], int num_sizes, int out[2]);
+
 // Attempt merging a secondary shader into the current shader. Returns NULL if
 // merging fails (e.g. incompatible signatures); otherwise returns an identifier
 // corresponding to the generated subpass function.
@@ -182,6 +219,38 @@ enum sh_lut_method {
     SH_LUT_LINEAR,   // upload as linearly-sampleable texture
 };
 
+struct sh_lut_params {
+    struct pl_shader_obj **object;
+    enum sh_lut_method method;
+    int width, height, depth, comps;
+
+    // Forces the LUT to be recomputed, e.g. because its contents changed
+    bool update;
+
+    // If true, texture-based LUTs are stored as half floats where supported,
+    // halving the texture bandwidth. Only suitable for values which don't
+    // need more than ~3 significant decimal digits, e.g. filter weights.
+    bool fp16;
+
+    // If set to true, shader objects will be preserved and updated in-place
+    // rather than being treated as read-only.
+    bool dynamic;
+
+    // If nonzero, this uniquely identifies the contents of the LUT (for a
+    // given `fill` function and size). Texture-based LUTs with a signature
+    // are shared between all shader objects on the same `pl_gpu`, so that
+    // identical LUTs only get computed and uploaded once. Changing the
+    // signature implies `update`. Ignored for `dynamic` LUTs.
+    uint64_t signature;
+
+    // The `fill` function will be called with a zero-initialized buffer
+    // whenever the data needs to be computed, which happens whenever the size
+    // is changed, the shader object is invalidated, or `update` is set to
+    // true.
+    void *priv;
+    void (*fill)(void *priv, float *data, int w, int h, int d);
+};
+
 // Makes a table of float vecs values available as a shader variable, using an
 // a given method (falling back if needed). The resulting identifier can be
 // sampled directly as %s(pos), where pos is a vector with the right number of
@@ -192,23 +261,34 @@ enum sh_lut_method {
 // This function also acts as `sh_require_obj`, and uses the `buf`, `tex`
 // and `text` fields of the resulting `obj`. (The other fields may be used by
 // the caller)
-//
-// The `fill` function will be called with a zero-initialized buffer whenever
-// the data needs to be computed, which happens whenever the size is changed,
-// the shader object is invalidated, or `update` is set to true.
-//
-// If `dynamic` is set to true, shader objects will be preserved and updated
-// in-place rather than being treated as read-only.
-ident_t sh_lut(struct pl_shader *sh, struct pl_shader_obj **obj,
-               enum sh_lut_method method, int width, int height, int depth,
-               int components, bool update, bool dynamic, void *priv,
-               void (*fill)(void *priv, float *data, int w, int h, int d));
+ident_t sh_lut(struct pl_shader *sh, const struct sh_lut_params *params);
+
+// Generates a function `vec4 name(vec3 pos)` which samples a 4-component 3D
+// LUT (as returned by `sh_lut`, with any method other than `SH_LUT_LINEAR`) of
+// the given dimensions using tetrahedral interpolation, for `pos` in the range
+// [0, 1]. This only needs four (nearest neighbour) lookups, and is more
+// accurate than trilinear interpolation at the same LUT size.
+ident_t sh_lut_tetrahedral(struct pl_shader *sh, ident_t lut, const int size[3]);
+
+// Frees the `pl_gpu`'s shared LUT cache. Called by `pl_gpu_destroy`.
+void sh_lut_cache_destroy(const struct pl_gpu *gpu);
 
 // Returns a GLSL-version appropriate "bvec"-like type. For GLSL 130+, this
 // returns bvecN. For GLSL 120, this returns vecN instead. The intended use of
 // this function is with mix(), which only accepts bvec in GLSL 130+.
 const char *sh_bvec(const struct pl_shader *sh, int dims);
 
+// Returns the precision qualifier to use for intermediate values which can
+// safely be computed at reduced precision (e.g. filter weights), including
+// the trailing space. Returns "" unless reduced precision was requested.
+static inline const char *sh_prec(const struct pl_shader *sh)
+{
+    struct pl_glsl_desc glsl = sh_glsl(sh);
+    if (!SH_PARAMS(sh).reduced_precision || !glsl.float16)
+        return "";
+    return (glsl.gles || glsl.version >= 130) ? "mediump " : "";
+}
+
 // Returns the appropriate `texture`-equivalent function for the shader and
 // given texture.
 static inline const char *sh_tex_fn(const struct pl_shader *sh,
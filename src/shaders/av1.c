@@ -512,9 +512,30 @@ static void sample(struct pl_shader *sh, enum offset off, enum pl_channel c,
          channel_names[c], GRAIN_WIDTH_LUT >> sub_x);
 }
 
+// Number of generated grain buffers kept around per shader object
+#define GRAIN_CACHE_SIZE 4
+
+// The subset of the grain parameters which affects the SSBO contents
+struct grain_cache_key {
+    uint16_t grain_seed;
+    int num_points_y;
+    int ar_coeff_lag;
+    int8_t ar_coeffs_y[24];
+    int8_t ar_coeffs_uv[2][25];
+    int ar_coeff_shift;
+    int grain_scale_shift;
+    int bit_depth;
+    int offsets_x, offsets_y; // only if the offsets are stored in the SSBO
+};
+
+struct grain_cache_entry {
+    struct grain_cache_key key;
+    const struct pl_buf *ssbo;
+    uint64_t last_use;
+};
+
 struct sh_grain_obj {
     // SSBO state and layout
-    struct pl_buf_pool ssbos;
     struct pl_shader_desc desc;
     struct pl_var_layout layout_y;
     struct pl_var_layout layout_cb;
@@ -525,13 +546,19 @@ struct sh_grain_obj {
     // LUT objects for the scaling luts
     struct pl_shader_obj *scaling[3];
 
+    // Cache of previously generated SSBOs, all sharing the current layout
+    struct grain_cache_entry cache[GRAIN_CACHE_SIZE];
+    uint64_t cache_clock;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+
     // Previous parameters used to check reusability
     bool fg_has_y, fg_has_u, fg_has_v;
+    bool gpu_offsets;
     int offsets_x, offsets_y;
     int sub_x, sub_y;
     int lut_size;
     struct pl_av1_grain_data data;
-    struct pl_color_repr repr;
 
     // Space to store the temporary arrays, reused
     uint32_t *offsets;
@@ -540,10 +567,44 @@ struct sh_grain_obj {
     int16_t grain_tmp_uv[GRAIN_HEIGHT][GRAIN_WIDTH];
 };
 
+static void grain_cache_flush(const struct pl_gpu *gpu, struct sh_grain_obj *obj)
+{
+    for (int i = 0; i < GRAIN_CACHE_SIZE; i++) {
+        pl_buf_destroy(gpu, &obj->cache[i].ssbo);
+        obj->cache[i] = (struct grain_cache_entry) {0};
+    }
+}
+
+// Returns the entry matching `key`, or the least recently used entry (with
+// `ssbo` possibly NULL) if there is none. In the latter case, `*hit` is false.
+static struct grain_cache_entry *grain_cache_get(struct sh_grain_obj *obj,
+                                                 const struct grain_cache_key *key,
+                                                 bool *hit)
+{
+    struct grain_cache_entry *lru = &obj->cache[0];
+    for (int i = 0; i < GRAIN_CACHE_SIZE; i++) {
+        struct grain_cache_entry *e = &obj->cache[i];
+        if (e->ssbo && memcmp(&e->key, key, sizeof(*key)) == 0) {
+            *hit = true;
+            return e;
+        }
+        if (!e->ssbo || (lru->ssbo && e->last_use < lru->last_use))
+            lru = e;
+    }
+
+    *hit = false;
+    return lru;
+}
+
 static void sh_grain_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_grain_obj *obj = ptr;
-    pl_buf_pool_uninit(gpu, &obj->ssbos);
+    if (obj->cache_hits || obj->cache_misses) {
+        PL_DEBUG(gpu, "AV1 grain cache: %"PRIu64" hits, %"PRIu64" misses",
+                 obj->cache_hits, obj->cache_misses);
+    }
+
+    grain_cache_flush(gpu, obj);
     for (int i = 0; i < 3; i++)
         pl_shader_obj_destroy(&obj->scaling[i]);
     *obj = (struct sh_grain_obj) {0};
@@ -664,7 +725,12 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
 
     int bw = BLOCK_SIZE >> sub_x;
     int bh = BLOCK_SIZE >> sub_y;
-    bool is_compute = sh_try_compute(sh, bw, bh, false, 0);
+    bool is_compute = sh_try_compute(sh, bw, bh, false, sizeof(uint32_t[2]));
+
+    // In compute shaders, the block offsets are generated directly on the GPU
+    // (once per work group), which avoids having to regenerate and re-upload
+    // a resolution-dependent table every time the grain seed changes
+    bool gpu_offsets = is_compute;
 
     struct sh_grain_obj *obj;
     obj = SH_OBJ(sh, grain_state, PL_SHADER_OBJ_AV1_GRAIN,
@@ -676,22 +742,14 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
     int offsets_y = PL_ALIGN2(tex_h << sub_y, 128) / 32;
     int lut_size = (GRAIN_WIDTH_LUT >> sub_x) * (GRAIN_HEIGHT_LUT >> sub_y);
 
-    // Note: In theory we could check only the parameters related to luma or
-    // only related to chroma and skip updating for changes to irrelevant
-    // parts, but this is probably not worth it since the grain_seed is
-    // expected to change per frame anyway.
-    bool needs_update = memcmp(data, &obj->data, sizeof(*data)) != 0 ||
-                        !pl_color_repr_equal(params->repr, &obj->repr) ||
-                        offsets_x != obj->offsets_x ||
-                        offsets_y != obj->offsets_y ||
-                        sub_x != obj->sub_x ||
-                        sub_y != obj->sub_y;
-
     if (offsets_x * offsets_y != obj->offsets_x * obj->offsets_y ||
         lut_size != obj->lut_size ||
+        sub_x != obj->sub_x ||
+        sub_y != obj->sub_y ||
         fg_has_y != obj->fg_has_y ||
         fg_has_u != obj->fg_has_u ||
-        fg_has_v != obj->fg_has_v)
+        fg_has_v != obj->fg_has_v ||
+        gpu_offsets != obj->gpu_offsets)
     {
         // (Re-)generate the SSBO layout
         PL_DEBUG(sh, "Recreating av1 grain buffer due to layout mismatch");
@@ -732,10 +790,12 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
                                      &obj->layout_cr, grain_cr);
         }
 
-        struct pl_var offsets = pl_var_uint("offsets");
-        offsets.dim_a = offsets_x * offsets_y;
-        ok &= sh_buf_desc_append(obj->tmp, gpu, &obj->desc,
-                                 &obj->layout_off, offsets);
+        if (!gpu_offsets) {
+            struct pl_var offsets = pl_var_uint("offsets");
+            offsets.dim_a = offsets_x * offsets_y;
+            ok &= sh_buf_desc_append(obj->tmp, gpu, &obj->desc,
+                                     &obj->layout_off, offsets);
+        }
 
         if (!ok) {
             PL_ERR(sh, "Failed generating SSBO buffer placement: Either GPU "
@@ -743,33 +803,68 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
             return false;
         }
 
-        TARRAY_GROW(obj, obj->offsets, offsets_x * offsets_y);
-        needs_update = true;
+        if (!gpu_offsets)
+            TARRAY_GROW(obj, obj->offsets, offsets_x * offsets_y);
+
+        // All cached buffers use the old layout, so get rid of them
+        grain_cache_flush(gpu, obj);
+        obj->sub_x = sub_x;
+        obj->sub_y = sub_y;
+        obj->offsets_x = offsets_x;
+        obj->offsets_y = offsets_y;
+        obj->fg_has_y = fg_has_y;
+        obj->fg_has_u = fg_has_u;
+        obj->fg_has_v = fg_has_v;
+        obj->gpu_offsets = gpu_offsets;
+        obj->lut_size = lut_size;
     }
 
-    const struct pl_buf *ssbo;
-    if (obj->desc.object && !needs_update) {
-        ssbo = obj->desc.object;
+    // Streams commonly cycle through a small set of grain parameters, so
+    // look up the generated buffer in the cache before regenerating it
+    struct grain_cache_key key;
+    memset(&key, 0, sizeof(key)); // ensure padding is zeroed for memcmp
+    key.grain_seed = data->grain_seed;
+    key.num_points_y = data->num_points_y;
+    key.ar_coeff_lag = data->ar_coeff_lag;
+    memcpy(key.ar_coeffs_y, data->ar_coeffs_y, sizeof(key.ar_coeffs_y));
+    memcpy(key.ar_coeffs_uv, data->ar_coeffs_uv, sizeof(key.ar_coeffs_uv));
+    key.ar_coeff_shift = data->ar_coeff_shift;
+    key.grain_scale_shift = data->grain_scale_shift;
+    key.bit_depth = PL_DEF(params->repr->bits.color_depth, 8);
+    if (!gpu_offsets) {
+        key.offsets_x = offsets_x;
+        key.offsets_y = offsets_y;
+    }
+
+    bool hit;
+    struct grain_cache_entry *entry = grain_cache_get(obj, &key, &hit);
+    entry->last_use = ++obj->cache_clock;
+
+    if (hit) {
+        obj->cache_hits++;
     } else {
-        needs_update = true;
+        obj->cache_misses++;
 
-        // Get the next free SSBO buffer, regenerate if necessary
-        struct pl_buf_params ssbo_params = {
-            .type = PL_BUF_STORAGE,
-            .size = sh_buf_desc_size(&obj->desc),
-            .host_writable = true,
-        };
+        // Avoid stalling on a buffer that's still in use by the GPU
+        if (entry->ssbo && pl_buf_poll(gpu, entry->ssbo, 0))
+            pl_buf_destroy(gpu, &entry->ssbo);
+
+        if (!entry->ssbo) {
+            entry->ssbo = pl_buf_create(gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_STORAGE,
+                .size = sh_buf_desc_size(&obj->desc),
+                .host_writable = true,
+            });
+        }
 
-        ssbo = pl_buf_pool_get(gpu, &obj->ssbos, &ssbo_params);
-        if (!ssbo) {
-            SH_FAIL(sh, "Failed creating/getting SSBO buffer for AV1 grain!");
+        if (!entry->ssbo) {
+            SH_FAIL(sh, "Failed creating SSBO buffer for AV1 grain!");
             return false;
         }
 
-        obj->desc.object = ssbo;
-    }
+        entry->key = key;
+        const struct pl_buf *ssbo = entry->ssbo;
 
-    if (needs_update) {
         // This is needed even for chroma
         generate_grain_y(obj->grain, obj->grain_tmp_y, params);
 
@@ -795,23 +890,16 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
                          sizeof(float) * lut_size);
         }
 
-        generate_offsets(obj->offsets, offsets_x, offsets_y, data);
-        pl_assert(obj->layout_off.stride == sizeof(uint32_t));
-        pl_buf_write(gpu, ssbo, obj->layout_off.offset, obj->offsets,
-                     (offsets_x * offsets_y) * obj->layout_off.stride);
-
-        obj->data = *data;
-        obj->sub_x = sub_x;
-        obj->sub_y = sub_y;
-        obj->offsets_x = offsets_x;
-        obj->offsets_y = offsets_y;
-        obj->fg_has_y = fg_has_y;
-        obj->fg_has_u = fg_has_u;
-        obj->fg_has_v = fg_has_v;
-        obj->lut_size = lut_size;
-        obj->repr = *params->repr;
+        if (!gpu_offsets) {
+            generate_offsets(obj->offsets, offsets_x, offsets_y, data);
+            pl_assert(obj->layout_off.stride == sizeof(uint32_t));
+            pl_buf_write(gpu, ssbo, obj->layout_off.offset, obj->offsets,
+                         (offsets_x * offsets_y) * obj->layout_off.stride);
+        }
     }
 
+    obj->desc.object = entry->ssbo;
+
     // For the scaling LUTs, we assume they'll be relatively constant
     // throughout the video so doing some extra work to avoid reinitializing
     // them constantly is probably worth it. Probably.
@@ -836,6 +924,8 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
                                   sizeof(data->points_uv[1]));
     }
 
+    obj->data = *data;
+
     ident_t scaling[3] = {0};
     for (int i = 0; i < 3; i++) {
         struct {
@@ -861,9 +951,16 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
         }
 
         if (priv.num > 0) {
-            scaling[i] = sh_lut(sh, &obj->scaling[i], SH_LUT_LINEAR,
-                                SCALING_LUT_SIZE, 0, 0, 1, scaling_changed,
-                                true, &priv, generate_scaling);
+            scaling[i] = sh_lut(sh, &(struct sh_lut_params) {
+                .object = &obj->scaling[i],
+                .method = SH_LUT_LINEAR,
+                .width = SCALING_LUT_SIZE,
+                .comps = 1,
+                .update = scaling_changed,
+                .dynamic = true,
+                .priv = &priv,
+                .fill = generate_scaling,
+            });
 
             if (!scaling[i]) {
                 SH_FAIL(sh, "Failed generating/uploading scaling LUTs!");
@@ -926,7 +1023,43 @@ bool pl_shader_av1_grain(struct pl_shader *sh,
          scale.texture_scale, tex);
 
     // Load the data vector which holds the offsets
-    GLSL("uint data = offsets[block_id.y * %du + block_id.x]; \n", offsets_x);
+    if (gpu_offsets) {
+        // Equivalent to `generate_offsets`. The first two invocations of each
+        // work group generate the current and previous row, respectively,
+        // and each keeps track of both the current and the previous column.
+        ident_t seed = sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_uint("seed"),
+            .data = &(unsigned int) { data->grain_seed },
+            .dynamic = true,
+        });
+
+        ident_t rows = sh_fresh(sh, "rows");
+        GLSLH("shared uint %s[2]; \n", rows);
+        GLSL("if (local_id.x < 2u && local_id.y == 0u) {                     \n"
+             "    uint res = 0u;                                             \n"
+             "    if (local_id.x == 0u || block_id.y > 0u) {                 \n"
+             "        uint y = block_id.y - local_id.x;                      \n"
+             "        uint state = %s ^ (((y * 37u + 178u) & 0xFFu) << 8)    \n"
+             "                        ^ ((y * 173u + 105u) & 0xFFu);         \n"
+             "        uint prev = 0u, cur = 0u;                              \n"
+             "        for (uint x = 0u; x <= block_id.x; x++) {              \n"
+             "            uint bit = state ^ (state >> 1) ^ (state >> 3)     \n"
+             "                             ^ (state >> 12);                  \n"
+             "            state = (state >> 1) | ((bit & 1u) << 15);         \n"
+             "            prev = cur;                                        \n"
+             "            cur = (state >> 8) & 0xFFu;                        \n"
+             "        }                                                      \n"
+             "        res = (prev << 8) | cur;                               \n"
+             "    }                                                          \n"
+             "    %s[local_id.x] = res;                                      \n"
+             "}                                                              \n"
+             "groupMemoryBarrier();                                          \n"
+             "barrier();                                                     \n"
+             "uint data = (%s[1] << 16) | %s[0];                             \n",
+             seed, rows, rows, rows);
+    } else {
+        GLSL("uint data = offsets[block_id.y * %du + block_id.x]; \n", offsets_x);
+    }
 
     // If we need access to the external luma plane, load it now
     if (tex_is_cb || tex_is_cr) {
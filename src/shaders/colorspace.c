@@ -584,20 +584,38 @@ const struct pl_peak_detect_params pl_peak_detect_default_params = {
     .overshoot_margin       = 0.05,
 };
 
+// Fully describes a (static) tone mapping curve, for baking it into a LUT
+struct tone_map_curve {
+    enum pl_tone_mapping_algorithm algo;
+    float param;
+    float peak;      // signal peak, after normalization and slope
+    float dst_range; // target peak, without normalization (for BT.2390)
+};
+
 struct sh_peak_obj {
     const struct pl_gpu *gpu;
     const struct pl_buf *buf;
     struct pl_shader_desc desc;
     float margin;
+
+    // Tone mapping LUT, stored here since it shares the lifetime
+    struct pl_shader_obj *tone_map_lut;
+    struct tone_map_curve curve;
 };
 
 static void sh_peak_uninit(const struct pl_gpu *gpu, void *ptr)
 {
     struct sh_peak_obj *obj = ptr;
     pl_buf_destroy(obj->gpu, &obj->buf);
+    pl_shader_obj_destroy(&obj->tone_map_lut);
     *obj = (struct sh_peak_obj) {0};
 }
 
+// Number of independent global accumulators. Work groups are distributed
+// among these to reduce contention on the global atomics, and the partial
+// results get combined by the last work group to finish.
+#define PEAK_SLOTS 16
+
 static inline float iir_coeff(float rate)
 {
     float a = 1.0 - cos(1.0 / rate);
@@ -613,7 +631,8 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     if (!sh_require(sh, PL_SHADER_SIG_COLOR, 0, 0))
         return false;
 
-    if (!sh_try_compute(sh, 8, 8, true, 2 * sizeof(int32_t))) {
+    // Prefer larger work groups, to reduce the number of global atomics
+    if (!sh_try_compute(sh, 16, 16, true, 2 * sizeof(int32_t))) {
         PL_ERR(sh, "HDR peak detection requires compute shaders!");
         return false;
     }
@@ -644,8 +663,11 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
 
         bool ok = true;
         ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_vec2("average"));
-        ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_int("frame_sum"));
-        ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_int("frame_max"));
+        struct pl_var frame_sum = pl_var_int("frame_sum");
+        struct pl_var frame_max = pl_var_int("frame_max");
+        frame_sum.dim_a = frame_max.dim_a = PEAK_SLOTS;
+        ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, frame_sum);
+        ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, frame_max);
         ok &= sh_buf_desc_append(obj, gpu, &obj->desc, NULL, pl_var_uint("counter"));
 
         if (!ok) {
@@ -684,48 +706,91 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     pl_shader_ootf(sh, csp);
 
     // For performance, we want to do as few atomic operations on global
-    // memory as possible, so use an atomic in shmem for the work group.
-    ident_t wg_sum = sh_fresh(sh, "wg_sum"), wg_max = sh_fresh(sh, "wg_max");
+    // memory as possible, so first reduce the values within each work group.
+    // Where supported, this is done in two levels: first inside each
+    // subgroup, then by one invocation per subgroup using atomics in shmem.
+    ident_t wg_sum = sh_fresh(sh, "wg_sum"), wg_max = sh_fresh(sh, "wg_max"),
+            wg_num = sh_fresh(sh, "wg_num"), valid = sh_fresh(sh, "valid");
     GLSLH("shared int %s;   \n", wg_sum);
     GLSLH("shared int %s;   \n", wg_max);
-    GLSL("%s = 0; %s = 0;   \n"
-         "barrier();        \n",
-         wg_sum, wg_max);
+    GLSLH("shared int %s;   \n", wg_num);
+    GLSL("%s = 0; %s = 0; %s = 0; \n"
+         "barrier();              \n",
+         wg_sum, wg_max, wg_num);
+
+    // Work groups may extend past the edge of the image, in which case the
+    // excess invocations must not contribute to the result. These still need
+    // to reach the barriers, so they only skip the reduction itself.
+    GLSL("#ifdef frag_valid                             \n"
+         "bool %s = frag_valid(gl_GlobalInvocationID);  \n"
+         "#else                                         \n"
+         "bool %s = true;                               \n"
+         "#endif                                        \n"
+         "if (%s) {                                     \n",
+         valid, valid, valid);
 
     // Chosen to avoid overflowing on an 8K buffer
     const float log_min = 1e-3, log_scale = 400.0, sig_scale = 10000.0;
 
-    // Have each thread update the work group sum with the local value
     GLSL("float sig_max = max(max(color.r, color.g), color.b);  \n"
          "float sig_log = log(max(sig_max, %f));                \n"
-         "atomicAdd(%s, int(sig_log * %f));                     \n"
-         "atomicMax(%s, int(sig_max * %f));                     \n"
-         "memoryBarrierShared();                                \n"
-         "barrier();                                            \n"
-         "color = color_orig;                                   \n"
-         "}                                                     \n",
-         log_min,
-         wg_sum, log_scale,
-         wg_max, sig_scale);
+         "int cur_sum = int(sig_log * %f);                      \n"
+         "int cur_max = int(sig_max * %f);                      \n"
+         "int cur_num = 1;                                      \n",
+         log_min, log_scale, sig_scale);
+
+    bool subgroups = SH_GPU(sh)->glsl.subgroup_size > 0;
+    if (subgroups) {
+        GLSL("cur_sum = subgroupAdd(cur_sum);   \n"
+             "cur_max = subgroupMax(cur_max);   \n"
+             "cur_num = subgroupAdd(cur_num);   \n"
+             "if (subgroupElect()) {            \n");
+    }
+
+    // Have each thread (or subgroup) update the work group sum
+    GLSL("atomicAdd(%s, cur_sum);   \n"
+         "atomicMax(%s, cur_max);   \n"
+         "atomicAdd(%s, cur_num);   \n",
+         wg_sum, wg_max, wg_num);
+
+    if (subgroups)
+        GLSL("}\n");
+
+    GLSL("}                         \n"
+         "memoryBarrierShared();    \n"
+         "barrier();                \n"
+         "color = color_orig;       \n"
+         "}                         \n");
 
     // Have one thread per work group update the global atomics. Do this
     // at the end of the shader to avoid clobbering `average`, in case the
-    // state object will be used by the same pass.
+    // state object will be used by the same pass. Only the invocations which
+    // actually contributed count towards the work group average.
     GLSLF("if (gl_LocalInvocationIndex == 0u) {                                 \n"
-          "    int wg_avg = %s / int(gl_WorkGroupSize.x * gl_WorkGroupSize.y);  \n"
-          "    atomicAdd(frame_sum, wg_avg);                                    \n"
-          "    atomicMax(frame_max, %s);                                        \n"
-          "    memoryBarrierBuffer();                                           \n"
-          "    barrier();                                                       \n",
-          wg_sum, wg_max);
-
-    // Finally, to update the global state per dispatch, we increment a counter
+          "    int wg_avg = %s / max(%s, 1);                                    \n"
+          "    uint wg_idx = gl_WorkGroupID.y * gl_NumWorkGroups.x +            \n"
+          "                  gl_WorkGroupID.x;                                  \n"
+          "    uint slot = wg_idx %% %du;                                        \n"
+          "    atomicAdd(frame_sum[slot], wg_avg);                              \n"
+          "    atomicMax(frame_max[slot], %s);                                  \n"
+          "    memoryBarrierBuffer();                                           \n",
+          wg_sum, wg_num, PEAK_SLOTS, wg_max);
+
+    // Finally, to update the global state per dispatch, we increment a
+    // counter. The last work group to finish combines the partial results.
     GLSLF("    uint num_wg = gl_NumWorkGroups.x * gl_NumWorkGroups.y;           \n"
           "    if (atomicAdd(counter, 1u) == num_wg - 1u) {                     \n"
-          "        vec2 cur = vec2(float(frame_sum) / float(num_wg), frame_max);\n"
+          "        int total_sum = 0, total_max = 0;                            \n"
+          "        for (int i = 0; i < %d; i++) {                               \n"
+          "            total_sum += frame_sum[i];                               \n"
+          "            total_max = max(total_max, frame_max[i]);                \n"
+          "            frame_sum[i] = 0;                                        \n"
+          "            frame_max[i] = 0;                                        \n"
+          "        }                                                            \n"
+          "        vec2 cur = vec2(float(total_sum) / float(num_wg), total_max);\n"
           "        cur *= vec2(1.0 / %f, 1.0 / %f);                             \n"
           "        cur.x = exp(cur.x);                                          \n",
-          log_scale, sig_scale);
+          PEAK_SLOTS, log_scale, sig_scale);
 
     // Set the initial value accordingly if it contains no data
     GLSLF("        if (average.y == 0.0) \n"
@@ -745,9 +810,7 @@ bool pl_shader_detect_peak(struct pl_shader *sh,
     }
 
     // Reset SSBO state for the next frame
-    GLSLF("        frame_sum = 0;            \n"
-          "        frame_max = 0;            \n"
-          "        counter = 0u;             \n"
+    GLSLF("        counter = 0u;             \n"
           "        memoryBarrierBuffer();    \n"
           "    }                             \n"
           "}                                 \n");
@@ -764,6 +827,89 @@ static inline float pq_delinearize(float x)
     return x;
 }
 
+static inline float pq_linearize(float x)
+{
+    x = powf(x, 1.0 / PQ_M2);
+    x = fmaxf(x - PQ_C1, 0.0) / (PQ_C2 - PQ_C3 * x);
+    x = powf(x, 1.0 / PQ_M1);
+    x *= 10000.0 / PL_COLOR_SDR_WHITE;
+    return x;
+}
+
+static inline float hable(float x)
+{
+    const float A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+    return (x * (A*x + C*B) + D*E) / (x * (A*x + B) + D*F) - E/F;
+}
+
+// CPU equivalent of the per-channel tone mapping curves in `pl_shader_tone_map`
+static float tone_map_curve_eval(const struct tone_map_curve *c, float sig)
+{
+    float peak = c->peak, param = c->param;
+    switch (c->algo) {
+    case PL_TONE_MAPPING_CLIP:
+        return sig * PL_DEF(param, 1.0);
+
+    case PL_TONE_MAPPING_MOBIUS: {
+        float j = PL_DEF(param, 0.3);
+        if (peak <= 1.0 + 1e-6 || sig <= j)
+            return sig;
+        float a = -j*j * (peak - 1.0) / (j*j - 2.0*j + peak),
+              b = (j*j - 2.0*j*peak + peak) / fmaxf(1e-6, peak - 1.0),
+              scale = (b*b + 2.0*b*j + j*j) / (b-a);
+        return scale * (sig + a) / (sig + b);
+    }
+
+    case PL_TONE_MAPPING_REINHARD: {
+        float contrast = PL_DEF(param, 0.5),
+              offset = (1.0 - contrast) / contrast;
+        return sig / (sig + offset) * (peak + offset) / peak;
+    }
+
+    case PL_TONE_MAPPING_HABLE:
+        return hable(sig) / hable(peak);
+
+    case PL_TONE_MAPPING_GAMMA: {
+        const float cutoff = 0.05, gamma = 1.0 / PL_DEF(param, 1.8);
+        if (sig > cutoff)
+            return powf(sig / peak, gamma);
+        return powf(cutoff / peak, gamma) / cutoff * sig;
+    }
+
+    case PL_TONE_MAPPING_LINEAR:
+        return sig * PL_DEF(param, 1.0) / peak;
+
+    case PL_TONE_MAPPING_BT_2390: {
+        float peak_pq = pq_delinearize(peak),
+              scale = 1.0 / peak_pq,
+              sig_pq = pq_delinearize(sig) * scale,
+              maxLum = pq_delinearize(c->dst_range) * scale,
+              ks = 1.5 * maxLum - 0.5;
+        if (sig_pq >= ks) {
+            float tb = (sig_pq - ks) / (1.0 - ks),
+                  tb2 = tb * tb,
+                  tb3 = tb2 * tb;
+            sig_pq = (2.0 * tb3 - 3.0 * tb2 + 1.0) * ks +
+                     (tb3 - 2.0 * tb2 + tb) * (1.0 - ks) +
+                     (-2.0 * tb3 + 3.0 * tb2) * maxLum;
+        }
+        return pq_linearize(sig_pq * peak_pq);
+    }
+
+    default: abort();
+    }
+}
+
+// The LUT is indexed by sqrt(sig / peak), for more precision near black
+static void fill_tone_map_lut(void *priv, float *data, int w, int h, int d)
+{
+    const struct tone_map_curve *c = priv;
+    for (int i = 0; i < w; i++) {
+        float x = (float) i / (w - 1);
+        data[i] = tone_map_curve_eval(c, c->peak * x * x);
+    }
+}
+
 const struct pl_color_map_params pl_color_map_default_params = {
     .intent                 = PL_INTENT_RELATIVE_COLORIMETRIC,
     .tone_mapping_algo      = PL_TONE_MAPPING_BT_2390,
@@ -792,11 +938,13 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
          src.sig_avg * src.sig_scale);
 
     // Update the variables based on values from the peak detection buffer
+    struct sh_peak_obj *obj = NULL;
+    bool dynamic_peak = false;
     if (peak_detect_state) {
-        struct sh_peak_obj *obj;
         obj = SH_OBJ(sh, peak_detect_state, PL_SHADER_OBJ_PEAK_DETECT,
                      struct sh_peak_obj, sh_peak_uninit);
         if (obj && obj->buf) {
+            dynamic_peak = true;
             obj->desc.desc.access = PL_DESC_ACCESS_READONLY;
             obj->desc.memory = 0;
             sh_desc(sh, obj->desc);
@@ -835,8 +983,54 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
          "sig_peak *= slope;                   \n",
          PL_DEF(params->max_boost, 1.0), dst.sig_avg * dst.sig_scale);
 
+    // Bake the curve into a LUT if possible, which only works as long as all
+    // of its parameters are known ahead of time
+    ident_t lut = NULL;
+    int lut_size = params->tone_mapping_lut_size;
+    if (lut_size > 0 && obj && !dynamic_peak) {
+        const struct pl_gpu *gpu = SH_GPU(sh);
+        enum pl_fmt_caps caps = PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_LINEAR;
+        if (gpu && pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32, caps)) {
+            float sig_peak = src.sig_peak * src.sig_scale,
+                  sig_avg = src.sig_avg * src.sig_scale;
+            if (dst_range > 1.0 && need_norm)
+                sig_peak /= dst_range;
+            sig_peak *= PL_MIN(PL_DEF(params->max_boost, 1.0),
+                               dst.sig_avg * dst.sig_scale / sig_avg);
+
+            obj->curve = (struct tone_map_curve) {
+                .algo = params->tone_mapping_algo,
+                .param = params->tone_mapping_param,
+                .peak = sig_peak,
+                .dst_range = dst_range,
+            };
+
+            lut = sh_lut(sh, &(struct sh_lut_params) {
+                .object = &obj->tone_map_lut,
+                .method = SH_LUT_LINEAR,
+                .width = lut_size,
+                .comps = 1,
+                .signature = siphash64((const uint8_t *) &obj->curve,
+                                       sizeof(obj->curve)),
+                .priv = &obj->curve,
+                .fill = fill_tone_map_lut,
+            });
+        } else {
+            PL_TRACE(sh, "No linear float texture format, not using a LUT "
+                     "for tone mapping");
+        }
+    }
+
+    if (lut) {
+        GLSL("vec3 lut_pos = sqrt(clamp(sig * vec3(1.0 / %f), 0.0, 1.0)); \n"
+             "sig = vec3(%s(lut_pos.r), %s(lut_pos.g), %s(lut_pos.b));   \n",
+             obj->curve.peak, lut, lut, lut);
+        goto tone_mapped;
+    }
+
     float param = params->tone_mapping_param;
     switch (params->tone_mapping_algo) {
+
     case PL_TONE_MAPPING_CLIP:
         GLSL("sig *= %f;\n", PL_DEF(param, 1.0));
         break;
@@ -936,6 +1130,7 @@ static void pl_shader_tone_map(struct pl_shader *sh, struct pl_color_space src,
         abort();
     }
 
+tone_mapped:
     GLSL("sig = min(sig, 1.01);                                         \n"
          "vec3 sig_lin = sig_orig * (sig[sig_idx] / sig_orig[sig_idx]); \n");
 
@@ -1143,7 +1338,8 @@ void pl_shader_dither(struct pl_shader *sh, int new_depth,
 
     GLSL("// pl_shader_dither \n"
         "{                    \n"
-        "float bias;          \n");
+        "%sfloat bias;        \n",
+        sh_prec(sh));
 
     params = PL_DEF(params, &pl_dither_default_params);
     if (params->lut_size < 0 || params->lut_size > 8) {
@@ -1179,8 +1375,19 @@ void pl_shader_dither(struct pl_shader *sh, int new_depth,
         obj->method = method;
 
         lut_size = 1 << PL_DEF(params->lut_size, 6);
-        lut = sh_lut(sh, &obj->lut, SH_LUT_AUTO, lut_size, lut_size, 0, 1,
-                     changed, false, obj, fill_dither_matrix);
+        // The dither matrix only depends on the method and size, so it can be
+        // shared between all dither states
+        lut = sh_lut(sh, &(struct sh_lut_params) {
+            .object = &obj->lut,
+            .method = SH_LUT_AUTO,
+            .width = lut_size,
+            .height = lut_size,
+            .comps = 1,
+            .update = changed,
+            .signature = method + 1,
+            .priv = obj,
+            .fill = fill_dither_matrix,
+        });
         if (!lut)
             goto fallback;
     }
@@ -1271,7 +1478,7 @@ const struct pl_dither_params pl_dither_default_params = {
 
 struct sh_3dlut_obj {
     struct pl_context *ctx;
-    enum pl_rendering_intent intent;
+    struct pl_3dlut_params params;
     struct pl_3dlut_profile src, dst;
     struct pl_3dlut_result result;
     struct pl_shader_obj *lut_obj;
@@ -1292,7 +1499,7 @@ static void fill_3dlut(void *priv, float *data, int s_r, int s_g, int s_b)
     struct sh_3dlut_obj *obj = priv;
     struct pl_context *ctx = obj->ctx;
 
-    obj->ok = pl_lcms_compute_lut(ctx, obj->intent, obj->src, obj->dst,
+    obj->ok = pl_lcms_compute_lut(ctx, &obj->params, obj->src, obj->dst,
                                   data, s_r, s_g, s_b, &obj->result);
 
     if (!obj->ok)
@@ -1313,9 +1520,11 @@ bool pl_3dlut_update(struct pl_shader *sh,
                      const struct pl_3dlut_params *params)
 {
     params = PL_DEF(params, &pl_3dlut_default_params);
-    size_t s_r = PL_DEF(params->size_r, 64),
-           s_g = PL_DEF(params->size_g, 64),
-           s_b = PL_DEF(params->size_b, 64);
+    bool tetrahedral = params->tetrahedral && sh_glsl(sh).version >= 130;
+    size_t def_size = tetrahedral ? 33 : 64;
+    size_t s_r = PL_DEF(params->size_r, def_size),
+           s_g = PL_DEF(params->size_g, def_size),
+           s_b = PL_DEF(params->size_b, def_size);
 
     struct sh_3dlut_obj *obj;
     obj = SH_OBJ(sh, lut3d, PL_SHADER_OBJ_3DLUT,
@@ -1325,18 +1534,33 @@ bool pl_3dlut_update(struct pl_shader *sh,
 
     bool changed = !color_profile_eq(&obj->src, src) ||
                    !color_profile_eq(&obj->dst, dst) ||
-                   obj->intent != params->intent;
+                   obj->params.intent != params->intent;
 
     // Update the object, since we need this information from `fill_3dlut`
     obj->ctx = sh->ctx;
-    obj->intent = params->intent;
+    obj->params = *params;
     obj->src = *src;
     obj->dst = *dst;
-    obj->lut = sh_lut(sh, &obj->lut_obj, SH_LUT_LINEAR, s_r, s_g, s_b, 4,
-                      changed, false, obj, fill_3dlut);
+    obj->lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut_obj,
+        .method = tetrahedral ? SH_LUT_TEXTURE : SH_LUT_LINEAR,
+        .width = s_r,
+        .height = s_g,
+        .depth = s_b,
+        .comps = 4,
+        .update = changed,
+        .priv = obj,
+        .fill = fill_3dlut,
+    });
     if (!obj->lut || !obj->ok)
         return false;
 
+    // Both variants are sampled as `vec4 lut(vec3 pos)`
+    if (tetrahedral) {
+        obj->lut = sh_lut_tetrahedral(sh, obj->lut,
+                                      (int[3]) { s_r, s_g, s_b });
+    }
+
     obj->updated = true;
     *out = obj->result;
     return true;
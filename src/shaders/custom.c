@@ -23,6 +23,7 @@
 #define SHADER_MAX_HOOKS 16
 #define SHADER_MAX_BINDS 16
 #define MAX_SZEXP_SIZE 32
+#define MAX_SZEXP_VARS (3 * MAX_SZEXP_SIZE)
 
 enum szexp_op {
     SZEXP_OP_ADD,
@@ -50,6 +51,10 @@ struct szexp {
         struct bstr varname;
         enum szexp_op op;
     } val;
+
+    // For SZEXP_VAR_*, the index into the list of textures referenced by
+    // this pass (see `hook_pass.vars`), resolved after parsing
+    int var;
 };
 
 struct custom_shader_hook {
@@ -131,12 +136,12 @@ static bool parse_rpn_szexpr(struct bstr line, struct szexp out[MAX_SZEXP_SIZE])
     return true;
 }
 
-// Evaluate a `szexp`, given a lookup function for named textures
-// Returns whether successful. 'result' is left untouched on failure
-static bool pl_eval_szexpr(struct pl_context *ctx, void *priv,
-                           bool (*lookup)(void *priv, struct bstr var, float size[2]),
+// Evaluate a `szexp`, given the sizes of all referenced textures (as indexed
+// by `szexp.var`). Returns whether successful. 'result' is left untouched on
+// failure
+static bool pl_eval_szexpr(struct pl_context *ctx,
                            const struct szexp expr[MAX_SZEXP_SIZE],
-                           float *result)
+                           const float vars[][2], float *result)
 {
     float stack[MAX_SZEXP_SIZE] = {0};
     int idx = 0; // points to next element to push
@@ -195,15 +200,7 @@ static bool pl_eval_szexpr(struct pl_context *ctx, void *priv,
 
         case SZEXP_VAR_W:
         case SZEXP_VAR_H: {
-            struct bstr name = expr[i].val.varname;
-            float size[2];
-
-            if (!lookup(priv, name, size)) {
-                pl_warn(ctx, "Variable '%.*s' not found in RPN expression!",
-                        BSTR_P(name));
-                return false;
-            }
-
+            const float *size = vars[expr[i].var];
             stack[idx++] = (expr[i].tag == SZEXP_VAR_W) ? size[0] : size[1];
             continue;
             }
@@ -651,9 +648,40 @@ static struct bstr pl_stage_to_mp(enum pl_hook_stage stage)
     };
 }
 
+// Special texture indices, for names that don't refer to a saved texture
+enum {
+    TEX_HOOKED          = -1, // whatever stage fired the hook
+    TEX_NATIVE_CROPPED  = -2, // only valid in RPN expressions
+    TEX_OUTPUT_SIZE     = -3, // "OUTPUT" in RPN expressions (the dst_rect)
+};
+
+struct hook_bind {
+    int idx;  // index into `lut_textures` or `pass_textures`, or TEX_HOOKED
+    bool lut; // whether this refers to a LUT texture
+};
+
 struct hook_pass {
     enum pl_hook_stage exec_stages;
     struct custom_shader_hook hook;
+
+    // Texture names, resolved to indices after parsing
+    struct hook_bind binds[SHADER_MAX_BINDS];
+    int num_binds;
+    int save_idx; // index into `pass_textures`, or TEX_HOOKED
+    int vars[MAX_SZEXP_VARS]; // textures referenced by the RPN expressions
+    int num_vars;
+
+    // Saved textures whose last reader is this pass, and which can be
+    // released once it has run (by index into `pass_textures`)
+    int *release;
+    int num_release;
+
+    // Cached evaluation of the RPN expressions, which only depend on the
+    // sizes of the referenced textures
+    bool plan_valid;
+    float plan_vars[MAX_SZEXP_VARS][2];
+    bool plan_run;
+    int plan_w, plan_h;
 };
 
 struct pass_tex {
@@ -679,10 +707,13 @@ struct hook_priv {
     struct custom_shader_tex *lut_textures;
     int num_lut_textures;
 
-    // Dynamic per pass
+    // Dynamic per pass. This is indexed by texture name, as interned into
+    // `tex_names`, with unsaved textures left as {0}
     enum pl_hook_stage save_stages;
     struct pass_tex *pass_textures;
-    int num_pass_textures;
+    struct bstr *tex_names;
+    int num_tex_names;
+    int stage_tex[32]; // index into `pass_textures` for each stage bit
 
     // State for PRNG/frame count
     int frame_count;
@@ -692,52 +723,82 @@ struct hook_priv {
 static void hook_reset(void *priv)
 {
     struct hook_priv *p = priv;
-    p->num_pass_textures = 0;
+    for (int i = 0; i < p->num_tex_names; i++)
+        p->pass_textures[i] = (struct pass_tex) {0};
 }
 
-struct szexp_ctx {
-    struct hook_priv *priv;
-    const struct pl_hook_params *params;
-};
-
-static bool lookup_tex(void *priv, struct bstr var, float size[2])
+static int stage_tex_idx(const struct hook_priv *p, enum pl_hook_stage stage)
 {
-    struct szexp_ctx *ctx = priv;
-    struct hook_priv *p = ctx->priv;
-    const struct pl_hook_params *params = ctx->params;
+    pl_assert(stage);
+    return p->stage_tex[__builtin_ctz(stage)];
+}
 
-    if (bstr_equals0(var, "HOOKED")) {
+static bool lookup_tex(struct hook_priv *p, const struct pl_hook_params *params,
+                       int idx, float size[2])
+{
+    switch (idx) {
+    case TEX_HOOKED:
         pl_assert(params->tex);
         size[0] = params->tex->params.w;
         size[1] = params->tex->params.h;
         return true;
-    }
 
-    if (bstr_equals0(var, "NATIVE_CROPPED")) {
+    case TEX_NATIVE_CROPPED:
         size[0] = pl_rect_w(params->src_rect);
         size[1] = pl_rect_h(params->src_rect);
         return true;
-    }
 
-    if (bstr_equals0(var, "OUTPUT")) {
+    case TEX_OUTPUT_SIZE:
         size[0] = pl_rect_w(params->dst_rect);
         size[1] = pl_rect_h(params->dst_rect);
         return true;
     }
 
-    if (bstr_equals0(var, "MAIN"))
-        var = bstr0("MAINPRESUB");
+    const struct pl_tex *tex = p->pass_textures[idx].tex;
+    if (!tex)
+        return false;
 
-    for (int i = 0; i < p->num_pass_textures; i++) {
-        if (bstr_equals(var, p->pass_textures[i].name)) {
-            const struct pl_tex *tex = p->pass_textures[i].tex;
-            size[0] = tex->params.w;
-            size[1] = tex->params.h;
-            return true;
+    size[0] = tex->params.w;
+    size[1] = tex->params.h;
+    return true;
+}
+
+// Evaluates the execution condition and output size of a pass, reusing the
+// previous results if none of the referenced texture sizes changed
+static bool eval_pass_plan(struct hook_priv *p, struct hook_pass *pass,
+                           const struct pl_hook_params *params)
+{
+    const struct custom_shader_hook *hook = &pass->hook;
+    float vars[MAX_SZEXP_VARS][2];
+    for (int i = 0; i < pass->num_vars; i++) {
+        int idx = pass->vars[i];
+        if (!lookup_tex(p, params, idx, vars[i])) {
+            PL_WARN(p, "Variable '%.*s' not found in RPN expression!",
+                    BSTR_P(p->tex_names[idx]));
+            return false;
         }
     }
 
-    return false;
+    size_t vars_size = pass->num_vars * sizeof(vars[0]);
+    if (pass->plan_valid && memcmp(vars, pass->plan_vars, vars_size) == 0)
+        return true;
+
+    float run = 0, out_size[2] = {0};
+    if (!pl_eval_szexpr(p->ctx, hook->cond, vars, &run))
+        return false;
+
+    if (run && (!pl_eval_szexpr(p->ctx, hook->width,  vars, &out_size[0]) ||
+                !pl_eval_szexpr(p->ctx, hook->height, vars, &out_size[1])))
+    {
+        return false;
+    }
+
+    memcpy(pass->plan_vars, vars, vars_size);
+    pass->plan_run = run;
+    pass->plan_w = roundf(out_size[0]);
+    pass->plan_h = roundf(out_size[1]);
+    pass->plan_valid = true;
+    return true;
 }
 
 static double prng_step(uint64_t s[4])
@@ -792,25 +853,35 @@ static bool bind_pass_tex(struct pl_shader *sh, struct bstr name,
     return true;
 }
 
-static void save_pass_tex(struct hook_priv *p, struct pass_tex ptex)
+static void save_pass_tex(struct hook_priv *p, int idx, struct pass_tex ptex)
 {
+    pl_assert(idx >= 0 && idx < p->num_tex_names);
+    p->pass_textures[idx] = ptex;
+}
 
-    for (int i = 0; i < p->num_pass_textures; i++) {
-        if (!bstr_equals(p->pass_textures[i].name, ptex.name))
+// Hands back all textures that are no longer read after `pass`
+static void release_pass_texs(struct hook_priv *p, const struct hook_pass *pass,
+                              const struct pl_hook_params *params)
+{
+    if (!params->release_tex)
+        return;
+
+    for (int i = 0; i < pass->num_release; i++) {
+        struct pass_tex *ptex = &p->pass_textures[pass->release[i]];
+        if (!ptex->tex)
             continue;
 
-        p->pass_textures[i] = ptex;
-        return;
+        PL_TRACE(p, "Releasing texture '%.*s'", BSTR_P(ptex->name));
+        params->release_tex(params->priv, ptex->tex);
+        *ptex = (struct pass_tex) {0};
     }
-
-    // No texture with this name yet, append new one
-    TARRAY_APPEND(p->tactx, p->pass_textures, p->num_pass_textures, ptex);
 }
 
 static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *params)
 {
     struct hook_priv *p = priv;
     struct bstr stage = pl_stage_to_mp(params->stage);
+    int stage_idx = stage_tex_idx(p, params->stage);
     struct pl_hook_res res = {0};
 
     // Save the input texture if needed
@@ -826,17 +897,12 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
         };
 
         PL_TRACE(p, "Saving input texture '%.*s' for binding", BSTR_P(ptex.name));
-        save_pass_tex(p, ptex);
+        save_pass_tex(p, stage_idx, ptex);
     }
 
     struct pl_shader *sh = NULL;
-    struct szexp_ctx scope = {
-        .priv = p,
-        .params = params,
-    };
-
     for (int n = 0; n < p->num_hook_passes; n++) {
-        const struct hook_pass *pass = &p->hook_passes[n];
+        struct hook_pass *pass = &p->hook_passes[n];
         if (!(pass->exec_stages & params->stage))
             continue;
 
@@ -844,25 +910,18 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
         PL_TRACE(p, "Executing hook pass %d on stage '%.*s': %.*s",
                  n, BSTR_P(stage), BSTR_P(hook->pass_desc));
 
-        // Test for execution condition
-        float run = 0;
-        if (!pl_eval_szexpr(p->ctx, &scope, lookup_tex, hook->cond, &run))
+        // Test for execution condition and determine the output size
+        if (!eval_pass_plan(p, pass, params))
             goto error;
 
-        if (!run) {
+        if (!pass->plan_run) {
             PL_TRACE(p, "Skipping hook due to condition");
+            release_pass_texs(p, pass, params);
             continue;
         }
 
-        float out_size[2] = {0};
-        if (!pl_eval_szexpr(p->ctx, &scope, lookup_tex, hook->width,  &out_size[0]) ||
-            !pl_eval_szexpr(p->ctx, &scope, lookup_tex, hook->height, &out_size[1]))
-        {
-            goto error;
-        }
-
-        int out_w = roundf(out_size[0]),
-            out_h = roundf(out_size[1]);
+        int out_w = pass->plan_w,
+            out_h = pass->plan_h;
 
         // Generate a new texture to store the render result
         const struct pl_tex *fbo;
@@ -887,10 +946,9 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
         }
 
         // Bind all necessary input textures
-        for (int i = 0; i < PL_ARRAY_SIZE(hook->bind_tex); i++) {
+        for (int i = 0; i < pass->num_binds; i++) {
             struct bstr texname = hook->bind_tex[i];
-            if (!texname.start)
-                break;
+            struct hook_bind bind = pass->binds[i];
 
             // Convenience alias, to allow writing shaders that are oblivious
             // of the exact stage they hooked. This simply translates to
@@ -909,6 +967,7 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
 
                 // Continue with binding this, under the new name
                 texname = stage;
+                bind.idx = stage_idx;
             }
 
             // Compatibility alias, because MAIN and MAINPRESUB mean the same
@@ -929,56 +988,51 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
                 texname = bstr0("MAINPRESUB");
             }
 
-            for (int j = 0; j < p->num_lut_textures; j++) {
-                if (bstr_equals(texname, p->lut_textures[j].name)) {
-                    // Directly bind this, no need to bother with all the
-                    // `bind_pass_tex` boilerplate
-                    ident_t id = sh_desc(sh, (struct pl_shader_desc) {
-                        .desc = {
-                            .name = "hook_lut",
-                            .type = PL_DESC_SAMPLED_TEX,
-                        },
-                        .object = p->lut_textures[j].tex,
-                    });
-                    GLSLH("#define %.*s %s \n", BSTR_P(texname), id);
-                    GLSLH("#define %.*s_tex(pos) (%s(%s, pos)) \n",
-                          BSTR_P(texname),
-                          sh_tex_fn(sh, p->lut_textures[j].tex->params), id);
-                    goto next_bind;
-                }
+            if (bind.lut) {
+                // Directly bind this, no need to bother with all the
+                // `bind_pass_tex` boilerplate
+                const struct pl_tex *lut = p->lut_textures[bind.idx].tex;
+                ident_t id = sh_desc(sh, (struct pl_shader_desc) {
+                    .desc = {
+                        .name = "hook_lut",
+                        .type = PL_DESC_SAMPLED_TEX,
+                    },
+                    .object = lut,
+                });
+                GLSLH("#define %.*s %s \n", BSTR_P(texname), id);
+                GLSLH("#define %.*s_tex(pos) (%s(%s, pos)) \n",
+                      BSTR_P(texname), sh_tex_fn(sh, lut->params), id);
+                continue;
             }
 
-            for (int j = 0; j < p->num_pass_textures; j++) {
-                if (bstr_equals(texname, p->pass_textures[j].name)) {
-                    // Note: We bind the whole texture, rather than
-                    // params->rect, because user shaders in general are not
-                    // designed to handle cropped input textures.
-                    const struct pass_tex *ptex = &p->pass_textures[j];
-                    struct pl_rect2df rect = {
-                        0, 0, ptex->tex->params.w, ptex->tex->params.h,
-                    };
-
-                    if (hook->offset_align && bstr_equals(texname, stage)) {
-                        float sx = pl_rect_w(params->rect) / pl_rect_w(params->src_rect),
-                              sy = pl_rect_h(params->rect) / pl_rect_h(params->src_rect),
-                              ox = params->rect.x0 - sx * params->src_rect.x0,
-                              oy = params->rect.y0 - sy * params->src_rect.y0;
-
-                        PL_TRACE(p, "Aligning plane with ref: %f %f", ox, oy);
-                        pl_rect2df_offset(&rect, ox, oy);
-                    }
-
-                    if (!bind_pass_tex(sh, texname, &p->pass_textures[j], &rect))
-                        goto error;
-                    goto next_bind;
-                }
+            const struct pass_tex *ptex = &p->pass_textures[bind.idx];
+            if (!ptex->tex) {
+                // This is a bogus/unknown texture name, or one that was
+                // never saved
+                PL_ERR(p, "Tried binding unknown texture '%.*s'!",
+                       BSTR_P(texname));
+                goto error;
             }
 
-            // If none of the above matched, this is a bogus/unknown texture name
-            PL_ERR(p, "Tried binding unknown texture '%.*s'!", BSTR_P(texname));
-            goto error;
+            // Note: We bind the whole texture, rather than params->rect,
+            // because user shaders in general are not designed to handle
+            // cropped input textures.
+            struct pl_rect2df rect = {
+                0, 0, ptex->tex->params.w, ptex->tex->params.h,
+            };
+
+            if (hook->offset_align && bind.idx == stage_idx) {
+                float sx = pl_rect_w(params->rect) / pl_rect_w(params->src_rect),
+                      sy = pl_rect_h(params->rect) / pl_rect_h(params->src_rect),
+                      ox = params->rect.x0 - sx * params->src_rect.x0,
+                      oy = params->rect.y0 - sy * params->src_rect.y0;
 
-    next_bind: ; // outer 'continue'
+                PL_TRACE(p, "Aligning plane with ref: %f %f", ox, oy);
+                pl_rect2df_offset(&rect, ox, oy);
+            }
+
+            if (!bind_pass_tex(sh, texname, ptex, &rect))
+                goto error;
         }
 
         // Set up the input variables
@@ -1090,7 +1144,9 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
         PL_TRACE(p, "Saving output texture '%.*s' from hook execution on '%.*s'",
                  BSTR_P(ptex.name), BSTR_P(stage));
 
-        save_pass_tex(p, ptex);
+        save_pass_tex(p, pass->save_idx == TEX_HOOKED ? stage_idx : pass->save_idx,
+                      ptex);
+        release_pass_texs(p, pass, params);
 
         // Update the result object, unless we saved to a different name
         if (!hook->save_tex.start) {
@@ -1153,6 +1209,176 @@ static bool register_hook(void *priv, struct custom_shader_hook hook)
     return true;
 }
 
+// Returns the index of a texture name in `tex_names`, adding it if needed
+static int intern_tex_name(struct hook_priv *p, struct bstr name)
+{
+    for (int i = 0; i < p->num_tex_names; i++) {
+        if (bstr_equals(p->tex_names[i], name))
+            return i;
+    }
+
+    TARRAY_APPEND(p->tactx, p->tex_names, p->num_tex_names, name);
+    return p->num_tex_names - 1;
+}
+
+static void resolve_szexpr(struct hook_priv *p, struct hook_pass *pass,
+                           struct szexp expr[MAX_SZEXP_SIZE])
+{
+    for (int i = 0; i < MAX_SZEXP_SIZE; i++) {
+        if (expr[i].tag != SZEXP_VAR_W && expr[i].tag != SZEXP_VAR_H)
+            continue;
+
+        struct bstr name = expr[i].val.varname;
+        int idx;
+        if (bstr_equals0(name, "HOOKED")) {
+            idx = TEX_HOOKED;
+        } else if (bstr_equals0(name, "NATIVE_CROPPED")) {
+            idx = TEX_NATIVE_CROPPED;
+        } else if (bstr_equals0(name, "OUTPUT")) {
+            idx = TEX_OUTPUT_SIZE;
+        } else if (bstr_equals0(name, "MAIN")) {
+            idx = intern_tex_name(p, bstr0("MAINPRESUB"));
+        } else {
+            idx = intern_tex_name(p, name);
+        }
+
+        int var = 0;
+        while (var < pass->num_vars && pass->vars[var] != idx)
+            var++;
+        if (var == pass->num_vars) {
+            pl_assert(pass->num_vars < MAX_SZEXP_VARS);
+            pass->vars[pass->num_vars++] = idx;
+        }
+
+        expr[i].var = var;
+    }
+}
+
+// Resolves all texture names used by a pass to indices, so they don't need
+// to be looked up by name while executing the hook
+static void resolve_hook_pass(struct hook_priv *p, struct hook_pass *pass)
+{
+    struct custom_shader_hook *hook = &pass->hook;
+    resolve_szexpr(p, pass, hook->width);
+    resolve_szexpr(p, pass, hook->height);
+    resolve_szexpr(p, pass, hook->cond);
+
+    pass->save_idx = hook->save_tex.start ? intern_tex_name(p, hook->save_tex)
+                                          : TEX_HOOKED;
+
+    for (int i = 0; i < PL_ARRAY_SIZE(hook->bind_tex); i++) {
+        struct bstr name = hook->bind_tex[i];
+        if (!name.start)
+            break;
+
+        struct hook_bind *bind = &pass->binds[pass->num_binds++];
+        if (bstr_equals0(name, "HOOKED")) {
+            *bind = (struct hook_bind) { .idx = TEX_HOOKED };
+            continue;
+        }
+
+        if (bstr_equals0(name, "MAIN"))
+            name = bstr0("MAINPRESUB");
+
+        *bind = (struct hook_bind) { .idx = -1 };
+        for (int j = 0; j < p->num_lut_textures; j++) {
+            if (bstr_equals(name, p->lut_textures[j].name)) {
+                *bind = (struct hook_bind) { .idx = j, .lut = true };
+                break;
+            }
+        }
+
+        if (bind->idx < 0)
+            bind->idx = intern_tex_name(p, name);
+    }
+}
+
+static bool szexpr_equal(const struct szexp a[MAX_SZEXP_SIZE],
+                         const struct szexp b[MAX_SZEXP_SIZE])
+{
+    for (int i = 0; i < MAX_SZEXP_SIZE; i++) {
+        if (a[i].tag != b[i].tag)
+            return false;
+
+        switch (a[i].tag) {
+        case SZEXP_END:
+            return true;
+        case SZEXP_CONST:
+            if (a[i].val.cval != b[i].val.cval)
+                return false;
+            continue;
+        case SZEXP_VAR_W:
+        case SZEXP_VAR_H:
+            if (!bstr_equals(a[i].val.varname, b[i].val.varname))
+                return false;
+            continue;
+        case SZEXP_OP1:
+        case SZEXP_OP2:
+            if (a[i].val.op != b[i].val.op)
+                return false;
+            continue;
+        }
+    }
+
+    return true;
+}
+
+static bool pass_reads_tex(const struct hook_pass *pass, int idx)
+{
+    for (int i = 0; i < pass->num_binds; i++) {
+        if (!pass->binds[i].lut && pass->binds[i].idx == idx)
+            return true;
+    }
+
+    for (int i = 0; i < pass->num_vars; i++) {
+        if (pass->vars[i] == idx)
+            return true;
+    }
+
+    return false;
+}
+
+// Figures out, for every texture saved under a custom name, after which pass
+// it is no longer needed. This is deliberately conservative: it only covers
+// textures that are written by a single pass and read exclusively by later
+// passes (in file order) on the same stages, under the same execution
+// condition as the writer. This is the case for typical multi-pass shaders
+// (e.g. prescalers with many intermediate feature textures), and guarantees
+// that no reader can observe a texture from a previous invocation.
+static void analyze_tex_lifetimes(struct hook_priv *p, enum pl_hook_stage stages)
+{
+    for (int n = 0; n < p->num_hook_passes; n++) {
+        const struct hook_pass *writer = &p->hook_passes[n];
+        int idx = writer->save_idx;
+        if (idx < 0)
+            continue;
+
+        // Skip textures that alias the name of a hooked stage
+        bool ok = true;
+        for (int i = 0; i < PL_ARRAY_SIZE(p->stage_tex); i++) {
+            if ((stages & (1u << i)) && p->stage_tex[i] == idx)
+                ok = false;
+        }
+
+        int last = -1;
+        for (int m = 0; ok && m < p->num_hook_passes; m++) {
+            const struct hook_pass *pass = &p->hook_passes[m];
+            if (m != n && pass->save_idx == idx) {
+                ok = false; // multiple writers
+            } else if (pass_reads_tex(pass, idx)) {
+                ok = m > n && pass->exec_stages == writer->exec_stages &&
+                     szexpr_equal(pass->hook.cond, writer->hook.cond);
+                last = m;
+            }
+        }
+
+        if (ok && last >= 0) {
+            struct hook_pass *reader = &p->hook_passes[last];
+            TARRAY_APPEND(p->tactx, reader->release, reader->num_release, idx);
+        }
+    }
+}
+
 static bool register_tex(void *priv, struct custom_shader_tex tex)
 {
     struct hook_priv *p = priv;
@@ -1195,9 +1421,20 @@ const struct pl_hook *pl_mpv_user_shader_parse(const struct pl_gpu *gpu,
     // We need to hook on both the exec and save stages, so that we can keep
     // track of any textures we might need
     hook->stages |= p->save_stages;
-    for (int i = 0; i < p->num_hook_passes; i++)
+    for (int i = 0; i < p->num_hook_passes; i++) {
         hook->stages |= p->hook_passes[i].exec_stages;
+        resolve_hook_pass(p, &p->hook_passes[i]);
+    }
+
+    for (int i = 0; i < PL_ARRAY_SIZE(p->stage_tex); i++) {
+        enum pl_hook_stage stage = 1u << i;
+        if (hook->stages & stage)
+            p->stage_tex[i] = intern_tex_name(p, pl_stage_to_mp(stage));
+    }
+
+    analyze_tex_lifetimes(p, hook->stages);
 
+    p->pass_textures = talloc_zero_array(hook, struct pass_tex, p->num_tex_names);
     return hook;
 
 error:
@@ -137,6 +137,54 @@ static bool setup_src(struct pl_shader *sh, const struct pl_sample_src *src,
     return true;
 }
 
+// Work group size used for compute shader debanding
+#define DEBAND_GROUP_SIZE 16
+
+// Decides whether or not to deband from a tile held in shmem, and if so,
+// returns the size of the apron (in texels) around each work group's tile.
+// Returns 0 if the fragment shader path should be used instead.
+static int deband_apron(struct pl_shader *sh, const struct pl_sample_src *src,
+                        const struct pl_deband_params *params)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    if (params->no_compute || params->iterations < 1 || !src->tex)
+        return 0;
+    if (src->tex->sampler_type != PL_SAMPLER_NORMAL)
+        return 0;
+    if (!gpu || !(gpu->caps & PL_GPU_CAP_COMPUTE))
+        return 0;
+
+    // The tile is stored as packed halfs
+    if (gpu->glsl.version < (gpu->glsl.gles ? 300 : 420))
+        return 0;
+
+    // The tile layout relies on a 1:1 mapping of output to source pixels
+    float src_w = PL_DEF(pl_rect_w(src->rect), src->tex->params.w),
+          src_h = PL_DEF(pl_rect_h(src->rect), src->tex->params.h);
+    int out_w = PL_DEF(src->new_w, roundf(fabs(src_w))),
+        out_h = PL_DEF(src->new_h, roundf(fabs(src_h)));
+    if (out_w != src_w || out_h != src_h)
+        return 0;
+
+    // Only worth it if loading the tile requires fewer texture fetches than
+    // sampling each tap directly, which is only the case for high numbers
+    // of iterations relative to the radius
+    const int bs = DEBAND_GROUP_SIZE;
+    int apron = ceilf(params->iterations * params->radius) + 1;
+    int tile = bs + 2 * apron;
+    if (tile * tile >= bs * bs * 4 * params->iterations)
+        return 0;
+
+    size_t shmem_req = tile * tile * sizeof(uint32_t[2]);
+    if (!sh_try_compute(sh, bs, bs, false, shmem_req)) {
+        PL_TRACE(sh, "Not using compute shader debanding: tile too large "
+                 "or incompatible work group size");
+        return 0;
+    }
+
+    return apron;
+}
+
 void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
                       const struct pl_deband_params *params)
 {
@@ -145,24 +193,77 @@ void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
         return;
     }
 
+    params = PL_DEF(params, &pl_deband_default_params);
+    int apron = deband_apron(sh, src, params);
+
     float scale;
-    ident_t tex, pos, pt;
+    ident_t tex, pos, size, pt;
     const char *fn;
-    if (!setup_src(sh, src, &tex, &pos, NULL, &pt, NULL, NULL, NULL, &scale, true, &fn))
+    if (!setup_src(sh, src, &tex, &pos, &size, &pt, NULL, NULL, NULL, &scale,
+                   !apron, &fn))
+    {
         return;
+    }
 
     GLSL("vec4 color;\n");
     GLSL("// pl_shader_deband\n");
     GLSL("{\n");
-    params = PL_DEF(params, &pl_deband_default_params);
 
     ident_t prng, state;
     prng = sh_prng(sh, true, &state);
 
     GLSL("vec2 pos = %s;       \n"
-         "vec4 avg, diff;      \n"
+         "%svec4 avg, diff;    \n"
          "color = %s(%s, pos); \n",
-         pos, fn, tex);
+         pos, sh_prec(sh), fn, tex);
+
+    ident_t fetch = NULL;
+    if (apron) {
+        // Load the work group's tile, plus an apron large enough to cover
+        // every possible tap, into shmem. The taps are then bilinearly
+        // interpolated from the tile instead of sampling the texture.
+        const int tile = DEBAND_GROUP_SIZE + 2 * apron;
+        ident_t tile_data = sh_fresh(sh, "tile"),
+                tile_org = sh_fresh(sh, "tile_org"),
+                unpack = sh_fresh(sh, "unpack");
+        fetch = sh_fresh(sh, "fetch");
+
+        GLSLH("shared uvec2 %s[%d]; \n"
+              "ivec2 %s;            \n",
+              tile_data, tile * tile, tile_org);
+
+        GLSLH("vec4 %s(uvec2 v) {                                       \n"
+              "    return vec4(unpackHalf2x16(v.x), unpackHalf2x16(v.y)); \n"
+              "}                                                        \n",
+              unpack);
+
+        GLSLH("vec4 %s(vec2 pos) {                              \n"
+              "    vec2 fp = pos * %s - vec2(0.5) - vec2(%s);   \n"
+              "    ivec2 i = ivec2(floor(fp));                  \n"
+              "    vec2 f = fp - vec2(i);                       \n"
+              "    int idx = i.y * %d + i.x;                    \n"
+              "    return mix(mix(%s(%s[idx]), %s(%s[idx + 1]), f.x),   \n"
+              "               mix(%s(%s[idx + %d]), %s(%s[idx + %d]), f.x), \n"
+              "               f.y);                             \n"
+              "}                                                \n",
+              fetch, size, tile_org, tile,
+              unpack, tile_data, unpack, tile_data,
+              unpack, tile_data, tile, unpack, tile_data, tile + 1);
+
+        GLSL("vec2 wpos = %s_map(gl_WorkGroupID * gl_WorkGroupSize);       \n"
+             "%s = ivec2(floor(wpos * %s)) - ivec2(%d);                    \n"
+             "for (int i = int(gl_LocalInvocationIndex); i < %d; i += %d) { \n"
+             "    vec2 c = vec2(%s + ivec2(i %% %d, i / %d)) + vec2(0.5);  \n"
+             "    vec4 v = %s(%s, c * %s);                                 \n"
+             "    %s[i] = uvec2(packHalf2x16(v.xy), packHalf2x16(v.zw));   \n"
+             "}                                                            \n"
+             "groupMemoryBarrier();                                        \n"
+             "barrier();                                                   \n",
+             pos, tile_org, size, apron,
+             tile * tile, DEBAND_GROUP_SIZE * DEBAND_GROUP_SIZE,
+             tile_org, tile, tile,
+             fn, tex, pt, tile_data);
+    }
 
     // Helper function: Compute a stochastic approximation of the avg color
     // around a pixel, given a specified radius
@@ -173,16 +274,26 @@ void pl_shader_deband(struct pl_shader *sh, const struct pl_sample_src *src,
           "    float dir  = %s * %f;                            \n"
           "    vec2 o = dist * vec2(cos(dir), sin(dir));        \n"
           // Sample at quarter-turn intervals around the source pixel
-          "    vec4 sum = vec4(0.0);                            \n"
-          "    sum += %s(%s, pos + %s * vec2( o.x,  o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2(-o.x,  o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2(-o.x, -o.y)); \n"
-          "    sum += %s(%s, pos + %s * vec2( o.x, -o.y)); \n"
-          // Return the (normalized) average
-          "    return 0.25 * sum;                               \n"
-          "}\n",
-          average, state, prng, prng, M_PI * 2,
-          fn, tex, pt, fn, tex, pt, fn, tex, pt, fn, tex, pt);
+          "    %svec4 sum = vec4(0.0);                          \n",
+          average, state, prng, prng, M_PI * 2, sh_prec(sh));
+
+    static const char *offsets[4] = {
+        " o.x,  o.y", "-o.x,  o.y", "-o.x, -o.y", " o.x, -o.y",
+    };
+
+    for (int i = 0; i < 4; i++) {
+        if (fetch) {
+            GLSLH("    sum += %s(pos + %s * vec2(%s)); \n",
+                  fetch, pt, offsets[i]);
+        } else {
+            GLSLH("    sum += %s(%s, pos + %s * vec2(%s)); \n",
+                  fn, tex, pt, offsets[i]);
+        }
+    }
+
+    // Return the (normalized) average
+    GLSLH("    return 0.25 * sum;                               \n"
+          "}\n");
 
     // For each iteration, compute the average at a given distance and
     // pick it instead of the color if the difference is below the threshold.
@@ -312,17 +423,20 @@ static void polar_sample(struct pl_shader *sh, const struct pl_filter *filter,
                          int comps, ident_t in)
 {
     // Since we can't know the subpixel position in advance, assume a
-    // worst case scenario
+    // worst case scenario. Since `fcoord` is in [0, 1), the distance
+    // along each axis is in [x-1, x] for positive x, and [-x, 1-x] otherwise
     int yy = y > 0 ? y-1 : y;
     int xx = x > 0 ? x-1 : x;
-    float dmax = sqrt(xx*xx + yy*yy);
+    float dmin = sqrt(xx*xx + yy*yy);
     // Skip samples definitely outside the radius
-    if (dmax >= filter->radius_cutoff)
+    if (dmin >= filter->radius_cutoff)
         return;
 
     GLSL("d = length(vec2(%d.0, %d.0) - fcoord);\n", x, y);
     // Check for samples that might be skippable
-    bool maybe_skippable = dmax >= filter->radius_cutoff - M_SQRT2;
+    int ymax = y > 0 ? y : 1-y;
+    int xmax = x > 0 ? x : 1-x;
+    bool maybe_skippable = sqrt(xmax*xmax + ymax*ymax) >= filter->radius_cutoff;
     if (maybe_skippable)
         GLSL("if (d < %f) {\n", filter->radius_cutoff);
 
@@ -344,8 +458,50 @@ static void polar_sample(struct pl_shader *sh, const struct pl_filter *filter,
         GLSL("}\n");
 }
 
+// Subroutine for iterating over all texel contributions with a dynamic loop,
+// rather than unrolling every tap. Each row only visits the exact span of
+// texels inside `radius_cutoff` for the current subpixel offset, which avoids
+// evaluating a large number of zero-weight taps for big (downscaling) filters.
+// If `in` is set, the texels are read from the shmem tile of width `iw` set up
+// by the compute shader path, with `rel` and `offset` as defined there.
+static void polar_sample_loop(struct pl_shader *sh, const struct pl_filter *filter,
+                              const char *fn, ident_t tex, ident_t lut, int bound,
+                              int comps, ident_t in, int iw, int offset)
+{
+    float cut = filter->radius_cutoff;
+    GLSL("for (int y = %d; y <= %d; y++) {                          \n"
+         "    float dy = float(y) - fcoord.y;                        \n"
+         "    if (abs(dy) >= %f)                                     \n"
+         "        continue;                                          \n"
+         "    float hw = sqrt(%f - dy * dy);                         \n"
+         "    int x0 = max(int(ceil(fcoord.x - hw)), %d);            \n"
+         "    int x1 = min(int(floor(fcoord.x + hw)), %d);           \n"
+         "    for (int x = x0; x <= x1; x++) {                       \n"
+         "        d = length(vec2(float(x), float(y)) - fcoord);     \n"
+         "        w = %s(d * 1.0/%f);                                \n"
+         "        wsum += w;                                         \n",
+         1 - bound, bound, cut, cut * cut, 1 - bound, bound, lut, filter->radius);
+
+    if (in) {
+        GLSL("idx = %d * (rel.y + y + %d) + rel.x + x + %d; \n",
+             iw, offset, offset);
+        for (int n = 0; n < comps; n++)
+            GLSL("color[%d] += w * %s%d[idx];\n", n, in, n);
+    } else {
+        GLSL("c = %s(%s, base + pt * vec2(float(x), float(y))); \n"
+             "color += vec4(w) * c;                             \n",
+             fn, tex);
+    }
+
+    GLSL("}}\n");
+}
+
+// Filters with a larger bound than this are sampled using a dynamic loop
+#define POLAR_UNROLL_BOUND 4
+
 struct sh_sampler_obj {
     const struct pl_filter *filter;
+    uint64_t signature; // hash of `filter->params`, for sharing the LUT
     struct pl_shader_obj *lut;
     struct pl_shader_obj *pass2; // for pl_shader_sample_ortho
 };
@@ -359,6 +515,19 @@ static void sh_sampler_uninit(const struct pl_gpu *gpu, void *ptr)
     *obj = (struct sh_sampler_obj) {0};
 }
 
+// Hashes the parameters that fully determine a filter's weights
+static uint64_t filter_signature(const struct pl_filter *filt)
+{
+    const struct pl_filter_params *fp = &filt->params;
+    uint64_t hash = pl_filter_config_hash(&fp->config);
+    PL_HASH_VAL(&hash, fp->lut_entries);
+    PL_HASH_VAL(&hash, fp->filter_scale);
+    PL_HASH_VAL(&hash, fp->cutoff);
+    PL_HASH_VAL(&hash, fp->max_row_size);
+    PL_HASH_VAL(&hash, fp->row_stride_align);
+    return hash;
+}
+
 static void fill_polar_lut(void *priv, float *data, int w, int h, int d)
 {
     const struct sh_sampler_obj *obj = priv;
@@ -368,6 +537,25 @@ static void fill_polar_lut(void *priv, float *data, int w, int h, int d)
     memcpy(data, filt->weights, w * sizeof(float));
 }
 
+// Returns whether `textureGatherOffset` can be used with offsets in the range
+// [min, max] (in both directions)
+static bool can_gather(struct pl_shader *sh,
+                       const struct pl_sample_filter_params *params,
+                       int min, int max)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    struct pl_glsl_desc glsl = sh_glsl(sh);
+    if (params->no_gather || !gpu->limits.max_gather_offset)
+        return false;
+
+    // The variant with a component argument requires GLSL 400 / GLSL ES 310
+    if (glsl.version < (glsl.gles ? 310 : 400))
+        return false;
+
+    return min >= gpu->limits.min_gather_offset &&
+           max <= gpu->limits.max_gather_offset;
+}
+
 bool pl_shader_sample_polar(struct pl_shader *sh,
                             const struct pl_sample_src *src,
                             const struct pl_sample_filter_params *params)
@@ -442,10 +630,21 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
             SH_FAIL(sh, "Failed initializing polar filter!");
             return false;
         }
+
+        obj->signature = filter_signature(obj->filter);
     }
 
-    ident_t lut = sh_lut(sh, &obj->lut, SH_LUT_LINEAR, lut_entries, 0, 0, 1,
-                         update, false, obj, fill_polar_lut);
+    ident_t lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut,
+        .method = SH_LUT_LINEAR,
+        .width = lut_entries,
+        .comps = 1,
+        .fp16 = true,
+        .update = update,
+        .signature = obj->signature,
+        .priv = obj,
+        .fill = fill_polar_lut,
+    });
     if (!lut) {
         SH_FAIL(sh, "Failed initializing polar LUT!");
         return false;
@@ -457,10 +656,11 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
          "vec2 pos = %s, size = %s, pt = %s;            \n"
          "vec2 fcoord = fract(pos * size - vec2(0.5));  \n"
          "vec2 base = pos - pt * fcoord;                \n"
-         "float w, d, wsum = 0.0;                       \n"
+         "%sfloat w;                                    \n"
+         "float d, wsum = 0.0;                          \n"
          "int idx;                                      \n"
          "vec4 c;                                       \n",
-         pos, size, pt);
+         pos, size, pt, sh_prec(sh));
 
     int bound   = ceil(obj->filter->radius_cutoff);
     int offset  = bound - 1; // padding top/left
@@ -469,15 +669,49 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
     // Determined experimentally on modern AMD and Nvidia hardware. 32 is a
     // good tradeoff for the horizontal work group size. Apart from that,
     // just use as many threads as possible.
-    const int bw = 32, bh = gpu->limits.max_group_threads / bw;
+    int bw = 32, bh = gpu->limits.max_group_threads / bw;
+    if (has_compute) {
+        // Other GPUs may prefer different sizes, so let the dispatch tune it
+        // (if enabled) per filter size, component count and scaling ratio,
+        // which together determine the shmem footprint of a work group
+        const int sizes[][2] = {
+            {bw, bh}, {32, 8}, {32, 16}, {16, 16}, {64, 8}, {16, 8},
+        };
+
+        const int key[] = { bound, comps, (int) lrintf(rx * 16),
+                            (int) lrintf(ry * 16) };
+        int tuned[2];
+        sh_tune_group_size(sh, siphash64((const uint8_t *) key, sizeof(key)),
+                           sizes, PL_ARRAY_SIZE(sizes), tuned);
+        bw = tuned[0];
+        bh = tuned[1];
+    }
 
     // We need to sample everything from base_min to base_max, so make sure
     // we have enough room in shmem
     int iw = (int) ceil(bw / rx) + padding + 1,
         ih = (int) ceil(bh / ry) + padding + 1;
+    int shmem_req = iw * ih * comps * sizeof(float);
+
+    // When downscaling, the footprint of each work group grows with the
+    // scaling ratio, so shrink the work group (height first) until the tile
+    // fits into the remaining shmem, rather than giving up on compute shaders
+    size_t shmem_avail = gpu->limits.max_shmem_size - sh->res.compute_shmem;
+    while (has_compute && shmem_req > shmem_avail && (bw > 8 || bh > 8)) {
+        if (bh > 8) {
+            bh /= 2;
+        } else {
+            bw /= 2;
+        }
+
+        iw = (int) ceil(bw / rx) + padding + 1;
+        ih = (int) ceil(bh / ry) + padding + 1;
+        shmem_req = iw * ih * comps * sizeof(float);
+    }
+
+    bool use_loop = bound > POLAR_UNROLL_BOUND;
 
     ident_t in = NULL;
-    int shmem_req = iw * ih * comps * sizeof(float);
     if (has_compute && sh_try_compute(sh, bw, bh, false, shmem_req)) {
         // Compute shader kernel
         GLSL("vec2 wpos = %s_map(gl_WorkGroupID * gl_WorkGroupSize);        \n"
@@ -502,6 +736,12 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
              "barrier();            \n");
 
         // Dispatch the actual samples
+        if (use_loop) {
+            polar_sample_loop(sh, obj->filter, fn, src_tex, lut, bound,
+                              comps, in, iw, offset);
+            goto done;
+        }
+
         for (int y = 1 - bound; y <= bound; y++) {
             for (int x = 1 - bound; x <= bound; x++) {
                 GLSL("idx = %d * rel.y + rel.x + %d;\n",
@@ -510,6 +750,14 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
             }
         }
     } else {
+        // Texture gathering is preferable to a loop, if it covers every tap
+        use_loop &= !can_gather(sh, params, 1 - bound, bound);
+        if (use_loop) {
+            polar_sample_loop(sh, obj->filter, fn, src_tex, lut, bound,
+                              comps, NULL, 0, 0);
+            goto done;
+        }
+
         // Fragment shader sampling
         for (int n = 0; n < comps; n++)
             GLSL("vec4 in%d;\n", n);
@@ -527,10 +775,7 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
                 bool use_gather = sqrt(x*x + y*y) < obj->filter->radius_cutoff;
 
                 // Make sure all required features are supported
-                use_gather &= sh_glsl(sh).version >= 400;
-                use_gather &= gpu->limits.max_gather_offset != 0;
-                use_gather &= PL_MAX(x, y) <= gpu->limits.max_gather_offset;
-                use_gather &= PL_MIN(x, y) >= gpu->limits.min_gather_offset;
+                use_gather &= can_gather(sh, params, PL_MIN(x, y), PL_MAX(x, y));
 
                 if (!use_gather) {
                     // Switch to direct sampling instead
@@ -566,6 +811,7 @@ bool pl_shader_sample_polar(struct pl_shader *sh,
         }
     }
 
+done:
     GLSL("color = vec4(%f / wsum) * color; \n"
          "}                                \n",
          scale);
@@ -579,6 +825,101 @@ static void fill_ortho_lut(void *priv, float *data, int w, int h, int d)
 
     pl_assert(w * h * 4 == filt->params.lut_entries * filt->row_stride);
     memcpy(data, filt->weights, w * h * 4 * sizeof(float));
+
+    // The LUT may be stored as half floats, so round the weights in advance
+    // while making sure each row still sums to one. Otherwise, the rounding
+    // errors would noticeably change the brightness of the image
+    for (int i = 0; i < h; i++)
+        pl_weights_round_half(&data[i * filt->row_stride], filt->row_size);
+}
+
+// Generates (if needed) the filter for one direction of separable sampling.
+// Sets `*update` if the filter changed. Returns false on failure.
+static bool ortho_filter(struct pl_shader *sh, struct sh_sampler_obj *obj,
+                         float ratio, const struct pl_sample_filter_params *params,
+                         bool *update)
+{
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    float inv_scale = 1.0 / ratio;
+    inv_scale = PL_MAX(inv_scale, 1.0);
+
+    if (params->no_widening)
+        inv_scale = 1.0;
+
+    int lut_entries = PL_DEF(params->lut_entries, 64);
+    *update = !filter_compat(obj->filter, inv_scale, lut_entries, 0.0,
+                             &params->filter);
+
+    if (*update) {
+        pl_filter_free(&obj->filter);
+        obj->filter = pl_filter_generate(sh->ctx, &(struct pl_filter_params) {
+            .config             = params->filter,
+            .lut_entries        = lut_entries,
+            .filter_scale       = inv_scale,
+            .max_row_size       = gpu->limits.max_tex_2d_dim / 4,
+            .row_stride_align   = 4,
+        });
+
+        if (!obj->filter) {
+            // This should never happen, but just in case ..
+            SH_FAIL(sh, "Failed initializing separated filter!");
+            return false;
+        }
+
+        obj->signature = filter_signature(obj->filter);
+    }
+
+    return true;
+}
+
+// Attaches the LUT for a filter previously set up by `ortho_filter`
+static ident_t ortho_lut(struct pl_shader *sh, struct sh_sampler_obj *obj,
+                         bool update)
+{
+    ident_t lut = sh_lut(sh, &(struct sh_lut_params) {
+        .object = &obj->lut,
+        .method = SH_LUT_LINEAR,
+        .width = obj->filter->row_stride / 4,
+        .height = obj->filter->params.lut_entries,
+        .comps = 4,
+        .fp16 = true,
+        .update = update,
+        .signature = obj->signature,
+        .priv = obj,
+        .fill = fill_ortho_lut,
+    });
+
+    if (!lut)
+        SH_FAIL(sh, "Failed initializing separated LUT!");
+    return lut;
+}
+
+// Loads the weight for the `n`th tap of a separable filter into `weight`.
+// For every 4th weight, another LUT entry needs to be fetched into `ws`.
+static void ortho_weight(struct pl_shader *sh, const struct pl_filter *filter,
+                         ident_t lut, const char *fcoord, int n)
+{
+    if (n % 4 == 0) {
+        int width = filter->row_stride / 4; // width of the LUT texture
+        float denom = PL_MAX(1, width - 1); // avoid division by zero
+        GLSL("ws = %s(vec2(%f, %s));\n", lut, (n / 4) / denom, fcoord);
+    }
+    GLSL("weight = ws[%d];\n", n % 4);
+}
+
+// Returns whether the taps `n` and `n+1` of a separable filter can be merged
+// into a single bilinear fetch at a weighted offset in between them. This
+// requires both weights to be non-negative (and not both ~zero) for every
+// subpixel offset, which holds for all interpolated LUT rows as well.
+static bool ortho_can_merge(const struct pl_filter *filter, int n)
+{
+    for (int i = 0; i < filter->params.lut_entries; i++) {
+        const float *w = &filter->weights[i * filter->row_stride + n];
+        if (w[0] < 0.0 || w[1] < 0.0 || w[0] + w[1] < 1e-4)
+            return false;
+    }
+
+    return true;
 }
 
 bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
@@ -639,41 +980,15 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
         assert(obj);
     }
 
-    float inv_scale = 1.0 / ratio[pass];
-    inv_scale = PL_MAX(inv_scale, 1.0);
-
-    if (params->no_widening)
-        inv_scale = 1.0;
-
-    int lut_entries = PL_DEF(params->lut_entries, 64);
-    bool update = !filter_compat(obj->filter, inv_scale, lut_entries, 0.0,
-                                 &params->filter);
-
-    if (update) {
-        pl_filter_free(&obj->filter);
-        obj->filter = pl_filter_generate(sh->ctx, &(struct pl_filter_params) {
-            .config             = params->filter,
-            .lut_entries        = lut_entries,
-            .filter_scale       = inv_scale,
-            .max_row_size       = gpu->limits.max_tex_2d_dim / 4,
-            .row_stride_align   = 4,
-        });
+    bool update;
+    if (!ortho_filter(sh, obj, ratio[pass], params, &update))
+        return false;
 
-        if (!obj->filter) {
-            // This should never happen, but just in case ..
-            SH_FAIL(sh, "Failed initializing separated filter!");
-            return false;
-        }
-    }
+    ident_t lut = ortho_lut(sh, obj, update);
+    if (!lut)
+        return false;
 
     int N = obj->filter->row_size; // number of samples to convolve
-    int width = obj->filter->row_stride / 4; // width of the LUT texture
-    ident_t lut = sh_lut(sh, &obj->lut, SH_LUT_LINEAR, width, lut_entries, 0, 4,
-                         update, false, obj, fill_ortho_lut);
-    if (!lut) {
-        SH_FAIL(sh, "Failed initializing separated LUT!");
-        return false;
-    }
 
     const float dir[PL_SEP_PASSES][2] = {
         [PL_SEP_HORIZ] = {1.0, 0.0},
@@ -689,11 +1004,12 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
          "vec2 fcoord2 = fract(pos * size - vec2(0.5));    \n"
          "float fcoord = dot(fcoord2, dir);                \n"
          "vec2 base = pos - fcoord * pt - pt * vec2(%d.0); \n"
-         "float weight;                                    \n"
-         "vec4 ws, c;                                      \n",
+         "%sfloat weight, wpair;                           \n"
+         "%svec4 ws;                                       \n"
+         "vec4 c;                                          \n",
          pos, size, pt,
          dir[pass][0], dir[pass][1],
-         N / 2 - 1);
+         N / 2 - 1, sh_prec(sh), sh_prec(sh));
 
     bool use_ar = params->antiring > 0;
     if (use_ar) {
@@ -701,16 +1017,29 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
              "vec4 lo = vec4(1e9); \n");
     }
 
+    // Adjacent taps can be merged into a single fetch if the texture can be
+    // sampled bilinearly. (Except for the central taps used for antiringing)
+    bool can_merge = src_params(src).sample_mode == PL_TEX_SAMPLE_LINEAR &&
+                     !params->no_merging;
+
     // Dispatch all of the samples
     GLSL("// scaler samples\n");
     for (int n = 0; n < N; n++) {
-        // Load the right weight for this instance. For every 4th weight, we
-        // need to fetch another LUT entry. Otherwise, just use the previous
-        if (n % 4 == 0) {
-            float denom = PL_MAX(1, width - 1); // avoid division by zero
-            GLSL("ws = %s(vec2(%f, fcoord));\n", lut, (n / 4) / denom);
+        bool merge = can_merge && n + 1 < N && ortho_can_merge(obj->filter, n);
+        merge &= !use_ar || n + 1 < N / 2 - 1 || n > N / 2;
+        if (merge) {
+            ortho_weight(sh, obj->filter, lut, "fcoord", n);
+            GLSL("wpair = weight;\n");
+            ortho_weight(sh, obj->filter, lut, "fcoord", n + 1);
+            GLSL("wpair += weight;                                        \n"
+                 "c = %s(%s, base + pt * vec2(%d.0 + weight / wpair));     \n"
+                 "color += vec4(wpair) * c;                               \n",
+                 fn, src_tex, n);
+            n++; // skip the merged tap
+            continue;
         }
-        GLSL("weight = ws[%d];\n", n % 4);
+
+        ortho_weight(sh, obj->filter, lut, "fcoord", n);
 
         // Load the input texel and add it to the running sum
         GLSL("c = %s(%s, base + pt * vec2(%d.0)); \n"
@@ -732,3 +1061,163 @@ bool pl_shader_sample_ortho(struct pl_shader *sh, int pass,
     GLSL("}\n");
     return true;
 }
+
+bool pl_shader_sample_ortho_fused(struct pl_shader *sh,
+                                  const struct pl_sample_src *src,
+                                  const struct pl_sample_filter_params *params)
+{
+    pl_assert(params);
+    if (params->filter.polar) {
+        SH_FAIL(sh, "Trying to use separated sampling with a polar filter?");
+        return false;
+    }
+
+    const struct pl_gpu *gpu = SH_GPU(sh);
+    pl_assert(gpu);
+
+    if (params->no_compute || !src->tex || !(gpu->caps & PL_GPU_CAP_COMPUTE))
+        return false;
+
+    // Compute the scaling ratios in advance, since we need to know the filter
+    // sizes before deciding whether or not we can use this path at all
+    float src_w = PL_DEF(pl_rect_w(src->rect), src->tex->params.w),
+          src_h = PL_DEF(pl_rect_h(src->rect), src->tex->params.h);
+    if (src_w < 0 || src_h < 0) {
+        PL_TRACE(sh, "Not using fused separable sampling for flipped src.rect");
+        return false;
+    }
+
+    int out_w = PL_DEF(src->new_w, roundf(src_w)),
+        out_h = PL_DEF(src->new_h, roundf(src_h));
+    float rx = out_w / src_w, ry = out_h / src_h;
+
+    struct sh_sampler_obj *vobj, *hobj;
+    vobj = SH_OBJ(sh, params->lut, PL_SHADER_OBJ_SAMPLER,
+                  struct sh_sampler_obj, sh_sampler_uninit);
+    if (!vobj)
+        return false;
+    hobj = SH_OBJ(sh, &vobj->pass2, PL_SHADER_OBJ_SAMPLER,
+                  struct sh_sampler_obj, sh_sampler_uninit);
+    assert(hobj);
+
+    bool vupdate, hupdate;
+    if (!ortho_filter(sh, vobj, ry, params, &vupdate) ||
+        !ortho_filter(sh, hobj, rx, params, &hupdate))
+    {
+        return false;
+    }
+
+    int NV = vobj->filter->row_size, NH = hobj->filter->row_size;
+    int comps = PL_DEF(src->components, src->tex->params.format->num_components);
+
+    // Each work group first runs the vertical pass for every column needed
+    // by the horizontal pass, storing the results in shmem, one row per
+    // output row. The work group size is the same as for polar sampling.
+    const int bw = 32, bh = PL_MIN(8, gpu->limits.max_group_threads / bw);
+    int offset = NH / 2 - 1; // padding left
+    int iw = (int) ceil(bw / rx) + NH + 1;
+    int shmem_req = iw * bh * comps * sizeof(float);
+    if (!sh_try_compute(sh, bw, bh, false, shmem_req)) {
+        PL_TRACE(sh, "Not using fused separable sampling: filter footprint "
+                 "too large or compute shaders unavailable");
+        return false;
+    }
+
+    float scale;
+    ident_t src_tex, pos, size, pt;
+    const char *fn;
+    if (!setup_src(sh, src, &src_tex, &pos, &size, &pt, NULL, NULL, NULL,
+                   &scale, false, &fn))
+    {
+        return false;
+    }
+
+    ident_t vlut = ortho_lut(sh, vobj, vupdate),
+            hlut = ortho_lut(sh, hobj, hupdate);
+    if (!vlut || !hlut)
+        return false;
+
+    GLSL("// pl_shader_sample_ortho_fused                               \n"
+         "vec4 color = vec4(0.0);                                       \n"
+         "{                                                             \n"
+         "vec2 pos = %s, size = %s, pt = %s;                            \n"
+         "vec2 fcoord = fract(pos * size - vec2(0.5));                  \n"
+         "vec2 base = pos - pt * fcoord;                                \n"
+         "vec2 wpos = %s_map(gl_WorkGroupID * gl_WorkGroupSize);        \n"
+         "vec2 wbase = wpos - pt * fract(wpos * size - vec2(0.5));      \n"
+         "int idx = int(gl_LocalInvocationID.y) * %d                    \n"
+         "        + int(round((base.x - wbase.x) * size.x));            \n"
+         "%sfloat weight;                                               \n"
+         "%svec4 ws;                                                    \n"
+         "vec4 c, sum;                                                  \n",
+         pos, size, pt, pos, iw, sh_prec(sh), sh_prec(sh));
+
+    bool use_ar = params->antiring > 0;
+    if (use_ar)
+        GLSL("vec4 hi, lo; \n");
+
+    ident_t in = sh_fresh(sh, "in");
+    for (int c = 0; c < comps; c++)
+        GLSLH("shared float %s%d[%d]; \n", in, c, iw * bh);
+
+    // Vertical pass, for all columns required by this work group
+    GLSL("for (int x = int(gl_LocalInvocationID.x); x < %d; x += %d) { \n"
+         "vec2 vbase = vec2(wbase.x + pt.x * float(x - %d),             \n"
+         "                  base.y - pt.y * %d.0);                      \n"
+         "sum = vec4(0.0);                                              \n",
+         iw, bw, offset, NV / 2 - 1);
+    if (use_ar) {
+        GLSL("hi = vec4(0.0); \n"
+             "lo = vec4(1e9); \n");
+    }
+
+    for (int n = 0; n < NV; n++) {
+        ortho_weight(sh, vobj->filter, vlut, "fcoord.y", n);
+        GLSL("c = %s(%s, vbase + vec2(0.0, pt.y * %d.0)); \n"
+             "sum += vec4(weight) * c;                    \n",
+             fn, src_tex, n);
+        if (use_ar && (n == NV / 2 - 1 || n == NV / 2)) {
+            GLSL("lo = min(lo, c); \n"
+                 "hi = max(hi, c); \n");
+        }
+    }
+
+    if (use_ar)
+        GLSL("sum = mix(sum, clamp(sum, lo, hi), %f);\n", params->antiring);
+
+    for (int c = 0; c < comps; c++) {
+        GLSL("%s%d[int(gl_LocalInvocationID.y) * %d + x] = sum[%d]; \n",
+             in, c, iw, c);
+    }
+
+    GLSL("}                     \n"
+         "groupMemoryBarrier(); \n"
+         "barrier();            \n");
+
+    // Horizontal pass, reading back the intermediate results from shmem
+    if (use_ar) {
+        GLSL("hi = vec4(0.0); \n"
+             "lo = vec4(1e9); \n");
+    }
+
+    for (int n = 0; n < NH; n++) {
+        ortho_weight(sh, hobj->filter, hlut, "fcoord.x", n);
+        GLSL("c = vec4(0.0); \n");
+        for (int c = 0; c < comps; c++)
+            GLSL("c[%d] = %s%d[idx + %d]; \n", c, in, c, n);
+        GLSL("color += vec4(weight) * c; \n");
+        if (use_ar && (n == NH / 2 - 1 || n == NH / 2)) {
+            GLSL("lo = min(lo, c); \n"
+                 "hi = max(hi, c); \n");
+        }
+    }
+
+    if (use_ar) {
+        GLSL("color = mix(color, clamp(color, lo, hi), %f);\n",
+             params->antiring);
+    }
+
+    GLSL("color *= vec4(%f);\n", scale);
+    GLSL("}\n");
+    return true;
+}
@@ -30,18 +30,34 @@ static const struct spirv_compiler_fns *compilers[] = {
 };
 
 struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx,
-                                             uint32_t api_version)
+                                             uint32_t api_version,
+                                             enum pl_spirv_opt opt)
 {
+    // Appended to the compiler name, so that programs cached with a different
+    // optimization level get recompiled
+    static const char *opt_suffix[PL_SPIRV_OPT_COUNT] = {
+        [PL_SPIRV_OPT_PERFORMANCE] = "",
+        [PL_SPIRV_OPT_SIZE]        = "-Os",
+        [PL_SPIRV_OPT_NONE]        = "-O0",
+    };
+
+    if (opt < 0 || opt >= PL_SPIRV_OPT_COUNT) {
+        pl_err(ctx, "Invalid SPIR-V optimization level: %d", (int) opt);
+        return NULL;
+    }
+
     for (int i = 0; i < PL_ARRAY_SIZE(compilers); i++) {
         const struct spirv_compiler_fns *impl = compilers[i];
         pl_info(ctx, "Initializing SPIR-V compiler '%s'", impl->name);
-        struct spirv_compiler *spirv = impl->create(ctx, api_version);
+        struct spirv_compiler *spirv = impl->create(ctx, api_version, opt);
         if (!spirv)
             continue;
 
         spirv->ctx = ctx;
         spirv->impl = impl;
-        strncpy(spirv->name, impl->name, sizeof(spirv->name) - 1);
+        spirv->opt = opt;
+        snprintf(spirv->name, sizeof(spirv->name), "%s%s", impl->name,
+                 opt_suffix[opt]);
         return spirv;
     }
 
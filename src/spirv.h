@@ -36,6 +36,7 @@ struct spirv_compiler {
     // implementation-specific fields
     struct pl_glsl_desc glsl;      // supported GLSL capabilities
     int compiler_version;          // for cache invalidation, may be left as 0
+    enum pl_spirv_opt opt;         // optimization level of the generated SPIR-V
 };
 
 struct spirv_compiler_fns {
@@ -47,13 +48,15 @@ struct spirv_compiler_fns {
                          struct bstr *out_spirv);
 
     // Only needs to initialize the implementation-specific fields
-    struct spirv_compiler *(*create)(struct pl_context *ctx, uint32_t api_ver);
+    struct spirv_compiler *(*create)(struct pl_context *ctx, uint32_t api_ver,
+                                     enum pl_spirv_opt opt);
     void (*destroy)(struct spirv_compiler *spirv);
 };
 
 // Initialize a SPIR-V compiler instance, or returns NULL on failure.
 // `api_version` is the Vulkan API version we're targetting.
 struct spirv_compiler *spirv_compiler_create(struct pl_context *ctx,
-                                             uint32_t api_version);
+                                             uint32_t api_version,
+                                             enum pl_spirv_opt opt);
 
 void spirv_compiler_destroy(struct spirv_compiler **spirv);
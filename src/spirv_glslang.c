@@ -29,7 +29,8 @@ static void glslang_destroy(struct spirv_compiler *spirv)
 }
 
 static struct spirv_compiler *glslang_create(struct pl_context *ctx,
-                                             uint32_t api_version)
+                                             uint32_t api_version,
+                                             enum pl_spirv_opt opt)
 {
     if (!pl_glslang_init()) {
         pl_fatal(ctx, "Failed initializing glslang SPIR-V compiler!");
@@ -62,7 +63,10 @@ static bool glslang_compile(struct spirv_compiler *spirv, void *tactx,
         [GLSL_SHADER_COMPUTE]  = PL_GLSLANG_COMPUTE,
     };
 
-    struct pl_glslang_res *res = pl_glslang_compile(glsl, p->api_ver, stages[type]);
+    struct pl_glslang_res *res;
+    res = pl_glslang_compile(glsl, p->api_ver, stages[type],
+                             spirv->opt != PL_SPIRV_OPT_NONE,
+                             spirv->opt == PL_SPIRV_OPT_SIZE);
     if (!res || !res->success) {
         PL_ERR(spirv, "glslang failed: %s", res ? res->error_msg : "(null)");
         talloc_free(res);
@@ -34,7 +34,8 @@ static void shaderc_destroy(struct spirv_compiler *spirv)
 }
 
 static struct spirv_compiler *shaderc_create(struct pl_context *ctx,
-                                             uint32_t api_version)
+                                             uint32_t api_version,
+                                             enum pl_spirv_opt opt)
 {
     struct spirv_compiler *spirv = talloc_ptrtype_priv(NULL, spirv, struct priv);
     struct priv *p = TA_PRIV(spirv);
@@ -48,13 +49,17 @@ static struct spirv_compiler *shaderc_create(struct pl_context *ctx,
     if (!p->opts)
         goto error;
 
+    static const shaderc_optimization_level levels[PL_SPIRV_OPT_COUNT] = {
 #ifdef SHADERC_HAS_PERF
-    shaderc_compile_options_set_optimization_level(p->opts,
-            shaderc_optimization_level_performance);
+        [PL_SPIRV_OPT_PERFORMANCE]  = shaderc_optimization_level_performance,
 #else
-    shaderc_compile_options_set_optimization_level(p->opts,
-            shaderc_optimization_level_size);
+        [PL_SPIRV_OPT_PERFORMANCE]  = shaderc_optimization_level_size,
 #endif
+        [PL_SPIRV_OPT_SIZE]         = shaderc_optimization_level_size,
+        [PL_SPIRV_OPT_NONE]         = shaderc_optimization_level_zero,
+    };
+
+    shaderc_compile_options_set_optimization_level(p->opts, levels[opt]);
 
     shaderc_compile_options_set_target_env(p->opts,
             shaderc_target_env_vulkan,
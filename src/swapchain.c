@@ -64,15 +64,84 @@ bool pl_swapchain_start_frame(const struct pl_swapchain *sw,
                               struct pl_swapchain_frame *out_frame)
 {
     *out_frame = (struct pl_swapchain_frame) {0}; // sanity
-    return sw->impl->start_frame(sw, out_frame);
+    uint64_t start = pl_trace_begin(sw->ctx);
+    bool ok = sw->impl->start_frame(sw, out_frame);
+    pl_trace_end(sw->ctx, "swapchain", "start_frame", start);
+    return ok;
 }
 
 bool pl_swapchain_submit_frame(const struct pl_swapchain *sw)
 {
-    return sw->impl->submit_frame(sw);
+    uint64_t start = pl_trace_begin(sw->ctx);
+    bool ok = sw->impl->submit_frame(sw);
+    pl_trace_end(sw->ctx, "swapchain", "submit_frame", start);
+    return ok;
 }
 
 void pl_swapchain_swap_buffers(const struct pl_swapchain *sw)
 {
+    uint64_t start = pl_trace_begin(sw->ctx);
     sw->impl->swap_buffers(sw);
+    pl_trace_end(sw->ctx, "swapchain", "swap_buffers", start);
+}
+
+bool pl_swapchain_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out)
+{
+    if (!sw->impl->timing)
+        return false;
+
+    return sw->impl->timing(sw, out);
+}
+
+// Tuning of the adaptive swapchain depth: the depth is raised as soon as the
+// average frame time exceeds DEPTH_RAISE of the frame budget, and lowered
+// again once it has stayed below DEPTH_LOWER for DEPTH_HOLD frames in a row.
+// After every change, the next DEPTH_SETTLE frames are ignored.
+#define DEPTH_RAISE  0.75
+#define DEPTH_LOWER  0.4
+#define DEPTH_HOLD   120
+#define DEPTH_SETTLE 8
+#define DEPTH_EMA    0.1 // smoothing factor for the frame time averages
+
+int pl_sw_depth_update(struct pl_sw_depth *d, int depth, int max_depth,
+                       uint64_t frame_time, uint64_t interval, uint64_t refresh)
+{
+    if (!d->avg_frame_time) {
+        d->avg_frame_time = frame_time;
+        d->avg_interval = interval;
+    }
+
+    d->avg_frame_time += DEPTH_EMA * (frame_time - d->avg_frame_time);
+    if (interval) {
+        d->avg_interval = PL_DEF(d->avg_interval, interval);
+        d->avg_interval += DEPTH_EMA * (interval - d->avg_interval);
+    }
+
+    if (d->settle_frames > 0) {
+        d->settle_frames--;
+        return depth;
+    }
+
+    double budget = PL_DEF((double) refresh, d->avg_interval);
+    if (!budget)
+        return depth;
+
+    int new_depth = depth;
+    if (d->avg_frame_time > DEPTH_RAISE * budget) {
+        d->fast_frames = 0;
+        new_depth = PL_MIN(depth + 1, max_depth);
+    } else if (d->avg_frame_time < DEPTH_LOWER * budget) {
+        if (++d->fast_frames >= DEPTH_HOLD)
+            new_depth = PL_MAX(depth - 1, 1);
+    } else {
+        d->fast_frames = 0;
+    }
+
+    if (new_depth != depth) {
+        d->fast_frames = 0;
+        d->settle_frames = DEPTH_SETTLE;
+    }
+
+    return new_depth;
 }
@@ -30,5 +30,22 @@ struct pl_sw_fns {
     SW_PFN(start_frame);
     SW_PFN(submit_frame);
     SW_PFN(swap_buffers);
+    SW_PFN(timing); // optional
 };
 #undef SW_PFN
+
+// State for adapting the swapchain depth to the measured frame times (see
+// `pl_vulkan_swapchain_params.adaptive_depth`)
+struct pl_sw_depth {
+    double avg_frame_time; // smoothed time taken to render each frame
+    double avg_interval;   // smoothed interval between completed frames
+    int fast_frames;       // consecutive frames with plenty of headroom
+    int settle_frames;     // frames left to ignore after a depth change
+};
+
+// Feeds the GPU time (in ns) taken by the most recently completed frame, and
+// the interval since the completion of the frame before it (or 0 if unknown).
+// The frame budget is `refresh` if known, or the average interval otherwise.
+// Returns the new depth, in the range [1, max_depth].
+int pl_sw_depth_update(struct pl_sw_depth *d, int depth, int max_depth,
+                       uint64_t frame_time, uint64_t interval, uint64_t refresh);
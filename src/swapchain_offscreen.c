@@ -0,0 +1,324 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "context.h"
+#include "gpu.h"
+#include "swapchain.h"
+
+enum slot_state {
+    SLOT_FREE = 0,  // available for `start_frame`
+    SLOT_RENDERING, // handed out by `start_frame`, not yet submitted
+    SLOT_PENDING,   // submitted, possibly still in use by the GPU
+    SLOT_DONE,      // submitted and completed, not yet retrieved
+    SLOT_HELD,      // retrieved by the user, not yet released
+};
+
+struct slot {
+    enum slot_state state;
+    uint64_t id;
+    const struct pl_tex *fbo;
+    const struct pl_buf *buf; // download target, also used as a fence
+    size_t stride;
+};
+
+struct priv {
+    struct pl_offscreen_swapchain_params params;
+    int swapchain_depth;
+
+    // Ring of image slots. Frame N is always assigned to slot N % num_slots
+    struct slot *slots;
+    int num_slots;
+    uint64_t frame_id; // ID of the next frame to be started
+    uint64_t out_id;   // ID of the next frame to be retrieved
+};
+
+static struct pl_sw_fns offscreen_swapchain;
+
+// Align up to the nearest multiple of a power of two
+#define ALIGN2(x, align) (((x) + (align) - 1) & ~((align) - 1))
+
+const struct pl_swapchain *pl_offscreen_swapchain_create(const struct pl_gpu *gpu,
+                        const struct pl_offscreen_swapchain_params *params)
+{
+    const struct pl_fmt *fmt = params->fbo_params.format;
+    if (!fmt || !params->fbo_params.w || !params->fbo_params.h) {
+        PL_ERR(gpu, "Offscreen swapchains require a valid FBO size and format!");
+        return NULL;
+    }
+
+    enum pl_fmt_caps caps = PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_HOST_READABLE;
+    if ((fmt->caps & caps) != caps) {
+        PL_ERR(gpu, "Offscreen swapchain format '%s' must be renderable and "
+               "host readable!", fmt->name);
+        return NULL;
+    }
+
+    struct pl_swapchain *sw = talloc_zero_priv(NULL, struct pl_swapchain, struct priv);
+    sw->impl = &offscreen_swapchain;
+    sw->ctx = gpu->ctx;
+    sw->gpu = gpu;
+
+    struct priv *p = TA_PRIV(sw);
+    p->params = *params;
+    p->params.fbo_params.renderable = true;
+    p->params.fbo_params.host_readable = true;
+    p->params.fbo_params.blit_dst = fmt->caps & PL_FMT_CAP_BLITTABLE;
+    pl_assert(!p->params.fbo_params.initial_data);
+
+    if (!p->params.color_repr.sys) {
+        p->params.color_repr = pl_color_repr_rgb;
+        p->params.color_repr.bits.color_depth = fmt->component_depth[0];
+        p->params.color_repr.bits.sample_depth = fmt->component_depth[0];
+    }
+    if (pl_color_space_equal(&p->params.color_space, &pl_color_space_unknown))
+        p->params.color_space = pl_color_space_monitor;
+
+    p->swapchain_depth = PL_DEF(params->swapchain_depth, 3);
+    pl_assert(p->swapchain_depth > 0);
+    p->num_slots = p->swapchain_depth + 1;
+    p->slots = talloc_zero_array(sw, struct slot, p->num_slots);
+    return sw;
+}
+
+static void offscreen_destroy(const struct pl_swapchain *sw)
+{
+    const struct pl_gpu *gpu = sw->gpu;
+    struct priv *p = TA_PRIV(sw);
+
+    pl_gpu_finish(gpu);
+    for (int i = 0; i < p->num_slots; i++) {
+        pl_tex_destroy(gpu, &p->slots[i].fbo);
+        pl_buf_destroy(gpu, &p->slots[i].buf);
+    }
+
+    talloc_free((void *) sw);
+}
+
+static int offscreen_latency(const struct pl_swapchain *sw)
+{
+    struct priv *p = TA_PRIV(sw);
+    return p->swapchain_depth;
+}
+
+static bool offscreen_resize(const struct pl_swapchain *sw, int *width, int *height)
+{
+    struct priv *p = TA_PRIV(sw);
+
+    // The slots are lazily recreated by `start_frame` as they become free
+    p->params.fbo_params.w = PL_DEF(*width, p->params.fbo_params.w);
+    p->params.fbo_params.h = PL_DEF(*height, p->params.fbo_params.h);
+    *width = p->params.fbo_params.w;
+    *height = p->params.fbo_params.h;
+    return true;
+}
+
+// Polls a submitted slot for completion, waiting up to `timeout`
+static bool slot_poll(const struct pl_gpu *gpu, struct slot *s, uint64_t timeout)
+{
+    if (s->state == SLOT_PENDING && !pl_buf_poll(gpu, s->buf, timeout))
+        s->state = SLOT_DONE;
+    return s->state != SLOT_PENDING;
+}
+
+static bool offscreen_start_frame(const struct pl_swapchain *sw,
+                                  struct pl_swapchain_frame *out_frame)
+{
+    const struct pl_gpu *gpu = sw->gpu;
+    struct priv *p = TA_PRIV(sw);
+    struct slot *s = &p->slots[p->frame_id % p->num_slots];
+
+    switch (s->state) {
+    case SLOT_HELD:
+        PL_TRACE(sw, "All offscreen swapchain images are held by the user");
+        return false;
+
+    case SLOT_PENDING:
+        slot_poll(gpu, s, UINT64_MAX);
+        // fall through
+    case SLOT_DONE:
+        // Drop this frame, since the user never retrieved it
+        if (p->out_id <= s->id) {
+            PL_TRACE(sw, "Dropping unretrieved offscreen frame %"PRIu64, s->id);
+            p->out_id = s->id + 1;
+        }
+        break;
+
+    case SLOT_FREE:
+        break;
+
+    case SLOT_RENDERING:
+        PL_ERR(sw, "Called `pl_swapchain_start_frame` twice in a row!");
+        return false;
+    }
+
+    s->state = SLOT_FREE;
+    if (!pl_tex_recreate(gpu, &s->fbo, &p->params.fbo_params)) {
+        PL_ERR(sw, "Failed creating offscreen swapchain image!");
+        return false;
+    }
+
+    // Size the download buffer. When skipping downloads, a single texel is
+    // still transferred, to give us something to poll for completion
+    const struct pl_fmt *fmt = s->fbo->params.format;
+    size_t size = fmt->texel_size;
+    s->stride = 0;
+    if (!p->params.no_download) {
+        s->stride = ALIGN2(s->fbo->params.w, gpu->limits.align_tex_xfer_stride);
+        s->stride *= fmt->texel_size;
+        size = s->stride * s->fbo->params.h;
+    }
+
+    bool mapped = gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS;
+    bool ok = pl_buf_recreate(gpu, &s->buf, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = size,
+        .host_mapped = mapped && !p->params.no_download,
+        .host_readable = !mapped && !p->params.no_download,
+        .memory_type = PL_BUF_MEM_HOST,
+    });
+
+    if (!ok) {
+        PL_ERR(sw, "Failed creating offscreen swapchain download buffer!");
+        return false;
+    }
+
+    s->state = SLOT_RENDERING;
+    s->id = p->frame_id;
+    *out_frame = (struct pl_swapchain_frame) {
+        .fbo = s->fbo,
+        .flipped = false,
+        .color_repr = p->params.color_repr,
+        .color_space = p->params.color_space,
+    };
+
+    return true;
+}
+
+static bool offscreen_submit_frame(const struct pl_swapchain *sw)
+{
+    const struct pl_gpu *gpu = sw->gpu;
+    struct priv *p = TA_PRIV(sw);
+    struct slot *s = &p->slots[p->frame_id % p->num_slots];
+    if (s->state != SLOT_RENDERING) {
+        PL_ERR(sw, "Called `pl_swapchain_submit_frame` without a started frame!");
+        return false;
+    }
+
+    // The started frame is consumed regardless of the outcome
+    p->frame_id++;
+    s->state = SLOT_PENDING;
+
+    struct pl_tex_transfer_params xfer = {
+        .tex = s->fbo,
+        .buf = s->buf,
+    };
+
+    if (s->stride) {
+        xfer.stride_w = s->stride / s->fbo->params.format->texel_size;
+    } else {
+        xfer.rc = (struct pl_rect3d) { .x1 = 1, .y1 = 1, .z1 = 1 };
+    }
+
+    if (!pl_tex_download(gpu, &xfer)) {
+        PL_ERR(sw, "Failed downloading offscreen swapchain image!");
+        s->state = SLOT_FREE; // drop this frame
+        return false;
+    }
+
+    pl_gpu_flush(gpu);
+    return true;
+}
+
+static void offscreen_swap_buffers(const struct pl_swapchain *sw)
+{
+    const struct pl_gpu *gpu = sw->gpu;
+    struct priv *p = TA_PRIV(sw);
+
+    // Block on the oldest frames until at most `swapchain_depth - 1` of the
+    // submitted frames are still pending
+    uint64_t first = p->frame_id - PL_MIN(p->frame_id, p->num_slots);
+    int pending = 0;
+    for (uint64_t id = first; id < p->frame_id; id++)
+        pending += p->slots[id % p->num_slots].state == SLOT_PENDING;
+
+    for (uint64_t id = first; id < p->frame_id; id++) {
+        if (pending < p->swapchain_depth)
+            break;
+
+        struct slot *s = &p->slots[id % p->num_slots];
+        if (s->state == SLOT_PENDING && s->id == id) {
+            slot_poll(gpu, s, UINT64_MAX);
+            pending--;
+        }
+    }
+}
+
+bool pl_offscreen_swapchain_get(const struct pl_swapchain *sw,
+                                struct pl_offscreen_frame *out_frame,
+                                uint64_t timeout)
+{
+    pl_assert(sw->impl == &offscreen_swapchain);
+    struct priv *p = TA_PRIV(sw);
+    struct slot *s = NULL;
+
+    // Skip over frames that were dropped due to failed submissions
+    for (; p->out_id < p->frame_id; p->out_id++) {
+        s = &p->slots[p->out_id % p->num_slots];
+        if (s->id == p->out_id && s->state != SLOT_FREE)
+            break;
+    }
+
+    if (p->out_id == p->frame_id)
+        return false;
+
+    if (!slot_poll(sw->gpu, s, timeout))
+        return false;
+
+    pl_assert(s->state == SLOT_DONE);
+    s->state = SLOT_HELD;
+    p->out_id++;
+
+    *out_frame = (struct pl_offscreen_frame) {
+        .frame_id = s->id,
+        .fbo = s->fbo,
+        .buf = s->stride ? s->buf : NULL,
+        .data = s->stride ? s->buf->data : NULL,
+        .stride = s->stride,
+    };
+
+    return true;
+}
+
+void pl_offscreen_swapchain_release(const struct pl_swapchain *sw,
+                                    const struct pl_offscreen_frame *frame)
+{
+    pl_assert(sw->impl == &offscreen_swapchain);
+    struct priv *p = TA_PRIV(sw);
+    struct slot *s = &p->slots[frame->frame_id % p->num_slots];
+    pl_assert(s->state == SLOT_HELD && s->id == frame->frame_id);
+    s->state = SLOT_FREE;
+}
+
+static struct pl_sw_fns offscreen_swapchain = {
+    .destroy      = offscreen_destroy,
+    .latency      = offscreen_latency,
+    .resize       = offscreen_resize,
+    .start_frame  = offscreen_start_frame,
+    .submit_frame = offscreen_submit_frame,
+    .swap_buffers = offscreen_swap_buffers,
+};
@@ -1,45 +1,114 @@
 #include "tests.h"
+#include <string.h>
 #include <sys/time.h>
+#include <time.h>
+
+#ifdef PL_HAVE_OPENGL
+#include <epoxy/egl.h>
+#endif
 
-#define TEX_SIZE 2048
 #define CUBE_SIZE 64
 #define NUM_FBOS 16
 #define BENCH_DUR 3
+#define BENCH_TOLERANCE 10
+#define MAX_RESULTS 1024
+#define CPU_TEX_SIZE 64
+
+// Command line options
+struct bench_opts {
+    double duration;            // duration of each benchmark, in seconds
+    const char *filter;         // only run benchmarks containing this string
+    bool vulkan, opengl, cpu;   // backends to test
+    bool res[3];                // resolutions to test (see `resolutions`)
+    const char *json;           // JSON output file, or "-" for stdout
+    const char *baseline;       // baseline file to compare the results against
+    const char *save_baseline;  // file to write the results as new baseline
+    double tolerance;           // allowed slowdown vs the baseline, in percent
+};
+
+static const struct {
+    const char *name;
+    int w, h;
+} resolutions[] = {
+    { "1080p", 1920, 1080 },
+    { "4k",    3840, 2160 },
+    { "8k",    7680, 4320 },
+};
+
+struct bench_result {
+    const char *backend;
+    const char *res;
+    char name[64];
+    int w, h;
+    unsigned long frames;
+    double secs;        // wall clock time
+    double cpu_ms;      // average CPU time spent submitting one frame
+    double gpu_ms;      // average GPU time per frame, or 0 if unavailable
+    double mb_per_sec;  // throughput, for transfer benchmarks (or 0)
+};
+
+static struct bench_result results[MAX_RESULTS];
+static int num_results;
+
+// Shared state for a single benchmark run
+struct bench {
+    const struct pl_gpu *gpu;
+    struct pl_dispatch *dp;
+    struct pl_renderer *rr;
+    struct pl_shader_obj *state;
+    const struct pl_tex *src;
+    const struct pl_tex *fbos[NUM_FBOS];
+    struct pl_timer *timer;
+    int w, h;
+
+    // Benchmark-specific
+    const void *priv;
+    void *buf;
+    size_t buf_size;
+};
+
+static const struct bench_opts *opts;
+static const char *cur_backend;
+static const char *cur_res;
+static int cur_w, cur_h;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1e3 * ts.tv_sec + 1e-6 * ts.tv_nsec;
+}
 
-static const struct pl_tex *create_test_img(const struct pl_gpu *gpu)
+static const struct pl_tex *create_test_img(const struct pl_gpu *gpu,
+                                            int w, int h)
 {
     const struct pl_fmt *fmt;
     fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32, PL_FMT_CAP_LINEAR);
     REQUIRE(fmt);
 
-    int cube_stride = TEX_SIZE / CUBE_SIZE;
-    int cube_count  = cube_stride * cube_stride;
-
-    assert(cube_count * CUBE_SIZE * CUBE_SIZE == TEX_SIZE * TEX_SIZE);
-    float *data = malloc(TEX_SIZE * TEX_SIZE * sizeof(float[4]));
-    for (int n = 0; n < cube_count; n++) {
-        int xbase = (n % cube_stride) * CUBE_SIZE;
-        int ybase = (n / cube_stride) * CUBE_SIZE;
-        for (int g = 0; g < CUBE_SIZE; g++) {
-            for (int r = 0; r < CUBE_SIZE; r++) {
-                int xpos = xbase + r;
-                int ypos = ybase + g;
-                assert(xpos < TEX_SIZE && ypos < TEX_SIZE);
-
-                float *color = &data[(ypos * TEX_SIZE + xpos) * 4];
-                color[0] = (float) r / CUBE_SIZE;
-                color[1] = (float) g / CUBE_SIZE;
-                color[2] = (float) n / cube_count;
-                color[3] = 1.0;
-            }
+    int cube_stride = (w + CUBE_SIZE - 1) / CUBE_SIZE;
+    int cube_count  = cube_stride * ((h + CUBE_SIZE - 1) / CUBE_SIZE);
+
+    float *data = malloc(w * h * sizeof(float[4]));
+    REQUIRE(data);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int n = (y / CUBE_SIZE) * cube_stride + x / CUBE_SIZE;
+            float *color = &data[(y * w + x) * 4];
+            color[0] = (float) (x % CUBE_SIZE) / CUBE_SIZE;
+            color[1] = (float) (y % CUBE_SIZE) / CUBE_SIZE;
+            color[2] = (float) n / cube_count;
+            color[3] = 1.0;
         }
     }
 
     const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
         .format         = fmt,
-        .w              = TEX_SIZE,
-        .h              = TEX_SIZE,
+        .w              = w,
+        .h              = h,
         .sampleable     = true,
+        .host_writable  = true,
+        .host_readable  = true,
         .sample_mode    = PL_TEX_SAMPLE_LINEAR,
         .initial_data   = data,
     });
@@ -49,58 +118,36 @@ static const struct pl_tex *create_test_img(const struct pl_gpu *gpu)
     return tex;
 }
 
-typedef void (*bench_fn)(struct pl_shader *sh, struct pl_shader_obj **state,
-                         const struct pl_tex *src);
-
-static void run_bench(const struct pl_gpu *gpu, struct pl_dispatch *dp,
-                      struct pl_shader_obj **state, const struct pl_tex *src,
-                      const struct pl_tex *fbo, struct pl_timer *timer,
-                      bench_fn bench)
+static bool bench_enabled(const char *name)
 {
-    struct pl_shader *sh = pl_dispatch_begin(dp);
-    bench(sh, state, src);
-
-    pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
-        .shader = &sh,
-        .target = fbo,
-        .timer = timer,
-    });
+    return !opts->filter || strstr(name, opts->filter);
 }
 
-static void benchmark(const struct pl_gpu *gpu, const char *name, bench_fn bench)
-{
-    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
-    struct pl_shader_obj *state = NULL;
-    const struct pl_tex *src = create_test_img(gpu);
-
-    // Create the FBOs
-    const struct pl_fmt *fmt;
-    fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 0, PL_FMT_CAP_RENDERABLE);
-    REQUIRE(fmt);
+// Performs a single iteration of the benchmark, targeting `b->fbos[index]`.
+// Returns the number of bytes transferred (for throughput measurements).
+typedef size_t (*iter_fn)(struct bench *b, int index);
 
-    const struct pl_tex *fbos[NUM_FBOS] = {0};
-    for (int i = 0; i < NUM_FBOS; i++) {
-        fbos[i] = pl_tex_create(gpu, &(struct pl_tex_params) {
-            .format         = fmt,
-            .w              = TEX_SIZE,
-            .h              = TEX_SIZE,
-            .renderable     = true,
-            .host_readable  = true,
-            .storable       = !!(fmt->caps & PL_FMT_CAP_STORABLE),
-        });
-        REQUIRE(fbos[i]);
-    }
+static void run_loop(struct bench *b, const char *name, iter_fn iter)
+{
+    const struct pl_gpu *gpu = b->gpu;
 
     // Run the benchmark and flush+block once to force shader compilation etc.
-    run_bench(gpu, dp, &state, src, fbos[0], NULL, bench);
+    struct pl_timer *timer = b->timer;
+    b->timer = NULL;
+    iter(b, 0);
     pl_gpu_finish(gpu);
+    b->timer = timer;
+
+    if (b->rr)
+        pl_renderer_reset_stats(b->rr);
 
     // Perform the actual benchmark
     struct timeval start = {0}, stop = {0};
     unsigned long frames = 0;
     int index = 0;
+    double cpu_total = 0.0;
+    size_t bytes = 0;
 
-    struct pl_timer *timer = pl_timer_create(gpu);
     uint64_t gputime_total = 0;
     unsigned long gputime_count = 0;
     uint64_t gputime;
@@ -108,41 +155,228 @@ static void benchmark(const struct pl_gpu *gpu, const char *name, bench_fn bench
     gettimeofday(&start, NULL);
     do {
         frames++;
-        run_bench(gpu, dp, &state, src, fbos[index++], timer, bench);
+        double cpu_start = now_ms();
+        bytes += iter(b, index++);
+        cpu_total += now_ms() - cpu_start;
         index %= NUM_FBOS;
         if (index == 0) {
             pl_gpu_flush(gpu);
             gettimeofday(&stop, NULL);
         }
-        while ((gputime = pl_timer_query(gpu, timer))) {
+        while (timer && (gputime = pl_timer_query(gpu, timer))) {
             gputime_total += gputime;
             gputime_count++;
         }
-    } while (stop.tv_sec - start.tv_sec < BENCH_DUR);
+    } while ((stop.tv_sec - start.tv_sec) +
+             1e-6 * (stop.tv_usec - start.tv_usec) < opts->duration);
 
     // Force the GPU to finish execution and re-measure the final stop time
     pl_gpu_finish(gpu);
 
     gettimeofday(&stop, NULL);
-    while ((gputime = pl_timer_query(gpu, timer))) {
+    while (timer && (gputime = pl_timer_query(gpu, timer))) {
         gputime_total += gputime;
         gputime_count++;
     }
 
-    float secs = (float) (stop.tv_sec - start.tv_sec) +
-                 1e-6 * (stop.tv_usec - start.tv_usec);
-    printf("'%s':\t%4lu frames in %1.6f seconds => %2.6f ms/frame (%5.2f FPS)",
-          name, frames, secs, 1000 * secs / frames, frames / secs);
-    if (gputime_count)
-        printf(", gpu time: %2.6f ms", 1e-6 * (gputime_total / gputime_count));
-    printf("\n");
-
-    pl_timer_destroy(gpu, &timer);
-    pl_shader_obj_destroy(&state);
-    pl_dispatch_destroy(&dp);
-    pl_tex_destroy(gpu, &src);
+    double secs = (stop.tv_sec - start.tv_sec) +
+                  1e-6 * (stop.tv_usec - start.tv_usec);
+
+    struct bench_result res = {
+        .backend = cur_backend,
+        .res = cur_res,
+        .w = b->w,
+        .h = b->h,
+        .frames = frames,
+        .secs = secs,
+        .cpu_ms = cpu_total / frames,
+        .mb_per_sec = bytes / (secs * 1e6),
+    };
+
+    snprintf(res.name, sizeof(res.name), "%s", name);
+
+    if (gputime_count) {
+        res.gpu_ms = 1e-6 * gputime_total / gputime_count;
+    } else if (b->rr) {
+        // The renderer dispatches multiple passes per frame, so estimate the
+        // per-frame GPU time from the renderer's own statistics instead
+        struct pl_render_stats stats;
+        pl_renderer_get_stats(b->rr, &stats);
+        double total = 0.0;
+        for (int i = 0; i < PL_RENDER_STAGE_COUNT; i++)
+            total += (double) stats.stages[i].average * stats.stages[i].count;
+        res.gpu_ms = 1e-6 * total / frames;
+    }
+
+    if (!opts->json || strcmp(opts->json, "-") != 0) {
+        printf("[%s %s] '%s':\t%4lu frames in %1.6f seconds => %2.6f ms/frame "
+               "(%5.2f FPS), cpu time: %2.6f ms", res.backend, res.res, name,
+               frames, secs, 1000 * secs / frames, frames / secs, res.cpu_ms);
+        if (res.gpu_ms)
+            printf(", gpu time: %2.6f ms", res.gpu_ms);
+        if (res.mb_per_sec)
+            printf(", throughput: %.2f MB/s", res.mb_per_sec);
+        printf("\n");
+    }
+
+    if (num_results < MAX_RESULTS)
+        results[num_results++] = res;
+}
+
+static struct bench bench_init(const struct pl_gpu *gpu)
+{
+    struct bench b = {
+        .gpu = gpu,
+        .w = cur_w,
+        .h = cur_h,
+        .dp = pl_dispatch_create(gpu->ctx, gpu),
+        .timer = pl_timer_create(gpu),
+    };
+
+    b.src = create_test_img(gpu, b.w, b.h);
+
+    // Create the FBOs
+    const struct pl_fmt *fmt;
+    fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 0, PL_FMT_CAP_RENDERABLE);
+    REQUIRE(fmt);
+
+    for (int i = 0; i < NUM_FBOS; i++) {
+        b.fbos[i] = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .format         = fmt,
+            .w              = b.w,
+            .h              = b.h,
+            .renderable     = true,
+            .host_readable  = true,
+            .storable       = !!(fmt->caps & PL_FMT_CAP_STORABLE),
+        });
+        REQUIRE(b.fbos[i]);
+    }
+
+    return b;
+}
+
+static void bench_uninit(struct bench *b)
+{
+    pl_renderer_destroy(&b->rr);
+    pl_timer_destroy(b->gpu, &b->timer);
+    pl_shader_obj_destroy(&b->state);
+    pl_dispatch_destroy(&b->dp);
+    pl_tex_destroy(b->gpu, &b->src);
     for (int i = 0; i < NUM_FBOS; i++)
-        pl_tex_destroy(gpu, &fbos[i]);
+        pl_tex_destroy(b->gpu, &b->fbos[i]);
+    free(b->buf);
+}
+
+// Shader benchmarks
+typedef void (*bench_fn)(struct pl_shader *sh, struct pl_shader_obj **state,
+                         const struct pl_tex *src);
+
+static size_t iter_shader(struct bench *b, int index)
+{
+    bench_fn bench = (bench_fn) b->priv;
+    struct pl_shader *sh = pl_dispatch_begin(b->dp);
+    bench(sh, &b->state, b->src);
+
+    pl_dispatch_finish(b->dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = b->fbos[index],
+        .timer = b->timer,
+    });
+
+    return 0;
+}
+
+static void benchmark(const struct pl_gpu *gpu, const char *name, bench_fn bench)
+{
+    if (!bench_enabled(name))
+        return;
+
+    struct bench b = bench_init(gpu);
+    b.priv = (const void *) bench;
+    run_loop(&b, name, iter_shader);
+    bench_uninit(&b);
+}
+
+// End-to-end rendering benchmarks
+static size_t iter_render(struct bench *b, int index)
+{
+    const struct pl_render_params *params = b->priv;
+    struct pl_image image = {
+        .signature  = 0, // don't care
+        .num_planes = 1,
+        .planes     = {{
+            .texture = b->src,
+            .components = 3,
+            .component_mapping = {0, 1, 2},
+        }},
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_bt709,
+    };
+
+    struct pl_render_target target = {
+        .fbo    = b->fbos[index],
+        .repr   = pl_color_repr_rgb,
+        .color  = pl_color_space_srgb,
+    };
+
+    REQUIRE(pl_render_image(b->rr, &image, &target, params));
+    return 0;
+}
+
+static void benchmark_render(const struct pl_gpu *gpu, const char *name,
+                             const struct pl_render_params *params)
+{
+    if (!bench_enabled(name))
+        return;
+
+    struct pl_render_params rparams = *params;
+    rparams.measure_timing = true;
+
+    struct bench b = bench_init(gpu);
+    b.rr = pl_renderer_create(gpu->ctx, gpu);
+    b.priv = &rparams;
+
+    // The renderer dispatches many passes, so rely on its own statistics
+    pl_timer_destroy(gpu, &b.timer);
+    run_loop(&b, name, iter_render);
+    bench_uninit(&b);
+}
+
+// Transfer benchmarks
+static size_t iter_upload(struct bench *b, int index)
+{
+    REQUIRE(pl_tex_upload(b->gpu, &(struct pl_tex_transfer_params) {
+        .tex    = b->src,
+        .ptr    = b->buf,
+        .timer  = b->timer,
+    }));
+
+    return b->buf_size;
+}
+
+static size_t iter_download(struct bench *b, int index)
+{
+    REQUIRE(pl_tex_download(b->gpu, &(struct pl_tex_transfer_params) {
+        .tex    = b->src,
+        .ptr    = b->buf,
+        .timer  = b->timer,
+    }));
+
+    return b->buf_size;
+}
+
+static void benchmark_transfer(const struct pl_gpu *gpu, const char *name,
+                               iter_fn iter)
+{
+    if (!bench_enabled(name))
+        return;
+
+    struct bench b = bench_init(gpu);
+    b.buf_size = b.w * b.h * b.src->params.format->texel_size;
+    b.buf = calloc(1, b.buf_size);
+    REQUIRE(b.buf);
+    run_loop(&b, name, iter);
+    bench_uninit(&b);
 }
 
 // List of benchmarks
@@ -221,6 +455,20 @@ static void bench_polar(struct pl_shader *sh, struct pl_shader_obj **state,
 static void bench_polar_nocompute(struct pl_shader *sh,
                                   struct pl_shader_obj **state,
                                   const struct pl_tex *src)
+{
+    struct pl_sample_filter_params params = {
+        .filter = pl_filter_ewa_lanczos,
+        .no_compute = true,
+        .no_gather = true,
+        .lut = state,
+    };
+
+    pl_shader_sample_polar(sh, &(struct pl_sample_src) { .tex = src }, &params);
+}
+
+static void bench_polar_gather(struct pl_shader *sh,
+                               struct pl_shader_obj **state,
+                               const struct pl_tex *src)
 {
     struct pl_sample_filter_params params = {
         .filter = pl_filter_ewa_lanczos,
@@ -270,51 +518,503 @@ static void bench_av1_grain_lap(struct pl_shader *sh, struct pl_shader_obj **sta
     pl_shader_av1_grain(sh, state, &params);
 }
 
-int main()
+static void bench_av1_grain_cached(struct pl_shader *sh,
+                                   struct pl_shader_obj **state,
+                                   const struct pl_tex *src)
 {
-    setbuf(stdout, NULL);
-    setbuf(stderr, NULL);
+    struct pl_av1_grain_params params = {
+        .data = av1_grain_data,
+        .tex = src,
+        .components = 3,
+        .component_mapping = {0, 1, 2},
+        .repr = &(struct pl_color_repr) {0},
+    };
+
+    // Cycle through a small number of repeating grain parameter sets
+    static uint16_t frame;
+    params.data.grain_seed = frame++ % 3;
+    pl_shader_av1_grain(sh, state, &params);
+}
+
+static void run_benchmarks(const struct pl_gpu *gpu)
+{
+    benchmark(gpu, "bilinear", bench_bilinear);
+    benchmark(gpu, "bicubic", bench_bicubic);
+    benchmark(gpu, "deband", bench_deband);
+    benchmark(gpu, "deband_heavy", bench_deband_heavy);
 
+    // Polar sampling
+    benchmark(gpu, "polar", bench_polar);
+    if (gpu->caps & PL_GPU_CAP_COMPUTE)
+        benchmark(gpu, "polar_nocompute", bench_polar_nocompute);
+    if (gpu->limits.max_gather_offset)
+        benchmark(gpu, "polar_gather", bench_polar_gather);
+
+    // Dithering algorithms
+    benchmark(gpu, "dither_blue", bench_dither_blue);
+    benchmark(gpu, "dither_white", bench_dither_white);
+    benchmark(gpu, "dither_ordered_fixed", bench_dither_ordered_fix);
+
+    // HDR peak detection
+    if (gpu->caps & PL_GPU_CAP_COMPUTE)
+        benchmark(gpu, "hdr_peakdetect", bench_hdr_peak);
+
+    // Misc stuff
+    benchmark(gpu, "av1_grain", bench_av1_grain);
+    benchmark(gpu, "av1_grain_lap", bench_av1_grain_lap);
+    benchmark(gpu, "av1_grain_cached", bench_av1_grain_cached);
+
+    // End-to-end rendering
+    benchmark_render(gpu, "render_fast", &(struct pl_render_params) {0});
+    benchmark_render(gpu, "render_default", &pl_render_default_params);
+    benchmark_render(gpu, "render_hq", &pl_render_high_quality_params);
+
+    // Texture transfers
+    benchmark_transfer(gpu, "upload", iter_upload);
+    benchmark_transfer(gpu, "download", iter_download);
+}
+
+// CPU-only microbenchmarks. These measure the host-side cost of generating
+// shaders, LUTs etc., using a dummy GPU wherever a `pl_gpu` is required
+static size_t iter_filter(struct bench *b, int index)
+{
+    const struct pl_filter_config *config = b->priv;
+    const struct pl_filter *filter;
+    filter = pl_filter_generate(b->gpu->ctx, &(struct pl_filter_params) {
+        .config = *config,
+        .lut_entries = 256,
+    });
+
+    REQUIRE(filter);
+    pl_filter_free(&filter);
+    return 0;
+}
+
+static size_t iter_blue_noise(struct bench *b, int index)
+{
+    pl_generate_blue_noise(b->buf, CPU_TEX_SIZE);
+    return 0;
+}
+
+// A typical combination of several shaders
+static void bench_pipeline(struct pl_shader *sh, struct pl_shader_obj **state,
+                           const struct pl_tex *src)
+{
+    pl_shader_deband(sh, &(struct pl_sample_src) { .tex = src }, NULL);
+    pl_shader_dither(sh, 8, state, NULL);
+}
+
+static size_t iter_shader_gen(struct bench *b, int index)
+{
+    bench_fn bench = (bench_fn) b->priv;
+    struct pl_shader *sh = pl_dispatch_begin(b->dp);
+    bench(sh, &b->state, b->src);
+    pl_shader_signature(sh);
+    pl_dispatch_abort(b->dp, &sh);
+    return 0;
+}
+
+static void benchmark_cpu(const struct pl_gpu *gpu, const char *name,
+                          iter_fn iter, const void *priv)
+{
+    if (!bench_enabled(name))
+        return;
+
+    struct bench b = bench_init(gpu);
+    b.priv = priv;
+    b.buf_size = CPU_TEX_SIZE * CPU_TEX_SIZE * sizeof(float);
+    b.buf = calloc(1, b.buf_size);
+    REQUIRE(b.buf);
+    run_loop(&b, name, iter);
+    bench_uninit(&b);
+}
+
+static void bench_cpu(void)
+{
+    // Creating passes always fails on the dummy GPU, so silence the resulting
+    // errors. The dispatch benchmark thus measures everything up to (and
+    // including) the pass cache lookup, but not the execution
     struct pl_context *ctx;
     ctx = pl_context_create(PL_API_VER, &(struct pl_context_params) {
-        .log_cb     = isatty(fileno(stdout)) ? pl_log_color : pl_log_simple,
-        .log_level  = PL_LOG_WARN,
+        .log_cb     = pl_log_simple,
+        .log_priv   = stderr,
+        .log_level  = PL_LOG_NONE,
     });
 
+    const struct pl_gpu *gpu = pl_gpu_dummy_create(ctx, NULL);
+    cur_backend = "cpu";
+    cur_res = "-";
+    cur_w = cur_h = CPU_TEX_SIZE;
+
+    benchmark_cpu(gpu, "filter_generate", iter_filter, &pl_filter_spline36);
+    benchmark_cpu(gpu, "filter_generate_polar", iter_filter,
+                  &pl_filter_ewa_lanczos);
+    benchmark_cpu(gpu, "blue_noise", iter_blue_noise, NULL);
+    benchmark_cpu(gpu, "shader_signature", iter_shader_gen, bench_pipeline);
+    benchmark_cpu(gpu, "av1_grain_gen", iter_shader_gen, bench_av1_grain);
+    benchmark_cpu(gpu, "dispatch_overhead", iter_shader, bench_bicubic);
+
+    pl_gpu_dummy_destroy(&gpu);
+    pl_context_destroy(&ctx);
+}
+
+static void run_all_resolutions(const struct pl_gpu *gpu, const char *backend)
+{
+    cur_backend = backend;
+    for (int i = 0; i < PL_ARRAY_SIZE(resolutions); i++) {
+        if (!opts->res[i])
+            continue;
+
+        if (resolutions[i].w > gpu->limits.max_tex_2d_dim ||
+            resolutions[i].h > gpu->limits.max_tex_2d_dim)
+        {
+            fprintf(stderr, "Skipping %s on %s: exceeds max texture size\n",
+                    resolutions[i].name, backend);
+            continue;
+        }
+
+        cur_res = resolutions[i].name;
+        cur_w = resolutions[i].w;
+        cur_h = resolutions[i].h;
+        run_benchmarks(gpu);
+    }
+}
+
+#ifdef PL_HAVE_VULKAN
+static void bench_vulkan(struct pl_context *ctx)
+{
     const struct pl_vulkan *vk = pl_vulkan_create(ctx, &(struct pl_vulkan_params) {
         .allow_software = true,
         .async_compute = true,
         .queue_count = NUM_FBOS,
     });
 
-    if (!vk)
-        return SKIP;
+    if (!vk) {
+        fprintf(stderr, "Failed creating vulkan device, skipping\n");
+        return;
+    }
 
-    printf("= Running benchmarks =\n");
-    benchmark(vk->gpu, "bilinear", bench_bilinear);
-    benchmark(vk->gpu, "bicubic", bench_bicubic);
-    benchmark(vk->gpu, "deband", bench_deband);
-    benchmark(vk->gpu, "deband_heavy", bench_deband_heavy);
+    run_all_resolutions(vk->gpu, "vulkan");
+    pl_vulkan_destroy(&vk);
+}
+#endif
 
-    // Polar sampling
-    benchmark(vk->gpu, "polar", bench_polar);
-    if (vk->gpu->caps & PL_GPU_CAP_COMPUTE)
-        benchmark(vk->gpu, "polar_nocompute", bench_polar_nocompute);
+#ifdef PL_HAVE_OPENGL
+static void bench_opengl(struct pl_context *ctx)
+{
+    if (!epoxy_has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+        goto skip;
+
+    EGLDisplay dpy = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, NULL);
+    if (dpy == EGL_NO_DISPLAY)
+        goto skip;
+
+    EGLint major, minor;
+    if (!eglInitialize(dpy, &major, &minor))
+        goto skip;
+
+    const int cfg_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
 
-    // Dithering algorithms
-    benchmark(vk->gpu, "dither_blue", bench_dither_blue);
-    benchmark(vk->gpu, "dither_white", bench_dither_white);
-    benchmark(vk->gpu, "dither_ordered_fixed", bench_dither_ordered_fix);
+    EGLConfig config = 0;
+    EGLint num_configs = 0;
+    bool ok = eglChooseConfig(dpy, cfg_attribs, &config, 1, &num_configs);
+    if (!ok || !num_configs || !eglBindAPI(EGL_OPENGL_API))
+        goto error;
+
+    // Just try getting the most recent core profile context
+    const int egl_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 0,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
 
-    // HDR peak detection
-    if (vk->gpu->caps & PL_GPU_CAP_COMPUTE)
-        benchmark(vk->gpu, "hdr_peakdetect", bench_hdr_peak);
+    EGLContext egl = eglCreateContext(dpy, config, EGL_NO_CONTEXT, egl_attribs);
+    if (!egl)
+        goto error;
 
-    // Misc stuff
-    benchmark(vk->gpu, "av1_grain", bench_av1_grain);
-    benchmark(vk->gpu, "av1_grain_lap", bench_av1_grain_lap);
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, egl)) {
+        eglDestroyContext(dpy, egl);
+        goto error;
+    }
+
+    const struct pl_opengl *gl = pl_opengl_create(ctx, &pl_opengl_default_params);
+    if (gl) {
+        run_all_resolutions(gl->gpu, "opengl");
+        pl_opengl_destroy(&gl);
+    }
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, egl);
+    // fall through
+
+error:
+    eglTerminate(dpy);
+    return;
+
+skip:
+    fprintf(stderr, "Failed creating OpenGL context, skipping\n");
+}
+#endif
+
+static double ms_per_frame(const struct bench_result *r)
+{
+    return 1000 * r->secs / r->frames;
+}
+
+static void write_json(FILE *f)
+{
+    fprintf(f, "{\n  \"version\": \"%s\",\n  \"api_ver\": %d,\n"
+            "  \"duration\": %f,\n  \"results\": [", pl_version(), PL_API_VER,
+            opts->duration);
+
+    for (int i = 0; i < num_results; i++) {
+        const struct bench_result *r = &results[i];
+        fprintf(f, "%s\n    {\"backend\": \"%s\", \"name\": \"%s\", "
+                "\"resolution\": \"%s\", \"width\": %d, \"height\": %d, "
+                "\"frames\": %lu, \"seconds\": %f, \"ms_per_frame\": %f, "
+                "\"fps\": %f, \"cpu_ms\": %f, \"gpu_ms\": %f, "
+                "\"mb_per_sec\": %f}",
+                i ? "," : "", r->backend, r->name, r->res, r->w, r->h,
+                r->frames, r->secs, ms_per_frame(r),
+                r->frames / r->secs, r->cpu_ms, r->gpu_ms, r->mb_per_sec);
+    }
+
+    fprintf(f, "\n  ]\n}\n");
+}
+
+static bool save_baseline(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed opening '%s' for writing\n", path);
+        return false;
+    }
+
+    fprintf(f, "# libplacebo %s benchmark baseline\n"
+            "# backend resolution name ms_per_frame\n", pl_version());
+    for (int i = 0; i < num_results; i++) {
+        const struct bench_result *r = &results[i];
+        fprintf(f, "%s %s %s %.9f\n", r->backend, r->res, r->name,
+                ms_per_frame(r));
+    }
+
+    fclose(f);
+    return true;
+}
+
+// Compares the results against a baseline written by `save_baseline`, which
+// is only meaningful on the same device (and build configuration) it was
+// recorded on. Returns the number of regressions, or -1 on error. Benchmarks
+// missing from either side are ignored.
+static int check_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed opening baseline '%s'\n", path);
+        return -1;
+    }
+
+    int num_checked = 0, num_regressed = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char backend[32], res[32], name[64];
+        double base;
+        if (line[0] == '#' || sscanf(line, "%31s %31s %63s %lf", backend, res,
+                                     name, &base) != 4)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < num_results; i++) {
+            const struct bench_result *r = &results[i];
+            if (strcmp(r->backend, backend) != 0 || strcmp(r->res, res) != 0 ||
+                strcmp(r->name, name) != 0)
+            {
+                continue;
+            }
+
+            double ms = ms_per_frame(r);
+            num_checked++;
+            if (ms > base * (1.0 + opts->tolerance / 100.0)) {
+                fprintf(stderr, "Regression [%s %s] '%s': %2.6f ms/frame, "
+                        "baseline %2.6f ms/frame (%+.1f%%)\n", backend, res,
+                        name, ms, base, 100.0 * (ms / base - 1.0));
+                num_regressed++;
+            }
+        }
+    }
+
+    fclose(f);
+    fprintf(stderr, "Compared %d benchmarks against '%s' (tolerance %.1f%%): "
+            "%d regressions\n", num_checked, path, opts->tolerance,
+            num_regressed);
+    return num_regressed;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "  --backend <vulkan|opengl|cpu|all>\n"
+        "                                 Backends to benchmark, may be repeated\n"
+        "                                 (default: all)\n"
+        "  --res <1080p|4k|8k|all>        Resolution to test, may be repeated\n"
+        "                                 (default: 1080p)\n"
+        "  --duration <secs>              Duration of each benchmark (default: %d)\n"
+        "  --filter <str>                 Only run benchmarks containing <str>\n"
+        "  --json <file>                  Write results as JSON to <file>, or\n"
+        "                                 to stdout if <file> is '-'\n"
+        "  --save-baseline <file>         Write the results as a new baseline\n"
+        "  --baseline <file>              Fail if any benchmark is slower than\n"
+        "                                 in the baseline <file>\n"
+        "  --tolerance <percent>          Allowed slowdown relative to the\n"
+        "                                 baseline (default: %d)\n",
+        prog, BENCH_DUR, BENCH_TOLERANCE);
+}
+
+static bool parse_opts(int argc, char **argv, struct bench_opts *o)
+{
+    *o = (struct bench_opts) {
+        .duration = BENCH_DUR,
+        .tolerance = BENCH_TOLERANCE,
+        .vulkan = true,
+        .opengl = true,
+        .cpu = true,
+    };
+
+    bool have_res = false, have_backend = false;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+            return false;
+        if (!val) {
+            fprintf(stderr, "Missing value for option '%s'\n", arg);
+            return false;
+        }
+
+        i++;
+        if (strcmp(arg, "--backend") == 0) {
+            if (!have_backend)
+                o->vulkan = o->opengl = o->cpu = false;
+            have_backend = true;
+            bool all = strcmp(val, "all") == 0;
+            o->vulkan |= all || strcmp(val, "vulkan") == 0;
+            o->opengl |= all || strcmp(val, "opengl") == 0;
+            o->cpu |= all || strcmp(val, "cpu") == 0;
+            if (!o->vulkan && !o->opengl && !o->cpu) {
+                fprintf(stderr, "Unknown backend '%s'\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--res") == 0) {
+            bool all = strcmp(val, "all") == 0, found = all;
+            for (int r = 0; r < PL_ARRAY_SIZE(resolutions); r++) {
+                if (all || strcmp(val, resolutions[r].name) == 0) {
+                    o->res[r] = true;
+                    found = true;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "Unknown resolution '%s'\n", val);
+                return false;
+            }
+            have_res = true;
+        } else if (strcmp(arg, "--duration") == 0) {
+            o->duration = atof(val);
+            if (o->duration <= 0) {
+                fprintf(stderr, "Invalid duration '%s'\n", val);
+                return false;
+            }
+        } else if (strcmp(arg, "--filter") == 0) {
+            o->filter = val;
+        } else if (strcmp(arg, "--json") == 0) {
+            o->json = val;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            o->baseline = val;
+        } else if (strcmp(arg, "--save-baseline") == 0) {
+            o->save_baseline = val;
+        } else if (strcmp(arg, "--tolerance") == 0) {
+            o->tolerance = atof(val);
+            if (o->tolerance < 0) {
+                fprintf(stderr, "Invalid tolerance '%s'\n", val);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", arg);
+            return false;
+        }
+    }
+
+    if (!have_res)
+        o->res[0] = true;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    setbuf(stdout, NULL);
+    setbuf(stderr, NULL);
+
+    struct bench_opts o;
+    if (!parse_opts(argc, argv, &o)) {
+        usage(argv[0]);
+        return 1;
+    }
+    opts = &o;
+
+    struct pl_context *ctx;
+    ctx = pl_context_create(PL_API_VER, &(struct pl_context_params) {
+        .log_cb     = isatty(fileno(stderr)) ? pl_log_color : pl_log_simple,
+        .log_priv   = stderr,
+        .log_level  = PL_LOG_WARN,
+    });
+
+    if (!o.json || strcmp(o.json, "-") != 0)
+        printf("= Running benchmarks =\n");
+
+#ifdef PL_HAVE_VULKAN
+    if (o.vulkan)
+        bench_vulkan(ctx);
+#endif
+
+#ifdef PL_HAVE_OPENGL
+    if (o.opengl)
+        bench_opengl(ctx);
+#endif
+
+    if (o.cpu)
+        bench_cpu();
 
-    pl_vulkan_destroy(&vk);
     pl_context_destroy(&ctx);
+
+    if (!num_results)
+        return SKIP;
+
+    if (o.json) {
+        bool use_stdout = strcmp(o.json, "-") == 0;
+        FILE *f = use_stdout ? stdout : fopen(o.json, "w");
+        if (!f) {
+            fprintf(stderr, "Failed opening '%s' for writing\n", o.json);
+            return 1;
+        }
+
+        write_json(f);
+        if (!use_stdout)
+            fclose(f);
+    }
+
+    if (o.save_baseline && !save_baseline(o.save_baseline))
+        return 1;
+
+    if (o.baseline && check_baseline(o.baseline) != 0)
+        return 1;
+
     return 0;
 }
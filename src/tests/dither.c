@@ -15,13 +15,24 @@ int main()
     }
 
     printf("Blue noise dither matrix:\n");
-    pl_generate_blue_noise(&data[0][0], SHIFT);
+    pl_generate_blue_noise(&data[0][0], SIZE);
     for (int y = 0; y < SIZE; y++) {
         for (int x = 0; x < SIZE; x++)
             printf(" %3d", (int)(data[y][x] * SIZE * SIZE));
         printf("\n");
     }
 
+    // Every value must be used exactly once
+    bool seen[SIZE * SIZE] = {0};
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            int v = data[y][x] * SIZE * SIZE;
+            REQUIRE(v >= 0 && v < SIZE * SIZE);
+            REQUIRE(!seen[v]);
+            seen[v] = true;
+        }
+    }
+
     // Generate an example of a dither shader
     struct pl_context *ctx = pl_test_context();
     struct pl_shader *sh = pl_shader_alloc(ctx, NULL);
@@ -1,11 +1,38 @@
 #include "gpu_tests.h"
 
+#include <libplacebo/utils/governor.h>
+#include <libplacebo/utils/render_pool.h>
+
+static void tier_cb(void *priv, int tier)
+{
+    *(int *) priv = tier;
+}
+
+static void trace_cb(void *priv, const struct pl_trace_event *ev)
+{
+    if (strcmp(ev->category, "gpu") == 0 && strcmp(ev->name, "upload") == 0) {
+        REQUIRE(ev->thread > 0 && ev->start_ns);
+        (*(int *) priv)++;
+    }
+}
+
 int main()
 {
     struct pl_context *ctx = pl_test_context();
     const struct pl_gpu *gpu = pl_gpu_dummy_create(ctx, NULL);
     pl_buffer_tests(gpu);
     pl_texture_tests(gpu);
+    pl_fmt_lookup_tests(gpu);
+    pl_lut_cache_tests(gpu);
+    pl_offscreen_tests(gpu);
+    pl_repack_tests(gpu);
+    pl_overlay_atlas_tests(gpu);
+
+    // DRM fourcc codes are derived from the host memory layout
+    REQUIRE(pl_find_named_fmt(gpu, "r8")->fourcc == 0x20203852);    // 'R8  '
+    REQUIRE(pl_find_named_fmt(gpu, "rg16")->fourcc == 0x32335247);  // 'GR32'
+    REQUIRE(pl_find_named_fmt(gpu, "rgba8")->fourcc == 0x34324241); // 'AB24'
+    REQUIRE(!pl_find_named_fmt(gpu, "rgba32f")->fourcc);
 
     // Attempt creating a shader and accessing the resulting LUT
     const struct pl_tex *dummy = pl_tex_dummy_create(gpu, &(struct pl_tex_dummy_params) {
@@ -62,6 +89,437 @@ int main()
     REQUIRE(res->input == PL_SHADER_SIG_SAMPLER);
     printf("generated sampler2D shader:\n\n%s\n", res->glsl);
 
+    // Regenerating the same shader must result in the same signature
+    uint64_t sig = pl_shader_signature(sh);
+    pl_shader_reset(sh, &(struct pl_shader_params) { .gpu = gpu });
+    REQUIRE(pl_shader_sample_polar(sh, &src, &filter_params));
+    REQUIRE(pl_shader_finalize(sh));
+    REQUIRE(pl_shader_signature(sh) == sig);
+
+    pl_shader_reset(sh, &(struct pl_shader_params) { .gpu = gpu });
+    REQUIRE(pl_shader_sample_direct(sh, &src));
+    REQUIRE(pl_shader_finalize(sh));
+    REQUIRE(pl_shader_signature(sh) != sig);
+
+    // Sampling the same texture from multiple subpasses must only bind it once
+    pl_shader_reset(sh, &(struct pl_shader_params) { .gpu = gpu });
+    struct pl_shader *sub = pl_shader_alloc(ctx, &(struct pl_shader_params) {
+        .gpu = gpu,
+        .id = 1,
+    });
+    REQUIRE(pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = dummy }));
+    REQUIRE(pl_shader_sample_direct(sub, &(struct pl_sample_src) { .tex = dummy }));
+    REQUIRE(sh_subpass(sh, sub));
+    REQUIRE((res = pl_shader_finalize(sh)));
+    REQUIRE(res->num_descriptors == 1);
+    pl_shader_free(&sub);
+
+    // Flexible work group sizes must be recorded as such, so they can be
+    // grown, overridden by rigid ones and tuned by the dispatch
+    pl_shader_reset(sh, &(struct pl_shader_params) { .gpu = gpu });
+    REQUIRE(sh_try_compute(sh, 8, 8, true, 0));
+    REQUIRE(sh->flexible_work_groups);
+    REQUIRE(sh_try_compute(sh, 16, 4, true, 0));
+    REQUIRE(sh->flexible_work_groups);
+    REQUIRE(sh->res.compute_group_size[0] == 16);
+    REQUIRE(sh->res.compute_group_size[1] == 8);
+    REQUIRE(sh_try_compute(sh, 32, 2, false, 0));
+    REQUIRE(!sh->flexible_work_groups);
+    REQUIRE(sh->res.compute_group_size[0] == 32);
+    REQUIRE(sh->res.compute_group_size[1] == 2);
+    REQUIRE(sh_try_compute(sh, 64, 64, true, 0));
+    REQUIRE(!sh->flexible_work_groups);
+    REQUIRE(sh->res.compute_group_size[0] == 32);
+    REQUIRE(!sh_try_compute(sh, 16, 16, false, 0));
+
+    // Bake a tone mapping curve into a LUT
+    struct pl_shader_obj *tone_map = NULL;
+    struct pl_color_map_params cparams = pl_color_map_default_params;
+    cparams.tone_mapping_lut_size = 64;
+    pl_shader_reset(sh, &(struct pl_shader_params) { .gpu = gpu });
+    REQUIRE(pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = dummy }));
+    pl_shader_color_map(sh, &cparams, pl_color_space_hdr10,
+                        pl_color_space_monitor, &tone_map, false);
+    REQUIRE((res = pl_shader_finalize(sh)));
+
+    const float *curve = NULL;
+    for (int n = 0; n < res->num_descriptors; n++) {
+        const struct pl_tex *tex = res->descriptors[n].object;
+        if (res->descriptors[n].desc.type == PL_DESC_SAMPLED_TEX && tex != dummy)
+            curve = (float *) pl_tex_dummy_data(tex);
+    }
+
+    REQUIRE(curve);
+    REQUIRE(curve[0] == 0.0);
+    REQUIRE(fabs(curve[63] - 1.0) < 1e-3);
+    for (int i = 1; i < 64; i++)
+        REQUIRE(curve[i] >= curve[i - 1]);
+    pl_shader_obj_destroy(&tone_map);
+
+    // Test (de)serialization of an empty dispatch cache
+    struct pl_dispatch *dp = pl_dispatch_create(ctx, gpu);
+    size_t cache_size = pl_dispatch_save(dp, NULL);
+    uint8_t *cache = malloc(cache_size);
+    REQUIRE(cache);
+    REQUIRE(pl_dispatch_save(dp, cache) == cache_size);
+    pl_dispatch_load(dp, cache, cache_size);
+    pl_dispatch_load(dp, cache, cache_size - 1); // truncated
+    REQUIRE(pl_dispatch_save(dp, NULL) == cache_size);
+    pl_dispatch_destroy(&dp);
+    free(cache);
+
+    // Distribute jobs across two (identical) GPUs
+    const struct pl_gpu *gpu2 = pl_gpu_dummy_create(ctx, NULL);
+    const struct pl_gpu *gpus[] = { gpu, gpu2 };
+    struct pl_render_pool *pool;
+    pool = pl_render_pool_create(ctx, &(struct pl_render_pool_params) {
+        .gpus = gpus,
+        .num_gpus = 2,
+    });
+    REQUIRE(pool);
+
+    struct pl_render_job jobs[3];
+    for (int i = 0; i < 3; i++) {
+        pl_render_pool_begin(pool, &jobs[i]);
+        REQUIRE(jobs[i].index == i % 2);
+        REQUIRE(jobs[i].gpu == gpus[i % 2] && jobs[i].renderer);
+    }
+    for (int i = 0; i < 3; i++)
+        pl_render_pool_done(pool, &jobs[i]);
+    pl_render_pool_destroy(&pool);
+
+    pool = pl_render_pool_create(ctx, &(struct pl_render_pool_params) {
+        .gpus = gpus,
+        .num_gpus = 2,
+        .mode = PL_RENDER_POOL_LEAST_LOADED,
+    });
+    REQUIRE(pool);
+
+    pl_render_pool_begin(pool, &jobs[0]);
+    pl_render_pool_begin(pool, &jobs[1]);
+    pl_render_pool_begin(pool, &jobs[2]);
+    REQUIRE(pl_render_pool_load(pool, 0) == 2);
+    REQUIRE(pl_render_pool_load(pool, 1) == 1);
+    pl_render_pool_done(pool, &jobs[0]);
+    pl_render_pool_done(pool, &jobs[2]);
+    pl_render_pool_begin(pool, &jobs[0]);
+    REQUIRE(jobs[0].index == 0);
+    pl_render_pool_done(pool, &jobs[0]);
+    pl_render_pool_done(pool, &jobs[1]);
+    pl_render_pool_destroy(&pool);
+    pl_gpu_dummy_destroy(&gpu2);
+
+    // Trace a texture upload
+    int num_uploads = 0;
+    struct pl_context_params ctx_params = ctx->params;
+    ctx_params.trace_cb = trace_cb;
+    ctx_params.trace_priv = &num_uploads;
+    pl_context_update(ctx, &ctx_params);
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 16,
+        .h = 16,
+        .format = pl_find_named_fmt(gpu, "r8"),
+        .host_writable = true,
+    });
+    static const uint8_t zero[16 * 16];
+    REQUIRE(tex);
+    struct pl_gpu_stats before, after;
+    pl_gpu_stats(gpu, &before);
+    REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = (void *) zero,
+    }));
+    REQUIRE(num_uploads == 1);
+    pl_gpu_stats(gpu, &after);
+    REQUIRE(after.bytes_uploaded - before.bytes_uploaded == sizeof(zero));
+    REQUIRE(after.textures_created >= 1);
+    pl_tex_destroy(gpu, &tex);
+    ctx_params.trace_cb = NULL;
+    pl_context_update(ctx, &ctx_params);
+
+    // Without GPU timers, the governor stays in the requested tier, and the
+    // cheaper tiers never use more expensive features than the ones above
+    int cb_tier = -1;
+    struct pl_renderer *rr = pl_renderer_create(ctx, gpu);
+    struct pl_render_governor *gov;
+    gov = pl_render_governor_create(ctx, &(struct pl_render_governor_params) {
+        .params = &pl_render_high_quality_params,
+        .target_ns = 1000000000 / 60,
+        .tier_cb = tier_cb,
+        .priv = &cb_tier,
+    });
+    REQUIRE(rr && gov);
+
+    for (int i = 0; i < 100; i++) {
+        const struct pl_render_params *par = pl_render_governor_update(gov, rr);
+        REQUIRE(par == pl_render_governor_params(gov, 0));
+        REQUIRE(par->measure_timing);
+    }
+    REQUIRE(cb_tier == -1);
+
+    pl_render_governor_set_tier(gov, PL_RENDER_GOVERNOR_TIERS);
+    REQUIRE(cb_tier == PL_RENDER_GOVERNOR_TIERS - 1);
+    REQUIRE(pl_render_governor_tier(gov) == cb_tier);
+    const struct pl_render_params *low = pl_render_governor_update(gov, rr);
+    REQUIRE(!low->upscaler && !low->deband_params && !low->peak_detect_params);
+
+    for (int i = 1; i < PL_RENDER_GOVERNOR_TIERS; i++) {
+        const struct pl_render_params *a = pl_render_governor_params(gov, i - 1);
+        const struct pl_render_params *b = pl_render_governor_params(gov, i);
+        REQUIRE(!b->upscaler || !b->upscaler->polar);
+        REQUIRE(!b->deband_params || b->deband_params->iterations <=
+                                     a->deband_params->iterations);
+        REQUIRE(!b->peak_detect_params || a->peak_detect_params);
+    }
+
+    pl_render_governor_destroy(&gov);
+    pl_renderer_destroy(&rr);
+
+    // CPU rendering of an RGB image at its native size must be lossless
+    uint8_t rgb[8 * 8 * 4];
+    for (int i = 0; i < sizeof(rgb); i++)
+        rgb[i] = i * 7;
+
+    const struct pl_tex *img_tex, *fbo;
+    img_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 8,
+        .h = 8,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .sampleable = true,
+        .initial_data = rgb,
+    });
+    fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 8,
+        .h = 8,
+        .format = pl_find_named_fmt(gpu, "rgba32f"),
+        .renderable = true,
+    });
+    REQUIRE(img_tex && fbo);
+
+    struct pl_image image = {
+        .num_planes = 1,
+        .planes = {{
+            .texture = img_tex,
+            .components = 4,
+            .component_mapping = {0, 1, 2, 3},
+        }},
+        .repr = pl_color_repr_rgb,
+        .color = pl_color_space_srgb,
+    };
+
+    struct pl_render_target target = {
+        .fbo = fbo,
+        .repr = pl_color_repr_rgb,
+        .color = pl_color_space_srgb,
+    };
+
+    struct pl_dummy_render_params rparams = pl_dummy_render_default_params;
+    rparams.threads = 3;
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, &rparams));
+    const float *out = (float *) pl_tex_dummy_data(fbo);
+    for (int i = 0; i < 8 * 8 * 4; i++) {
+        float ref = (i % 4 == 3) ? 1.0 : rgb[i] / 255.0;
+        REQUIRE(fabs(out[i] - ref) < 1e-5);
+    }
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &img_tex);
+
+    // Upscaling a flat gray 4:2:0 YCbCr image to an 8-bit target
+    static const uint8_t luma[4 * 4] = {
+        126, 126, 126, 126, 126, 126, 126, 126,
+        126, 126, 126, 126, 126, 126, 126, 126,
+    };
+    static const uint8_t chroma[2 * 2 * 2] = {
+        128, 128, 128, 128, 128, 128, 128, 128,
+    };
+
+    const struct pl_tex *luma_tex, *chroma_tex;
+    luma_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 4,
+        .h = 4,
+        .format = pl_find_named_fmt(gpu, "r8"),
+        .sampleable = true,
+        .initial_data = luma,
+    });
+    chroma_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 2,
+        .h = 2,
+        .format = pl_find_named_fmt(gpu, "rg8"),
+        .sampleable = true,
+        .initial_data = chroma,
+    });
+    fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 10,
+        .h = 6,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .renderable = true,
+    });
+    REQUIRE(luma_tex && chroma_tex && fbo);
+
+    image = (struct pl_image) {
+        .num_planes = 2,
+        .planes = {
+            {
+                .texture = luma_tex,
+                .components = 1,
+                .component_mapping = {PL_CHANNEL_Y},
+            }, {
+                .texture = chroma_tex,
+                .components = 2,
+                .component_mapping = {PL_CHANNEL_CB, PL_CHANNEL_CR},
+            },
+        },
+        .repr = {
+            .sys = PL_COLOR_SYSTEM_BT_709,
+            .levels = PL_COLOR_LEVELS_TV,
+        },
+        .color = pl_color_space_bt709,
+    };
+    pl_image_set_chroma_location(&image, PL_CHROMA_LEFT);
+
+    target.fbo = fbo;
+    target.color = pl_color_space_bt709;
+    rparams = pl_dummy_render_default_params;
+    rparams.scaler = &pl_filter_catmull_rom;
+    rparams.dither = false;
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, &rparams));
+    const uint8_t *out8 = pl_tex_dummy_data(fbo);
+    for (int i = 0; i < 10 * 6 * 4; i++)
+        REQUIRE(out8[i] == (i % 4 == 3 ? 255 : 128));
+
+    // Polar scalers are not supported
+    rparams.scaler = &pl_filter_ewa_lanczos;
+    REQUIRE(!pl_dummy_render_image(gpu, &image, &target, &rparams));
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &chroma_tex);
+    pl_tex_destroy(gpu, &luma_tex);
+
+    // Upscaling gradients and a checkerboard must match bilinear sampling
+    uint8_t pattern[8 * 4 * 4];
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 8; x++) {
+            uint8_t *px = &pattern[(y * 8 + x) * 4];
+            px[0] = x * 255 / 7;
+            px[1] = y * 255 / 3;
+            px[2] = ((x ^ y) & 1) ? 255 : 0;
+            px[3] = 255;
+        }
+    }
+
+    img_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 8,
+        .h = 4,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .sampleable = true,
+        .initial_data = pattern,
+    });
+    fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 16,
+        .h = 8,
+        .format = pl_find_named_fmt(gpu, "rgba32f"),
+        .renderable = true,
+    });
+    REQUIRE(img_tex && fbo);
+
+    image = (struct pl_image) {
+        .num_planes = 1,
+        .planes = {{
+            .texture = img_tex,
+            .components = 4,
+            .component_mapping = {0, 1, 2, 3},
+        }},
+        .repr = pl_color_repr_rgb,
+        .color = pl_color_space_srgb,
+    };
+
+    target = (struct pl_render_target) {
+        .fbo = fbo,
+        .repr = pl_color_repr_rgb,
+        .color = pl_color_space_srgb,
+    };
+
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, NULL));
+    out = (float *) pl_tex_dummy_data(fbo);
+    for (int y = 0; y < 8; y++) {
+        float py = PL_MAX((y + 0.5) / 2 - 0.5, 0.0);
+        int y0 = py, y1 = PL_MIN(y0 + 1, 3);
+        for (int x = 0; x < 16; x++) {
+            float px = PL_MAX((x + 0.5) / 2 - 0.5, 0.0);
+            int x0 = px, x1 = PL_MIN(x0 + 1, 7);
+            float fx = px - x0, fy = py - y0;
+            for (int c = 0; c < 3; c++) {
+                #define P(x, y) (pattern[((y) * 8 + (x)) * 4 + c] / 255.0)
+                float ref = (1 - fy) * ((1 - fx) * P(x0, y0) + fx * P(x1, y0)) +
+                                  fy * ((1 - fx) * P(x0, y1) + fx * P(x1, y1));
+                #undef P
+                REQUIRE(fabs(out[(y * 16 + x) * 4 + c] - ref) < 5e-3);
+            }
+        }
+    }
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &img_tex);
+
+    // P010-style samples (10 bits in the high bits of 16) must round-trip,
+    // and be quantized correctly to lower depths
+    uint16_t p010[4 * 2 * 4];
+    for (int i = 0; i < PL_ARRAY_SIZE(p010); i++)
+        p010[i] = (i % 4 == 3 ? 1023 : (i * 97) % 1024) << 6;
+
+    const struct pl_bit_encoding p010_bits = {
+        .sample_depth = 16,
+        .color_depth = 10,
+        .bit_shift = 6,
+    };
+
+    img_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 4,
+        .h = 2,
+        .format = pl_find_named_fmt(gpu, "rgba16"),
+        .sampleable = true,
+        .initial_data = p010,
+    });
+    fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 4,
+        .h = 2,
+        .format = pl_find_named_fmt(gpu, "rgba16"),
+        .renderable = true,
+    });
+    const struct pl_tex *fbo8 = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 4,
+        .h = 2,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+        .renderable = true,
+    });
+    REQUIRE(img_tex && fbo && fbo8);
+
+    image.planes[0].texture = img_tex;
+    image.repr.bits = p010_bits;
+    target.fbo = fbo;
+    target.repr.bits = p010_bits;
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, NULL));
+    const uint16_t *out16 = (uint16_t *) pl_tex_dummy_data(fbo);
+    for (int i = 0; i < PL_ARRAY_SIZE(p010); i++)
+        REQUIRE(out16[i] == (i % 4 == 3 ? UINT16_MAX : p010[i]));
+
+    target.fbo = fbo8;
+    target.repr.bits = (struct pl_bit_encoding) {0};
+    rparams = pl_dummy_render_default_params;
+    rparams.dither = false;
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, &rparams));
+    out8 = pl_tex_dummy_data(fbo8);
+    for (int i = 0; i < PL_ARRAY_SIZE(p010); i++)
+        REQUIRE(out8[i] == (int) lrint((p010[i] >> 6) * 255.0 / 1023));
+
+    // Dithering only ever picks one of the two neighbouring values
+    REQUIRE(pl_dummy_render_image(gpu, &image, &target, NULL));
+    for (int i = 0; i < PL_ARRAY_SIZE(p010); i++) {
+        float ref = (p010[i] >> 6) * 255.0 / 1023;
+        REQUIRE(out8[i] == (int) floorf(ref) || out8[i] == (int) ceilf(ref));
+    }
+    pl_tex_destroy(gpu, &fbo8);
+    pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &img_tex);
+
     pl_shader_free(&sh);
     pl_shader_obj_destroy(&lut);
     pl_tex_destroy(gpu, &dummy);
@@ -1,5 +1,14 @@
+#include <time.h>
+
 #include "tests.h"
 
+static double time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
 int main()
 {
     struct pl_context *ctx = pl_test_context();
@@ -33,7 +42,95 @@ int main()
             }
         }
 
+        // Ensure multi-threaded generation gives identical results
+        struct pl_filter_params tparams = params;
+        tparams.threads = 4;
+        const struct pl_filter *tflt = pl_filter_generate(ctx, &tparams);
+        REQUIRE(tflt);
+        REQUIRE(tflt->row_stride == flt->row_stride);
+        size_t num = params.lut_entries * PL_DEF(flt->row_stride, 1);
+        REQUIRE(memcmp(tflt->weights, flt->weights, num * sizeof(float)) == 0);
+        REQUIRE(tflt->radius_cutoff == flt->radius_cutoff);
+
+        // Ensure the weights survive being stored as half floats, as done for
+        // the LUT textures, with sufficient accuracy
+        for (int i = 0; i < num; i++) {
+            float w = flt->weights[i];
+            float h = pl_half_to_float(pl_float_to_half(w));
+            REQUIRE(feq(h, w, 5e-4));
+        }
+
+        // Ensure the rows of separable filters still add up to unity after
+        // being rounded to half floats for the LUT
+        float *row = malloc(PL_DEF(flt->row_size, 1) * sizeof(float));
+        REQUIRE(row);
+        for (int i = 0; !params.config.polar && i < params.lut_entries; i++) {
+            float sum = 0.0;
+            memcpy(row, &flt->weights[i * flt->row_stride],
+                   flt->row_size * sizeof(float));
+            pl_weights_round_half(row, flt->row_size);
+            for (int n = 0; n < flt->row_size; n++) {
+                REQUIRE(pl_half_to_float(pl_float_to_half(row[n])) == row[n]);
+                sum += row[n];
+            }
+            REQUIRE(feq(sum, 1.0, 1e-6));
+        }
+        free(row);
+
+        pl_filter_free(&tflt);
         pl_filter_free(&flt);
     }
+
+    // Test the half float conversion itself, including rounding and the
+    // subnormal and overflow edge cases
+    REQUIRE(pl_float_to_half(1.0f) == 0x3C00);
+    REQUIRE(pl_float_to_half(-2.0f) == 0xC000);
+    REQUIRE(pl_float_to_half(65504.0f) == 0x7BFF);
+    REQUIRE(pl_float_to_half(65520.0f) == 0x7C00);
+    REQUIRE(pl_float_to_half(1.0f + 1.0f / 2048) == 0x3C00); // tie to even
+    REQUIRE(pl_float_to_half(1.0f + 3.0f / 2048) == 0x3C02);
+    REQUIRE(pl_float_to_half(1.0f / (1 << 24)) == 0x0001);
+    REQUIRE(pl_float_to_half(1.0f / (1 << 25)) == 0x0000);
+    REQUIRE(pl_float_to_half(-1.0f / (1 << 14)) == 0x8400);
+    for (int i = 0; i < 0x7C00; i++)
+        REQUIRE(pl_float_to_half(pl_half_to_float(i)) == i);
+
+    // Filter configs must hash by value, consistent with pl_filter_config_eq
+    struct pl_filter_function kernel = *pl_filter_lanczos.kernel;
+    struct pl_filter_config a = pl_filter_lanczos, b = a;
+    b.kernel = &kernel;
+    REQUIRE(pl_filter_config_eq(&a, &b));
+    REQUIRE(pl_filter_config_hash(&a) == pl_filter_config_hash(&b));
+    b.blur = 1.1;
+    REQUIRE(pl_filter_config_hash(&a) != pl_filter_config_hash(&b));
+    b.blur = a.blur;
+    kernel.params[0] += 1.0; // non-tunable, ignored
+    REQUIRE(pl_filter_config_hash(&a) == pl_filter_config_hash(&b));
+    REQUIRE(pl_filter_config_hash(NULL) == 0);
+
+    // Benchmark the generation of large LUTs
+    static const char *bench_filters[] = { "ewa_lanczos", "lanczos" };
+    for (int i = 0; i < PL_ARRAY_SIZE(bench_filters); i++) {
+        const struct pl_named_filter_config *conf;
+        conf = pl_find_named_filter(bench_filters[i]);
+        REQUIRE(conf);
+
+        for (int threads = 1; threads <= 4; threads *= 2) {
+            struct pl_filter_params params = {
+                .config       = *conf->filter,
+                .lut_entries  = 1024,
+                .filter_scale = 8.0,
+                .threads      = threads,
+            };
+
+            double start = time_ms();
+            const struct pl_filter *flt = pl_filter_generate(ctx, &params);
+            REQUIRE(flt);
+            printf("Generating '%s' (%d entries, %d threads): %.3f ms\n",
+                   conf->name, params.lut_entries, threads, time_ms() - start);
+            pl_filter_free(&flt);
+        }
+    }
+
     pl_context_destroy(&ctx);
 }
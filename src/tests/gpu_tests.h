@@ -1,5 +1,9 @@
 #include "tests.h"
 #include "shaders.h"
+#include "dispatch.h"
+
+#include <libplacebo/utils/blit.h>
+#include <libplacebo/utils/upload.h>
 
 static uint8_t test_src[16*16*16 * 4 * sizeof(double)] = {0};
 static uint8_t test_dst[16*16*16 * 4 * sizeof(double)] = {0};
@@ -58,9 +62,42 @@ static void pl_buffer_tests(const struct pl_gpu *gpu)
         REQUIRE(!pl_buf_poll(gpu, buf, 0));
         REQUIRE(memcmp(test_src, buf->data, buf_size) == 0);
         pl_buf_destroy(gpu, &buf);
+
+        printf("test streaming buffer ring sub-allocation\n");
+        struct pl_buf_ring ring = {0};
+        struct pl_buf_params params = {
+            .type = PL_BUF_TEX_TRANSFER,
+            .host_writable = true,
+        };
+
+        size_t offset, prev_end = 0;
+        const struct pl_buf *prev = NULL;
+        for (int i = 0; i < 8; i++) {
+            params.size = 100 + 37 * i;
+            buf = pl_buf_ring_alloc(gpu, &ring, &params, 16, &offset);
+            REQUIRE(buf && buf->data);
+            REQUIRE(offset % 16 == 0);
+            REQUIRE(offset + params.size <= buf->params.size);
+            if (buf == prev)
+                REQUIRE(offset >= prev_end);
+            memcpy(buf->data + offset, test_src, params.size);
+            prev = buf;
+            prev_end = offset + params.size;
+        }
+
+        // Transfers larger than the ring's buffers must still succeed
+        params.size = PL_BUF_RING_MIN_SIZE + 1;
+        buf = pl_buf_ring_alloc(gpu, &ring, &params, 16, &offset);
+        REQUIRE(buf && offset == 0 && buf->params.size >= params.size);
+        pl_buf_ring_uninit(gpu, &ring);
     }
 }
 
+static void count_cb(void *priv)
+{
+    (*(int *) priv)++;
+}
+
 static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex[2],
                               uint8_t *src, uint8_t *dst)
 {
@@ -84,11 +121,14 @@ static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex
     struct pl_timer *ul, *dl;
     ul = pl_timer_create(gpu);
     dl = pl_timer_create(gpu);
+    int ul_done = 0, dl_done = 0;
 
     REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params){
         .tex = tex[0],
         .ptr = src,
         .timer = ul,
+        .callback = count_cb,
+        .priv = &ul_done,
     }));
 
     // Test blitting, if possible for this format
@@ -112,8 +152,14 @@ static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex
         .tex = dst_tex,
         .ptr = dst,
         .timer = dl,
+        .callback = count_cb,
+        .priv = &dl_done,
     }));
 
+    // The download may happen asynchronously, since we set a callback
+    pl_gpu_finish(gpu);
+    REQUIRE(ul_done == 1 && dl_done == 1);
+
     if (fmt->emulated && fmt->type == PL_FMT_FLOAT) {
         // TODO: can't memcmp here because bits might be lost due to the
         // emulated 16/32 bit upload paths, figure out a better way to
@@ -131,6 +177,75 @@ static void pl_test_roundtrip(const struct pl_gpu *gpu, const struct pl_tex *tex
     pl_timer_destroy(gpu, &dl);
 }
 
+static void pl_fmt_lookup_tests(const struct pl_gpu *gpu)
+{
+    // Repeat all lookups, to make sure the memoized results (including ones
+    // evicted by colliding entries) match the initial ones
+    static const int depths[] = { 0, 8, 16, 32 };
+    static const enum pl_fmt_caps caps[] = {
+        0, PL_FMT_CAP_SAMPLEABLE, PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_LINEAR,
+    };
+
+    const struct pl_fmt *res[PL_FMT_TYPE_COUNT][4][4][4][3];
+    for (int pass = 0; pass < 2; pass++) {
+        for (enum pl_fmt_type t = 1; t < PL_FMT_TYPE_COUNT; t++) {
+            for (int c = 0; c < 4; c++) {
+                for (int d = 0; d < PL_ARRAY_SIZE(depths); d++) {
+                    for (int h = 0; h < PL_ARRAY_SIZE(depths); h++) {
+                        for (int k = 0; k < PL_ARRAY_SIZE(caps); k++) {
+                            const struct pl_fmt *fmt;
+                            fmt = pl_find_fmt(gpu, t, c + 1, depths[d],
+                                              depths[h], caps[k]);
+                            if (pass) {
+                                REQUIRE(fmt == res[t][c][d][h][k]);
+                                continue;
+                            }
+
+                            res[t][c][d][h][k] = fmt;
+                            if (!fmt)
+                                continue;
+                            REQUIRE(fmt->type == t);
+                            REQUIRE(fmt->num_components == c + 1);
+                            REQUIRE((fmt->caps & caps[k]) == caps[k]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int f = 0; f < gpu->num_formats; f++) {
+        const struct pl_fmt *fmt = gpu->formats[f];
+        if (fmt->opaque || !pl_fmt_is_ordered(fmt))
+            continue;
+        if (!(fmt->caps & PL_FMT_CAP_SAMPLEABLE))
+            continue;
+        if (fmt->type == PL_FMT_UINT || fmt->type == PL_FMT_SINT)
+            continue;
+
+        struct pl_plane_data data = {
+            .type = fmt->type,
+            .pixel_stride = fmt->texel_size,
+        };
+
+        for (int i = 0; i < fmt->num_components; i++) {
+            data.component_size[i] = fmt->host_bits[i];
+            data.component_map[i] = fmt->num_components - 1 - i;
+        }
+
+        int map[2][4];
+        const struct pl_fmt *found[2];
+        for (int i = 0; i < 2; i++)
+            found[i] = pl_plane_find_fmt(gpu, map[i], &data);
+
+        REQUIRE(found[0]);
+        REQUIRE(found[0] == found[1]);
+        REQUIRE(memcmp(map[0], map[1], sizeof(map[0])) == 0);
+        for (int i = 0; i < fmt->num_components; i++)
+            REQUIRE(map[0][i] == fmt->num_components - 1 - i);
+    }
+}
+
 static void pl_texture_tests(const struct pl_gpu *gpu)
 {
     for (int f = 0; f < gpu->num_formats; f++) {
@@ -188,7 +303,103 @@ static void pl_texture_tests(const struct pl_gpu *gpu)
                 pl_tex_destroy(gpu, &tex[i]);
         }
     }
+
+    // Batched multi-plane uploads, re-using the staging buffer
+    printf("testing batched plane uploads\n");
+    struct pl_plane_data planes[3];
+    for (int i = 0; i < PL_ARRAY_SIZE(planes); i++) {
+        planes[i] = (struct pl_plane_data) {
+            .type = PL_FMT_UNORM,
+            .width = i ? 8 : 16,
+            .height = i ? 8 : 16,
+            .component_size = { 8 },
+            .component_map = { i },
+            .pixel_stride = 1,
+            .pixels = test_src + i * 256,
+        };
+    }
+
+    const struct pl_tex *ptex[3] = {0};
+    const struct pl_buf *staging = NULL;
+    struct pl_plane out[3];
+    for (int n = 0; n < 2; n++) {
+        REQUIRE(pl_upload_planes(gpu, out, ptex, planes, 3, &staging));
+        for (int i = 0; i < PL_ARRAY_SIZE(out); i++) {
+            REQUIRE(out[i].texture == ptex[i]);
+            REQUIRE(ptex[i]->params.w == planes[i].width);
+        }
+    }
+
+    // Padded rows, where the final row ends right after its last texel
+    uint8_t padded[7 * 12 + 8];
+    memcpy(padded, test_src, sizeof(padded));
+    planes[1].row_stride = 12;
+    planes[1].pixels = padded;
+    REQUIRE(pl_upload_planes(gpu, out, ptex, planes, 3, &staging));
+
+    for (int i = 0; i < PL_ARRAY_SIZE(ptex); i++)
+        pl_tex_destroy(gpu, &ptex[i]);
+    pl_buf_destroy(gpu, &staging);
+
+    // Texture pool, released textures should be reused by compatible requests
+    const struct pl_fmt *pool_fmt = pl_find_named_fmt(gpu, "rgba8");
+    if (pool_fmt && (pool_fmt->caps & PL_FMT_CAP_SAMPLEABLE)) {
+        printf("testing texture pool\n");
+        struct pl_tex_params pool_params = {
+            .w = 16,
+            .h = 16,
+            .format = pool_fmt,
+            .sampleable = true,
+        };
+
+        const struct pl_tex *a = pl_tex_pool_get(gpu, &pool_params);
+        const struct pl_tex *orig = a;
+        REQUIRE(a);
+        pl_tex_pool_put(gpu, &a);
+        REQUIRE(!a);
+
+        pool_params.w = 8;
+        const struct pl_tex *b = pl_tex_pool_get(gpu, &pool_params);
+        REQUIRE(b && b != orig);
+
+        pool_params.w = 16;
+        a = pl_tex_pool_get(gpu, &pool_params);
+        REQUIRE(a == orig);
+
+        pl_tex_destroy(gpu, &a);
+        pl_tex_destroy(gpu, &b);
+    }
+}
+
+#ifdef PL_HAVE_LCMS
+struct test_lut_cache {
+    uint64_t signature;
+    void *data;
+    size_t size;
+    int hits, saves;
+};
+
+static bool test_lut_cache_load(void *priv, uint64_t sig, void *data, size_t size)
+{
+    struct test_lut_cache *cache = priv;
+    if (!cache->data || cache->signature != sig || cache->size != size)
+        return false;
+    memcpy(data, cache->data, size);
+    cache->hits++;
+    return true;
+}
+
+static void test_lut_cache_save(void *priv, uint64_t sig, const void *data,
+                                size_t size)
+{
+    struct test_lut_cache *cache = priv;
+    talloc_free(cache->data);
+    cache->data = talloc_memdup(NULL, (void *) data, size);
+    cache->signature = sig;
+    cache->size = size;
+    cache->saves++;
 }
+#endif
 
 static void pl_shader_tests(const struct pl_gpu *gpu)
 {
@@ -373,6 +584,19 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
         TEST_FBO_PATTERN(epsilon, "color system %d", (int) sys);
     }
 
+    // Test the same round trip with the matrices folded into the shader
+    pl_dispatch_set_specialize_constants(dp, true);
+    sh = pl_dispatch_begin(dp);
+    pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+    pl_shader_encode_color(sh, &(struct pl_color_repr) { .sys = PL_COLOR_SYSTEM_BT_709 });
+    pl_shader_decode_color(sh, &(struct pl_color_repr) { .sys = PL_COLOR_SYSTEM_BT_709 }, NULL);
+    REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+    }));
+    pl_dispatch_set_specialize_constants(dp, false);
+    TEST_FBO_PATTERN(1e-6, "%s", "specialized constants");
+
     for (enum pl_color_light light = 0; light < PL_COLOR_LIGHT_COUNT; light++) {
         sh = pl_dispatch_begin(dp);
         struct pl_color_space src_space = { .light = light };
@@ -411,10 +635,70 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
         REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
             .shader = &sh,
             .target = fbo,
+            .async  = i % 2, // exercise the async compute queue, if any
         }));
         TEST_FBO_PATTERN(1e-6, "deband iter %d", i);
     }
 
+    // Test work group size tuning, which must not affect the results
+    if (fbo->params.storable) {
+        pl_dispatch_set_autotune(dp, true);
+        pl_dispatch_set_prefer_compute(dp, true);
+        for (int i = 0; i < 40; i++) {
+            sh = pl_dispatch_begin(dp);
+            pl_shader_deband(sh, &(struct pl_sample_src) { .tex = src },
+                             &(struct pl_deband_params) { .iterations = 0 });
+
+            REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+                .shader = &sh,
+                .target = fbo,
+            }));
+            TEST_FBO_PATTERN(1e-6, "autotune iter %d", i);
+        }
+        pl_dispatch_set_prefer_compute(dp, false);
+        pl_dispatch_set_autotune(dp, false);
+    }
+
+    // Test debanding with a small radius, which uses shmem tiles if possible.
+    // With an unlimited threshold, every pixel is replaced by the average of
+    // its taps, which for a linear gradient reproduces the pattern wherever
+    // no tap gets clamped to the texture edge
+    for (int i = 0; i < 2; i++) {
+        const int iters = 4, margin = iters;
+        sh = pl_dispatch_begin(dp);
+        pl_shader_deband(sh,
+            &(struct pl_sample_src) {
+                .tex            = src,
+            },
+            &(struct pl_deband_params) {
+                .iterations     = iters,
+                .threshold      = 1e9,
+                .radius         = 1.0,
+                .no_compute     = i || !fbo->params.storable,
+        });
+
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = fbo,
+        }));
+
+        printf("testing pattern of deband averages (no_compute %d)\n", i);
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = data,
+        }));
+
+        for (int y = margin; y < FBO_H - margin; y++) {
+            for (int x = margin; x < FBO_W - margin; x++) {
+                float *color = &data[(y * FBO_W + x) * 4];
+                REQUIRE(feq(color[0], (x + 0.5) / FBO_W, 1e-3));
+                REQUIRE(feq(color[1], (y + 0.5) / FBO_H, 1e-3));
+                REQUIRE(feq(color[2], 0.0, 1e-3));
+                REQUIRE(feq(color[3], 1.0, 1e-3));
+            }
+        }
+    }
+
 #ifdef PL_HAVE_LCMS
     // Test the use of 3DLUTs if available
     sh = pl_dispatch_begin(dp);
@@ -435,6 +719,27 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
 
     pl_dispatch_abort(dp, &sh);
     pl_shader_obj_destroy(&lut3d);
+
+    // Test threaded 3DLUT generation and the cache callbacks
+    struct test_lut_cache lut_cache = {0};
+    struct pl_3dlut_params lut_params = pl_3dlut_default_params;
+    lut_params.size_r = lut_params.size_g = lut_params.size_b = 16;
+    lut_params.threads = 4;
+    lut_params.cache_priv = &lut_cache;
+    lut_params.cache_load = test_lut_cache_load;
+    lut_params.cache_save = test_lut_cache_save;
+
+    for (int i = 0; i < 2; i++) {
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_3dlut_update(sh, &src_color, &dst_color, &lut3d, &out,
+                                &lut_params));
+        pl_dispatch_abort(dp, &sh);
+        pl_shader_obj_destroy(&lut3d);
+    }
+
+    REQUIRE(lut_cache.saves == 1);
+    REQUIRE(lut_cache.hits == 1);
+    talloc_free(lut_cache.data);
 #endif
 
     // Test AV1 grain synthesis
@@ -463,11 +768,207 @@ static void pl_shader_tests(const struct pl_gpu *gpu)
     }
     pl_shader_obj_destroy(&grain);
 
+    // Test many dispatches with varying (large) uniform data, which should
+    // end up in uniform buffers and cycle through the whole UBO ring
+    for (int i = 0; i < 500; i++) {
+        int idx = i % 16;
+        float colors[16][4] = {0};
+        colors[idx][0] = (i % 7) / 7.0;
+        colors[idx][1] = (i % 11) / 11.0;
+        colors[idx][2] = (i % 13) / 13.0;
+        colors[idx][3] = 1.0;
+
+        struct pl_var var = pl_var_vec4("colors");
+        var.dim_a = PL_ARRAY_SIZE(colors);
+
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(sh_require(sh, PL_SHADER_SIG_NONE, FBO_W, FBO_H));
+        ident_t id = sh_var(sh, (struct pl_shader_var) {
+            .var  = var,
+            .data = colors,
+        });
+
+        GLSL("vec4 color = %s[%d]; \n", id, idx);
+        sh->res.output = PL_SHADER_SIG_COLOR;
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = fbo,
+        }));
+
+        // Only spot check some iterations, to avoid stalling on every one
+        if (i % 37)
+            continue;
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = data,
+        }));
+
+        for (int c = 0; c < 4; c++)
+            REQUIRE(feq(data[c], colors[idx][c], 1e-6));
+    }
+
+    // Test drawing multiple sub-rects in a single dispatch, on top of a black
+    // background, which should reproduce the pattern inside the sub-rects only
+    sh = pl_dispatch_begin(dp);
+    REQUIRE(sh_require(sh, PL_SHADER_SIG_NONE, FBO_W, FBO_H));
+    GLSL("vec4 color = vec4(0.0); \n");
+    sh->res.output = PL_SHADER_SIG_COLOR;
+    REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+    }));
+
+    static const struct pl_rect2d sub_rects[] = {
+        { 0, 0, FBO_W / 2, FBO_H / 2 },
+        { FBO_W / 2, FBO_H / 4, FBO_W, FBO_H },
+        { 2, FBO_H - 3, 5, FBO_H },
+    };
+
+    sh = pl_dispatch_begin(dp);
+    pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+    REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+        .rects = sub_rects,
+        .num_rects = PL_ARRAY_SIZE(sub_rects),
+    }));
+
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = data,
+    }));
+
+    for (int y = 0; y < FBO_H; y++) {
+        for (int x = 0; x < FBO_W; x++) {
+            bool inside = false;
+            for (int i = 0; i < PL_ARRAY_SIZE(sub_rects); i++) {
+                const struct pl_rect2d *rc = &sub_rects[i];
+                inside |= x >= rc->x0 && x < rc->x1 && y >= rc->y0 && y < rc->y1;
+            }
+
+            float *color = &data[(y * FBO_W + x) * 4];
+            REQUIRE(feq(color[0], inside ? (x + 0.5) / FBO_W : 0.0, 1e-6));
+            REQUIRE(feq(color[1], inside ? (y + 0.5) / FBO_H : 0.0, 1e-6));
+            REQUIRE(feq(color[3], inside ? 1.0 : 0.0, 1e-6));
+        }
+    }
+
+    // Test warming up the pass cache, after which dispatching the same
+    // shaders should not require any (asynchronous) compilation
+    struct pl_shader *warm_sh[PL_COLOR_TRC_COUNT];
+    struct pl_dispatch_params warm[PL_COLOR_TRC_COUNT];
+    for (enum pl_color_transfer trc = 0; trc < PL_COLOR_TRC_COUNT; trc++) {
+        warm_sh[trc] = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(warm_sh[trc], &(struct pl_sample_src) { .tex = src });
+        pl_shader_delinearize(warm_sh[trc], trc);
+        warm[trc] = (struct pl_dispatch_params) {
+            .shader = &warm_sh[trc],
+            .target = fbo,
+        };
+    }
+
+    REQUIRE(pl_dispatch_warmup(dp, warm, PL_COLOR_TRC_COUNT, 0));
+    pl_dispatch_set_async(dp, true);
+    for (enum pl_color_transfer trc = 0; trc < PL_COLOR_TRC_COUNT; trc++) {
+        sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        pl_shader_delinearize(sh, trc);
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = fbo,
+        }));
+    }
+    REQUIRE(pl_dispatch_skipped(dp) == 0);
+    pl_dispatch_set_async(dp, false);
+
+    // Passes left compiling by a non-blocking warm-up session must be waited
+    // on by synchronous dispatches, rather than skipped
+    for (int i = 0; i < 2; i++) {
+        if (i == 0)
+            pl_dispatch_warmup_begin(dp, 0);
+        sh = pl_dispatch_begin(dp);
+        pl_shader_sample_direct(sh, &(struct pl_sample_src) { .tex = src });
+        pl_shader_linearize(sh, PL_COLOR_TRC_PQ);
+        pl_shader_delinearize(sh, PL_COLOR_TRC_HLG);
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = fbo,
+        }));
+        if (i == 0)
+            REQUIRE(pl_dispatch_warmup_poll(dp) >= 0);
+    }
+    REQUIRE(pl_dispatch_skipped(dp) == 0);
+
+    // Test serialization of the dispatch cache
+    size_t cache_size = pl_dispatch_save(dp, NULL);
+    uint8_t *cache = malloc(cache_size);
+    REQUIRE(cache);
+    REQUIRE(pl_dispatch_save(dp, cache) == cache_size);
+
+    struct pl_dispatch *dp2 = pl_dispatch_create(gpu->ctx, gpu);
+    pl_dispatch_load(dp2, cache, cache_size);
+    REQUIRE(pl_dispatch_save(dp2, NULL) == cache_size);
+    pl_dispatch_destroy(&dp2);
+    free(cache);
+
     pl_dispatch_destroy(&dp);
     pl_tex_destroy(gpu, &src);
     pl_tex_destroy(gpu, &fbo);
 }
 
+// Regression test: make sure distinct SSBOs end up on distinct bindings,
+// rather than all aliasing the first one
+static void pl_ssbo_binding_tests(const struct pl_gpu *gpu)
+{
+    if (!(gpu->caps & PL_GPU_CAP_COMPUTE) || !gpu->limits.max_ssbo_size)
+        return;
+
+    static const char *names[] = { "val_a", "val_b", "val_c" };
+    const struct pl_buf *bufs[3] = {0};
+    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    REQUIRE(sh_try_compute(sh, 1, 1, false, 0));
+
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = pl_buf_create(gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_STORAGE,
+            .size = sizeof(uint32_t),
+            .host_writable = true,
+            .host_readable = true,
+            .initial_data = &(uint32_t) {0},
+        });
+        REQUIRE(bufs[i]);
+
+        struct pl_shader_desc desc = {
+            .desc = {
+                .name   = "SSBO",
+                .type   = PL_DESC_BUF_STORAGE,
+                .access = PL_DESC_ACCESS_WRITEONLY,
+            },
+            .object = bufs[i],
+        };
+
+        REQUIRE(sh_buf_desc_append(sh, gpu, &desc, NULL, pl_var_uint(names[i])));
+        sh_desc(sh, desc);
+        GLSL("%s = %du; \n", names[i], 10 * (i + 1));
+    }
+
+    REQUIRE(pl_dispatch_compute(dp, &(struct pl_dispatch_compute_params) {
+        .shader = &sh,
+        .dispatch_size = {1, 1, 1},
+    }));
+
+    for (int i = 0; i < 3; i++) {
+        uint32_t val = 0;
+        REQUIRE(pl_buf_read(gpu, bufs[i], 0, &val, sizeof(val)));
+        REQUIRE(val == 10 * (i + 1));
+        pl_buf_destroy(gpu, &bufs[i]);
+    }
+
+    pl_dispatch_destroy(&dp);
+}
+
 static void pl_scaler_tests(const struct pl_gpu *gpu)
 {
     const struct pl_fmt *src_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
@@ -478,8 +979,9 @@ static void pl_scaler_tests(const struct pl_gpu *gpu)
     if (!src_fmt || !fbo_fmt)
         return;
 
-    float *fbo_data = NULL;
-    struct pl_shader_obj *lut = NULL;
+    float *fbo_data = NULL, *fused_data = NULL, *sep_data = NULL;
+    struct pl_shader_obj *lut = NULL, *lut_ortho = NULL;
+    const struct pl_tex *sep_tex = NULL;
 
     static float data_5x5[5][5] = {
         { 0, 0, 0, 0, 0 },
@@ -555,12 +1057,103 @@ static void pl_scaler_tests(const struct pl_gpu *gpu)
         }
     }
 
+    // Test separable sampling with and without merged taps, and fused
+    // separable sampling against the two separate passes
+    const struct pl_fmt *sep_fmt;
+    sep_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
+                          PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_SAMPLEABLE);
+    if (!fbo_data || !sep_fmt)
+        goto error;
+
+    struct pl_sample_src sep_src = {
+        .tex    = dot5x5,
+        .new_w  = fbo->params.w,
+        .new_h  = fbo->params.h,
+    };
+
+    struct pl_sample_filter_params sep_params = {
+        .filter = pl_filter_spline36,
+        .lut    = &lut_ortho,
+    };
+
+    sep_tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = dot5x5->params.w,
+        .h              = fbo->params.h,
+        .format         = sep_fmt,
+        .renderable     = true,
+        .sampleable     = true,
+        .sample_mode    = (sep_fmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
+        .address_mode   = PL_TEX_ADDRESS_CLAMP,
+    });
+    REQUIRE(sep_tex);
+
+    sep_data = malloc(fbo->params.w * fbo->params.h * sizeof(float));
+    REQUIRE(sep_data);
+    for (int i = 0; i < 2; i++) {
+        sep_params.no_merging = i;
+        sep_src.tex = dot5x5;
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_ortho(sh, PL_SEP_VERT, &sep_src, &sep_params));
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = sep_tex,
+        }));
+
+        sep_src.tex = sep_tex;
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_ortho(sh, PL_SEP_HORIZ, &sep_src, &sep_params));
+        REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = fbo,
+        }));
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = i ? fbo_data : sep_data,
+        }));
+    }
+
+    // Merged taps are subject to the precision of bilinear filtering
+    for (int i = 0; i < fbo->params.w * fbo->params.h; i++)
+        REQUIRE(fabs(sep_data[i] - fbo_data[i]) < 1e-2);
+
+    if (!fbo->params.storable)
+        goto error;
+
+    sep_src.tex = dot5x5;
+    sh = pl_dispatch_begin(dp);
+    if (!pl_shader_sample_ortho_fused(sh, &sep_src, &sep_params)) {
+        printf("Fused separable sampling unsupported, skipping test\n");
+        pl_dispatch_abort(dp, &sh);
+        goto error;
+    }
+
+    REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+    }));
+
+    fused_data = malloc(fbo->params.w * fbo->params.h * sizeof(float));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex            = fbo,
+        .ptr            = fused_data,
+    }));
+
+    for (int i = 0; i < fbo->params.w * fbo->params.h; i++)
+        REQUIRE(fabs(fused_data[i] - fbo_data[i]) < 1e-2);
+
 error:
     free(fbo_data);
+    free(fused_data);
+    free(sep_data);
     pl_shader_obj_destroy(&lut);
+    pl_shader_obj_destroy(&lut_ortho);
     pl_dispatch_destroy(&dp);
     pl_tex_destroy(gpu, &dot5x5);
     pl_tex_destroy(gpu, &fbo);
+    pl_tex_destroy(gpu, &sep_tex);
 }
 
 static const char *user_shader_tests[] = {
@@ -610,13 +1203,66 @@ static const char *user_shader_tests[] = {
     "//!BORDER REPEAT                                                       \n"
     "0000803f000000000000000000000000000000000000803f000000000000000000000000000000000000803f00000000000000000000803f0000803f000000000000803f000000000000803f000000000000803f0000803f00000000000000009a99993e9a99993e9a99993e000000009a99193f9a99193f9a99193f000000000000803f0000803f0000803f00000000 \n",
 
+    // Test chains of intermediate textures
+    "//!HOOK MAIN                                                           \n"
+    "//!DESC first pass                                                     \n"
+    "//!BIND HOOKED                                                         \n"
+    "//!SAVE STEP1                                                          \n"
+    "                                                                       \n"
+    "vec4 hook()                                                            \n"
+    "{                                                                      \n"
+    "    return HOOKED_tex(HOOKED_pos);                                     \n"
+    "}                                                                      \n"
+    "                                                                       \n"
+    "//!HOOK MAIN                                                           \n"
+    "//!DESC second pass                                                    \n"
+    "//!BIND STEP1                                                          \n"
+    "//!SAVE STEP2                                                          \n"
+    "//!WIDTH STEP1.w 2 *                                                   \n"
+    "//!HEIGHT STEP1.h 2 *                                                  \n"
+    "                                                                       \n"
+    "vec4 hook()                                                            \n"
+    "{                                                                      \n"
+    "    return STEP1_tex(STEP1_pos);                                       \n"
+    "}                                                                      \n"
+    "                                                                       \n"
+    "//!HOOK MAIN                                                           \n"
+    "//!DESC third pass                                                     \n"
+    "//!BIND HOOKED                                                         \n"
+    "//!BIND STEP2                                                          \n"
+    "                                                                       \n"
+    "vec4 hook()                                                            \n"
+    "{                                                                      \n"
+    "    return HOOKED_tex(HOOKED_pos) + STEP2_tex(STEP2_pos);              \n"
+    "}                                                                      \n",
+
 };
 
-static void pl_render_tests(const struct pl_gpu *gpu)
+// Counts the number of times a hook gets reset and dispatched
+struct hook_counter {
+    int resets;
+    int hooks;
+};
+
+static void counter_reset(void *priv)
 {
-    const struct pl_fmt *fbo_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32,
-                                               PL_FMT_CAP_RENDERABLE |
-                                               PL_FMT_CAP_BLITTABLE);
+    struct hook_counter *c = priv;
+    c->resets++;
+}
+
+static struct pl_hook_res counter_hook(void *priv,
+                                       const struct pl_hook_params *params)
+{
+    struct hook_counter *c = priv;
+    c->hooks++;
+    return (struct pl_hook_res) {0};
+}
+
+static void pl_render_tests(const struct pl_gpu *gpu)
+{
+    const struct pl_fmt *fbo_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32,
+                                               PL_FMT_CAP_RENDERABLE |
+                                               PL_FMT_CAP_BLITTABLE);
     if (!fbo_fmt)
         return;
 
@@ -653,6 +1299,7 @@ static void pl_render_tests(const struct pl_gpu *gpu)
         .h              = 40,
         .format         = fbo_fmt,
         .renderable     = true,
+        .blit_src       = true,
         .blit_dst       = true,
         .storable       = !!(fbo_fmt->caps & PL_FMT_CAP_STORABLE),
         .host_readable  = true,
@@ -735,6 +1382,7 @@ static void pl_render_tests(const struct pl_gpu *gpu)
     target.color.sig_scale = 2.0;
     TEST_PARAMS(color_map, tone_mapping_algo, PL_TONE_MAPPING_BT_2390);
     TEST_PARAMS(color_map, desaturation_strength, 1);
+    TEST_PARAMS(peak_detect, downsample, 4);
     image.color.sig_scale = target.color.sig_scale = 0.0;
 
     // Test some misc stuff
@@ -750,8 +1398,249 @@ static void pl_render_tests(const struct pl_gpu *gpu)
 
     params.force_3dlut = true;
     REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params.lut3d_params = &(struct pl_3dlut_params) {
+        .intent = PL_INTENT_RELATIVE_COLORIMETRIC,
+        .tetrahedral = true,
+    };
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params = pl_render_default_params;
+
+    // The baked color conversion must match the regular one, up to the
+    // accuracy of the LUT. This requires disabling peak detection.
+    const size_t lut_size = fbo->params.w * fbo->params.h * 4;
+    float *lut_ref = malloc(lut_size * sizeof(float));
+    float *lut_data = malloc(lut_size * sizeof(float));
+    REQUIRE(lut_ref && lut_data);
+    image.color = pl_color_space_hdr10;
+    params.peak_detect_params = NULL;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = lut_ref,
+    }));
+
+    params.color_lut_size = 33;
+    for (int i = 0; i < 2; i++) { // second time from the cached LUT
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = lut_data,
+        }));
+        for (int n = 0; n < lut_size; n++)
+            REQUIRE(fabs(lut_ref[n] - lut_data[n]) < 2e-2);
+    }
+
+    // With peak detection active, the LUT is skipped
+    params.peak_detect_params = &pl_peak_detect_default_params;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    free(lut_ref);
+    free(lut_data);
+    image.color = pl_color_space_bt709;
+    params = pl_render_default_params;
+
+    params.reduced_precision = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params = pl_render_default_params;
+
+    params.specialize_constants = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params = pl_render_default_params;
+
+    params.prefer_compute = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params = pl_render_default_params;
+
+    params.disable_tap_merging = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    params = pl_render_default_params;
+
+    // Tuning the work group sizes must not affect the output, for any of the
+    // candidate sizes tried along the way
+    const size_t tune_size = fbo->params.w * fbo->params.h * 4;
+    float *tune_ref = malloc(tune_size * sizeof(float));
+    float *tune_data = malloc(tune_size * sizeof(float));
+    REQUIRE(tune_ref && tune_data);
+    params.prefer_compute = true;
+    params.upscaler = params.downscaler = &pl_filter_ewa_lanczos;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = tune_ref,
+    }));
+
+    params.autotune_compute = true;
+    for (int i = 0; i < 60; i++) {
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = tune_data,
+        }));
+        for (int n = 0; n < tune_size; n++)
+            REQUIRE(fabs(tune_ref[n] - tune_data[n]) < 1e-4);
+    }
+    free(tune_ref);
+    free(tune_data);
+    params = pl_render_default_params;
+
+    // Downscale by more than 2x, to hit at least one mip level
+    struct pl_rect2df dst_rect = target.dst_rect;
+    target.dst_rect = (struct pl_rect2df) {0, 0, 2, 2};
+    params.downscaler = &pl_filter_mitchell;
+    params.mipmap_downscaling = true;
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
     params = pl_render_default_params;
 
+    // Reducing by exactly 4x with a box filter must match the plain box
+    // downscaler, which averages the same 4x4 blocks
+    static float data_16x16[16][16];
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++)
+            data_16x16[y][x] = ((x * 7 + y * 13) % 16) / 15.0;
+    }
+
+    struct pl_plane img16 = {0};
+    const struct pl_tex *img16_tex = NULL;
+    REQUIRE(pl_upload_plane(gpu, &img16, &img16_tex, &(struct pl_plane_data) {
+        .type = PL_FMT_FLOAT,
+        .width = 16,
+        .height = 16,
+        .component_size = { 8 * sizeof(float) },
+        .component_map  = { 0 },
+        .pixel_stride = sizeof(float),
+        .pixels = &data_16x16,
+    }));
+
+    struct pl_image image16 = image;
+    image16.planes[0] = img16;
+    image16.src_rect = (struct pl_rect2df) {0, 0, 16, 16};
+    target.dst_rect = (struct pl_rect2df) {0, 0, 4, 4};
+
+    const size_t mip_size = fbo->params.w * fbo->params.h * 4;
+    float *mip_ref = malloc(mip_size * sizeof(float));
+    float *mip_data = malloc(mip_size * sizeof(float));
+    REQUIRE(mip_ref && mip_data);
+    params.downscaler = &pl_filter_box;
+    REQUIRE(pl_render_image(rr, &image16, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = mip_ref,
+    }));
+
+    params.mipmap_downscaling = true;
+    REQUIRE(pl_render_image(rr, &image16, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = mip_data,
+    }));
+    for (int n = 0; n < mip_size; n++)
+        REQUIRE(fabs(mip_ref[n] - mip_data[n]) < 1e-2);
+
+    free(mip_ref);
+    free(mip_data);
+    pl_tex_destroy(gpu, &img16_tex);
+    target.dst_rect = dst_rect;
+    params = pl_render_default_params;
+
+    // Rendering to multiple targets at once must match rendering them one by
+    // one, for both the first and any further targets
+    const struct pl_tex *fbo2 = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = 17,
+        .h              = 23,
+        .format         = fbo_fmt,
+        .renderable     = true,
+        .blit_dst       = true,
+        .host_readable  = true,
+    });
+    REQUIRE(fbo2);
+
+    struct pl_render_target targets[2] = { target, target };
+    targets[1].fbo = fbo2;
+    targets[1].dst_rect = (struct pl_rect2df) {0};
+
+    const size_t sizes[2] = {
+        fbo->params.w * fbo->params.h * 4,
+        fbo2->params.w * fbo2->params.h * 4,
+    };
+
+    float *ref_data[2], *multi_data[2];
+    for (int i = 0; i < 2; i++) {
+        ref_data[i] = malloc(sizes[i] * sizeof(float));
+        multi_data[i] = malloc(sizes[i] * sizeof(float));
+        REQUIRE(ref_data[i] && multi_data[i]);
+        pl_tex_clear(gpu, targets[i].fbo, (float[4]){0});
+        REQUIRE(pl_render_image(rr, &image, &targets[i], &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = targets[i].fbo,
+            .ptr = ref_data[i],
+        }));
+        pl_tex_clear(gpu, targets[i].fbo, (float[4]){0});
+    }
+
+    REQUIRE(pl_render_image_multi(rr, &image, targets, 2, &params));
+    for (int i = 0; i < 2; i++) {
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = targets[i].fbo,
+            .ptr = multi_data[i],
+        }));
+        for (int n = 0; n < sizes[i]; n++)
+            REQUIRE(fabs(ref_data[i][n] - multi_data[i][n]) < 1e-2);
+        free(ref_data[i]);
+        free(multi_data[i]);
+    }
+
+    pl_tex_destroy(gpu, &fbo2);
+
+    // Rendering a mosaic must match rendering each tile individually
+    struct pl_render_tile tiles[4];
+    for (int i = 0; i < 4; i++) {
+        float x = (i % 2) * 20, y = (i / 2) * 20;
+        tiles[i] = (struct pl_render_tile) {
+            .image = &image,
+            .dst_rect = { x, y, x + 20, y + 20 },
+        };
+    }
+
+    const size_t fbo_size = fbo->params.w * fbo->params.h * sizeof(float[4]);
+    float *tiles_data = malloc(fbo_size);
+    REQUIRE(tiles_data);
+
+    struct pl_render_target tile_target = target;
+    pl_tex_clear(gpu, fbo, (float[4]){0});
+    for (int i = 0; i < 4; i++) {
+        tile_target.dst_rect = tiles[i].dst_rect;
+        REQUIRE(pl_render_image(rr, tiles[i].image, &tile_target, &params));
+    }
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = fbo_data,
+    }));
+
+    pl_tex_clear(gpu, fbo, (float[4]){0});
+    REQUIRE(pl_render_tiles(rr, tiles, 4, &target, &params));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = fbo,
+        .ptr = tiles_data,
+    }));
+
+    for (int i = 0; i < fbo_size / sizeof(float); i++)
+        REQUIRE(fabs(fbo_data[i] - tiles_data[i]) < 1e-2);
+    free(tiles_data);
+
+    if (fbo->params.storable && (gpu->caps & PL_GPU_CAP_COMPUTE)) {
+        const struct pl_tex *stor = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w          = fbo->params.w,
+            .h          = fbo->params.h,
+            .format     = fbo_fmt,
+            .storable   = true,
+        });
+
+        REQUIRE(stor);
+        struct pl_render_target stor_target = target;
+        stor_target.fbo = stor;
+        REQUIRE(pl_render_image(rr, &image, &stor_target, &params));
+        pl_tex_destroy(gpu, &stor);
+    }
+
     image.av1_grain = av1_grain_data;
     REQUIRE(pl_render_image(rr, &image, &target, &params));
     image.av1_grain = (struct pl_av1_grain_data) {0};
@@ -764,14 +1653,39 @@ static void pl_render_tests(const struct pl_gpu *gpu)
                                         strlen(user_shader_tests[i]));
         REQUIRE(hook);
 
+        // Render twice, to also exercise the cached pass plans
         params.hooks = &hook;
         params.num_hooks = 1;
         REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
 
         pl_mpv_user_shader_destroy(&hook);
     }
     params = pl_render_default_params;
 
+    // Hooks must run exactly once per rendered frame, even with async_compile
+    struct hook_counter counter = {0};
+    const struct pl_hook *counter_hooks[] = {
+        &(struct pl_hook) {
+            .stages = PL_HOOK_OUTPUT,
+            .input = PL_HOOK_SIG_NONE,
+            .priv = &counter,
+            .reset = counter_reset,
+            .hook = counter_hook,
+        },
+    };
+
+    params.hooks = counter_hooks;
+    params.num_hooks = PL_ARRAY_SIZE(counter_hooks);
+    params.async_compile = true;
+    params.skip_redraw_caching = true;
+    for (int i = 1; i <= 3; i++) {
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(counter.resets == i);
+        REQUIRE(counter.hooks == i);
+    }
+    params = pl_render_default_params;
+
     // Test overlays
     image.num_overlays = 1;
     image.overlays = &(struct pl_overlay) {
@@ -795,6 +1709,174 @@ static void pl_render_tests(const struct pl_gpu *gpu)
     REQUIRE(pl_render_image(rr, &image, &target, &params));
     target.num_overlays = 0;
 
+    // Test overlay atlases
+    static const uint8_t bitmap[3][4] = {
+        { 0x00, 0xFF, 0xFF, 0x00 },
+        { 0xFF, 0x80, 0x80, 0xFF },
+        { 0x00, 0xFF, 0xFF, 0x00 },
+    };
+
+    struct pl_overlay_bitmap bitmaps[20];
+    for (int i = 0; i < PL_ARRAY_SIZE(bitmaps); i++) {
+        bitmaps[i] = (struct pl_overlay_bitmap) {
+            .data = &bitmap[0][0],
+            .w = 4,
+            .h = 3,
+            .stride = sizeof(bitmap[0]),
+            .dst = { i, 2 * i, i + 4, 2 * i + 3 },
+            .color = { 1.0, 1.0 - i / 20.0, 0.0, 0.8 },
+        };
+    }
+
+    struct pl_overlay_part parts[PL_ARRAY_SIZE(bitmaps)];
+    struct pl_overlay atlas = {
+        .mode = PL_OVERLAY_MONOCHROME,
+        .parts = parts,
+        .num_parts = PL_ARRAY_SIZE(parts),
+    };
+
+    const struct pl_tex *atlas_tex = NULL;
+    if (pl_upload_overlay_atlas(gpu, &atlas.plane, &atlas_tex, parts, bitmaps,
+                                PL_ARRAY_SIZE(bitmaps)))
+    {
+        for (int i = 0; i < PL_ARRAY_SIZE(parts); i++) {
+            REQUIRE(parts[i].src.x1 <= atlas_tex->params.w);
+            REQUIRE(parts[i].src.y1 <= atlas_tex->params.h);
+        }
+
+        target.num_overlays = 1;
+        target.overlays = &atlas;
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        target.num_overlays = 0;
+    }
+    pl_tex_destroy(gpu, &atlas_tex);
+
+    // Test redrawing animated overlays on top of a static frame. Every frame
+    // must match rendering it from scratch, which is done afterwards so as to
+    // not interfere with the cache
+    const int num_redraws = 6;
+    const size_t redraw_size = fbo->params.w * fbo->params.h * 4;
+    float *redraw_data = malloc(num_redraws * redraw_size * sizeof(float));
+    REQUIRE(redraw_data);
+    image.signature = 0x1234;
+    for (int n = 0; n < 2; n++) {
+        params.skip_redraw_caching = n;
+        for (int i = 0; i < num_redraws; i++) {
+            params.partial_redraw = i >= 3;
+            target.num_overlays = 1;
+            target.overlays = &(struct pl_overlay) {
+                .plane = img5x5,
+                .rect = {i, i, i + 10, i + 10},
+                .mode = PL_OVERLAY_NORMAL,
+            };
+            float *ref = &redraw_data[i * redraw_size];
+            REQUIRE(pl_render_image(rr, &image, &target, &params));
+            REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+                .tex            = fbo,
+                .ptr            = n ? fbo_data : ref,
+            }));
+
+            for (int k = 0; n && k < redraw_size; k++)
+                REQUIRE(fabs(fbo_data[k] - ref[k]) < 1e-2);
+        }
+    }
+    free(redraw_data);
+    target.num_overlays = 0;
+    image.signature = 0;
+    params = pl_render_default_params;
+
+    // Test re-outputting a static frame from the scaled image cache, which
+    // must match rendering it from scratch
+    float *uncached_data = malloc(fbo->params.w * fbo->params.h * sizeof(float[4]));
+    struct pl_color_space target_color = target.color;
+    REQUIRE(uncached_data);
+    image.signature = 0x5678;
+    for (int i = 0; i < 4; i++) {
+        params.dither_params = (i % 2) ? &pl_dither_default_params : NULL;
+        target.color.transfer = i < 2 ? PL_COLOR_TRC_BT_1886 : PL_COLOR_TRC_GAMMA22;
+        for (int n = 0; n < 3; n++)
+            REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = fbo_data,
+        }));
+
+        params.skip_redraw_caching = true;
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex            = fbo,
+            .ptr            = uncached_data,
+        }));
+        params.skip_redraw_caching = false;
+
+        for (int n = 0; n < fbo->params.w * fbo->params.h * 4; n++)
+            REQUIRE(fabs(fbo_data[n] - uncached_data[n]) < 1e-2);
+    }
+    free(uncached_data);
+    target.color = target_color;
+    image.signature = 0;
+    params = pl_render_default_params;
+
+    // Test frame mixing
+    struct pl_image images[3] = { image, image, image };
+    for (int i = 0; i < PL_ARRAY_SIZE(images); i++)
+        images[i].signature = i + 1;
+
+    struct pl_image_mix mix = {
+        .num_images = PL_ARRAY_SIZE(images),
+        .images = images,
+        .distances = (float[]) { -1.4, -0.4, 0.6 },
+        .vsync_duration = 0.4,
+    };
+
+    for (int i = 0; i < 3; i++) {
+        // Repeated calls should hit the frame cache
+        REQUIRE(pl_render_image_mix(rr, &mix, &target, &params));
+        pl_gpu_flush(gpu);
+    }
+
+    params.frame_mixer = &pl_filter_triangle;
+    REQUIRE(pl_render_image_mix(rr, &mix, &target, &params));
+    params = pl_render_default_params;
+
+    mix.vsync_duration = 0.0;
+    REQUIRE(pl_render_image_mix(rr, &mix, &target, &params));
+
+    // Test timing statistics
+    params.measure_timing = true;
+    for (int i = 0; i < 5; i++)
+        REQUIRE(pl_render_image(rr, &image, &target, &params));
+    pl_gpu_finish(gpu);
+
+    struct pl_render_stats stats;
+    pl_renderer_get_stats(rr, &stats);
+    for (int i = 0; i < PL_RENDER_STAGE_COUNT; i++) {
+        const struct pl_render_stage_stats *st = &stats.stages[i];
+        REQUIRE(st->name);
+        REQUIRE(st->peak >= st->average);
+        printf("stage '%s': %"PRIu64" passes, last %"PRIu64", avg %"PRIu64
+               ", peak %"PRIu64"\n", st->name, st->count, st->last,
+               st->average, st->peak);
+    }
+
+    pl_renderer_reset_stats(rr);
+    pl_renderer_get_stats(rr, &stats);
+    REQUIRE(stats.stages[PL_RENDER_STAGE_OUTPUT_TARGET].count == 0);
+    params = pl_render_default_params;
+
+    // After warming up a fresh renderer, the first frame should not need to
+    // create any new passes
+    pl_renderer_destroy(&rr);
+    rr = pl_renderer_create(gpu->ctx, gpu);
+    params = pl_render_high_quality_params;
+    REQUIRE(pl_renderer_warmup(rr, &image, &target, &params));
+    pl_renderer_get_stats(rr, &stats);
+    REQUIRE(stats.frames == 0);
+    REQUIRE(pl_render_image(rr, &image, &target, &params));
+    pl_renderer_get_stats(rr, &stats);
+    REQUIRE(stats.last_frame.cache_misses == 0);
+    params = pl_render_default_params;
+
 error:
     free(fbo_data);
     pl_renderer_destroy(&rr);
@@ -802,11 +1884,506 @@ error:
     pl_tex_destroy(gpu, &fbo);
 }
 
+static const struct pl_tex *lut_tex(const struct pl_shader *sh)
+{
+    for (int i = 0; i < sh->res.num_descriptors; i++) {
+        if (sh->descriptors[i].desc.type == PL_DESC_SAMPLED_TEX)
+            return sh->descriptors[i].object;
+    }
+
+    return NULL;
+}
+
+static void pl_lut_cache_tests(const struct pl_gpu *gpu)
+{
+    // Identical LUTs from independent shader objects should be shared
+    struct pl_shader_obj *state[2] = {0};
+    struct pl_shader *sh[2] = {0};
+    for (int i = 0; i < PL_ARRAY_SIZE(sh); i++) {
+        sh[i] = pl_shader_alloc(gpu->ctx, &(struct pl_shader_params) {
+            .gpu = gpu,
+        });
+        pl_shader_dither(sh[i], 8, &state[i], &pl_dither_default_params);
+    }
+
+    const struct pl_tex *tex = lut_tex(sh[0]);
+    if (tex) {
+        printf("testing shared LUT cache\n");
+        REQUIRE(lut_tex(sh[1]) == tex);
+    }
+
+    for (int i = 0; i < PL_ARRAY_SIZE(sh); i++) {
+        pl_shader_free(&sh[i]);
+        pl_shader_obj_destroy(&state[i]);
+    }
+}
+
+static void pl_offscreen_tests(const struct pl_gpu *gpu)
+{
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                           PL_FMT_CAP_RENDERABLE |
+                                           PL_FMT_CAP_HOST_READABLE);
+    if (!fmt)
+        return;
+
+    const struct pl_swapchain *sw;
+    sw = pl_offscreen_swapchain_create(gpu, &(struct pl_offscreen_swapchain_params) {
+        .fbo_params = {
+            .w = 16,
+            .h = 16,
+            .format = fmt,
+            .host_writable = true,
+        },
+        .swapchain_depth = 2,
+    });
+
+    REQUIRE(sw);
+    REQUIRE(pl_swapchain_latency(sw) == 2);
+
+    static uint8_t src[16 * 16], dst[64 * 16];
+    const int frames = 10;
+    uint64_t next_id = 0;
+
+    for (int i = 0; i <= frames; i++) {
+        if (i < frames) {
+            struct pl_swapchain_frame frame;
+            REQUIRE(pl_swapchain_start_frame(sw, &frame));
+            memset(src, i + 1, sizeof(src));
+            REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+                .tex = frame.fbo,
+                .ptr = src,
+            }));
+            REQUIRE(pl_swapchain_submit_frame(sw));
+            pl_swapchain_swap_buffers(sw);
+        }
+
+        // Drain all completed frames, blocking for the rest after the end
+        struct pl_offscreen_frame out;
+        uint64_t timeout = i < frames ? 0 : UINT64_MAX;
+        while (pl_offscreen_swapchain_get(sw, &out, timeout)) {
+            REQUIRE(out.frame_id == next_id);
+            REQUIRE(out.buf && out.stride >= 16 && out.stride <= 64);
+            const uint8_t *data = out.data;
+            if (!data) {
+                REQUIRE(pl_buf_read(gpu, out.buf, 0, dst, out.stride * 16));
+                data = dst;
+            }
+            REQUIRE(data[0] == next_id + 1);
+            REQUIRE(data[15 * out.stride + 15] == next_id + 1);
+            pl_offscreen_swapchain_release(sw, &out);
+            next_id++;
+        }
+    }
+
+    REQUIRE(next_id == frames);
+    pl_swapchain_destroy(&sw);
+}
+
+static void pl_blit_filtered_tests(const struct pl_gpu *gpu)
+{
+    const struct pl_fmt *src_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
+                                               PL_FMT_CAP_LINEAR);
+    const struct pl_fmt *dst_fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 1, 16, 32,
+                                               PL_FMT_CAP_RENDERABLE |
+                                               PL_FMT_CAP_HOST_READABLE);
+    if (!src_fmt || !dst_fmt)
+        return;
+
+    static float data[256 * 256];
+    for (int i = 0; i < PL_ARRAY_SIZE(data); i++)
+        data[i] = 0.5;
+
+    const struct pl_tex *src = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = 256,
+        .h              = 256,
+        .format         = src_fmt,
+        .sampleable     = true,
+        .sample_mode    = PL_TEX_SAMPLE_LINEAR,
+        .initial_data   = data,
+    });
+
+    const struct pl_tex *dst = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = 16,
+        .h              = 16,
+        .format         = dst_fmt,
+        .renderable     = true,
+        .storable       = !!(dst_fmt->caps & PL_FMT_CAP_STORABLE),
+        .host_writable  = true,
+        .host_readable  = true,
+    });
+
+    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
+    REQUIRE(src && dst && dp);
+
+    // A flat source must stay flat regardless of the filter and the scaling
+    // ratio, including strong downscales which can't be done in one pass
+    const struct {
+        const struct pl_filter_config *filter;
+        struct pl_rect2d dst_rc;
+    } tests[] = {
+        { NULL },
+        { &pl_filter_box },
+        { &pl_filter_mitchell },
+        { &pl_filter_ewa_lanczos },
+        { &pl_filter_mitchell, {0, 0, 2, 2} },
+        { &pl_filter_box, {4, 4, 12, 12} },
+    };
+
+    static float out[16 * 16];
+    struct pl_shader_obj *lut = NULL;
+    for (int i = 0; i < PL_ARRAY_SIZE(tests); i++) {
+        struct pl_rect2d rc = tests[i].dst_rc;
+        if (!pl_rect_w(rc))
+            rc = (struct pl_rect2d) { 0, 0, dst->params.w, dst->params.h };
+
+        memset(out, 0, sizeof(out));
+        REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+            .tex = dst,
+            .ptr = out,
+        }));
+
+        REQUIRE(pl_tex_blit_filtered(gpu, dp, &(struct pl_blit_filtered_params) {
+            .src    = src,
+            .dst    = dst,
+            .dst_rc = tests[i].dst_rc,
+            .filter = tests[i].filter,
+            .lut    = i % 2 ? &lut : NULL,
+        }));
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = dst,
+            .ptr = out,
+        }));
+
+        for (int y = 0; y < dst->params.h; y++) {
+            for (int x = 0; x < dst->params.w; x++) {
+                bool inside = x >= rc.x0 && x < rc.x1 && y >= rc.y0 && y < rc.y1;
+                float ref = inside ? 0.5 : 0.0;
+                REQUIRE(fabs(out[y * dst->params.w + x] - ref) < 1e-2);
+            }
+        }
+    }
+
+    // Downscaling a source made of 16x16 blocks by exactly 16x must reproduce
+    // each block's value, for filters which don't reach past the blocks. The
+    // flipped source rect must mirror the result.
+    for (int y = 0; y < 256; y++) {
+        for (int x = 0; x < 256; x++)
+            data[y * 256 + x] = ((x / 16) * 16 + y / 16) / 255.0;
+    }
+
+    const struct pl_tex *blocks = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = 256,
+        .h              = 256,
+        .format         = src_fmt,
+        .sampleable     = true,
+        .sample_mode    = PL_TEX_SAMPLE_LINEAR,
+        .initial_data   = data,
+    });
+    REQUIRE(blocks);
+
+    const struct pl_filter_config *block_filters[] = { NULL, &pl_filter_box };
+    for (int i = 0; i < 2 * PL_ARRAY_SIZE(block_filters); i++) {
+        bool flip = i % 2;
+        REQUIRE(pl_tex_blit_filtered(gpu, dp, &(struct pl_blit_filtered_params) {
+            .src    = blocks,
+            .dst    = dst,
+            .src_rc = flip ? (struct pl_rect2df) { 256, 0, 0, 256 }
+                           : (struct pl_rect2df) {0},
+            .filter = block_filters[i / 2],
+            .lut    = &lut,
+        }));
+
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = dst,
+            .ptr = out,
+        }));
+
+        for (int y = 0; y < dst->params.h; y++) {
+            for (int x = 0; x < dst->params.w; x++) {
+                int bx = flip ? dst->params.w - 1 - x : x;
+                float ref = (bx * 16 + y) / 255.0;
+                REQUIRE(fabs(out[y * dst->params.w + x] - ref) < 1e-2);
+            }
+        }
+    }
+
+    pl_shader_obj_destroy(&lut);
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(gpu, &src);
+    pl_tex_destroy(gpu, &dst);
+    pl_tex_destroy(gpu, &blocks);
+}
+
+// Downloads an uploaded plane via a host-readable copy, since the textures
+// created by the upload helpers are not host-readable themselves
+static bool download_plane(const struct pl_gpu *gpu, const struct pl_tex *tex,
+                            uint16_t *out)
+{
+    if (!tex->params.blit_src)
+        return false;
+
+    const struct pl_tex *copy = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w              = tex->params.w,
+        .h              = tex->params.h,
+        .format         = tex->params.format,
+        .blit_dst       = true,
+        .host_readable  = true,
+    });
+
+    bool ok = copy;
+    if (ok) {
+        struct pl_rect3d rc = { .x1 = tex->params.w, .y1 = tex->params.h };
+        pl_tex_blit(gpu, copy, tex, rc, rc);
+        ok = pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = copy,
+            .ptr = out,
+        });
+    }
+
+    pl_tex_destroy(gpu, &copy);
+    return ok;
+}
+
+// Mirrors the format selection of `pl_upload_packed`
+static bool have_packed_fmt(const struct pl_gpu *gpu, int comps, int depth)
+{
+    enum pl_fmt_caps caps = PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_STORABLE;
+    for (int c = comps; c <= 4; c++) {
+        if (pl_find_fmt(gpu, PL_FMT_UNORM, c, depth, 0, caps))
+            return true;
+    }
+
+    return false;
+}
+
+static void pl_upload_packed_tests(const struct pl_gpu *gpu)
+{
+    if (!(gpu->caps & PL_GPU_CAP_COMPUTE) || gpu->glsl.version < 130 ||
+        !gpu->limits.max_ssbo_size)
+    {
+        return;
+    }
+
+    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
+    const struct pl_buf *staging = NULL;
+    const struct pl_tex *tex[2] = {0};
+    struct pl_plane planes[2];
+    REQUIRE(dp);
+
+    // One row of 10 pixels of v210 (two units), where the components take
+    // on the values 1, 2, 3, ... in memory order: Cb Y Cr, Y Cb Y, Cr Y Cb,...
+    enum { W = 10 };
+    uint32_t v210[8];
+    for (int i = 0; i < PL_ARRAY_SIZE(v210); i++) {
+        uint32_t c = 3 * i + 1;
+        v210[i] = c | (c + 1) << 10 | (c + 2) << 20;
+    }
+
+    int num = pl_upload_packed(gpu, dp, planes, tex, &(struct pl_packed_data) {
+        .layout = PL_PACKED_V210,
+        .width  = W,
+        .height = 1,
+        .pixels = v210,
+    }, &staging);
+
+    static const int luma[W] = { 2, 4, 6, 8, 10, 12, 14, 16, 18, 20 };
+    static const int cb[W/2] = { 1, 5, 9, 13, 17 };
+    static const int cr[W/2] = { 3, 7, 11, 15, 19 };
+    uint16_t out[4 * W];
+
+    if (have_packed_fmt(gpu, 1, 10) && have_packed_fmt(gpu, 2, 10)) {
+        REQUIRE(num == 2);
+        REQUIRE(planes[0].components == 1 && planes[1].components == 2);
+        REQUIRE(planes[0].component_mapping[0] == PL_CHANNEL_Y);
+        REQUIRE(tex[1]->params.w == W / 2);
+
+        int c0 = tex[0]->params.format->num_components;
+        if (download_plane(gpu, tex[0], out)) {
+            for (int x = 0; x < W; x++)
+                REQUIRE(abs(out[x * c0] - luma[x] * 64) <= 64);
+        }
+
+        int c1 = tex[1]->params.format->num_components;
+        if (download_plane(gpu, tex[1], out)) {
+            for (int x = 0; x < W / 2; x++) {
+                REQUIRE(abs(out[x * c1 + 0] - cb[x] * 64) <= 64);
+                REQUIRE(abs(out[x * c1 + 1] - cr[x] * 64) <= 64);
+            }
+        }
+    } else {
+        REQUIRE(num == 0);
+    }
+
+    // Unaligned 24-bit BGR, with a staging buffer that can't be used as a
+    // storage buffer (e.g. left over from pl_upload_planes) and must be
+    // replaced
+    pl_buf_destroy(gpu, &staging);
+    staging = pl_buf_create(gpu, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = 1024,
+        .host_writable = true,
+    });
+    REQUIRE(staging);
+
+    static const uint8_t bgr24[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    const struct pl_packed_data bgr_data = {
+        .layout = PL_PACKED_BGR24,
+        .width  = 3,
+        .height = 1,
+        .pixels = bgr24,
+    };
+
+    num = pl_upload_packed(gpu, dp, planes, tex, &bgr_data, &staging);
+    if (have_packed_fmt(gpu, 3, 8)) {
+        REQUIRE(num == 1);
+        REQUIRE(staging && staging->params.type == PL_BUF_STORAGE);
+        REQUIRE(planes[0].components == 3);
+        int c0 = tex[0]->params.format->num_components;
+        uint8_t *out8 = (uint8_t *) out;
+        if (tex[0]->params.format->texel_size == c0 &&
+            download_plane(gpu, tex[0], out))
+        {
+            for (int x = 0; x < 3; x++) {
+                REQUIRE(out8[x * c0 + 0] == bgr24[x * 3 + 2]);
+                REQUIRE(out8[x * c0 + 1] == bgr24[x * 3 + 1]);
+                REQUIRE(out8[x * c0 + 2] == bgr24[x * 3 + 0]);
+            }
+        }
+
+        // Caller-supplied buffers too small for the data must be rejected
+        const struct pl_buf *small = pl_buf_create(gpu, &(struct pl_buf_params) {
+            .type = PL_BUF_STORAGE,
+            .size = 8,
+        });
+        REQUIRE(small);
+        REQUIRE(!pl_upload_packed(gpu, dp, planes, tex, &(struct pl_packed_data) {
+            .layout = PL_PACKED_BGR24,
+            .width  = 3,
+            .height = 1,
+            .buf    = small,
+        }, NULL));
+        REQUIRE(!pl_upload_packed(gpu, dp, planes, tex, &(struct pl_packed_data) {
+            .layout     = PL_PACKED_BGR24,
+            .width      = 2,
+            .height     = 1,
+            .buf        = small,
+            .buf_offset = 4,
+        }, NULL));
+        pl_buf_destroy(gpu, &small);
+    } else {
+        REQUIRE(num == 0);
+    }
+
+    pl_buf_destroy(gpu, &staging);
+    pl_tex_destroy(gpu, &tex[0]);
+    pl_tex_destroy(gpu, &tex[1]);
+    pl_dispatch_destroy(&dp);
+}
+
+static void pl_repack_tests(const struct pl_gpu *gpu)
+{
+    // 10-bit samples in the high bits of 16-bit words, with garbage in the
+    // low bits. No format can ignore the padding, so this gets repacked
+    enum { W = 7, H = 3, STRIDE = 8 };
+    static uint16_t data[STRIDE * H];
+    for (int i = 0; i < PL_ARRAY_SIZE(data); i++)
+        data[i] = (i * 37 & 0x3FF) << 6 | (i & 0x3F);
+
+    struct pl_plane_data pd = {
+        .type           = PL_FMT_UNORM,
+        .width          = W,
+        .height         = H,
+        .component_size = {10},
+        .component_pad  = {6},
+        .pixel_stride   = sizeof(uint16_t),
+        .row_stride     = STRIDE * sizeof(uint16_t),
+        .pixels         = data,
+    };
+
+    if (pl_plane_find_fmt(gpu, NULL, &pd))
+        return;
+
+    const struct pl_tex *tex = NULL;
+    struct pl_plane plane;
+    REQUIRE(pl_upload_plane(gpu, &plane, &tex, &pd));
+    REQUIRE(plane.components == 1);
+    REQUIRE(tex->params.format->component_depth[0] == 16);
+
+    uint16_t out[4 * W * H];
+    int comps = tex->params.format->num_components;
+    if (download_plane(gpu, tex, out)) {
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                uint16_t c = data[y * STRIDE + x] >> 6;
+                REQUIRE(out[(y * W + x) * comps] == (c << 6 | c >> 4));
+            }
+        }
+    }
+
+    pl_tex_destroy(gpu, &tex);
+}
+
+static void pl_overlay_atlas_tests(const struct pl_gpu *gpu)
+{
+    uint8_t data[16 * 16];
+    for (int i = 0; i < PL_ARRAY_SIZE(data); i++)
+        data[i] = i;
+
+    // Bitmaps of varying sizes, forcing multiple shelves
+    struct pl_overlay_bitmap bitmaps[50];
+    for (int i = 0; i < PL_ARRAY_SIZE(bitmaps); i++) {
+        bitmaps[i] = (struct pl_overlay_bitmap) {
+            .data = data,
+            .w = 1 + i % 16,
+            .h = 1 + (i * 7) % 16,
+            .stride = 16,
+            .dst = { i, i, i + 1 + i % 16, i + 1 + (i * 7) % 16 },
+            .color = { 1.0, 1.0, 1.0, 1.0 },
+        };
+    }
+
+    struct pl_overlay_part parts[PL_ARRAY_SIZE(bitmaps)];
+    struct pl_plane plane;
+    const struct pl_tex *tex = NULL;
+    if (!pl_upload_overlay_atlas(gpu, &plane, &tex, parts, bitmaps,
+                                 PL_ARRAY_SIZE(bitmaps)))
+    {
+        pl_tex_destroy(gpu, &tex);
+        return;
+    }
+
+    REQUIRE(plane.texture == tex);
+    REQUIRE(plane.components == 1);
+    for (int i = 0; i < PL_ARRAY_SIZE(parts); i++) {
+        const struct pl_rect2df *a = &parts[i].src;
+        REQUIRE(pl_rect_w(*a) == bitmaps[i].w && pl_rect_h(*a) == bitmaps[i].h);
+        REQUIRE(a->x0 >= 0 && a->x1 <= tex->params.w);
+        REQUIRE(a->y0 >= 0 && a->y1 <= tex->params.h);
+        REQUIRE(parts[i].dst.x0 == bitmaps[i].dst.x0);
+
+        for (int j = 0; j < i; j++) {
+            const struct pl_rect2df *b = &parts[j].src;
+            REQUIRE(a->x1 <= b->x0 || b->x1 <= a->x0 ||
+                    a->y1 <= b->y0 || b->y1 <= a->y0);
+        }
+    }
+
+    pl_tex_destroy(gpu, &tex);
+}
+
 static void gpu_tests(const struct pl_gpu *gpu)
 {
     pl_buffer_tests(gpu);
     pl_texture_tests(gpu);
     pl_shader_tests(gpu);
+    pl_ssbo_binding_tests(gpu);
     pl_scaler_tests(gpu);
+    pl_blit_filtered_tests(gpu);
+    pl_upload_packed_tests(gpu);
+    pl_repack_tests(gpu);
+    pl_lut_cache_tests(gpu);
     pl_render_tests(gpu);
+    pl_offscreen_tests(gpu);
+    pl_overlay_atlas_tests(gpu);
 }
@@ -90,6 +90,183 @@ static void opengl_swapchain_tests(const struct pl_opengl *gl,
     pl_swapchain_destroy(&sw);
 }
 
+struct upload_priv {
+    EGLDisplay display;
+    EGLContext context;
+};
+
+static bool upload_make_current(void *priv)
+{
+    struct upload_priv *p = priv;
+    return eglMakeCurrent(p->display, EGL_NO_SURFACE, EGL_NO_SURFACE, p->context);
+}
+
+static void upload_release_current(void *priv)
+{
+    struct upload_priv *p = priv;
+    eglMakeCurrent(p->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+static void opengl_upload_tests(const struct pl_opengl *gl,
+                                EGLDisplay display, EGLContext shared)
+{
+    if (shared == EGL_NO_CONTEXT)
+        return;
+
+    const struct pl_gpu *gpu = gl->gpu;
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                           PL_FMT_CAP_HOST_READABLE);
+    if (!fmt)
+        return;
+
+    struct pl_opengl_uploader *up;
+    up = pl_opengl_uploader_create(gl, &(struct pl_opengl_uploader_params) {
+        .make_current = upload_make_current,
+        .release_current = upload_release_current,
+        .priv = &(struct upload_priv) { display, shared },
+    });
+    if (!up)
+        return;
+
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 16,
+        .h = 16,
+        .format = fmt,
+        .host_writable = true,
+        .host_readable = true,
+    });
+    REQUIRE(tex);
+
+    uint8_t src[16 * 16], dst[16 * 16];
+    for (int n = 0; n < 4; n++) {
+        for (int i = 0; i < sizeof(src); i++)
+            src[i] = i + n * 17;
+
+        REQUIRE(pl_opengl_upload(up, &(struct pl_tex_transfer_params) {
+            .tex = tex,
+            .ptr = src,
+        }));
+
+        pl_opengl_uploader_sync(up, tex);
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = tex,
+            .ptr = dst,
+        }));
+        REQUIRE(memcmp(src, dst, sizeof(src)) == 0);
+    }
+
+    // Consecutive uploads only need to be synced once, for the last one
+    uint8_t src2[16 * 16];
+    for (int i = 0; i < sizeof(src2); i++)
+        src2[i] = 255 - i;
+
+    REQUIRE(pl_opengl_upload(up, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = src,
+    }));
+    REQUIRE(pl_opengl_upload(up, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = src2,
+    }));
+
+    pl_opengl_uploader_sync(up, tex);
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = dst,
+    }));
+    REQUIRE(memcmp(src2, dst, sizeof(src2)) == 0);
+
+    // Destroying a texture with pending uploads releases their fences
+    REQUIRE(pl_opengl_upload(up, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = src,
+    }));
+
+    pl_tex_destroy(gpu, &tex);
+    pl_opengl_uploader_destroy(&up);
+}
+
+static void lazy_state_draw(struct pl_dispatch *dp, const struct pl_tex *fbo,
+                            float val, bool literal)
+{
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    REQUIRE(sh_require(sh, PL_SHADER_SIG_NONE, fbo->params.w, fbo->params.h));
+    if (literal) {
+        GLSL("vec4 color = vec4(%f); \n", val);
+    } else {
+        ident_t id = sh_var(sh, (struct pl_shader_var) {
+            .var  = pl_var_float("val"),
+            .data = &val,
+        });
+        GLSL("vec4 color = vec4(%s); \n", id);
+    }
+    sh->res.output = PL_SHADER_SIG_COLOR;
+    REQUIRE(pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+        .shader = &sh,
+        .target = fbo,
+    }));
+}
+
+static void opengl_lazy_state_tests(const struct pl_gpu *gpu)
+{
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32,
+                                           PL_FMT_CAP_RENDERABLE |
+                                           PL_FMT_CAP_HOST_READABLE);
+    if (!fmt)
+        return;
+
+    const struct pl_tex *fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 16,
+        .h = 16,
+        .format = fmt,
+        .renderable = true,
+        .host_readable = true,
+    });
+    REQUIRE(fbo);
+
+    struct pl_dispatch *dp = pl_dispatch_create(gpu->ctx, gpu);
+    float data[16 * 16 * 4];
+    GLint prog, fb;
+
+    // Consecutive passes leave their program and framebuffer bound, and must
+    // still pick up updated uniforms and program switches in between
+    static const struct { float val; bool literal; } draws[] = {
+        { 0.25, false },
+        { 0.75, false },
+        { 0.50, true  },
+    };
+
+    for (int i = 0; i < PL_ARRAY_SIZE(draws); i++) {
+        lazy_state_draw(dp, fbo, draws[i].val, draws[i].literal);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fb);
+        REQUIRE(prog && fb);
+
+        // Any other `pl_gpu` operation resets the deferred state first
+        REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+            .tex = fbo,
+            .ptr = data,
+        }));
+
+        glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fb);
+        REQUIRE(!prog && !fb);
+
+        for (int n = 0; n < PL_ARRAY_SIZE(data); n++)
+            REQUIRE(feq(data[n], draws[i].val, 1e-6));
+    }
+
+    // As does resetting it explicitly
+    lazy_state_draw(dp, fbo, 1.0, true);
+    pl_opengl_reset_state(gpu);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fb);
+    REQUIRE(!prog && !fb);
+
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(gpu, &fbo);
+}
+
 int main()
 {
     // Create the OpenGL context
@@ -152,7 +329,7 @@ int main()
         if (!eglBindAPI(egl_vers[i].api))
             goto error;
 
-        EGLContext egl;
+        EGLContext egl, shared = EGL_NO_CONTEXT;
         if (egl_vers[i].api == EGL_OPENGL_ES_API) {
             // OpenGL ES
             const EGLint egl_attribs[] = {
@@ -163,6 +340,8 @@ int main()
 
             printf("Attempting creation of OpenGL ES v%d context\n", egl_vers[i].major);
             egl = eglCreateContext(dpy, config, EGL_NO_CONTEXT, egl_attribs);
+            if (egl)
+                shared = eglCreateContext(dpy, config, egl, egl_attribs);
         } else {
             // Desktop OpenGL
             const int egl_attribs[] = {
@@ -176,6 +355,8 @@ int main()
             printf("Attempting creation of Desktop OpenGL v%d.%d context\n",
                    egl_vers[i].major, egl_vers[i].minor);
             egl = eglCreateContext(dpy, config, EGL_NO_CONTEXT, egl_attribs);
+            if (egl)
+                shared = eglCreateContext(dpy, config, egl, egl_attribs);
         }
 
         if (!egl)
@@ -221,9 +402,19 @@ int main()
         gpu_tests(gpu);
         opengl_interop_tests(gpu);
         opengl_swapchain_tests(gl, dpy, surf);
+        opengl_upload_tests(gl, dpy, shared);
+
+        pl_opengl_destroy(&gl);
 
+        params.lazy_state = true;
+        gl = pl_opengl_create(ctx, &params);
+        REQUIRE(gl);
+        opengl_lazy_state_tests(gl->gpu);
         pl_opengl_destroy(&gl);
+
         eglDestroySurface(dpy, surf);
+        if (shared != EGL_NO_CONTEXT)
+            eglDestroyContext(dpy, shared);
         eglDestroyContext(dpy, egl);
 
         // Reduce log spam after first successful test
@@ -1,5 +1,15 @@
+#include <pthread.h>
+
 #include "tests.h"
 #include "gpu.h"
+#include "swapchain.h"
+
+static void *alloc_thread(void *arg)
+{
+    for (int i = 0; i < 10; i++)
+        talloc_free(talloc_size(NULL, 100));
+    return NULL;
+}
 
 int main()
 {
@@ -85,4 +95,85 @@ int main()
     REQUIRE(layout.offset == 6 * sizeof(float));
     REQUIRE(layout.stride == 2 * sizeof(float));
     REQUIRE(layout.size == 20 * 2 * 2 * sizeof(float));
+
+    // Test the locale-invariant number formatting used for shader generation
+    struct bstr str = {0};
+    bstr_xappend_asprintf_c(NULL, &str, "%f %f %f %f %d", 0.5, -2.0, 1e-7,
+                            123.4567894, -42);
+    bstr_xappend(NULL, &str, bstr0(" "));
+    bstr_xappend_float_c(NULL, &str, 0.1);
+    REQUIRE(bstr_equals0(str, "0.5 -2.0 0.0 123.456789 -42 0.1"));
+    talloc_free(str.start);
+
+    // Small, short-lived allocations are recycled by the allocator
+    struct xta_stats before, after;
+    talloc_free(talloc_size(NULL, 100));
+    talloc_get_stats(&before);
+    void *ctx = talloc_new(NULL);
+    for (int i = 0; i < 10; i++)
+        talloc_free(talloc_zero_size(ctx, 100));
+    talloc_free(ctx);
+    talloc_get_stats(&after);
+    REQUIRE(after.allocs - before.allocs >= 11);
+    REQUIRE(after.frees - before.frees == after.allocs - before.allocs);
+    REQUIRE(after.pool_hits - before.pool_hits >= 10);
+
+    // Allocations made by other threads are accounted for as well, even
+    // after they exit
+    pthread_t thread;
+    talloc_get_stats(&before);
+    REQUIRE(pthread_create(&thread, NULL, alloc_thread, NULL) == 0);
+    REQUIRE(pthread_join(thread, NULL) == 0);
+    talloc_get_stats(&after);
+    REQUIRE(after.allocs - before.allocs >= 10);
+    REQUIRE(after.frees - before.frees >= 10);
+
+    // Per-context statistics only count live allocations
+    struct xta_ctx_stats cstats;
+    ctx = talloc_size(NULL, 16);
+    void *child = talloc_size(ctx, 100);
+    talloc_size(child, 200);
+    talloc_free(talloc_size(ctx, 300));
+    talloc_get_ctx_stats(ctx, &cstats);
+    REQUIRE(cstats.blocks == 3);
+    REQUIRE(cstats.bytes == 316);
+    talloc_get_ctx_stats(child, &cstats);
+    REQUIRE(cstats.blocks == 2);
+    REQUIRE(cstats.bytes == 300);
+    talloc_free(ctx);
+
+    // Adaptive swapchain depth: frames well within the budget only lower the
+    // depth after being sustained, one step at a time
+    const uint64_t refresh = 16666667;
+    struct pl_sw_depth sd = {0};
+    int depth = 3, changed = 0;
+    for (int i = 0; i < 119; i++)
+        depth = pl_sw_depth_update(&sd, depth, 3, 2000000, 0, refresh);
+    REQUIRE(depth == 3);
+    depth = pl_sw_depth_update(&sd, depth, 3, 2000000, 0, refresh);
+    REQUIRE(depth == 2);
+
+    // Changes are followed by a settling period, and never go below 1
+    for (int i = 0; i < 1000; i++) {
+        int new_depth = pl_sw_depth_update(&sd, depth, 3, 2000000, 0, refresh);
+        changed += new_depth != depth;
+        depth = new_depth;
+    }
+    REQUIRE(depth == 1);
+    REQUIRE(changed == 1);
+
+    // Slow frames raise the depth again, clamped to the maximum
+    for (int i = 0; i < 100; i++)
+        depth = pl_sw_depth_update(&sd, depth, 3, 15000000, 0, refresh);
+    REQUIRE(depth == 3);
+
+    // Without a known refresh rate, the interval between frames is the budget
+    sd = (struct pl_sw_depth) {0};
+    depth = 3;
+    for (int i = 0; i < 200; i++)
+        depth = pl_sw_depth_update(&sd, depth, 3, 12000000, 10000000, 0);
+    REQUIRE(depth == 3);
+    for (int i = 0; i < 200; i++)
+        depth = pl_sw_depth_update(&sd, depth, 3, 2000000, 10000000, 0);
+    REQUIRE(depth == 2);
 }
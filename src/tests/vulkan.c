@@ -2,6 +2,22 @@
 #include "vulkan/command.h"
 #include "vulkan/gpu.h"
 #include <vulkan/vulkan.h>
+#include <unistd.h>
+
+// Signals the `signal_handle` of a `pl_sync`, as if done by an external API.
+// Re-uses our internal helpers for this
+static void vulkan_signal_sync(const struct pl_vulkan *pl_vk,
+                               const struct pl_sync *sync)
+{
+    struct vk_ctx *vk = TA_PRIV(pl_vk);
+    struct vk_cmd *cmd = vk_cmd_begin(vk, vk->pool_graphics);
+    VkSemaphore signal;
+    REQUIRE(cmd);
+    pl_vk_sync_unwrap(sync, NULL, &signal);
+    vk_cmd_sig(cmd, signal);
+    vk_cmd_queue(vk, &cmd);
+    REQUIRE(vk_flush_commands(vk));
+}
 
 static void vulkan_interop_tests(const struct pl_vulkan *pl_vk,
                                  enum pl_handle_type handle_type)
@@ -45,16 +61,7 @@ static void vulkan_interop_tests(const struct pl_vulkan *pl_vk,
         ((struct pl_tex_params *) &tex->params)->export_handle = PL_HANDLE_DMA_BUF;
 
         REQUIRE(pl_tex_export(gpu, tex, sync));
-
-        // Re-use our internal helpers to signal this VkSemaphore
-        struct vk_ctx *vk = TA_PRIV(pl_vk);
-        struct vk_cmd *cmd = vk_cmd_begin(vk, vk->pool_graphics);
-        VkSemaphore signal;
-        REQUIRE(cmd);
-        pl_vk_sync_unwrap(sync, NULL, &signal);
-        vk_cmd_sig(cmd, signal);
-        vk_cmd_queue(vk, &cmd);
-        REQUIRE(vk_flush_commands(vk));
+        vulkan_signal_sync(pl_vk, sync);
 
         // Do something with the image again to "import" it
         pl_tex_clear(gpu, tex, (float[4]){0});
@@ -63,6 +70,61 @@ static void vulkan_interop_tests(const struct pl_vulkan *pl_vk,
         pl_sync_destroy(gpu, &sync);
         pl_tex_destroy(gpu, &tex);
     }
+
+    const struct pl_fmt *rfmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8,
+                                            PL_FMT_CAP_RENDERABLE |
+                                            PL_FMT_CAP_SAMPLEABLE);
+    if ((gpu->export_caps.sync & handle_type) && rfmt) {
+        // Hand off a rendered frame using `pl_render_target.export_sync`
+        const struct pl_sync *sync = pl_sync_create(gpu, handle_type);
+        const struct pl_tex *src = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = 16,
+            .h = 16,
+            .format = rfmt,
+            .sampleable = true,
+        });
+        const struct pl_tex *fbo = pl_tex_create(gpu, &(struct pl_tex_params) {
+            .w = 32,
+            .h = 32,
+            .format = rfmt,
+            .renderable = true,
+            .blit_dst = true,
+        });
+
+        REQUIRE(sync);
+        REQUIRE(src);
+        REQUIRE(fbo);
+        ((struct pl_tex_params *) &fbo->params)->export_handle = PL_HANDLE_DMA_BUF;
+
+        struct pl_image image = {
+            .num_planes = 1,
+            .planes[0] = {
+                .texture = src,
+                .components = 4,
+                .component_mapping = {0, 1, 2, 3},
+            },
+            .repr = pl_color_repr_rgb,
+            .color = pl_color_space_srgb,
+        };
+
+        struct pl_render_target target = {
+            .fbo = fbo,
+            .repr = pl_color_repr_rgb,
+            .color = pl_color_space_srgb,
+            .export_sync = sync,
+        };
+
+        struct pl_renderer *rr = pl_renderer_create(gpu->ctx, gpu);
+        REQUIRE(pl_render_image(rr, &image, &target, NULL));
+        vulkan_signal_sync(pl_vk, sync);
+        pl_tex_clear(gpu, fbo, (float[4]){0});
+        pl_gpu_finish(gpu);
+
+        pl_renderer_destroy(&rr);
+        pl_sync_destroy(gpu, &sync);
+        pl_tex_destroy(gpu, &fbo);
+        pl_tex_destroy(gpu, &src);
+    }
 }
 
 static void vulkan_test_export_import(const struct pl_vulkan *pl_vk,
@@ -74,8 +136,9 @@ static void vulkan_test_export_import(const struct pl_vulkan *pl_vk,
         !(gpu->import_caps.tex & handle_type))
         return;
 
-    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 0, 0,
-                                           PL_FMT_CAP_BLITTABLE);
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                           PL_FMT_CAP_BLITTABLE |
+                                           PL_FMT_CAP_HOST_READABLE);
     if (!fmt)
         return;
 
@@ -83,24 +146,130 @@ static void vulkan_test_export_import(const struct pl_vulkan *pl_vk,
         .w = 32,
         .h = 32,
         .format = fmt,
+        .host_writable = true,
         .export_handle = handle_type,
     });
     REQUIRE(export);
     REQUIRE(export->shared_mem.handle.fd > -1);
-
+    REQUIRE(!export->shared_mem.has_drm_format_mod);
+
+    uint8_t data[32 * 32], out[32 * 32];
+    for (int i = 0; i < PL_ARRAY_SIZE(data); i++)
+        data[i] = i;
+    REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+        .tex = export,
+        .ptr = data,
+    }));
+
+    // Import the memory without specifying any DRM format modifier, which
+    // must use the exporter's (implicit) layout
     const struct pl_tex *import = pl_tex_create(gpu, &(struct pl_tex_params) {
         .w = 32,
         .h = 32,
         .format = fmt,
+        .host_readable = true,
         .import_handle = handle_type,
-        .shared_mem = export->shared_mem,
+        .shared_mem = {
+            .handle = export->shared_mem.handle,
+            .size = export->shared_mem.size,
+            .offset = export->shared_mem.offset,
+            .dedicated = export->shared_mem.dedicated,
+        },
     });
     REQUIRE(import);
-
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = import,
+        .ptr = out,
+    }));
+    REQUIRE(memcmp(data, out, sizeof(data)) == 0);
     pl_tex_destroy(gpu, &import);
+
+    // Re-importing the same memory via a different fd must hit the cache
+    struct pl_tex_params params = {
+        .w = 32,
+        .h = 32,
+        .format = fmt,
+        .host_readable = true,
+        .import_handle = handle_type,
+        .shared_mem = export->shared_mem,
+    };
+
+    import = pl_tex_import_get(gpu, &params);
+    REQUIRE(import);
+    memset(out, 0, sizeof(out));
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = import,
+        .ptr = out,
+    }));
+    REQUIRE(memcmp(data, out, sizeof(data)) == 0);
+    const struct pl_tex *first = import;
+    pl_tex_import_put(gpu, &import);
+
+    params.shared_mem.handle.fd = dup(export->shared_mem.handle.fd);
+    REQUIRE(params.shared_mem.handle.fd > -1);
+    import = pl_tex_import_get(gpu, &params);
+    close(params.shared_mem.handle.fd);
+    REQUIRE(import == first);
+    pl_tex_import_put(gpu, &import);
+    pl_tex_import_cache_flush(gpu);
     pl_tex_destroy(gpu, &export);
 }
 
+static void vulkan_test_host_ptr(const struct pl_vulkan *pl_vk)
+{
+    const struct pl_gpu *gpu = pl_vk->gpu;
+    if (!(gpu->import_caps.buf & PL_HANDLE_HOST_PTR))
+        return;
+
+    const struct pl_fmt *fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 1, 8, 8,
+                                           PL_FMT_CAP_HOST_READABLE);
+    if (!fmt)
+        return;
+
+    const size_t size = 64 * 64;
+    uint8_t *mem = NULL;
+    REQUIRE(posix_memalign((void **) &mem, 0x1000, 2 * 0x1000 + size) == 0);
+    for (int i = 0; i < size; i++)
+        mem[0x1000 + i] = i;
+
+    const struct pl_buf *buf = pl_buf_create(gpu, &(struct pl_buf_params) {
+        .type = PL_BUF_TEX_TRANSFER,
+        .size = size,
+        .import_handle = PL_HANDLE_HOST_PTR,
+        .shared_mem = {
+            .handle.ptr = mem,
+            .size = 2 * 0x1000 + size,
+            .offset = 0x1000,
+        },
+    });
+    REQUIRE(buf);
+
+    const struct pl_tex *tex = pl_tex_create(gpu, &(struct pl_tex_params) {
+        .w = 64,
+        .h = 64,
+        .format = fmt,
+        .host_writable = true,
+        .host_readable = true,
+    });
+    REQUIRE(tex);
+
+    REQUIRE(pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .buf = buf,
+    }));
+
+    uint8_t out[64 * 64];
+    REQUIRE(pl_tex_download(gpu, &(struct pl_tex_transfer_params) {
+        .tex = tex,
+        .ptr = out,
+    }));
+    REQUIRE(memcmp(out, mem + 0x1000, size) == 0);
+
+    pl_buf_destroy(gpu, &buf);
+    pl_tex_destroy(gpu, &tex);
+    free(mem);
+}
+
 static void vulkan_swapchain_tests(const struct pl_vulkan *vk, VkSurfaceKHR surf)
 {
     if (!surf)
@@ -130,6 +299,12 @@ static void vulkan_swapchain_tests(const struct pl_vulkan *vk, VkSurfaceKHR surf
         REQUIRE(pl_swapchain_submit_frame(sw));
         pl_swapchain_swap_buffers(sw);
 
+        struct pl_vulkan_submit_stats stats;
+        pl_vulkan_submit_stats(gpu, &stats);
+        REQUIRE(stats.total_submits > 0);
+        REQUIRE(stats.cmds >= stats.submits);
+        REQUIRE(stats.total_cmds >= stats.total_submits);
+
         // Try resizing the swapchain in the middle of rendering
         if (i == 5) {
             w = 320;
@@ -224,7 +399,22 @@ int main()
         gpu_tests(vk->gpu);
         vulkan_swapchain_tests(vk, surf);
 
-        // Test importing this context via the vulkan interop API
+        // Round-trip the pipeline cache shared by all of the passes above
+        size_t pcache_size = pl_vulkan_save_pipeline_cache(vk->gpu, NULL, 0);
+        REQUIRE(pcache_size);
+        uint8_t *pcache = malloc(pcache_size);
+        REQUIRE(pcache);
+        REQUIRE(pl_vulkan_save_pipeline_cache(vk->gpu, pcache, pcache_size) == pcache_size);
+        pl_vulkan_load_pipeline_cache(vk->gpu, pcache, pcache_size);
+        free(pcache);
+
+        // Test importing this context via the vulkan interop API, re-using
+        // the format capabilities probed by the first context
+        size_t cache_size = pl_vulkan_save_format_cache(vk->gpu, NULL);
+        uint8_t *cache = malloc(cache_size);
+        REQUIRE(cache);
+        REQUIRE(pl_vulkan_save_format_cache(vk->gpu, cache) == cache_size);
+
         struct pl_vulkan_import_params iparams = {
             .instance = vk->instance,
             .phys_device = vk->phys_device,
@@ -236,10 +426,22 @@ int main()
             .queue_graphics = vk->queue_graphics,
             .queue_compute = vk->queue_compute,
             .queue_transfer = vk->queue_transfer,
+            .format_cache = cache,
+            .format_cache_len = cache_size,
+            .blacklist_caps = params.blacklist_caps,
         };
         const struct pl_vulkan *vk2 = pl_vulkan_import(ctx, &iparams);
         REQUIRE(vk2);
+        REQUIRE(vk2->gpu->num_formats == vk->gpu->num_formats);
+        for (int n = 0; n < vk->gpu->num_formats; n++) {
+            const struct pl_fmt *a = vk->gpu->formats[n], *b = vk2->gpu->formats[n];
+            REQUIRE(strcmp(a->name, b->name) == 0);
+            REQUIRE(a->caps == b->caps);
+            REQUIRE(a->num_modifiers == b->num_modifiers);
+        }
+        REQUIRE(pl_vulkan_save_format_cache(vk2->gpu, NULL) == cache_size);
         pl_vulkan_destroy(&vk2);
+        free(cache);
 
         // Run these tests last because they disable some validation layers
 #ifdef VK_HAVE_UNIX
@@ -251,15 +453,42 @@ int main()
         vulkan_interop_tests(vk, PL_HANDLE_WIN32);
         vulkan_interop_tests(vk, PL_HANDLE_WIN32_KMT);
 #endif
+        vulkan_test_host_ptr(vk);
 
         pl_vulkan_destroy(&vk);
 
-        // Re-run the same export/import tests with async queues disabled
+        // Re-run the same export/import tests with async queues disabled,
+        // and a single queue reserved for streams
         params.async_compute = false;
         params.async_transfer = false;
+        params.num_streams = 1;
         vk = pl_vulkan_create(ctx, &params);
         REQUIRE(vk); // it succeeded the first time
 
+        const struct pl_vulkan *stream = pl_vulkan_stream_create(ctx, vk);
+        if (stream) {
+            REQUIRE(!pl_vulkan_stream_create(ctx, vk)); // only one reserved
+            REQUIRE(stream->device == vk->device);
+
+            static const uint8_t data[16] = {1, 2, 3, 4};
+            uint8_t out[16] = {0};
+            const struct pl_buf *buf = pl_buf_create(stream->gpu, &(struct pl_buf_params) {
+                .size = sizeof(data),
+                .host_readable = true,
+                .initial_data = data,
+            });
+            REQUIRE(buf);
+            REQUIRE(pl_buf_read(stream->gpu, buf, 0, out, sizeof(out)));
+            REQUIRE(memcmp(data, out, sizeof(data)) == 0);
+            pl_buf_destroy(stream->gpu, &buf);
+            pl_vulkan_destroy(&stream);
+
+            // The queue should be available again
+            stream = pl_vulkan_stream_create(ctx, vk);
+            REQUIRE(stream);
+            pl_vulkan_destroy(&stream);
+        }
+
 #ifdef VK_HAVE_UNIX
         vulkan_interop_tests(vk, PL_HANDLE_FD);
         vulkan_interop_tests(vk, PL_HANDLE_DMA_BUF);
@@ -0,0 +1,170 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "context.h"
+#include "common.h"
+#include "gpu.h"
+
+#include <libplacebo/utils/blit.h>
+
+// Picks a format for the intermediate (vertically scaled) texture of the
+// two-pass fallback, preferring higher precision like the renderer does. This
+// may have more components than the source texture, if needed.
+static const struct pl_fmt *find_tmp_fmt(const struct pl_gpu *gpu, int comps)
+{
+    static const struct {
+        enum pl_fmt_type type;
+        int depth;
+    } configs[] = {
+        {PL_FMT_FLOAT, 16},
+        {PL_FMT_UNORM, 16},
+        {PL_FMT_SNORM, 16},
+        {PL_FMT_UNORM, 8},
+    };
+
+    for (int i = 0; i < PL_ARRAY_SIZE(configs); i++) {
+        for (int c = comps; c <= 4; c++) {
+            const struct pl_fmt *fmt;
+            fmt = pl_find_fmt(gpu, configs[i].type, c, configs[i].depth, 0,
+                              PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_RENDERABLE);
+            if (fmt)
+                return fmt;
+        }
+    }
+
+    return NULL;
+}
+
+bool pl_tex_blit_filtered(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                          const struct pl_blit_filtered_params *params)
+{
+    const struct pl_tex *src = params->src, *dst = params->dst;
+    pl_assert(src && dst);
+
+    if (!src->params.sampleable) {
+        PL_ERR(gpu, "Source texture for filtered blit must be sampleable!");
+        return false;
+    }
+
+    if (!dst->params.renderable && !dst->params.storable) {
+        PL_ERR(gpu, "Destination texture for filtered blit must be renderable "
+               "or storable!");
+        return false;
+    }
+
+    struct pl_rect2df src_rc = params->src_rc;
+    if (!pl_rect_w(src_rc) || !pl_rect_h(src_rc)) {
+        src_rc = (struct pl_rect2df) {
+            .x1 = src->params.w,
+            .y1 = src->params.h,
+        };
+    }
+
+    struct pl_rect2d dst_rc = params->dst_rc;
+    if (!pl_rect_w(dst_rc) || !pl_rect_h(dst_rc)) {
+        dst_rc = (struct pl_rect2d) {
+            .x1 = dst->params.w,
+            .y1 = dst->params.h,
+        };
+    }
+
+    int new_w = abs(pl_rect_w(dst_rc)), new_h = abs(pl_rect_h(dst_rc));
+    struct pl_sample_src sample_src = {
+        .tex = src,
+        .components = src->params.format->num_components,
+        .rect = src_rc,
+        .new_w = new_w,
+        .new_h = new_h,
+    };
+
+    struct pl_shader_obj *tmp_lut = NULL;
+    struct pl_sample_filter_params fparams = {
+        .antiring = params->antiring,
+        .no_compute = !dst->params.storable,
+        .lut = PL_DEF(params->lut, &tmp_lut),
+    };
+
+    const struct pl_tex *tmp = NULL;
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    bool ok;
+
+    if (!params->filter) {
+        ok = pl_shader_sample_direct(sh, &sample_src);
+    } else if (params->filter->polar) {
+        fparams.filter = *params->filter;
+        ok = pl_shader_sample_polar(sh, &sample_src, &fparams);
+    } else {
+        fparams.filter = *params->filter;
+        ok = pl_shader_sample_ortho_fused(sh, &sample_src, &fparams);
+        if (!ok) {
+            // Fall back to scaling vertically into an intermediate texture,
+            // followed by a separate horizontal pass
+            const struct pl_fmt *fmt;
+            fmt = find_tmp_fmt(gpu, src->params.format->num_components);
+            if (!fmt) {
+                PL_ERR(gpu, "Found no renderable format for the intermediate "
+                       "texture of a filtered blit!");
+                goto done;
+            }
+
+            tmp = pl_tex_pool_get(gpu, &(struct pl_tex_params) {
+                .w = src->params.w,
+                .h = new_h,
+                .format = fmt,
+                .sampleable = true,
+                .renderable = true,
+            });
+            if (!tmp)
+                goto done;
+
+            if (!pl_shader_sample_ortho(sh, PL_SEP_VERT, &sample_src, &fparams))
+                goto done;
+
+            ok = pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+                .shader = &sh,
+                .target = tmp,
+            });
+            if (!ok)
+                goto done;
+
+            sample_src.tex = tmp;
+            sample_src.rect = (struct pl_rect2df) {
+                .x0 = src_rc.x0,
+                .x1 = src_rc.x1,
+                .y1 = new_h,
+            };
+
+            sh = pl_dispatch_begin(dp);
+            ok = pl_shader_sample_ortho(sh, PL_SEP_HORIZ, &sample_src,
+                                        &fparams);
+        }
+    }
+
+    if (ok) {
+        ok = pl_dispatch_finish(dp, &(struct pl_dispatch_params) {
+            .shader = &sh,
+            .target = dst,
+            .rect = dst_rc,
+        });
+    }
+
+done:
+    pl_dispatch_abort(dp, &sh);
+    pl_tex_pool_put(gpu, &tmp);
+    pl_shader_obj_destroy(&tmp_lut);
+    return ok;
+}
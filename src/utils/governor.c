@@ -0,0 +1,187 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "context.h"
+#include "common.h"
+
+#include <libplacebo/utils/governor.h>
+
+struct pl_render_governor {
+    struct pl_context *ctx;
+    struct pl_render_governor_params params;
+    struct pl_render_params tiers[PL_RENDER_GOVERNOR_TIERS];
+    struct pl_deband_params deband[PL_RENDER_GOVERNOR_TIERS];
+
+    int tier;
+    bool reset;     // whether the renderer's stats need to be reset
+    int frames;     // frames rendered since the last reset
+    int good;       // consecutive frames with enough headroom
+};
+
+static const struct pl_filter_config *reduce_filter(const struct pl_filter_config *f)
+{
+    return (f && f->polar) ? &pl_filter_spline36 : f;
+}
+
+static void setup_tiers(struct pl_render_governor *gov)
+{
+    const struct pl_render_params *base = gov->params.params;
+    for (int i = 0; i < PL_RENDER_GOVERNOR_TIERS; i++) {
+        struct pl_render_params *p = &gov->tiers[i];
+        *p = *base;
+        p->measure_timing = true;
+
+        if (base->deband_params) {
+            gov->deband[i] = *base->deband_params;
+            p->deband_params = &gov->deband[i];
+        }
+
+        switch (i) {
+        case 3:
+            p->upscaler = p->downscaler = NULL;
+            p->plane_upscaler = p->plane_downscaler = NULL;
+            p->deband_params = NULL;
+            p->sigmoid_params = NULL;
+            p->peak_detect_params = NULL;
+            break;
+
+        case 2:
+            if (p->upscaler)
+                p->upscaler = &pl_filter_bicubic;
+            if (p->downscaler)
+                p->downscaler = &pl_filter_bicubic;
+            if (p->plane_upscaler)
+                p->plane_upscaler = &pl_filter_bicubic;
+            if (p->plane_downscaler)
+                p->plane_downscaler = &pl_filter_bicubic;
+            gov->deband[i].iterations = PL_MIN(gov->deband[i].iterations, 1);
+            p->peak_detect_params = NULL;
+            break;
+
+        case 1:
+            p->upscaler = reduce_filter(p->upscaler);
+            p->downscaler = reduce_filter(p->downscaler);
+            p->plane_upscaler = reduce_filter(p->plane_upscaler);
+            p->plane_downscaler = reduce_filter(p->plane_downscaler);
+            gov->deband[i].iterations = (gov->deband[i].iterations + 1) / 2;
+            break;
+
+        case 0:
+            break;
+        }
+    }
+}
+
+struct pl_render_governor *pl_render_governor_create(struct pl_context *ctx,
+                                const struct pl_render_governor_params *params)
+{
+    pl_assert(params->params && params->target_ns);
+    struct pl_render_governor *gov = talloc_zero(NULL, struct pl_render_governor);
+    gov->ctx = ctx;
+    gov->params = *params;
+    gov->params.headroom = PL_DEF(params->headroom, 0.7);
+    gov->params.hold_frames = PL_DEF(params->hold_frames, 120);
+    gov->params.settle_frames = PL_DEF(params->settle_frames, 8);
+    gov->reset = true;
+    setup_tiers(gov);
+    return gov;
+}
+
+void pl_render_governor_destroy(struct pl_render_governor **gov)
+{
+    TA_FREEP(gov);
+}
+
+// Estimates the GPU time per frame from the stats gathered since the last
+// reset, by scaling the average time of every stage by its number of passes
+// per frame. Returns 0 if there are no measurements yet.
+static uint64_t estimate_frame_time(struct pl_renderer *rr, int frames)
+{
+    struct pl_render_stats stats;
+    pl_renderer_get_stats(rr, &stats);
+
+    uint64_t total = 0;
+    for (int i = 0; i < PL_ARRAY_SIZE(stats.stages); i++) {
+        const struct pl_render_stage_stats *st = &stats.stages[i];
+        total += st->average * st->count;
+    }
+
+    return total / frames;
+}
+
+static void set_tier(struct pl_render_governor *gov, int tier)
+{
+    tier = PL_MAX(0, PL_MIN(tier, PL_RENDER_GOVERNOR_TIERS - 1));
+    gov->reset = true;
+    gov->good = 0;
+    if (tier == gov->tier)
+        return;
+
+    PL_INFO(gov, "Switching rendering quality tier: %d -> %d", gov->tier, tier);
+    gov->tier = tier;
+    if (gov->params.tier_cb)
+        gov->params.tier_cb(gov->params.priv, tier);
+}
+
+const struct pl_render_params *pl_render_governor_update(
+        struct pl_render_governor *gov, struct pl_renderer *rr)
+{
+    if (gov->reset) {
+        pl_renderer_reset_stats(rr);
+        gov->reset = false;
+        gov->frames = 0;
+    }
+
+    // Wait for the measurements of the current tier to settle first
+    if (gov->frames++ < gov->params.settle_frames)
+        goto done;
+
+    uint64_t ns = estimate_frame_time(rr, gov->frames - 1);
+    if (!ns)
+        goto done;
+
+    if (ns > gov->params.target_ns) {
+        PL_DEBUG(gov, "Frame time %.3f ms exceeds the target of %.3f ms",
+                 ns / 1e6, gov->params.target_ns / 1e6);
+        set_tier(gov, gov->tier + 1);
+    } else if (ns < gov->params.headroom * gov->params.target_ns) {
+        if (++gov->good >= gov->params.hold_frames && gov->tier > 0)
+            set_tier(gov, gov->tier - 1);
+    } else {
+        gov->good = 0;
+    }
+
+done:
+    return &gov->tiers[gov->tier];
+}
+
+int pl_render_governor_tier(const struct pl_render_governor *gov)
+{
+    return gov->tier;
+}
+
+const struct pl_render_params *pl_render_governor_params(
+        const struct pl_render_governor *gov, int tier)
+{
+    pl_assert(tier >= 0 && tier < PL_RENDER_GOVERNOR_TIERS);
+    return &gov->tiers[tier];
+}
+
+void pl_render_governor_set_tier(struct pl_render_governor *gov, int tier)
+{
+    set_tier(gov, tier);
+}
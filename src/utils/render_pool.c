@@ -0,0 +1,207 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "context.h"
+#include "common.h"
+
+#include <libplacebo/utils/render_pool.h>
+
+struct pool_gpu {
+    const struct pl_gpu *gpu;
+    struct pl_renderer *rr;
+    int group;          // GPUs with the same group are identical
+    int load;           // number of outstanding jobs
+    size_t cache_size;  // size of the cache as of the last sync
+};
+
+struct pl_render_pool {
+    struct pl_context *ctx;
+    struct pl_render_pool_params params;
+    struct pool_gpu *gpus;
+    int num_gpus;
+    int idx_next; // next GPU in round-robin order
+};
+
+static bool glsl_identical(const struct pl_glsl_desc *a,
+                           const struct pl_glsl_desc *b)
+{
+    return a->version == b->version &&
+           a->gles == b->gles &&
+           a->vulkan == b->vulkan &&
+           a->subgroup_size == b->subgroup_size &&
+           a->float16 == b->float16;
+}
+
+static bool limits_identical(const struct pl_gpu_limits *a,
+                             const struct pl_gpu_limits *b)
+{
+    for (int i = 0; i < 3; i++) {
+        if (a->max_group_size[i] != b->max_group_size[i] ||
+            a->max_dispatch[i] != b->max_dispatch[i])
+            return false;
+    }
+
+    return a->max_tex_1d_dim == b->max_tex_1d_dim &&
+           a->max_tex_2d_dim == b->max_tex_2d_dim &&
+           a->max_tex_3d_dim == b->max_tex_3d_dim &&
+           a->max_pushc_size == b->max_pushc_size &&
+           a->max_xfer_size == b->max_xfer_size &&
+           a->max_ubo_size == b->max_ubo_size &&
+           a->max_ssbo_size == b->max_ssbo_size &&
+           a->max_buffer_texels == b->max_buffer_texels &&
+           a->min_gather_offset == b->min_gather_offset &&
+           a->max_gather_offset == b->max_gather_offset &&
+           a->align_ubo_offset == b->align_ubo_offset &&
+           a->max_constants == b->max_constants &&
+           a->max_shmem_size == b->max_shmem_size &&
+           a->max_group_threads == b->max_group_threads &&
+           a->align_tex_xfer_stride == b->align_tex_xfer_stride &&
+           a->align_tex_xfer_offset == b->align_tex_xfer_offset;
+}
+
+// Conservatively decides whether two GPUs can share compiled programs. The
+// structs are compared field by field, since their padding is unspecified.
+static bool gpu_identical(const struct pl_gpu *a, const struct pl_gpu *b)
+{
+    if (a->caps != b->caps || a->num_formats != b->num_formats)
+        return false;
+    if (!glsl_identical(&a->glsl, &b->glsl))
+        return false;
+    if (!limits_identical(&a->limits, &b->limits))
+        return false;
+
+    for (int i = 0; i < a->num_formats; i++) {
+        const struct pl_fmt *fa = a->formats[i], *fb = b->formats[i];
+        if (strcmp(fa->name, fb->name) != 0 || fa->caps != fb->caps)
+            return false;
+    }
+
+    return true;
+}
+
+struct pl_render_pool *pl_render_pool_create(struct pl_context *ctx,
+                                    const struct pl_render_pool_params *params)
+{
+    pl_assert(params->num_gpus > 0);
+    struct pl_render_pool *pool = talloc_zero(NULL, struct pl_render_pool);
+    pool->ctx = ctx;
+    pool->params = *params;
+    pool->params.gpus = NULL; // not used past this point
+    pool->num_gpus = params->num_gpus;
+    pool->gpus = talloc_zero_array(pool, struct pool_gpu, pool->num_gpus);
+
+    for (int i = 0; i < pool->num_gpus; i++) {
+        struct pool_gpu *g = &pool->gpus[i];
+        g->gpu = params->gpus[i];
+        g->rr = pl_renderer_create(ctx, g->gpu);
+        if (!g->rr)
+            goto error;
+
+        g->group = i;
+        for (int j = 0; j < i; j++) {
+            if (gpu_identical(g->gpu, pool->gpus[j].gpu)) {
+                g->group = pool->gpus[j].group;
+                break;
+            }
+        }
+
+        PL_DEBUG(pool, "Render pool GPU %d: group %d", i, g->group);
+    }
+
+    return pool;
+
+error:
+    PL_ERR(pool, "Failed creating render pool!");
+    pl_render_pool_destroy(&pool);
+    return NULL;
+}
+
+void pl_render_pool_destroy(struct pl_render_pool **ppool)
+{
+    struct pl_render_pool *pool = *ppool;
+    if (!pool)
+        return;
+
+    for (int i = 0; i < pool->num_gpus; i++)
+        pl_renderer_destroy(&pool->gpus[i].rr);
+
+    TA_FREEP(ppool);
+}
+
+void pl_render_pool_begin(struct pl_render_pool *pool, struct pl_render_job *job)
+{
+    int idx = pool->idx_next;
+
+    if (pool->params.mode == PL_RENDER_POOL_LEAST_LOADED) {
+        for (int n = 1; n < pool->num_gpus; n++) {
+            int i = (pool->idx_next + n) % pool->num_gpus;
+            if (pool->gpus[i].load < pool->gpus[idx].load)
+                idx = i;
+        }
+    }
+
+    pool->idx_next = (idx + 1) % pool->num_gpus;
+    struct pool_gpu *g = &pool->gpus[idx];
+    g->load++;
+
+    *job = (struct pl_render_job) {
+        .index = idx,
+        .gpu = g->gpu,
+        .renderer = g->rr,
+    };
+}
+
+// Propagate newly compiled programs from `src` to all identical GPUs
+static void sync_cache(struct pl_render_pool *pool, struct pool_gpu *src)
+{
+    size_t size = pl_renderer_save(src->rr, NULL);
+    if (size == src->cache_size)
+        return;
+
+    uint8_t *cache = talloc_size(NULL, size);
+    pl_renderer_save(src->rr, cache);
+    src->cache_size = size;
+
+    for (int i = 0; i < pool->num_gpus; i++) {
+        struct pool_gpu *g = &pool->gpus[i];
+        if (g == src || g->group != src->group)
+            continue;
+
+        pl_renderer_load(g->rr, cache, size);
+        g->cache_size = pl_renderer_save(g->rr, NULL);
+    }
+
+    talloc_free(cache);
+}
+
+void pl_render_pool_done(struct pl_render_pool *pool,
+                         const struct pl_render_job *job)
+{
+    pl_assert(job->index >= 0 && job->index < pool->num_gpus);
+    struct pool_gpu *g = &pool->gpus[job->index];
+    pl_assert(g->load > 0);
+    g->load--;
+
+    if (!pool->params.no_cache_sharing)
+        sync_cache(pool, g);
+}
+
+int pl_render_pool_load(const struct pl_render_pool *pool, int index)
+{
+    pl_assert(index >= 0 && index < pool->num_gpus);
+    return pool->gpus[index].load;
+}
@@ -20,6 +20,7 @@
 #include "context.h"
 #include "common.h"
 #include "gpu.h"
+#include "shaders.h"
 
 struct comp {
     int order; // e.g. 0, 1, 2, 3 for RGBA
@@ -74,6 +75,20 @@ const struct pl_fmt *pl_plane_find_fmt(const struct pl_gpu *gpu, int out_map[4],
     int dummy[4] = {0};
     out_map = PL_DEF(out_map, dummy);
 
+    const struct pl_fmt *ret;
+    const int key[] = {
+        data->type, data->pixel_stride,
+        data->component_size[0], data->component_size[1],
+        data->component_size[2], data->component_size[3],
+        data->component_pad[0], data->component_pad[1],
+        data->component_pad[2], data->component_pad[3],
+        data->component_map[0], data->component_map[1],
+        data->component_map[2], data->component_map[3],
+    };
+
+    if (pl_fmt_cache_get(gpu, PL_FMT_CACHE_PLANE, key, sizeof(key), &ret, out_map))
+        return ret;
+
     // Count the number of components and initialize out_map
     int num = 0;
     for (int i = 0; i < PL_ARRAY_SIZE(data->component_size); i++) {
@@ -108,16 +123,160 @@ const struct pl_fmt *pl_plane_find_fmt(const struct pl_gpu *gpu, int out_map[4],
             out_map[idx++] = data->component_map[i];
         }
 
-        return fmt;
+        ret = fmt;
+        goto done;
 
 next_fmt: ; // acts as `continue`
     }
 
+    ret = NULL;
+
+done:
+    pl_fmt_cache_put(gpu, PL_FMT_CACHE_PLANE, key, sizeof(key), ret, out_map);
+    return ret;
+}
+
+static void fill_plane(struct pl_plane *out_plane, const struct pl_tex *tex,
+                       const int out_map[4])
+{
+    if (!out_plane)
+        return;
+
+    *out_plane = (struct pl_plane) { .texture = tex };
+    for (int i = 0; i < 4; i++) {
+        out_plane->component_mapping[i] = out_map[i];
+        if (out_map[i] >= 0)
+            out_plane->components = i+1;
+    }
+}
+
+// Describes the conversion of host memory plane data with no directly
+// matching texture format into one with byte-aligned components
+struct repack {
+    int num;            // number of components, or 0 if no repacking is needed
+    size_t out_stride;  // size of a repacked pixel in bytes
+    int shift[4];       // offset of each component in bits (memory order)
+    int size[4];        // size of each component in bits
+    int bytes[4];       // size of each repacked component in bytes
+
+    // If all components are already byte-aligned, the source byte to copy
+    // for each output byte, or -1 to fill with zero
+    bool bytewise;
+    int src_byte[8];
+};
+
+// Picks a texture format for the plane after expanding every component to 8
+// or 16 bits and dropping all padding, allowing trailing padding (e.g. for
+// rgb24 to rgbx). Only implemented for normalized data of up to 8 bytes/pixel.
+static const struct pl_fmt *find_repack_fmt(const struct pl_gpu *gpu,
+                                            int out_map[4], struct repack *rp,
+                                            const struct pl_plane_data *data)
+{
+    if (!data->pixels || data->type != PL_FMT_UNORM || data->pixel_stride > 8)
+        return NULL;
+
+    struct pl_plane_data rd = *data;
+    int offset = 0, bytes = 0, num = 0;
+    for (int i = 0; i < PL_ARRAY_SIZE(data->component_size); i++) {
+        int size = data->component_size[i];
+        if (!size)
+            break;
+        if (size > 16)
+            return NULL;
+
+        rp->shift[i] = offset + data->component_pad[i];
+        rp->size[i] = size;
+        rp->bytes[i] = size > 8 ? 2 : 1;
+        rd.component_size[i] = rp->bytes[i] * 8;
+        rd.component_pad[i] = 0;
+        offset = rp->shift[i] + size;
+        bytes += rp->bytes[i];
+        num = i+1;
+    }
+
+    if (!num || offset > data->pixel_stride * 8)
+        return NULL;
+
+    rp->bytewise = true;
+    for (int i = 0, b = 0; i < num; i++) {
+        rp->bytewise &= rp->shift[i] % 8 == 0 && rp->size[i] == rp->bytes[i] * 8;
+        for (int n = 0; n < rp->bytes[i]; n++)
+            rp->src_byte[b++] = rp->shift[i] / 8 + n;
+    }
+
+    for (int stride = bytes; stride <= 8; stride++) {
+        rd.pixel_stride = stride;
+        const struct pl_fmt *fmt = pl_plane_find_fmt(gpu, out_map, &rd);
+        if (fmt) {
+            for (int b = bytes; b < stride; b++)
+                rp->src_byte[b] = -1;
+            rp->num = num;
+            rp->out_stride = stride;
+            return fmt;
+        }
+    }
+
     return NULL;
 }
 
-bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
-                     const struct pl_tex **tex, const struct pl_plane_data *data)
+// Writes the repacked plane (with tightly packed rows) to `dst`. Components
+// are left-aligned within their new size, with the low bits filled by bit
+// replication, so normalized values are preserved.
+static void repack_plane(const struct repack *rp,
+                         const struct pl_plane_data *data, uint8_t *dst)
+{
+    const size_t in_stride = data->pixel_stride, out_stride = rp->out_stride;
+    const size_t row_stride = PL_DEF(data->row_stride, in_stride * data->width);
+
+    for (int y = 0; y < data->height; y++) {
+        const uint8_t *src = (const uint8_t *) data->pixels + y * row_stride;
+        uint8_t *out = dst + y * data->width * out_stride;
+
+        if (rp->bytewise) {
+            for (int x = 0; x < data->width; x++) {
+                for (int b = 0; b < out_stride; b++) {
+                    int idx = rp->src_byte[b];
+                    out[b] = idx >= 0 ? src[idx] : 0;
+                }
+                src += in_stride;
+                out += out_stride;
+            }
+            continue;
+        }
+
+        for (int x = 0; x < data->width; x++) {
+            uint64_t px = 0;
+            for (int b = 0; b < in_stride; b++)
+                px |= (uint64_t) src[b] << (8 * b);
+
+            uint8_t *o = out;
+            for (int i = 0; i < rp->num; i++) {
+                const int bits = rp->bytes[i] * 8;
+                uint32_t c = (px >> rp->shift[i]) & ((1u << rp->size[i]) - 1);
+                c <<= bits - rp->size[i];
+                for (int n = rp->size[i]; n < bits; n *= 2)
+                    c |= c >> n;
+                for (int b = 0; b < rp->bytes[i]; b++)
+                    *o++ = c >> (8 * b);
+            }
+
+            while (o < out + out_stride)
+                *o++ = 0;
+            src += in_stride;
+            out += out_stride;
+        }
+    }
+}
+
+// Prepares the texture for a plane upload and fills in `out_plane`. If the
+// plane data has to be repacked on the CPU first, this is described by `rp`.
+// Returns the row stride of the (repacked) plane data in texels, or 0 on
+// failure.
+static unsigned int prepare_plane(const struct pl_gpu *gpu,
+                                  struct pl_plane *out_plane,
+                                  const struct pl_tex **tex,
+                                  const struct pl_plane_data *data,
+                                  struct repack *rp)
 {
     pl_assert(!data->buf ^ !data->pixels); // exactly one
 
@@ -126,18 +285,22 @@ bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
         pl_assert(data->buf_offset == PL_ALIGN(data->buf_offset, data->pixel_stride));
     }
 
+    int out_map[4];
+    *rp = (struct repack) {0};
+    const struct pl_fmt *fmt = pl_plane_find_fmt(gpu, out_map, data);
+    if (!fmt)
+        fmt = find_repack_fmt(gpu, out_map, rp, data);
+
     size_t row_stride = PL_DEF(data->row_stride, data->pixel_stride * data->width);
-    unsigned int stride_texels = row_stride / data->pixel_stride;
-    if (stride_texels * data->pixel_stride != row_stride) {
+    unsigned int stride_texels = rp->num ? data->width : row_stride / data->pixel_stride;
+    if (!rp->num && stride_texels * data->pixel_stride != row_stride) {
         PL_ERR(gpu, "data->row_stride must be a multiple of data->pixel_stride!");
-        return false;
+        return 0;
     }
 
-    int out_map[4];
-    const struct pl_fmt *fmt = pl_plane_find_fmt(gpu, out_map, data);
     if (!fmt) {
         PL_ERR(gpu, "Failed picking any compatible texture format for a plane!");
-        return false;
+        return 0;
 
         // TODO: try soft-converting to a supported format using e.g zimg?
     }
@@ -157,17 +320,24 @@ bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
 
     if (!ok) {
         PL_ERR(gpu, "Failed initializing plane texture!");
-        return false;
+        return 0;
     }
 
-    if (out_plane) {
-        *out_plane = (struct pl_plane) { .texture = *tex };
-        for (int i = 0; i < PL_ARRAY_SIZE(out_map); i++) {
-            out_plane->component_mapping[i] = out_map[i];
-            if (out_map[i] >= 0)
-                out_plane->components = i+1;
-        }
-    }
+    fill_plane(out_plane, *tex, out_map);
+    return stride_texels;
+}
+
+bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                     const struct pl_tex **tex, const struct pl_plane_data *data)
+{
+    // Repacking requires a staging buffer
+    if (data->pixels && !pl_plane_find_fmt(gpu, NULL, data))
+        return pl_upload_planes(gpu, out_plane, tex, data, 1, NULL);
+
+    struct repack rp;
+    unsigned int stride_texels = prepare_plane(gpu, out_plane, tex, data, &rp);
+    if (!stride_texels)
+        return false;
 
     return pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
         .tex        = *tex,
@@ -177,3 +347,534 @@ bool pl_upload_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
         .buf_offset = data->buf_offset,
     });
 }
+
+bool pl_import_plane(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                     const struct pl_tex **tex, const struct pl_plane_data *data,
+                     enum pl_handle_type handle_type,
+                     const struct pl_shared_mem *shared_mem)
+{
+    pl_assert(!data->buf && !data->pixels);
+
+    if (!(gpu->import_caps.tex & handle_type)) {
+        PL_ERR(gpu, "Importing plane textures from handle type 0x%x is not "
+               "supported by this GPU!", (unsigned) handle_type);
+        return false;
+    }
+
+    int out_map[4];
+    const struct pl_fmt *fmt = pl_plane_find_fmt(gpu, out_map, data);
+    if (!fmt || fmt->emulated) {
+        PL_ERR(gpu, "Failed picking any compatible texture format for an "
+               "imported plane!");
+        return false;
+    }
+
+    struct pl_shared_mem mem = *shared_mem;
+    if (handle_type == PL_HANDLE_DMA_BUF)
+        mem.pitch = PL_DEF(mem.pitch, data->row_stride);
+
+    // Imported textures are bound to their memory, so hand the previous one
+    // back to the import cache, from which recycled surfaces are re-used
+    pl_tex_import_put(gpu, tex);
+    *tex = pl_tex_import_get(gpu, &(struct pl_tex_params) {
+        .w = data->width,
+        .h = data->height,
+        .format = fmt,
+        .sampleable = true,
+        .address_mode = PL_TEX_ADDRESS_CLAMP,
+        .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
+        .import_handle = handle_type,
+        .shared_mem = mem,
+    });
+
+    if (!*tex) {
+        PL_ERR(gpu, "Failed importing plane texture!");
+        return false;
+    }
+
+    fill_plane(out_plane, *tex, out_map);
+    return true;
+}
+
+bool pl_upload_planes(const struct pl_gpu *gpu, struct pl_plane out_planes[],
+                      const struct pl_tex *tex[], const struct pl_plane_data data[],
+                      int num_planes, const struct pl_buf **staging)
+{
+    const struct pl_buf *tmp = NULL;
+    staging = PL_DEF(staging, &tmp);
+
+    void *ta = talloc_new(NULL);
+    unsigned int *strides = talloc_array(ta, unsigned int, num_planes);
+    size_t *offsets = talloc_array(ta, size_t, num_planes);
+    size_t *sizes = talloc_array(ta, size_t, num_planes);
+    struct repack *rps = talloc_array(ta, struct repack, num_planes);
+    size_t total_size = 0;
+    bool ok = false;
+
+    // Lay out all of the host-memory planes inside the staging buffer
+    for (int i = 0; i < num_planes; i++) {
+        struct pl_plane *out_plane = out_planes ? &out_planes[i] : NULL;
+        strides[i] = prepare_plane(gpu, out_plane, &tex[i], &data[i], &rps[i]);
+        if (!strides[i])
+            goto error;
+        if (data[i].buf)
+            continue;
+
+        size_t texel = rps[i].num ? rps[i].out_stride : data[i].pixel_stride;
+        size_t align = pl_lcm(4, texel);
+        align = pl_lcm(align, PL_DEF(gpu->limits.align_tex_xfer_offset, 1));
+        offsets[i] = PL_ALIGN(total_size, align);
+        // The final row only needs its texels, not the stride padding, which
+        // the host data is not required to contain
+        sizes[i] = ((data[i].height - 1) * strides[i] + data[i].width) * texel;
+        total_size = offsets[i] + sizes[i];
+    }
+
+    if (total_size) {
+        // Re-use the previous staging buffer if possible. If it's still in
+        // use by the GPU, just replace it - the old one will be released once
+        // the GPU is done with it.
+        const struct pl_buf *buf = *staging;
+        if (buf && (buf->params.size < total_size || pl_buf_poll(gpu, buf, 0)))
+            pl_buf_destroy(gpu, staging);
+
+        bool mapped = gpu->caps & PL_GPU_CAP_MAPPED_BUFFERS;
+        if (!*staging) {
+            *staging = pl_buf_create(gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_TEX_TRANSFER,
+                .size = total_size,
+                .host_writable = true,
+                .host_mapped = mapped,
+                .memory_type = PL_BUF_MEM_HOST,
+            });
+        }
+
+        buf = *staging;
+        if (!buf) {
+            PL_ERR(gpu, "Failed creating staging buffer for plane upload!");
+            goto error;
+        }
+
+        // Gather all planes into the mapped buffer directly if possible, or
+        // else into host memory first, so the buffer gets a single write
+        uint8_t *dst = buf->data ? buf->data : talloc_zero_size(ta, total_size);
+        for (int i = 0; i < num_planes; i++) {
+            if (data[i].buf)
+                continue;
+
+            if (rps[i].num) {
+                repack_plane(&rps[i], &data[i], dst + offsets[i]);
+            } else {
+                memcpy(dst + offsets[i], data[i].pixels, sizes[i]);
+            }
+        }
+
+        if (!buf->data)
+            pl_buf_write(gpu, buf, 0, dst, total_size);
+    }
+
+    // Issue all of the transfers back-to-back, so they can be batched
+    for (int i = 0; i < num_planes; i++) {
+        bool staged = !data[i].buf;
+        ok = pl_tex_upload(gpu, &(struct pl_tex_transfer_params) {
+            .tex        = tex[i],
+            .stride_w   = strides[i],
+            .buf        = staged ? *staging : data[i].buf,
+            .buf_offset = staged ? offsets[i] : data[i].buf_offset,
+        });
+
+        if (!ok)
+            goto error;
+    }
+
+    ok = true;
+    // fall through
+
+error:
+    pl_buf_destroy(gpu, &tmp);
+    talloc_free(ta);
+    return ok;
+}
+
+static const struct packed_layout {
+    int unit_px;    // pixels per unit (one shader invocation)
+    int unit_size;  // size of a unit in bytes
+    int depth;      // component depth in bits
+    bool ycbcr;     // unpacks to separate luma and 4:2:2 chroma planes
+    bool words;     // units are made of whole (aligned) 32-bit words
+} packed_layouts[] = {
+    [PL_PACKED_RGB24]       = { 1,  3,  8 },
+    [PL_PACKED_BGR24]       = { 1,  3,  8 },
+    [PL_PACKED_XRGB2101010] = { 1,  4, 10, false, true },
+    [PL_PACKED_Y210]        = { 2,  8, 10, true,  true },
+    [PL_PACKED_V210]        = { 6, 16, 10, true,  true },
+};
+
+static const struct pl_fmt *find_packed_fmt(const struct pl_gpu *gpu,
+                                            int comps, int depth)
+{
+    enum pl_fmt_caps caps = PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_STORABLE;
+    for (int c = comps; c <= 4; c++) {
+        const struct pl_fmt *fmt;
+        fmt = pl_find_fmt(gpu, PL_FMT_UNORM, c, depth, 0, caps | PL_FMT_CAP_LINEAR);
+        fmt = PL_DEF(fmt, pl_find_fmt(gpu, PL_FMT_UNORM, c, depth, 0, caps));
+        if (fmt)
+            return fmt;
+    }
+
+    return NULL;
+}
+
+static bool recreate_packed_tex(const struct pl_gpu *gpu,
+                                const struct pl_tex **tex,
+                                const struct pl_fmt *fmt, int w, int h)
+{
+    bool ok = pl_tex_recreate(gpu, tex, &(struct pl_tex_params) {
+        .w = w,
+        .h = h,
+        .format = fmt,
+        .sampleable = true,
+        .storable = true,
+        .blit_src = !!(fmt->caps & PL_FMT_CAP_BLITTABLE),
+        .address_mode = PL_TEX_ADDRESS_CLAMP,
+        .sample_mode = (fmt->caps & PL_FMT_CAP_LINEAR)
+                            ? PL_TEX_SAMPLE_LINEAR
+                            : PL_TEX_SAMPLE_NEAREST,
+    });
+
+    if (!ok)
+        PL_ERR(gpu, "Failed initializing unpacked plane texture!");
+    return ok;
+}
+
+int pl_upload_packed(const struct pl_gpu *gpu, struct pl_dispatch *dp,
+                     struct pl_plane out_planes[2], const struct pl_tex *tex[2],
+                     const struct pl_packed_data *data,
+                     const struct pl_buf **staging)
+{
+    const int threads = 64;
+    pl_assert(data->layout > 0 && data->layout < PL_ARRAY_SIZE(packed_layouts));
+    pl_assert(!data->pixels != !data->buf);
+    const struct packed_layout *layout = &packed_layouts[data->layout];
+    const int w = data->width, h = data->height;
+    const int units = (w + layout->unit_px - 1) / layout->unit_px;
+    const int chroma_w = (w + 1) / 2;
+
+    size_t stride = data->row_stride;
+    if (!stride) {
+        stride = units * layout->unit_size;
+        if (data->layout == PL_PACKED_V210)
+            stride = PL_ALIGN2(stride, 128);
+    }
+
+    if (layout->words && (stride % 4 || data->buf_offset % 4)) {
+        PL_ERR(gpu, "Row stride and offset of packed data must be multiples "
+               "of 4 for this layout!");
+        return 0;
+    }
+
+    // Pick the output formats and (re)create the output planes
+    const struct pl_fmt *fmt, *chroma_fmt = NULL;
+    fmt = find_packed_fmt(gpu, layout->ycbcr ? 1 : 3, layout->depth);
+    if (layout->ycbcr)
+        chroma_fmt = find_packed_fmt(gpu, 2, layout->depth);
+    if (!fmt || (layout->ycbcr && !chroma_fmt)) {
+        PL_ERR(gpu, "Failed picking storable texture formats for unpacking!");
+        return 0;
+    }
+
+    if (!recreate_packed_tex(gpu, &tex[0], fmt, w, h))
+        return 0;
+    if (layout->ycbcr && !recreate_packed_tex(gpu, &tex[1], chroma_fmt, chroma_w, h))
+        return 0;
+
+    if (out_planes) {
+        static const int rgb_map[4] = { PL_CHANNEL_R, PL_CHANNEL_G, PL_CHANNEL_B, -1 };
+        static const int luma_map[4] = { PL_CHANNEL_Y, -1, -1, -1 };
+        static const int chroma_map[4] = { PL_CHANNEL_CB, PL_CHANNEL_CR, -1, -1 };
+        fill_plane(&out_planes[0], tex[0], layout->ycbcr ? luma_map : rgb_map);
+        if (layout->ycbcr)
+            fill_plane(&out_planes[1], tex[1], chroma_map);
+    }
+
+    // Get the raw data into a storage buffer
+    const struct pl_buf *tmp = NULL, *buf = data->buf;
+    size_t offset = data->buf_offset;
+    size_t size = stride * (h - 1) + units * layout->unit_size;
+    if (!buf) {
+        // Also replace staging buffers left over from e.g. pl_upload_planes,
+        // which can't be bound as storage buffers
+        staging = PL_DEF(staging, &tmp);
+        if (*staging && ((*staging)->params.type != PL_BUF_STORAGE ||
+                         !(*staging)->params.host_writable ||
+                         (*staging)->params.size < PL_ALIGN2(size, 4) ||
+                         pl_buf_poll(gpu, *staging, 0)))
+        {
+            pl_buf_destroy(gpu, staging);
+        }
+
+        if (!*staging && PL_ALIGN2(size, 4) <= gpu->limits.max_ssbo_size) {
+            *staging = pl_buf_create(gpu, &(struct pl_buf_params) {
+                .type = PL_BUF_STORAGE,
+                .size = PL_ALIGN2(size, 4),
+                .host_writable = true,
+            });
+        }
+
+        if (!*staging) {
+            PL_ERR(gpu, "Failed creating staging buffer for packed upload!");
+            goto error;
+        }
+
+        buf = *staging;
+        offset = 0;
+        pl_buf_write(gpu, buf, 0, data->pixels, size);
+    }
+
+    if (buf->params.type != PL_BUF_STORAGE) {
+        PL_ERR(gpu, "Packed data must be provided in a PL_BUF_STORAGE buffer!");
+        goto error;
+    }
+
+    // The shader reads whole words, so the last (partial) word containing
+    // any of the data must still lie within the buffer
+    if (offset > buf->params.size ||
+        PL_ALIGN2(offset + size, 4) > buf->params.size)
+    {
+        PL_ERR(gpu, "Packed data (%zu bytes at offset %zu) exceeds the size "
+               "of the buffer (%zu bytes)!", size, offset, buf->params.size);
+        goto error;
+    }
+
+    struct pl_shader *sh = pl_dispatch_begin(dp);
+    if (!sh_try_compute(sh, threads, 1, true, 0) || sh_glsl(sh).version < 130) {
+        PL_ERR(gpu, "Unpacking packed data requires compute shaders!");
+        pl_dispatch_abort(dp, &sh);
+        goto error;
+    }
+
+    struct pl_shader_desc desc = {
+        .desc = {
+            .name   = "PackedData",
+            .type   = PL_DESC_BUF_STORAGE,
+            .access = PL_DESC_ACCESS_READONLY,
+        },
+        .object = buf,
+    };
+
+    struct pl_var words = pl_var_uint(sh_fresh(sh, "words"));
+    words.dim_a = buf->params.size / sizeof(uint32_t);
+    if (!sh_buf_desc_append(sh->tmp, gpu, &desc, NULL, words)) {
+        PL_ERR(gpu, "Packed data exceeds device limits!");
+        pl_dispatch_abort(dp, &sh);
+        goto error;
+    }
+
+    sh_desc(sh, desc);
+    ident_t img = sh_desc(sh, (struct pl_shader_desc) {
+        .desc = {
+            .name   = "unpacked",
+            .type   = PL_DESC_STORAGE_IMG,
+            .access = PL_DESC_ACCESS_WRITEONLY,
+        },
+        .object = tex[0],
+    });
+
+    ident_t chroma = NULL;
+    if (layout->ycbcr) {
+        chroma = sh_desc(sh, (struct pl_shader_desc) {
+            .desc = {
+                .name   = "unpacked_chroma",
+                .type   = PL_DESC_STORAGE_IMG,
+                .access = PL_DESC_ACCESS_WRITEONLY,
+            },
+            .object = tex[1],
+        });
+    }
+
+    GLSL("ivec2 pos = ivec2(gl_GlobalInvocationID);                 \n"
+         "if (pos.x < %d) {                                         \n"
+         "uint base = uint(%zu) + uint(pos.y) * uint(%zu)           \n"
+         "          + uint(pos.x) * %du;                            \n",
+         units, offset, stride, layout->unit_size);
+
+    switch (data->layout) {
+    case PL_PACKED_RGB24:
+    case PL_PACKED_BGR24:
+        GLSL("uvec3 b;                                              \n"
+             "for (int i = 0; i < 3; i++) {                         \n"
+             "    uint o = base + uint(i);                          \n"
+             "    b[i] = (%s[o >> 2] >> ((o & 3u) * 8u)) & 0xFFu;   \n"
+             "}                                                     \n"
+             "vec3 rgb = vec3(b) * vec3(1.0 / 255.0);               \n"
+             "imageStore(%s, pos, vec4(rgb%s, 1.0));                \n",
+             words.name, img,
+             data->layout == PL_PACKED_BGR24 ? ".bgr" : "");
+        break;
+
+    case PL_PACKED_XRGB2101010:
+        GLSL("uvec3 c = uvec3(%s[base >> 2]) >> uvec3(20u, 10u, 0u);\n"
+             "vec3 rgb = vec3(c & uvec3(0x3FFu)) * vec3(1.0 / 1023.0); \n"
+             "imageStore(%s, pos, vec4(rgb, 1.0));                  \n",
+             words.name, img);
+        break;
+
+    case PL_PACKED_Y210:
+        GLSL("uint w0 = %s[base >> 2], w1 = %s[(base >> 2) + 1u];  \n"
+             "uvec4 c = (uvec4(w0, w1, w0, w1) >> uvec4(6u, 6u, 22u, 22u)) \n"
+             "        & uvec4(0x3FFu);                              \n"
+             "vec4 v = vec4(c) * vec4(1.0 / 1023.0);                \n"
+             "imageStore(%s, ivec2(2 * pos.x, pos.y), vec4(v.x));   \n"
+             "if (2 * pos.x + 1 < %d)                               \n"
+             "    imageStore(%s, ivec2(2 * pos.x + 1, pos.y), vec4(v.y)); \n"
+             "imageStore(%s, pos, vec4(v.zw, 0.0, 0.0));            \n",
+             words.name, words.name, img, w, img, chroma);
+        break;
+
+    case PL_PACKED_V210: {
+        // Each 32-bit word holds three 10-bit components, in this order
+        static const int luma[6][2] = {
+            {0, 10}, {1, 0}, {1, 20}, {2, 10}, {3, 0}, {3, 20},
+        };
+        static const int cb[3][2] = { {0, 0},  {1, 10}, {2, 20} };
+        static const int cr[3][2] = { {0, 20}, {2, 0},  {3, 10} };
+
+        GLSL("uint w[4];                                            \n"
+             "for (int i = 0; i < 4; i++)                           \n"
+             "    w[i] = %s[(base >> 2) + uint(i)];                 \n"
+             "const float scale = 1.0 / 1023.0;                     \n",
+             words.name);
+
+        for (int i = 0; i < 6; i++) {
+            GLSL("if (6 * pos.x + %d < %d) {                        \n"
+                 "    float y = float((w[%d] >> %du) & 0x3FFu);     \n"
+                 "    imageStore(%s, ivec2(6 * pos.x + %d, pos.y),  \n"
+                 "               vec4(y * scale));                  \n"
+                 "}                                                 \n",
+                 i, w, luma[i][0], luma[i][1], img, i);
+        }
+
+        for (int i = 0; i < 3; i++) {
+            GLSL("if (3 * pos.x + %d < %d) {                        \n"
+                 "    vec2 c = vec2((w[%d] >> %du) & 0x3FFu,        \n"
+                 "                  (w[%d] >> %du) & 0x3FFu);       \n"
+                 "    imageStore(%s, ivec2(3 * pos.x + %d, pos.y),  \n"
+                 "               vec4(c * scale, 0.0, 0.0));        \n"
+                 "}                                                 \n",
+                 i, chroma_w, cb[i][0], cb[i][1], cr[i][0], cr[i][1],
+                 chroma, i);
+        }
+        break;
+    }
+
+    default: abort();
+    }
+
+    GLSL("}\n");
+
+    bool ok = pl_dispatch_compute(dp, &(struct pl_dispatch_compute_params) {
+        .shader = &sh,
+        .dispatch_size = { (units + threads - 1) / threads, h, 1 },
+        .width  = units,
+        .height = h,
+    });
+
+    pl_buf_destroy(gpu, &tmp);
+    return ok ? 1 + layout->ycbcr : 0;
+
+error:
+    pl_buf_destroy(gpu, &tmp);
+    return 0;
+}
+
+// Padding between atlas entries, to prevent bleeding when filtering
+#define ATLAS_PAD 1
+#define ATLAS_MIN_SIZE 64
+
+bool pl_upload_overlay_atlas(const struct pl_gpu *gpu, struct pl_plane *out_plane,
+                             const struct pl_tex **tex,
+                             struct pl_overlay_part out_parts[],
+                             const struct pl_overlay_bitmap bitmaps[], int num)
+{
+    void *tmp = talloc_new(NULL);
+    int max_dim = gpu->limits.max_tex_2d_dim;
+    bool ok = false;
+
+    int max_w = 1;
+    size_t area = 0;
+    for (int i = 0; i < num; i++) {
+        int w = bitmaps[i].w + ATLAS_PAD, h = bitmaps[i].h + ATLAS_PAD;
+        max_w = PL_MAX(max_w, w);
+        area += (size_t) w * h;
+    }
+
+    // Aim for a roughly square atlas
+    int width = ATLAS_MIN_SIZE;
+    while (width < max_dim && (width < max_w || (size_t) width * width < area))
+        width *= 2;
+    width = PL_MIN(width, max_dim);
+    if (max_w > width) {
+        PL_ERR(gpu, "Overlay bitmap of width %d exceeds the maximum texture "
+               "size!", max_w);
+        goto error;
+    }
+
+    // Simple shelf packing, in the order given
+    int *xs = talloc_array(tmp, int, num), *ys = talloc_array(tmp, int, num);
+    int x = 0, y = 0, shelf_h = 0;
+    for (int i = 0; i < num; i++) {
+        int w = bitmaps[i].w + ATLAS_PAD, h = bitmaps[i].h + ATLAS_PAD;
+        if (x + w > width) {
+            x = 0;
+            y += shelf_h;
+            shelf_h = 0;
+        }
+
+        xs[i] = x;
+        ys[i] = y;
+        x += w;
+        shelf_h = PL_MAX(shelf_h, h);
+    }
+
+    int height = ATLAS_MIN_SIZE;
+    while (height < y + shelf_h)
+        height *= 2;
+    if (height > max_dim) {
+        PL_ERR(gpu, "Overlay bitmaps don't fit into a %dx%d atlas!",
+               max_dim, max_dim);
+        goto error;
+    }
+
+    uint8_t *pixels = talloc_zero_size(tmp, (size_t) width * height);
+    for (int i = 0; i < num; i++) {
+        const struct pl_overlay_bitmap *bmp = &bitmaps[i];
+        for (int row = 0; row < bmp->h; row++) {
+            memcpy(&pixels[(size_t) (ys[i] + row) * width + xs[i]],
+                   &bmp->data[row * bmp->stride], bmp->w);
+        }
+
+        out_parts[i] = (struct pl_overlay_part) {
+            .src = { xs[i], ys[i], xs[i] + bmp->w, ys[i] + bmp->h },
+            .dst = bmp->dst,
+        };
+        memcpy(out_parts[i].color, bmp->color, sizeof(bmp->color));
+    }
+
+    ok = pl_upload_plane(gpu, out_plane, tex, &(struct pl_plane_data) {
+        .type           = PL_FMT_UNORM,
+        .width          = width,
+        .height         = height,
+        .component_size = { 8 },
+        .component_map  = { 0 },
+        .pixel_stride   = 1,
+        .row_stride     = width,
+        .pixels         = pixels,
+    });
+
+    // fall through
+error:
+    talloc_free(tmp);
+    return ok;
+}
@@ -18,11 +18,97 @@
 #include "command.h"
 #include "utils.h"
 
+struct vk_signal {
+    VkSemaphore semaphore;
+    VkEvent event;
+    enum vk_wait_type type; // last signal type
+    VkQueue source;         // last signal source
+    // For timeline semaphores: the point on the source queue's timeline
+    // corresponding to this signal. While the source command is still being
+    // recorded, `cmd` is set instead and `value` is not yet known.
+    VkSemaphore timeline;
+    uint64_t value;
+    struct vk_cmd *cmd;
+};
+
 // returns VK_SUCCESS (completed), VK_TIMEOUT (not yet completed) or an error
 static VkResult vk_cmd_poll(struct vk_ctx *vk, struct vk_cmd *cmd,
                             uint64_t timeout)
 {
-    return vk->WaitForFences(vk->dev, 1, &cmd->fence, false, timeout);
+    if (!cmd->timeline)
+        return vk->WaitForFences(vk->dev, 1, &cmd->done_fence, false, timeout);
+
+    // Not yet queued, so there is nothing to wait for
+    if (!cmd->value)
+        return VK_SUCCESS;
+
+    if (!timeout) {
+        uint64_t value;
+        VkResult res = vk->GetSemaphoreCounterValueKHR(vk->dev, cmd->timeline,
+                                                        &value);
+        if (res != VK_SUCCESS)
+            return res;
+        return value >= cmd->value ? VK_SUCCESS : VK_TIMEOUT;
+    }
+
+    VkSemaphoreWaitInfoKHR winfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+        .semaphoreCount = 1,
+        .pSemaphores = &cmd->timeline,
+        .pValues = &cmd->value,
+    };
+
+    return vk->WaitSemaphoresKHR(vk->dev, &winfo, timeout);
+}
+
+static void vk_cmd_recycle(struct vk_ctx *vk, struct vk_cmd *cmd)
+{
+    if (vk->fence_waiters && cmd->fence) {
+        TARRAY_APPEND(vk->ta, vk->cmds_retired, vk->num_cmds_retired, cmd);
+        return;
+    }
+
+    struct vk_cmdthread *thread = cmd->thread;
+    TARRAY_APPEND(thread, thread->cmds, thread->num_cmds, cmd);
+}
+
+// Like `vk_cmd_poll`, but releases `vk->lock` while blocking
+static VkResult vk_cmd_poll_unlocked(struct vk_ctx *vk, struct vk_cmd *cmd,
+                                     uint64_t timeout)
+{
+    // Copy everything needed for the wait, since `cmd` may get recycled by
+    // another thread in the meantime
+    VkSemaphore timeline = cmd->timeline;
+    uint64_t value = cmd->value;
+    VkFence fence = cmd->done_fence;
+    if (timeline && !value)
+        return VK_SUCCESS;
+
+    if (!timeline)
+        vk->fence_waiters++;
+
+    VkResult res;
+    bool unlocked = vk_unlock_outermost(vk);
+    if (timeline) {
+        res = vk->WaitSemaphoresKHR(vk->dev, &(VkSemaphoreWaitInfoKHR) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+            .semaphoreCount = 1,
+            .pSemaphores = &timeline,
+            .pValues = &value,
+        }, timeout);
+    } else {
+        res = vk->WaitForFences(vk->dev, 1, &fence, false, timeout);
+    }
+    if (unlocked)
+        vk_lock(vk);
+
+    if (!timeline && --vk->fence_waiters == 0) {
+        struct vk_cmd *retired;
+        while (TARRAY_POP(vk->cmds_retired, vk->num_cmds_retired, &retired))
+            vk_cmd_recycle(vk, retired);
+    }
+
+    return res;
 }
 
 static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
@@ -32,10 +118,17 @@ static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
         cb->run(cb->priv, cb->arg);
     }
 
+    // Signals from commands that never got queued will never fire
+    for (int i = 0; i < cmd->num_tsigs; i++)
+        cmd->tsigs[i]->cmd = NULL;
+
     cmd->num_callbacks = 0;
     cmd->num_deps = 0;
     cmd->num_sigs = 0;
+    cmd->num_tsigs = 0;
     cmd->num_objs = 0;
+    cmd->value = 0;
+    cmd->done_fence = cmd->fence;
 
     // also make sure to reset vk->last_cmd in case this was the last command
     if (vk->last_cmd == cmd)
@@ -50,25 +143,31 @@ static void vk_cmd_destroy(struct vk_ctx *vk, struct vk_cmd *cmd)
     vk_cmd_poll(vk, cmd, UINT64_MAX);
     vk_cmd_reset(vk, cmd);
     vk->DestroyFence(vk->dev, cmd->fence, VK_ALLOC);
-    vk->FreeCommandBuffers(vk->dev, cmd->pool->pool, 1, &cmd->buf);
+    vk->FreeCommandBuffers(vk->dev, cmd->thread->pool, 1, &cmd->buf);
 
     talloc_free(cmd);
 }
 
-static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool)
+static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool,
+                                    struct vk_cmdthread *thread)
 {
     struct vk_cmd *cmd = talloc_zero(NULL, struct vk_cmd);
     cmd->pool = pool;
+    cmd->thread = thread;
 
     VkCommandBufferAllocateInfo ainfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = pool->pool,
+        .commandPool = thread->pool,
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1,
     };
 
     VK(vk->AllocateCommandBuffers(vk->dev, &ainfo, &cmd->buf));
 
+    // Completion is tracked using the queue's timeline semaphore instead
+    if (pool->timelines)
+        return cmd;
+
     VkFenceCreateInfo finfo = {
         .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
         .flags = VK_FENCE_CREATE_SIGNALED_BIT,
@@ -76,6 +175,7 @@ static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool)
 
     VK(vk->CreateFence(vk->dev, &finfo, VK_ALLOC, &cmd->fence));
     VK_NAME(FENCE, cmd->fence, "cmd");
+    cmd->done_fence = cmd->fence;
 
     return cmd;
 
@@ -106,31 +206,60 @@ void vk_cmd_callback(struct vk_cmd *cmd, vk_cb callback,
     });
 }
 
-void vk_cmd_dep(struct vk_cmd *cmd, VkSemaphore dep, VkPipelineStageFlags stage)
+static void cmd_dep_value(struct vk_cmd *cmd, VkSemaphore dep,
+                          VkPipelineStageFlags stage, uint64_t value)
 {
     int idx = cmd->num_deps++;
     TARRAY_GROW(cmd, cmd->deps, idx);
     TARRAY_GROW(cmd, cmd->depstages, idx);
+    TARRAY_GROW(cmd, cmd->depvalues, idx);
     cmd->deps[idx] = dep;
     cmd->depstages[idx] = stage;
+    cmd->depvalues[idx] = value;
+}
+
+void vk_cmd_dep(struct vk_cmd *cmd, VkSemaphore dep, VkPipelineStageFlags stage)
+{
+    cmd_dep_value(cmd, dep, stage, 0);
+}
+
+// Waits for a point on a timeline semaphore. Since timeline values are
+// monotonic, multiple waits on the same timeline collapse into one.
+static void cmd_dep_timeline(struct vk_cmd *cmd, VkSemaphore timeline,
+                             VkPipelineStageFlags stage, uint64_t value)
+{
+    for (int i = 0; i < cmd->num_deps; i++) {
+        if (cmd->deps[i] == timeline) {
+            cmd->depstages[i] |= stage;
+            cmd->depvalues[i] = PL_MAX(cmd->depvalues[i], value);
+            return;
+        }
+    }
+
+    cmd_dep_value(cmd, timeline, stage, value);
 }
 
-void vk_cmd_obj(struct vk_cmd *cmd, const void *obj)
+void vk_cmd_obj(struct vk_cmd *cmd, struct vk_obj *obj)
 {
+    if (cmd->num_objs && cmd->objs[cmd->num_objs - 1] == obj)
+        return;
+
     TARRAY_APPEND(cmd, cmd->objs, cmd->num_objs, obj);
 }
 
-void vk_cmd_sig(struct vk_cmd *cmd, VkSemaphore sig)
+static void cmd_sig_value(struct vk_cmd *cmd, VkSemaphore sig, uint64_t value)
 {
-    TARRAY_APPEND(cmd, cmd->sigs, cmd->num_sigs, sig);
+    int idx = cmd->num_sigs++;
+    TARRAY_GROW(cmd, cmd->sigs, idx);
+    TARRAY_GROW(cmd, cmd->sigvalues, idx);
+    cmd->sigs[idx] = sig;
+    cmd->sigvalues[idx] = value;
 }
 
-struct vk_signal {
-    VkSemaphore semaphore;
-    VkEvent event;
-    enum vk_wait_type type; // last signal type
-    VkQueue source;         // last signal source
-};
+void vk_cmd_sig(struct vk_cmd *cmd, VkSemaphore sig)
+{
+    cmd_sig_value(cmd, sig, 0);
+}
 
 struct vk_signal *vk_cmd_signal(struct vk_ctx *vk, struct vk_cmd *cmd,
                                 VkPipelineStageFlags stage)
@@ -145,8 +274,9 @@ struct vk_signal *vk_cmd_signal(struct vk_ctx *vk, struct vk_cmd *cmd,
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     };
 
-    // We can skip creating the semaphores if there's only one queue
-    if (vk->num_pools > 1 || vk->pools[0]->num_queues > 1) {
+    // We can skip creating the semaphores if there's only one queue, or if
+    // we can use the queues' timeline semaphores instead
+    if (!cmd->timeline && (vk->num_pools > 1 || vk->pools[0]->num_queues > 1)) {
         VK(vk->CreateSemaphore(vk->dev, &sinfo, VK_ALLOC, &sig->semaphore));
         VK_NAME(SEMAPHORE, sig->semaphore, "sig");
     }
@@ -174,7 +304,11 @@ done:
     // end up using one or the other)
     sig->type = VK_WAIT_NONE;
     sig->source = cmd->queue;
-    if (sig->semaphore)
+    sig->timeline = cmd->timeline;
+    sig->value = 0;
+    sig->cmd = cmd; // until the command is queued
+    TARRAY_APPEND(cmd, cmd->tsigs, cmd->num_tsigs, sig);
+    if (!cmd->timeline && sig->semaphore)
         vk_cmd_sig(cmd, sig->semaphore);
 
     VkQueueFlags req = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
@@ -198,7 +332,9 @@ static bool unsignal_cmd(struct vk_cmd *cmd, VkSemaphore sem)
 
     for (int n = 0; n < cmd->num_sigs; n++) {
         if (cmd->sigs[n] == sem) {
+            int num_sigs = cmd->num_sigs;
             TARRAY_REMOVE_AT(cmd->sigs, cmd->num_sigs, n);
+            TARRAY_REMOVE_AT(cmd->sigvalues, num_sigs, n);
             return true;
         }
     }
@@ -242,6 +378,9 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
     if (!sig)
         return VK_WAIT_NONE;
 
+    // Commands still being recorded (by other threads) can't be waited on
+    pl_assert(!sig->cmd || sig->cmd == cmd);
+
     if (sig->source == cmd->queue && unsignal(vk, cmd, sig->semaphore)) {
         // If we can remove the semaphore signal operation from the history and
         // pretend it never happened, then we get to use the more efficient
@@ -252,6 +391,12 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
         } else {
             sig->type = VK_WAIT_BARRIER;
         }
+    } else if (sig->timeline) {
+        // Wait for the source queue's timeline to reach the signal. The
+        // source command must have been queued by now, since only one
+        // command is ever being recorded for a different queue at a time.
+        cmd_dep_timeline(cmd, sig->timeline, stage, sig->value);
+        sig->type = VK_WAIT_NONE;
     } else {
         // Otherwise, we use the semaphore. (This also unsignals it as a result
         // of the command execution)
@@ -266,11 +411,24 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
     return sig->type;
 }
 
+struct vk_cmd *vk_signal_cmd(const struct vk_signal *sig)
+{
+    return sig ? sig->cmd : NULL;
+}
+
 void vk_signal_destroy(struct vk_ctx *vk, struct vk_signal **sig)
 {
     if (!*sig)
         return;
 
+    struct vk_cmd *cmd = (*sig)->cmd;
+    for (int i = 0; cmd && i < cmd->num_tsigs; i++) {
+        if (cmd->tsigs[i] == *sig) {
+            TARRAY_REMOVE_AT(cmd->tsigs, cmd->num_tsigs, i);
+            break;
+        }
+    }
+
     vk->DestroySemaphore(vk->dev, (*sig)->semaphore, VK_ALLOC);
     vk->DestroyEvent(vk->dev, (*sig)->event, VK_ALLOC);
     talloc_free(*sig);
@@ -278,7 +436,7 @@ void vk_signal_destroy(struct vk_ctx *vk, struct vk_signal **sig)
 }
 
 struct vk_cmdpool *vk_cmdpool_create(struct vk_ctx *vk,
-                                     VkDeviceQueueCreateInfo qinfo,
+                                     VkDeviceQueueCreateInfo qinfo, int first,
                                      VkQueueFamilyProperties props)
 {
     struct vk_cmdpool *pool = talloc_ptrtype(NULL, pool);
@@ -290,16 +448,31 @@ struct vk_cmdpool *vk_cmdpool_create(struct vk_ctx *vk,
     };
 
     for (int n = 0; n < pool->num_queues; n++)
-        vk->GetDeviceQueue(vk->dev, pool->qf, n, &pool->queues[n]);
+        vk->GetDeviceQueue(vk->dev, pool->qf, first + n, &pool->queues[n]);
 
-    VkCommandPoolCreateInfo cinfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
-                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = pool->qf,
-    };
+    const VkPhysicalDeviceTimelineSemaphoreFeaturesKHR *timeline;
+    timeline = vk_find_struct(&vk->features,
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR);
 
-    VK(vk->CreateCommandPool(vk->dev, &cinfo, VK_ALLOC, &pool->pool));
+    if (timeline && timeline->timelineSemaphore && vk->WaitSemaphoresKHR) {
+        pool->timelines = talloc_zero_array(pool, VkSemaphore, pool->num_queues);
+        pool->timeline_values = talloc_zero_array(pool, uint64_t, pool->num_queues);
+
+        VkSemaphoreTypeCreateInfoKHR stinfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+        };
+
+        VkSemaphoreCreateInfo sinfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &stinfo,
+        };
+
+        for (int n = 0; n < pool->num_queues; n++) {
+            VK(vk->CreateSemaphore(vk->dev, &sinfo, VK_ALLOC, &pool->timelines[n]));
+            VK_NAME(SEMAPHORE, pool->timelines[n], "timeline");
+        }
+    }
 
     return pool;
 
@@ -314,25 +487,65 @@ void vk_cmdpool_destroy(struct vk_ctx *vk, struct vk_cmdpool *pool)
     if (!pool)
         return;
 
-    for (int i = 0; i < pool->num_cmds; i++)
-        vk_cmd_destroy(vk, pool->cmds[i]);
+    for (int i = 0; i < pool->num_threads; i++) {
+        struct vk_cmdthread *thread = pool->threads[i];
+        for (int n = 0; n < thread->num_cmds; n++)
+            vk_cmd_destroy(vk, thread->cmds[n]);
+        vk->DestroyCommandPool(vk->dev, thread->pool, VK_ALLOC);
+    }
+
+    for (int n = 0; pool->timelines && n < pool->num_queues; n++)
+        vk->DestroySemaphore(vk->dev, pool->timelines[n], VK_ALLOC);
 
-    vk->DestroyCommandPool(vk->dev, pool->pool, VK_ALLOC);
     talloc_free(pool);
 }
 
+struct vk_cmdthread *vk_cmdpool_thread(struct vk_ctx *vk, struct vk_cmdpool *pool)
+{
+    pthread_t self = pthread_self();
+    for (int i = 0; i < pool->num_threads; i++) {
+        if (pthread_equal(pool->threads[i]->thread, self))
+            return pool->threads[i];
+    }
+
+    struct vk_cmdthread *thread = talloc_zero(pool, struct vk_cmdthread);
+    thread->thread = self;
+
+    VkCommandPoolCreateInfo cinfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = pool->qf,
+    };
+
+    VK(vk->CreateCommandPool(vk->dev, &cinfo, VK_ALLOC, &thread->pool));
+    PL_DEBUG(vk, "Created command pool for QF %d on thread %d", pool->qf,
+             pool->num_threads);
+    TARRAY_APPEND(pool, pool->threads, pool->num_threads, thread);
+    return thread;
+
+error:
+    talloc_free(thread);
+    vk->failed = true;
+    return NULL;
+}
+
 struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool)
 {
+    struct vk_cmdthread *thread = vk_cmdpool_thread(vk, pool);
+    if (!thread)
+        return NULL;
+
     // Garbage collect the cmdpool first, to increase the chances of getting
     // an already-available command buffer.
     vk_poll_commands(vk, 0);
 
     struct vk_cmd *cmd = NULL;
-    if (TARRAY_POP(pool->cmds, pool->num_cmds, &cmd))
+    if (TARRAY_POP(thread->cmds, thread->num_cmds, &cmd))
         goto done;
 
     // No free command buffers => allocate another one
-    cmd = vk_cmd_create(vk, pool);
+    cmd = vk_cmd_create(vk, pool, thread);
     if (!cmd)
         goto error;
 
@@ -346,6 +559,8 @@ done: ;
     VK(vk->BeginCommandBuffer(cmd->buf, &binfo));
 
     cmd->queue = pool->queues[pool->idx_queues];
+    cmd->queue_idx = pool->idx_queues;
+    cmd->timeline = pool->timelines ? pool->timelines[cmd->queue_idx] : NULL;
     return cmd;
 
 error:
@@ -359,11 +574,28 @@ bool vk_cmd_queue(struct vk_ctx *vk, struct vk_cmd **pcmd)
 {
     struct vk_cmd *cmd = *pcmd;
     struct vk_cmdpool *pool = cmd->pool;
+    uint64_t start = pl_trace_begin(vk->ctx);
     *pcmd = NULL;
 
     VK(vk->EndCommandBuffer(cmd->buf));
 
-    VK(vk->ResetFences(vk->dev, 1, &cmd->fence));
+    if (cmd->timeline) {
+        // Commands are submitted in the order they're queued, so this is the
+        // point at which the command's position on the timeline is known
+        cmd->value = ++pool->timeline_values[cmd->queue_idx];
+        cmd_sig_value(cmd, cmd->timeline, cmd->value);
+    }
+
+    for (int i = 0; i < cmd->num_tsigs; i++) {
+        cmd->tsigs[i]->value = cmd->value;
+        cmd->tsigs[i]->cmd = NULL;
+    }
+    cmd->num_tsigs = 0;
+
+    cmd->seq = ++vk->cmd_seq;
+    for (int i = 0; i < cmd->num_objs; i++)
+        cmd->objs[i]->seq = cmd->seq;
+
     TARRAY_APPEND(vk->ta, vk->cmds_queued, vk->num_cmds_queued, cmd);
     vk->last_cmd = cmd;
 
@@ -373,29 +605,45 @@ bool vk_cmd_queue(struct vk_ctx *vk, struct vk_cmd **pcmd)
         vk_flush_commands(vk);
     }
 
+    pl_trace_end(vk->ctx, "vulkan", "cmd_queue", start);
     return true;
 
 error:
     vk_cmd_reset(vk, cmd);
-    TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
+    vk_cmd_recycle(vk, cmd);
     vk->failed = true;
     return false;
 }
 
-bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
+static bool poll_commands(struct vk_ctx *vk, uint64_t timeout, bool unlock)
 {
     bool ret = false;
 
     while (vk->num_cmds_pending > 0) {
         struct vk_cmd *cmd = vk->cmds_pending[0];
-        struct vk_cmdpool *pool = cmd->pool;
-        VkResult res = vk_cmd_poll(vk, cmd, timeout);
+        VkResult res = vk_cmd_poll(vk, cmd, unlock ? 0 : timeout);
+        if (res == VK_TIMEOUT && timeout && unlock) {
+            // Other threads may complete (or submit) commands while we're
+            // waiting, so start over afterwards
+            res = vk_cmd_poll_unlocked(vk, cmd, timeout);
+            ret |= res == VK_SUCCESS;
+            timeout = 0;
+            continue;
+        }
         if (res == VK_TIMEOUT)
             break;
-        PL_TRACE(vk, "VkFence signalled: %p", (void *) cmd->fence);
-        vk_cmd_reset(vk, cmd);
+        if (cmd->timeline) {
+            PL_TRACE(vk, "Timeline %p reached %"PRIu64, (void *) cmd->timeline,
+                     cmd->value);
+        } else {
+            PL_TRACE(vk, "VkFence signalled: %p", (void *) cmd->done_fence);
+        }
+
+        // Remove the command before running its callbacks, in case any of
+        // them polls for commands again
         TARRAY_REMOVE_AT(vk->cmds_pending, vk->num_cmds_pending, 0);
-        TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
+        vk_cmd_reset(vk, cmd);
+        vk_cmd_recycle(vk, cmd);
         ret = true;
 
         // If we've successfully spent some time waiting for at least one
@@ -409,28 +657,74 @@ bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
     return ret;
 }
 
+bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
+{
+    return poll_commands(vk, timeout, false);
+}
+
+bool vk_wait_commands(struct vk_ctx *vk, uint64_t timeout)
+{
+    return poll_commands(vk, timeout, true);
+}
+
 bool vk_flush_commands(struct vk_ctx *vk)
 {
     return vk_flush_obj(vk, NULL);
 }
 
-bool vk_flush_obj(struct vk_ctx *vk, const void *obj)
+static void submit_info(struct vk_ctx *vk, struct vk_cmd *cmd,
+                        VkSubmitInfo *sinfo,
+                        VkTimelineSemaphoreSubmitInfoKHR *tinfo)
 {
-    // Count how many commands we want to flush
+    *tinfo = (VkTimelineSemaphoreSubmitInfoKHR) {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .waitSemaphoreValueCount = cmd->num_deps,
+        .pWaitSemaphoreValues = cmd->depvalues,
+        .signalSemaphoreValueCount = cmd->num_sigs,
+        .pSignalSemaphoreValues = cmd->sigvalues,
+    };
+
+    *sinfo = (VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = cmd->timeline ? tinfo : NULL,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd->buf,
+        .waitSemaphoreCount = cmd->num_deps,
+        .pWaitSemaphores = cmd->deps,
+        .pWaitDstStageMask = cmd->depstages,
+        .signalSemaphoreCount = cmd->num_sigs,
+        .pSignalSemaphores = cmd->sigs,
+    };
+
+    if (pl_msg_test(vk->ctx, PL_LOG_TRACE)) {
+        PL_TRACE(vk, "Submitting command on queue %p (QF %d):",
+                 (void *) cmd->queue, cmd->pool->qf);
+        for (int n = 0; n < cmd->num_objs; n++)
+            PL_TRACE(vk, "    uses object %p", (void *) cmd->objs[n]);
+        for (int n = 0; n < cmd->num_deps; n++) {
+            PL_TRACE(vk, "    waits on semaphore %p = %"PRIu64,
+                     (void *) cmd->deps[n], cmd->depvalues[n]);
+        }
+        for (int n = 0; n < cmd->num_sigs; n++) {
+            PL_TRACE(vk, "    signals semaphore %p = %"PRIu64,
+                     (void *) cmd->sigs[n], cmd->sigvalues[n]);
+        }
+        if (cmd->num_callbacks)
+            PL_TRACE(vk, "    signals %d callbacks", cmd->num_callbacks);
+    }
+}
+
+bool vk_flush_obj(struct vk_ctx *vk, const struct vk_obj *obj)
+{
+    // Count how many commands we want to flush. Since queued commands have
+    // consecutive sequence numbers, this is just the distance from the first
+    // queued command to the last one involving `obj`
     int num_to_flush = vk->num_cmds_queued;
     if (obj) {
         num_to_flush = 0;
-        for (int i = 0; i < vk->num_cmds_queued; i++) {
-            struct vk_cmd *cmd = vk->cmds_queued[i];
-            for (int o = 0; o < cmd->num_objs; o++) {
-                if (cmd->objs[o] == obj) {
-                    num_to_flush = i+1;
-                    goto next_cmd;
-                }
-            }
-
-next_cmd: ;
-        }
+        if (vk->num_cmds_queued && obj->seq >= vk->cmds_queued[0]->seq)
+            num_to_flush = obj->seq - vk->cmds_queued[0]->seq + 1;
+        pl_assert(num_to_flush <= vk->num_cmds_queued);
     }
 
     if (!num_to_flush)
@@ -439,46 +733,63 @@ next_cmd: ;
     PL_TRACE(vk, "Flushing %d/%d queued commands",
              num_to_flush, vk->num_cmds_queued);
 
+    uint64_t start = pl_trace_begin(vk->ctx);
     bool ret = true;
 
-    for (int i = 0; i < num_to_flush; i++) {
-        struct vk_cmd *cmd = vk->cmds_queued[i];
-        struct vk_cmdpool *pool = cmd->pool;
-
-        VkSubmitInfo sinfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &cmd->buf,
-            .waitSemaphoreCount = cmd->num_deps,
-            .pWaitSemaphores = cmd->deps,
-            .pWaitDstStageMask = cmd->depstages,
-            .signalSemaphoreCount = cmd->num_sigs,
-            .pSignalSemaphores = cmd->sigs,
-        };
+    for (int i = 0; i < num_to_flush;) {
+        // Batch up all consecutive commands targeting the same queue into a
+        // single vkQueueSubmit. (Reordering commands across queues is not
+        // allowed, since that may violate binary semaphore ordering)
+        VkQueue queue = vk->cmds_queued[i]->queue;
+        int num = 1;
+        while (i + num < num_to_flush && vk->cmds_queued[i + num]->queue == queue)
+            num++;
+
+        TARRAY_GROW(vk->ta, vk->submit_infos, num - 1);
+        TARRAY_GROW(vk->ta, vk->timeline_infos, num - 1);
+
+        for (int n = 0; n < num; n++) {
+            struct vk_cmd *cmd = vk->cmds_queued[i + n];
+            submit_info(vk, cmd, &vk->submit_infos[n], &vk->timeline_infos[n]);
+        }
+
+        // Only one fence can be signalled per submission, so without timeline
+        // semaphores, all commands in the batch share the last one's fence
+        struct vk_cmd *last = vk->cmds_queued[i + num - 1];
+        for (int n = 0; n < num; n++)
+            vk->cmds_queued[i + n]->done_fence = last->fence;
+
+        VkResult res = VK_SUCCESS;
+        if (last->fence) {
+            PL_TRACE(vk, "    signals fence %p", (void *) last->fence);
+            res = vk->ResetFences(vk->dev, 1, &last->fence);
+        }
+        if (res == VK_SUCCESS)
+            res = vk->QueueSubmit(queue, num, vk->submit_infos, last->fence);
+        if (res == VK_SUCCESS) {
+            vk->frame_submits++;
+            vk->frame_cmds += num;
+            vk->submit_stats.total_submits++;
+            vk->submit_stats.total_cmds += num;
+        }
 
-        if (pl_msg_test(vk->ctx, PL_LOG_TRACE)) {
-            PL_TRACE(vk, "Submitting command on queue %p (QF %d):",
-                     (void *)cmd->queue, pool->qf);
-            for (int n = 0; n < cmd->num_objs; n++)
-                PL_TRACE(vk, "    uses object %p", cmd->objs[n]);
-            for (int n = 0; n < cmd->num_deps; n++)
-                PL_TRACE(vk, "    waits on semaphore %p", (void *) cmd->deps[n]);
-            for (int n = 0; n < cmd->num_sigs; n++)
-                PL_TRACE(vk, "    signals semaphore %p", (void *) cmd->sigs[n]);
-            PL_TRACE(vk, "    signals fence %p", (void *) cmd->fence);
-            if (cmd->num_callbacks)
-                PL_TRACE(vk, "    signals %d callbacks", cmd->num_callbacks);
+        for (int n = 0; n < num; n++) {
+            struct vk_cmd *cmd = vk->cmds_queued[i + n];
+            if (res == VK_SUCCESS) {
+                TARRAY_APPEND(vk->ta, vk->cmds_pending, vk->num_cmds_pending, cmd);
+            } else {
+                vk_cmd_reset(vk, cmd);
+                vk_cmd_recycle(vk, cmd);
+            }
         }
 
-        VK(vk->QueueSubmit(cmd->queue, 1, &sinfo, cmd->fence));
-        TARRAY_APPEND(vk->ta, vk->cmds_pending, vk->num_cmds_pending, cmd);
-        continue;
+        if (res != VK_SUCCESS) {
+            PL_ERR(vk, "vkQueueSubmit: %s", vk_res_str(res));
+            vk->failed = true;
+            ret = false;
+        }
 
-error:
-        vk_cmd_reset(vk, cmd);
-        TARRAY_APPEND(pool, pool->cmds, pool->num_cmds, cmd);
-        vk->failed = true;
-        ret = false;
+        i += num;
     }
 
     // Move remaining commands back to index 0
@@ -492,6 +803,7 @@ error:
     while (vk->num_cmds_pending > PL_VK_MAX_PENDING_CMDS)
         vk_poll_commands(vk, UINT64_MAX);
 
+    pl_trace_end(vk->ctx, "vulkan", "flush_commands", start);
     return ret;
 }
 
@@ -503,10 +815,37 @@ void vk_rotate_queues(struct vk_ctx *vk)
         pool->idx_queues = (pool->idx_queues + 1) % pool->num_queues;
         PL_TRACE(vk, "QF %d: %d/%d", pool->qf, pool->idx_queues, pool->num_queues);
     }
+
+    // This also marks the end of a frame, for the purposes of statistics
+    vk->submit_stats.submits = vk->frame_submits;
+    vk->submit_stats.cmds = vk->frame_cmds;
+    vk->frame_submits = vk->frame_cmds = 0;
 }
 
 void vk_wait_idle(struct vk_ctx *vk)
 {
     vk_flush_commands(vk);
-    while (vk_poll_commands(vk, UINT64_MAX)) ;
+    while (vk_wait_commands(vk, UINT64_MAX)) ;
+}
+
+void vk_lock(struct vk_ctx *vk)
+{
+    pthread_mutex_lock(&vk->lock);
+    vk->lock_depth++;
+}
+
+void vk_unlock(struct vk_ctx *vk)
+{
+    pl_assert(vk->lock_depth > 0);
+    vk->lock_depth--;
+    pthread_mutex_unlock(&vk->lock);
+}
+
+bool vk_unlock_outermost(struct vk_ctx *vk)
+{
+    if (vk->lock_depth != 1)
+        return false;
+
+    vk_unlock(vk);
+    return true;
 }
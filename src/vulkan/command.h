@@ -35,31 +35,55 @@ struct vk_callback {
 void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
                      const void *priv, const void *arg);
 
+// Tracks the last queued command associated with an object, so that
+// `vk_flush_obj` does not need to search through all queued commands. Must be
+// embedded into the object, and outlive all commands it gets associated with.
+struct vk_obj {
+    uint64_t seq; // sequence number of the last queued command, or 0
+};
+
 // Helper wrapper around command buffers that also track dependencies,
 // callbacks and synchronization primitives
 struct vk_cmd {
-    struct vk_cmdpool *pool; // pool it was allocated from
+    struct vk_cmdpool *pool;     // pool (queue family) it belongs to
+    struct vk_cmdthread *thread; // per-thread pool it was allocated from
     VkQueue queue;           // the submission queue (for recording/pending)
     VkCommandBuffer buf;     // the command buffer itself
-    VkFence fence;           // the fence guards cmd buffer reuse
+    VkFence fence;           // the fence guards cmd buffer reuse (or NULL)
+    VkFence done_fence;      // the fence to wait on (may belong to a later cmd)
+    // If timeline semaphores are supported, completion is tracked via the
+    // queue's timeline semaphore instead of `fence`. `value` is the value
+    // the timeline reaches once this command completes, assigned when the
+    // command gets queued.
+    VkSemaphore timeline;
+    int queue_idx;
+    uint64_t value;
     // The semaphores represent dependencies that need to complete before
-    // this command can be executed. These are *not* owned by the vk_cmd
+    // this command can be executed. These are *not* owned by the vk_cmd.
+    // For timeline semaphores, `depvalues` gives the value to wait for.
     VkSemaphore *deps;
     VkPipelineStageFlags *depstages;
+    uint64_t *depvalues;
     int num_deps;
     // The signals represent semaphores that fire once the command finishes
     // executing. These are also not owned by the vk_cmd
     VkSemaphore *sigs;
+    uint64_t *sigvalues;
     int num_sigs;
+    // Signals generated by this command while it was not queued yet. (For
+    // timeline semaphores, their timeline value is not yet known)
+    struct vk_signal **tsigs;
+    int num_tsigs;
     // Since VkFences are useless, we have to manually track "callbacks"
     // to fire once the VkFence completes. These are used for multiple purposes,
     // ranging from garbage collection (resource deallocation) to fencing.
     struct vk_callback *callbacks;
     int num_callbacks;
-    // Abstract objects associated with this command. Can be used to
-    // selectively flush.
-    const void **objs;
+    // Objects associated with this command. Can be used to selectively flush.
+    // `seq` is the command's position in the queue, assigned when queued.
+    struct vk_obj **objs;
     int num_objs;
+    uint64_t seq;
 };
 
 // Associate a callback with the completion of the current command. This
@@ -73,7 +97,7 @@ void vk_cmd_dep(struct vk_cmd *cmd, VkSemaphore dep, VkPipelineStageFlags stage)
 
 // Associate an object with a command. This can be used to partially flush
 // commands only involving the object in question.
-void vk_cmd_obj(struct vk_cmd *cmd, const void *obj);
+void vk_cmd_obj(struct vk_cmd *cmd, struct vk_obj *obj);
 
 // Associate a raw signal with the current command. This semaphore will signal
 // after the command completes.
@@ -116,27 +140,51 @@ enum vk_wait_type vk_cmd_wait(struct vk_ctx *vk, struct vk_cmd *cmd,
 // longer relevant.
 void vk_signal_destroy(struct vk_ctx *vk, struct vk_signal **sig);
 
+// Returns the command generating this signal, if that command is still being
+// recorded (i.e. has not been queued yet), or NULL otherwise. Such signals can
+// only be waited on by the same command.
+struct vk_cmd *vk_signal_cmd(const struct vk_signal *sig);
+
+// Per-thread part of a vk_cmdpool. VkCommandPools (and all command buffers
+// allocated from them) must only ever be used by one thread at a time, so
+// every thread recording commands gets its own.
+struct vk_cmdthread {
+    pthread_t thread;
+    VkCommandPool pool;
+    // Command buffers allocated from this pool that are available for
+    // re-recording
+    struct vk_cmd **cmds;
+    int num_cmds;
+};
+
 // Command pool / queue family hybrid abstraction
 struct vk_cmdpool {
     VkQueueFamilyProperties props;
     int qf; // queue family index
-    VkCommandPool pool;
     VkQueue *queues;
     int num_queues;
     int idx_queues;
-    // Command buffers associated with this queue. These are available for
-    // re-recording
-    struct vk_cmd **cmds;
-    int num_cmds;
+    // Per-thread command pools, created on demand
+    struct vk_cmdthread **threads;
+    int num_threads;
+    // Timeline semaphores for each queue (if supported), and the last value
+    // assigned to a command queued on it
+    VkSemaphore *timelines;
+    uint64_t *timeline_values;
 };
 
-// Set up a vk_cmdpool corresponding to a queue family.
+// Set up a vk_cmdpool corresponding to a queue family. The pool uses the
+// `qinfo.queueCount` queues starting at queue index `first`.
 struct vk_cmdpool *vk_cmdpool_create(struct vk_ctx *vk,
-                                     VkDeviceQueueCreateInfo qinfo,
+                                     VkDeviceQueueCreateInfo qinfo, int first,
                                      VkQueueFamilyProperties props);
 
 void vk_cmdpool_destroy(struct vk_ctx *vk, struct vk_cmdpool *pool);
 
+// Returns the calling thread's command pool for this queue family, creating it
+// if needed. Returns NULL on failure.
+struct vk_cmdthread *vk_cmdpool_thread(struct vk_ctx *vk, struct vk_cmdpool *pool);
+
 // Fetch a command buffer from a command pool and begin recording to it.
 // Returns NULL on failure.
 struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool);
@@ -156,13 +204,18 @@ bool vk_cmd_queue(struct vk_ctx *vk, struct vk_cmd **cmd);
 // never flushed!
 bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout);
 
+// Like `vk_poll_commands`, but releases `vk->lock` while blocking, if possible
+// (see `vk_unlock_outermost`). Only for use by top-level waits that don't hold
+// on to any state other threads might modify in the meantime.
+bool vk_wait_commands(struct vk_ctx *vk, uint64_t timeout);
+
 // Flush all currently queued commands. Returns whether successful. Failed
 // commands will be implicitly dropped.
 bool vk_flush_commands(struct vk_ctx *vk);
 
 // Like `vk_flush_commands`, but only flushes up to the last command involving
 // `obj`, inclusive. If `obj` is NULL, behaves as `vk_flush_commands`.
-bool vk_flush_obj(struct vk_ctx *vk, const void *obj);
+bool vk_flush_obj(struct vk_ctx *vk, const struct vk_obj *obj);
 
 // Rotate through queues in each command pool. Call this once per frame, after
 // submitting all of the command buffers for that frame. Calling this more
@@ -170,6 +223,17 @@ bool vk_flush_obj(struct vk_ctx *vk, const void *obj);
 void vk_rotate_queues(struct vk_ctx *vk);
 
 // Wait until all commands are complete, i.e. the device is idle. This is
-// basically equivalent to calling `vk_poll_commands` with a timeout of
+// basically equivalent to calling `vk_wait_commands` with a timeout of
 // UINT64_MAX until it returns `false`.
 void vk_wait_idle(struct vk_ctx *vk);
+
+// Recursive locking of `vk->lock`. All of the functions in this file must be
+// called with the lock held.
+void vk_lock(struct vk_ctx *vk);
+void vk_unlock(struct vk_ctx *vk);
+
+// Releases `vk->lock` for the duration of a blocking call, but only if the
+// calling thread holds it exactly once, i.e. is not in the middle of some
+// other operation that expects the state to stay untouched. Returns whether
+// the lock was released, in which case it must be re-acquired with `vk_lock`.
+bool vk_unlock_outermost(struct vk_ctx *vk);
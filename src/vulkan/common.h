@@ -20,6 +20,8 @@
 #include "../common.h"
 #include "../context.h"
 
+#include <pthread.h>
+
 #ifdef __unix__
 #define VK_HAVE_UNIX 1
 #endif
@@ -67,6 +69,13 @@ struct vk_ctx {
     // Generic error flag for catching "failed" devices
     bool failed;
 
+    // Recursive lock protecting all of the mutable state below (command
+    // pools, queues, signals), as well as the pl_gpu built on top of this
+    // context. Held for the duration of every pl_gpu entry point, except
+    // while blocking (see `vk_unlock_outermost`) or compiling shaders.
+    pthread_mutex_t lock;
+    int lock_depth; // recursion depth, only accessed by the lock owner
+
     // Enabled extensions
     const char **exts;
     int num_exts;
@@ -74,6 +83,17 @@ struct vk_ctx {
     struct vk_cmdpool **pools;    // command pools (one per queue family)
     int num_pools;
 
+    // Graphics queues reserved for streams (see `pl_vulkan_stream_create`),
+    // starting at queue index `stream_queue` of the graphics queue family
+    bool *streams_used;
+    int num_streams;
+    int stream_queue;
+
+    // For streams, the context this stream was created from, and the index of
+    // the reserved queue it is bound to
+    struct vk_ctx *parent;
+    int stream_idx;
+
     // Pointers into *pools
     struct vk_cmdpool *pool_graphics; // required
     struct vk_cmdpool *pool_compute;  // optional
@@ -85,6 +105,23 @@ struct vk_ctx {
     struct vk_cmd **cmds_pending; // submitted but not completed
     int num_cmds_queued;
     int num_cmds_pending;
+    uint64_t cmd_seq;             // sequence number of the last queued command
+
+    // Number of threads currently blocked on a VkFence outside of the lock.
+    // Since fences get reset when their command is reused, completed commands
+    // are held back in `cmds_retired` until no thread is waiting anymore
+    int fence_waiters;
+    struct vk_cmd **cmds_retired;
+    int num_cmds_retired;
+
+    // Scratch space for batching up command submissions
+    VkSubmitInfo *submit_infos;
+    VkTimelineSemaphoreSubmitInfoKHR *timeline_infos;
+
+    // Submission statistics, as well as the counts for the current frame
+    struct pl_vulkan_submit_stats submit_stats;
+    int frame_submits;
+    int frame_cmds;
 
     // A dynamic reference to the most recently submitted command that has not
     // yet completed. Used to implement vk_dev_callback. Gets cleared when
@@ -95,6 +132,11 @@ struct vk_ctx {
     struct vk_signal **signals;
     int num_signals;
     bool disable_events;
+    enum pl_spirv_opt spirv_opt;
+
+    // User-provided format cache, only valid during `pl_gpu_create_vk`
+    const uint8_t *format_cache;
+    size_t format_cache_len;
 
     // Instance-level function pointers
     VK_FUN(CreateDevice);
@@ -105,8 +147,10 @@ struct vk_ctx {
     VK_FUN(GetPhysicalDeviceExternalSemaphorePropertiesKHR);
     VK_FUN(GetPhysicalDeviceFeatures2KHR);
     VK_FUN(GetPhysicalDeviceFormatProperties);
+    VK_FUN(GetPhysicalDeviceFormatProperties2KHR);
     VK_FUN(GetPhysicalDeviceImageFormatProperties2KHR);
     VK_FUN(GetPhysicalDeviceMemoryProperties);
+    VK_FUN(GetPhysicalDeviceMemoryProperties2KHR);
     VK_FUN(GetPhysicalDeviceProperties);
     VK_FUN(GetPhysicalDeviceProperties2KHR);
     VK_FUN(GetPhysicalDeviceQueueFamilyProperties);
@@ -138,9 +182,11 @@ struct vk_ctx {
     VK_FUN(CmdDraw);
     VK_FUN(CmdEndDebugUtilsLabelEXT);
     VK_FUN(CmdEndRenderPass);
+    VK_FUN(CmdExecuteCommands);
     VK_FUN(CmdPipelineBarrier);
     VK_FUN(CmdPushConstants);
     VK_FUN(CmdPushDescriptorSetKHR);
+    VK_FUN(CmdPushDescriptorSetWithTemplateKHR);
     VK_FUN(CmdResetQueryPool);
     VK_FUN(CmdSetEvent);
     VK_FUN(CmdSetScissor);
@@ -155,6 +201,7 @@ struct vk_ctx {
     VK_FUN(CreateDebugReportCallbackEXT);
     VK_FUN(CreateDescriptorPool);
     VK_FUN(CreateDescriptorSetLayout);
+    VK_FUN(CreateDescriptorUpdateTemplateKHR);
     VK_FUN(CreateEvent);
     VK_FUN(CreateFence);
     VK_FUN(CreateFramebuffer);
@@ -175,6 +222,7 @@ struct vk_ctx {
     VK_FUN(DestroyDebugReportCallbackEXT);
     VK_FUN(DestroyDescriptorPool);
     VK_FUN(DestroyDescriptorSetLayout);
+    VK_FUN(DestroyDescriptorUpdateTemplateKHR);
     VK_FUN(DestroyDevice);
     VK_FUN(DestroyEvent);
     VK_FUN(DestroyFence);
@@ -197,15 +245,22 @@ struct vk_ctx {
     VK_FUN(FreeMemory);
     VK_FUN(GetBufferMemoryRequirements);
     VK_FUN(GetDeviceQueue);
+    VK_FUN(GetImageDrmFormatModifierPropertiesEXT);
     VK_FUN(GetImageMemoryRequirements);
+    VK_FUN(GetImageMemoryRequirements2KHR);
     VK_FUN(GetMemoryFdKHR);
     VK_FUN(GetMemoryFdPropertiesKHR);
+    VK_FUN(GetMemoryHostPointerPropertiesEXT);
+    VK_FUN(GetPastPresentationTimingGOOGLE);
     VK_FUN(GetPipelineCacheData);
     VK_FUN(GetQueryPoolResults);
+    VK_FUN(GetRefreshCycleDurationGOOGLE);
+    VK_FUN(GetSemaphoreCounterValueKHR);
     VK_FUN(GetSemaphoreFdKHR);
     VK_FUN(GetSwapchainImagesKHR);
     VK_FUN(InvalidateMappedMemoryRanges);
     VK_FUN(MapMemory);
+    VK_FUN(MergePipelineCaches);
     VK_FUN(QueuePresentKHR);
     VK_FUN(QueueSubmit);
     VK_FUN(ResetEvent);
@@ -213,8 +268,13 @@ struct vk_ctx {
     VK_FUN(ResetQueryPoolEXT);
     VK_FUN(SetDebugUtilsObjectNameEXT);
     VK_FUN(SetHdrMetadataEXT);
+    VK_FUN(UpdateDescriptorSetWithTemplateKHR);
     VK_FUN(UpdateDescriptorSets);
     VK_FUN(WaitForFences);
+    VK_FUN(WaitSemaphoresKHR);
+#ifdef VK_KHR_present_wait
+    VK_FUN(WaitForPresentKHR);
+#endif
 
 #ifdef VK_HAVE_WIN32
     VK_FUN(GetMemoryWin32HandleKHR);
@@ -69,8 +69,10 @@ static const struct vk_fun vk_inst_funs[] = {
     VK_INST_FUN(GetDeviceProcAddr),
     VK_INST_FUN(GetPhysicalDeviceFeatures2KHR),
     VK_INST_FUN(GetPhysicalDeviceFormatProperties),
+    VK_INST_FUN(GetPhysicalDeviceFormatProperties2KHR),
     VK_INST_FUN(GetPhysicalDeviceImageFormatProperties2KHR),
     VK_INST_FUN(GetPhysicalDeviceMemoryProperties),
+    VK_INST_FUN(GetPhysicalDeviceMemoryProperties2KHR),
     VK_INST_FUN(GetPhysicalDeviceProperties),
     VK_INST_FUN(GetPhysicalDeviceProperties2KHR),
     VK_INST_FUN(GetPhysicalDeviceQueueFamilyProperties),
@@ -103,6 +105,20 @@ static const struct vk_ext vk_device_extensions[] = {
         .name = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
         .funs = (struct vk_fun[]) {
             VK_DEV_FUN(CmdPushDescriptorSetKHR),
+            // Only available if VK_KHR_descriptor_update_template is as well
+            VK_DEV_FUN(CmdPushDescriptorSetWithTemplateKHR),
+            {0},
+        },
+    }, {
+        .name = VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_1,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN_ALIAS(CreateDescriptorUpdateTemplateKHR,
+                             vkCreateDescriptorUpdateTemplate),
+            VK_DEV_FUN_ALIAS(DestroyDescriptorUpdateTemplateKHR,
+                             vkDestroyDescriptorUpdateTemplate),
+            VK_DEV_FUN_ALIAS(UpdateDescriptorSetWithTemplateKHR,
+                             vkUpdateDescriptorSetWithTemplate),
             {0},
         },
     }, {
@@ -124,6 +140,38 @@ static const struct vk_ext vk_device_extensions[] = {
             VK_DEV_FUN(GetMemoryFdPropertiesKHR),
             {0},
         },
+    }, {
+        .name = VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_2,
+        .funs = (struct vk_fun[]) {
+            {0},
+        },
+    }, {
+        .name = VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN(GetImageDrmFormatModifierPropertiesEXT),
+            {0},
+        },
+    }, {
+        .name = VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_1,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN_ALIAS(GetImageMemoryRequirements2KHR,
+                             vkGetImageMemoryRequirements2),
+            {0},
+        },
+    }, {
+        .name = VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_1,
+        .funs = (struct vk_fun[]) {
+            {0}
+        },
+    }, {
+        .name = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN(GetMemoryHostPointerPropertiesEXT),
+            {0},
+        },
 #ifdef VK_HAVE_WIN32
     }, {
         .name = VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
@@ -171,15 +219,60 @@ static const struct vk_ext vk_device_extensions[] = {
             VK_DEV_FUN_ALIAS(ResetQueryPoolEXT, vkResetQueryPool),
             {0},
         },
+    }, {
+        .name = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            {0}
+        },
+    }, {
+        .name = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_2,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN_ALIAS(GetSemaphoreCounterValueKHR, vkGetSemaphoreCounterValue),
+            VK_DEV_FUN_ALIAS(WaitSemaphoresKHR, vkWaitSemaphores),
+            {0},
+        },
+    }, {
+        .name = VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME,
+        .core_ver = VK_API_VERSION_1_2,
+        .funs = (struct vk_fun[]) {
+            {0}
+        },
+    }, {
+        .name = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN(GetPastPresentationTimingGOOGLE),
+            VK_DEV_FUN(GetRefreshCycleDurationGOOGLE),
+            {0},
+        },
+#ifdef VK_KHR_present_wait
+    }, {
+        .name = VK_KHR_PRESENT_ID_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            {0}
+        },
+    }, {
+        .name = VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+        .funs = (struct vk_fun[]) {
+            VK_DEV_FUN(WaitForPresentKHR),
+            {0},
+        },
+#endif
     },
 };
 
 // Make sure to keep this in sync with the above!
 const char * const pl_vulkan_recommended_extensions[] = {
     VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+    VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
     VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
     VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
     VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+    VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+    VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+    VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
     VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
     VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
 #ifdef VK_HAVE_WIN32
@@ -189,14 +282,50 @@ const char * const pl_vulkan_recommended_extensions[] = {
     VK_EXT_PCI_BUS_INFO_EXTENSION_NAME,
     VK_EXT_HDR_METADATA_EXTENSION_NAME,
     VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME,
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+    VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME,
+    VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME,
+#ifdef VK_KHR_present_wait
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+#endif
 };
 
 const int pl_vulkan_num_recommended_extensions =
     PL_ARRAY_SIZE(pl_vulkan_recommended_extensions);
 
 // pNext chain of features we want enabled
+#ifdef VK_KHR_present_wait
+static const VkPhysicalDevicePresentIdFeaturesKHR present_id = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+    .presentId = true,
+};
+
+static const VkPhysicalDevicePresentWaitFeaturesKHR present_wait = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+    .pNext = (void *) &present_id,
+    .presentWait = true,
+};
+#endif
+
+static const VkPhysicalDeviceShaderFloat16Int8FeaturesKHR shader_float16 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR,
+#ifdef VK_KHR_present_wait
+    .pNext = (void *) &present_wait,
+#endif
+    .shaderFloat16 = true,
+};
+
+static const VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+    .pNext = (void *) &shader_float16,
+    .timelineSemaphore = true,
+};
+
 static const VkPhysicalDeviceHostQueryResetFeaturesEXT host_query_reset = {
     .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES_EXT,
+    .pNext = (void *) &timeline_semaphore,
     .hostQueryReset = true,
 };
 
@@ -239,6 +368,7 @@ static const struct vk_fun vk_dev_funs[] = {
     VK_DEV_FUN(CmdDraw),
     VK_DEV_FUN(CmdEndDebugUtilsLabelEXT),
     VK_DEV_FUN(CmdEndRenderPass),
+    VK_DEV_FUN(CmdExecuteCommands),
     VK_DEV_FUN(CmdPipelineBarrier),
     VK_DEV_FUN(CmdPushConstants),
     VK_DEV_FUN(CmdResetQueryPool),
@@ -300,6 +430,7 @@ static const struct vk_fun vk_dev_funs[] = {
     VK_DEV_FUN(GetQueryPoolResults),
     VK_DEV_FUN(InvalidateMappedMemoryRanges),
     VK_DEV_FUN(MapMemory),
+    VK_DEV_FUN(MergePipelineCaches),
     VK_DEV_FUN(QueueSubmit),
     VK_DEV_FUN(ResetEvent),
     VK_DEV_FUN(ResetFences),
@@ -773,6 +904,15 @@ error:
     return NULL;
 }
 
+static void vk_ctx_init_lock(struct vk_ctx *vk)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&vk->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
 const struct pl_vulkan_params pl_vulkan_default_params = {
     .async_transfer = true,
     .async_compute  = true,
@@ -789,7 +929,9 @@ void pl_vulkan_destroy(const struct pl_vulkan **pl_vk)
     struct vk_ctx *vk = TA_PRIV(*pl_vk);
     if (vk->dev) {
         PL_DEBUG(vk, "Flushing remaining commands...");
+        vk_lock(vk);
         vk_wait_idle(vk);
+        vk_unlock(vk);
         pl_assert(vk->num_cmds_queued == 0);
         pl_assert(vk->num_cmds_pending == 0);
         for (int i = 0; i < vk->num_pools; i++)
@@ -801,7 +943,14 @@ void pl_vulkan_destroy(const struct pl_vulkan **pl_vk)
             vk->DestroyDevice(vk->dev, VK_ALLOC);
     }
 
+    if (vk->parent) {
+        vk_lock(vk->parent);
+        vk->parent->streams_used[vk->stream_idx] = false;
+        vk_unlock(vk->parent);
+    }
+
     pl_vk_inst_destroy(&vk->internal_instance);
+    pthread_mutex_destroy(&vk->lock);
     TA_FREEP((void **) pl_vk);
 }
 
@@ -830,6 +979,20 @@ error:
 
 VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
                                          const struct pl_vulkan_device_params *params)
+{
+    VkPhysicalDevice dev = VK_NULL_HANDLE;
+    pl_vulkan_choose_devices(ctx, params, &dev, 1);
+    return dev;
+}
+
+struct vk_candidate {
+    VkPhysicalDevice dev;
+    int priority;
+};
+
+int pl_vulkan_choose_devices(struct pl_context *ctx,
+                             const struct pl_vulkan_device_params *params,
+                             VkPhysicalDevice *out_devices, int max_devices)
 {
     // Hack for the VK macro's logging to work
     struct { struct pl_context *ctx; } *vk = (void *) &ctx;
@@ -837,11 +1000,12 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
 
     pl_assert(params->instance);
     VkInstance inst = params->instance;
-    VkPhysicalDevice dev = VK_NULL_HANDLE;
+    struct vk_candidate *candidates = NULL;
+    int num_candidates = 0;
 
     PFN_vkGetInstanceProcAddr get_addr;
     if (!(get_addr = get_proc_addr_fallback(ctx, params->get_proc_addr)))
-        return NULL;
+        return 0;
 
     VK_LOAD_FUN(inst, EnumeratePhysicalDevices, get_addr);
     VK_LOAD_FUN(inst, GetPhysicalDeviceProperties2KHR, get_addr);
@@ -850,7 +1014,7 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
         PL_FATAL(vk, "Provided VkInstance does not support "
                  VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
                  ", cannot continue!");
-        return VK_NULL_HANDLE;
+        return 0;
     }
 
     VkPhysicalDevice *devices = NULL;
@@ -870,7 +1034,6 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
     static const uint8_t nil[VK_UUID_SIZE] = {0};
     bool uuid_set = memcmp(params->device_uuid, nil, VK_UUID_SIZE) != 0;
 
-    int best = -1;
     for (int i = 0; i < num; i++) {
         VkPhysicalDeviceIDPropertiesKHR id_props = {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR,
@@ -902,9 +1065,12 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
             }
         }
 
+        int priority = t < PL_ARRAY_SIZE(types) ? types[t].priority : 0;
+        struct vk_candidate cand = { devices[i], priority };
+
         if (uuid_set) {
             if (memcmp(id_props.deviceUUID, params->device_uuid, VK_UUID_SIZE) == 0) {
-                dev = devices[i];
+                TARRAY_APPEND(NULL, candidates, num_candidates, cand);
                 continue;
             } else {
                 PL_DEBUG(vk, "     -> excluding due to UUID mismatch");
@@ -912,7 +1078,7 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
             }
         } else if (params->device_name && params->device_name[0] != '\0') {
             if (strcmp(params->device_name, prop.properties.deviceName) == 0) {
-                dev = devices[i];
+                TARRAY_APPEND(NULL, candidates, num_candidates, cand);
                 continue;
             } else {
                 PL_DEBUG(vk, "      -> excluding due to name mismatch");
@@ -925,16 +1091,31 @@ VkPhysicalDevice pl_vulkan_choose_device(struct pl_context *ctx,
             continue;
         }
 
-        int priority = t < PL_ARRAY_SIZE(types) ? types[t].priority : 0;
-        if (priority > best) {
-            dev = devices[i];
-            best = priority;
-        }
+        TARRAY_APPEND(NULL, candidates, num_candidates, cand);
+    }
+
+    // Stable insertion sort by descending priority, so that devices of the
+    // same type retain their enumeration order
+    for (int i = 1; i < num_candidates; i++) {
+        struct vk_candidate tmp = candidates[i];
+        int j = i;
+        for (; j > 0 && candidates[j - 1].priority < tmp.priority; j--)
+            candidates[j] = candidates[j - 1];
+        candidates[j] = tmp;
     }
 
+    num_candidates = PL_MIN(num_candidates, max_devices);
+    for (int i = 0; i < num_candidates; i++)
+        out_devices[i] = candidates[i].dev;
+
+    talloc_free(candidates);
+    talloc_free(devices);
+    return num_candidates;
+
 error:
+    talloc_free(candidates);
     talloc_free(devices);
-    return dev;
+    return 0;
 }
 
 // Find the most specialized queue supported a combination of flags. In cases
@@ -1051,7 +1232,10 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
     // Now that we know which QFs we want, we can create the logical device
     VkDeviceQueueCreateInfo *qinfos = NULL;
     int num_qinfos = 0;
-    add_qinfo(tmp, &qinfos, &num_qinfos, qfs, idx_gfx, params->queue_count);
+    int gfx_count = params->queue_count;
+    if (gfx_count)
+        gfx_count += params->num_streams;
+    add_qinfo(tmp, &qinfos, &num_qinfos, qfs, idx_gfx, gfx_count);
     add_qinfo(tmp, &qinfos, &num_qinfos, qfs, idx_comp, params->queue_count);
     add_qinfo(tmp, &qinfos, &num_qinfos, qfs, idx_tf, params->queue_count);
 
@@ -1194,7 +1378,25 @@ static bool device_init(struct vk_ctx *vk, const struct pl_vulkan_params *params
     // Create the command pools
     for (int i = 0; i < num_qinfos; i++) {
         int qf = qinfos[i].queueFamilyIndex;
-        struct vk_cmdpool *pool = vk_cmdpool_create(vk, qinfos[i], qfs[qf]);
+        VkDeviceQueueCreateInfo qinfo = qinfos[i];
+
+        // Keep the reserved stream queues out of the graphics pool, but leave
+        // at least one queue for ourselves
+        if (qf == idx_gfx && params->num_streams > 0) {
+            int num = PL_MIN(params->num_streams, (int) qinfo.queueCount - 1);
+            if (num < params->num_streams) {
+                PL_WARN(vk, "Graphics queue family only has %d queues, "
+                        "reserving %d/%d queues for streams",
+                        (int) qinfo.queueCount, num, params->num_streams);
+            }
+
+            qinfo.queueCount -= num;
+            vk->num_streams = num;
+            vk->stream_queue = qinfo.queueCount;
+            vk->streams_used = talloc_zero_array(vk->ta, bool, num);
+        }
+
+        struct vk_cmdpool *pool = vk_cmdpool_create(vk, qinfo, 0, qfs[qf]);
         if (!pool)
             goto error;
         TARRAY_APPEND(vk->ta, vk->pools, vk->num_pools, pool);
@@ -1241,6 +1443,9 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
         .GetInstanceProcAddr = get_proc_addr_fallback(ctx, params->get_proc_addr),
     };
 
+    vk_ctx_init_lock(vk);
+    uint64_t t_start = pl_clock_ns();
+
     if (!vk->GetInstanceProcAddr)
         goto error;
 
@@ -1259,6 +1464,8 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
         vk->inst = vk->internal_instance->instance;
     }
 
+    uint64_t t_inst = pl_clock_ns();
+
     // Directly load all mandatory instance-level function pointers, since
     // these will be required for all further device creation logic
     for (int i = 0; i < PL_ARRAY_SIZE(vk_inst_funs); i++) {
@@ -1299,6 +1506,7 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
 
     vk->GetPhysicalDeviceProperties2KHR(vk->physd, &prop);
     vk->limits = prop.properties.limits;
+    uint64_t t_physd = pl_clock_ns();
 
     PL_INFO(vk, "Vulkan device properties:");
     PL_INFO(vk, "    Device Name: %s", prop.properties.deviceName);
@@ -1320,10 +1528,23 @@ const struct pl_vulkan *pl_vulkan_create(struct pl_context *ctx,
     if (!device_init(vk, params))
         goto error;
 
+    uint64_t t_device = pl_clock_ns();
+
+    vk->spirv_opt = params->spirv_opt;
+    vk->format_cache = params->format_cache;
+    vk->format_cache_len = params->format_cache_len;
     pl_vk->gpu = pl_gpu_create_vk(vk);
+    vk->format_cache = NULL;
     if (!pl_vk->gpu)
         goto error;
 
+    uint64_t t_gpu = pl_clock_ns();
+    PL_INFO(vk, "Vulkan initialization took %.2f ms (instance: %.2f ms, "
+            "physical device: %.2f ms, device: %.2f ms, gpu: %.2f ms)",
+            (t_gpu - t_start) * 1e-6, (t_inst - t_start) * 1e-6,
+            (t_physd - t_inst) * 1e-6, (t_device - t_physd) * 1e-6,
+            (t_gpu - t_device) * 1e-6);
+
     // Blacklist / restrict features
     if (params->blacklist_caps) {
         pl_gpu_caps *caps = (pl_gpu_caps*) &pl_vk->gpu->caps;
@@ -1374,8 +1595,11 @@ error:
     return NULL;
 }
 
-const struct pl_vulkan *pl_vulkan_import(struct pl_context *ctx,
-                                         const struct pl_vulkan_import_params *params)
+// Shared implementation of `pl_vulkan_import` and `pl_vulkan_stream_create`.
+// The graphics pool uses the queues starting at index `gfx_first`.
+static struct pl_vulkan *vk_import(struct pl_context *ctx,
+                                   const struct pl_vulkan_import_params *params,
+                                   int gfx_first)
 {
     void *tmp = talloc_new(NULL);
 
@@ -1391,6 +1615,8 @@ const struct pl_vulkan *pl_vulkan_import(struct pl_context *ctx,
         .GetInstanceProcAddr = get_proc_addr_fallback(ctx, params->get_proc_addr),
     };
 
+    vk_ctx_init_lock(vk);
+
     if (!vk->GetInstanceProcAddr)
         goto error;
 
@@ -1503,7 +1729,8 @@ const struct pl_vulkan *pl_vulkan_import(struct pl_context *ctx,
             .queueCount = qinfos[i].info->count,
         };
 
-        *pool = vk_cmdpool_create(vk, qinfo, qfs[qf]);
+        int first = pool == &vk->pool_graphics ? gfx_first : 0;
+        *pool = vk_cmdpool_create(vk, qinfo, first, qfs[qf]);
         if (!*pool)
             goto error;
         TARRAY_APPEND(vk->ta, vk->pools, vk->num_pools, *pool);
@@ -1517,7 +1744,11 @@ next_qf: ;
     if (params->blacklist_caps & PL_GPU_CAP_COMPUTE)
         vk->pool_compute = NULL;
 
+    vk->spirv_opt = params->spirv_opt;
+    vk->format_cache = params->format_cache;
+    vk->format_cache_len = params->format_cache_len;
     pl_vk->gpu = pl_gpu_create_vk(vk);
+    vk->format_cache = NULL;
     if (!pl_vk->gpu)
         goto error;
 
@@ -1572,3 +1803,65 @@ error:
     pl_vulkan_destroy((const struct pl_vulkan **) &pl_vk);
     return NULL;
 }
+
+const struct pl_vulkan *pl_vulkan_import(struct pl_context *ctx,
+                                         const struct pl_vulkan_import_params *params)
+{
+    return vk_import(ctx, params, 0);
+}
+
+const struct pl_vulkan *pl_vulkan_stream_create(struct pl_context *ctx,
+                                                const struct pl_vulkan *parent)
+{
+    struct vk_ctx *pvk = TA_PRIV(parent);
+    int idx = -1;
+
+    vk_lock(pvk);
+    for (int i = 0; i < pvk->num_streams; i++) {
+        if (!pvk->streams_used[i]) {
+            pvk->streams_used[i] = true;
+            idx = i;
+            break;
+        }
+    }
+    vk_unlock(pvk);
+
+    if (idx < 0) {
+        PL_ERR(pvk, "No free stream queues left! (%d reserved)", pvk->num_streams);
+        return NULL;
+    }
+
+    struct pl_vulkan_import_params params = {
+        .instance = pvk->inst,
+        .get_proc_addr = pvk->GetInstanceProcAddr,
+        .phys_device = pvk->physd,
+        .device = pvk->dev,
+        .extensions = pvk->exts,
+        .num_extensions = pvk->num_exts,
+        .queue_graphics = {
+            .index = pvk->pool_graphics->qf,
+            .count = 1,
+        },
+        .features = &pvk->features,
+        .spirv_opt = pvk->spirv_opt,
+        .blacklist_caps = ~parent->gpu->caps,
+        .max_glsl_version = parent->gpu->glsl.version,
+        .disable_events = pvk->disable_events,
+        .max_api_version = pvk->api_ver,
+    };
+
+    struct pl_vulkan *pl_vk = vk_import(ctx, &params, pvk->stream_queue + idx);
+    if (!pl_vk) {
+        vk_lock(pvk);
+        pvk->streams_used[idx] = false;
+        vk_unlock(pvk);
+        return NULL;
+    }
+
+    struct vk_ctx *vk = TA_PRIV(pl_vk);
+    vk->parent = pvk;
+    vk->stream_idx = idx;
+    PL_INFO(vk, "Created stream on graphics queue %d (QF %d)",
+            pvk->stream_queue + idx, pvk->pool_graphics->qf);
+    return pl_vk;
+}
@@ -15,6 +15,8 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
+
 #include "gpu.h"
 #include "command.h"
 #include "formats.h"
@@ -33,6 +35,99 @@ enum queue_type {
     TRANSFER,
 };
 
+// Format properties, as either queried from the driver or loaded from a
+// user-provided format cache (see `pl_vulkan_save_format_cache`)
+struct vk_fmt_props {
+    VkFormat format;
+    VkFormatProperties props;
+    uint64_t *mods; // DRM format modifiers usable for sampled DMA-BUF imports
+    int num_mods;   // or -1 if not queried
+};
+
+// Number of query pairs in the timestamp query ring
+#define QUERY_RING_SLOTS 256
+
+// Timestamp queries of all timers are allocated from a single ring of query
+// pairs (even=start, odd=stop), so their results can be read back in bulk
+struct vk_query_ring {
+    VkQueryPool qpool;
+    struct vk_query_slot {
+        struct pl_timer *timer; // or NULL if the timer was destroyed
+        bool done;              // set once the command was completed or dropped
+    } slots[QUERY_RING_SLOTS];
+    int head; // next slot to allocate
+    int tail; // oldest slot not yet read back
+    uint64_t ts[4 * QUERY_RING_SLOTS]; // scratch space for readbacks
+};
+
+// Commands are recorded separately by every thread using the pl_gpu, each
+// from its own command pools (see `vk_cmdpool_thread`), so that threads don't
+// end up recording into each other's commands. This holds all of the state
+// tied to the command currently being recorded by a thread.
+struct vk_rec {
+    pthread_t thread;
+
+    // This is a pl_dispatch used (on ourselves!) for the purposes of
+    // dispatching compute shaders for performing various emulation tasks
+    // (e.g. partial clears, blits or emulated texture transfers). Created on
+    // first use. Warning: Care must be taken to avoid recursive calls.
+    struct pl_dispatch *dp;
+
+    // The "currently recording" command. This will be queued and replaced by
+    // a new command every time we need to "switch" between queue families.
+    struct vk_cmd *cmd;
+
+    // The render pass currently being deferred on `cmd`, if any. Raster passes
+    // record their draw commands into secondary command buffers, which are
+    // only executed (inside a single render pass) once something other than
+    // another compatible raster pass to the same target needs to happen.
+    struct vk_rp {
+        const struct pl_tex *target;
+        const struct pl_pass *pass; // first pass, provides the VkRenderPass
+        VkCommandBuffer *bufs;
+        int num_bufs;
+        // Resources to signal once the render pass is done
+        const struct pl_buf **verts;
+        int num_verts;
+        struct vk_rp_desc {
+            const struct pl_pass *pass;
+            struct pl_desc_binding db;
+            int idx;
+        } *descs;
+        int num_descs;
+    } rp;
+
+    // Pool of available secondary command buffers (from this thread's
+    // command pool for `pool_graphics`)
+    VkCommandBuffer *secondaries;
+    int num_secondaries;
+
+    // Barriers generated by tex_barrier/buf_barrier are accumulated here, and
+    // only recorded (as a single vkCmdPipelineBarrier / vkCmdWaitEvents each)
+    // right before the next command that may depend on them. See
+    // vk_flush_barriers.
+    struct vk_barrier_batch {
+        struct vk_cmd *cmd;
+        VkPipelineStageFlags src_stages;
+        VkPipelineStageFlags dst_stages;
+        VkEvent *events; // only for `event_wait`
+        int num_events;
+        VkImageMemoryBarrier *imgs;
+        int num_imgs;
+        VkBufferMemoryBarrier *bufs;
+        int num_bufs;
+    } barrier, event_wait;
+
+    // Pool of vertex buffers for streaming vertex data, i.e. vertex data too
+    // large to be worth caching per pass (see `vk_pass_run`)
+    struct pl_buf_pool vbo;
+
+    // Streaming buffer rings for transfers without a user-provided buffer
+    // (see `pl_tex_upload_pbo`)
+    struct pl_buf_ring pbo_write;
+    struct pl_buf_ring pbo_read;
+};
+
 // For gpu.priv
 struct pl_vk {
     struct pl_gpu_fns impl;
@@ -40,29 +135,119 @@ struct pl_vk {
     struct vk_malloc *alloc;
     struct spirv_compiler *spirv;
 
+    // Pipeline cache shared by all passes, see `pl_vulkan_save_pipeline_cache`
+    VkPipelineCache pipecache;
+
+    // All format properties used by `vk_setup_formats`
+    struct vk_fmt_props *fmt_props;
+    int num_fmt_props;
+    int num_fmt_queries; // number of properties not found in the cache
+
     // Some additional cached device limits and features checks
     uint32_t max_push_descriptors;
     size_t min_texel_alignment;
     bool host_query_reset;
 
-    // This is a pl_dispatch used (on ourselves!) for the purposes of
-    // dispatching compute shaders for performing various emulation tasks
-    // (e.g. partial clears, blits or emulated texture transfers).
-    // Warning: Care must be taken to avoid recursive calls.
-    struct pl_dispatch *dp;
+    // Per-thread recording state, see `vk_rec`
+    struct vk_rec **recs;
+    int num_recs;
 
-    // The "currently recording" command. This will be queued and replaced by
-    // a new command every time we need to "switch" between queue families.
-    struct vk_cmd *cmd;
+    // Shared timestamp queries for all `pl_timer`s
+    struct vk_query_ring queries;
 };
 
-static void vk_submit(const struct pl_gpu *gpu)
+// Returns the calling thread's recording state, creating it if needed. Must
+// be called with the lock held.
+static struct vk_rec *vk_rec(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    pthread_t self = pthread_self();
+    for (int i = 0; i < p->num_recs; i++) {
+        if (pthread_equal(p->recs[i]->thread, self))
+            return p->recs[i];
+    }
+
+    struct vk_rec *rec = talloc_zero((void *) gpu, struct vk_rec);
+    rec->thread = self;
+    TARRAY_APPEND((void *) gpu, p->recs, p->num_recs, rec);
+    return rec;
+}
+
+// Returns the calling thread's internal pl_dispatch, see `vk_rec.dp`
+static struct pl_dispatch *vk_dispatch(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_rec *rec = vk_rec(gpu);
+    if (!rec->dp)
+        rec->dp = pl_dispatch_create(p->vk->ctx, gpu);
+    return rec->dp;
+}
+
+static void rec_end_render_pass(const struct pl_gpu *gpu, struct vk_rec *rec);
+static void rec_flush_barriers(const struct pl_gpu *gpu, struct vk_rec *rec);
+
+static void rec_submit(const struct pl_gpu *gpu, struct vk_rec *rec)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
 
-    if (p->cmd)
-        vk_cmd_queue(vk, &p->cmd);
+    rec_end_render_pass(gpu, rec);
+    rec_flush_barriers(gpu, rec);
+    if (rec->cmd)
+        vk_cmd_queue(vk, &rec->cmd);
+}
+
+static void vk_submit(const struct pl_gpu *gpu)
+{
+    rec_submit(gpu, vk_rec(gpu));
+}
+
+static void vk_end_render_pass(const struct pl_gpu *gpu)
+{
+    rec_end_render_pass(gpu, vk_rec(gpu));
+}
+
+static void vk_flush_barriers(const struct pl_gpu *gpu)
+{
+    rec_flush_barriers(gpu, vk_rec(gpu));
+}
+
+static bool rp_uses(const struct vk_rp *rp, const void *obj)
+{
+    if (rp->target == obj)
+        return true;
+    for (int i = 0; i < rp->num_verts; i++) {
+        if (rp->verts[i] == obj)
+            return true;
+    }
+    for (int i = 0; i < rp->num_descs; i++) {
+        if (rp->descs[i].db.object == obj)
+            return true;
+    }
+    return false;
+}
+
+// Makes sure `obj` is not still in use by a command being recorded by another
+// thread, so that `cmd` can synchronize against its signal `*sig`. This can
+// only happen if the user did not flush the other thread's commands first, in
+// which case they get queued on its behalf. That is safe, because threads
+// never hold on to their recording command without holding the lock (which is
+// only released while blocking as the outermost call).
+static void vk_claim_obj(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                         const void *obj, struct vk_signal **sig)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    for (int i = 0; i < p->num_recs; i++) {
+        struct vk_rec *rec = p->recs[i];
+        if (!rec->cmd || rec->cmd == cmd)
+            continue;
+        if (rec->cmd == vk_signal_cmd(*sig) || rp_uses(&rec->rp, obj)) {
+            PL_TRACE(gpu, "Submitting command recorded by another thread");
+            rec_submit(gpu, rec);
+        }
+    }
+
+    pl_assert(!vk_signal_cmd(*sig) || vk_signal_cmd(*sig) == cmd);
 }
 
 // Returns a command buffer, or NULL on error
@@ -89,12 +274,14 @@ static struct vk_cmd *vk_require_cmd(const struct pl_gpu *gpu,
     }
 
     pl_assert(pool);
-    if (p->cmd && p->cmd->pool == pool)
-        return p->cmd;
-
-    vk_submit(gpu);
-    p->cmd = vk_cmd_begin(vk, pool);
-    return p->cmd;
+    struct vk_rec *rec = vk_rec(gpu);
+    rec_end_render_pass(gpu, rec);
+    if (rec->cmd && rec->cmd->pool == pool)
+        return rec->cmd;
+
+    rec_submit(gpu, rec);
+    rec->cmd = vk_cmd_begin(vk, pool);
+    return rec->cmd;
 }
 
 static inline bool supports_marks(struct vk_cmd *cmd) {
@@ -123,11 +310,14 @@ static inline bool supports_marks(struct vk_cmd *cmd) {
     static void fun##_lazy(const struct pl_gpu *gpu, argtype *arg) {        \
         struct pl_vk *p = TA_PRIV(gpu);                                     \
         struct vk_ctx *vk = p->vk;                                          \
-        if (p->cmd) {                                                       \
-            vk_cmd_callback(p->cmd, (vk_cb) fun, gpu, (void *) arg);        \
+        vk_lock(vk);                                                        \
+        struct vk_rec *rec = vk_rec(gpu);                                   \
+        if (rec->cmd) {                                                     \
+            vk_cmd_callback(rec->cmd, (vk_cb) fun, gpu, (void *) arg);      \
         } else {                                                            \
             vk_dev_callback(vk, (vk_cb) fun, gpu, (void *) arg);            \
         }                                                                   \
+        vk_unlock(vk);                                                      \
     }
 
 static void vk_destroy_gpu(const struct pl_gpu *gpu)
@@ -135,16 +325,237 @@ static void vk_destroy_gpu(const struct pl_gpu *gpu)
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
 
-    pl_dispatch_destroy(&p->dp);
-    vk_submit(gpu);
+    vk_lock(vk);
+    for (int i = 0; i < p->num_recs; i++) {
+        pl_dispatch_destroy(&p->recs[i]->dp);
+        rec_submit(gpu, p->recs[i]);
+    }
     vk_wait_idle(vk);
 
+    for (int i = 0; i < p->num_recs; i++) {
+        struct vk_rec *rec = p->recs[i];
+        pl_buf_pool_uninit(gpu, &rec->vbo);
+        pl_buf_ring_uninit(gpu, &rec->pbo_write);
+        pl_buf_ring_uninit(gpu, &rec->pbo_read);
+    }
+    vk_unlock(vk);
+
+    vk->DestroyQueryPool(vk->dev, p->queries.qpool, VK_ALLOC);
+    vk->DestroyPipelineCache(vk->dev, p->pipecache, VK_ALLOC);
     vk_malloc_destroy(&p->alloc);
     spirv_compiler_destroy(&p->spirv);
 
     talloc_free((void *) gpu);
 }
 
+#define VK_FMT_CACHE_MAGIC {'P','L','V','F'}
+#define VK_FMT_CACHE_VERSION 1
+static const char vk_fmt_cache_magic[4] = VK_FMT_CACHE_MAGIC;
+
+// Identifies the device (and driver) a format cache belongs to
+struct vk_fmt_cache_header {
+    char magic[sizeof(vk_fmt_cache_magic)];
+    int cache_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint32_t api_version;
+    uint8_t uuid[VK_UUID_SIZE];
+    int num_entries;
+};
+
+// Followed by `num_mods` DRM format modifiers (uint64_t)
+struct vk_fmt_cache_entry {
+    VkFormat format;
+    VkFormatProperties props;
+    int num_mods;
+};
+
+static struct vk_fmt_cache_header vk_fmt_cache_header(struct vk_ctx *vk)
+{
+    VkPhysicalDeviceIDPropertiesKHR id_props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR,
+    };
+
+    VkPhysicalDeviceProperties2KHR props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+        .pNext = &id_props,
+    };
+
+    vk->GetPhysicalDeviceProperties2KHR(vk->physd, &props);
+
+    struct vk_fmt_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, vk_fmt_cache_magic, sizeof(header.magic));
+    header.cache_version = VK_FMT_CACHE_VERSION;
+    header.vendor_id = props.properties.vendorID;
+    header.device_id = props.properties.deviceID;
+    header.driver_version = props.properties.driverVersion;
+    header.api_version = vk->api_ver;
+    memcpy(header.uuid, id_props.deviceUUID, sizeof(header.uuid));
+    return header;
+}
+
+static void vk_load_fmt_cache(struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    struct bstr cache = {
+        .start = (void *) vk->format_cache,
+        .len   = vk->format_cache_len,
+    };
+
+    if (!cache.len)
+        return;
+
+    struct vk_fmt_cache_header header = vk_fmt_cache_header(vk), in;
+    if (cache.len < sizeof(in))
+        goto invalid;
+    memcpy(&in, cache.start, sizeof(in));
+    cache = bstr_cut(cache, sizeof(in));
+
+    header.num_entries = in.num_entries;
+    if (memcmp(&header, &in, sizeof(header)) != 0 || in.num_entries < 0) {
+        PL_INFO(gpu, "Format cache belongs to a different device or driver, "
+                "ignoring");
+        return;
+    }
+
+    for (int i = 0; i < in.num_entries; i++) {
+        struct vk_fmt_cache_entry entry;
+        if (cache.len < sizeof(entry))
+            goto invalid;
+        memcpy(&entry, cache.start, sizeof(entry));
+        cache = bstr_cut(cache, sizeof(entry));
+
+        struct vk_fmt_props props = {
+            .format = entry.format,
+            .props = entry.props,
+            .num_mods = entry.num_mods,
+        };
+
+        if (entry.num_mods > 0) {
+            size_t mods_size = entry.num_mods * sizeof(uint64_t);
+            if (cache.len < mods_size)
+                goto invalid;
+            props.mods = talloc_memdup(gpu, cache.start, mods_size);
+            cache = bstr_cut(cache, mods_size);
+        }
+
+        TARRAY_APPEND(gpu, p->fmt_props, p->num_fmt_props, props);
+    }
+
+    PL_DEBUG(gpu, "Loaded %d format properties from cache", p->num_fmt_props);
+    return;
+
+invalid:
+    PL_WARN(gpu, "Format cache is corrupt, ignoring");
+    p->num_fmt_props = 0;
+}
+
+static struct vk_fmt_props *vk_get_fmt_props(struct pl_gpu *gpu, VkFormat format)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    for (int i = 0; i < p->num_fmt_props; i++) {
+        if (p->fmt_props[i].format == format)
+            return &p->fmt_props[i];
+    }
+
+    struct vk_fmt_props props = {
+        .format = format,
+        .num_mods = -1,
+    };
+
+    vk->GetPhysicalDeviceFormatProperties(vk->physd, format, &props.props);
+    TARRAY_APPEND(gpu, p->fmt_props, p->num_fmt_props, props);
+    p->num_fmt_queries++;
+    return &p->fmt_props[p->num_fmt_props - 1];
+}
+
+size_t pl_vulkan_save_format_cache(const struct pl_gpu *gpu, uint8_t *out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+
+    struct vk_fmt_cache_header header = vk_fmt_cache_header(p->vk);
+    header.num_entries = p->num_fmt_props;
+
+    size_t size = 0;
+#define WRITE(ptr, len)                         \
+    do {                                        \
+        if (out)                                \
+            memcpy(out + size, (ptr), (len));   \
+        size += (len);                          \
+    } while (0)
+
+    WRITE(&header, sizeof(header));
+    for (int i = 0; i < p->num_fmt_props; i++) {
+        const struct vk_fmt_props *props = &p->fmt_props[i];
+        struct vk_fmt_cache_entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.format = props->format;
+        entry.props = props->props;
+        entry.num_mods = props->num_mods;
+        WRITE(&entry, sizeof(entry));
+        if (props->num_mods > 0)
+            WRITE(props->mods, props->num_mods * sizeof(uint64_t));
+    }
+#undef WRITE
+
+    return size;
+}
+
+// Query the list of DRM format modifiers usable for sampling from imported
+// PL_HANDLE_DMA_BUF textures of this format
+static void vk_setup_modifiers(struct pl_gpu *gpu, struct pl_fmt *fmt,
+                               const struct vk_format *vk_fmt)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    struct vk_fmt_props *props = vk_get_fmt_props(gpu, vk_fmt->tfmt);
+    if (props->num_mods >= 0)
+        goto done;
+
+    VkDrmFormatModifierPropertiesListEXT modlist = {
+        .sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT,
+    };
+
+    VkFormatProperties2KHR prop2 = {
+        .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2_KHR,
+        .pNext = &modlist,
+    };
+
+    props->num_mods = 0;
+    vk->GetPhysicalDeviceFormatProperties2KHR(vk->physd, vk_fmt->tfmt, &prop2);
+    if (!modlist.drmFormatModifierCount)
+        goto done;
+
+    void *tmp = talloc_new(NULL);
+    modlist.pDrmFormatModifierProperties = talloc_array(tmp,
+            VkDrmFormatModifierPropertiesEXT, modlist.drmFormatModifierCount);
+    vk->GetPhysicalDeviceFormatProperties2KHR(vk->physd, vk_fmt->tfmt, &prop2);
+
+    props->mods = talloc_array(gpu, uint64_t, modlist.drmFormatModifierCount);
+    for (int i = 0; i < modlist.drmFormatModifierCount; i++) {
+        const VkDrmFormatModifierPropertiesEXT *mod;
+        mod = &modlist.pDrmFormatModifierProperties[i];
+        if (mod->drmFormatModifierPlaneCount != 1)
+            continue;
+        if (!(mod->drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+            continue;
+        props->mods[props->num_mods++] = mod->drmFormatModifier;
+    }
+
+    talloc_free(tmp);
+
+done:
+    fmt->modifiers = props->mods;
+    fmt->num_modifiers = props->num_mods;
+}
+
 static void vk_setup_formats(struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
@@ -153,6 +564,9 @@ static void vk_setup_formats(struct pl_gpu *gpu)
     // Texture format emulation requires at least support for texel buffers
     bool has_emu = (gpu->caps & PL_GPU_CAP_COMPUTE) && gpu->limits.max_buffer_texels;
 
+    uint64_t start = pl_clock_ns();
+    vk_load_fmt_cache(gpu);
+
     for (const struct vk_format *pvk_fmt = vk_formats; pvk_fmt->tfmt; pvk_fmt++) {
         const struct vk_format *vk_fmt = pvk_fmt;
 
@@ -160,14 +574,13 @@ static void vk_setup_formats(struct pl_gpu *gpu)
         if (vk_fmt->fmt.emulated && !has_emu)
             continue;
 
-        VkFormatProperties prop = {0};
-        vk->GetPhysicalDeviceFormatProperties(vk->physd, vk_fmt->tfmt, &prop);
+        VkFormatProperties prop = vk_get_fmt_props(gpu, vk_fmt->tfmt)->props;
 
         // If wholly unsupported, try falling back to the emulation formats
         // for texture operations
         while (has_emu && !prop.optimalTilingFeatures && vk_fmt->emufmt) {
             vk_fmt = vk_fmt->emufmt;
-            vk->GetPhysicalDeviceFormatProperties(vk->physd, vk_fmt->tfmt, &prop);
+            prop = vk_get_fmt_props(gpu, vk_fmt->tfmt)->props;
         }
 
         VkFormatFeatureFlags texflags = prop.optimalTilingFeatures;
@@ -177,7 +590,7 @@ static void vk_setup_formats(struct pl_gpu *gpu)
             // than their texture representation. If they don't, assume their
             // buffer representation is nonsensical (e.g. r16f)
             if (vk_fmt->bfmt) {
-                vk->GetPhysicalDeviceFormatProperties(vk->physd, vk_fmt->bfmt, &prop);
+                prop = vk_get_fmt_props(gpu, vk_fmt->bfmt)->props;
                 bufflags = prop.bufferFeatures;
             } else {
                 bufflags = 0;
@@ -255,11 +668,19 @@ static void vk_setup_formats(struct pl_gpu *gpu)
             }
         }
 
+        fmt->fourcc = pl_fmt_fourcc(fmt);
+        if (fmt->fourcc && vk->GetImageDrmFormatModifierPropertiesEXT)
+            vk_setup_modifiers(gpu, fmt, vk_fmt);
+
         TARRAY_APPEND(gpu, gpu->formats, gpu->num_formats, fmt);
     }
 
     pl_gpu_sort_formats(gpu);
     pl_gpu_verify_formats(gpu);
+
+    PL_DEBUG(gpu, "Format setup took %.2f ms (%d properties cached, %d queried)",
+             (pl_clock_ns() - start) * 1e-6,
+             p->num_fmt_props - p->num_fmt_queries, p->num_fmt_queries);
 }
 
 static pl_handle_caps vk_sync_handle_caps(struct vk_ctx *vk)
@@ -353,11 +774,17 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
     p->impl = pl_fns_vk;
     p->vk = vk;
 
-    p->spirv = spirv_compiler_create(vk->ctx, vk->api_ver);
+    p->spirv = spirv_compiler_create(vk->ctx, vk->api_ver, vk->spirv_opt);
     p->alloc = vk_malloc_create(vk);
     if (!p->alloc || !p->spirv)
         goto error;
 
+    VkPipelineCacheCreateInfo pcinfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+
+    VK(vk->CreatePipelineCache(vk->dev, &pcinfo, VK_ALLOC, &p->pipecache));
+
     gpu->glsl = p->spirv->glsl;
     gpu->limits = (struct pl_gpu_limits) {
         .max_tex_1d_dim    = vk->limits.maxImageDimension1D,
@@ -370,6 +797,8 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         .max_buffer_texels = vk->limits.maxTexelBufferElements,
         .min_gather_offset = vk->limits.minTexelGatherOffset,
         .max_gather_offset = vk->limits.maxTexelGatherOffset,
+        .align_ubo_offset  = vk->limits.minUniformBufferOffsetAlignment,
+        .max_constants     = INT_MAX, // no limit imposed by vulkan
         .align_tex_xfer_stride = vk->limits.optimalBufferCopyRowPitchAlignment,
         .align_tex_xfer_offset = pl_lcm(vk->limits.optimalBufferCopyOffsetAlignment, 4),
     };
@@ -429,10 +858,20 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
             p->host_query_reset = host_query_reset->hostQueryReset;
     }
 
+    const VkPhysicalDeviceShaderFloat16Int8FeaturesKHR *shader_float16;
+    shader_float16 = vk_find_struct(&vk->features,
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR);
+    if (shader_float16)
+        gpu->glsl.float16 = shader_float16->shaderFloat16;
+
     // We ostensibly support this, although it can still fail on buffer
     // creation (for certain combinations of buffers)
     gpu->caps |= PL_GPU_CAP_MAPPED_BUFFERS;
 
+    // All entry points are serialized by `vk->lock`, while commands are
+    // recorded separately per thread (see `vk_rec`)
+    gpu->caps |= PL_GPU_CAP_THREAD_SAFE;
+
     if (vk->pool_compute) {
         gpu->caps |= PL_GPU_CAP_COMPUTE;
         gpu->limits.max_shmem_size = vk->limits.maxComputeSharedMemorySize;
@@ -446,6 +885,27 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
         // want to be using them. (This seems mostly relevant for AMD)
         if (vk->pool_compute->num_queues > vk->pool_graphics->num_queues)
             gpu->caps |= PL_GPU_CAP_PARALLEL_COMPUTE;
+
+        // Subgroup operations are core in vulkan 1.1
+        if (vk->api_ver >= VK_API_VERSION_1_1) {
+            VkPhysicalDeviceSubgroupProperties subgroup = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+            };
+
+            VkPhysicalDeviceProperties2KHR props = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+                .pNext = &subgroup,
+            };
+
+            vk->GetPhysicalDeviceProperties2KHR(vk->physd, &props);
+            const VkSubgroupFeatureFlags ops = VK_SUBGROUP_FEATURE_BASIC_BIT |
+                                               VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+            if ((subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                (subgroup.supportedOperations & ops) == ops)
+            {
+                gpu->glsl.subgroup_size = subgroup.subgroupSize;
+            }
+        }
     }
 
     if (!vk->features.features.shaderImageGatherExtended) {
@@ -463,8 +923,6 @@ const struct pl_gpu *pl_gpu_create_vk(struct vk_ctx *vk)
     }
     PL_DEBUG(gpu, "Minimum texel alignment: %zu", p->min_texel_alignment);
 
-    // Create the dispatch last, after any setup of `gpu` is done
-    p->dp = pl_dispatch_create(vk->ctx, gpu);
     pl_gpu_print_info(gpu, PL_LOG_INFO);
     pl_gpu_print_formats(gpu, PL_LOG_DEBUG);
     return gpu;
@@ -516,6 +974,15 @@ static void vk_cmd_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
 static void vk_cmd_timer_end(const struct pl_gpu *gpu, struct vk_cmd *cmd,
                              struct pl_timer *timer);
 
+// Tracks which stages and accesses the most recent write to a resource has
+// been made visible to, in order to decide whether later reads can skip their
+// barriers
+struct vk_vis {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    bool write_pending; // may have been written since the last barrier
+};
+
 // For pl_tex.priv
 struct pl_tex_vk {
     bool held;
@@ -533,9 +1000,6 @@ struct pl_tex_vk {
     VkSampler sampler;
     // for rendering
     VkFramebuffer framebuffer;
-    // for transfers
-    struct pl_buf_pool pbo_write;
-    struct pl_buf_pool pbo_read;
     // for vk_tex_upload/download fallback code
     const struct pl_fmt *texel_fmt;
     struct pl_buf_pool tmp_write;
@@ -546,6 +1010,8 @@ struct pl_tex_vk {
     // the signal guards reuse, and can be NULL
     struct vk_signal *sig;
     VkPipelineStageFlags sig_stage;
+    VkPipelineStageFlags read_stages; // skipped read-after-read barriers
+    struct vk_vis vis;
     VkSemaphore *ext_deps; // external semaphore, not owned by the pl_tex
     int num_ext_deps;
     const struct pl_sync *ext_sync; // indicates an exported image
@@ -559,10 +1025,118 @@ void pl_tex_vk_external_dep(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     TARRAY_APPEND((void *) tex, tex_vk->ext_deps, tex_vk->num_ext_deps, external_dep);
+    tex_vk->vis.write_pending = true; // external users may have written to it
 }
 
 static void vk_sync_deref(const struct pl_gpu *gpu, const struct pl_sync *sync);
 
+static void rec_flush_barriers(const struct pl_gpu *gpu, struct vk_rec *rec)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct vk_barrier_batch *b = &rec->barrier, *e = &rec->event_wait;
+
+    if (b->num_imgs || b->num_bufs) {
+        vk->CmdPipelineBarrier(b->cmd->buf, b->src_stages, b->dst_stages, 0,
+                               0, NULL, b->num_bufs, b->bufs,
+                               b->num_imgs, b->imgs);
+    }
+
+    if (e->num_events) {
+        vk->CmdWaitEvents(e->cmd->buf, e->num_events, e->events,
+                          e->src_stages, e->dst_stages, 0, NULL,
+                          e->num_bufs, e->bufs, e->num_imgs, e->imgs);
+    }
+
+    for (struct vk_barrier_batch *x = b; x; x = x == b ? e : NULL) {
+        x->cmd = NULL;
+        x->src_stages = x->dst_stages = 0;
+        x->num_events = x->num_imgs = x->num_bufs = 0;
+    }
+}
+
+static bool batch_conflicts(const struct vk_barrier_batch *batch,
+                            const VkImageMemoryBarrier *img,
+                            const VkBufferMemoryBarrier *buf)
+{
+    for (int i = 0; img && i < batch->num_imgs; i++) {
+        if (batch->imgs[i].image == img->image)
+            return true;
+    }
+
+    for (int i = 0; buf && i < batch->num_bufs; i++) {
+        const VkBufferMemoryBarrier *b = &batch->bufs[i];
+        if (b->buffer == buf->buffer && b->offset < buf->offset + buf->size &&
+            buf->offset < b->offset + b->size)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Adds a barrier (or event wait, if `event` is set) to the current batch
+static void queue_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
+                          VkEvent event, VkPipelineStageFlags src_stages,
+                          VkPipelineStageFlags dst_stages,
+                          const VkImageMemoryBarrier *img,
+                          const VkBufferMemoryBarrier *buf)
+{
+    struct vk_rec *rec = vk_rec(gpu);
+
+    // Multiple barriers affecting the same resource can't be combined, since
+    // their relative order matters
+    bool flush = (rec->barrier.cmd && rec->barrier.cmd != cmd) ||
+                 (rec->event_wait.cmd && rec->event_wait.cmd != cmd) ||
+                 batch_conflicts(&rec->barrier, img, buf) ||
+                 batch_conflicts(&rec->event_wait, img, buf);
+    if (flush)
+        rec_flush_barriers(gpu, rec);
+
+    struct vk_barrier_batch *batch = event ? &rec->event_wait : &rec->barrier;
+    batch->cmd = cmd;
+    batch->src_stages |= src_stages;
+    batch->dst_stages |= dst_stages;
+    if (event)
+        TARRAY_APPEND((void *) gpu, batch->events, batch->num_events, event);
+    if (img)
+        TARRAY_APPEND((void *) gpu, batch->imgs, batch->num_imgs, *img);
+    if (buf)
+        TARRAY_APPEND((void *) gpu, batch->bufs, batch->num_bufs, *buf);
+}
+
+static inline bool is_read_only(VkAccessFlags access)
+{
+    static const VkAccessFlags writes = VK_ACCESS_SHADER_WRITE_BIT |
+                                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_TRANSFER_WRITE_BIT |
+                                        VK_ACCESS_HOST_WRITE_BIT |
+                                        VK_ACCESS_MEMORY_WRITE_BIT;
+
+    return access && !(access & writes);
+}
+
+// Whether the last write was already made visible to `stage` and `access`
+static inline bool vis_covers(const struct vk_vis *vis,
+                              VkPipelineStageFlags stage, VkAccessFlags access)
+{
+    return !vis->write_pending && !(stage & ~vis->stages) &&
+           !(access & ~vis->access);
+}
+
+// Update `vis` after recording a barrier towards `stage` and `access`. If the
+// barrier synchronizes against a write, only its destination scope sees it.
+static inline void vis_barrier(struct vk_vis *vis, bool after_write,
+                               VkPipelineStageFlags stage, VkAccessFlags access)
+{
+    if (after_write)
+        vis->stages = vis->access = 0;
+    vis->stages |= stage;
+    vis->access |= access;
+}
+
 // Small helper to ease image barrier creation. if `discard` is set, the contents
 // of the image will be undefined after the barrier
 static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -574,6 +1148,7 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct vk_ctx *vk = p->vk;
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     pl_assert(!tex_vk->held);
+    vk_claim_obj(gpu, cmd, tex, &tex_vk->sig);
 
     for (int i = 0; i < tex_vk->num_ext_deps; i++)
         vk_cmd_dep(cmd, tex_vk->ext_deps[i], stage);
@@ -622,6 +1197,30 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
                       (imgBarrier.srcQueueFamilyIndex !=
                        imgBarrier.dstQueueFamilyIndex);
 
+    // Reads following other reads (in the same layout) don't need a barrier,
+    // provided the last write was already made visible to this stage and
+    // access. Instead, remember the stages of the previous reads, so that the
+    // next signal (and thus the next write) also synchronizes against them.
+    bool reading = is_read_only(newAccess);
+    bool same_qf = imgBarrier.srcQueueFamilyIndex == imgBarrier.dstQueueFamilyIndex;
+    bool rar = reading && same_qf && imgBarrier.oldLayout == newLayout &&
+               vis_covers(&tex_vk->vis, stage, newAccess);
+
+    if (type == VK_WAIT_NONE) {
+        tex_vk->read_stages = 0;
+    } else if (rar) {
+        tex_vk->read_stages |= tex_vk->sig_stage;
+    }
+
+    if (rar) {
+        tex_vk->current_access |= newAccess;
+        return;
+    }
+
+    // Reads the last write isn't visible to yet need a barrier, even if the
+    // access mask itself doesn't change
+    need_trans |= reading && !vis_covers(&tex_vk->vis, stage, newAccess);
+
     // Transitioning to VK_IMAGE_LAYOUT_UNDEFINED is a pseudo-operation
     // that for us means we don't need to perform the actual transition
     if (need_trans && newLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
@@ -630,22 +1229,30 @@ static void tex_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
             // No synchronization required, so we can safely transition out of
             // VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
             imgBarrier.srcAccessMask = 0;
-            vk->CmdPipelineBarrier(cmd->buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                   stage, 0, 0, NULL, 0, NULL, 1, &imgBarrier);
+            queue_barrier(gpu, cmd, NULL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          stage, &imgBarrier, NULL);
             break;
         case VK_WAIT_BARRIER:
             // Regular pipeline barrier is required
-            vk->CmdPipelineBarrier(cmd->buf, tex_vk->sig_stage, stage, 0, 0, NULL,
-                                   0, NULL, 1, &imgBarrier);
+            queue_barrier(gpu, cmd, NULL, tex_vk->sig_stage, stage,
+                          &imgBarrier, NULL);
             break;
         case VK_WAIT_EVENT:
             // We can/should use the VkEvent for synchronization
-            vk->CmdWaitEvents(cmd->buf, 1, &event, tex_vk->sig_stage,
-                              stage, 0, NULL, 0, NULL, 1, &imgBarrier);
+            queue_barrier(gpu, cmd, event, tex_vk->sig_stage, stage,
+                          &imgBarrier, NULL);
             break;
         }
+
+        // Layout and queue family transitions count as writes
+        bool after_write = tex_vk->vis.write_pending || !same_qf ||
+                           imgBarrier.oldLayout != newLayout;
+        vis_barrier(&tex_vk->vis, after_write, stage, newAccess);
+    } else if (newLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        tex_vk->vis = (struct vk_vis) {0}; // contents are discarded
     }
 
+    tex_vk->vis.write_pending = !reading;
     tex_vk->current_layout = newLayout;
     tex_vk->current_access = newAccess;
 }
@@ -658,6 +1265,10 @@ static void tex_signal(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct vk_ctx *vk = p->vk;
     pl_assert(!tex_vk->sig);
 
+    stage |= tex_vk->read_stages;
+    tex_vk->read_stages = 0;
+
+    vk_flush_barriers(gpu);
     tex_vk->sig = vk_cmd_signal(vk, cmd, stage);
     tex_vk->sig_stage = stage;
 }
@@ -673,8 +1284,6 @@ static void vk_tex_destroy(const struct pl_gpu *gpu, struct pl_tex *tex)
 
     pl_buf_pool_uninit(gpu, &tex_vk->tmp_write);
     pl_buf_pool_uninit(gpu, &tex_vk->tmp_read);
-    pl_buf_pool_uninit(gpu, &tex_vk->pbo_write);
-    pl_buf_pool_uninit(gpu, &tex_vk->pbo_read);
     vk_sync_deref(gpu, tex_vk->ext_sync);
     vk_signal_destroy(vk, &tex_vk->sig);
     vk->DestroyFramebuffer(vk->dev, tex_vk->framebuffer, VK_ALLOC);
@@ -884,6 +1493,15 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
         usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
 
+    // Transient images can only be backed by lazily allocated memory if they
+    // are used exclusively as attachments
+    bool lazy = params->transient && !handle_type &&
+                usage == VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT &&
+                vk_malloc_has_memtype(p->alloc, 0,
+                                      VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    if (lazy)
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
     // FIXME: Since we can't keep track of queue family ownership properly,
     // and we don't know in advance what types of queue families this image
     // will belong to, we're forced to share all of our images between all
@@ -892,8 +1510,29 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
     for (int i = 0; i < vk->num_pools; i++)
         qfs[i] = vk->pools[i]->qf;
 
+    // DMA-BUFs with an explicit DRM format modifier (e.g. frames exported by
+    // hardware decoders) need to be created with exactly the memory layout
+    // described by the exporter
+    const struct pl_shared_mem *shmem = &params->shared_mem;
+    bool drm_mod = params->import_handle == PL_HANDLE_DMA_BUF &&
+                   vk->GetImageDrmFormatModifierPropertiesEXT &&
+                   shmem->has_drm_format_mod &&
+                   shmem->drm_format_mod != PL_DRM_FORMAT_MOD_INVALID;
+
+    VkSubresourceLayout drm_layout = {
+        .rowPitch = PL_DEF(shmem->pitch, params->w * params->format->texel_size),
+    };
+
+    VkImageDrmFormatModifierExplicitCreateInfoEXT drm_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
+        .drmFormatModifier = shmem->drm_format_mod,
+        .drmFormatModifierPlaneCount = 1,
+        .pPlaneLayouts = &drm_layout,
+    };
+
     VkExternalMemoryImageCreateInfoKHR ext_info = {
         .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO_KHR,
+        .pNext = drm_mod ? &drm_info : NULL,
         .handleTypes = vk_mem_handle_type(handle_type),
     };
 
@@ -910,7 +1549,8 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .tiling = drm_mod ? VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT
+                          : VK_IMAGE_TILING_OPTIMAL,
         .usage = usage,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .sharingMode = vk->num_pools > 1 ? VK_SHARING_MODE_CONCURRENT
@@ -920,8 +1560,17 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
     };
 
     // Double-check physical image format limits and fail if invalid
+    VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_pinfo = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+        .drmFormatModifier = drm_info.drmFormatModifier,
+        .sharingMode = iinfo.sharingMode,
+        .queueFamilyIndexCount = iinfo.queueFamilyIndexCount,
+        .pQueueFamilyIndices = qfs,
+    };
+
     VkPhysicalDeviceExternalImageFormatInfoKHR ext_pinfo = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR,
+        .pNext = drm_mod ? &drm_pinfo : NULL,
         .handleType = ext_info.handleTypes,
     };
 
@@ -947,6 +1596,11 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
     VkResult res;
     res = vk->GetPhysicalDeviceImageFormatProperties2KHR(vk->physd, &pinfo, &props);
     if (res == VK_ERROR_FORMAT_NOT_SUPPORTED) {
+        if (drm_mod) {
+            PL_ERR(gpu, "DRM format modifier 0x%"PRIx64" is not supported for "
+                   "texture format '%s'!", shmem->drm_format_mod,
+                   params->format->name);
+        }
         goto error;
     } else {
         VK_ASSERT(res, "Querying image format properties");
@@ -981,10 +1635,19 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
     VkMemoryRequirements reqs = {0};
     vk->GetImageMemoryRequirements(vk->dev, tex_vk->img, &reqs);
 
+    if (lazy) {
+        VkMemoryPropertyFlags lazyFlags =
+            memFlags | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        if (vk_malloc_has_memtype(p->alloc, reqs.memoryTypeBits, lazyFlags)) {
+            PL_DEBUG(gpu, "Using lazily allocated memory for transient image");
+            memFlags = lazyFlags;
+        }
+    }
+
     struct vk_memslice *mem = &tex_vk->mem;
     if (params->import_handle) {
         if (!vk_malloc_import(p->alloc, params->import_handle,
-                              &params->shared_mem, mem))
+                              &params->shared_mem, tex_vk->img, mem))
         {
             goto error;
         }
@@ -996,7 +1659,8 @@ static const struct pl_tex *vk_tex_create(const struct pl_gpu *gpu,
         // positives.
         vk->ctx->suppress_errors_for_object = (uint64_t)tex_vk->img;
     } else {
-        if (!vk_malloc_generic(p->alloc, reqs, memFlags, params->export_handle, mem))
+        if (!vk_malloc_image(p->alloc, tex_vk->img, memFlags,
+                             params->export_handle, mem))
             goto error;
     }
     VK(vk->BindImageMemory(vk->dev, tex_vk->img, mem->vkmem, mem->offset));
@@ -1072,6 +1736,7 @@ static void vk_tex_clear(const struct pl_gpu *gpu, const struct pl_tex *tex,
         .layerCount = 1,
     };
 
+    vk_flush_barriers(gpu);
     vk->CmdClearColorImage(cmd->buf, tex_vk->img, tex_vk->current_layout,
                            &clearColor, 1, &range);
 
@@ -1128,6 +1793,7 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
             },
         };
 
+        vk_flush_barriers(gpu);
         vk->CmdCopyImage(cmd->buf, src_vk->img, src_vk->current_layout,
                          dst_vk->img, dst_vk->current_layout, 1, &region);
     } else {
@@ -1140,6 +1806,7 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
                            {dst_rc.x1, dst_rc.y1, dst_rc.z1}},
         };
 
+        vk_flush_barriers(gpu);
         vk->CmdBlitImage(cmd->buf, src_vk->img, src_vk->current_layout,
                          dst_vk->img, dst_vk->current_layout, 1, &region,
                          filters[src->params.sample_mode]);
@@ -1151,7 +1818,7 @@ static void vk_tex_blit(const struct pl_gpu *gpu,
     CMD_MARK_END(cmd);
 }
 
-const struct pl_tex *pl_vulkan_wrap(const struct pl_gpu *gpu,
+static const struct pl_tex *vk_wrap(const struct pl_gpu *gpu,
                                     const struct pl_vulkan_wrap_params *params)
 {
     struct pl_tex *tex = NULL;
@@ -1214,6 +1881,16 @@ error:
     return NULL;
 }
 
+const struct pl_tex *pl_vulkan_wrap(const struct pl_gpu *gpu,
+                                    const struct pl_vulkan_wrap_params *params)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    const struct pl_tex *tex = vk_wrap(gpu, params);
+    vk_unlock(p->vk);
+    return tex;
+}
+
 VkImage pl_vulkan_unwrap(const struct pl_gpu *gpu, const struct pl_tex *tex,
                          VkFormat *out_format, VkImageUsageFlags *out_flags)
 {
@@ -1227,7 +1904,7 @@ VkImage pl_vulkan_unwrap(const struct pl_gpu *gpu, const struct pl_tex *tex,
     return tex_vk->img;
 }
 
-bool pl_vulkan_hold(const struct pl_gpu *gpu, const struct pl_tex *tex,
+static bool vk_hold(const struct pl_gpu *gpu, const struct pl_tex *tex,
                     VkImageLayout layout, VkAccessFlags access,
                     VkSemaphore sem_out)
 {
@@ -1256,9 +1933,103 @@ bool pl_vulkan_hold(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
     CMD_MARK_END(cmd);
 
-    vk_submit(gpu);
-    tex_vk->held = vk_flush_commands(vk);
-    return tex_vk->held;
+    vk_submit(gpu);
+    tex_vk->held = vk_flush_commands(vk);
+    return tex_vk->held;
+}
+
+void pl_vulkan_mem_stats(const struct pl_gpu *gpu,
+                         struct pl_vulkan_mem_stats *out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    vk_malloc_mem_stats(p->alloc, out);
+    vk_unlock(p->vk);
+}
+
+void pl_vulkan_submit_stats(const struct pl_gpu *gpu,
+                            struct pl_vulkan_submit_stats *out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    *out = p->vk->submit_stats;
+    vk_unlock(p->vk);
+}
+
+static uint64_t vk_gpu_submits(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    uint64_t submits = p->vk->submit_stats.total_submits;
+    vk_unlock(p->vk);
+    return submits;
+}
+
+size_t pl_vulkan_save_pipeline_cache(const struct pl_gpu *gpu, uint8_t *out,
+                                     size_t size)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+
+    vk_lock(vk);
+    VkResult res = vk->GetPipelineCacheData(vk->dev, p->pipecache, &size, out);
+    vk_unlock(vk);
+
+    if (res != VK_SUCCESS && res != VK_INCOMPLETE) {
+        PL_ERR(vk, "Failed retrieving pipeline cache data: %s", vk_res_str(res));
+        return 0;
+    }
+
+    return size;
+}
+
+void pl_vulkan_load_pipeline_cache(const struct pl_gpu *gpu,
+                                   const uint8_t *cache, size_t size)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    VkPipelineCache tmp = VK_NULL_HANDLE;
+
+    // Incompatible data (e.g. from a different driver) is simply ignored by
+    // vkCreatePipelineCache, so this can't fail due to a stale cache
+    VkPipelineCacheCreateInfo pcinfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pInitialData = cache,
+        .initialDataSize = size,
+    };
+
+    vk_lock(vk);
+    VK(vk->CreatePipelineCache(vk->dev, &pcinfo, VK_ALLOC, &tmp));
+    VK(vk->MergePipelineCaches(vk->dev, p->pipecache, 1, &tmp));
+    PL_DEBUG(vk, "Loaded %zu bytes of pipeline cache data", size);
+
+error:
+    vk->DestroyPipelineCache(vk->dev, tmp, VK_ALLOC);
+    vk_unlock(vk);
+}
+
+size_t pl_vulkan_trim(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+
+    // Make sure any pending frees actually get processed first
+    vk_poll_commands(p->vk, 0);
+    size_t freed = vk_malloc_trim(p->alloc);
+
+    vk_unlock(p->vk);
+    return freed;
+}
+
+bool pl_vulkan_hold(const struct pl_gpu *gpu, const struct pl_tex *tex,
+                    VkImageLayout layout, VkAccessFlags access,
+                    VkSemaphore sem_out)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    bool ok = vk_hold(gpu, tex, layout, access, sem_out);
+    vk_unlock(p->vk);
+    return ok;
 }
 
 bool pl_vulkan_hold_raw(const struct pl_gpu *gpu, const struct pl_tex *tex,
@@ -1296,12 +2067,14 @@ void pl_vulkan_release(const struct pl_gpu *gpu, const struct pl_tex *tex,
 
     tex_vk->current_layout = layout;
     tex_vk->current_access = access;
+    tex_vk->vis.write_pending = true;
     tex_vk->held = false;
 }
 
 // For pl_buf.priv
 struct pl_buf_vk {
     struct vk_bufslice slice;
+    struct vk_obj obj;
     int refcount; // 1 = object allocated but not in use, > 1 = in use
     enum queue_type update_queue;
     VkBufferView view; // for texel buffers
@@ -1312,6 +2085,8 @@ struct pl_buf_vk {
     // the signal guards reuse, and can be NULL
     struct vk_signal *sig;
     VkPipelineStageFlags sig_stage;
+    VkPipelineStageFlags read_stages; // skipped read-after-read barriers
+    struct vk_vis vis;
 };
 
 #define PL_VK_BUF_VERTEX PL_BUF_PRIVATE
@@ -1342,6 +2117,7 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
     struct pl_buf_vk *buf_vk = TA_PRIV(buf);
+    vk_claim_obj(gpu, cmd, buf, &buf_vk->sig);
 
     // CONCURRENT buffers require transitioning to/from IGNORED, EXCLUSIVE
     // buffers require transitioning to/from the concrete QF index
@@ -1400,8 +2176,23 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         buf_vk->needs_flush = false;
     }
 
-    if (buffBarrier.srcAccessMask != buffBarrier.dstAccessMask ||
-        buffBarrier.srcQueueFamilyIndex != buffBarrier.dstQueueFamilyIndex)
+    // Skip read-after-read barriers, same as for textures. (Host writes are
+    // tracked by `src_stages` instead of `vis`)
+    bool reading = is_read_only(newAccess);
+    bool same_qf = buffBarrier.srcQueueFamilyIndex == buffBarrier.dstQueueFamilyIndex;
+    bool visible = vis_covers(&buf_vk->vis, stage, newAccess);
+    bool rar = reading && same_qf && !src_stages && visible;
+
+    if (type == VK_WAIT_NONE) {
+        buf_vk->read_stages = 0;
+    } else if (rar) {
+        buf_vk->read_stages |= buf_vk->sig_stage;
+    }
+
+    if (rar) {
+        newAccess |= buf_vk->current_access;
+    } else if (buffBarrier.srcAccessMask != buffBarrier.dstAccessMask ||
+               !same_qf || (reading && !visible))
     {
         switch (type) {
         case VK_WAIT_NONE:
@@ -1409,28 +2200,31 @@ static void buf_barrier(const struct pl_gpu *gpu, struct vk_cmd *cmd,
             // VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
             buffBarrier.srcAccessMask = 0;
             src_stages |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            vk->CmdPipelineBarrier(cmd->buf, src_stages, stage, 0, 0, NULL,
-                                   1, &buffBarrier, 0, NULL);
+            queue_barrier(gpu, cmd, NULL, src_stages, stage, NULL, &buffBarrier);
             break;
         case VK_WAIT_BARRIER:
             // Regular pipeline barrier is required
-            vk->CmdPipelineBarrier(cmd->buf, buf_vk->sig_stage | src_stages,
-                                   stage, 0, 0, NULL, 1, &buffBarrier, 0, NULL);
+            queue_barrier(gpu, cmd, NULL, buf_vk->sig_stage | src_stages, stage,
+                          NULL, &buffBarrier);
             break;
         case VK_WAIT_EVENT:
             // We can/should use the VkEvent for synchronization
             pl_assert(!src_stages);
-            vk->CmdWaitEvents(cmd->buf, 1, &event, buf_vk->sig_stage,
-                              stage, 0, NULL, 1, &buffBarrier, 0, NULL);
+            queue_barrier(gpu, cmd, event, buf_vk->sig_stage, stage,
+                          NULL, &buffBarrier);
             break;
         }
+
+        bool after_write = buf_vk->vis.write_pending || !same_qf || src_stages;
+        vis_barrier(&buf_vk->vis, after_write, stage, newAccess);
     }
 
+    buf_vk->vis.write_pending = !reading;
     buf_vk->current_access = newAccess;
     buf_vk->exported = export;
     buf_vk->refcount++;
     vk_cmd_callback(cmd, (vk_cb) vk_buf_deref, gpu, buf);
-    vk_cmd_obj(cmd, buf);
+    vk_cmd_obj(cmd, &buf_vk->obj);
 }
 
 static void buf_signal(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -1440,6 +2234,10 @@ static void buf_signal(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     struct pl_buf_vk *buf_vk = TA_PRIV(buf);
     pl_assert(!buf_vk->sig);
 
+    stage |= buf_vk->read_stages;
+    buf_vk->read_stages = 0;
+
+    vk_flush_barriers(gpu);
     buf_vk->sig = vk_cmd_signal(p->vk, cmd, stage);
     buf_vk->sig_stage = stage;
 }
@@ -1488,6 +2286,7 @@ static void buf_flush(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         .size = size,
     };
 
+    vk_flush_barriers(gpu);
     vk->CmdPipelineBarrier(cmd->buf, buf_vk->sig_stage,
                            VK_PIPELINE_STAGE_HOST_BIT, 0,
                            0, NULL, 1, &buffBarrier, 0, NULL);
@@ -1509,7 +2308,12 @@ static void vk_buf_write(const struct pl_gpu *gpu, const struct pl_buf *buf,
 
     // For host-mapped buffers, we can just directly memcpy the buffer contents.
     // Otherwise, we can update the buffer from the GPU using a command buffer.
-    if (buf_vk->slice.mem.data) {
+    // Buffers which are only mapped internally (see `vk_buf_create`) are
+    // written directly unless they are still in use by the GPU.
+    bool direct = buf_vk->slice.mem.data &&
+                  (buf->params.host_mapped || buf_vk->refcount == 1);
+
+    if (direct) {
         pl_assert(buf_vk->refcount == 1);
         uintptr_t addr = (uintptr_t) buf_vk->slice.mem.data + offset;
         memcpy((void *) addr, data, size);
@@ -1539,6 +2343,7 @@ static void vk_buf_write(const struct pl_gpu *gpu, const struct pl_buf *buf,
                      "instead!");
         }
 
+        vk_flush_barriers(gpu);
         for (size_t xfer = 0; xfer < size_base; xfer += max_transfer) {
             vk->CmdUpdateBuffer(cmd->buf, buf_vk->slice.buf,
                                 buf_offset + xfer,
@@ -1579,7 +2384,9 @@ static bool vk_buf_export(const struct pl_gpu *gpu, const struct pl_buf *buf)
     if (buf_vk->exported)
         return true;
 
-    struct vk_cmd *cmd = PL_DEF(p->cmd, vk_require_cmd(gpu, GRAPHICS));
+    struct vk_rec *rec = vk_rec(gpu);
+    rec_end_render_pass(gpu, rec);
+    struct vk_cmd *cmd = PL_DEF(rec->cmd, vk_require_cmd(gpu, GRAPHICS));
     if (!cmd) {
         PL_ERR(gpu, "Failed exporting buffer!");
         return false;
@@ -1631,7 +2438,10 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
         break;
     case PL_BUF_UNIFORM:
         bufFlags |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        mem_type = PL_BUF_MEM_DEVICE;
+        // Host-mapped uniform buffers are used for streaming small amounts
+        // of data every frame, so don't insist on device-local memory
+        if (!params->host_mapped)
+            mem_type = PL_BUF_MEM_DEVICE;
         align = pl_lcm(align, vk->limits.minUniformBufferOffsetAlignment);
         break;
     case PL_BUF_STORAGE:
@@ -1695,6 +2505,17 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
     default: break;
     }
 
+    // With resizable BAR, small to medium sized device-local buffers written
+    // by the host can be mapped directly, skipping the transfer commands
+    bool host_update = params->host_writable || params->initial_data;
+    if (mem_type == PL_BUF_MEM_DEVICE && host_update && !host_mapped &&
+        params->size <= 4 * 1024 * 1024 && !params->handle_type &&
+        !params->import_handle && vk_malloc_has_rebar(p->alloc))
+    {
+        memFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        host_mapped = true;
+    }
+
     if (host_mapped) {
         // Include any alignment restraints required for possibly
         // noncoherent, mapped memory
@@ -1703,9 +2524,16 @@ static const struct pl_buf *vk_buf_create(const struct pl_gpu *gpu,
         size = PL_ALIGN(size, vk->limits.nonCoherentAtomSize);
     }
 
-    if (!vk_malloc_buffer(p->alloc, bufFlags, memFlags, size, align,
-                          params->handle_type, &buf_vk->slice))
+    if (params->import_handle) {
+        pl_assert(params->import_handle == PL_HANDLE_HOST_PTR);
+        if (!vk_malloc_import_host(p->alloc, bufFlags, &params->shared_mem,
+                                   params->size, align, &buf_vk->slice))
+            goto error;
+    } else if (!vk_malloc_buffer(p->alloc, bufFlags, memFlags, size, align,
+                                 params->handle_type, &buf_vk->slice))
+    {
         goto error;
+    }
 
     if (params->host_mapped)
         buf->data = buf_vk->slice.mem.data;
@@ -1755,8 +2583,8 @@ static bool vk_buf_poll(const struct pl_gpu *gpu, const struct pl_buf *buf,
     // user is guaranteed to see progress eventually, even if they call
     // this in a tight loop
     vk_submit(gpu);
-    vk_flush_obj(vk, buf);
-    vk_poll_commands(vk, timeout);
+    vk_flush_obj(vk, &buf_vk->obj);
+    vk_wait_commands(vk, timeout);
 
     return buf_vk->refcount > 1;
 }
@@ -1821,7 +2649,7 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
 
     if (!params->buf)
-        return pl_tex_upload_pbo(gpu, &tex_vk->pbo_write, params);
+        return pl_tex_upload_pbo(gpu, &vk_rec(gpu)->pbo_write, params);
 
     pl_assert(params->buf);
     const struct pl_buf *buf = params->buf;
@@ -1870,6 +2698,7 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
                     false);
         buf_barrier(gpu, cmd, tbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT, 0, size, false);
+        vk_flush_barriers(gpu);
         vk->CmdCopyBuffer(cmd->buf, buf_vk->slice.buf, tbuf_vk->slice.buf,
                           1, &region);
 
@@ -1883,8 +2712,25 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
         fixed.buf = tbuf;
         fixed.buf_offset = 0;
 
-        return emulated ? pl_tex_upload_texel(gpu, p->dp, &fixed)
-                        : pl_tex_upload(gpu, &fixed);
+        if (!emulated)
+            return pl_tex_upload(gpu, &fixed);
+
+        fixed.callback = NULL;
+        if (!pl_tex_upload_texel(gpu, vk_dispatch(gpu), &fixed))
+            goto error;
+
+        // The compute pass uploading the data is recorded into the current
+        // command, so attach the callback to that
+        if (params->callback) {
+            struct vk_cmd *cur = vk_rec(gpu)->cmd;
+            if (cur) {
+                vk_cmd_callback(cur, (vk_cb) params->callback, params->priv, NULL);
+            } else {
+                vk_dev_callback(vk, (vk_cb) params->callback, params->priv, NULL);
+            }
+        }
+
+        return true;
 
     } else {
 
@@ -1914,10 +2760,13 @@ static bool vk_tex_upload(const struct pl_gpu *gpu,
         tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT,
                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false);
+        vk_flush_barriers(gpu);
         vk->CmdCopyBufferToImage(cmd->buf, buf_vk->slice.buf, tex_vk->img,
                                  tex_vk->current_layout, 1, &region);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        if (params->callback)
+            vk_cmd_callback(cmd, (vk_cb) params->callback, params->priv, NULL);
 
         vk_cmd_timer_end(gpu, cmd, params->timer);
         CMD_MARK_END(cmd);
@@ -1938,7 +2787,7 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
 
     if (!params->buf)
-        return pl_tex_download_pbo(gpu, &tex_vk->pbo_read, params);
+        return pl_tex_download_pbo(gpu, &vk_rec(gpu)->pbo_read, params);
 
     pl_assert(params->buf);
     const struct pl_buf *buf = params->buf;
@@ -1968,8 +2817,9 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
         struct pl_tex_transfer_params fixed = *params;
         fixed.buf = tbuf;
         fixed.buf_offset = 0;
+        fixed.callback = NULL; // fired after the final copy, below
 
-        bool ok = emulated ? pl_tex_download_texel(gpu, p->dp, &fixed)
+        bool ok = emulated ? pl_tex_download_texel(gpu, vk_dispatch(gpu), &fixed)
                            : pl_tex_download(gpu, &fixed);
         if (!ok)
             goto error;
@@ -1993,11 +2843,14 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
         buf_barrier(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_WRITE_BIT, params->buf_offset, size,
                     false);
+        vk_flush_barriers(gpu);
         vk->CmdCopyBuffer(cmd->buf, tbuf_vk->slice.buf, buf_vk->slice.buf,
                           1, &region);
         buf_signal(gpu, cmd, tbuf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_flush(gpu, cmd, buf, params->buf_offset, size);
+        if (params->callback)
+            vk_cmd_callback(cmd, (vk_cb) params->callback, params->priv, NULL);
 
         vk_cmd_timer_end(gpu, cmd, params->timer);
         CMD_MARK_END(cmd);
@@ -2030,11 +2883,14 @@ static bool vk_tex_download(const struct pl_gpu *gpu,
         tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_ACCESS_TRANSFER_READ_BIT,
                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false);
+        vk_flush_barriers(gpu);
         vk->CmdCopyImageToBuffer(cmd->buf, tex_vk->img, tex_vk->current_layout,
                                  buf_vk->slice.buf, 1, &region);
         buf_signal(gpu, cmd, buf, VK_PIPELINE_STAGE_TRANSFER_BIT);
         tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_TRANSFER_BIT);
         buf_flush(gpu, cmd, buf, params->buf_offset, size);
+        if (params->callback)
+            vk_cmd_callback(cmd, (vk_cb) params->callback, params->priv, NULL);
 
         vk_cmd_timer_end(gpu, cmd, params->timer);
         CMD_MARK_END(cmd);
@@ -2051,6 +2907,13 @@ static int vk_desc_namespace(const struct pl_gpu *gpu, enum pl_desc_type type)
     return 0;
 }
 
+// Host-side descriptor data, as consumed by the descriptor update template
+union vk_desc_data {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+    VkBufferView view;
+};
+
 // For pl_pass.priv
 struct pl_pass_vk {
     // Pipeline / render pass
@@ -2063,10 +2926,12 @@ struct pl_pass_vk {
     bool use_pushd;
     VkDescriptorSetLayout dsLayout;
     VkDescriptorPool dsPool;
+    VkDescriptorUpdateTemplateKHR dsTemplate; // may be NULL
     // To keep track of which descriptor sets are and aren't available, we
     // allocate a fixed number and use a bitmask of all available sets.
     VkDescriptorSet dss[16];
     uint16_t dmask;
+    struct vk_obj obj; // for waiting on descriptor sets
     // Vertex buffers (vertices)
     struct pl_buf_pool vbo;
     const struct pl_buf *cached_vert;
@@ -2075,8 +2940,7 @@ struct pl_pass_vk {
 
     // For updating
     VkWriteDescriptorSet *dswrite;
-    VkDescriptorImageInfo *dsiinfo;
-    VkDescriptorBufferInfo *dsbinfo;
+    union vk_desc_data *dsdata;
 };
 
 static void vk_pass_destroy(const struct pl_gpu *gpu, struct pl_pass *pass)
@@ -2091,6 +2955,10 @@ static void vk_pass_destroy(const struct pl_gpu *gpu, struct pl_pass *pass)
     vk->DestroyPipelineLayout(vk->dev, pass_vk->pipeLayout, VK_ALLOC);
     vk->DestroyDescriptorPool(vk->dev, pass_vk->dsPool, VK_ALLOC);
     vk->DestroyDescriptorSetLayout(vk->dev, pass_vk->dsLayout, VK_ALLOC);
+    if (pass_vk->dsTemplate) {
+        vk->DestroyDescriptorUpdateTemplateKHR(vk->dev, pass_vk->dsTemplate,
+                                               VK_ALLOC);
+    }
 
     talloc_free(pass);
 }
@@ -2118,7 +2986,7 @@ struct vk_cache_header {
     size_t vert_spirv_len;
     size_t frag_spirv_len;
     size_t comp_spirv_len;
-    size_t pipecache_len;
+    size_t pipecache_len; // only written by older versions
 };
 
 static bool vk_use_cached_program(const struct pl_pass_params *params,
@@ -2176,7 +3044,9 @@ static VkResult vk_compile_glsl(const struct pl_gpu *gpu, void *tactx,
     PL_DEBUG(gpu, "%s shader source:", shader_names[type]);
     pl_msg_source(gpu->ctx, PL_LOG_DEBUG, glsl);
 
-    if (!p->spirv->impl->compile_glsl(p->spirv, tactx, type, glsl, spirv)) {
+    bool ok = p->spirv->impl->compile_glsl(p->spirv, tactx, type, glsl, spirv);
+
+    if (!ok) {
         pl_msg_source(gpu->ctx, PL_LOG_ERR, glsl);
         return VK_ERROR_INITIALIZATION_FAILED;
     }
@@ -2189,6 +3059,11 @@ static const VkShaderStageFlags stageFlags[] = {
     [PL_PASS_COMPUTE] = VK_SHADER_STAGE_COMPUTE_BIT,
 };
 
+static const VkPipelineBindPoint bindPoint[] = {
+    [PL_PASS_RASTER]  = VK_PIPELINE_BIND_POINT_GRAPHICS,
+    [PL_PASS_COMPUTE] = VK_PIPELINE_BIND_POINT_COMPUTE,
+};
+
 static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
                                             const struct pl_pass_params *params)
 {
@@ -2201,6 +3076,7 @@ static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
 
     struct pl_pass_vk *pass_vk = TA_PRIV(pass);
     pass_vk->dmask = -1; // all descriptors available
+    bool locked = false;
 
     // temporary allocations
     void *tmp = talloc_new(NULL);
@@ -2210,17 +3086,45 @@ static const struct pl_pass *vk_pass_create(const struct pl_gpu *gpu,
     VkShaderModule frag_shader = VK_NULL_HANDLE;
     VkShaderModule comp_shader = VK_NULL_HANDLE;
 
+    // Compiling GLSL is by far the most expensive part of creating a pass, and
+    // doesn't touch any shared state, so do it before taking the lock to allow
+    // other threads to keep using the GPU in the meantime
+    struct bstr vert = {0}, frag = {0}, comp = {0}, pipecache = {0};
+    if (vk_use_cached_program(params, p->spirv, &vert, &frag, &comp, &pipecache)) {
+        PL_DEBUG(gpu, "Using cached SPIR-V and VkPipeline");
+    } else {
+        pipecache.len = 0;
+        switch (params->type) {
+        case PL_PASS_RASTER:
+            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_VERTEX,
+                               params->vertex_shader, &vert));
+            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_FRAGMENT,
+                               params->glsl_shader, &frag));
+            comp.len = 0;
+            break;
+        case PL_PASS_COMPUTE:
+            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_COMPUTE,
+                               params->glsl_shader, &comp));
+            frag.len = 0;
+            vert.len = 0;
+            break;
+        default: abort();
+        }
+    }
+
+    vk_lock(vk);
+    locked = true;
+
     int num_desc = params->num_descriptors;
     if (!num_desc)
         goto no_descriptors;
 
     pass_vk->dswrite = talloc_array(pass, VkWriteDescriptorSet, num_desc);
-    pass_vk->dsiinfo = talloc_array(pass, VkDescriptorImageInfo, num_desc);
-    pass_vk->dsbinfo = talloc_array(pass, VkDescriptorBufferInfo, num_desc);
+    pass_vk->dsdata = talloc_array(pass, union vk_desc_data, num_desc);
 
 #define NUM_DS (PL_ARRAY_SIZE(pass_vk->dss))
 
-    static int dsSize[PL_DESC_TYPE_COUNT] = {0};
+    int dsSize[PL_DESC_TYPE_COUNT] = {0};
     VkDescriptorSetLayoutBinding *bindings =
         talloc_array(tmp, VkDescriptorSetLayoutBinding, num_desc);
 
@@ -2311,41 +3215,81 @@ no_descriptors: ;
     VK(vk->CreatePipelineLayout(vk->dev, &linfo, VK_ALLOC,
                                 &pass_vk->pipeLayout));
 
-    struct bstr vert = {0}, frag = {0}, comp = {0}, pipecache = {0};
-    if (vk_use_cached_program(params, p->spirv, &vert, &frag, &comp, &pipecache)) {
-        PL_DEBUG(gpu, "Using cached SPIR-V and VkPipeline");
-    } else {
-        pipecache.len = 0;
-        switch (params->type) {
-        case PL_PASS_RASTER:
-            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_VERTEX,
-                               params->vertex_shader, &vert));
-            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_FRAGMENT,
-                               params->glsl_shader, &frag));
-            comp.len = 0;
-            break;
-        case PL_PASS_COMPUTE:
-            VK(vk_compile_glsl(gpu, tmp, GLSL_SHADER_COMPUTE,
-                               params->glsl_shader, &comp));
-            frag.len = 0;
-            vert.len = 0;
-            break;
-        default: abort();
+    // If possible, use a descriptor update template, which lets us update
+    // (or push) all descriptors with a single call per pass
+    bool can_template = vk->CreateDescriptorUpdateTemplateKHR;
+    if (pass_vk->use_pushd && !vk->CmdPushDescriptorSetWithTemplateKHR)
+        can_template = false;
+
+    if (num_desc && can_template) {
+        VkDescriptorUpdateTemplateEntryKHR *entries =
+            talloc_array(tmp, VkDescriptorUpdateTemplateEntryKHR, num_desc);
+
+        for (int i = 0; i < num_desc; i++) {
+            const struct pl_desc *desc = &params->descriptors[i];
+            entries[i] = (VkDescriptorUpdateTemplateEntryKHR) {
+                .dstBinding = desc->binding,
+                .descriptorCount = 1,
+                .descriptorType = dsType[desc->type],
+                .offset = i * sizeof(union vk_desc_data),
+                .stride = sizeof(union vk_desc_data),
+            };
         }
+
+        VkDescriptorUpdateTemplateCreateInfoKHR tinfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR,
+            .descriptorUpdateEntryCount = num_desc,
+            .pDescriptorUpdateEntries = entries,
+            .templateType = pass_vk->use_pushd
+                ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR
+                : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR,
+            .descriptorSetLayout = pass_vk->dsLayout,
+            .pipelineBindPoint = bindPoint[params->type],
+            .pipelineLayout = pass_vk->pipeLayout,
+            .set = 0,
+        };
+
+        VK(vk->CreateDescriptorUpdateTemplateKHR(vk->dev, &tinfo, VK_ALLOC,
+                                                 &pass_vk->dsTemplate));
     }
 
-    VkPipelineCacheCreateInfo pcinfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
-        .pInitialData = pipecache.start,
-        .initialDataSize = pipecache.len,
-    };
+    // Pipelines are created against the shared pipeline cache, so per-pass
+    // pipeline cache data (as written by older versions) is merged into it
+    if (pipecache.len) {
+        VkPipelineCacheCreateInfo pcinfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pInitialData = pipecache.start,
+            .initialDataSize = pipecache.len,
+        };
 
-    VK(vk->CreatePipelineCache(vk->dev, &pcinfo, VK_ALLOC, &pipeCache));
+        VK(vk->CreatePipelineCache(vk->dev, &pcinfo, VK_ALLOC, &pipeCache));
+        VK(vk->MergePipelineCaches(vk->dev, p->pipecache, 1, &pipeCache));
+    }
 
     VkShaderModuleCreateInfo sinfo = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
     };
 
+    // Specialization constants are only used by the main shader stage
+    VkSpecializationMapEntry *specEntries =
+        talloc_array(tmp, VkSpecializationMapEntry, params->num_constants);
+    VkSpecializationInfo specInfo = {
+        .mapEntryCount = params->num_constants,
+        .pMapEntries = specEntries,
+        .pData = params->constant_data,
+    };
+
+    for (int i = 0; i < params->num_constants; i++) {
+        const struct pl_constant *con = &params->constants[i];
+        size_t size = pl_var_type_size(con->type);
+        specEntries[i] = (VkSpecializationMapEntry) {
+            .constantID = con->id,
+            .offset = con->offset,
+            .size = size,
+        };
+        specInfo.dataSize = PL_MAX(specInfo.dataSize, con->offset + size);
+    }
+
     switch (params->type) {
     case PL_PASS_RASTER: {
         sinfo.pCode = (uint32_t *) vert.start;
@@ -2454,6 +3398,7 @@ no_descriptors: ;
                     .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                     .module = frag_shader,
                     .pName = "main",
+                    .pSpecializationInfo = &specInfo,
                 }
             },
             .pVertexInputState = &(VkPipelineVertexInputStateCreateInfo) {
@@ -2503,7 +3448,7 @@ no_descriptors: ;
             .renderPass = pass_vk->renderPass,
         };
 
-        VK(vk->CreateGraphicsPipelines(vk->dev, pipeCache, 1, &cinfo,
+        VK(vk->CreateGraphicsPipelines(vk->dev, p->pipecache, 1, &cinfo,
                                        VK_ALLOC, &pass_vk->pipe));
         break;
     }
@@ -2520,23 +3465,20 @@ no_descriptors: ;
                 .stage = VK_SHADER_STAGE_COMPUTE_BIT,
                 .module = comp_shader,
                 .pName = "main",
+                .pSpecializationInfo = &specInfo,
             },
             .layout = pass_vk->pipeLayout,
         };
 
-        VK(vk->CreateComputePipelines(vk->dev, pipeCache, 1, &cinfo,
+        VK(vk->CreateComputePipelines(vk->dev, p->pipecache, 1, &cinfo,
                                       VK_ALLOC, &pass_vk->pipe));
         break;
     }
     default: abort();
     }
 
-    // Update params->cached_program
-    struct bstr cache = {0};
-    VK(vk->GetPipelineCacheData(vk->dev, pipeCache, &cache.len, NULL));
-    cache.start = talloc_size(tmp, cache.len);
-    VK(vk->GetPipelineCacheData(vk->dev, pipeCache, &cache.len, cache.start));
-
+    // Update params->cached_program. The compiled pipelines themselves end
+    // up in the shared pipeline cache, so only the SPIR-V is stored here
     struct vk_cache_header header = {
         .magic = VK_CACHE_MAGIC,
         .cache_version = VK_CACHE_VERSION,
@@ -2544,11 +3486,10 @@ no_descriptors: ;
         .vert_spirv_len = vert.len,
         .frag_spirv_len = frag.len,
         .comp_spirv_len = comp.len,
-        .pipecache_len = cache.len,
     };
 
-    PL_DEBUG(vk, "Pass statistics: size %zu, SPIR-V: vert %zu frag %zu comp %zu",
-             cache.len, vert.len, frag.len, comp.len);
+    PL_DEBUG(vk, "Pass statistics: SPIR-V: vert %zu frag %zu comp %zu",
+             vert.len, frag.len, comp.len);
 
     for (int i = 0; i < sizeof(p->spirv->name); i++)
         header.compiler[i] = p->spirv->name[i];
@@ -2558,7 +3499,6 @@ no_descriptors: ;
     bstr_xappend(pass, &prog, vert);
     bstr_xappend(pass, &prog, frag);
     bstr_xappend(pass, &prog, comp);
-    bstr_xappend(pass, &prog, cache);
     pass->params.cached_program = prog.start;
     pass->params.cached_program_len = prog.len;
 
@@ -2577,6 +3517,8 @@ error:
     vk->DestroyShaderModule(vk->dev, comp_shader, VK_ALLOC);
     vk->DestroyPipelineCache(vk->dev, pipeCache, VK_ALLOC);
     talloc_free(tmp);
+    if (locked)
+        vk_unlock(vk);
     return pass;
 }
 
@@ -2621,7 +3563,7 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
                     VK_ACCESS_SHADER_READ_BIT,
                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false);
 
-        VkDescriptorImageInfo *iinfo = &pass_vk->dsiinfo[idx];
+        VkDescriptorImageInfo *iinfo = &pass_vk->dsdata[idx].image;
         *iinfo = (VkDescriptorImageInfo) {
             .sampler = tex_vk->sampler,
             .imageView = tex_vk->view,
@@ -2638,7 +3580,7 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         tex_barrier(gpu, cmd, tex, passStages[pass->params.type], access,
                     VK_IMAGE_LAYOUT_GENERAL, false);
 
-        VkDescriptorImageInfo *iinfo = &pass_vk->dsiinfo[idx];
+        VkDescriptorImageInfo *iinfo = &pass_vk->dsdata[idx].image;
         *iinfo = (VkDescriptorImageInfo) {
             .imageView = tex_vk->view,
             .imageLayout = tex_vk->current_layout,
@@ -2655,11 +3597,11 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         buf_barrier(gpu, cmd, buf, passStages[pass->params.type],
                     access, 0, buf->params.size, false);
 
-        VkDescriptorBufferInfo *binfo = &pass_vk->dsbinfo[idx];
+        VkDescriptorBufferInfo *binfo = &pass_vk->dsdata[idx].buffer;
         *binfo = (VkDescriptorBufferInfo) {
             .buffer = buf_vk->slice.buf,
-            .offset = buf_vk->slice.mem.offset,
-            .range = buf->params.size,
+            .offset = buf_vk->slice.mem.offset + db.offset,
+            .range = buf->params.size - db.offset,
         };
 
         wds->pBufferInfo = binfo;
@@ -2673,7 +3615,10 @@ static void vk_update_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         buf_barrier(gpu, cmd, buf, passStages[pass->params.type],
                     access, 0, buf->params.size, false);
 
-        wds->pTexelBufferView = &buf_vk->view;
+        VkBufferView *view = &pass_vk->dsdata[idx].view;
+        *view = buf_vk->view;
+
+        wds->pTexelBufferView = view;
         break;
     }
     default: abort();
@@ -2707,6 +3652,195 @@ static void vk_release_descriptor(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     }
 }
 
+static void vk_secondary_release(struct vk_rec *rec, VkCommandBuffer buf)
+{
+    TARRAY_APPEND(rec, rec->secondaries, rec->num_secondaries, buf);
+}
+
+// Returns a secondary command buffer recording draw commands for `pass`, or
+// NULL on error
+static VkCommandBuffer vk_begin_secondary(const struct pl_gpu *gpu,
+                                          const struct pl_pass *pass,
+                                          const struct pl_tex *target)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct pl_pass_vk *pass_vk = TA_PRIV(pass);
+    struct pl_tex_vk *tex_vk = TA_PRIV(target);
+    struct vk_rec *rec = vk_rec(gpu);
+
+    VkCommandBuffer buf = VK_NULL_HANDLE;
+    if (!TARRAY_POP(rec->secondaries, rec->num_secondaries, &buf)) {
+        struct vk_cmdthread *thread = vk_cmdpool_thread(vk, vk->pool_graphics);
+        if (!thread)
+            goto error;
+
+        VkCommandBufferAllocateInfo ainfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = thread->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+
+        VK(vk->AllocateCommandBuffers(vk->dev, &ainfo, &buf));
+    }
+
+    VkCommandBufferBeginInfo binfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &(VkCommandBufferInheritanceInfo) {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = pass_vk->renderPass,
+            .framebuffer = tex_vk->framebuffer,
+        },
+    };
+
+    VK(vk->BeginCommandBuffer(buf, &binfo));
+    return buf;
+
+error:
+    if (buf)
+        vk_secondary_release(rec, buf);
+    return VK_NULL_HANDLE;
+}
+
+// Executes all draws recorded into the deferred render pass (if any), and
+// signals all of the resources used by them
+static void rec_end_render_pass(const struct pl_gpu *gpu, struct vk_rec *rec)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct vk_rp *rp = &rec->rp;
+    if (!rp->target)
+        return;
+
+    struct vk_cmd *cmd = rec->cmd;
+    const struct pl_tex *tex = rp->target;
+    struct pl_tex_vk *tex_vk = TA_PRIV(tex);
+    struct pl_pass_vk *pass_vk = TA_PRIV(rp->pass);
+    pl_assert(cmd && rp->num_bufs);
+
+    VkRenderPassBeginInfo binfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = pass_vk->renderPass,
+        .framebuffer = tex_vk->framebuffer,
+        .renderArea = (VkRect2D){{0, 0}, {tex->params.w, tex->params.h}},
+    };
+
+    if (rp->num_bufs > 1)
+        PL_TRACE(gpu, "Merging %d raster passes into one render pass", rp->num_bufs);
+
+    CMD_MARK_BEGIN(cmd);
+    rec_flush_barriers(gpu, rec);
+    vk->CmdBeginRenderPass(cmd->buf, &binfo,
+                           VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vk->CmdExecuteCommands(cmd->buf, rp->num_bufs, rp->bufs);
+    vk->CmdEndRenderPass(cmd->buf);
+
+    for (int i = 0; i < rp->num_bufs; i++)
+        vk_cmd_callback(cmd, (vk_cb) vk_secondary_release, rec, rp->bufs[i]);
+
+    for (int i = 0; i < rp->num_verts; i++)
+        buf_signal(gpu, cmd, rp->verts[i], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+    // The renderPass implicitly transitions the texture to this layout
+    tex_vk->current_layout = pass_vk->finalLayout;
+    tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    for (int i = 0; i < rp->num_descs; i++) {
+        const struct vk_rp_desc *d = &rp->descs[i];
+        vk_release_descriptor(gpu, cmd, d->pass, d->db, d->idx);
+    }
+    CMD_MARK_END(cmd);
+
+    rp->target = NULL;
+    rp->pass = NULL;
+    rp->num_bufs = rp->num_verts = rp->num_descs = 0;
+}
+
+// Whether or not a raster pass can be recorded into the currently deferred
+// render pass. Since the barriers for all merged passes get recorded before
+// the render pass begins, this requires that none of them can affect the
+// draws already recorded. Resources shared with previous passes must only
+// ever be read from, in which case the barriers are no-ops.
+static bool vk_can_merge_pass(const struct pl_gpu *gpu,
+                              const struct pl_pass_run_params *params,
+                              const struct pl_buf *vert)
+{
+    struct vk_rec *rec = vk_rec(gpu);
+    const struct vk_rp *rp = &rec->rp;
+    const struct pl_pass *pass = params->pass;
+
+    if (!rp->target || rp->target != params->target || params->timer)
+        return false;
+    pl_assert(rec->cmd && pass->params.type == PL_PASS_RASTER);
+
+    for (int i = 0; i < rp->num_descs; i++) {
+        if (rp->descs[i].db.object == vert)
+            return false;
+    }
+
+    for (int i = 0; i < pass->params.num_descriptors; i++) {
+        const struct pl_desc *desc = &pass->params.descriptors[i];
+        const void *obj = params->desc_bindings[i].object;
+        if (obj == params->target)
+            return false;
+
+        for (int n = 0; n < rp->num_verts; n++) {
+            if (rp->verts[n] == obj)
+                return false;
+        }
+
+        for (int n = 0; n < rp->num_descs; n++) {
+            const struct vk_rp_desc *d = &rp->descs[n];
+            if (d->db.object != obj)
+                continue;
+
+            const struct pl_desc *prev = &d->pass->params.descriptors[d->idx];
+            if (prev->type != desc->type ||
+                prev->access != PL_DESC_ACCESS_READONLY ||
+                desc->access != PL_DESC_ACCESS_READONLY)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Records the resources used by a raster pass into the deferred render pass,
+// skipping duplicates (which are guaranteed to be used identically)
+static void vk_rp_add_resources(const struct pl_gpu *gpu,
+                                const struct pl_pass_run_params *params,
+                                const struct pl_buf *vert)
+{
+    struct vk_rec *rec = vk_rec(gpu);
+    struct vk_rp *rp = &rec->rp;
+    const struct pl_pass *pass = params->pass;
+
+    for (int i = 0; i < rp->num_verts; i++) {
+        if (rp->verts[i] == vert)
+            goto next_desc;
+    }
+
+    TARRAY_APPEND((void *) gpu, rp->verts, rp->num_verts, vert);
+
+next_desc: ;
+    for (int i = 0; i < pass->params.num_descriptors; i++) {
+        struct pl_desc_binding db = params->desc_bindings[i];
+        for (int n = 0; n < rp->num_descs; n++) {
+            if (rp->descs[n].db.object == db.object)
+                goto skip;
+        }
+
+        struct vk_rp_desc d = { .pass = pass, .db = db, .idx = i };
+        TARRAY_APPEND((void *) gpu, rp->descs, rp->num_descs, d);
+skip: ;
+    }
+}
+
 static void set_ds(struct pl_pass_vk *pass_vk, void *dsbit)
 {
     pass_vk->dmask |= (uintptr_t) dsbit;
@@ -2719,11 +3853,17 @@ static void vk_pass_run(const struct pl_gpu *gpu,
     struct vk_ctx *vk = p->vk;
     const struct pl_pass *pass = params->pass;
     struct pl_pass_vk *pass_vk = TA_PRIV(pass);
-
-    static const enum queue_type types[] = {
-        [PL_PASS_RASTER]  = GRAPHICS,
-        [PL_PASS_COMPUTE] = COMPUTE,
-    };
+    struct vk_rec *rec = vk_rec(gpu);
+
+    // Keep dependent compute passes on the graphics queue (if possible), to
+    // avoid bouncing between queues with a semaphore for every single pass.
+    // Only passes marked as independent get sent to the async compute queue
+    enum queue_type type = GRAPHICS;
+    if (pass->params.type == PL_PASS_COMPUTE) {
+        VkQueueFlags gfx_flags = vk->pool_graphics->props.queueFlags;
+        if (params->async || !(gfx_flags & VK_QUEUE_COMPUTE_BIT))
+            type = COMPUTE;
+    }
 
     // Update the vertex buffer before dispatching the pass, do this
     // before vk_require_cmd since it can trigger its own commands
@@ -2740,11 +3880,15 @@ static void vk_pass_run(const struct pl_gpu *gpu,
             // Invalidate existing cache
             pass_vk->cached_vert = NULL;
 
-            // Fetch new vertex buffer and update it
-            size_t vert_size = params->vertex_count * pass->params.vertex_stride;
-            vert = pl_buf_pool_get(gpu, &pass_vk->vbo, &(struct pl_buf_params) {
+            // Fetch new vertex buffer and update it. Small vertex buffers get
+            // cached per pass, while larger ones (e.g. many sub-rects drawn
+            // at once) are streamed through a pool shared by all passes, to
+            // avoid every pass holding on to its own set of large buffers
+            bool cacheable = size <= 128*1024; // 128 KiB
+            struct pl_buf_pool *pool = cacheable ? &pass_vk->vbo : &rec->vbo;
+            vert = pl_buf_pool_get(gpu, pool, &(struct pl_buf_params) {
                 .type = PL_VK_BUF_VERTEX,
-                .size = vert_size,
+                .size = size,
                 .host_writable = true,
             });
 
@@ -2753,10 +3897,10 @@ static void vk_pass_run(const struct pl_gpu *gpu,
                 goto error;
             }
 
-            vk_buf_write(gpu, vert, 0, params->vertex_data, vert_size);
+            vk_buf_write(gpu, vert, 0, params->vertex_data, size);
 
             // Update the cached information, for small vertex buffers
-            if (size <= 128*1024) { // 128 KiB
+            if (cacheable) {
                 pass_vk->cached_vert = vert;
                 pass_vk->cached_size = size;
                 pass_vk->cached_data =
@@ -2773,12 +3917,25 @@ static void vk_pass_run(const struct pl_gpu *gpu,
         // Wait for a free descriptor set
         while (!pass_vk->dmask) {
             PL_TRACE(gpu, "No free descriptor sets! ...blocking (slow path)");
-            vk_flush_obj(vk, pass);
+            vk_submit(gpu);
+            vk_flush_obj(vk, &pass_vk->obj);
             vk_poll_commands(vk, 10000000); // 10 ms
         }
     }
 
-    struct vk_cmd *cmd = vk_require_cmd(gpu, types[pass->params.type]);
+    bool merge = false;
+    struct vk_cmd *cmd;
+    if (pass->params.type == PL_PASS_RASTER && vk_can_merge_pass(gpu, params, vert)) {
+        // Keep recording into the currently deferred render pass
+        merge = true;
+        cmd = rec->cmd;
+    } else {
+        // Flush the work so far into its own command buffer, for better
+        // intra-frame granularity
+        vk_submit(gpu);
+        cmd = vk_require_cmd(gpu, type);
+    }
+
     if (!cmd)
         goto error;
 
@@ -2793,7 +3950,7 @@ static void vk_pass_run(const struct pl_gpu *gpu,
             if (pass_vk->dmask & dsbit) {
                 ds = pass_vk->dss[i];
                 pass_vk->dmask &= ~dsbit; // unset
-                vk_cmd_obj(cmd, pass);
+                vk_cmd_obj(cmd, &pass_vk->obj);
                 vk_cmd_callback(cmd, (vk_cb) set_ds, pass_vk,
                                 (void *)(uintptr_t) dsbit);
                 break;
@@ -2805,33 +3962,60 @@ static void vk_pass_run(const struct pl_gpu *gpu,
     for (int i = 0; i < pass->params.num_descriptors; i++)
         vk_update_descriptor(gpu, cmd, pass, params->desc_bindings[i], ds, i);
 
-    if (!pass_vk->use_pushd) {
+    if (ds && pass_vk->dsTemplate) {
+        vk->UpdateDescriptorSetWithTemplateKHR(vk->dev, ds, pass_vk->dsTemplate,
+                                               pass_vk->dsdata);
+    } else if (ds) {
         vk->UpdateDescriptorSets(vk->dev, pass->params.num_descriptors,
                                  pass_vk->dswrite, 0, NULL);
     }
 
-    // Bind the pipeline, descriptor set, etc.
-    static const VkPipelineBindPoint bindPoint[] = {
-        [PL_PASS_RASTER]  = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        [PL_PASS_COMPUTE] = VK_PIPELINE_BIND_POINT_COMPUTE,
-    };
+    // Raster passes record their draw commands into a secondary command
+    // buffer, so that the barriers for subsequent passes can still be
+    // recorded before the (deferred) render pass begins
+    VkCommandBuffer buf = cmd->buf;
+    if (pass->params.type == PL_PASS_RASTER) {
+        const struct pl_tex *tex = params->target;
+
+        buf_barrier(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, vert->params.size,
+                    false);
+
+        if (!merge) {
+            tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        pass_vk->initialLayout, false);
+        }
+
+        buf = vk_begin_secondary(gpu, pass, tex);
+        if (!buf) {
+            PL_ERR(gpu, "Failed allocating secondary command buffer!");
+            vk->failed = true;
+            goto error;
+        }
+    }
 
-    vk->CmdBindPipeline(cmd->buf, bindPoint[pass->params.type], pass_vk->pipe);
+    // Bind the pipeline, descriptor set, etc.
+    vk->CmdBindPipeline(buf, bindPoint[pass->params.type], pass_vk->pipe);
 
     if (ds) {
-        vk->CmdBindDescriptorSets(cmd->buf, bindPoint[pass->params.type],
+        vk->CmdBindDescriptorSets(buf, bindPoint[pass->params.type],
                                   pass_vk->pipeLayout, 0, 1, &ds, 0, NULL);
     }
 
-    if (pass_vk->use_pushd) {
-        vk->CmdPushDescriptorSetKHR(cmd->buf, bindPoint[pass->params.type],
+    if (pass_vk->use_pushd && pass_vk->dsTemplate) {
+        vk->CmdPushDescriptorSetWithTemplateKHR(buf, pass_vk->dsTemplate,
+                                                pass_vk->pipeLayout, 0,
+                                                pass_vk->dsdata);
+    } else if (pass_vk->use_pushd) {
+        vk->CmdPushDescriptorSetKHR(buf, bindPoint[pass->params.type],
                                     pass_vk->pipeLayout, 0,
                                     pass->params.num_descriptors,
                                     pass_vk->dswrite);
     }
 
     if (pass->params.push_constants_size) {
-        vk->CmdPushConstants(cmd->buf, pass_vk->pipeLayout,
+        vk->CmdPushConstants(buf, pass_vk->pipeLayout,
                              stageFlags[pass->params.type], 0,
                              pass->params.push_constants_size,
                              params->push_constants);
@@ -2839,20 +4023,11 @@ static void vk_pass_run(const struct pl_gpu *gpu,
 
     switch (pass->params.type) {
     case PL_PASS_RASTER: {
-        const struct pl_tex *tex = params->target;
-        struct pl_tex_vk *tex_vk = TA_PRIV(tex);
-
-        buf_barrier(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, vert->params.size,
-                    false);
+        struct vk_rp *rp = &rec->rp;
 
-        vk->CmdBindVertexBuffers(cmd->buf, 0, 1, &vert_vk->slice.buf,
+        vk->CmdBindVertexBuffers(buf, 0, 1, &vert_vk->slice.buf,
                                  &vert_vk->slice.mem.offset);
 
-        tex_barrier(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                    pass_vk->initialLayout, false);
-
         VkViewport viewport = {
             .x = params->viewport.x0,
             .y = params->viewport.y0,
@@ -2865,45 +4040,52 @@ static void vk_pass_run(const struct pl_gpu *gpu,
             .extent = {pl_rect_w(params->scissors), pl_rect_h(params->scissors)},
         };
 
-        vk->CmdSetViewport(cmd->buf, 0, 1, &viewport);
-        vk->CmdSetScissor(cmd->buf, 0, 1, &scissor);
+        vk->CmdSetViewport(buf, 0, 1, &viewport);
+        vk->CmdSetScissor(buf, 0, 1, &scissor);
+        vk->CmdDraw(buf, params->vertex_count, 1, 0, 0);
 
-        VkRenderPassBeginInfo binfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = pass_vk->renderPass,
-            .framebuffer = tex_vk->framebuffer,
-            .renderArea = (VkRect2D){{0, 0}, {tex->params.w, tex->params.h}},
-        };
+        VkResult res = vk->EndCommandBuffer(buf);
+        if (res != VK_SUCCESS) {
+            PL_ERR(gpu, "Failed recording secondary command buffer: %s",
+                   vk_res_str(res));
+            vk_secondary_release(rec, buf);
+            vk->failed = true;
+            goto error;
+        }
 
-        vk->CmdBeginRenderPass(cmd->buf, &binfo, VK_SUBPASS_CONTENTS_INLINE);
-        vk->CmdDraw(cmd->buf, params->vertex_count, 1, 0, 0);
-        vk->CmdEndRenderPass(cmd->buf);
+        if (!merge) {
+            rp->target = params->target;
+            rp->pass = pass;
+        }
 
-        buf_signal(gpu, cmd, vert, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        TARRAY_APPEND((void *) gpu, rp->bufs, rp->num_bufs, buf);
+        vk_rp_add_resources(gpu, params, vert);
 
-        // The renderPass implicitly transitions the texture to this layout
-        tex_vk->current_layout = pass_vk->finalLayout;
-        tex_signal(gpu, cmd, tex, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        // Timers need to cover the actual draw, so don't defer those
+        if (params->timer)
+            vk_end_render_pass(gpu);
         break;
     }
     case PL_PASS_COMPUTE:
-        vk->CmdDispatch(cmd->buf, params->compute_groups[0],
+        vk_flush_barriers(gpu);
+        vk->CmdDispatch(buf, params->compute_groups[0],
                         params->compute_groups[1],
                         params->compute_groups[2]);
+
+        for (int i = 0; i < pass->params.num_descriptors; i++)
+            vk_release_descriptor(gpu, cmd, pass, params->desc_bindings[i], i);
         break;
     default: abort();
     };
 
-    for (int i = 0; i < pass->params.num_descriptors; i++)
-        vk_release_descriptor(gpu, cmd, pass, params->desc_bindings[i], i);
-
     vk_cmd_timer_end(gpu, cmd, params->timer);
     CMD_MARK_END(cmd);
 
-    // flush the work so far into its own command buffer, for better
-    // intra-frame granularity
-    pl_assert(cmd == p->cmd); // make sure this is still the case
-    vk_submit(gpu);
+    // Compute passes get flushed immediately, while raster passes stay
+    // deferred until something else happens (see vk_end_render_pass)
+    pl_assert(cmd == rec->cmd); // make sure this is still the case
+    if (pass->params.type == PL_PASS_COMPUTE)
+        vk_submit(gpu);
 
 error:
     return;
@@ -2986,6 +4168,7 @@ static const struct pl_sync *vk_sync_create(const struct pl_gpu *gpu,
         sync->signal_handle.handle = NULL;
         break;
     case PL_HANDLE_DMA_BUF:
+    case PL_HANDLE_HOST_PTR:
         abort();
     }
 
@@ -3058,7 +4241,9 @@ static bool vk_tex_export(const struct pl_gpu *gpu, const struct pl_tex *tex,
     struct pl_tex_vk *tex_vk = TA_PRIV(tex);
     struct pl_sync_vk *sync_vk = TA_PRIV(sync);
 
-    struct vk_cmd *cmd = p->cmd ? p->cmd : vk_require_cmd(gpu, GRAPHICS);
+    struct vk_rec *rec = vk_rec(gpu);
+    rec_end_render_pass(gpu, rec);
+    struct vk_cmd *cmd = rec->cmd ? rec->cmd : vk_require_cmd(gpu, GRAPHICS);
     if (!cmd)
         goto error;
 
@@ -3086,86 +4271,132 @@ error:
     return false;
 }
 
-// Gives us enough queries for 8 results
-#define QUERY_POOL_SIZE 16
+// Number of results buffered per timer
+#define TIMER_RESULTS 8
 
 struct pl_timer {
     bool recording; // true between vk_cmd_timer_begin() and vk_cmd_timer_end()
-    VkQueryPool qpool; // even=start, odd=stop
-    int index_write; // next index to write to
-    int index_read; // next index to read from
-    uint64_t pending; // bitmask of queries that are still running
+    int slot; // slot of the query pair being recorded
+    uint64_t results[TIMER_RESULTS]; // FIFO of unread results
+    int index_read;
+    int num_results;
 };
 
-static inline uint64_t timer_bit(int index)
-{
-    return 1llu << (index / 2);
-}
-
 static void vk_timer_destroy(const struct pl_gpu *gpu, struct pl_timer *timer)
 {
     struct pl_vk *p = TA_PRIV(gpu);
-    struct vk_ctx *vk = p->vk;
+    struct vk_query_ring *ring = &p->queries;
+
+    // Discard the results of all queries still in flight for this timer
+    for (int i = ring->tail; i != ring->head; i = (i + 1) % QUERY_RING_SLOTS) {
+        if (ring->slots[i].timer == timer)
+            ring->slots[i].timer = NULL;
+    }
 
-    pl_assert(!timer->pending);
-    vk->DestroyQueryPool(vk->dev, timer->qpool, VK_ALLOC);
     talloc_free(timer);
 }
 
-MAKE_LAZY_DESTRUCTOR(vk_timer_destroy, struct pl_timer)
-
 static struct pl_timer *vk_timer_create(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
 
-    struct pl_timer *timer = talloc_ptrtype(NULL, timer);
-    *timer = (struct pl_timer) {0};
+    // The query pool is shared by all timers, and only created on demand
+    if (!p->queries.qpool) {
+        struct VkQueryPoolCreateInfo qinfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * QUERY_RING_SLOTS,
+        };
 
-    struct VkQueryPoolCreateInfo qinfo = {
-        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-        .queryType = VK_QUERY_TYPE_TIMESTAMP,
-        .queryCount = QUERY_POOL_SIZE,
-    };
+        VK(vk->CreateQueryPool(vk->dev, &qinfo, VK_ALLOC, &p->queries.qpool));
+    }
 
-    VK(vk->CreateQueryPool(vk->dev, &qinfo, VK_ALLOC, &timer->qpool));
+    struct pl_timer *timer = talloc_ptrtype(NULL, timer);
+    *timer = (struct pl_timer) {0};
     return timer;
 
 error:
-    vk_timer_destroy(gpu, timer);
     return NULL;
 }
 
-static uint64_t vk_timer_query(const struct pl_gpu *gpu, struct pl_timer *timer)
+// Reads back the results of all completed queries at the tail of the ring,
+// using a single vkGetQueryPoolResults call per contiguous range
+static void vk_queries_collect(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
-
-    if (timer->index_read == timer->index_write)
-        return 0; // no more unprocessed results
+    struct vk_query_ring *ring = &p->queries;
 
     vk_poll_commands(vk, 0);
-    if (timer->pending & timer_bit(timer->index_read))
-        return 0; // still waiting for results
+    while (ring->tail != ring->head && ring->slots[ring->tail].done) {
+        int end = ring->tail;
+        while (end < QUERY_RING_SLOTS && end != ring->head && ring->slots[end].done)
+            end++;
+
+        // Each query is followed by its availability, since the commands of
+        // slots marked as done may also have failed or never been submitted
+        int num = end - ring->tail;
+        VkResult res;
+        res = vk->GetQueryPoolResults(vk->dev, ring->qpool, 2 * ring->tail,
+                                      2 * num, 4 * num * sizeof(uint64_t),
+                                      ring->ts, 2 * sizeof(uint64_t),
+                                      VK_QUERY_RESULT_64_BIT |
+                                      VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        if (res != VK_NOT_READY)
+            VK_ASSERT(res, "Retrieving query pool results");
+
+        for (int i = 0; i < num; i++) {
+            struct vk_query_slot *slot = &ring->slots[ring->tail + i];
+            struct pl_timer *timer = slot->timer;
+            const uint64_t *q = &ring->ts[4 * i];
+            if (timer && q[1] && q[3]) {
+                uint64_t ns = (q[2] - q[0]) * vk->limits.timestampPeriod;
+                if (timer->num_results == TIMER_RESULTS) {
+                    // forcibly drop the least recent result to make space
+                    timer->index_read = (timer->index_read + 1) % TIMER_RESULTS;
+                    timer->num_results--;
+                }
+                int idx = (timer->index_read + timer->num_results) % TIMER_RESULTS;
+                timer->results[idx] = ns;
+                timer->num_results++;
+            }
+            // Unavailable results of done slots will never arrive, drop them
+            *slot = (struct vk_query_slot) {0};
+        }
 
-    VkResult res;
-    uint64_t ts[2] = {0};
-    res = vk->GetQueryPoolResults(vk->dev, timer->qpool, timer->index_read, 2,
-                                  sizeof(ts), &ts[0], sizeof(uint64_t),
-                                  VK_QUERY_RESULT_64_BIT);
-
-    switch (res) {
-    case VK_SUCCESS:
-        timer->index_read = (timer->index_read + 2) % QUERY_POOL_SIZE;
-        return (ts[1] - ts[0]) * vk->limits.timestampPeriod;
-    case VK_NOT_READY:
-        return 0;
-    default:
-        VK_ASSERT(res, "Retrieving query pool results");
+        // Make sure stale results can't be mistaken for those of a later
+        // command that gets discarded before its own reset executes
+        if (p->host_query_reset)
+            vk->ResetQueryPoolEXT(vk->dev, ring->qpool, 2 * ring->tail, 2 * num);
+
+        ring->tail = end % QUERY_RING_SLOTS;
     }
 
+    return;
+
 error:
-    return 0;
+    // Drop the offending queries, so they don't block the ring forever
+    while (ring->tail != ring->head && ring->slots[ring->tail].done) {
+        ring->slots[ring->tail] = (struct vk_query_slot) {0};
+        ring->tail = (ring->tail + 1) % QUERY_RING_SLOTS;
+    }
+}
+
+static uint64_t vk_timer_query(const struct pl_gpu *gpu, struct pl_timer *timer)
+{
+    // Results for all timers are read back together, so this only needs to
+    // touch the query pool once all previously collected results are used up
+    if (!timer->num_results)
+        vk_queries_collect(gpu);
+    if (!timer->num_results)
+        return 0;
+
+    uint64_t ns = timer->results[timer->index_read];
+    timer->index_read = (timer->index_read + 1) % TIMER_RESULTS;
+    timer->num_results--;
+    return ns;
 }
 
 static void vk_cmd_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -3173,6 +4404,7 @@ static void vk_cmd_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
+    struct vk_query_ring *ring = &p->queries;
 
     if (!timer)
         return;
@@ -3182,17 +4414,21 @@ static void vk_cmd_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
         return;
     }
 
-    vk_poll_commands(vk, 0);
-    if (timer->pending & timer_bit(timer->index_write))
-        return; // next query is still running, skip this timer
+    int next = (ring->head + 1) % QUERY_RING_SLOTS;
+    if (next == ring->tail) {
+        vk_queries_collect(gpu);
+        if (next == ring->tail)
+            return; // all queries are still running, skip this timer
+    }
 
+    int slot = ring->head;
     VkQueueFlags reset_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
     if (cmd->pool->props.queueFlags & reset_flags) {
         // Use direct command buffer resets
-        vk->CmdResetQueryPool(cmd->buf, timer->qpool, timer->index_write, 2);
+        vk->CmdResetQueryPool(cmd->buf, ring->qpool, 2 * slot, 2);
     } else if (p->host_query_reset) {
         // Use host query resets
-        vk->ResetQueryPoolEXT(vk->dev, timer->qpool, timer->index_write, 2);
+        vk->ResetQueryPoolEXT(vk->dev, ring->qpool, 2 * slot, 2);
     } else {
         PL_TRACE(gpu, "QF %d supports no mechanism for resetting queries",
                  cmd->pool->qf);
@@ -3200,16 +4436,18 @@ static void vk_cmd_timer_begin(const struct pl_gpu *gpu, struct vk_cmd *cmd,
     }
 
     vk->CmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                          timer->qpool, timer->index_write);
+                          ring->qpool, 2 * slot);
 
+    ring->slots[slot] = (struct vk_query_slot) { .timer = timer };
+    ring->head = next;
+    timer->slot = slot;
     timer->recording = true;
 }
 
-static void vk_timer_cb(void *ptimer, void *pindex)
+static void vk_timer_cb(void *pslot, void *arg)
 {
-    struct pl_timer *timer = ptimer;
-    int index = (uintptr_t) pindex;
-    timer->pending &= ~timer_bit(index);
+    struct vk_query_slot *slot = pslot;
+    slot->done = true;
 }
 
 static void vk_cmd_timer_end(const struct pl_gpu *gpu, struct vk_cmd *cmd,
@@ -3217,30 +4455,31 @@ static void vk_cmd_timer_end(const struct pl_gpu *gpu, struct vk_cmd *cmd,
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
+    struct vk_query_ring *ring = &p->queries;
 
     if (!timer || !timer->recording)
         return;
 
     vk->CmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                          timer->qpool, timer->index_write + 1);
+                          ring->qpool, 2 * timer->slot + 1);
 
     timer->recording = false;
-    timer->pending |= timer_bit(timer->index_write);
-    vk_cmd_callback(cmd, (vk_cb) vk_timer_cb, timer,
-                    (void *) (uintptr_t) timer->index_write);
+    vk_cmd_callback(cmd, (vk_cb) vk_timer_cb, &ring->slots[timer->slot], NULL);
+}
 
-    timer->index_write = (timer->index_write + 2) % QUERY_POOL_SIZE;
-    if (timer->index_write == timer->index_read) {
-        // forcibly drop the least recent result to make space
-        timer->index_read = (timer->index_read + 2) % QUERY_POOL_SIZE;
-    }
+// Submits the commands recorded by all threads
+static void vk_submit_all(const struct pl_gpu *gpu)
+{
+    struct pl_vk *p = TA_PRIV(gpu);
+    for (int i = 0; i < p->num_recs; i++)
+        rec_submit(gpu, p->recs[i]);
 }
 
 static void vk_gpu_flush(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
-    vk_submit(gpu);
+    vk_submit_all(gpu);
     vk_flush_commands(vk);
     vk_rotate_queues(vk);
 }
@@ -3249,43 +4488,131 @@ static void vk_gpu_finish(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
-    vk_submit(gpu);
+    vk_submit_all(gpu);
     vk_wait_idle(vk);
 }
 
 struct vk_cmd *pl_vk_steal_cmd(const struct pl_gpu *gpu)
 {
     struct pl_vk *p = TA_PRIV(gpu);
+    vk_lock(p->vk);
+    struct vk_rec *rec = vk_rec(gpu);
     struct vk_cmd *cmd = vk_require_cmd(gpu, GRAPHICS);
-    p->cmd = NULL;
+    rec_flush_barriers(gpu, rec);
+    rec->cmd = NULL;
+    vk_unlock(p->vk);
     return cmd;
 }
 
+// Thread-safe wrappers around the internal entry points. These simply hold
+// the (recursive) vk_ctx lock for the duration of each call.
+#define VK_LOCK(gpu)   vk_lock(((struct pl_vk *) TA_PRIV(gpu))->vk)
+#define VK_UNLOCK(gpu) vk_unlock(((struct pl_vk *) TA_PRIV(gpu))->vk)
+
+#define LOCKED_FUN(ret, name, params, args)                                 \
+    static ret name##_locked params {                                       \
+        VK_LOCK(gpu);                                                       \
+        ret res = name args;                                                \
+        VK_UNLOCK(gpu);                                                     \
+        return res;                                                         \
+    }
+
+#define LOCKED_VOID(name, params, args)                                     \
+    static void name##_locked params {                                      \
+        VK_LOCK(gpu);                                                       \
+        name args;                                                          \
+        VK_UNLOCK(gpu);                                                     \
+    }
+
+LOCKED_FUN(const struct pl_tex *, vk_tex_create,
+           (const struct pl_gpu *gpu, const struct pl_tex_params *params),
+           (gpu, params))
+LOCKED_VOID(vk_tex_invalidate,
+            (const struct pl_gpu *gpu, const struct pl_tex *tex),
+            (gpu, tex))
+LOCKED_VOID(vk_tex_clear,
+            (const struct pl_gpu *gpu, const struct pl_tex *tex,
+             const float color[4]),
+            (gpu, tex, color))
+LOCKED_VOID(vk_tex_blit,
+            (const struct pl_gpu *gpu, const struct pl_tex *dst,
+             const struct pl_tex *src, struct pl_rect3d dst_rc,
+             struct pl_rect3d src_rc),
+            (gpu, dst, src, dst_rc, src_rc))
+LOCKED_FUN(bool, vk_tex_upload,
+           (const struct pl_gpu *gpu, const struct pl_tex_transfer_params *params),
+           (gpu, params))
+LOCKED_FUN(bool, vk_tex_download,
+           (const struct pl_gpu *gpu, const struct pl_tex_transfer_params *params),
+           (gpu, params))
+LOCKED_FUN(const struct pl_buf *, vk_buf_create,
+           (const struct pl_gpu *gpu, const struct pl_buf_params *params),
+           (gpu, params))
+LOCKED_VOID(vk_buf_write,
+            (const struct pl_gpu *gpu, const struct pl_buf *buf, size_t offset,
+             const void *data, size_t size),
+            (gpu, buf, offset, data, size))
+LOCKED_FUN(bool, vk_buf_read,
+           (const struct pl_gpu *gpu, const struct pl_buf *buf, size_t offset,
+            void *dest, size_t size),
+           (gpu, buf, offset, dest, size))
+LOCKED_FUN(bool, vk_buf_export,
+           (const struct pl_gpu *gpu, const struct pl_buf *buf),
+           (gpu, buf))
+LOCKED_FUN(bool, vk_buf_poll,
+           (const struct pl_gpu *gpu, const struct pl_buf *buf, uint64_t timeout),
+           (gpu, buf, timeout))
+LOCKED_VOID(vk_pass_run,
+            (const struct pl_gpu *gpu, const struct pl_pass_run_params *params),
+            (gpu, params))
+LOCKED_FUN(const struct pl_sync *, vk_sync_create,
+           (const struct pl_gpu *gpu, enum pl_handle_type handle_type),
+           (gpu, handle_type))
+LOCKED_VOID(vk_sync_deref,
+            (const struct pl_gpu *gpu, const struct pl_sync *sync),
+            (gpu, sync))
+LOCKED_FUN(bool, vk_tex_export,
+           (const struct pl_gpu *gpu, const struct pl_tex *tex,
+            const struct pl_sync *sync),
+           (gpu, tex, sync))
+LOCKED_FUN(struct pl_timer *, vk_timer_create,
+           (const struct pl_gpu *gpu),
+           (gpu))
+LOCKED_VOID(vk_timer_destroy,
+            (const struct pl_gpu *gpu, struct pl_timer *timer),
+            (gpu, timer))
+LOCKED_FUN(uint64_t, vk_timer_query,
+           (const struct pl_gpu *gpu, struct pl_timer *timer),
+           (gpu, timer))
+LOCKED_VOID(vk_gpu_flush, (const struct pl_gpu *gpu), (gpu))
+LOCKED_VOID(vk_gpu_finish, (const struct pl_gpu *gpu), (gpu))
+
 static const struct pl_gpu_fns pl_fns_vk = {
     .destroy                = vk_destroy_gpu,
-    .tex_create             = vk_tex_create,
+    .tex_create             = vk_tex_create_locked,
     .tex_destroy            = vk_tex_destroy_lazy,
-    .tex_invalidate         = vk_tex_invalidate,
-    .tex_clear              = vk_tex_clear,
-    .tex_blit               = vk_tex_blit,
-    .tex_upload             = vk_tex_upload,
-    .tex_download           = vk_tex_download,
-    .buf_create             = vk_buf_create,
+    .tex_invalidate         = vk_tex_invalidate_locked,
+    .tex_clear              = vk_tex_clear_locked,
+    .tex_blit               = vk_tex_blit_locked,
+    .tex_upload             = vk_tex_upload_locked,
+    .tex_download           = vk_tex_download_locked,
+    .buf_create             = vk_buf_create_locked,
     .buf_destroy            = vk_buf_destroy_lazy,
-    .buf_write              = vk_buf_write,
-    .buf_read               = vk_buf_read,
-    .buf_export             = vk_buf_export,
-    .buf_poll               = vk_buf_poll,
+    .buf_write              = vk_buf_write_locked,
+    .buf_read               = vk_buf_read_locked,
+    .buf_export             = vk_buf_export_locked,
+    .buf_poll               = vk_buf_poll_locked,
     .desc_namespace         = vk_desc_namespace,
-    .pass_create            = vk_pass_create,
+    .pass_create            = vk_pass_create, // locks internally
     .pass_destroy           = vk_pass_destroy_lazy,
-    .pass_run               = vk_pass_run,
-    .sync_create            = vk_sync_create,
-    .sync_destroy           = vk_sync_deref,
-    .tex_export             = vk_tex_export,
-    .timer_create           = vk_timer_create,
-    .timer_destroy          = vk_timer_destroy_lazy,
-    .timer_query            = vk_timer_query,
-    .gpu_flush              = vk_gpu_flush,
-    .gpu_finish             = vk_gpu_finish,
+    .pass_run               = vk_pass_run_locked,
+    .sync_create            = vk_sync_create_locked,
+    .sync_destroy           = vk_sync_deref_locked,
+    .tex_export             = vk_tex_export_locked,
+    .timer_create           = vk_timer_create_locked,
+    .timer_destroy          = vk_timer_destroy_locked,
+    .timer_query            = vk_timer_query_locked,
+    .gpu_flush              = vk_gpu_flush_locked,
+    .gpu_finish             = vk_gpu_finish_locked,
+    .gpu_submits            = vk_gpu_submits,
 };
@@ -41,21 +41,36 @@
 // device. (Default: 256 MB)
 #define PLVK_HEAP_MAXIMUM_SLAB_SIZE (1 << 28)
 
-// Controls the minimum free region size, to reduce thrashing the free space
-// map with lots of small buffers during uninit. (Default: 1 KB)
-#define PLVK_HEAP_MINIMUM_REGION_SIZE (1 << 10)
-
-// Represents a region of available memory
-struct vk_region {
-    size_t start; // first offset in region
-    size_t end;   // first offset *not* in region
+// Allocations bigger than this always get their own dedicated allocation,
+// since they would otherwise force the heap to grow by a slab that they
+// mostly fill up by themselves. Smaller images also get one if the driver
+// prefers it (see VK_KHR_dedicated_allocation). (Default: 64 MB)
+#define PLVK_HEAP_DEDICATED_THRESHOLD \
+    (PLVK_HEAP_MAXIMUM_SLAB_SIZE / PLVK_HEAP_SLAB_GROWTH_RATE)
+
+// Parameters of the TLSF (two-level segregated fit) free space map. Free
+// blocks are sorted into size classes by their most significant bit (first
+// level), and each class is subdivided linearly into TLSF_SL_COUNT sub-classes
+// (second level). Blocks smaller than TLSF_SL_COUNT bytes all share the first
+// first-level class. TLSF_FL_COUNT must be large enough to cover the largest
+// possible slab size.
+#define TLSF_SL_LOG2  4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 32
+
+// Represents a contiguous block of memory inside a slab, which is either
+// allocated or free. All blocks of a slab form a doubly linked list sorted by
+// offset (for coalescing), and free blocks are additionally linked into the
+// TLSF free list corresponding to their size.
+struct vk_block {
+    struct vk_slab *slab;
+    size_t offset;
+    size_t size;
+    bool free;
+    struct vk_block *prev, *next;           // physical neighbours
+    struct vk_block *prev_free, *next_free; // free list (or spare list)
 };
 
-static inline size_t region_len(struct vk_region r)
-{
-    return r.end - r.start;
-}
-
 // A single slab represents a contiguous region of allocated memory. Actual
 // allocations are served as slices of this. Slabs are organized into linked
 // lists, which represent individual heaps.
@@ -65,9 +80,17 @@ struct vk_slab {
     size_t used;          // number of bytes actually in use (for GC accounting)
     bool dedicated;       // slab is allocated specifically for one object
     bool imported;        // slab represents an imported memory allocation
-    // free space map: a sorted list of memory regions that are available
-    struct vk_region *regions;
-    int num_regions;
+    int heap_index;       // index into `vk_malloc.heaps` (or -1 if imported)
+    uint32_t mem_heap;    // index of the VkMemoryHeap this was allocated from
+    // free space map, see `TLSF_*`. `sl_bitmap[fl]` has a bit set for every
+    // non-empty `free_lists[fl][sl]`, and `fl_bitmap` for every non-zero
+    // `sl_bitmap[fl]`
+    struct vk_block *blocks; // first block (at offset 0)
+    struct vk_block *spare;  // unused block structs, for re-use
+    struct vk_block *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    uint32_t fl_bitmap;
+    int num_free;            // number of free blocks
     // optional, depends on the memory type:
     VkBuffer buffer;        // buffer spanning the entire slab
     void *data;             // mapped memory corresponding to `mem`
@@ -90,6 +113,9 @@ struct vk_heap {
     enum pl_handle_type handle_type; // handle type available for this heap
     struct vk_slab **slabs;      // array of slabs sorted by size
     int num_slabs;
+    // dedicated allocations are not part of `slabs`, but still accounted
+    size_t dedicated_size;
+    int num_dedicated;
 };
 
 // The overall state of the allocator, which keeps track of a vk_heap for each
@@ -97,19 +123,29 @@ struct vk_heap {
 struct vk_malloc {
     struct vk_ctx *vk;
     VkPhysicalDeviceMemoryProperties props;
+    bool has_budget; // VK_EXT_memory_budget is enabled
+    bool has_dedicated; // VK_KHR_dedicated_allocation is enabled
+    bool has_rebar; // device-local memory is fully host-visible
+    size_t host_ptr_align; // for VK_EXT_external_memory_host (or 0)
     struct vk_heap *heaps;
     int num_heaps;
+
+    // accounting per VkMemoryHeap: total size of all allocated device memory,
+    // and the number of bytes of that actually in use
+    VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize used[VK_MAX_MEMORY_HEAPS];
 };
 
-static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
+static void slab_free(struct vk_malloc *ma, struct vk_slab *slab)
 {
+    struct vk_ctx *vk = ma->vk;
     if (!slab)
         return;
 
     pl_assert(slab->used == 0);
-    if (!slab->imported) {
-        vk->DestroyBuffer(vk->dev, slab->buffer, VK_ALLOC);
+    vk->DestroyBuffer(vk->dev, slab->buffer, VK_ALLOC);
 
+    if (!slab->imported) {
         switch (slab->handle_type) {
         case PL_HANDLE_FD:
         case PL_HANDLE_DMA_BUF:
@@ -127,20 +163,270 @@ static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
         case PL_HANDLE_WIN32_KMT:
             // PL_HANDLE_WIN32_KMT is just an identifier. It doesn't get closed.
             break;
+        case PL_HANDLE_HOST_PTR:
+            // Host pointers are owned by the user
+            break;
         }
 
         PL_INFO(vk, "Freed slab of size %zu", (size_t) slab->size);
+    } else if (slab->handle_type == PL_HANDLE_HOST_PTR) {
+        PL_DEBUG(vk, "Unimporting slab of size %zu from ptr: %p",
+                 (size_t) slab->size, slab->handle.ptr);
     } else {
         PL_DEBUG(vk, "Unimporting slab of size %zu from fd: %d",
                  (size_t) slab->size, slab->handle.fd);
     }
 
     // also implicitly unmaps the memory if needed
-    vk->FreeMemory(vk->dev, slab->mem, VK_ALLOC);
+    if (slab->mem) {
+        vk->FreeMemory(vk->dev, slab->mem, VK_ALLOC);
+        pl_assert(ma->allocated[slab->mem_heap] >= slab->size);
+        ma->allocated[slab->mem_heap] -= slab->size;
+    }
 
     talloc_free(slab);
 }
 
+// Maps a block size to its TLSF size class
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+    pl_assert(size);
+    int msb = PL_LOG2(size);
+    if (msb < TLSF_SL_LOG2) {
+        *fl = 0;
+        *sl = size;
+    } else {
+        *fl = msb - TLSF_SL_LOG2 + 1;
+        *sl = (size >> (msb - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+    }
+
+    pl_assert(*fl < TLSF_FL_COUNT && *sl < TLSF_SL_COUNT);
+}
+
+static struct vk_block *block_new(struct vk_slab *slab)
+{
+    struct vk_block *block = slab->spare;
+    if (block) {
+        slab->spare = block->next_free;
+    } else {
+        block = talloc_ptrtype(slab, block);
+    }
+
+    *block = (struct vk_block) { .slab = slab };
+    return block;
+}
+
+static void block_recycle(struct vk_slab *slab, struct vk_block *block)
+{
+    block->next_free = slab->spare;
+    slab->spare = block;
+}
+
+static void free_insert(struct vk_slab *slab, struct vk_block *block)
+{
+    int fl, sl;
+    tlsf_mapping(block->size, &fl, &sl);
+
+    struct vk_block **head = &slab->free_lists[fl][sl];
+    block->free = true;
+    block->prev_free = NULL;
+    block->next_free = *head;
+    if (*head)
+        (*head)->prev_free = block;
+    *head = block;
+
+    slab->sl_bitmap[fl] |= 1u << sl;
+    slab->fl_bitmap |= 1u << fl;
+    slab->num_free++;
+}
+
+static void free_remove(struct vk_slab *slab, struct vk_block *block)
+{
+    int fl, sl;
+    tlsf_mapping(block->size, &fl, &sl);
+    pl_assert(block->free);
+
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        pl_assert(slab->free_lists[fl][sl] == block);
+        slab->free_lists[fl][sl] = block->next_free;
+    }
+
+    if (block->next_free)
+        block->next_free->prev_free = block->prev_free;
+
+    if (!slab->free_lists[fl][sl]) {
+        slab->sl_bitmap[fl] &= ~(1u << sl);
+        if (!slab->sl_bitmap[fl])
+            slab->fl_bitmap &= ~(1u << fl);
+    }
+
+    block->free = false;
+    block->prev_free = block->next_free = NULL;
+    slab->num_free--;
+}
+
+// Finds a free block of at least `size` bytes in constant time, or NULL
+static struct vk_block *free_find(struct vk_slab *slab, size_t size)
+{
+    // Round up to the next size class, so every block in the list we find is
+    // guaranteed to be big enough
+    int msb = PL_LOG2(size);
+    if (msb >= TLSF_SL_LOG2) {
+        size_t round = ((size_t) 1 << (msb - TLSF_SL_LOG2)) - 1;
+        if (size + round < size)
+            return NULL;
+        size += round;
+    }
+
+    int fl, sl;
+    msb = PL_LOG2(size);
+    if (msb >= TLSF_SL_LOG2 && msb - TLSF_SL_LOG2 + 1 >= TLSF_FL_COUNT)
+        return NULL;
+    tlsf_mapping(size, &fl, &sl);
+
+    uint32_t sl_map = slab->sl_bitmap[fl] & (UINT32_MAX << sl);
+    if (!sl_map) {
+        // Nothing left in this first-level class, try the next larger one
+        uint32_t fl_map = fl + 1 < TLSF_FL_COUNT
+                            ? slab->fl_bitmap & (UINT32_MAX << (fl + 1))
+                            : 0;
+        if (!fl_map)
+            return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = slab->sl_bitmap[fl];
+    }
+
+    pl_assert(sl_map);
+    sl = __builtin_ctz(sl_map);
+    return slab->free_lists[fl][sl];
+}
+
+static inline bool block_fits(const struct vk_block *block, size_t size,
+                              size_t align)
+{
+    return PL_ALIGN(block->offset, align) + size <= block->offset + block->size;
+}
+
+// Searches the free list for the size class containing `size` itself, which
+// may include blocks that are too small. Used as a fallback when `free_find`
+// fails, e.g. when the only suitable block is exactly large enough. Not
+// constant time, but only ever needed for near-full slabs.
+static struct vk_block *free_find_exact(struct vk_slab *slab, size_t size,
+                                        size_t align)
+{
+    int fl, sl;
+    int msb = PL_LOG2(size);
+    if (msb >= TLSF_SL_LOG2 && msb - TLSF_SL_LOG2 + 1 >= TLSF_FL_COUNT)
+        return NULL;
+    tlsf_mapping(size, &fl, &sl);
+
+    for (struct vk_block *b = slab->free_lists[fl][sl]; b; b = b->next_free) {
+        if (block_fits(b, size, align))
+            return b;
+    }
+
+    return NULL;
+}
+
+// Initializes the free space map of a new slab to a single free block
+static void slab_init_blocks(struct vk_slab *slab)
+{
+    struct vk_block *block = block_new(slab);
+    block->size = slab->size;
+    slab->blocks = block;
+    free_insert(slab, block);
+}
+
+// Splits off `size` bytes from the start of `block`, returning the new block
+// (which takes over the start of `block`). Neither block is free.
+static struct vk_block *block_split(struct vk_slab *slab,
+                                    struct vk_block *block, size_t size)
+{
+    pl_assert(size < block->size);
+    struct vk_block *head = block_new(slab);
+    head->offset = block->offset;
+    head->size = size;
+    head->prev = block->prev;
+    head->next = block;
+    if (head->prev) {
+        head->prev->next = head;
+    } else {
+        slab->blocks = head;
+    }
+
+    block->prev = head;
+    block->offset += size;
+    block->size -= size;
+    return head;
+}
+
+// Allocates an aligned block from this slab, or returns NULL if there's no
+// suitable free block
+static struct vk_block *slab_get_block(struct vk_slab *slab, size_t size,
+                                       size_t align)
+{
+    if (size > slab->size)
+        return NULL;
+
+    // Find a block that fits even in the worst case alignment, falling back
+    // to searching the (partially fitting) size class of `size` itself
+    struct vk_block *block = NULL;
+    if (size + align - 1 >= size)
+        block = free_find(slab, size + align - 1);
+    if (!block)
+        block = free_find_exact(slab, size, align);
+    if (!block)
+        return NULL;
+
+    free_remove(slab, block);
+
+    // Return the unaligned head of this block to the free list. The previous
+    // block can't be free, since free blocks are always coalesced
+    size_t gap = PL_ALIGN(block->offset, align) - block->offset;
+    if (gap)
+        free_insert(slab, block_split(slab, block, gap));
+
+    // Likewise for the unused tail
+    if (block->size > size) {
+        struct vk_block *head = block_split(slab, block, size);
+        free_insert(slab, block);
+        block = head;
+    }
+
+    return block;
+}
+
+// Returns a block to the free list, coalescing it with its neighbours
+static void slab_put_block(struct vk_slab *slab, struct vk_block *block)
+{
+    pl_assert(!block->free);
+
+    struct vk_block *prev = block->prev;
+    if (prev && prev->free) {
+        free_remove(slab, prev);
+        prev->size += block->size;
+        prev->next = block->next;
+        if (prev->next)
+            prev->next->prev = prev;
+        block_recycle(slab, block);
+        block = prev;
+    }
+
+    struct vk_block *next = block->next;
+    if (next && next->free) {
+        free_remove(slab, next);
+        block->size += next->size;
+        block->next = next->next;
+        if (block->next)
+            block->next->prev = block;
+        block_recycle(slab, next);
+    }
+
+    free_insert(slab, block);
+}
+
 static bool find_best_memtype(struct vk_malloc *ma, uint32_t typeBits,
                               VkMemoryPropertyFlags flags,
                               VkMemoryType *out_type, int *out_index)
@@ -190,20 +476,21 @@ static bool buf_external_check(struct vk_ctx *vk, VkBufferUsageFlags usage,
                                  import);
 }
 
+// If `dedicated` is set, the allocation is made specifically for `image`
+// (or for the slab's own buffer, if `heap->usage` is set)
 static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
-                                  size_t size)
+                                  size_t size, bool dedicated, VkImage image)
 {
     struct vk_ctx *vk = ma->vk;
     struct vk_slab *slab = talloc_ptrtype(NULL, slab);
     *slab = (struct vk_slab) {
         .size = size,
+        .dedicated = dedicated,
+        .heap_index = heap - ma->heaps,
         .handle_type = heap->handle_type,
     };
 
-    TARRAY_APPEND(slab, slab->regions, slab->num_regions, (struct vk_region) {
-        .start = 0,
-        .end   = slab->size,
-    });
+    slab_init_blocks(slab);
 
     switch (slab->handle_type) {
     case PL_HANDLE_FD:
@@ -214,6 +501,8 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
     case PL_HANDLE_WIN32_KMT:
         slab->handle.handle = NULL;
         break;
+    case PL_HANDLE_HOST_PTR:
+        abort(); // only supported for imports
     }
 
     VkExportMemoryAllocateInfoKHR ext_info = {
@@ -221,12 +510,19 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
         .handleTypes = vk_mem_handle_type(slab->handle_type),
     };
 
+    VkMemoryDedicatedAllocateInfoKHR ded_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+        .image = image,
+    };
+
     VkMemoryAllocateInfo minfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = heap->handle_type ? &ext_info : NULL,
         .allocationSize = slab->size,
     };
 
+    if (heap->handle_type)
+        vk_link_struct(&minfo, &ext_info);
+
     uint32_t typeBits = heap->typeBits ? heap->typeBits : UINT32_MAX;
     if (heap->usage) {
         // FIXME: Since we can't keep track of queue family ownership properly,
@@ -266,19 +562,25 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
         vk->GetBufferMemoryRequirements(vk->dev, slab->buffer, &reqs);
         minfo.allocationSize = reqs.size; // this can be larger than slab->size
         typeBits &= reqs.memoryTypeBits;  // this can restrict the types
+        ded_info.buffer = slab->buffer;
     }
 
+    if (dedicated && ma->has_dedicated && (ded_info.image || ded_info.buffer))
+        vk_link_struct(&minfo, &ded_info);
+
     VkMemoryType type;
     int index;
     if (!find_best_memtype(ma, typeBits, heap->flags, &type, &index))
         goto error;
 
-    PL_INFO(vk, "Allocating %zu memory of type 0x%x (id %d) in heap %d",
+    PL_INFO(vk, "Allocating %zu memory of type 0x%x (id %d) in heap %d%s",
             (size_t) slab->size, (unsigned) type.propertyFlags, index,
-            (int) type.heapIndex);
+            (int) type.heapIndex, dedicated ? " (dedicated)" : "");
 
     minfo.memoryTypeIndex = index;
     VK(vk->AllocateMemory(vk->dev, &minfo, VK_ALLOC, &slab->mem));
+    slab->mem_heap = type.heapIndex;
+    ma->allocated[slab->mem_heap] += slab->size;
 
     if (heap->flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
         VK(vk->MapMemory(vk->dev, slab->mem, 0, VK_WHOLE_SIZE, 0, &slab->data));
@@ -320,66 +622,14 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma, struct vk_heap *heap,
     return slab;
 
 error:
-    slab_free(vk, slab);
+    slab_free(ma, slab);
     return NULL;
 }
 
-static void insert_region(struct vk_slab *slab, struct vk_region region)
-{
-    if (region.start == region.end)
-        return;
-
-    bool big_enough = region_len(region) >= PLVK_HEAP_MINIMUM_REGION_SIZE;
-
-    // Find the index of the first region that comes after this
-    for (int i = 0; i < slab->num_regions; i++) {
-        struct vk_region *r = &slab->regions[i];
-
-        // Check for a few special cases which can be coalesced
-        if (r->end == region.start) {
-            // The new region is at the tail of this region. In addition to
-            // modifying this region, we also need to coalesce all the following
-            // regions for as long as possible
-            r->end = region.end;
-
-            struct vk_region *next = &slab->regions[i+1];
-            while (i+1 < slab->num_regions && r->end == next->start) {
-                r->end = next->end;
-                TARRAY_REMOVE_AT(slab->regions, slab->num_regions, i+1);
-            }
-            return;
-        }
-
-        if (r->start == region.end) {
-            // The new region is at the head of this region. We don't need to
-            // do anything special here - because if this could be further
-            // coalesced backwards, the previous loop iteration would already
-            // have caught it.
-            r->start = region.start;
-            return;
-        }
-
-        if (r->start > region.start) {
-            // The new region comes somewhere before this region, so insert
-            // it into this index in the array.
-            if (big_enough) {
-                TARRAY_INSERT_AT(slab, slab->regions, slab->num_regions,
-                                    i, region);
-            }
-            return;
-        }
-    }
-
-    // If we've reached the end of this loop, then all of the regions
-    // come before the new region, and are disconnected - so append it
-    if (big_enough)
-        TARRAY_APPEND(slab, slab->regions, slab->num_regions, region);
-}
-
-static void heap_uninit(struct vk_ctx *vk, struct vk_heap *heap)
+static void heap_uninit(struct vk_malloc *ma, struct vk_heap *heap)
 {
     for (int i = 0; i < heap->num_slabs; i++)
-        slab_free(vk, heap->slabs[i]);
+        slab_free(ma, heap->slabs[i]);
 
     talloc_free(heap->slabs);
     *heap = (struct vk_heap){0};
@@ -391,6 +641,34 @@ struct vk_malloc *vk_malloc_create(struct vk_ctx *vk)
     vk->GetPhysicalDeviceMemoryProperties(vk->physd, &ma->props);
     ma->vk = vk;
 
+    for (int i = 0; i < vk->num_exts; i++) {
+        if (strcmp(vk->exts[i], VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            ma->has_budget = true;
+        if (strcmp(vk->exts[i], VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME) == 0)
+            ma->has_dedicated = true;
+    }
+
+    // Promoted to core in vulkan 1.1, and useless without a way to query
+    // the driver's preference
+    if (vk->api_ver >= VK_API_VERSION_1_1)
+        ma->has_dedicated = true;
+    if (!vk->GetImageMemoryRequirements2KHR)
+        ma->has_dedicated = false;
+
+    if (vk->GetMemoryHostPointerPropertiesEXT) {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_props = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT,
+        };
+
+        VkPhysicalDeviceProperties2KHR props = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+            .pNext = &host_props,
+        };
+
+        vk->GetPhysicalDeviceProperties2KHR(vk->physd, &props);
+        ma->host_ptr_align = host_props.minImportedHostPointerAlignment;
+    }
+
     PL_INFO(vk, "Memory heaps supported by device:");
     for (int i = 0; i < ma->props.memoryHeapCount; i++) {
         VkMemoryHeap heap = ma->props.memoryHeaps[i];
@@ -405,6 +683,23 @@ struct vk_malloc *vk_malloc_create(struct vk_ctx *vk)
                 i, (unsigned) type.propertyFlags, (int) type.heapIndex);
     }
 
+    // Most devices expose a small (256 MB) window of device-local memory as
+    // host-visible, which is best left alone. With resizable BAR, the entire
+    // VRAM heap is host-visible instead.
+    const VkMemoryPropertyFlags rebar_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    for (int i = 0; i < ma->props.memoryTypeCount; i++) {
+        VkMemoryType type = ma->props.memoryTypes[i];
+        if ((type.propertyFlags & rebar_flags) != rebar_flags)
+            continue;
+        if (ma->props.memoryHeaps[type.heapIndex].size > (256LLU << 20)) {
+            PL_INFO(vk, "Device-local memory is host-visible (resizable BAR), "
+                    "using direct buffer uploads");
+            ma->has_rebar = true;
+            break;
+        }
+    }
+
     return ma;
 }
 
@@ -415,7 +710,7 @@ void vk_malloc_destroy(struct vk_malloc **ma_ptr)
         return;
 
     for (int i = 0; i < ma->num_heaps; i++)
-        heap_uninit(ma->vk, &ma->heaps[i]);
+        heap_uninit(ma, &ma->heaps[i]);
 
     TA_FREEP(ma_ptr);
 }
@@ -435,18 +730,29 @@ pl_handle_caps vk_malloc_handle_caps(struct vk_malloc *ma, bool import)
             caps |= type;
     }
 
+    // Host pointers can only be imported, and only as buffers
+    if (import && ma->host_ptr_align) {
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (buf_external_check(vk, usage, PL_HANDLE_HOST_PTR, true))
+            caps |= PL_HANDLE_HOST_PTR;
+    }
+
     return caps;
 }
 
 void vk_free_memslice(struct vk_malloc *ma, struct vk_memslice slice)
 {
     struct vk_ctx *vk = ma->vk;
-    struct vk_slab *slab = slice.priv;
-    if (!slab)
+    struct vk_block *block = slice.priv;
+    if (!block)
         return;
 
+    struct vk_slab *slab = block->slab;
+
     pl_assert(slab->used >= slice.size);
     slab->used -= slice.size;
+    ma->used[slab->mem_heap] -= slice.size;
 
     PL_DEBUG(vk, "Freeing slice %zu + %zu from slab with size %zu",
              (size_t) slice.offset, (size_t) slice.size, (size_t) slab->size);
@@ -454,13 +760,15 @@ void vk_free_memslice(struct vk_malloc *ma, struct vk_memslice slice)
     if (slab->dedicated) {
         // If the slab was purpose-allocated for this memslice, we can just
         // free it here
-        slab_free(vk, slab);
+        if (slab->heap_index >= 0) {
+            struct vk_heap *heap = &ma->heaps[slab->heap_index];
+            heap->dedicated_size -= slab->size;
+            heap->num_dedicated--;
+        }
+        slab_free(ma, slab);
     } else {
         // Return the allocation to the free space map
-        insert_region(slab, (struct vk_region) {
-            .start = slice.offset,
-            .end   = slice.offset + slice.size,
-        });
+        slab_put_block(slab, block);
     }
 }
 
@@ -497,93 +805,183 @@ static struct vk_heap *find_heap(struct vk_malloc *ma, VkBufferUsageFlags usage,
     return heap;
 }
 
-static inline bool region_fits(struct vk_region r, size_t size, size_t align)
+// Queries the current VK_EXT_memory_budget values, returns false if unavailable
+static bool query_budget(struct vk_malloc *ma,
+                         VkPhysicalDeviceMemoryBudgetPropertiesEXT *out)
 {
-    return PL_ALIGN(r.start, align) + size <= r.end;
+    struct vk_ctx *vk = ma->vk;
+    if (!ma->has_budget)
+        return false;
+
+    *out = (VkPhysicalDeviceMemoryBudgetPropertiesEXT) {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+
+    VkPhysicalDeviceMemoryProperties2KHR props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+        .pNext = out,
+    };
+
+    vk->GetPhysicalDeviceMemoryProperties2KHR(vk->physd, &props);
+    return true;
 }
 
-// Finds the best-fitting region in a heap. If the heap is too small or too
-// fragmented, a new slab will be allocated under the hood.
-static bool heap_get_region(struct vk_malloc *ma, struct vk_heap *heap,
-                            size_t size, size_t align,
-                            struct vk_slab **out_slab, int *out_index)
+// Returns whether allocating `size` more bytes from a given VkMemoryHeap
+// would exceed its current budget
+static bool over_budget(struct vk_malloc *ma, int mem_heap, size_t size)
 {
-    struct vk_slab *slab = NULL;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+    if (!query_budget(ma, &budget) || !budget.heapBudget[mem_heap])
+        return false;
 
-    // If the allocation is very big, serve it directly instead of bothering
-    // with the heap
-    if (size > PLVK_HEAP_MAXIMUM_SLAB_SIZE) {
-        slab = slab_alloc(ma, heap, size);
-        if (slab)
-            slab->dedicated = true;
-        *out_slab = slab;
-        *out_index = 0;
-        return !!slab;
-    }
+    return budget.heapUsage[mem_heap] + size > budget.heapBudget[mem_heap];
+}
 
-    for (int i = 0; i < heap->num_slabs; i++) {
-        slab = heap->slabs[i];
-        if (slab->size < size)
+// Best guess at which VkMemoryHeap a vk_heap's slabs will be allocated from,
+// or -1 if unknown. (The actual choice may depend on buffer requirements)
+static int heap_mem_index(struct vk_malloc *ma, const struct vk_heap *heap)
+{
+    for (int i = 0; i < ma->props.memoryTypeCount; i++) {
+        VkMemoryType type = ma->props.memoryTypes[i];
+        if ((type.propertyFlags & heap->flags) != heap->flags)
             continue;
+        if (heap->typeBits && !(heap->typeBits & (1 << i)))
+            continue;
+        return type.heapIndex;
+    }
 
-        // Attempt a best fit search
-        int best = -1;
-        for (int n = 0; n < slab->num_regions; n++) {
-            struct vk_region r = slab->regions[n];
-            if (!region_fits(r, size, align))
-                continue;
-            if (best >= 0 && region_len(r) > region_len(slab->regions[best]))
+    return -1;
+}
+
+size_t vk_malloc_trim(struct vk_malloc *ma)
+{
+    size_t freed = 0;
+    for (int i = 0; i < ma->num_heaps; i++) {
+        struct vk_heap *heap = &ma->heaps[i];
+        for (int n = heap->num_slabs - 1; n >= 0; n--) {
+            struct vk_slab *slab = heap->slabs[n];
+            if (slab->used)
                 continue;
-            best = n;
-        }
 
-        if (best >= 0) {
-            *out_slab = slab;
-            *out_index = best;
-            return true;
+            freed += slab->size;
+            TARRAY_REMOVE_AT(heap->slabs, heap->num_slabs, n);
+            slab_free(ma, slab);
         }
     }
 
+    if (freed)
+        PL_DEBUG(ma->vk, "Trimmed %zu bytes of unused memory", freed);
+    return freed;
+}
+
+void vk_malloc_mem_stats(struct vk_malloc *ma, struct pl_vulkan_mem_stats *out)
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+    bool has_budget = query_budget(ma, &budget);
+
+    *out = (struct pl_vulkan_mem_stats) {
+        .num_heaps = ma->props.memoryHeapCount,
+    };
+
+    for (int i = 0; i < out->num_heaps; i++) {
+        out->heaps[i] = (struct pl_vulkan_mem_heap) {
+            .flags = ma->props.memoryHeaps[i].flags,
+            .size = ma->props.memoryHeaps[i].size,
+            .allocated = ma->allocated[i],
+            .used = ma->used[i],
+            .budget = has_budget ? budget.heapBudget[i] : 0,
+            .usage = has_budget ? budget.heapUsage[i] : 0,
+        };
+    }
+}
+
+// Finds a suitable free block in a heap. If the heap is too small or too
+// fragmented, a new slab will be allocated under the hood.
+static struct vk_block *heap_get_block(struct vk_malloc *ma,
+                                       struct vk_heap *heap,
+                                       size_t size, size_t align,
+                                       bool dedicated, VkImage image)
+{
+    struct vk_slab *slab = NULL;
+    struct vk_block *block;
+
+    // If the allocation is very big (or the driver asked for it), serve it
+    // directly instead of bothering with the heap
+    if (dedicated || size > PLVK_HEAP_DEDICATED_THRESHOLD) {
+        slab = slab_alloc(ma, heap, size, true, image);
+        if (!slab)
+            return NULL;
+        heap->dedicated_size += slab->size;
+        heap->num_dedicated++;
+        block = slab_get_block(slab, size, 1);
+        pl_assert(block);
+        return block;
+    }
+
+    for (int i = 0; i < heap->num_slabs; i++) {
+        slab = heap->slabs[i];
+        block = slab_get_block(slab, size, align);
+        if (block)
+            return block;
+    }
+
     // Otherwise, allocate a new vk_slab and append it to the list.
     size_t cur_size = PL_MAX(size, slab ? slab->size : 0);
     size_t slab_size = PLVK_HEAP_SLAB_GROWTH_RATE * cur_size;
     slab_size = PL_MAX(PLVK_HEAP_MINIMUM_SLAB_SIZE, slab_size);
     slab_size = PL_MIN(PLVK_HEAP_MAXIMUM_SLAB_SIZE, slab_size);
     pl_assert(slab_size >= size);
-    slab = slab_alloc(ma, heap, slab_size);
+
+    // If growing the heap would exceed the memory budget, release unused
+    // slabs first, and otherwise only grow it by as much as necessary
+    int mem_heap = heap_mem_index(ma, heap);
+    if (mem_heap >= 0 && over_budget(ma, mem_heap, slab_size)) {
+        size_t freed = vk_malloc_trim(ma);
+        if (over_budget(ma, mem_heap, slab_size)) {
+            slab_size = PL_MAX(size, PLVK_HEAP_MINIMUM_SLAB_SIZE);
+            PL_DEBUG(ma->vk, "Memory heap %d over budget, trimmed %zu bytes "
+                     "and shrinking new slab to %zu bytes", mem_heap, freed,
+                     slab_size);
+        }
+    }
+
+    slab = slab_alloc(ma, heap, slab_size, false, VK_NULL_HANDLE);
     if (!slab)
-        return false;
+        return NULL;
     TARRAY_APPEND(NULL, heap->slabs, heap->num_slabs, slab);
+    vk_malloc_print_stats(ma, PL_LOG_DEBUG);
 
-    // Return the only region there is in a newly allocated slab
-    pl_assert(slab->num_regions == 1);
-    *out_slab = slab;
-    *out_index = 0;
-    return true;
+    // A newly allocated slab consists only of a single free block at offset
+    // 0, so this can't fail
+    block = slab_get_block(slab, size, align);
+    pl_assert(block);
+    return block;
 }
 
 static bool slice_heap(struct vk_malloc *ma, struct vk_heap *heap, size_t size,
-                       size_t alignment, struct vk_memslice *out)
+                       size_t alignment, bool dedicated, VkImage image,
+                       struct vk_memslice *out)
 {
     struct vk_ctx *vk = ma->vk;
-    struct vk_slab *slab;
-    int index;
     alignment = pl_lcm(alignment, vk->limits.bufferImageGranularity);
-    if (!heap_get_region(ma, heap, size, alignment, &slab, &index))
+    struct vk_block *block = heap_get_block(ma, heap, size, alignment,
+                                            dedicated, image);
+    if (!block)
         return false;
 
-    struct vk_region reg = slab->regions[index];
-    TARRAY_REMOVE_AT(slab->regions, slab->num_regions, index);
-    VkDeviceSize offset = PL_ALIGN(reg.start, alignment);
+    struct vk_slab *slab = block->slab;
+    VkDeviceSize offset = block->offset;
     *out = (struct vk_memslice) {
         .vkmem = slab->mem,
         .offset = offset,
         .size = size,
-        .priv = slab,
+        .priv = block,
         .shared_mem = {
             .handle = slab->handle,
             .offset = offset,
             .size = slab->size,
+            // matches the condition for `ded_info` in `slab_alloc`
+            .dedicated = slab->dedicated && ma->has_dedicated && image,
         },
     };
 
@@ -595,21 +993,137 @@ static bool slice_heap(struct vk_malloc *ma, struct vk_heap *heap, size_t size,
     PL_DEBUG(vk, "Sub-allocating slice %zu + %zu from slab with size %zu",
              (size_t) out->offset, (size_t) out->size, (size_t) slab->size);
 
-    size_t out_end = out->offset + out->size;
-    insert_region(slab, (struct vk_region) { reg.start, out->offset });
-    insert_region(slab, (struct vk_region) { out_end, reg.end });
-
     slab->used += size;
+    ma->used[slab->mem_heap] += size;
     return true;
 }
 
+int vk_malloc_stats(struct vk_malloc *ma, struct vk_heap_stats *out, int num)
+{
+    for (int i = 0; i < PL_MIN(num, ma->num_heaps); i++) {
+        const struct vk_heap *heap = &ma->heaps[i];
+        struct vk_heap_stats *st = &out[i];
+        *st = (struct vk_heap_stats) {
+            .usage = heap->usage,
+            .flags = heap->flags,
+            .num_slabs = heap->num_slabs + heap->num_dedicated,
+            .size = heap->dedicated_size,
+            .used = heap->dedicated_size,
+        };
+
+        size_t total_free = 0;
+        for (int n = 0; n < heap->num_slabs; n++) {
+            const struct vk_slab *slab = heap->slabs[n];
+            st->size += slab->size;
+            st->used += slab->used;
+            st->num_free += slab->num_free;
+            total_free += slab->size - slab->used;
+            if (!slab->fl_bitmap)
+                continue;
+
+            // The largest free block must be in the largest size class
+            int fl = PL_LOG2(slab->fl_bitmap);
+            int sl = PL_LOG2(slab->sl_bitmap[fl]);
+            for (struct vk_block *b = slab->free_lists[fl][sl]; b; b = b->next_free)
+                st->largest_free = PL_MAX(st->largest_free, b->size);
+        }
+
+        if (total_free)
+            st->fragmentation = 1.0 - (double) st->largest_free / total_free;
+    }
+
+    return ma->num_heaps;
+}
+
+void vk_malloc_print_stats(struct vk_malloc *ma, enum pl_log_level lev)
+{
+    struct vk_ctx *vk = ma->vk;
+    if (!pl_msg_test(vk->ctx, lev))
+        return;
+
+    struct vk_heap_stats *stats = talloc_array(NULL, struct vk_heap_stats, ma->num_heaps);
+    int num = vk_malloc_stats(ma, stats, ma->num_heaps);
+
+    PL_MSG(vk, lev, "Memory heap statistics:");
+    for (int i = 0; i < num; i++) {
+        const struct vk_heap_stats *st = &stats[i];
+        PL_MSG(vk, lev, "    heap %d (usage 0x%x flags 0x%x): %d slabs, "
+               "%zu / %zu bytes used, %d free blocks (largest %zu), "
+               "fragmentation %.2f%%", i, (unsigned) st->usage,
+               (unsigned) st->flags, st->num_slabs, st->used, st->size,
+               st->num_free, st->largest_free, 100.0 * st->fragmentation);
+    }
+
+    talloc_free(stats);
+}
+
 bool vk_malloc_generic(struct vk_malloc *ma, VkMemoryRequirements reqs,
                        VkMemoryPropertyFlags flags,
                        enum pl_handle_type handle_type,
                        struct vk_memslice *out)
 {
     struct vk_heap *heap = find_heap(ma, 0, flags, handle_type, &reqs);
-    return slice_heap(ma, heap, reqs.size, reqs.alignment, out);
+    return slice_heap(ma, heap, reqs.size, reqs.alignment, false,
+                      VK_NULL_HANDLE, out);
+}
+
+bool vk_malloc_image(struct vk_malloc *ma, VkImage image,
+                     VkMemoryPropertyFlags flags,
+                     enum pl_handle_type handle_type,
+                     struct vk_memslice *out)
+{
+    struct vk_ctx *vk = ma->vk;
+    if (!ma->has_dedicated) {
+        VkMemoryRequirements reqs = {0};
+        vk->GetImageMemoryRequirements(vk->dev, image, &reqs);
+        return vk_malloc_generic(ma, reqs, flags, handle_type, out);
+    }
+
+    VkMemoryDedicatedRequirementsKHR ded_reqs = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR,
+    };
+
+    VkMemoryRequirements2KHR reqs2 = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+        .pNext = &ded_reqs,
+    };
+
+    VkImageMemoryRequirementsInfo2KHR info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR,
+        .image = image,
+    };
+
+    vk->GetImageMemoryRequirements2KHR(vk->dev, &info, &reqs2);
+    VkMemoryRequirements *reqs = &reqs2.memoryRequirements;
+
+    // Always give exported images their own allocation, so the exported
+    // handle doesn't expose the memory of any other objects
+    bool dedicated = ded_reqs.prefersDedicatedAllocation ||
+                     ded_reqs.requiresDedicatedAllocation ||
+                     handle_type;
+
+    struct vk_heap *heap = find_heap(ma, 0, flags, handle_type, reqs);
+    return slice_heap(ma, heap, reqs->size, reqs->alignment, dedicated,
+                      image, out);
+}
+
+bool vk_malloc_has_rebar(struct vk_malloc *ma)
+{
+    return ma->has_rebar;
+}
+
+bool vk_malloc_has_memtype(struct vk_malloc *ma, uint32_t typeBits,
+                           VkMemoryPropertyFlags flags)
+{
+    for (int i = 0; i < ma->props.memoryTypeCount; i++) {
+        if ((ma->props.memoryTypes[i].propertyFlags & flags) != flags)
+            continue;
+        if (typeBits && !(typeBits & (1 << i)))
+            continue;
+        return true;
+    }
+
+    return false;
 }
 
 bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
@@ -618,17 +1132,17 @@ bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
                       struct vk_bufslice *out)
 {
     struct vk_heap *heap = find_heap(ma, bufFlags, memFlags, handle_type, NULL);
-    if (!slice_heap(ma, heap, size, alignment, &out->mem))
+    if (!slice_heap(ma, heap, size, alignment, false, VK_NULL_HANDLE, &out->mem))
         return false;
 
-    struct vk_slab *slab = out->mem.priv;
-    out->buf = slab->buffer;
+    struct vk_block *block = out->mem.priv;
+    out->buf = block->slab->buffer;
 
     return true;
 }
 
 bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
-                      const struct pl_shared_mem *shared_mem,
+                      const struct pl_shared_mem *shared_mem, VkImage image,
                       struct vk_memslice *out)
 {
     struct vk_ctx *vk = ma->vk;
@@ -648,6 +1162,10 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
         PL_ERR(vk, "Importing external memory requires %s.",
                VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME);
         return false;
+    } else if (shared_mem->dedicated && (!ma->has_dedicated || !image)) {
+        PL_ERR(vk, "Importing dedicated memory requires %s and an image.",
+               VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+        return false;
     }
 
     VkDeviceMemory vkmem = NULL;
@@ -677,28 +1195,42 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
         return false;
     }
 
-    const VkImportMemoryFdInfoKHR iinfo = {
+    VkImportMemoryFdInfoKHR iinfo = {
         .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
         .pNext = NULL,
         .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
         .fd = fd,
     };
 
-    const VkMemoryAllocateInfo ainfo = {
+    VkMemoryDedicatedAllocateInfoKHR ded_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR,
+        .image = image,
+    };
+
+    VkMemoryAllocateInfo ainfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         .pNext = &iinfo,
         .allocationSize = shared_mem->size,
         .memoryTypeIndex = first_mem_type - 1,
     };
 
+    if (shared_mem->dedicated)
+        vk_link_struct(&ainfo, &ded_info);
+
     VK(vk->AllocateMemory(vk->dev, &ainfo, VK_ALLOC, &vkmem));
     // fd ownership is transferred at this point.
 
+    uint32_t mem_heap = ma->props.memoryTypes[first_mem_type - 1].heapIndex;
+    ma->allocated[mem_heap] += shared_mem->size;
+    ma->used[mem_heap] += shared_mem->size;
+
     struct vk_slab *slab = talloc_ptrtype(NULL, slab);
     *slab = (struct vk_slab) {
         .mem = vkmem,
         .dedicated = true,
         .imported = true,
+        .heap_index = -1,
+        .mem_heap = mem_heap,
         .size = shared_mem->size,
         .used = shared_mem->size,
         .handle = {
@@ -706,12 +1238,17 @@ bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
         },
         .handle_type = handle_type,
     };
+
+    slab_init_blocks(slab);
+    struct vk_block *block = slab_get_block(slab, slab->size, 1);
+    pl_assert(block);
+
     *out = (struct vk_memslice) {
         .vkmem = vkmem,
         .size = shared_mem->size,
         .offset = shared_mem->offset,
         .shared_mem = *shared_mem,
-        .priv = slab,
+        .priv = block,
     };
 
     PL_DEBUG(vk, "Importing %zu of memory from fd: %d",
@@ -726,3 +1263,129 @@ error:
 
 #endif // VK_HAVE_UNIX
 }
+
+bool vk_malloc_import_host(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
+                           const struct pl_shared_mem *shared_mem, size_t size,
+                           VkDeviceSize alignment, struct vk_bufslice *out)
+{
+    struct vk_ctx *vk = ma->vk;
+    if (!ma->host_ptr_align) {
+        PL_ERR(vk, "Importing host pointers requires %s.",
+               VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        return false;
+    }
+
+    // The imported range must be aligned to `minImportedHostPointerAlignment`,
+    // so round it outwards. This is safe since the alignment is at most the
+    // page size, and whole pages are always accessible.
+    uintptr_t addr = (uintptr_t) shared_mem->handle.ptr + shared_mem->offset;
+    uintptr_t base = addr & ~((uintptr_t) ma->host_ptr_align - 1);
+    size_t import_size = PL_ALIGN2(addr - base + size, ma->host_ptr_align);
+    if ((addr - base) % alignment) {
+        PL_ERR(vk, "Imported host ptr %p is not aligned to %zu bytes!",
+               (void *) addr, (size_t) alignment);
+        return false;
+    }
+
+    VkExternalMemoryHandleTypeFlagBitsKHR htype;
+    htype = vk_mem_handle_type(PL_HANDLE_HOST_PTR);
+
+    VkMemoryHostPointerPropertiesEXT ptr_props = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT,
+    };
+
+    struct vk_slab *slab = talloc_ptrtype(NULL, slab);
+    *slab = (struct vk_slab) {
+        .dedicated = true,
+        .imported = true,
+        .heap_index = -1,
+        .size = import_size,
+        .handle = {
+            .ptr = (void *) base,
+        },
+        .handle_type = PL_HANDLE_HOST_PTR,
+    };
+
+    VK(vk->GetMemoryHostPointerPropertiesEXT(vk->dev, htype, (void *) base,
+                                             &ptr_props));
+
+    // See the comment in `slab_alloc` regarding queue family sharing
+    uint32_t qfs[3] = {0};
+    for (int i = 0; i < vk->num_pools; i++)
+        qfs[i] = vk->pools[i]->qf;
+
+    VkExternalMemoryBufferCreateInfoKHR ext_buf_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR,
+        .handleTypes = htype,
+    };
+
+    VkBufferCreateInfo binfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &ext_buf_info,
+        .size  = import_size,
+        .usage = bufFlags,
+        .sharingMode = vk->num_pools > 1 ? VK_SHARING_MODE_CONCURRENT
+                                         : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vk->num_pools,
+        .pQueueFamilyIndices = qfs,
+    };
+
+    VK(vk->CreateBuffer(vk->dev, &binfo, VK_ALLOC, &slab->buffer));
+    VK_NAME(BUFFER, slab->buffer, "imported host ptr");
+
+    VkMemoryRequirements reqs = {0};
+    vk->GetBufferMemoryRequirements(vk->dev, slab->buffer, &reqs);
+    uint32_t typeBits = ptr_props.memoryTypeBits & reqs.memoryTypeBits;
+    if (!typeBits) {
+        PL_ERR(vk, "No compatible memory types offered for imported host ptr");
+        goto error;
+    }
+
+    VkMemoryType type;
+    int index;
+    if (!find_best_memtype(ma, typeBits, 0, &type, &index))
+        goto error;
+
+    VkImportMemoryHostPointerInfoEXT iinfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+        .handleType = htype,
+        .pHostPointer = (void *) base,
+    };
+
+    VkMemoryAllocateInfo ainfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &iinfo,
+        .allocationSize = import_size,
+        .memoryTypeIndex = index,
+    };
+
+    VK(vk->AllocateMemory(vk->dev, &ainfo, VK_ALLOC, &slab->mem));
+    slab->mem_heap = type.heapIndex;
+    ma->allocated[slab->mem_heap] += slab->size;
+    VK(vk->BindBufferMemory(vk->dev, slab->buffer, slab->mem, 0));
+
+    slab->used = size;
+    ma->used[slab->mem_heap] += size;
+    slab_init_blocks(slab);
+    struct vk_block *block = slab_get_block(slab, slab->size, 1);
+    pl_assert(block);
+
+    *out = (struct vk_bufslice) {
+        .buf = slab->buffer,
+        .mem = {
+            .vkmem = slab->mem,
+            .offset = addr - base,
+            .size = size,
+            .shared_mem = *shared_mem,
+            .priv = block,
+        },
+    };
+
+    PL_DEBUG(vk, "Importing %zu bytes of host memory from ptr: %p",
+             import_size, (void *) base);
+    return true;
+
+error:
+    slab_free(ma, slab);
+    return false;
+}
@@ -27,6 +27,33 @@ void vk_malloc_destroy(struct vk_malloc **ma);
 // Get the supported handle types for this malloc instance
 pl_handle_caps vk_malloc_handle_caps(struct vk_malloc *ma, bool import);
 
+// Usage and fragmentation statistics about a single memory heap
+struct vk_heap_stats {
+    VkBufferUsageFlags usage;    // the buffer usage type (or 0)
+    VkMemoryPropertyFlags flags; // the memory type flags (or 0)
+    int num_slabs;               // number of slabs (incl. dedicated allocations)
+    size_t size;                 // total size of all slabs
+    size_t used;                 // number of bytes actually in use
+    int num_free;                // number of disjoint free blocks
+    size_t largest_free;         // size of the largest free block
+    double fragmentation;        // 1 - largest_free / (size - used), or 0
+};
+
+// Fills in the statistics for up to `num` heaps, and returns the total number
+// of heaps. Call with `num = 0` to query only the number of heaps.
+int vk_malloc_stats(struct vk_malloc *ma, struct vk_heap_stats *out, int num);
+
+// Logs the current statistics of all heaps
+void vk_malloc_print_stats(struct vk_malloc *ma, enum pl_log_level lev);
+
+// Fills in the per-VkMemoryHeap usage statistics (see pl_vulkan_mem_stats)
+void vk_malloc_mem_stats(struct vk_malloc *ma, struct pl_vulkan_mem_stats *out);
+
+// Immediately frees all slabs which contain no allocations, and returns the
+// number of bytes released. This is also done automatically when growing a
+// heap would exceed its memory budget (if VK_EXT_memory_budget is available)
+size_t vk_malloc_trim(struct vk_malloc *ma);
+
 // Represents a single "slice" of generic (non-buffer) memory, plus some
 // metadata for accounting. This struct is essentially read-only.
 struct vk_memslice {
@@ -46,6 +73,24 @@ bool vk_malloc_generic(struct vk_malloc *ma, VkMemoryRequirements reqs,
                        enum pl_handle_type handle_type,
                        struct vk_memslice *out);
 
+// Allocate the memory backing an image. This is like vk_malloc_generic, but
+// uses a dedicated allocation (VK_KHR_dedicated_allocation) for the image if
+// the driver prefers or requires one, which is also the case for all very
+// large allocations. The image must be bound at `out->offset`.
+bool vk_malloc_image(struct vk_malloc *ma, VkImage image,
+                     VkMemoryPropertyFlags flags,
+                     enum pl_handle_type handle_type,
+                     struct vk_memslice *out);
+
+// Returns whether any memory type allowed by `typeBits` (or any memory type at
+// all, for 0) supports all of the memory property `flags`.
+bool vk_malloc_has_memtype(struct vk_malloc *ma, uint32_t typeBits,
+                           VkMemoryPropertyFlags flags);
+
+// Returns whether (a large part of) device-local memory can be directly
+// mapped by the host, e.g. due to resizable BAR support.
+bool vk_malloc_has_rebar(struct vk_malloc *ma);
+
 // Represents a single "slice" of a larger buffer
 struct vk_bufslice {
     struct vk_memslice mem; // must be freed by the user when done
@@ -63,7 +108,18 @@ bool vk_malloc_buffer(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
 
 // Import and track external memory. This can be called repeatedly for the
 // same external memory allocation and it will be imported again and tracked
-// separately each time. This is explicitly allowed by the Vulkan spec.
+// separately each time. This is explicitly allowed by the Vulkan spec. If
+// `shared_mem->dedicated` is set, the memory is imported as a dedicated
+// allocation for `image`, which is required in that case.
 bool vk_malloc_import(struct vk_malloc *ma, enum pl_handle_type handle_type,
-                      const struct pl_shared_mem *shared_mem,
+                      const struct pl_shared_mem *shared_mem, VkImage image,
                       struct vk_memslice *out);
+
+// Import a region of host memory (PL_HANDLE_HOST_PTR) as a buffer. The
+// buffer contents start at `shared_mem->offset` bytes into the allocation,
+// and span `size` bytes, which must be aligned to `alignment` relative to the
+// start of the resulting buffer. The slice's `buf` is a dedicated buffer
+// covering (at least) this range.
+bool vk_malloc_import_host(struct vk_malloc *ma, VkBufferUsageFlags bufFlags,
+                           const struct pl_shared_mem *shared_mem, size_t size,
+                           VkDeviceSize alignment, struct vk_bufslice *out);
@@ -22,6 +22,14 @@
 #include "gpu.h"
 #include "swapchain.h"
 
+// A swapchain which was replaced by a newer one, but may still have frames
+// in flight. Destroyed once the last of these frames has completed.
+struct retired_swapchain {
+    VkSwapchainKHR swapchain;
+    uint64_t gen;
+    int frames;
+};
+
 struct priv {
     struct vk_ctx *vk;
     VkSurfaceKHR surf;
@@ -30,15 +38,38 @@ struct priv {
     struct pl_vulkan_swapchain_params params;
     VkSwapchainCreateInfoKHR protoInfo; // partially filled-in prototype
     VkSwapchainKHR swapchain;
-    VkSwapchainKHR old_swapchain;
+    uint64_t swapchain_gen; // incremented whenever `swapchain` is replaced
+    int swapchain_frames;   // frames in flight on the current `swapchain`
+    struct retired_swapchain *retired;
+    int num_retired;
     int cur_width, cur_height;
-    int swapchain_depth;
+    int swapchain_depth;    // current depth, at most `max_depth`
+    int max_depth;
     int frames_in_flight;   // number of frames currently queued
     bool suboptimal;        // true once VK_SUBOPTIMAL_KHR is returned
     struct pl_color_repr color_repr;
     struct pl_color_space color_space;
     struct pl_hdr_metadata hdr_metadata;
 
+    // presentation timing state:
+    bool present_wait;      // whether VK_KHR_present_wait is used
+    uint64_t frame_id;      // present ID of the most recently submitted frame
+    uint64_t first_id;      // first present ID used on the current swapchain
+    uint64_t presented_id;  // last present ID successfully waited on
+    struct pl_swapchain_timing timing; // latest timing feedback
+
+    // adaptive depth state (see `pl_vulkan_swapchain_params.adaptive_depth`).
+    // Each frame is timed on the GPU, using a pair of timestamp queries
+    // written at the start and end of the frame:
+    struct pl_sw_depth depth;
+    VkQueryPool qpool;      // two queries per slot, NULL if unsupported
+    int num_qslots;
+    int next_qslot;
+    int cur_qslot;          // slot of the current frame, or -1
+    int *frame_qslots;      // slots of all frames in flight, in order
+    int num_frame_qslots;
+    uint64_t last_done;     // GPU timestamp of the previous frame's end
+
     // state of the images:
     const struct pl_tex **images; // pl_tex wrappers for the VkImages
     int num_images;         // size of `images`
@@ -51,6 +82,10 @@ struct priv {
 
 static struct pl_sw_fns vulkan_swapchain;
 
+// Upper bound on how long `swap_buffers` waits for a frame to be presented,
+// to avoid stalling indefinitely on e.g. hidden windows
+#define PRESENT_WAIT_TIMEOUT (100 * 1000000ULL) // 100 ms
+
 static bool vk_map_color_space(VkColorSpaceKHR space, struct pl_color_space *out)
 {
     switch (space) {
@@ -277,6 +312,7 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
     p->vk = vk;
     p->surf = params->surface;
     p->swapchain_depth = PL_DEF(params->swapchain_depth, 3);
+    p->max_depth = p->swapchain_depth;
     pl_assert(p->swapchain_depth > 0);
     p->protoInfo = (VkSwapchainCreateInfoKHR) {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -285,7 +321,7 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
         .imageColorSpace = sfmt.colorSpace,
         .imageArrayLayers = 1, // non-stereoscopic
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .minImageCount = p->swapchain_depth + 1, // +1 for the FB
+        .minImageCount = p->max_depth + 1, // +1 for the FB
         .presentMode = params->present_mode,
         .clipped = true,
     };
@@ -317,6 +353,43 @@ const struct pl_swapchain *pl_vulkan_create_swapchain(const struct pl_vulkan *pl
         p->protoInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    if (params->low_latency) {
+#ifdef VK_KHR_present_wait
+        const VkPhysicalDevicePresentIdFeaturesKHR *present_id;
+        const VkPhysicalDevicePresentWaitFeaturesKHR *present_wait;
+        present_id = vk_find_struct(&vk->features,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR);
+        present_wait = vk_find_struct(&vk->features,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR);
+
+        p->present_wait = vk->WaitForPresentKHR &&
+                          present_id && present_id->presentId &&
+                          present_wait && present_wait->presentWait;
+#endif
+        if (!p->present_wait) {
+            PL_WARN(vk, "Low latency mode requested, but VK_KHR_present_wait "
+                    "is not supported by this device, ignoring");
+        }
+    }
+
+    p->cur_qslot = -1;
+    if (params->adaptive_depth) {
+        if (vk->pool_graphics->props.timestampValidBits) {
+            // Enough slots for all frames in flight plus the current one
+            p->num_qslots = p->max_depth + 2;
+            VkQueryPoolCreateInfo qinfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = 2 * p->num_qslots,
+            };
+
+            VK(vk->CreateQueryPool(vk->dev, &qinfo, VK_ALLOC, &p->qpool));
+        } else {
+            PL_WARN(vk, "Adaptive swapchain depth requested, but the graphics "
+                    "queue does not support timestamp queries, ignoring");
+        }
+    }
+
     return sw;
 
 error:
@@ -331,8 +404,16 @@ static void vk_sw_destroy(const struct pl_swapchain *sw)
     struct priv *p = TA_PRIV(sw);
     struct vk_ctx *vk = p->vk;
 
+    // Only wait for our own frames to complete, rather than for the entire
+    // device to become idle
     pl_gpu_flush(gpu);
-    vk_wait_idle(vk);
+    vk_lock(vk);
+    while (p->frames_in_flight || p->num_retired) {
+        if (!vk_wait_commands(vk, UINT64_MAX))
+            break;
+    }
+    vk_unlock(vk);
+
     for (int i = 0; i < p->num_images; i++)
         pl_tex_destroy(gpu, &p->images[i]);
     for (int i = 0; i < p->num_sems; i++) {
@@ -340,7 +421,10 @@ static void vk_sw_destroy(const struct pl_swapchain *sw)
         vk->DestroySemaphore(vk->dev, p->sems_out[i], VK_ALLOC);
     }
 
+    for (int i = 0; i < p->num_retired; i++)
+        vk->DestroySwapchainKHR(vk->dev, p->retired[i].swapchain, VK_ALLOC);
     vk->DestroySwapchainKHR(vk->dev, p->swapchain, VK_ALLOC);
+    vk->DestroyQueryPool(vk->dev, p->qpool, VK_ALLOC);
     talloc_free((void *) sw);
 }
 
@@ -480,11 +564,28 @@ error:
     return false;
 }
 
-static void destroy_swapchain(struct vk_ctx *vk, struct priv *p)
+// Signals the completion of a frame (or other use) of the swapchain
+// generation `arg`, destroying it if it was retired and is no longer in use
+static void retire_cb(struct priv *p, void *arg)
 {
-    assert(p->old_swapchain);
-    vk->DestroySwapchainKHR(vk->dev, p->old_swapchain, VK_ALLOC);
-    p->old_swapchain = VK_NULL_HANDLE;
+    uint64_t gen = (uintptr_t) arg;
+    if (gen == p->swapchain_gen) {
+        p->swapchain_frames--;
+        return;
+    }
+
+    for (int i = 0; i < p->num_retired; i++) {
+        struct retired_swapchain *r = &p->retired[i];
+        if (r->gen != gen)
+            continue;
+        if (--r->frames == 0) {
+            struct vk_ctx *vk = p->vk;
+            PL_DEBUG(vk, "Destroying retired swapchain %p", (void *) r->swapchain);
+            vk->DestroySwapchainKHR(vk->dev, r->swapchain, VK_ALLOC);
+            TARRAY_REMOVE_AT(p->retired, p->num_retired, i);
+        }
+        return;
+    }
 }
 
 static bool vk_sw_recreate(const struct pl_swapchain *sw, int w, int h)
@@ -496,14 +597,6 @@ static bool vk_sw_recreate(const struct pl_swapchain *sw, int w, int h)
     VkImage *vkimages = NULL;
     int num_images = 0;
 
-    // It's invalid to trigger another swapchain recreation while there's more
-    // than one swapchain already active, so we need to flush any pending
-    // asynchronous swapchain release operations that may be ongoing
-    while (p->old_swapchain) {
-        vk_flush_commands(vk);
-        vk_poll_commands(vk, UINT64_MAX);
-    }
-
     VkSwapchainCreateInfoKHR sinfo = p->protoInfo;
     sinfo.oldSwapchain = p->swapchain;
 
@@ -517,14 +610,23 @@ static bool vk_sw_recreate(const struct pl_swapchain *sw, int w, int h)
     VK(vk->CreateSwapchainKHR(vk->dev, &sinfo, VK_ALLOC, &p->swapchain));
 
     p->suboptimal = false;
+    p->first_id = p->frame_id + 1;
     p->cur_width = sinfo.imageExtent.width;
     p->cur_height = sinfo.imageExtent.height;
 
-    // Freeing the old swapchain while it's still in use is an error, so do it
-    // asynchronously once the device is idle
+    // Freeing the old swapchain while it's still in use is an error, so
+    // retire it, to be destroyed asynchronously once all of the frames that
+    // were presented to it have completed. The extra reference covers any
+    // remaining uses of its images by already submitted commands.
     if (sinfo.oldSwapchain) {
-        p->old_swapchain = sinfo.oldSwapchain;
-        vk_dev_callback(vk, (vk_cb) destroy_swapchain, vk, p);
+        uint64_t gen = p->swapchain_gen++;
+        TARRAY_APPEND(sw, p->retired, p->num_retired, (struct retired_swapchain) {
+            .swapchain = sinfo.oldSwapchain,
+            .gen = gen,
+            .frames = p->swapchain_frames + 1,
+        });
+        p->swapchain_frames = 0;
+        vk_dev_callback(vk, (vk_cb) retire_cb, p, (void *) (uintptr_t) gen);
     }
 
     // Get the new swapchain images
@@ -605,6 +707,30 @@ error:
     return false;
 }
 
+// Writes the timestamp marking the start of a new frame, for adaptive depth
+static void begin_frame_timing(const struct pl_swapchain *sw)
+{
+    struct priv *p = TA_PRIV(sw);
+    struct vk_ctx *vk = p->vk;
+    p->cur_qslot = -1;
+
+    // Slots can only be reused once the results of their frame were read
+    if (!p->qpool || p->num_frame_qslots + 1 >= p->num_qslots)
+        return;
+
+    struct vk_cmd *cmd = pl_vk_steal_cmd(sw->gpu);
+    if (!cmd)
+        return;
+
+    int slot = p->next_qslot;
+    p->next_qslot = (slot + 1) % p->num_qslots;
+    vk->CmdResetQueryPool(cmd->buf, p->qpool, 2 * slot, 2);
+    vk->CmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          p->qpool, 2 * slot);
+    vk_cmd_queue(vk, &cmd);
+    p->cur_qslot = slot;
+}
+
 static bool vk_sw_start_frame(const struct pl_swapchain *sw,
                               struct pl_swapchain_frame *out_frame)
 {
@@ -623,9 +749,14 @@ static bool vk_sw_start_frame(const struct pl_swapchain *sw,
     PL_TRACE(vk, "vkAcquireNextImageKHR signals %p", (void *) sem_in);
 
     for (int attempts = 0; attempts < 2; attempts++) {
+        // This may block for a long time, so don't hold the lock meanwhile.
+        // The swapchain itself must not be used concurrently anyway.
         uint32_t imgidx = 0;
+        bool unlocked = vk_unlock_outermost(vk);
         VkResult res = vk->AcquireNextImageKHR(vk->dev, p->swapchain, UINT64_MAX,
                                                sem_in, VK_NULL_HANDLE, &imgidx);
+        if (unlocked)
+            vk_lock(vk);
 
         switch (res) {
         case VK_SUBOPTIMAL_KHR:
@@ -635,6 +766,7 @@ static bool vk_sw_start_frame(const struct pl_swapchain *sw,
             p->last_imgidx = imgidx;
             pl_vulkan_release(sw->gpu, p->images[imgidx],
                               VK_IMAGE_LAYOUT_UNDEFINED, 0, sem_in);
+            begin_frame_timing(sw);
             *out_frame = (struct pl_swapchain_frame) {
                 .fbo = p->images[imgidx],
                 .flipped = false,
@@ -661,9 +793,54 @@ static bool vk_sw_start_frame(const struct pl_swapchain *sw,
     return false;
 }
 
+// Adapts the swapchain depth to the GPU time taken by the frame that just
+// completed, as measured by the timestamps written at its start and end
+static void update_depth(struct priv *p)
+{
+    struct vk_ctx *vk = p->vk;
+    if (!p->num_frame_qslots)
+        return;
+
+    int slot = p->frame_qslots[0];
+    TARRAY_REMOVE_AT(p->frame_qslots, p->num_frame_qslots, 0);
+    if (slot < 0)
+        return;
+
+    uint64_t ts[2];
+    VkResult res = vk->GetQueryPoolResults(vk->dev, p->qpool, 2 * slot, 2,
+                                           sizeof(ts), ts, sizeof(ts[0]),
+                                           VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS)
+        return; // e.g. the frame's commands were never executed
+
+    uint32_t bits = vk->pool_graphics->props.timestampValidBits;
+    uint64_t mask = bits >= 64 ? UINT64_MAX : (1LLU << bits) - 1;
+    uint64_t frame = (ts[1] - ts[0]) & mask, interval = 0;
+    if (p->last_done) {
+        // The start of this frame may overlap the end of the previous one
+        interval = (ts[1] - p->last_done) & mask;
+        frame = PL_MIN(frame, interval);
+    }
+    p->last_done = ts[1];
+
+    double period = vk->limits.timestampPeriod;
+    int depth = pl_sw_depth_update(&p->depth, p->swapchain_depth, p->max_depth,
+                                   frame * period, interval * period,
+                                   p->timing.refresh_duration);
+
+    if (depth != p->swapchain_depth) {
+        PL_DEBUG(vk, "Frame time %.3f ms (interval %.3f ms), changing "
+                 "swapchain depth: %d -> %d", p->depth.avg_frame_time / 1e6,
+                 p->depth.avg_interval / 1e6, p->swapchain_depth, depth);
+        p->swapchain_depth = depth;
+    }
+}
+
 static void present_cb(struct priv *p, void *arg)
 {
     p->frames_in_flight--;
+    update_depth(p);
+    retire_cb(p, arg);
 }
 
 static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
@@ -689,8 +866,17 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
     if (!cmd)
         return false;
 
+    if (p->cur_qslot >= 0) {
+        vk->CmdWriteTimestamp(cmd->buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                              p->qpool, 2 * p->cur_qslot + 1);
+    }
+
     p->frames_in_flight++;
-    vk_cmd_callback(cmd, (vk_cb) present_cb, p, NULL);
+    p->swapchain_frames++;
+    TARRAY_APPEND(sw, p->frame_qslots, p->num_frame_qslots, p->cur_qslot);
+    p->cur_qslot = -1;
+    vk_cmd_callback(cmd, (vk_cb) present_cb, p,
+                    (void *) (uintptr_t) p->swapchain_gen);
 
     vk_cmd_queue(vk, &cmd);
     if (!vk_flush_commands(vk))
@@ -710,6 +896,31 @@ static bool vk_sw_submit_frame(const struct pl_swapchain *sw)
         .pImageIndices = &p->last_imgidx,
     };
 
+    // Tag each frame with a sequential ID, for presentation timing feedback
+    p->frame_id++;
+
+#ifdef VK_KHR_present_wait
+    VkPresentIdKHR present_id = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = 1,
+        .pPresentIds = &p->frame_id,
+    };
+
+    if (p->present_wait)
+        vk_link_struct(&pinfo, &present_id);
+#endif
+
+    VkPresentTimesInfoGOOGLE present_times = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .swapchainCount = 1,
+        .pTimes = &(VkPresentTimeGOOGLE) {
+            .presentID = (uint32_t) p->frame_id,
+        },
+    };
+
+    if (vk->GetPastPresentationTimingGOOGLE)
+        vk_link_struct(&pinfo, &present_times);
+
     PL_TRACE(vk, "vkQueuePresentKHR waits on %p", (void *) sem_out);
     VkResult res = vk->QueuePresentKHR(queue, &pinfo);
     switch (res) {
@@ -736,7 +947,50 @@ static void vk_sw_swap_buffers(const struct pl_swapchain *sw)
     struct priv *p = TA_PRIV(sw);
 
     while (p->frames_in_flight >= p->swapchain_depth)
-        vk_poll_commands(p->vk, UINT64_MAX);
+        vk_wait_commands(p->vk, UINT64_MAX);
+
+#ifdef VK_KHR_present_wait
+    struct vk_ctx *vk = p->vk;
+    if (!p->present_wait || !p->swapchain)
+        return;
+    if (p->frame_id < (uint64_t) p->swapchain_depth)
+        return;
+
+    // Additionally wait until the Nth previous frame has actually been
+    // displayed. Frames presented to a previous swapchain can't be waited on.
+    uint64_t id = p->frame_id - (p->swapchain_depth - 1);
+    if (id < p->first_id || id <= p->presented_id)
+        return;
+
+    bool unlocked = vk_unlock_outermost(vk);
+    VkResult res = vk->WaitForPresentKHR(vk->dev, p->swapchain, id,
+                                         PRESENT_WAIT_TIMEOUT);
+    if (unlocked)
+        vk_lock(vk);
+    switch (res) {
+    case VK_SUBOPTIMAL_KHR:
+        p->suboptimal = true;
+        // fall through
+    case VK_SUCCESS:
+        p->presented_id = id;
+        if (!vk->GetPastPresentationTimingGOOGLE) {
+            // Approximate the timing feedback by the time we got woken up
+            p->timing.frame_id = id;
+            p->timing.actual_present = pl_clock_ns();
+        }
+        return;
+
+    case VK_TIMEOUT:
+    case VK_ERROR_OUT_OF_DATE_KHR:
+        // Benign, the next start_frame will take care of recreation
+        return;
+
+    default:
+        PL_ERR(vk, "Failed waiting for present ID %"PRIu64": %s", id,
+               vk_res_str(res));
+        return;
+    }
+#endif
 }
 
 static bool vk_sw_resize(const struct pl_swapchain *sw, int *width, int *height)
@@ -790,18 +1044,130 @@ static bool vk_sw_hdr_metadata(const struct pl_swapchain *sw,
     return true;
 }
 
+static bool vk_sw_timing(const struct pl_swapchain *sw,
+                         struct pl_swapchain_timing *out)
+{
+    struct priv *p = TA_PRIV(sw);
+    struct vk_ctx *vk = p->vk;
+    VkPastPresentationTimingGOOGLE *timings = NULL;
+
+    if (vk->GetPastPresentationTimingGOOGLE && p->swapchain) {
+        VkRefreshCycleDurationGOOGLE refresh = {0};
+        VK(vk->GetRefreshCycleDurationGOOGLE(vk->dev, p->swapchain, &refresh));
+        p->timing.refresh_duration = refresh.refreshDuration;
+
+        // Past timings are only ever returned once, so only remember the
+        // most recent entry
+        uint32_t num = 0;
+        VK(vk->GetPastPresentationTimingGOOGLE(vk->dev, p->swapchain, &num, NULL));
+        timings = talloc_zero_array(NULL, VkPastPresentationTimingGOOGLE, num);
+        VkResult res = vk->GetPastPresentationTimingGOOGLE(vk->dev, p->swapchain,
+                                                           &num, timings);
+        if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+            VK_ASSERT(res, "vkGetPastPresentationTimingGOOGLE");
+
+        if (num) {
+            const VkPastPresentationTimingGOOGLE *t = &timings[num - 1];
+            // Reconstruct the full 64-bit ID from the truncated presentID
+            uint32_t age = (uint32_t) p->frame_id - t->presentID;
+            p->timing.frame_id = p->frame_id - age;
+            p->timing.actual_present = t->actualPresentTime;
+            p->timing.earliest_present = t->earliestPresentTime;
+            p->timing.present_margin = t->presentMargin;
+        }
+
+        TA_FREEP(&timings);
+    }
+
+    if (!p->timing.frame_id)
+        return false;
+
+    *out = p->timing;
+
+    // Extrapolate the next vblank from the last known present time
+    uint64_t now = pl_clock_ns(), period = out->refresh_duration;
+    if (out->actual_present && period) {
+        uint64_t next = out->actual_present;
+        if (now > next)
+            next += ((now - next) / period + 1) * period;
+        out->next_vblank = next;
+    }
+
+    return true;
+
+error:
+    talloc_free(timings);
+    return false;
+}
+
 bool pl_vulkan_swapchain_suboptimal(const struct pl_swapchain *sw)
 {
     struct priv *p = TA_PRIV(sw);
     return p->suboptimal;
 }
 
+// Serialize swapchain operations against concurrent use of the pl_gpu
+#define SW_LOCK(sw)   vk_lock(((struct priv *) TA_PRIV(sw))->vk)
+#define SW_UNLOCK(sw) vk_unlock(((struct priv *) TA_PRIV(sw))->vk)
+
+static bool vk_sw_resize_locked(const struct pl_swapchain *sw,
+                                int *width, int *height)
+{
+    SW_LOCK(sw);
+    bool ok = vk_sw_resize(sw, width, height);
+    SW_UNLOCK(sw);
+    return ok;
+}
+
+static bool vk_sw_hdr_metadata_locked(const struct pl_swapchain *sw,
+                                      const struct pl_hdr_metadata *metadata)
+{
+    SW_LOCK(sw);
+    bool ok = vk_sw_hdr_metadata(sw, metadata);
+    SW_UNLOCK(sw);
+    return ok;
+}
+
+static bool vk_sw_start_frame_locked(const struct pl_swapchain *sw,
+                                     struct pl_swapchain_frame *out_frame)
+{
+    SW_LOCK(sw);
+    bool ok = vk_sw_start_frame(sw, out_frame);
+    SW_UNLOCK(sw);
+    return ok;
+}
+
+static bool vk_sw_submit_frame_locked(const struct pl_swapchain *sw)
+{
+    SW_LOCK(sw);
+    bool ok = vk_sw_submit_frame(sw);
+    SW_UNLOCK(sw);
+    return ok;
+}
+
+static void vk_sw_swap_buffers_locked(const struct pl_swapchain *sw)
+{
+    SW_LOCK(sw);
+    vk_sw_swap_buffers(sw);
+    SW_UNLOCK(sw);
+}
+
+static bool vk_sw_timing_locked(const struct pl_swapchain *sw,
+                                struct pl_swapchain_timing *out)
+{
+    SW_LOCK(sw);
+    bool ok = vk_sw_timing(sw, out);
+    SW_UNLOCK(sw);
+    return ok;
+}
+
 static struct pl_sw_fns vulkan_swapchain = {
     .destroy      = vk_sw_destroy,
     .latency      = vk_sw_latency,
-    .resize       = vk_sw_resize,
-    .hdr_metadata = vk_sw_hdr_metadata,
-    .start_frame  = vk_sw_start_frame,
-    .submit_frame = vk_sw_submit_frame,
-    .swap_buffers = vk_sw_swap_buffers,
+    .resize       = vk_sw_resize_locked,
+    .hdr_metadata = vk_sw_hdr_metadata_locked,
+    .start_frame  = vk_sw_start_frame_locked,
+    .submit_frame = vk_sw_submit_frame_locked,
+    .swap_buffers = vk_sw_swap_buffers_locked,
+    .timing       = vk_sw_timing_locked,
 };
@@ -32,6 +32,8 @@ vk_mem_handle_type(enum pl_handle_type handle_type)
         return VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_KMT_BIT_KHR;
     case PL_HANDLE_DMA_BUF:
         return VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+    case PL_HANDLE_HOST_PTR:
+        return VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
     }
 
     abort();
@@ -50,7 +52,8 @@ vk_sync_handle_type(enum pl_handle_type handle_type)
         return VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT_KHR;
     case PL_HANDLE_WIN32_KMT:
         return VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_KMT_BIT_KHR;
-    case PL_HANDLE_DMA_BUF: abort();
+    case PL_HANDLE_DMA_BUF:
+    case PL_HANDLE_HOST_PTR: abort();
     }
 
     abort();
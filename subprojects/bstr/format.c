@@ -33,6 +33,45 @@ int ccStrPrintDouble( char *str, int bufsize, int decimals, double value );
 #define CC_STR_PRINT_BUFSIZE_INT64 (21)
 #define CC_STR_PRINT_BUFSIZE_UINT64 (20)
 
+// Prints `value` with six decimal places, like "%f", except that trailing
+// zeros are dropped (always keeping at least one decimal). Rounding to a
+// fixed point integer first avoids the per-digit floating point math of
+// ccStrPrintDouble, which only serves as the fallback for huge values.
+static int print_float(char *buf, int bufsize, double value)
+{
+    int len;
+    if (!(value > -1e12 && value < 1e12)) { // also catches NaN
+        len = ccStrPrintDouble(buf, bufsize, 6, value);
+    } else {
+        len = 0;
+        if (value < 0.0) {
+            buf[len++] = '-';
+            value = -value;
+        }
+
+        uint64_t fixed = (uint64_t) (value * 1e6 + 0.5);
+        uint32_t frac = fixed % 1000000;
+        len += ccStrPrintUint64(&buf[len], fixed / 1000000);
+        buf[len++] = '.';
+        for (int i = 5; i >= 0; i--) {
+            buf[len + i] = '0' + frac % 10;
+            frac /= 10;
+        }
+        len += 6;
+    }
+
+    while (len > 2 && buf[len - 1] == '0' && buf[len - 2] != '.')
+        len--;
+    return len;
+}
+
+void bstr_xappend_float_c(void *tactx, bstr *s, double value)
+{
+    char buf[32];
+    int len = print_float(buf, sizeof(buf), value);
+    bstr_xappend(tactx, s, (struct bstr) { buf, len });
+}
+
 void bstr_xappend_asprintf_c(void *tactx, bstr *s, const char *fmt, ...)
 {
     va_list ap;
@@ -87,7 +126,7 @@ void bstr_xappend_vasprintf_c(void *tactx, bstr *s, const char *fmt,
             c++;
             continue;
         case 'f':
-            len = ccStrPrintDouble(buf, sizeof(buf), 6, va_arg(ap, double));
+            len = print_float(buf, sizeof(buf), va_arg(ap, double));
             bstr_xappend(tactx, s, (struct bstr) { buf, len });
             continue;
         default:
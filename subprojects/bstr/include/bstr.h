@@ -109,12 +109,17 @@ void bstr_xappend_vasprintf(void *talloc_ctx, bstr *s, const char *fmt, va_list
 //
 // NOTE: These only support %d, %zu, %f, %c and %s, with no other length
 // modifiers or combinations. Calling them on an invalid string will abort, so
-// only use on known format strings!
+// only use on known format strings! Unlike printf, %f omits trailing zeros
+// after the first decimal, e.g. "0.5" instead of "0.500000".
 void bstr_xappend_asprintf_c(void *talloc_ctx, bstr *s, const char *fmt, ...)
     PRINTF_ATTRIBUTE(3, 4);
 void bstr_xappend_vasprintf_c(void *talloc_ctx, bstr *s, const char *fmt, va_list va)
     PRINTF_ATTRIBUTE(3, 0);
 
+// Equivalent to bstr_xappend_asprintf_c(talloc_ctx, s, "%f", value), but
+// without the overhead of parsing a format string
+void bstr_xappend_float_c(void *talloc_ctx, bstr *s, double value);
+
 // If s starts/ends with prefix, return true and return the rest of the string
 // in s.
 bool bstr_eatstart(struct bstr *s, struct bstr prefix);
@@ -43,6 +43,8 @@
 #define talloc_parent                   xta_find_parent
 #define talloc_enable_leak_report       xta_enable_leak_report
 #define talloc_print_leak_report        xta_print_leak_report
+#define talloc_get_stats                xta_get_stats
+#define talloc_get_ctx_stats            xta_get_ctx_stats
 #define talloc_size                     xta_xalloc_size
 #define talloc_zero_size                xta_xzalloc_size
 #define talloc_get_size                 xta_get_size
@@ -89,6 +91,10 @@ struct xta_ref *xta_ref_new(void *t);
 struct xta_ref *xta_ref_dup(struct xta_ref *ref);
 void xta_ref_deref(struct xta_ref **ref);
 
+// Returns true if the caller holds the only reference to `ref`. In this case,
+// the children of `ref` may be freely reused.
+bool xta_ref_is_unique(struct xta_ref *ref);
+
 // Attaches a reference as a child of another talloc ctx, such that freeing
 // `t` is like dereferencing the xta_ref.
 bool xta_ref_attach(void *t, struct xta_ref *ref);
@@ -96,6 +102,7 @@ bool xta_ref_attach(void *t, struct xta_ref *ref);
 #define talloc_ref_new(...)             xta_oom_p(xta_ref_new(__VA_ARGS__))
 #define talloc_ref_dup(...)             xta_oom_p(xta_ref_dup(__VA_ARGS__))
 #define talloc_ref_deref(...)           xta_ref_deref(__VA_ARGS__)
+#define talloc_ref_is_unique(...)       xta_ref_is_unique(__VA_ARGS__)
 #define talloc_ref_attach(...)          xta_oom_b(xta_ref_attach(__VA_ARGS__))
 
 // Talloc public/private struct helpers
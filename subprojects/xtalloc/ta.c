@@ -17,6 +17,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
 
 #define TA_NO_WRAPPERS
 #include "ta.h"
@@ -74,6 +75,195 @@ static void xta_dbg_add(struct xta_header *h);
 static void xta_dbg_check_header(struct xta_header *h);
 static void xta_dbg_remove(struct xta_header *h);
 
+// Small blocks (headers included) are recycled through per-thread caches of
+// free blocks, grouped into power-of-two size classes, rather than going back
+// to malloc() every time. The blocks themselves are regular malloc() blocks
+// of exactly the class size, so they may be freed from any thread, and any
+// cached blocks are released once their thread exits.
+#define POOL_MIN_SHIFT  6   // smallest class: 64 bytes
+#define POOL_CLASSES    6   // largest class: 2048 bytes
+#define POOL_MAX_FREE   64  // maximum number of cached blocks per class
+#define POOL_SIZE(cls)  ((size_t) 1 << (POOL_MIN_SHIFT + (cls)))
+
+struct pool_block {
+    struct pool_block *next;
+};
+
+struct pool_cache {
+    struct pool_block *free[POOL_CLASSES];
+    int num_free[POOL_CLASSES];
+    // Statistics of this thread, only ever written by the owning thread
+    struct xta_stats stats;
+    // Whether `pool_key` is set for this thread, and the cache is linked into
+    // the list of all caches
+    bool registered;
+    struct pool_cache *prev, *next;
+};
+
+static __thread struct pool_cache pool_cache;
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+static bool pool_key_ok;
+
+// Protects the list of registered thread caches (and their statistics) as
+// well as the accumulated statistics of threads which already exited
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_cache *pool_caches;
+static struct xta_stats pool_retired_stats;
+
+// The counters are per-thread, so this doesn't need any atomic RMW. The
+// relaxed store only makes concurrent reads from xta_get_stats() well-defined
+#define STAT_INC(c, field) \
+    __atomic_store_n(&(c)->stats.field, (c)->stats.field + 1, __ATOMIC_RELAXED)
+
+static void pool_flush(void *arg)
+{
+    struct pool_cache *c = arg;
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        while (c->free[i]) {
+            struct pool_block *b = c->free[i];
+            c->free[i] = b->next;
+            free(b);
+        }
+        c->num_free[i] = 0;
+    }
+
+    if (!c->registered)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        pool_caches = c->next;
+    }
+    if (c->next)
+        c->next->prev = c->prev;
+    pool_retired_stats.allocs += c->stats.allocs;
+    pool_retired_stats.frees += c->stats.frees;
+    pool_retired_stats.pool_hits += c->stats.pool_hits;
+    c->stats = (struct xta_stats) {0};
+    c->prev = c->next = NULL;
+    c->registered = false;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void pool_key_init(void)
+{
+    pool_key_ok = pthread_key_create(&pool_key, pool_flush) == 0;
+}
+
+// Makes sure the cache gets flushed (and its statistics retained) when this
+// thread exits. Returns false if this is not possible.
+static bool pool_register(struct pool_cache *c)
+{
+    if (c->registered)
+        return true;
+
+    pthread_once(&pool_key_once, pool_key_init);
+    if (!pool_key_ok || pthread_setspecific(pool_key, c) != 0)
+        return false;
+
+    pthread_mutex_lock(&pool_lock);
+    c->prev = NULL;
+    c->next = pool_caches;
+    if (pool_caches)
+        pool_caches->prev = c;
+    pool_caches = c;
+    c->registered = true;
+    pthread_mutex_unlock(&pool_lock);
+    return true;
+}
+
+// The thread-specific destructor is never run for the main thread (unless it
+// calls pthread_exit), so flush its cache on exit or unload instead. Deleting
+// the key also makes sure no other thread calls into `pool_flush` after the
+// library was unloaded; their cached blocks are leaked instead.
+__attribute__((destructor))
+static void pool_uninit(void)
+{
+    if (!pool_key_ok)
+        return;
+
+    pool_flush(&pool_cache);
+    pthread_key_delete(pool_key);
+    pool_key_ok = false; // free all further blocks directly
+}
+
+// Returns the size class for a block of `size` bytes, or -1 if too large
+static int pool_class(size_t size)
+{
+    if (size > POOL_SIZE(POOL_CLASSES - 1))
+        return -1;
+    int cls = 0;
+    while (POOL_SIZE(cls) < size)
+        cls++;
+    return cls;
+}
+
+// The real size of the block used for an allocation of `size` bytes
+static size_t block_size(size_t size)
+{
+    int cls = pool_class(size);
+    return cls >= 0 ? POOL_SIZE(cls) : size;
+}
+
+static void *block_alloc(size_t size)
+{
+    struct pool_cache *c = &pool_cache;
+    if (!c->registered)
+        pool_register(c);
+    STAT_INC(c, allocs);
+    int cls = pool_class(size);
+    if (cls < 0)
+        return malloc(size);
+
+    struct pool_block *b = c->free[cls];
+    if (!b)
+        return malloc(POOL_SIZE(cls));
+
+    c->free[cls] = b->next;
+    c->num_free[cls]--;
+    STAT_INC(c, pool_hits);
+    return b;
+}
+
+// `size` must be the size the block was (re)allocated with
+static void block_free(void *ptr, size_t size)
+{
+    if (!ptr)
+        return;
+
+    struct pool_cache *c = &pool_cache;
+    STAT_INC(c, frees);
+    int cls = pool_class(size);
+    if (cls < 0 || c->num_free[cls] >= POOL_MAX_FREE || !pool_register(c)) {
+        free(ptr);
+        return;
+    }
+
+    struct pool_block *b = ptr;
+    b->next = c->free[cls];
+    c->free[cls] = b;
+    c->num_free[cls]++;
+}
+
+/* Return the allocation statistics accumulated by all threads since the
+ * start of the process. Allocations which are served from the block caches
+ * are additionally counted in `pool_hits`.
+ */
+void xta_get_stats(struct xta_stats *out)
+{
+    pthread_mutex_lock(&pool_lock);
+    *out = pool_retired_stats;
+    for (struct pool_cache *c = pool_caches; c; c = c->next) {
+        out->allocs += __atomic_load_n(&c->stats.allocs, __ATOMIC_RELAXED);
+        out->frees += __atomic_load_n(&c->stats.frees, __ATOMIC_RELAXED);
+        out->pool_hits += __atomic_load_n(&c->stats.pool_hits, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
 static struct xta_header *get_header(void *ptr)
 {
     struct xta_header *h = ptr ? PTR_TO_HEADER(ptr) : NULL;
@@ -87,7 +277,7 @@ static struct xta_ext_header *get_or_alloc_ext_header(void *ptr)
     if (!h)
         return NULL;
     if (!h->ext) {
-        h->ext = malloc(sizeof(struct xta_ext_header));
+        h->ext = block_alloc(sizeof(struct xta_ext_header));
         if (!h->ext)
             return NULL;
         *h->ext = (struct xta_ext_header) {
@@ -147,7 +337,7 @@ void *xta_alloc_size(void *xta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct xta_header *h = malloc(sizeof(union aligned_header) + size);
+    struct xta_header *h = block_alloc(sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
     *h = (struct xta_header) {.size = size};
@@ -167,9 +357,10 @@ void *xta_zalloc_size(void *xta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct xta_header *h = calloc(1, sizeof(union aligned_header) + size);
+    struct xta_header *h = block_alloc(sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
+    memset(h, 0, sizeof(union aligned_header) + size);
     *h = (struct xta_header) {.size = size};
     xta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
@@ -204,10 +395,15 @@ void *xta_realloc_size(void *xta_parent, void *ptr, size_t size)
         return xta_alloc_size(xta_parent, size);
     struct xta_header *h = get_header(ptr);
     struct xta_header *old_h = h;
-    if (h->size == size)
+    size_t old_bs = block_size(sizeof(union aligned_header) + h->size);
+    size_t new_bs = block_size(sizeof(union aligned_header) + size);
+    if (new_bs == old_bs) {
+        // Still fits into the same block
+        h->size = size;
         return ptr;
+    }
     xta_dbg_remove(h);
-    h = realloc(h, sizeof(union aligned_header) + size);
+    h = realloc(h, new_bs);
     xta_dbg_add(h ? h : old_h);
     if (!h)
         return NULL;
@@ -270,8 +466,9 @@ void xta_free(void *ptr)
         h->prev->next = h->next;
     }
     xta_dbg_remove(h);
-    free(h->ext);
-    free(h);
+    if (h->ext)
+        block_free(h->ext, sizeof(struct xta_ext_header));
+    block_free(h, sizeof(union aligned_header) + h->size);
 }
 
 /* Set a destructor that is to be called when the given allocation is freed.
@@ -311,6 +508,31 @@ void *xta_find_parent(void *ptr)
     return NULL;
 }
 
+static void ctx_stats(struct xta_header *h, struct xta_ctx_stats *out)
+{
+    out->blocks++;
+    out->bytes += h->size;
+    if (!h->ext)
+        return;
+    struct xta_header *ch;
+    for (ch = h->ext->children.next; ch != &h->ext->children; ch = ch->next)
+        ctx_stats(ch, out);
+}
+
+/* Return the number and total size of the allocations that are currently
+ * alive in the hierarchy rooted at ptr, including ptr itself. This can be
+ * used to track down leaks or growth of a specific context.
+ *
+ * Warning: this has O(N) runtime complexity with N (indirect) children!
+ */
+void xta_get_ctx_stats(void *ptr, struct xta_ctx_stats *out)
+{
+    *out = (struct xta_ctx_stats) {0};
+    struct xta_header *h = get_header(ptr);
+    if (h)
+        ctx_stats(h, out);
+}
+
 #ifdef TA_MEMORY_DEBUGGING
 
 #include <pthread.h>
@@ -54,6 +54,23 @@ bool xta_set_destructor(void *ptr, void (*destructor)(void *));
 bool xta_set_parent(void *ptr, void *xta_parent);
 void *xta_find_parent(void *ptr);
 
+// Allocation statistics, accumulated over the whole process
+struct xta_stats {
+    unsigned long long allocs;    // blocks allocated (incl. internal headers)
+    unsigned long long frees;     // blocks freed
+    unsigned long long pool_hits; // allocations served from the block caches
+};
+
+void xta_get_stats(struct xta_stats *out);
+
+// Live allocations of a single allocation context, including all children
+struct xta_ctx_stats {
+    size_t blocks; // number of allocations
+    size_t bytes;  // total size of the allocations (excl. headers)
+};
+
+void xta_get_ctx_stats(void *ptr, struct xta_ctx_stats *out);
+
 // Utility functions
 size_t xta_calc_array_size(size_t element_size, size_t count);
 size_t xta_calc_prealloc_elems(size_t nextidx);
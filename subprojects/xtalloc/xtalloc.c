@@ -124,6 +124,17 @@ void xta_ref_deref(struct xta_ref **refp)
     *refp = NULL;
 }
 
+bool xta_ref_is_unique(struct xta_ref *ref)
+{
+    if (!ref)
+        return false;
+
+    pthread_mutex_lock(&ref->lock);
+    bool unique = ref->refcount == 1;
+    pthread_mutex_unlock(&ref->lock);
+    return unique;
+}
+
 // Indirection object, used to associate the destructor with a xta_ref_deref
 struct xta_ref_indirect {
     struct xta_ref *ref;